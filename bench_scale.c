@@ -0,0 +1,92 @@
+// Microbenchmark for the --scale kernels in iq_scale.h (no LimeSDR needed).
+// gcc -O2 -o bench_scale bench_scale.c -lm
+// ./bench_scale [--scale 0.5] [--seconds 1] [--frames 8192]
+#include "iq_scale.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+    double SCALE = 0.5;
+    double SECONDS = 1.0;
+    size_t FRAMES = 8192;
+
+    // clang-format off
+    for (int i=1; i<argc; i++){
+        const char* a = argv[i];
+        #define NEEDVAL() do{ if (i+1>=argc){ fprintf(stderr,"missing value for %s\n", a); return 1; } }while(0)
+
+        if (!strcmp(a,"--scale")){ NEEDVAL(); SCALE = strtod(argv[++i], NULL); if (SCALE<0.0 || SCALE>4.0){ fprintf(stderr,"--scale out of range\n"); return 1; } continue; }
+        if (!strcmp(a,"--seconds")){ NEEDVAL(); SECONDS = strtod(argv[++i], NULL); if (SECONDS<=0.0){ fprintf(stderr,"bad --seconds\n"); return 1; } continue; }
+        if (!strcmp(a,"--frames")){ NEEDVAL(); FRAMES = (size_t)strtoul(argv[++i], NULL, 0); if (FRAMES<1){ fprintf(stderr,"bad --frames\n"); return 1; } continue; }
+
+        fprintf(stderr,"unknown option: %s\n", a);
+        return 1;
+    }
+    // clang-format on
+
+    const size_t n = 2 * FRAMES;
+    int16_t *src = (int16_t *)aligned_alloc(64, ((n * sizeof(int16_t) + 63) / 64) * 64);
+    int16_t *ref = (int16_t *)aligned_alloc(64, ((n * sizeof(int16_t) + 63) / 64) * 64);
+    int16_t *dst = (int16_t *)aligned_alloc(64, ((n * sizeof(int16_t) + 63) / 64) * 64);
+    if (!src || !ref || !dst) {
+        fprintf(stderr, "malloc failed\n");
+        return 1;
+    }
+
+    uint32_t lcg = 12345;
+    for (size_t i = 0; i < n; i++) {
+        lcg = lcg * 1664525u + 1013904223u;
+        src[i] = (int16_t)(lcg >> 16);
+    }
+
+    iq_scale_q_t q;
+    iq_scale_q_init(&q, SCALE);
+    iq_scale_scalar(ref, src, n, &q);
+
+    const char *sel = NULL;
+    (void)iq_scale_select(&sel);
+    printf("scale=%.6f (g=%d, shift=%d), chunk=%zu frames, runtime pick: %s\n", SCALE, q.g, q.shift, FRAMES, sel);
+
+    for (const iq_scale_kernel_t *k = iq_scale_kernels(); k->name; k++) {
+        if (!k->supported()) {
+            printf("  %-8s not supported on this CPU\n", k->name);
+            continue;
+        }
+
+        k->fn(dst, src, n, &q);
+        int maxdiff = 0;
+        for (size_t i = 0; i < n; i++) {
+            int d = abs((int)dst[i] - (int)ref[i]);
+            if (d > maxdiff)
+                maxdiff = d;
+        }
+
+        uint64_t iters = 0;
+        const double t0 = now_s();
+        double t1 = t0;
+        do {
+            for (int r = 0; r < 64; r++)
+                k->fn(dst, src, n, &q);
+            iters += 64;
+            t1 = now_s();
+        } while (t1 - t0 < SECONDS);
+
+        const double samples = (double)iters * (double)n;
+        printf("  %-8s %9.1f Msamples/s (int16)  %8.1f Mframes/s (complex)  max|diff| vs scalar=%d\n", k->name,
+               samples / (t1 - t0) / 1e6, samples / 2.0 / (t1 - t0) / 1e6, maxdiff);
+    }
+
+    free(src);
+    free(ref);
+    free(dst);
+    return 0;
+}
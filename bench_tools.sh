@@ -0,0 +1,134 @@
+#!/usr/bin/env bash
+# Hardware-free benchmark of the streaming paths (WAV, pipe, tone, OFDM) linked against the mock
+# LimeSuite backend in mock/. Reports sustained Msps, CPU ns per sample and chunk-interval tail
+# latency per case; the raw JSON lines go to --out for regression tracking.
+#
+# ./bench_tools.sh [--seconds 3] [--repeat 3] [--rate max|host|<Hz>] [--sample-rate 30M]
+#                  [--reg-us 0] [--gain-us 0] [--cpu <n>] [--out bench_results.jsonl] [--cases wav,pipe,...]
+#
+# --rate max lets the mock sink take samples as fast as the host makes them (the ceiling);
+# --rate host paces it at --sample-rate, so "underruns" shows whether that rate is sustained.
+# Each case runs --repeat times and the table reports the median run. --cpu pins every run to one
+# CPU with taskset for steadier numbers.
+set -euo pipefail
+
+SECONDS_PER_RUN=3
+REPEAT=3
+RATE=max
+SR=30e6
+REG_US=0
+GAIN_US=0
+CPU=""
+OUT=bench_results.jsonl
+CASES="wav,wav-scale,wav-mmap,pipe,pipe-scale,pipe-shm,tone-dc,tone-2,tone-sweep,ofdm"
+BUILD=${BUILD:-_bench}
+CC=${CC:-gcc}
+CFLAGS=${CFLAGS:--O2}
+
+while [ $# -gt 0 ]; do
+    case "$1" in
+    --seconds) SECONDS_PER_RUN=$2; shift 2 ;;
+    --repeat) REPEAT=$2; shift 2 ;;
+    --rate) RATE=$2; shift 2 ;;
+    --sample-rate) SR=$2; shift 2 ;;
+    --reg-us) REG_US=$2; shift 2 ;;
+    --gain-us) GAIN_US=$2; shift 2 ;;
+    --cpu) CPU=$2; shift 2 ;;
+    --out) OUT=$2; shift 2 ;;
+    --cases) CASES=$2; shift 2 ;;
+    -h | --help) sed -n '2,13p' "$0"; exit 0 ;;
+    *) echo "unknown option: $1" >&2; exit 1 ;;
+    esac
+done
+
+HERE=$(cd "$(dirname "$0")" && pwd)
+mkdir -p "$BUILD"
+for t in tx_wav_I16bit tx_pipe_I16bit tx_ssb11; do
+    $CC $CFLAGS -I"$HERE/mock" -o "$BUILD/$t" "$HERE/$t.c" "$HERE/mock/lms_mock.c" -lpthread -lm
+done
+$CC $CFLAGS -o "$BUILD/iq_shm_cat" "$HERE/iq_shm_cat.c"
+
+# Fixed-seed noise input, 2^20 frames (4 MiB): looping it keeps the file in the page cache.
+SR_HZ=$(python3 -c "import sys; v=sys.argv[1].lower(); m={'k':1e3,'m':1e6,'g':1e9}; print(int(float(v[:-1])*m[v[-1]] if v[-1] in m else float(v)))" "$SR")
+WAV="$BUILD/bench_noise.wav"
+RAW="$BUILD/bench_noise.raw"
+if [ ! -f "$WAV" ] || [ "$(python3 -c "import wave,sys; print(wave.open(sys.argv[1]).getframerate())" "$WAV")" != "$SR_HZ" ]; then
+    python3 - "$WAV" "$RAW" "$SR_HZ" <<'EOF'
+import random, struct, sys, wave
+random.seed(1234)
+n = 1 << 20
+data = struct.pack("<%dh" % (2 * n), *[int(random.gauss(0, 6000)) for _ in range(2 * n)])
+with wave.open(sys.argv[1], "wb") as w:
+    w.setnchannels(2)
+    w.setsampwidth(2)
+    w.setframerate(int(sys.argv[3]))
+    w.writeframes(data)
+open(sys.argv[2], "wb").write(data)
+EOF
+fi
+
+TMP_REPORT=$(mktemp)
+FIFO="$BUILD/bench.fifo"
+trap 'rm -f "$TMP_REPORT" "$FIFO"; kill $(jobs -p) 2>/dev/null || true' EXIT
+PIN=()
+[ -n "$CPU" ] && PIN=(taskset -c "$CPU")
+
+run_case() {
+    local name=$1
+    local args=()
+    local producer=0
+    local producer_pid=""
+    case "$name" in
+    wav) args=("$BUILD/tx_wav_I16bit" --file "$WAV" --loop) ;;
+    wav-scale) args=("$BUILD/tx_wav_I16bit" --file "$WAV" --loop --scale 0.5) ;;
+    wav-mmap) args=("$BUILD/tx_wav_I16bit" --file "$WAV" --loop --mmap) ;;
+    pipe) args=("$BUILD/tx_pipe_I16bit" --fifo "$FIFO" --sample-rate "$SR_HZ" --digital-ramp off); producer=1 ;;
+    pipe-scale) args=("$BUILD/tx_pipe_I16bit" --fifo "$FIFO" --sample-rate "$SR_HZ" --digital-ramp off --scale 0.5); producer=1 ;;
+    pipe-shm) args=("$BUILD/tx_pipe_I16bit" --shm "bench_$$" --sample-rate "$SR_HZ" --digital-ramp off); producer=2 ;;
+    tone-dc) args=("$BUILD/tx_ssb11" --host-sr "$SR_HZ") ;;
+    tone-2) args=("$BUILD/tx_ssb11" --host-sr "$SR_HZ" --tone 1k --tone 3k:-6) ;;
+    tone-sweep) args=("$BUILD/tx_ssb11" --host-sr "$SR_HZ" --sweep -1M~1M/0.5 --tone 250.5k:-10) ;;
+    ofdm) args=("$BUILD/tx_ssb11" --host-sr "$SR_HZ" --ofdm --ofdm-fft 1024 --ofdm-pilots 40 --ofdm-payload 600 --ofdm-mod 64qam) ;;
+    *) echo "unknown case: $name" >&2; return 1 ;;
+    esac
+    if [ "$producer" = 1 ]; then
+        rm -f "$FIFO"
+        mkfifo "$FIFO"
+        (while :; do cat "$RAW"; done >"$FIFO" 2>/dev/null) &
+        producer_pid=$!
+    elif [ "$producer" = 2 ]; then
+        "$BUILD/iq_shm_cat" --shm "bench_$$" --file "$RAW" --loop >/dev/null 2>&1 &
+        producer_pid=$!
+    fi
+    LMS_MOCK_RATE=$RATE LMS_MOCK_REG_US=$REG_US LMS_MOCK_GAIN_US=$GAIN_US LMS_MOCK_REPORT=$TMP_REPORT \
+        LMS_MOCK_LABEL=$name timeout -s INT "$SECONDS_PER_RUN" "${PIN[@]}" "${args[@]}" >/dev/null 2>&1 || true
+    if [ -n "$producer_pid" ]; then
+        kill "$producer_pid" 2>/dev/null || true
+        wait "$producer_pid" 2>/dev/null || true
+    fi
+}
+
+IFS=, read -r -a CASE_LIST <<<"$CASES"
+for c in "${CASE_LIST[@]}"; do
+    for _ in $(seq "$REPEAT"); do
+        run_case "$c"
+    done
+done
+
+cat "$TMP_REPORT" >>"$OUT"
+python3 - "$TMP_REPORT" "$RATE" "$SR" <<'EOF'
+import json, sys
+runs = {}
+for line in open(sys.argv[1]):
+    r = json.loads(line)
+    runs.setdefault(r["case"], []).append(r)
+print("mock rate=%s, sample rate=%s" % (sys.argv[2], sys.argv[3]))
+print("%-11s %4s %9s %9s %10s %10s %10s %10s %9s" % ("case", "runs", "Msps", "(min)", "ns/sample", "p50 us",
+                                                     "p99 us", "max us", "underrun"))
+for case, rs in runs.items():
+    rs.sort(key=lambda r: r["msps"])
+    m = rs[len(rs) // 2]
+    print("%-11s %4d %9.2f %9.2f %10.3f %10.1f %10.1f %10.1f %9d" % (case, len(rs), m["msps"], rs[0]["msps"],
+          m["cpu_ns_per_sample"], m["chunk_us_p50"], m["chunk_us_p99"], m["chunk_us_max"], m["underruns"]))
+EOF
+echo "raw results appended to $OUT"
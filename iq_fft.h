@@ -0,0 +1,106 @@
+#ifndef IQ_FFT_H
+#define IQ_FFT_H
+
+// In-place complex float FFT of interleaved (re, im) pairs, power-of-two sizes >= 4.
+// Iterative radix-2 over a precomputed bit-reversal table and twiddle table; the first two stages
+// are fused into one multiply-free radix-4 pass (their twiddles are 1 and -+j). Unnormalised in
+// both directions. Shared by the OFDM generator (iq_ofdm.h) and the spectrum analyzer (iq_stats.h).
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+typedef struct {
+    int n;
+    bool inverse;     // twiddles e^{+j 2 pi k / n}
+    uint32_t *bitrev; // n entries
+    float *tw;        // n/2 complex
+} iq_fft_t;
+
+static inline void iq_fft_free(iq_fft_t *f) {
+    free(f->bitrev);
+    free(f->tw);
+    memset(f, 0, sizeof(*f));
+}
+
+static inline int iq_fft_init(iq_fft_t *f, int n, bool inverse) {
+    memset(f, 0, sizeof(*f));
+    if (n < 4 || (n & (n - 1)))
+        return -1;
+    f->n = n;
+    f->inverse = inverse;
+    f->bitrev = (uint32_t *)malloc((size_t)n * sizeof(uint32_t));
+    f->tw = (float *)malloc((size_t)n * sizeof(float));
+    if (!f->bitrev || !f->tw) {
+        iq_fft_free(f);
+        return -1;
+    }
+    int log2n = 0;
+    while ((1 << log2n) < n)
+        log2n++;
+    for (int i = 0; i < n; i++) {
+        uint32_t r = 0;
+        for (int b = 0; b < log2n; b++)
+            r |= (uint32_t)((i >> b) & 1) << (log2n - 1 - b);
+        f->bitrev[i] = r;
+    }
+    const double sign = inverse ? 1.0 : -1.0;
+    for (int k = 0; k < n / 2; k++) {
+        f->tw[2 * k] = (float)cos(2.0 * M_PI * k / n);
+        f->tw[2 * k + 1] = (float)(sign * sin(2.0 * M_PI * k / n));
+    }
+    return 0;
+}
+
+static inline void iq_fft_run(const iq_fft_t *f, float *x) {
+    const int n = f->n;
+    for (int i = 0; i < n; i++) {
+        const uint32_t j = f->bitrev[i];
+        if ((uint32_t)i < j) {
+            const float re = x[2 * i], im = x[2 * i + 1];
+            x[2 * i] = x[2 * j];
+            x[2 * i + 1] = x[2 * j + 1];
+            x[2 * j] = re;
+            x[2 * j + 1] = im;
+        }
+    }
+    // lengths 2 and 4 together: twiddles 1 and s*j
+    const float s = f->inverse ? 1.0f : -1.0f;
+    for (int i = 0; i < 2 * n; i += 8) {
+        const float ar = x[i] + x[i + 2], ai = x[i + 1] + x[i + 3];
+        const float br = x[i] - x[i + 2], bi = x[i + 1] - x[i + 3];
+        const float cr = x[i + 4] + x[i + 6], ci = x[i + 5] + x[i + 7];
+        const float dr = x[i + 4] - x[i + 6], di = x[i + 5] - x[i + 7];
+        x[i] = ar + cr;
+        x[i + 1] = ai + ci;
+        x[i + 4] = ar - cr;
+        x[i + 5] = ai - ci;
+        x[i + 2] = br - s * di; // b + s j d
+        x[i + 3] = bi + s * dr;
+        x[i + 6] = br + s * di;
+        x[i + 7] = bi - s * dr;
+    }
+    for (int len = 8; len <= n; len <<= 1) {
+        const int half = len >> 1, step = n / len;
+        for (int base = 0; base < n; base += len) {
+            float *a = x + 2 * base, *b = a + 2 * half;
+            for (int k = 0; k < half; k++) {
+                const float wr = f->tw[2 * k * step], wi = f->tw[2 * k * step + 1];
+                const float tr = b[2 * k] * wr - b[2 * k + 1] * wi;
+                const float ti = b[2 * k] * wi + b[2 * k + 1] * wr;
+                b[2 * k] = a[2 * k] - tr;
+                b[2 * k + 1] = a[2 * k + 1] - ti;
+                a[2 * k] += tr;
+                a[2 * k + 1] += ti;
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,492 @@
+#ifndef IQ_OFDM_H
+#define IQ_OFDM_H
+
+// OFDM test-signal generator for interleaved int16 I/Q, the C counterpart of old/ofdm2.py.
+//
+// Subcarrier plan as in build_subcarrier_plan(): used = pilots + payload bins split evenly above and
+// below DC starting guard + 1 bins out, pilots spread evenly across them. Data bins carry random
+// BPSK/QPSK/8PSK/16QAM/32PSK/64QAM points, pilots BPSK alternating +1/-1 per symbol. A frame is
+// `preamble` Schmidl-Cox symbols (QPSK on the even bins only, so the two halves of the symbol repeat)
+// followed by `frame` data symbols.
+//
+// The content of symbol g is a pure function of (seed, g): each symbol seeds its own PRNG. That lets
+// a pool of workers render fixed-size chunks of the stream independently and in any order; a symbol
+// that straddles two chunks is simply computed by both. Per symbol: map bins, in-place IFFT (iq_fft.h),
+// then the cyclic prefix and the clip are applied while converting to int16 straight into the chunk
+// buffer the stream sends. The clip is a phase-preserving magnitude limit at `scale` of full scale;
+// the gain puts the RMS papr_db below it. Unlike soft_clip() in the Python version it does not look
+// at the block peak, so every chunk is scaled the same.
+//
+// Symbols that repeat are rendered once: the preamble always, and with repeat (the same payload in
+// every frame) the whole frame, which then streams out of one period buffer like a periodic tone set
+// in iq_tone.h, with no worker threads at all.
+
+#include "iq_fft.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define IQ_OFDM_FFT_MIN 16
+#define IQ_OFDM_FFT_MAX 8192
+#define IQ_OFDM_FRAME_MAX 1024 // symbols per frame
+#define IQ_OFDM_THREADS_MAX 16
+#define IQ_OFDM_WINDOW_MAX (2 * IQ_OFDM_THREADS_MAX + 2)
+#define IQ_OFDM_PREAMBLE_SALT 0x5052454D424C45ull // "PREMBLE"
+
+enum { IQ_OFDM_BPSK, IQ_OFDM_QPSK, IQ_OFDM_8PSK, IQ_OFDM_16QAM, IQ_OFDM_32PSK, IQ_OFDM_64QAM };
+
+typedef struct {
+    int fft_n;
+    double cp_frac;
+    int guard;   // unused bins at each band edge
+    int pilots;  // pilot bins (total)
+    int payload; // data bins (total); pilots + payload must be even
+    int mod;
+    uint64_t seed;
+    double papr_db; // clip level over RMS
+    int preamble;   // preamble symbols per frame
+    int frame;      // data symbols per frame
+    bool repeat;    // same payload in every frame
+} iq_ofdm_cfg_t;
+
+static inline void iq_ofdm_cfg_default(iq_ofdm_cfg_t *c) {
+    memset(c, 0, sizeof(*c));
+    c->fft_n = 64;
+    c->cp_frac = 0.25;
+    c->pilots = 6;
+    c->payload = 22;
+    c->mod = IQ_OFDM_16QAM;
+    c->seed = 12345;
+    c->papr_db = 9.0;
+    c->preamble = 1;
+    c->frame = 16;
+}
+
+static const char *const iq_ofdm_mod_names[] = {"bpsk", "qpsk", "8psk", "16qam", "32psk", "64qam"};
+static const int iq_ofdm_mod_bits[] = {1, 2, 3, 4, 5, 6};
+
+static inline const char *iq_ofdm_mod_name(int mod) { return iq_ofdm_mod_names[mod]; }
+
+static inline bool iq_ofdm_parse_mod(const char *s, int *mod) {
+    for (int m = 0; m <= IQ_OFDM_64QAM; m++) {
+        if (!strcasecmp(s, iq_ofdm_mod_names[m])) {
+            *mod = m;
+            return true;
+        }
+    }
+    return false;
+}
+
+typedef struct {
+    iq_ofdm_cfg_t cfg;
+    int n, cp, sym_len; // sym_len = cp + n frames
+    int frame_syms;     // preamble + frame
+    int *data_bins, n_data;
+    int *pilot_bins, n_pilot;
+    int *pre_bins, n_pre;
+    float pre_amp; // keeps the preamble at the data symbols' power
+    iq_fft_t ifft;
+    float constel[2 * 64];
+    int bits;
+    float gain, clip; // IFFT output to int16, limit in int16 units
+    int16_t *cache;   // symbols [0, cached) of a frame, sym_len frames each
+    int cached;
+} iq_ofdm_t;
+
+static inline uint64_t iq_ofdm_mix(uint64_t *s) { // splitmix64
+    uint64_t z = (*s += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static inline void iq_ofdm_free(iq_ofdm_t *o) {
+    free(o->data_bins);
+    free(o->pilot_bins);
+    free(o->pre_bins);
+    iq_fft_free(&o->ifft);
+    free(o->cache);
+    memset(o, 0, sizeof(*o));
+}
+
+static inline void iq_ofdm_constellation(iq_ofdm_t *o) {
+    const int mod = o->cfg.mod;
+    const int m = 1 << o->bits;
+    if (mod == IQ_OFDM_16QAM || mod == IQ_OFDM_64QAM) {
+        const int side = mod == IQ_OFDM_16QAM ? 4 : 8;
+        const double norm = 1.0 / sqrt(mod == IQ_OFDM_16QAM ? 10.0 : 42.0);
+        for (int k = 0; k < m; k++) {
+            o->constel[2 * k] = (float)((2 * (k % side) - side + 1) * norm);
+            o->constel[2 * k + 1] = (float)((2 * (k / side) - side + 1) * norm);
+        }
+        return;
+    }
+    const double off = mod == IQ_OFDM_QPSK ? M_PI / 4.0 : 0.0;
+    for (int k = 0; k < m; k++) {
+        o->constel[2 * k] = (float)cos(2.0 * M_PI * k / m + off);
+        o->constel[2 * k + 1] = (float)sin(2.0 * M_PI * k / m + off);
+    }
+}
+
+// Time-domain symbol g (no CP) into x, n complex floats.
+static inline void iq_ofdm_symbol(const iq_ofdm_t *o, float *x, uint64_t g) {
+    memset(x, 0, 2 * (size_t)o->n * sizeof(float));
+    const uint64_t f = g / (uint64_t)o->frame_syms;
+    const int p = (int)(g % (uint64_t)o->frame_syms);
+    if (p < o->cfg.preamble) {
+        uint64_t s = o->cfg.seed ^ IQ_OFDM_PREAMBLE_SALT ^ (uint64_t)p;
+        uint64_t r = 0;
+        for (int k = 0; k < o->n_pre; k++, r >>= 2) {
+            if ((k & 31) == 0)
+                r = iq_ofdm_mix(&s);
+            x[2 * o->pre_bins[k]] = (r & 1) ? -o->pre_amp : o->pre_amp;
+            x[2 * o->pre_bins[k] + 1] = (r & 2) ? -o->pre_amp : o->pre_amp;
+        }
+    } else {
+        const uint64_t d = (uint64_t)(p - o->cfg.preamble) + (o->cfg.repeat ? 0 : f * (uint64_t)o->cfg.frame);
+        uint64_t s = o->cfg.seed + d * 0xD1B54A32D192ED03ull;
+        const int bits = o->bits, per = 64 / bits;
+        const uint64_t mask = (1ull << bits) - 1;
+        uint64_t r = 0;
+        for (int k = 0; k < o->n_data; k++, r >>= bits) {
+            if (k % per == 0)
+                r = iq_ofdm_mix(&s);
+            const float *c = o->constel + 2 * (r & mask);
+            x[2 * o->data_bins[k]] = c[0];
+            x[2 * o->data_bins[k] + 1] = c[1];
+        }
+        const float pilot = (d & 1) ? -1.0f : 1.0f;
+        for (int k = 0; k < o->n_pilot; k++)
+            x[2 * o->pilot_bins[k]] = pilot;
+    }
+    iq_fft_run(&o->ifft, x);
+}
+
+// Frames [from, to) of the CP + symbol sequence for x into out: scale, magnitude clip, round.
+static inline void iq_ofdm_emit(const iq_ofdm_t *o, const float *x, int16_t *out, int from, int to) {
+    const float g = o->gain, lim = o->clip, lim2 = lim * lim;
+    for (int j = from; j < to; j++, out += 2) {
+        const int idx = j < o->cp ? o->n - o->cp + j : j - o->cp;
+        float re = x[2 * idx] * g, im = x[2 * idx + 1] * g;
+        const float m2 = re * re + im * im;
+        if (m2 > lim2) {
+            const float s = lim / sqrtf(m2);
+            re *= s;
+            im *= s;
+        }
+        out[0] = (int16_t)(re + (re < 0.0f ? -0.5f : 0.5f)); // |re|, |im| <= lim <= 32767
+        out[1] = (int16_t)(im + (im < 0.0f ? -0.5f : 0.5f));
+    }
+}
+
+// Stream frames [first, first + frames) into out; x is n complex floats of scratch.
+static inline void iq_ofdm_render(const iq_ofdm_t *o, float *x, int16_t *out, uint64_t first, size_t frames) {
+    uint64_t g = first / (uint64_t)o->sym_len;
+    int off = (int)(first % (uint64_t)o->sym_len);
+    for (size_t pos = 0; pos < frames; g++, off = 0) {
+        size_t n = (size_t)(o->sym_len - off);
+        if (n > frames - pos)
+            n = frames - pos;
+        const int p = (int)(g % (uint64_t)o->frame_syms);
+        if (p < o->cached) {
+            memcpy(out + 2 * pos, o->cache + 2 * ((size_t)p * o->sym_len + off), n * 2 * sizeof(int16_t));
+        } else {
+            iq_ofdm_symbol(o, x, g);
+            iq_ofdm_emit(o, x, out + 2 * pos, off, off + (int)n);
+        }
+        pos += n;
+    }
+}
+
+// scale: clip level as a fraction of int16 full scale.
+static inline int iq_ofdm_init(iq_ofdm_t *o, const iq_ofdm_cfg_t *cfg, double scale) {
+    memset(o, 0, sizeof(*o));
+    o->cfg = *cfg;
+    const int n = cfg->fft_n;
+    const int used = cfg->pilots + cfg->payload;
+    if (n < IQ_OFDM_FFT_MIN || n > IQ_OFDM_FFT_MAX || (n & (n - 1))) {
+        fprintf(stderr, "ofdm: FFT size %d is not a power of two in %d..%d\n", n, IQ_OFDM_FFT_MIN, IQ_OFDM_FFT_MAX);
+        return -1;
+    }
+    if (cfg->pilots < 0 || cfg->payload < 1 || cfg->guard < 0 || (used & 1) || used > n - 2 - 2 * cfg->guard) {
+        fprintf(stderr, "ofdm: %d pilots + %d payload bins must be even and fit in %d bins (guard %d)\n",
+                cfg->pilots, cfg->payload, n - 2 - 2 * cfg->guard, cfg->guard);
+        return -1;
+    }
+    if (cfg->cp_frac < 0.0 || cfg->cp_frac > 1.0 || cfg->preamble < 0 || cfg->frame < 1 ||
+        cfg->preamble + cfg->frame > IQ_OFDM_FRAME_MAX || cfg->papr_db < 0.0 || cfg->mod < 0 ||
+        cfg->mod > IQ_OFDM_64QAM) {
+        fprintf(stderr, "ofdm: bad cp, frame layout (max %d symbols), PAPR or modulation\n", IQ_OFDM_FRAME_MAX);
+        return -1;
+    }
+    o->n = n;
+    o->cp = (int)lround(cfg->cp_frac * n);
+    o->sym_len = o->cp + n;
+    o->frame_syms = cfg->preamble + cfg->frame;
+    o->bits = iq_ofdm_mod_bits[cfg->mod];
+
+    int *used_bins = (int *)malloc((size_t)used * sizeof(int));
+    o->data_bins = (int *)malloc((size_t)used * sizeof(int));
+    o->pilot_bins = (int *)malloc(((size_t)cfg->pilots + 1) * sizeof(int));
+    o->pre_bins = (int *)malloc((size_t)used * sizeof(int));
+    if (!used_bins || !o->data_bins || !o->pilot_bins || !o->pre_bins || iq_fft_init(&o->ifft, n, true)) {
+        free(used_bins);
+        iq_ofdm_free(o);
+        return -1;
+    }
+    for (int k = 0; k < used / 2; k++) {
+        used_bins[k] = 1 + cfg->guard + k;
+        used_bins[used / 2 + k] = n - 1 - cfg->guard - k;
+    }
+    bool *is_pilot = (bool *)calloc((size_t)used, sizeof(bool));
+    if (!is_pilot) {
+        free(used_bins);
+        iq_ofdm_free(o);
+        return -1;
+    }
+    for (int k = 0; k < cfg->pilots; k++) { // round(linspace(0, used - 1, pilots)); duplicates collapse
+        const int sel = cfg->pilots > 1 ? (int)lround((double)k * (used - 1) / (cfg->pilots - 1)) : 0;
+        is_pilot[sel] = true;
+    }
+    for (int k = 0; k < used; k++) {
+        if (is_pilot[k])
+            o->pilot_bins[o->n_pilot++] = used_bins[k];
+        else
+            o->data_bins[o->n_data++] = used_bins[k];
+        if (!(used_bins[k] & 1))
+            o->pre_bins[o->n_pre++] = used_bins[k];
+    }
+    free(is_pilot);
+    free(used_bins);
+    o->pre_amp = o->n_pre ? (float)sqrt((double)used / (2.0 * o->n_pre)) : 0.0f; // per I/Q component
+
+    iq_ofdm_constellation(o);
+
+    // unnormalised IFFT: E|x|^2 = sum |X|^2 = pilots + data bins (preamble equalised to match)
+    if (scale < 0.0)
+        scale = 0.0;
+    if (scale > 1.0)
+        scale = 1.0;
+    o->clip = (float)(scale * 32767.0);
+    o->gain = (float)(o->clip / pow(10.0, cfg->papr_db / 20.0) / sqrt((double)(o->n_pilot + o->n_data)));
+
+    const int cached = cfg->repeat ? o->frame_syms : cfg->preamble;
+    if (cached) {
+        float *x = (float *)malloc(2 * (size_t)n * sizeof(float));
+        o->cache = (int16_t *)malloc((size_t)cached * o->sym_len * 2 * sizeof(int16_t));
+        if (!x || !o->cache) {
+            free(x);
+            iq_ofdm_free(o);
+            return -1;
+        }
+        for (int p = 0; p < cached; p++)
+            iq_ofdm_render(o, x, o->cache + 2 * (size_t)p * o->sym_len, (uint64_t)p * o->sym_len, (size_t)o->sym_len);
+        o->cached = cached;
+        free(x);
+    }
+    return 0;
+}
+
+// Net payload bit rate at fs.
+static inline double iq_ofdm_bitrate(const iq_ofdm_t *o, double fs) {
+    return (double)o->n_data * o->bits * o->cfg.frame / ((double)o->frame_syms * o->sym_len / fs);
+}
+
+// Chunk source: a period buffer (repeat) or a worker pool rendering chunks ahead of the stream.
+enum { IQ_OFDM_SLOT_QUEUED, IQ_OFDM_SLOT_BUSY, IQ_OFDM_SLOT_DONE };
+
+typedef struct {
+    int16_t *pcm;
+    uint64_t seq; // chunk index in the stream
+    int state;
+} iq_ofdm_slot_t;
+
+typedef struct {
+    iq_ofdm_t o;
+    size_t chunk;
+
+    int16_t *period; // repeat: period_frames + chunk frames; the tail repeats the head
+    size_t period_frames;
+    size_t pos;
+
+    unsigned window;
+    iq_ofdm_slot_t slots[IQ_OFDM_WINDOW_MAX];
+    int16_t *pcm_mem;
+    uint64_t next_seq;
+    unsigned cur;
+    bool held; // slots[cur] is out with the caller until the next call
+    pthread_t th[IQ_OFDM_THREADS_MAX];
+    float *scratch[IQ_OFDM_THREADS_MAX];
+    int nthreads;
+    pthread_mutex_t mu;
+    pthread_cond_t work, done;
+    unsigned queue[IQ_OFDM_WINDOW_MAX], q_head, q_len;
+    bool stop;
+    uint64_t chunks;
+    uint64_t waits; // next() found its chunk still rendering
+} iq_ofdm_src_t;
+
+typedef struct {
+    iq_ofdm_src_t *s;
+    int id;
+} iq_ofdm_worker_arg_t;
+
+static inline void *iq_ofdm_worker(void *arg) {
+    iq_ofdm_src_t *s = ((iq_ofdm_worker_arg_t *)arg)->s;
+    float *x = s->scratch[((iq_ofdm_worker_arg_t *)arg)->id];
+    free(arg);
+    pthread_mutex_lock(&s->mu);
+    for (;;) {
+        while (!s->stop && s->q_len == 0)
+            pthread_cond_wait(&s->work, &s->mu);
+        if (s->stop)
+            break;
+        iq_ofdm_slot_t *sl = &s->slots[s->queue[s->q_head]];
+        s->q_head = (s->q_head + 1) % IQ_OFDM_WINDOW_MAX;
+        s->q_len--;
+        sl->state = IQ_OFDM_SLOT_BUSY;
+        pthread_mutex_unlock(&s->mu);
+
+        iq_ofdm_render(&s->o, x, sl->pcm, sl->seq * s->chunk, s->chunk);
+
+        pthread_mutex_lock(&s->mu);
+        sl->state = IQ_OFDM_SLOT_DONE;
+        pthread_cond_broadcast(&s->done);
+    }
+    pthread_mutex_unlock(&s->mu);
+    return NULL;
+}
+
+static inline void iq_ofdm_submit(iq_ofdm_src_t *s, unsigned idx) {
+    pthread_mutex_lock(&s->mu);
+    s->slots[idx].seq = s->next_seq++;
+    s->slots[idx].state = IQ_OFDM_SLOT_QUEUED;
+    s->queue[(s->q_head + s->q_len) % IQ_OFDM_WINDOW_MAX] = idx;
+    s->q_len++;
+    pthread_cond_signal(&s->work);
+    pthread_mutex_unlock(&s->mu);
+}
+
+static inline void iq_ofdm_src_free(iq_ofdm_src_t *s) {
+    if (s->nthreads) {
+        pthread_mutex_lock(&s->mu);
+        s->stop = true;
+        pthread_cond_broadcast(&s->work);
+        pthread_mutex_unlock(&s->mu);
+        for (int i = 0; i < s->nthreads; i++)
+            pthread_join(s->th[i], NULL);
+        pthread_mutex_destroy(&s->mu);
+        pthread_cond_destroy(&s->work);
+        pthread_cond_destroy(&s->done);
+    }
+    for (int i = 0; i < IQ_OFDM_THREADS_MAX; i++)
+        free(s->scratch[i]);
+    free(s->pcm_mem);
+    free(s->period);
+    iq_ofdm_free(&s->o);
+    memset(s, 0, sizeof(*s));
+}
+
+// nthreads <= 0: one per CPU but one (the stream thread keeps its own). Start it before
+// tx_rt_enter() so the workers do not inherit the stream thread's pinning and priority.
+static inline int iq_ofdm_src_init(iq_ofdm_src_t *s, const iq_ofdm_cfg_t *cfg, double scale, size_t chunk,
+                                   int nthreads) {
+    memset(s, 0, sizeof(*s));
+    s->chunk = chunk;
+    if (iq_ofdm_init(&s->o, cfg, scale))
+        return -1;
+    if (cfg->repeat) {
+        const size_t period = (size_t)s->o.frame_syms * s->o.sym_len;
+        s->period_frames = period;
+        s->period = (int16_t *)aligned_alloc(64, ((2 * (period + chunk) * sizeof(int16_t) + 63) / 64) * 64);
+        if (!s->period) {
+            iq_ofdm_src_free(s);
+            return -1;
+        }
+        memcpy(s->period, s->o.cache, period * 2 * sizeof(int16_t));
+        for (size_t i = 0; i < chunk; i++) {
+            s->period[2 * (period + i)] = s->period[2 * (i % period)];
+            s->period[2 * (period + i) + 1] = s->period[2 * (i % period) + 1];
+        }
+        return 0;
+    }
+
+    if (nthreads <= 0) {
+        const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = cpus > 1 ? (int)cpus - 1 : 1;
+    }
+    if (nthreads > IQ_OFDM_THREADS_MAX)
+        nthreads = IQ_OFDM_THREADS_MAX;
+    s->window = (unsigned)(2 * nthreads + 2);
+    s->pcm_mem = (int16_t *)aligned_alloc(64, ((s->window * chunk * 2 * sizeof(int16_t) + 63) / 64) * 64);
+    if (!s->pcm_mem) {
+        iq_ofdm_src_free(s);
+        return -1;
+    }
+    for (unsigned i = 0; i < s->window; i++)
+        s->slots[i].pcm = s->pcm_mem + (size_t)i * chunk * 2;
+
+    pthread_mutex_init(&s->mu, NULL);
+    pthread_cond_init(&s->work, NULL);
+    pthread_cond_init(&s->done, NULL);
+    for (; s->nthreads < nthreads; s->nthreads++) {
+        s->scratch[s->nthreads] = (float *)malloc(2 * (size_t)s->o.n * sizeof(float));
+        iq_ofdm_worker_arg_t *wa = (iq_ofdm_worker_arg_t *)malloc(sizeof(*wa));
+        if (!s->scratch[s->nthreads] || !wa) {
+            free(wa);
+            break;
+        }
+        wa->s = s;
+        wa->id = s->nthreads;
+        if (pthread_create(&s->th[s->nthreads], NULL, iq_ofdm_worker, wa)) {
+            free(wa);
+            break;
+        }
+    }
+    if (!s->nthreads) {
+        fprintf(stderr, "ofdm: failed to start symbol worker threads\n");
+        pthread_mutex_destroy(&s->mu);
+        pthread_cond_destroy(&s->work);
+        pthread_cond_destroy(&s->done);
+        iq_ofdm_src_free(s);
+        return -1;
+    }
+    for (unsigned i = 0; i < s->window; i++)
+        iq_ofdm_submit(s, i);
+    return 0;
+}
+
+// Next `chunk` frames; the pointer stays valid until the next call.
+static inline const int16_t *iq_ofdm_src_next(iq_ofdm_src_t *s) {
+    s->chunks++;
+    if (s->period) {
+        const int16_t *p = s->period + 2 * s->pos;
+        s->pos = (s->pos + s->chunk) % s->period_frames;
+        return p;
+    }
+    if (s->held) {
+        iq_ofdm_submit(s, s->cur);
+        s->cur = (s->cur + 1) % s->window;
+    }
+    iq_ofdm_slot_t *sl = &s->slots[s->cur];
+    pthread_mutex_lock(&s->mu);
+    if (sl->state != IQ_OFDM_SLOT_DONE)
+        s->waits++;
+    while (sl->state != IQ_OFDM_SLOT_DONE)
+        pthread_cond_wait(&s->done, &s->mu);
+    pthread_mutex_unlock(&s->mu);
+    s->held = true;
+    return sl->pcm;
+}
+
+#endif
@@ -0,0 +1,652 @@
+#ifndef IQ_PACK_H
+#define IQ_PACK_H
+
+// Block-compressed, seekable I/Q container (.iqz) and its parallel streaming decoder.
+//
+// Layout, all little-endian:
+//
+//   iq_pack_file_hdr_t   64 bytes: magic "IQZ1", lanes (int16 per frame: 2 or 4), rate, frames,
+//                        block_frames, nblocks, index_offset
+//   block 0 .. n-1       iq_pack_block_hdr_t (16 bytes) + payload; every block holds block_frames
+//                        frames except the last
+//   index                nblocks + 1 uint64 file offsets (the last one is the end of the final block),
+//                        so block b of any frame f = b * block_frames + r is one lookup away and a loop
+//                        back to frame 0 never scans the file
+//
+// Each block picks the smallest of four lossless codecs. All of them first take out `shift`, the
+// number of trailing zero bits common to every sample, which makes 12-bit data left-justified in
+// int16 cost 12 bits or less:
+//
+//   RAW    int16 as is
+//   CONST  one value per lane (quiet sections, DC)
+//   BITS   (v >> shift) as `param`-bit two's complement, bit-packed
+//   RICE   per-lane delta of (v >> shift), zigzag, Rice-coded in groups of IQ_PACK_GROUP values with
+//          a 5-bit k per group; quotients of IQ_PACK_ESC or more escape to an 18-bit literal
+//
+// Bit streams are MSB first. The decoder checks every payload against its block header and never
+// reads past it, so a corrupt or truncated file fails the stream instead of feeding it garbage.
+//
+// iq_pack_reader_t is the streaming side. A pool of worker threads decodes blocks into a window of
+// buffers ahead of the consumer, and iq_pack_read() copies them out fread() style: it stops short at
+// the end, and with loop the next call continues at frame 0. That is the same contract as
+// wav_aio_read(), so tx_wav_I16bit's reader thread treats all three inputs alike.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define IQ_PACK_MAGIC "IQZ1"
+#define IQ_PACK_BLOCK_MAGIC 0x425a5149u // "IQZB"
+#define IQ_PACK_VERSION 1
+#define IQ_PACK_BLOCK_FRAMES_DEF 65536
+#define IQ_PACK_GROUP 32
+#define IQ_PACK_ESC 20
+#define IQ_PACK_LIT_BITS 18 // zigzag delta of two int16
+#define IQ_PACK_MAX_LANES 4
+#define IQ_PACK_THREADS_MAX 16
+#define IQ_PACK_WINDOW_MAX 64
+
+enum { IQ_PACK_RAW = 0, IQ_PACK_CONST, IQ_PACK_BITS, IQ_PACK_RICE, IQ_PACK_NCODECS };
+
+#pragma pack(push, 1)
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t lanes;
+    uint32_t sample_rate;
+    uint64_t frames;
+    uint32_t block_frames;
+    uint32_t nblocks;
+    uint64_t index_offset;
+    uint8_t reserved[24];
+} iq_pack_file_hdr_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t frames;
+    uint8_t codec;
+    uint8_t shift;
+    uint8_t param; // BITS: width
+    uint8_t reserved;
+    uint32_t payload_bytes;
+} iq_pack_block_hdr_t;
+#pragma pack(pop)
+
+_Static_assert(sizeof(iq_pack_file_hdr_t) == 64, "iqz file header layout");
+_Static_assert(sizeof(iq_pack_block_hdr_t) == 16, "iqz block header layout");
+
+static inline const char *iq_pack_codec_name(int c) {
+    static const char *n[] = {"raw", "const", "bits", "rice"};
+    return c >= 0 && c < IQ_PACK_NCODECS ? n[c] : "?";
+}
+
+// Worst case payload of one block: RAW.
+static inline size_t iq_pack_max_payload(size_t frames, unsigned lanes) { return frames * lanes * sizeof(int16_t); }
+
+// ---- bit I/O ----
+
+typedef struct {
+    uint8_t *p, *end;
+    uint64_t acc;
+    unsigned n; // bits in acc, < 8 between calls
+    bool overflow;
+} iq_pack_bw_t;
+
+static inline void iq_pack_put(iq_pack_bw_t *w, uint32_t v, unsigned bits) { // bits <= 32
+    w->acc = (w->acc << bits) | (uint64_t)v;
+    w->n += bits;
+    while (w->n >= 8) {
+        w->n -= 8;
+        if (w->p == w->end) {
+            w->overflow = true;
+            return;
+        }
+        *w->p++ = (uint8_t)(w->acc >> w->n);
+    }
+}
+
+static inline void iq_pack_flush(iq_pack_bw_t *w) {
+    if (w->n)
+        iq_pack_put(w, 0, 8 - w->n);
+}
+
+typedef struct {
+    const uint8_t *p, *end;
+    uint64_t buf; // left-justified
+    unsigned avail;
+    unsigned past; // zero bytes shifted in beyond the payload
+} iq_pack_br_t;
+
+static inline void iq_pack_refill(iq_pack_br_t *r) {
+    while (r->avail <= 56) {
+        uint64_t b = 0;
+        if (r->p < r->end)
+            b = *r->p++;
+        else
+            r->past++;
+        r->buf |= b << (56 - r->avail);
+        r->avail += 8;
+    }
+}
+
+static inline uint32_t iq_pack_get(iq_pack_br_t *r, unsigned bits) { // 1..32, after a refill
+    uint32_t v = (uint32_t)(r->buf >> (64 - bits));
+    r->buf <<= bits;
+    r->avail -= bits;
+    return v;
+}
+
+// ---- codecs ----
+
+static inline uint32_t iq_pack_zz(int32_t d) { return ((uint32_t)d << 1) ^ (uint32_t)(d >> 31); }
+static inline int32_t iq_pack_unzz(uint32_t u) { return (int32_t)(u >> 1) ^ -(int32_t)(u & 1); }
+
+// RICE payload into out (cap bytes); returns bytes or 0 if it does not fit.
+static inline size_t iq_pack_rice_encode(const int16_t *in, size_t frames, unsigned lanes, unsigned shift, uint8_t *out,
+                                         size_t cap) {
+    iq_pack_bw_t w = {out, out + cap, 0, 0, false};
+    int32_t prev[IQ_PACK_MAX_LANES] = {0};
+    uint32_t u[IQ_PACK_GROUP];
+    const size_t n = frames * lanes;
+    for (size_t g = 0; g < n && !w.overflow; g += IQ_PACK_GROUP) {
+        const size_t m = n - g < IQ_PACK_GROUP ? n - g : IQ_PACK_GROUP;
+        uint64_t sum = 0;
+        for (size_t j = 0; j < m; j++) {
+            const size_t i = g + j;
+            const int32_t v = (int32_t)in[i] >> shift;
+            u[j] = iq_pack_zz(v - prev[i % lanes]);
+            prev[i % lanes] = v;
+            sum += u[j];
+        }
+        unsigned k = 0;
+        while (k < IQ_PACK_LIT_BITS && ((uint64_t)m << (k + 1)) <= sum)
+            k++;
+        iq_pack_put(&w, k, 5);
+        for (size_t j = 0; j < m; j++) {
+            const uint32_t q = u[j] >> k;
+            if (q >= IQ_PACK_ESC) {
+                iq_pack_put(&w, 1, IQ_PACK_ESC + 1); // ESC zeros, then the stop bit
+                iq_pack_put(&w, u[j], IQ_PACK_LIT_BITS);
+            } else {
+                iq_pack_put(&w, 1, q + 1);
+                if (k)
+                    iq_pack_put(&w, u[j] & ((1u << k) - 1), k);
+            }
+        }
+    }
+    iq_pack_flush(&w);
+    return w.overflow ? 0 : (size_t)(w.p - out);
+}
+
+static inline int iq_pack_rice_decode(const uint8_t *in, size_t bytes, size_t frames, unsigned lanes, unsigned shift,
+                                      int16_t *out) {
+    iq_pack_br_t r = {in, in + bytes, 0, 0, 0};
+    int32_t prev[IQ_PACK_MAX_LANES] = {0};
+    const size_t n = frames * lanes;
+    for (size_t g = 0; g < n; g += IQ_PACK_GROUP) {
+        const size_t m = n - g < IQ_PACK_GROUP ? n - g : IQ_PACK_GROUP;
+        iq_pack_refill(&r);
+        const unsigned k = iq_pack_get(&r, 5);
+        if (k > IQ_PACK_LIT_BITS)
+            return -1;
+        for (size_t j = 0; j < m; j++) {
+            iq_pack_refill(&r);
+            if (!r.buf)
+                return -1;
+            const unsigned q = (unsigned)__builtin_clzll(r.buf);
+            if (q > IQ_PACK_ESC)
+                return -1;
+            r.buf <<= q + 1;
+            r.avail -= q + 1;
+            uint32_t u;
+            if (q == IQ_PACK_ESC) {
+                u = iq_pack_get(&r, IQ_PACK_LIT_BITS);
+            } else {
+                u = (uint32_t)q << k;
+                if (k)
+                    u |= iq_pack_get(&r, k);
+            }
+            const size_t i = g + j;
+            const int32_t v = prev[i % lanes] + iq_pack_unzz(u);
+            prev[i % lanes] = v;
+            out[i] = (int16_t)(uint16_t)((uint32_t)v << shift);
+        }
+        if (r.past > 8)
+            return -1;
+    }
+    return r.past > 8 ? -1 : 0;
+}
+
+static inline size_t iq_pack_bits_encode(const int16_t *in, size_t n, unsigned shift, unsigned width, uint8_t *out,
+                                         size_t cap) {
+    iq_pack_bw_t w = {out, out + cap, 0, 0, false};
+    const uint32_t mask = width >= 32 ? 0xffffffffu : (1u << width) - 1;
+    for (size_t i = 0; i < n && !w.overflow; i++)
+        iq_pack_put(&w, (uint32_t)((int32_t)in[i] >> shift) & mask, width);
+    iq_pack_flush(&w);
+    return w.overflow ? 0 : (size_t)(w.p - out);
+}
+
+static inline int iq_pack_bits_decode(const uint8_t *in, size_t bytes, size_t n, unsigned shift, unsigned width,
+                                      int16_t *out) {
+    if (width < 1 || width > 16 || bytes < (n * width + 7) / 8)
+        return -1;
+    iq_pack_br_t r = {in, in + bytes, 0, 0, 0};
+    const unsigned up = 32 - width;
+    for (size_t i = 0; i < n; i++) {
+        iq_pack_refill(&r);
+        const int32_t v = (int32_t)(iq_pack_get(&r, width) << up) >> up; // sign-extend
+        out[i] = (int16_t)(uint16_t)((uint32_t)v << shift);
+    }
+    return 0;
+}
+
+// Encode one block into out (room for a header plus iq_pack_max_payload()); returns the bytes used.
+static inline size_t iq_pack_encode_block(const int16_t *in, size_t frames, unsigned lanes, uint8_t *out) {
+    iq_pack_block_hdr_t h;
+    memset(&h, 0, sizeof(h));
+    h.magic = IQ_PACK_BLOCK_MAGIC;
+    h.frames = (uint32_t)frames;
+    uint8_t *pl = out + sizeof(h);
+    const size_t n = frames * lanes;
+    const size_t raw = n * sizeof(int16_t);
+
+    uint32_t any = 0;
+    bool constant = true;
+    for (size_t i = 0; i < n; i++) {
+        any |= (uint16_t)in[i];
+        constant = constant && in[i] == in[i % lanes];
+    }
+    if (constant) {
+        h.codec = IQ_PACK_CONST;
+        h.payload_bytes = lanes * sizeof(int16_t);
+        memcpy(pl, in, h.payload_bytes);
+        memcpy(out, &h, sizeof(h));
+        return sizeof(h) + h.payload_bytes;
+    }
+    h.shift = (uint8_t)__builtin_ctz(any); // any != 0 here
+    int32_t lo = INT32_MAX, hi = INT32_MIN;
+    for (size_t i = 0; i < n; i++) {
+        const int32_t v = (int32_t)in[i] >> h.shift;
+        lo = v < lo ? v : lo;
+        hi = v > hi ? v : hi;
+    }
+    unsigned width = 1;
+    while (width < 16 && (lo < -(1 << (width - 1)) || hi > (1 << (width - 1)) - 1))
+        width++;
+
+    size_t best = raw;
+    h.codec = IQ_PACK_RAW;
+    const size_t bits = (n * width + 7) / 8;
+    if (bits < best) {
+        best = bits;
+        h.codec = IQ_PACK_BITS;
+        h.param = (uint8_t)width;
+    }
+    const size_t rice = iq_pack_rice_encode(in, frames, lanes, h.shift, pl, best > 0 ? best - 1 : 0);
+    if (rice && rice < best) {
+        best = rice;
+        h.codec = IQ_PACK_RICE;
+        h.param = 0;
+    } else if (h.codec == IQ_PACK_BITS) {
+        iq_pack_bits_encode(in, n, h.shift, width, pl, best);
+    }
+    if (h.codec == IQ_PACK_RAW) {
+        h.shift = 0;
+        memcpy(pl, in, raw);
+    }
+    h.payload_bytes = (uint32_t)best;
+    memcpy(out, &h, sizeof(h));
+    return sizeof(h) + best;
+}
+
+// Decode one block (header + payload, `bytes` long) into out; returns frames, -1 if it is corrupt.
+static inline long iq_pack_decode_block(const uint8_t *in, size_t bytes, unsigned lanes, size_t max_frames,
+                                        int16_t *out) {
+    iq_pack_block_hdr_t h;
+    if (bytes < sizeof(h))
+        return -1;
+    memcpy(&h, in, sizeof(h));
+    if (h.magic != IQ_PACK_BLOCK_MAGIC || h.frames > max_frames || h.payload_bytes > bytes - sizeof(h) ||
+        h.shift > 15)
+        return -1;
+    const uint8_t *pl = in + sizeof(h);
+    const size_t n = (size_t)h.frames * lanes;
+    switch (h.codec) {
+    case IQ_PACK_RAW:
+        if (h.payload_bytes != n * sizeof(int16_t))
+            return -1;
+        memcpy(out, pl, h.payload_bytes);
+        break;
+    case IQ_PACK_CONST:
+        if (h.payload_bytes != lanes * sizeof(int16_t))
+            return -1;
+        for (size_t i = 0; i < n; i += lanes)
+            memcpy(out + i, pl, h.payload_bytes);
+        break;
+    case IQ_PACK_BITS:
+        if (iq_pack_bits_decode(pl, h.payload_bytes, n, h.shift, h.param, out))
+            return -1;
+        break;
+    case IQ_PACK_RICE:
+        if (iq_pack_rice_decode(pl, h.payload_bytes, h.frames, lanes, h.shift, out))
+            return -1;
+        break;
+    default:
+        return -1;
+    }
+    return (long)h.frames;
+}
+
+// ---- file ----
+
+// 1 when path is an .iqz (header in *fh), 0 when it is not, -1 when it cannot be opened.
+static inline int iq_pack_probe(const char *path, iq_pack_file_hdr_t *fh) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    const bool ok = pread(fd, fh, sizeof(*fh), 0) == (ssize_t)sizeof(*fh) && !memcmp(fh->magic, IQ_PACK_MAGIC, 4);
+    close(fd);
+    return ok ? 1 : 0;
+}
+
+// Header and index of an open .iqz; *index gets nblocks + 1 offsets (free it).
+static inline int iq_pack_read_index(int fd, iq_pack_file_hdr_t *fh, uint64_t **index) {
+    *index = NULL;
+    if (pread(fd, fh, sizeof(*fh), 0) != (ssize_t)sizeof(*fh) || memcmp(fh->magic, IQ_PACK_MAGIC, 4)) {
+        fprintf(stderr, "iqz: not an IQZ1 file\n");
+        return -1;
+    }
+    if (fh->version != IQ_PACK_VERSION || fh->lanes < 1 || fh->lanes > IQ_PACK_MAX_LANES || !fh->block_frames ||
+        fh->nblocks != (fh->frames + fh->block_frames - 1) / fh->block_frames) {
+        fprintf(stderr, "iqz: bad header (version %u, %u lanes, %u frames/block, %u blocks)\n", fh->version,
+                fh->lanes, fh->block_frames, fh->nblocks);
+        return -1;
+    }
+    const size_t len = ((size_t)fh->nblocks + 1) * sizeof(uint64_t);
+    uint64_t *ix = (uint64_t *)malloc(len);
+    if (!ix || pread(fd, ix, len, (off_t)fh->index_offset) != (ssize_t)len) {
+        fprintf(stderr, "iqz: cannot read the block index\n");
+        free(ix);
+        return -1;
+    }
+    for (uint32_t b = 0; b < fh->nblocks; b++)
+        if (ix[b + 1] <= ix[b] || ix[b + 1] - ix[b] > sizeof(iq_pack_block_hdr_t) +
+                                                          iq_pack_max_payload(fh->block_frames, fh->lanes)) {
+            fprintf(stderr, "iqz: bad index entry for block %u\n", b);
+            free(ix);
+            return -1;
+        }
+    *index = ix;
+    return 0;
+}
+
+// ---- streaming decoder ----
+
+enum { IQ_PACK_SLOT_IDLE = 0, IQ_PACK_SLOT_QUEUED, IQ_PACK_SLOT_BUSY, IQ_PACK_SLOT_DONE };
+
+typedef struct {
+    int16_t *pcm;
+    uint64_t seq; // block number in the stream; the file block is seq % nblocks with loop
+    int state;
+    long frames; // decoded, -1 = error
+} iq_pack_slot_t;
+
+typedef struct {
+    int fd;
+    iq_pack_file_hdr_t fh;
+    uint64_t *index;
+    bool loop;
+    unsigned window;
+    iq_pack_slot_t slots[IQ_PACK_WINDOW_MAX];
+    int16_t *pcm_mem;
+    uint64_t next_seq;
+    unsigned cur;
+    size_t cur_off; // bytes consumed from slots[cur]
+    bool eof, failed;
+
+    pthread_t th[IQ_PACK_THREADS_MAX];
+    uint8_t *scratch[IQ_PACK_THREADS_MAX]; // one compressed block per worker
+    int nthreads;
+    pthread_mutex_t mu;
+    pthread_cond_t work, done;
+    unsigned queue[IQ_PACK_WINDOW_MAX], q_head, q_len;
+    bool stop;
+
+    uint64_t packed_bytes; // compressed bytes read
+    uint64_t blocks;
+    uint64_t waits; // iq_pack_read() found its block still decoding
+} iq_pack_reader_t;
+
+typedef struct {
+    iq_pack_reader_t *r;
+    int id;
+} iq_pack_worker_arg_t;
+
+static inline uint32_t iq_pack_file_block(const iq_pack_reader_t *r, uint64_t seq) {
+    return (uint32_t)(r->loop ? seq % r->fh.nblocks : seq);
+}
+
+static inline void *iq_pack_worker(void *arg) {
+    iq_pack_reader_t *r = ((iq_pack_worker_arg_t *)arg)->r;
+    uint8_t *scratch = r->scratch[((iq_pack_worker_arg_t *)arg)->id];
+    free(arg);
+    pthread_mutex_lock(&r->mu);
+    for (;;) {
+        while (!r->stop && r->q_len == 0)
+            pthread_cond_wait(&r->work, &r->mu);
+        if (r->stop)
+            break;
+        const unsigned idx = r->queue[r->q_head];
+        r->q_head = (r->q_head + 1) % IQ_PACK_WINDOW_MAX;
+        r->q_len--;
+        iq_pack_slot_t *s = &r->slots[idx];
+        s->state = IQ_PACK_SLOT_BUSY;
+        const uint32_t b = iq_pack_file_block(r, s->seq);
+        pthread_mutex_unlock(&r->mu);
+
+        const size_t len = (size_t)(r->index[b + 1] - r->index[b]);
+        ssize_t got;
+        do
+            got = pread(r->fd, scratch, len, (off_t)r->index[b]);
+        while (got < 0 && errno == EINTR);
+        const size_t want = b + 1 == r->fh.nblocks ? (size_t)(r->fh.frames - (uint64_t)b * r->fh.block_frames)
+                                                   : r->fh.block_frames;
+        long frames = got == (ssize_t)len ? iq_pack_decode_block(scratch, len, r->fh.lanes, want, s->pcm) : -1;
+        if (frames != (long)want)
+            frames = -1;
+
+        pthread_mutex_lock(&r->mu);
+        s->frames = frames;
+        s->state = IQ_PACK_SLOT_DONE;
+        r->packed_bytes += len;
+        pthread_cond_broadcast(&r->done);
+    }
+    pthread_mutex_unlock(&r->mu);
+    return NULL;
+}
+
+static inline void iq_pack_submit(iq_pack_reader_t *r, unsigned idx, uint64_t seq) {
+    pthread_mutex_lock(&r->mu);
+    iq_pack_slot_t *s = &r->slots[idx];
+    s->seq = seq;
+    if (!r->loop && seq >= r->fh.nblocks) {
+        s->state = IQ_PACK_SLOT_IDLE;
+    } else {
+        s->state = IQ_PACK_SLOT_QUEUED;
+        r->queue[(r->q_head + r->q_len) % IQ_PACK_WINDOW_MAX] = idx;
+        r->q_len++;
+        pthread_cond_signal(&r->work);
+    }
+    pthread_mutex_unlock(&r->mu);
+}
+
+static inline void iq_pack_close(iq_pack_reader_t *r) {
+    if (r->nthreads) {
+        pthread_mutex_lock(&r->mu);
+        r->stop = true;
+        pthread_cond_broadcast(&r->work);
+        pthread_mutex_unlock(&r->mu);
+        for (int i = 0; i < r->nthreads; i++)
+            pthread_join(r->th[i], NULL);
+        pthread_mutex_destroy(&r->mu);
+        pthread_cond_destroy(&r->work);
+        pthread_cond_destroy(&r->done);
+    }
+    for (int i = 0; i < IQ_PACK_THREADS_MAX; i++)
+        free(r->scratch[i]);
+    free(r->pcm_mem);
+    free(r->index);
+    if (r->fd >= 0)
+        close(r->fd);
+    memset(r, 0, sizeof(*r));
+    r->fd = -1;
+}
+
+// nthreads <= 0: one per CPU but one (the stream thread keeps its own).
+static inline int iq_pack_open(iq_pack_reader_t *r, const char *path, bool loop, int nthreads) {
+    memset(r, 0, sizeof(*r));
+    r->loop = loop;
+    r->fd = open(path, O_RDONLY);
+    if (r->fd < 0) {
+        fprintf(stderr, "iqz: open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    if (iq_pack_read_index(r->fd, &r->fh, &r->index) || !r->fh.frames) {
+        if (r->index && !r->fh.frames)
+            fprintf(stderr, "iqz: no frames\n");
+        iq_pack_close(r);
+        return -1;
+    }
+    (void)posix_fadvise(r->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    if (nthreads <= 0) {
+        const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = cpus > 1 ? (int)cpus - 1 : 1;
+    }
+    if (nthreads > IQ_PACK_THREADS_MAX)
+        nthreads = IQ_PACK_THREADS_MAX;
+    r->window = (unsigned)(2 * nthreads + 2);
+    if (r->window > IQ_PACK_WINDOW_MAX)
+        r->window = IQ_PACK_WINDOW_MAX;
+
+    const size_t pcm = (size_t)r->fh.block_frames * r->fh.lanes;
+    r->pcm_mem = (int16_t *)aligned_alloc(64, r->window * pcm * sizeof(int16_t));
+    if (!r->pcm_mem) {
+        fprintf(stderr, "iqz: cannot allocate %u decode buffers\n", r->window);
+        iq_pack_close(r);
+        return -1;
+    }
+    for (unsigned i = 0; i < r->window; i++)
+        r->slots[i].pcm = r->pcm_mem + i * pcm;
+
+    pthread_mutex_init(&r->mu, NULL);
+    pthread_cond_init(&r->work, NULL);
+    pthread_cond_init(&r->done, NULL);
+    for (; r->nthreads < nthreads; r->nthreads++) {
+        r->scratch[r->nthreads] =
+            (uint8_t *)malloc(sizeof(iq_pack_block_hdr_t) + iq_pack_max_payload(r->fh.block_frames, r->fh.lanes));
+        iq_pack_worker_arg_t *wa = (iq_pack_worker_arg_t *)malloc(sizeof(*wa));
+        if (!r->scratch[r->nthreads] || !wa) {
+            free(wa);
+            break;
+        }
+        wa->r = r;
+        wa->id = r->nthreads;
+        if (pthread_create(&r->th[r->nthreads], NULL, iq_pack_worker, wa)) {
+            free(wa);
+            break;
+        }
+    }
+    if (!r->nthreads) {
+        fprintf(stderr, "iqz: failed to start decoder threads\n");
+        pthread_mutex_destroy(&r->mu);
+        pthread_cond_destroy(&r->work);
+        pthread_cond_destroy(&r->done);
+        iq_pack_close(r);
+        return -1;
+    }
+    for (unsigned i = 0; i < r->window; i++)
+        iq_pack_submit(r, i, r->next_seq++);
+    return 0;
+}
+
+static inline bool iq_pack_failed(const iq_pack_reader_t *r) { return r->failed; }
+
+// Restart the stream at frame (O(1) through the index). Waits for the blocks in flight first.
+static inline void iq_pack_seek(iq_pack_reader_t *r, uint64_t frame) {
+    pthread_mutex_lock(&r->mu);
+    r->q_len = 0; // queued but not started: just drop them
+    for (unsigned i = 0; i < r->window; i++) {
+        if (r->slots[i].state == IQ_PACK_SLOT_QUEUED)
+            r->slots[i].state = IQ_PACK_SLOT_IDLE;
+        while (r->slots[i].state == IQ_PACK_SLOT_BUSY)
+            pthread_cond_wait(&r->done, &r->mu);
+    }
+    pthread_mutex_unlock(&r->mu);
+    if (frame >= r->fh.frames)
+        frame = r->loop ? frame % r->fh.frames : r->fh.frames;
+    const uint64_t b = frame / r->fh.block_frames;
+    r->next_seq = b;
+    r->cur = 0;
+    r->cur_off = (size_t)(frame - b * r->fh.block_frames) * r->fh.lanes * sizeof(int16_t);
+    r->eof = r->failed = false;
+    for (unsigned i = 0; i < r->window; i++)
+        iq_pack_submit(r, i, r->next_seq++);
+}
+
+// Copy up to want bytes of decoded interleaved int16 into dst, fread() style (see the top).
+static inline size_t iq_pack_read(iq_pack_reader_t *r, void *dst, size_t want) {
+    uint8_t *out = (uint8_t *)dst;
+    size_t got = 0;
+    while (got < want && !r->eof && !r->failed) {
+        iq_pack_slot_t *s = &r->slots[r->cur];
+        pthread_mutex_lock(&r->mu);
+        if (s->state == IQ_PACK_SLOT_QUEUED || s->state == IQ_PACK_SLOT_BUSY)
+            r->waits++;
+        while (s->state == IQ_PACK_SLOT_QUEUED || s->state == IQ_PACK_SLOT_BUSY)
+            pthread_cond_wait(&r->done, &r->mu);
+        const int state = s->state;
+        pthread_mutex_unlock(&r->mu);
+        if (state == IQ_PACK_SLOT_IDLE) {
+            r->eof = true;
+            break;
+        }
+        if (s->frames < 0) {
+            fprintf(stderr, "iqz: block %u is corrupt\n", iq_pack_file_block(r, s->seq));
+            r->failed = true;
+            break;
+        }
+
+        const size_t end = (size_t)s->frames * r->fh.lanes * sizeof(int16_t);
+        if (r->cur_off < end) {
+            size_t n = end - r->cur_off;
+            if (n > want - got)
+                n = want - got;
+            memcpy(out + got, (const uint8_t *)s->pcm + r->cur_off, n);
+            r->cur_off += n;
+            got += n;
+            continue;
+        }
+
+        const bool last = iq_pack_file_block(r, s->seq) + 1 == r->fh.nblocks;
+        r->blocks++;
+        iq_pack_submit(r, r->cur, r->next_seq++);
+        r->cur = (r->cur + 1) % r->window;
+        r->cur_off = 0;
+        if (last && (got || !r->loop)) {
+            r->eof = !r->loop;
+            break;
+        }
+    }
+    return got;
+}
+
+#endif
@@ -0,0 +1,299 @@
+// Converts 16-bit I/Q WAVs (2 or 4 channels) to the block-compressed .iqz container that
+// tx_wav_I16bit --file accepts directly, and back. Blocks are encoded on every core.
+//
+// ./iq_pack_wav --in capture.wav --out capture.iqz [--block-frames 65536] [--threads 0]
+// ./iq_pack_wav --unpack --in capture.iqz --out capture.wav
+#include "iq_pack.h"
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BATCH_PER_THREAD 4
+
+typedef struct {
+    uint32_t sample_rate;
+    uint16_t channels;
+    uint64_t data_offset;
+    uint64_t data_bytes;
+} wav_in_t;
+
+static uint32_t le32(const uint8_t *p) { return (uint32_t)p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24; }
+static uint16_t le16(const uint8_t *p) { return (uint16_t)(p[0] | p[1] << 8); }
+
+static bool parse_wav(FILE *f, wav_in_t *wi) {
+    memset(wi, 0, sizeof(*wi));
+    uint8_t h[12];
+    if (fread(h, 1, 12, f) != 12 || memcmp(h, "RIFF", 4) || memcmp(h + 8, "WAVE", 4)) {
+        fprintf(stderr, "not a RIFF/WAVE file\n");
+        return false;
+    }
+    bool got_fmt = false;
+    uint16_t format = 0, bits = 0;
+    for (;;) {
+        if (fread(h, 1, 8, f) != 8) {
+            fprintf(stderr, "WAV: missing %s chunk\n", got_fmt ? "data" : "fmt ");
+            return false;
+        }
+        const uint32_t size = le32(h + 4);
+        if (!memcmp(h, "fmt ", 4)) {
+            uint8_t fmt[16];
+            if (size < 16 || fread(fmt, 1, 16, f) != 16) {
+                fprintf(stderr, "WAV: short fmt chunk\n");
+                return false;
+            }
+            format = le16(fmt);
+            wi->channels = le16(fmt + 2);
+            wi->sample_rate = le32(fmt + 4);
+            bits = le16(fmt + 14);
+            fseeko(f, (off_t)(size - 16 + (size & 1)), SEEK_CUR);
+            got_fmt = true;
+        } else if (!memcmp(h, "data", 4) && got_fmt) {
+            wi->data_offset = (uint64_t)ftello(f);
+            wi->data_bytes = size;
+            break;
+        } else {
+            fseeko(f, (off_t)(size + (size & 1)), SEEK_CUR);
+        }
+    }
+    if (!(format == 1 || format == 0xFFFE) || bits != 16 || (wi->channels != 2 && wi->channels != 4)) {
+        fprintf(stderr, "WAV: need 16-bit PCM with 2 or 4 channels; got format 0x%04x, %u ch, %u bits\n", format,
+                wi->channels, bits);
+        return false;
+    }
+    return true;
+}
+
+typedef struct {
+    const int16_t *in;
+    size_t frames;
+    unsigned lanes;
+    uint8_t *out;
+    size_t out_bytes;
+} job_t;
+
+typedef struct {
+    job_t *jobs;
+    size_t njobs;
+    size_t first, step;
+} worker_t;
+
+static void *encode_worker(void *arg) {
+    worker_t *w = (worker_t *)arg;
+    for (size_t j = w->first; j < w->njobs; j += w->step)
+        w->jobs[j].out_bytes = iq_pack_encode_block(w->jobs[j].in, w->jobs[j].frames, w->jobs[j].lanes, w->jobs[j].out);
+    return NULL;
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int pack(const char *in_path, const char *out_path, uint32_t block_frames, int nthreads) {
+    FILE *in = fopen(in_path, "rb");
+    if (!in) {
+        fprintf(stderr, "open %s: %s\n", in_path, strerror(errno));
+        return 1;
+    }
+    wav_in_t wi;
+    if (!parse_wav(in, &wi)) {
+        fclose(in);
+        return 1;
+    }
+    FILE *out = fopen(out_path, "wb");
+    if (!out) {
+        fprintf(stderr, "create %s: %s\n", out_path, strerror(errno));
+        fclose(in);
+        return 1;
+    }
+
+    iq_pack_file_hdr_t fh;
+    memset(&fh, 0, sizeof(fh));
+    memcpy(fh.magic, IQ_PACK_MAGIC, 4);
+    fh.version = IQ_PACK_VERSION;
+    fh.lanes = wi.channels;
+    fh.sample_rate = wi.sample_rate;
+    fh.frames = wi.data_bytes / (fh.lanes * sizeof(int16_t));
+    fh.block_frames = block_frames;
+    fh.nblocks = (uint32_t)((fh.frames + block_frames - 1) / block_frames);
+
+    const size_t batch = (size_t)nthreads * BATCH_PER_THREAD;
+    const size_t raw_block = iq_pack_max_payload(block_frames, fh.lanes);
+    const size_t out_block = sizeof(iq_pack_block_hdr_t) + raw_block;
+    int16_t *raw = (int16_t *)malloc(batch * raw_block);
+    uint8_t *enc = (uint8_t *)malloc(batch * out_block);
+    uint64_t *index = (uint64_t *)malloc(((size_t)fh.nblocks + 1) * sizeof(uint64_t));
+    job_t *jobs = (job_t *)calloc(batch, sizeof(job_t));
+    worker_t *ws = (worker_t *)calloc((size_t)nthreads, sizeof(worker_t));
+    pthread_t *th = (pthread_t *)calloc((size_t)nthreads, sizeof(pthread_t));
+    int rc = 1;
+    if (!raw || !enc || !index || !jobs || !ws || !th) {
+        fprintf(stderr, "malloc failed\n");
+        goto done;
+    }
+    if (fwrite(&fh, sizeof(fh), 1, out) != 1)
+        goto write_error;
+
+    uint64_t codec_blocks[IQ_PACK_NCODECS] = {0};
+    uint64_t pos = sizeof(fh), frames_left = fh.frames;
+    uint32_t b = 0;
+    const double t0 = now_s();
+    fseeko(in, (off_t)wi.data_offset, SEEK_SET);
+    while (b < fh.nblocks) {
+        size_t nj = 0;
+        for (; nj < batch && b + nj < fh.nblocks; nj++) {
+            const size_t frames = frames_left < block_frames ? (size_t)frames_left : block_frames;
+            frames_left -= frames;
+            jobs[nj] = (job_t){raw + nj * raw_block / sizeof(int16_t), frames, fh.lanes, enc + nj * out_block, 0};
+            if (fread((void *)jobs[nj].in, fh.lanes * sizeof(int16_t), frames, in) != frames) {
+                fprintf(stderr, "%s: short read in the data chunk\n", in_path);
+                goto done;
+            }
+        }
+        int started = 0;
+        for (; started < nthreads && (size_t)started < nj; started++) {
+            ws[started] = (worker_t){jobs, nj, (size_t)started, (size_t)nthreads};
+            if (pthread_create(&th[started], NULL, encode_worker, &ws[started]))
+                break;
+        }
+        for (int t = 0; t < started; t++)
+            pthread_join(th[t], NULL);
+        for (size_t j = 0; j < nj; j++) // jobs of a worker that did not start: encode here
+            if (j % (size_t)nthreads >= (size_t)started)
+                jobs[j].out_bytes = iq_pack_encode_block(jobs[j].in, jobs[j].frames, fh.lanes, jobs[j].out);
+        for (size_t j = 0; j < nj; j++, b++) {
+            index[b] = pos;
+            if (fwrite(jobs[j].out, 1, jobs[j].out_bytes, out) != jobs[j].out_bytes)
+                goto write_error;
+            pos += jobs[j].out_bytes;
+            codec_blocks[((const iq_pack_block_hdr_t *)jobs[j].out)->codec]++;
+        }
+    }
+    index[fh.nblocks] = pos;
+    fh.index_offset = pos;
+    if (fwrite(index, sizeof(uint64_t), (size_t)fh.nblocks + 1, out) != (size_t)fh.nblocks + 1)
+        goto write_error;
+    if (fseeko(out, 0, SEEK_SET) || fwrite(&fh, sizeof(fh), 1, out) != 1 || fflush(out))
+        goto write_error;
+
+    const double dt = now_s() - t0;
+    const uint64_t raw_bytes = fh.frames * fh.lanes * sizeof(int16_t);
+    printf("%" PRIu64 " frames, %u blocks of %u: %.1f MB -> %.1f MB (%.2fx) in %.1f s (%.0f MB/s raw)\n", fh.frames,
+           fh.nblocks, block_frames, (double)raw_bytes / 1e6, (double)pos / 1e6,
+           pos ? (double)raw_bytes / (double)pos : 0.0, dt, dt > 0 ? (double)raw_bytes / dt / 1e6 : 0.0);
+    printf("blocks:");
+    for (int c = 0; c < IQ_PACK_NCODECS; c++)
+        printf(" %s=%" PRIu64, iq_pack_codec_name(c), codec_blocks[c]);
+    printf("\n");
+    rc = 0;
+    goto done;
+
+write_error:
+    fprintf(stderr, "write %s: %s\n", out_path, strerror(errno));
+done:
+    if (fclose(out) && !rc) {
+        fprintf(stderr, "write %s: %s\n", out_path, strerror(errno));
+        rc = 1;
+    }
+    if (rc)
+        unlink(out_path);
+    fclose(in);
+    free(raw);
+    free(enc);
+    free(index);
+    free(jobs);
+    free(ws);
+    free(th);
+    return rc;
+}
+
+static void put_le32(uint8_t *p, uint32_t v) {
+    for (int i = 0; i < 4; i++)
+        p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static int unpack(const char *in_path, const char *out_path, int nthreads) {
+    iq_pack_reader_t r;
+    if (iq_pack_open(&r, in_path, false, nthreads))
+        return 1;
+    FILE *out = fopen(out_path, "wb");
+    if (!out) {
+        fprintf(stderr, "create %s: %s\n", out_path, strerror(errno));
+        iq_pack_close(&r);
+        return 1;
+    }
+    const uint64_t data = r.fh.frames * r.fh.lanes * sizeof(int16_t);
+    if (data > 0xFFFFFFFFull - 36)
+        fprintf(stderr, "WARN: %" PRIu64 " bytes of data do not fit a RIFF size field\n", data);
+    uint8_t h[44];
+    memcpy(h, "RIFF", 4);
+    put_le32(h + 4, (uint32_t)(36 + data));
+    memcpy(h + 8, "WAVEfmt ", 8);
+    put_le32(h + 16, 16);
+    put_le32(h + 20, 1 | r.fh.lanes << 16); // PCM, channels
+    put_le32(h + 24, r.fh.sample_rate);
+    put_le32(h + 28, r.fh.sample_rate * r.fh.lanes * 2);
+    put_le32(h + 32, (r.fh.lanes * 2) | 16u << 16); // block align, bits
+    memcpy(h + 36, "data", 4);
+    put_le32(h + 40, (uint32_t)data);
+
+    int rc = fwrite(h, 1, sizeof(h), out) == sizeof(h) ? 0 : 1;
+    uint8_t buf[1 << 16];
+    uint64_t written = 0;
+    for (size_t n; !rc && (n = iq_pack_read(&r, buf, sizeof(buf))) > 0; written += n)
+        if (fwrite(buf, 1, n, out) != n)
+            rc = 1;
+    if (rc)
+        fprintf(stderr, "write %s: %s\n", out_path, strerror(errno));
+    if (!rc && (iq_pack_failed(&r) || written != data)) {
+        fprintf(stderr, "%s: decoded %" PRIu64 " of %" PRIu64 " bytes\n", in_path, written, data);
+        rc = 1;
+    }
+    if (fclose(out) && !rc) {
+        fprintf(stderr, "write %s: %s\n", out_path, strerror(errno));
+        rc = 1;
+    }
+    if (!rc)
+        printf("%" PRIu64 " frames (%u ch, %u Hz) written to %s\n", r.fh.frames, r.fh.lanes, r.fh.sample_rate,
+               out_path);
+    iq_pack_close(&r);
+    return rc;
+}
+
+int main(int argc, char **argv) {
+    const char *IN = NULL, *OUT = NULL;
+    bool UNPACK = false;
+    long BLOCK_FRAMES = IQ_PACK_BLOCK_FRAMES_DEF;
+    int THREADS = 0; // 0 = one per CPU
+
+    // clang-format off
+    for (int i=1; i<argc; i++){
+        const char* a = argv[i];
+        #define NEEDVAL() do{ if (i+1>=argc){ fprintf(stderr,"missing value for %s\n", a); return 1; } }while(0)
+
+        if (!strcmp(a,"--in")){ NEEDVAL(); IN = argv[++i]; continue; }
+        if (!strcmp(a,"--out")){ NEEDVAL(); OUT = argv[++i]; continue; }
+        if (!strcmp(a,"--unpack")){ UNPACK = true; continue; }
+        if (!strcmp(a,"--block-frames")){ NEEDVAL(); BLOCK_FRAMES = strtol(argv[++i], NULL, 0); if (BLOCK_FRAMES<1024 || BLOCK_FRAMES>(1<<20)){ fprintf(stderr,"bad --block-frames (1024..1048576)\n"); return 1; } continue; }
+        if (!strcmp(a,"--threads")){ NEEDVAL(); THREADS = (int)strtol(argv[++i], NULL, 0); if (THREADS<0 || THREADS>IQ_PACK_THREADS_MAX){ fprintf(stderr,"bad --threads (0..%d)\n", IQ_PACK_THREADS_MAX); return 1; } continue; }
+
+        fprintf(stderr,"unknown option: %s\n", a);
+        return 1;
+    }
+    if (!IN || !OUT){ fprintf(stderr,"usage: %s [--unpack] --in <file> --out <file> [--block-frames n] [--threads n]\n", argv[0]); return 1; }
+    // clang-format on
+
+    if (THREADS == 0) {
+        const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        THREADS = cpus < 1 ? 1 : (cpus > IQ_PACK_THREADS_MAX ? IQ_PACK_THREADS_MAX : (int)cpus);
+    }
+    return UNPACK ? unpack(IN, OUT, THREADS) : pack(IN, OUT, (uint32_t)BLOCK_FRAMES, THREADS);
+}
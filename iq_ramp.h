@@ -0,0 +1,234 @@
+#ifndef IQ_RAMP_H
+#define IQ_RAMP_H
+
+// Per-sample digital gain envelope for interleaved int16 I/Q.
+// The envelope is linear in dB or a raised cosine in amplitude. Gains are generated per frame
+// with a recurrence (resynced exactly at every chunk start) and applied with an element-wise
+// saturating Q15 multiply, so the analog gain can stay fixed and no SPI traffic is needed.
+
+#include "iq_scale.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define IQ_RAMP_MUTE_DB (-90.0) // at or below this level the output is exact zero
+#define IQ_RAMP_DB_FLOOR (-80.0) // linear-in-dB ramps to mute start/end here
+
+typedef enum { IQ_RAMP_OFF = 0, IQ_RAMP_DB, IQ_RAMP_COS } iq_ramp_shape_t;
+
+typedef void (*iq_mul_fn)(int16_t *dst, const int16_t *src, const int16_t *g, size_t n);
+
+typedef struct {
+    iq_ramp_shape_t shape;
+    double from_db, to_db;
+    uint64_t len; // frames
+    uint64_t pos; // frames already produced
+    int16_t *gains; // 2 * cap Q15 gains (I and Q share a value)
+    size_t cap;
+    iq_mul_fn mul;
+    iq_scale_fn scale_fn;
+} iq_ramp_t;
+
+static inline bool iq_ramp_parse_shape(const char *s, iq_ramp_shape_t *out) {
+    if (!strcasecmp(s, "off") || !strcasecmp(s, "0"))
+        *out = IQ_RAMP_OFF;
+    else if (!strcasecmp(s, "db"))
+        *out = IQ_RAMP_DB;
+    else if (!strcasecmp(s, "cos"))
+        *out = IQ_RAMP_COS;
+    else
+        return false;
+    return true;
+}
+
+static inline const char *iq_ramp_shape_name(iq_ramp_shape_t s) {
+    return s == IQ_RAMP_DB ? "db" : (s == IQ_RAMP_COS ? "cos" : "off");
+}
+
+static inline double iq_ramp_amp(double db) { return db <= IQ_RAMP_MUTE_DB ? 0.0 : pow(10.0, db / 20.0); }
+
+static inline int16_t iq_ramp_q15(double a) {
+    long v = lround(a * 32768.0);
+    return (int16_t)(v > 32767 ? 32767 : (v < 0 ? 0 : v));
+}
+
+static inline void iq_mul_q15_c(int16_t *dst, const int16_t *src, const int16_t *g, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        dst[i] = iq_sat16(((int32_t)src[i] * g[i] + (1 << 14)) >> 15);
+}
+
+#ifdef IQ_SCALE_X86
+__attribute__((target("sse2"))) static inline void iq_mul_q15_sse2(int16_t *dst, const int16_t *src,
+                                                                   const int16_t *g, size_t n) {
+    const __m128i rnd = _mm_set1_epi32(1 << 14);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i gv = _mm_loadu_si128((const __m128i *)(g + i));
+        __m128i lo = _mm_mullo_epi16(x, gv);
+        __m128i hi = _mm_mulhi_epi16(x, gv);
+        __m128i p0 = _mm_srai_epi32(_mm_add_epi32(_mm_unpacklo_epi16(lo, hi), rnd), 15);
+        __m128i p1 = _mm_srai_epi32(_mm_add_epi32(_mm_unpackhi_epi16(lo, hi), rnd), 15);
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packs_epi32(p0, p1));
+    }
+    iq_mul_q15_c(dst + i, src + i, g + i, n - i);
+}
+
+__attribute__((target("avx2"))) static inline void iq_mul_q15_avx2(int16_t *dst, const int16_t *src,
+                                                                   const int16_t *g, size_t n) {
+    const __m256i rnd = _mm256_set1_epi32(1 << 14);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(src + i));
+        __m256i gv = _mm256_loadu_si256((const __m256i *)(g + i));
+        __m256i lo = _mm256_mullo_epi16(x, gv);
+        __m256i hi = _mm256_mulhi_epi16(x, gv);
+        __m256i p0 = _mm256_srai_epi32(_mm256_add_epi32(_mm256_unpacklo_epi16(lo, hi), rnd), 15);
+        __m256i p1 = _mm256_srai_epi32(_mm256_add_epi32(_mm256_unpackhi_epi16(lo, hi), rnd), 15);
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_packs_epi32(p0, p1));
+    }
+    iq_mul_q15_sse2(dst + i, src + i, g + i, n - i);
+}
+#endif
+
+#ifdef IQ_SCALE_NEON
+static inline void iq_mul_q15_neon(int16_t *dst, const int16_t *src, const int16_t *g, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        int16x8_t x = vld1q_s16(src + i);
+        int16x8_t gv = vld1q_s16(g + i);
+        int32x4_t p0 = vrshrq_n_s32(vmull_s16(vget_low_s16(x), vget_low_s16(gv)), 15);
+        int32x4_t p1 = vrshrq_n_s32(vmull_s16(vget_high_s16(x), vget_high_s16(gv)), 15);
+        vst1q_s16(dst + i, vcombine_s16(vqmovn_s32(p0), vqmovn_s32(p1)));
+    }
+    iq_mul_q15_c(dst + i, src + i, g + i, n - i);
+}
+#endif
+
+static inline iq_mul_fn iq_mul_select(void) {
+#ifdef IQ_SCALE_X86
+    if (__builtin_cpu_supports("avx2"))
+        return iq_mul_q15_avx2;
+    return iq_mul_q15_sse2;
+#elif defined(IQ_SCALE_NEON)
+    return iq_mul_q15_neon;
+#else
+    return iq_mul_q15_c;
+#endif
+}
+
+static inline int iq_ramp_init(iq_ramp_t *r, size_t max_frames) {
+    memset(r, 0, sizeof(*r));
+    r->gains = (int16_t *)aligned_alloc(64, ((2 * max_frames * sizeof(int16_t) + 63) / 64) * 64);
+    if (!r->gains)
+        return -1;
+    r->cap = max_frames;
+    r->mul = iq_mul_select();
+    r->scale_fn = iq_scale_select(NULL);
+    return 0;
+}
+
+static inline void iq_ramp_free(iq_ramp_t *r) {
+    free(r->gains);
+    memset(r, 0, sizeof(*r));
+}
+
+// Start a ramp from from_db to to_db (dB relative to full scale, 0 = unity) over len frames.
+static inline void iq_ramp_begin(iq_ramp_t *r, iq_ramp_shape_t shape, double from_db, double to_db, uint64_t len) {
+    r->shape = shape == IQ_RAMP_OFF ? IQ_RAMP_COS : shape;
+    r->from_db = from_db;
+    r->to_db = to_db;
+    r->len = len;
+    r->pos = 0;
+}
+
+static inline bool iq_ramp_active(const iq_ramp_t *r) { return r->pos < r->len; }
+
+// Level in dB at frame pos of the current ramp.
+static inline double iq_ramp_level_db(const iq_ramp_t *r) {
+    if (r->len == 0 || r->pos >= r->len)
+        return r->to_db;
+    const double t = (double)r->pos / (double)r->len;
+    if (r->shape == IQ_RAMP_DB) {
+        double a = r->from_db < IQ_RAMP_DB_FLOOR ? IQ_RAMP_DB_FLOOR : r->from_db;
+        double b = r->to_db < IQ_RAMP_DB_FLOOR ? IQ_RAMP_DB_FLOOR : r->to_db;
+        return a + (b - a) * t;
+    }
+    const double a0 = iq_ramp_amp(r->from_db), a1 = iq_ramp_amp(r->to_db);
+    const double a = a0 + (a1 - a0) * 0.5 * (1.0 - cos(M_PI * t));
+    return a > 0.0 ? 20.0 * log10(a) : IQ_RAMP_MUTE_DB;
+}
+
+// Apply the envelope to frames I/Q frames (dst may equal src) and advance the ramp.
+// Once the ramp is done the final level is held: unity is a copy, mute is zeros.
+static inline void iq_ramp_apply(iq_ramp_t *r, int16_t *dst, const int16_t *src, size_t frames) {
+    while (frames > 0) {
+        size_t n = frames < r->cap ? frames : r->cap;
+
+        if (!iq_ramp_active(r)) {
+            if (r->to_db >= 0.0) {
+                if (dst != src)
+                    memcpy(dst, src, 2 * n * sizeof(int16_t));
+            } else if (r->to_db <= IQ_RAMP_MUTE_DB) {
+                memset(dst, 0, 2 * n * sizeof(int16_t));
+            } else {
+                iq_scale_q_t q;
+                iq_scale_q_init(&q, iq_ramp_amp(r->to_db));
+                r->scale_fn(dst, src, 2 * n, &q);
+            }
+        } else {
+            const uint64_t left = r->len - r->pos;
+            const size_t nr = left < n ? (size_t)left : n;
+            const double t0 = (double)r->pos / (double)r->len;
+            const double dt = 1.0 / (double)r->len;
+
+            if (r->shape == IQ_RAMP_DB) {
+                // geometric recurrence: amplitude changes by a constant factor per frame
+                double a = iq_ramp_amp(iq_ramp_level_db(r));
+                double b0 = r->from_db < IQ_RAMP_DB_FLOOR ? IQ_RAMP_DB_FLOOR : r->from_db;
+                double b1 = r->to_db < IQ_RAMP_DB_FLOOR ? IQ_RAMP_DB_FLOOR : r->to_db;
+                const double k = pow(10.0, (b1 - b0) * dt / 20.0);
+                for (size_t i = 0; i < nr; i++) {
+                    int16_t g = iq_ramp_q15(a);
+                    r->gains[2 * i] = g;
+                    r->gains[2 * i + 1] = g;
+                    a *= k;
+                }
+            } else {
+                // rotate (cos, sin) of pi*t by pi*dt per frame
+                const double a0 = iq_ramp_amp(r->from_db), a1 = iq_ramp_amp(r->to_db);
+                double c = cos(M_PI * t0), s = sin(M_PI * t0);
+                const double cd = cos(M_PI * dt), sd = sin(M_PI * dt);
+                for (size_t i = 0; i < nr; i++) {
+                    int16_t g = iq_ramp_q15(a0 + (a1 - a0) * 0.5 * (1.0 - c));
+                    r->gains[2 * i] = g;
+                    r->gains[2 * i + 1] = g;
+                    const double c2 = c * cd - s * sd;
+                    s = s * cd + c * sd;
+                    c = c2;
+                }
+            }
+            r->pos += nr;
+
+            const int16_t hold = r->to_db <= IQ_RAMP_MUTE_DB ? 0 : iq_ramp_q15(iq_ramp_amp(r->to_db));
+            for (size_t i = nr; i < n; i++) {
+                r->gains[2 * i] = hold;
+                r->gains[2 * i + 1] = hold;
+            }
+            r->mul(dst, src, r->gains, 2 * n);
+        }
+
+        dst += 2 * n;
+        src += 2 * n;
+        frames -= n;
+    }
+}
+
+#endif
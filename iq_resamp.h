@@ -0,0 +1,362 @@
+#ifndef IQ_RESAMP_H
+#define IQ_RESAMP_H
+
+// Streaming rational (L/M) polyphase FIR resampler for interleaved int16 I/Q.
+// A Kaiser-windowed sinc prototype of taps*L coefficients is split into L Q15 banks of `taps`
+// each (stored reversed, every bank normalised to unity DC gain), so an output sample is one
+// contiguous int16 dot product per lane against the input history. Lanes are the int16 of a
+// frame (2 for I/Q, 4 for I_A Q_A I_B Q_B) and are kept deinterleaved in the history.
+// Output sample n sits at input position (ph0 + n*M) / L with phase (ph0 + n*M) % L, so a chunk
+// splits into independent output ranges; large chunks are shared with worker threads.
+
+#include "iq_scale.h"
+#include <inttypes.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define IQ_RESAMP_TAPS_DEF 32           // per phase; must be a multiple of 16
+#define IQ_RESAMP_MAX_PHASES 65536      // L limit (taps * L int16 of coefficients)
+#define IQ_RESAMP_MAX_LANES 4
+#define IQ_RESAMP_MAX_THREADS 8
+#define IQ_RESAMP_MT_MIN_MACS (1u << 18) // below this per chunk, threads cost more than they save
+#define IQ_RESAMP_KAISER_BETA 8.6        // ~ 90 dB stopband
+
+typedef int32_t (*iq_dot_fn)(const int16_t *x, const int16_t *h, size_t n);
+
+struct iq_resamp;
+
+typedef struct {
+    struct iq_resamp *r;
+    pthread_t th;
+    int id;
+} iq_resamp_worker_t;
+
+typedef struct iq_resamp {
+    unsigned L, M;
+    size_t taps;
+    size_t lanes;
+    int16_t *bank; // L * taps, bank[ph * taps + j] pairs with history[idx + j]
+    iq_dot_fn dot;
+    const char *kernel;
+
+    // history: each lane holds taps-1 old frames followed by the current chunk
+    int16_t *hist[IQ_RESAMP_MAX_LANES];
+    size_t hist_cap; // frames per lane
+    uint64_t idx;    // input index (relative to the current chunk) of the next output
+    unsigned ph;     // phase of the next output
+
+    // per-chunk job, read by the workers
+    int16_t *job_out;
+    size_t job_out_n;
+    uint64_t job_idx;
+    unsigned job_ph;
+
+    int nthreads; // including the caller
+    iq_resamp_worker_t workers[IQ_RESAMP_MAX_THREADS];
+    pthread_mutex_t mu;
+    pthread_cond_t cv, done_cv;
+    uint64_t gen;
+    int pending;
+    bool stop;
+} iq_resamp_t;
+
+static inline int32_t iq_dot_c(const int16_t *x, const int16_t *h, size_t n) {
+    int32_t acc = 0;
+    for (size_t i = 0; i < n; i++)
+        acc += (int32_t)x[i] * h[i];
+    return acc;
+}
+
+#ifdef IQ_SCALE_X86
+__attribute__((target("sse2"))) static inline int32_t iq_dot_sse2(const int16_t *x, const int16_t *h, size_t n) {
+    __m128i acc = _mm_setzero_si128();
+    for (size_t i = 0; i < n; i += 8)
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_loadu_si128((const __m128i *)(x + i)),
+                                                _mm_loadu_si128((const __m128i *)(h + i))));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(acc);
+}
+
+__attribute__((target("avx2"))) static inline int32_t iq_dot_avx2(const int16_t *x, const int16_t *h, size_t n) {
+    __m256i acc = _mm256_setzero_si256();
+    for (size_t i = 0; i < n; i += 16)
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_loadu_si256((const __m256i *)(x + i)),
+                                                      _mm256_loadu_si256((const __m256i *)(h + i))));
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(s);
+}
+#endif
+
+#ifdef IQ_SCALE_NEON
+static inline int32_t iq_dot_neon(const int16_t *x, const int16_t *h, size_t n) {
+    int32x4_t acc = vdupq_n_s32(0);
+    for (size_t i = 0; i < n; i += 8) {
+        int16x8_t a = vld1q_s16(x + i), b = vld1q_s16(h + i);
+        acc = vmlal_s16(acc, vget_low_s16(a), vget_low_s16(b));
+        acc = vmlal_s16(acc, vget_high_s16(a), vget_high_s16(b));
+    }
+    return vaddvq_s32(acc);
+}
+#endif
+
+static inline iq_dot_fn iq_dot_select(const char **name) {
+    const char *n = "c";
+    iq_dot_fn fn = iq_dot_c;
+#ifdef IQ_SCALE_X86
+    if (__builtin_cpu_supports("avx2")) {
+        n = "avx2";
+        fn = iq_dot_avx2;
+    } else if (__builtin_cpu_supports("sse2")) {
+        n = "sse2";
+        fn = iq_dot_sse2;
+    }
+#elif defined(IQ_SCALE_NEON)
+    n = "neon";
+    fn = iq_dot_neon;
+#endif
+    if (name)
+        *name = n;
+    return fn;
+}
+
+static inline uint64_t iq_resamp_gcd(uint64_t a, uint64_t b) {
+    while (b) {
+        uint64_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+static inline double iq_resamp_bessel_i0(double x) {
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 50; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < 1e-12 * sum)
+            break;
+    }
+    return sum;
+}
+
+static inline int iq_resamp_design(iq_resamp_t *r) {
+    const size_t n = r->taps * r->L;
+    double *proto = (double *)malloc(n * sizeof(double));
+    r->bank = (int16_t *)aligned_alloc(64, ((n * sizeof(int16_t) + 63) / 64) * 64);
+    if (!proto || !r->bank) {
+        free(proto);
+        return -1;
+    }
+    // cutoff at 45% of the lower of the two rates, in cycles per upsampled sample
+    const double fc = 0.45 / (double)(r->L > r->M ? r->L : r->M);
+    const double mid = (double)(n - 1) / 2.0;
+    const double i0b = iq_resamp_bessel_i0(IQ_RESAMP_KAISER_BETA);
+    for (size_t k = 0; k < n; k++) {
+        const double t = (double)k - mid;
+        const double sinc = t == 0.0 ? 2.0 * fc : sin(2.0 * M_PI * fc * t) / (M_PI * t);
+        const double w = (2.0 * (double)k) / (double)(n - 1) - 1.0;
+        proto[k] = sinc * iq_resamp_bessel_i0(IQ_RESAMP_KAISER_BETA * sqrt(fmax(0.0, 1.0 - w * w))) / i0b;
+    }
+    for (unsigned ph = 0; ph < r->L; ph++) {
+        double sum = 0.0;
+        for (size_t j = 0; j < r->taps; j++)
+            sum += proto[ph + j * r->L];
+        const double g = sum != 0.0 ? 1.0 / sum : 0.0;
+        // reversed: tap j (applied to x[idx - j]) goes to bank[taps - 1 - j]
+        for (size_t j = 0; j < r->taps; j++) {
+            long q = lround(proto[ph + j * r->L] * g * 32768.0);
+            q = q > 32767 ? 32767 : (q < -32768 ? -32768 : q);
+            r->bank[(size_t)ph * r->taps + (r->taps - 1 - j)] = (int16_t)q;
+        }
+    }
+    free(proto);
+    return 0;
+}
+
+// Outputs [from, to) of the current job.
+static inline void iq_resamp_run(iq_resamp_t *r, size_t from, size_t to) {
+    for (size_t n = from; n < to; n++) {
+        const uint64_t pos = (uint64_t)r->job_ph + (uint64_t)n * r->M;
+        const size_t idx = (size_t)(r->job_idx + pos / r->L);
+        const int16_t *h = r->bank + (size_t)(pos % r->L) * r->taps;
+        for (size_t l = 0; l < r->lanes; l++)
+            r->job_out[n * r->lanes + l] = iq_sat16((r->dot(r->hist[l] + idx, h, r->taps) + (1 << 14)) >> 15);
+    }
+}
+
+static inline void iq_resamp_slice(const iq_resamp_t *r, int id, size_t *from, size_t *to) {
+    *from = r->job_out_n * (size_t)id / (size_t)r->nthreads;
+    *to = r->job_out_n * (size_t)(id + 1) / (size_t)r->nthreads;
+}
+
+static inline void *iq_resamp_thread(void *arg) {
+    iq_resamp_worker_t *w = (iq_resamp_worker_t *)arg;
+    iq_resamp_t *r = w->r;
+    uint64_t seen = 0;
+    pthread_mutex_lock(&r->mu);
+    for (;;) {
+        while (!r->stop && r->gen == seen)
+            pthread_cond_wait(&r->cv, &r->mu);
+        if (r->stop)
+            break;
+        seen = r->gen;
+        pthread_mutex_unlock(&r->mu);
+
+        size_t from, to;
+        iq_resamp_slice(r, w->id, &from, &to);
+        iq_resamp_run(r, from, to);
+
+        pthread_mutex_lock(&r->mu);
+        if (--r->pending == 0)
+            pthread_cond_signal(&r->done_cv);
+    }
+    pthread_mutex_unlock(&r->mu);
+    return NULL;
+}
+
+static inline void iq_resamp_free(iq_resamp_t *r) {
+    if (r->nthreads > 1) {
+        pthread_mutex_lock(&r->mu);
+        r->stop = true;
+        pthread_cond_broadcast(&r->cv);
+        pthread_mutex_unlock(&r->mu);
+        for (int i = 1; i < r->nthreads; i++)
+            pthread_join(r->workers[i].th, NULL);
+        pthread_cond_destroy(&r->cv);
+        pthread_cond_destroy(&r->done_cv);
+        pthread_mutex_destroy(&r->mu);
+    }
+    for (size_t l = 0; l < IQ_RESAMP_MAX_LANES; l++)
+        free(r->hist[l]);
+    free(r->bank);
+    memset(r, 0, sizeof(*r));
+}
+
+// in_rate -> out_rate for frames of `lanes` int16, taking at most max_in frames per call.
+// nthreads <= 0 uses one thread per online CPU (capped at IQ_RESAMP_MAX_THREADS).
+static inline int iq_resamp_init(iq_resamp_t *r, double in_rate, double out_rate, size_t lanes, size_t taps,
+                                 size_t max_in, int nthreads) {
+    memset(r, 0, sizeof(*r));
+    const uint64_t in = (uint64_t)llround(in_rate), out = (uint64_t)llround(out_rate);
+    if (!in || !out || lanes < 1 || lanes > IQ_RESAMP_MAX_LANES || taps < 16 || taps % 16) {
+        fprintf(stderr, "resampler: bad parameters\n");
+        return -1;
+    }
+    const uint64_t g = iq_resamp_gcd(in, out);
+    if (out / g > IQ_RESAMP_MAX_PHASES) {
+        fprintf(stderr, "resampler: %" PRIu64 " -> %" PRIu64 " Hz needs L=%" PRIu64 " phases (max %d)\n", in, out,
+                out / g, IQ_RESAMP_MAX_PHASES);
+        return -1;
+    }
+    r->L = (unsigned)(out / g);
+    r->M = (unsigned)(in / g);
+    r->taps = taps;
+    r->lanes = lanes;
+    r->dot = iq_dot_select(&r->kernel);
+    r->hist_cap = taps - 1 + max_in;
+    r->idx = 0;
+    r->ph = 0;
+    for (size_t l = 0; l < lanes; l++) {
+        r->hist[l] = (int16_t *)calloc(r->hist_cap, sizeof(int16_t));
+        if (!r->hist[l]) {
+            iq_resamp_free(r);
+            return -1;
+        }
+    }
+    if (iq_resamp_design(r)) {
+        iq_resamp_free(r);
+        return -1;
+    }
+
+    if (nthreads <= 0)
+        nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    r->nthreads = nthreads < 1 ? 1 : (nthreads > IQ_RESAMP_MAX_THREADS ? IQ_RESAMP_MAX_THREADS : nthreads);
+    if (r->nthreads > 1) {
+        pthread_mutex_init(&r->mu, NULL);
+        pthread_cond_init(&r->cv, NULL);
+        pthread_cond_init(&r->done_cv, NULL);
+        for (int i = 1; i < r->nthreads; i++) {
+            r->workers[i].r = r;
+            r->workers[i].id = i;
+            if (pthread_create(&r->workers[i].th, NULL, iq_resamp_thread, &r->workers[i])) {
+                fprintf(stderr, "resampler: failed to start worker %d\n", i);
+                r->nthreads = i;
+                break;
+            }
+        }
+    }
+    return 0;
+}
+
+static inline bool iq_resamp_identity(const iq_resamp_t *r) { return r->L == r->M; }
+
+// Largest input chunk whose output is guaranteed to fit in out_frames.
+static inline size_t iq_resamp_max_in(const iq_resamp_t *r, size_t out_frames) {
+    uint64_t n = (uint64_t)out_frames * r->M / r->L;
+    n = n > 1 ? n - 1 : 1;
+    return (size_t)(n < r->hist_cap - (r->taps - 1) ? n : r->hist_cap - (r->taps - 1));
+}
+
+// Consume n_in frames from in and write the resulting frames to out; returns frames written.
+static inline size_t iq_resamp_process(iq_resamp_t *r, const int16_t *in, size_t n_in, int16_t *out) {
+    const size_t keep = r->taps - 1;
+    if (n_in > r->hist_cap - keep)
+        n_in = r->hist_cap - keep;
+    for (size_t l = 0; l < r->lanes; l++) {
+        int16_t *h = r->hist[l] + keep;
+        for (size_t i = 0; i < n_in; i++)
+            h[i] = in[i * r->lanes + l];
+    }
+
+    // outputs n with idx + (ph + n*M)/L < n_in
+    size_t n_out = 0;
+    if (r->idx < n_in) {
+        const uint64_t span = (n_in - r->idx) * (uint64_t)r->L - r->ph;
+        n_out = (size_t)((span + r->M - 1) / r->M);
+    }
+    r->job_out = out;
+    r->job_out_n = n_out;
+    r->job_idx = r->idx;
+    r->job_ph = r->ph;
+
+    if (r->nthreads > 1 && n_out * r->taps * r->lanes >= IQ_RESAMP_MT_MIN_MACS) {
+        pthread_mutex_lock(&r->mu);
+        r->pending = r->nthreads - 1;
+        r->gen++;
+        pthread_cond_broadcast(&r->cv);
+        pthread_mutex_unlock(&r->mu);
+
+        size_t from, to;
+        iq_resamp_slice(r, 0, &from, &to);
+        iq_resamp_run(r, from, to);
+
+        pthread_mutex_lock(&r->mu);
+        while (r->pending > 0)
+            pthread_cond_wait(&r->done_cv, &r->mu);
+        pthread_mutex_unlock(&r->mu);
+    } else {
+        iq_resamp_run(r, 0, n_out);
+    }
+
+    const uint64_t pos = (uint64_t)r->ph + (uint64_t)n_out * r->M;
+    r->idx = r->idx + pos / r->L - n_in;
+    r->ph = (unsigned)(pos % r->L);
+    for (size_t l = 0; l < r->lanes; l++)
+        memmove(r->hist[l], r->hist[l] + n_in, keep * sizeof(int16_t));
+    return n_out;
+}
+
+#endif
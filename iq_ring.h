@@ -0,0 +1,110 @@
+#ifndef IQ_RING_H
+#define IQ_RING_H
+
+// Single-producer/single-consumer ring of fixed-size interleaved I/Q chunks.
+// The producer (reader thread) fills slots, the consumer (streaming thread) drains them.
+// head/tail are free-running counters, slot index = counter % depth.
+
+#include "tx_rt.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define IQ_RING_ALIGN 64
+
+typedef struct {
+    size_t frames; // valid frames in this slot
+    bool eof;      // input ended after this slot (no more slots will follow)
+    uint64_t pos;  // stream frame index of the first frame, for producers that drop slots
+} iq_slot_t;
+
+typedef struct {
+    int16_t *mem; // depth * slot_samples int16, IQ_RING_ALIGN aligned
+    iq_slot_t *slots;
+    size_t depth;
+    size_t slot_samples; // int16 per slot (2 per frame)
+
+    _Alignas(IQ_RING_ALIGN) atomic_size_t head; // written by producer only
+    _Alignas(IQ_RING_ALIGN) atomic_size_t tail; // written by consumer only
+    _Alignas(IQ_RING_ALIGN) atomic_uint_fast64_t empty_waits; // consumer found ring empty
+    atomic_uint_fast64_t full_waits;                          // producer found ring full
+} iq_ring_t;
+
+// rt (may be NULL) puts the slots on hugepages and locks them under --rt; see tx_rt_alloc().
+static inline int iq_ring_init(iq_ring_t *r, size_t depth, size_t slot_samples, const tx_rt_t *rt) {
+    memset(r, 0, sizeof(*r));
+    size_t slot_bytes = slot_samples * sizeof(int16_t);
+    slot_bytes = (slot_bytes + IQ_RING_ALIGN - 1) & ~(size_t)(IQ_RING_ALIGN - 1);
+
+    r->mem = (int16_t *)tx_rt_alloc(rt, depth * slot_bytes); // zeroed, so prefaulted
+    r->slots = (iq_slot_t *)calloc(depth, sizeof(iq_slot_t));
+    if (!r->mem || !r->slots) {
+        free(r->mem);
+        free(r->slots);
+        memset(r, 0, sizeof(*r));
+        return -1;
+    }
+    r->depth = depth;
+    r->slot_samples = slot_bytes / sizeof(int16_t);
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    atomic_init(&r->empty_waits, 0);
+    atomic_init(&r->full_waits, 0);
+    return 0;
+}
+
+static inline void iq_ring_free(iq_ring_t *r) {
+    free(r->mem);
+    free(r->slots);
+    memset(r, 0, sizeof(*r));
+}
+
+static inline int16_t *iq_ring_slot_buf(iq_ring_t *r, size_t counter) {
+    return r->mem + (counter % r->depth) * r->slot_samples;
+}
+
+static inline size_t iq_ring_fill(iq_ring_t *r) {
+    size_t h = atomic_load_explicit(&r->head, memory_order_acquire);
+    size_t t = atomic_load_explicit(&r->tail, memory_order_acquire);
+    return h - t;
+}
+
+// Producer: returns the next free slot buffer, or NULL when the ring is full.
+static inline int16_t *iq_ring_acquire(iq_ring_t *r, iq_slot_t **slot) {
+    size_t h = atomic_load_explicit(&r->head, memory_order_relaxed);
+    size_t t = atomic_load_explicit(&r->tail, memory_order_acquire);
+    if (h - t >= r->depth)
+        return NULL;
+    *slot = &r->slots[h % r->depth];
+    return iq_ring_slot_buf(r, h);
+}
+
+static inline void iq_ring_publish(iq_ring_t *r) {
+    size_t h = atomic_load_explicit(&r->head, memory_order_relaxed);
+    atomic_store_explicit(&r->head, h + 1, memory_order_release);
+}
+
+// Consumer: returns the oldest filled slot buffer, or NULL when the ring is empty.
+static inline int16_t *iq_ring_peek(iq_ring_t *r, const iq_slot_t **slot) {
+    size_t t = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    size_t h = atomic_load_explicit(&r->head, memory_order_acquire);
+    if (h == t)
+        return NULL;
+    *slot = &r->slots[t % r->depth];
+    return iq_ring_slot_buf(r, t);
+}
+
+static inline void iq_ring_release(iq_ring_t *r) {
+    size_t t = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    atomic_store_explicit(&r->tail, t + 1, memory_order_release);
+}
+
+static inline void iq_ring_pause(long ns) {
+    struct timespec ts = {0, ns};
+    nanosleep(&ts, NULL);
+}
+
+#endif
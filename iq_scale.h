@@ -0,0 +1,161 @@
+#ifndef IQ_SCALE_H
+#define IQ_SCALE_H
+
+// Saturating amplitude scale for interleaved int16 I/Q.
+// The scale is turned into a Q15 mantissa plus a shift (result = (x*g + rnd) >> shift), so the
+// SIMD kernels do one 16x16->32 multiply, a rounding shift and a saturating pack per sample.
+// iq_scale_select() picks the widest kernel the CPU supports at runtime; the original double
+// loop stays as the portable fallback.
+
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define IQ_SCALE_X86 1
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define IQ_SCALE_NEON 1
+#endif
+
+typedef struct {
+    double scale;
+    int16_t g; // Q(shift) mantissa
+    int shift; // 1..30
+} iq_scale_q_t;
+
+typedef void (*iq_scale_fn)(int16_t *dst, const int16_t *src, size_t n, const iq_scale_q_t *q);
+
+typedef struct {
+    const char *name;
+    iq_scale_fn fn;
+    bool (*supported)(void);
+} iq_scale_kernel_t;
+
+static inline void iq_scale_q_init(iq_scale_q_t *q, double scale) {
+    q->scale = scale;
+    q->shift = 15;
+    q->g = 0;
+    if (scale <= 0.0)
+        return;
+    // keep the mantissa in [16384, 32767] for full 15-bit precision
+    while (q->shift > 1 && llround(scale * (double)(1 << q->shift)) > 32767)
+        q->shift--;
+    while (q->shift < 30 && llround(scale * (double)(1 << (q->shift + 1))) <= 32767)
+        q->shift++;
+    q->g = (int16_t)llround(scale * (double)(1 << q->shift));
+}
+
+static inline int16_t iq_sat16(int32_t s) {
+    if (s > 32767)
+        return 32767;
+    if (s < -32768)
+        return -32768;
+    return (int16_t)s;
+}
+
+static inline void iq_scale_scalar(int16_t *dst, const int16_t *src, size_t n, const iq_scale_q_t *q) {
+    for (size_t i = 0; i < n; i++)
+        dst[i] = iq_sat16((int32_t)(src[i] * q->scale));
+}
+
+static inline void iq_scale_q15_c(int16_t *dst, const int16_t *src, size_t n, const iq_scale_q_t *q) {
+    const int32_t rnd = 1 << (q->shift - 1);
+    for (size_t i = 0; i < n; i++)
+        dst[i] = iq_sat16(((int32_t)src[i] * q->g + rnd) >> q->shift);
+}
+
+static inline bool iq_scale_always(void) { return true; }
+
+#ifdef IQ_SCALE_X86
+__attribute__((target("sse2"))) static inline void iq_scale_sse2(int16_t *dst, const int16_t *src, size_t n,
+                                                                 const iq_scale_q_t *q) {
+    const __m128i g = _mm_set1_epi16(q->g);
+    const __m128i rnd = _mm_set1_epi32(1 << (q->shift - 1));
+    const __m128i cnt = _mm_cvtsi32_si128(q->shift);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i lo = _mm_mullo_epi16(x, g);
+        __m128i hi = _mm_mulhi_epi16(x, g);
+        __m128i p0 = _mm_sra_epi32(_mm_add_epi32(_mm_unpacklo_epi16(lo, hi), rnd), cnt);
+        __m128i p1 = _mm_sra_epi32(_mm_add_epi32(_mm_unpackhi_epi16(lo, hi), rnd), cnt);
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packs_epi32(p0, p1));
+    }
+    iq_scale_q15_c(dst + i, src + i, n - i, q);
+}
+
+__attribute__((target("avx2"))) static inline void iq_scale_avx2(int16_t *dst, const int16_t *src, size_t n,
+                                                                 const iq_scale_q_t *q) {
+    const __m256i g = _mm256_set1_epi16(q->g);
+    const __m256i rnd = _mm256_set1_epi32(1 << (q->shift - 1));
+    const __m128i cnt = _mm_cvtsi32_si128(q->shift);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(src + i));
+        __m256i lo = _mm256_mullo_epi16(x, g);
+        __m256i hi = _mm256_mulhi_epi16(x, g);
+        // unpack and pack both work per 128-bit lane, so element order is preserved
+        __m256i p0 = _mm256_sra_epi32(_mm256_add_epi32(_mm256_unpacklo_epi16(lo, hi), rnd), cnt);
+        __m256i p1 = _mm256_sra_epi32(_mm256_add_epi32(_mm256_unpackhi_epi16(lo, hi), rnd), cnt);
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_packs_epi32(p0, p1));
+    }
+    iq_scale_sse2(dst + i, src + i, n - i, q);
+}
+
+static inline bool iq_scale_has_sse2(void) { return __builtin_cpu_supports("sse2"); }
+static inline bool iq_scale_has_avx2(void) { return __builtin_cpu_supports("avx2"); }
+#endif
+
+#ifdef IQ_SCALE_NEON
+static inline void iq_scale_neon(int16_t *dst, const int16_t *src, size_t n, const iq_scale_q_t *q) {
+    const int16x4_t g = vdup_n_s16(q->g);
+    const int32x4_t sh = vdupq_n_s32(-q->shift); // negative count = rounding right shift
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        int16x8_t x = vld1q_s16(src + i);
+        int32x4_t p0 = vrshlq_s32(vmull_s16(vget_low_s16(x), g), sh);
+        int32x4_t p1 = vrshlq_s32(vmull_s16(vget_high_s16(x), g), sh);
+        vst1q_s16(dst + i, vcombine_s16(vqmovn_s32(p0), vqmovn_s32(p1)));
+    }
+    iq_scale_q15_c(dst + i, src + i, n - i, q);
+}
+#endif
+
+// Kernels from widest to narrowest; the list ends with the scalar fallback and a NULL entry.
+static inline const iq_scale_kernel_t *iq_scale_kernels(void) {
+    static const iq_scale_kernel_t k[] = {
+#ifdef IQ_SCALE_X86
+        {"avx2", iq_scale_avx2, iq_scale_has_avx2},
+        {"sse2", iq_scale_sse2, iq_scale_has_sse2},
+#endif
+#ifdef IQ_SCALE_NEON
+        {"neon", iq_scale_neon, iq_scale_always},
+#endif
+        {"q15-c", iq_scale_q15_c, iq_scale_always},
+        {"scalar", iq_scale_scalar, iq_scale_always},
+        {NULL, NULL, NULL},
+    };
+    return k;
+}
+
+static inline iq_scale_fn iq_scale_select(const char **name) {
+    const iq_scale_kernel_t *k = iq_scale_kernels();
+    for (; k->name; k++) {
+        if (k->fn != iq_scale_q15_c && k->fn != iq_scale_scalar && k->supported())
+            break;
+    }
+    if (!k->name) {
+        k = iq_scale_kernels();
+        while (k->fn != iq_scale_scalar)
+            k++;
+    }
+    if (name)
+        *name = k->name;
+    return k->fn;
+}
+
+#endif
@@ -0,0 +1,340 @@
+#ifndef IQ_SHM_H
+#define IQ_SHM_H
+
+// Shared-memory SPSC ring of interleaved int16 I/Q frames, the zero-copy alternative to the named
+// pipe in front of tx_pipe_I16bit (--shm <name>). The consumer creates the POSIX shm object
+// /dev/shm/<name>; a producer process attaches and renders samples straight into the ring:
+//
+//     iq_shm_t p;
+//     iq_shm_attach(&p, "txring", 5000);
+//     size_t n;
+//     int16_t *dst = iq_shm_reserve(&p, want, &n, 1000); // n <= want contiguous frames
+//     ... write n frames to dst ...
+//     iq_shm_commit(&p, n);
+//     iq_shm_close(&p); // producer EOF
+//
+// Layout (IQ_SHM_HDR_BYTES header page, then `capacity` data bytes, a power of two in whole
+// pages): head and tail are free-running byte counters on their own cache lines, written only by
+// the producer and the consumer respectively. The consumer maps the data twice back to back, so any
+// span it reads is contiguous and goes to LMS_SendStream without a copy; the producer maps it once
+// and iq_shm_reserve() stops at the wrap.
+//
+// Wakeups: one process-shared futex word per direction (head_seq, tail_seq). A side about to sleep
+// reads the word, raises its *_waiting flag and re-checks the ring; the other side bumps the word
+// after moving its counter and only calls FUTEX_WAKE when the flag is up, so a producer that keeps
+// the ring from running dry makes no syscalls. Waits are bounded (IQ_SHM_WAIT_SLICE_MS) because the
+// Python producer (iq_shm.py, same layout) cannot fence and may miss a wakeup.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <linux/futex.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define IQ_SHM_MAGIC 0x4d535149u // "IQSM"
+#define IQ_SHM_VERSION 1u
+#define IQ_SHM_HDR_BYTES 4096u
+#define IQ_SHM_SIZE_DEF (16u << 20)
+#define IQ_SHM_WAIT_SLICE_MS 50
+#define IQ_SHM_NAME_MAX 256
+
+// Fixed offsets: iq_shm.py mirrors this struct field by field.
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t frame_bytes; // 4 per channel (I16 I + Q)
+    uint32_t channels;
+    uint64_t capacity;  // data bytes
+    double sample_rate; // what the consumer expects, 0 = unknown
+    atomic_uint consumer_closed;
+    atomic_uint producer_closed;
+    atomic_uint producer_pid; // last producer to attach, 0 = none yet
+    uint32_t pad0[5];
+
+    _Alignas(64) atomic_uint_fast64_t head; // bytes committed, producer only
+    atomic_uint head_seq;                   // futex: bumped after every commit
+    atomic_uint consumer_waiting;
+    atomic_uint_fast64_t producer_wakes; // FUTEX_WAKE calls made by the producer
+
+    _Alignas(64) atomic_uint_fast64_t tail; // bytes released, consumer only
+    atomic_uint tail_seq;                   // futex: bumped after every release
+    atomic_uint producer_waiting;
+    atomic_uint_fast64_t consumer_wakes;
+    atomic_uint_fast64_t producer_full_waits; // producer found the ring full
+} iq_shm_hdr_t;
+
+_Static_assert(offsetof(iq_shm_hdr_t, head) == 64, "iq_shm.py layout");
+_Static_assert(offsetof(iq_shm_hdr_t, tail) == 128, "iq_shm.py layout");
+_Static_assert(sizeof(atomic_uint_fast64_t) == 8 && sizeof(atomic_uint) == 4, "iq_shm.py layout");
+
+typedef struct {
+    int fd;
+    uint8_t *map;
+    size_t map_len;
+    iq_shm_hdr_t *h;
+    uint8_t *data;
+    uint64_t cap, mask;
+    size_t frame_bytes;
+    bool consumer;
+    uint64_t empty_waits; // consumer: futex sleeps on an empty ring
+    char name[IQ_SHM_NAME_MAX];
+} iq_shm_t;
+
+static inline int iq_shm_futex(atomic_uint *addr, int op, unsigned val, int timeout_ms) {
+    struct timespec ts = {timeout_ms / 1000, (long)(timeout_ms % 1000) * 1000000L};
+    return (int)syscall(SYS_futex, (unsigned *)addr, op, val, timeout_ms >= 0 ? &ts : NULL, NULL, 0);
+}
+
+static inline void iq_shm_wake(atomic_uint *seq, atomic_uint *waiting, atomic_uint_fast64_t *wakes) {
+    atomic_fetch_add_explicit(seq, 1, memory_order_release);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(waiting, memory_order_relaxed)) {
+        atomic_fetch_add_explicit(wakes, 1, memory_order_relaxed);
+        iq_shm_futex(seq, FUTEX_WAKE, 1, -1);
+    }
+}
+
+static inline const char *iq_shm_path(const char *name, char *buf, size_t len) {
+    snprintf(buf, len, "%s%s", name[0] == '/' ? "" : "/", name);
+    return buf;
+}
+
+static inline void iq_shm_unmap(iq_shm_t *q) {
+    if (q->map && q->map != MAP_FAILED)
+        munmap(q->map, q->map_len);
+    if (q->fd >= 0)
+        close(q->fd);
+    q->map = NULL;
+    q->fd = -1;
+}
+
+// Consumer: create (or reset) the ring. capacity is rounded up to a power of two >= a page.
+static inline int iq_shm_create(iq_shm_t *q, const char *name, size_t capacity, unsigned channels,
+                                double sample_rate) {
+    memset(q, 0, sizeof(*q));
+    q->fd = -1;
+    q->consumer = true;
+    iq_shm_path(name, q->name, sizeof(q->name));
+    uint64_t cap = IQ_SHM_HDR_BYTES;
+    while (cap < capacity)
+        cap <<= 1;
+
+    q->fd = shm_open(q->name, O_RDWR | O_CREAT | O_TRUNC, 0660);
+    if (q->fd < 0) {
+        fprintf(stderr, "shm_open(%s): %s\n", q->name, strerror(errno));
+        return -1;
+    }
+    if (ftruncate(q->fd, (off_t)(IQ_SHM_HDR_BYTES + cap))) {
+        fprintf(stderr, "ftruncate(%s, %" PRIu64 "): %s\n", q->name, IQ_SHM_HDR_BYTES + cap, strerror(errno));
+        goto fail;
+    }
+
+    // Header, data, and the data again right behind it.
+    q->map_len = IQ_SHM_HDR_BYTES + 2 * cap;
+    q->map = (uint8_t *)mmap(NULL, q->map_len, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    const int prot = PROT_READ | PROT_WRITE, flags = MAP_SHARED | MAP_FIXED;
+    if (q->map == MAP_FAILED || mmap(q->map, IQ_SHM_HDR_BYTES + cap, prot, flags, q->fd, 0) == MAP_FAILED ||
+        mmap(q->map + IQ_SHM_HDR_BYTES + cap, cap, prot, flags, q->fd, IQ_SHM_HDR_BYTES) == MAP_FAILED) {
+        fprintf(stderr, "mmap(%s): %s\n", q->name, strerror(errno));
+        goto fail;
+    }
+    q->h = (iq_shm_hdr_t *)q->map;
+    q->data = q->map + IQ_SHM_HDR_BYTES;
+    q->cap = cap;
+    q->mask = cap - 1;
+    q->frame_bytes = 4u * channels;
+
+    memset(q->h, 0, sizeof(*q->h));
+    q->h->frame_bytes = (uint32_t)q->frame_bytes;
+    q->h->channels = channels;
+    q->h->capacity = cap;
+    q->h->sample_rate = sample_rate;
+    q->h->version = IQ_SHM_VERSION;
+    atomic_thread_fence(memory_order_release);
+    q->h->magic = IQ_SHM_MAGIC; // last: producers poll for it
+    return 0;
+
+fail:
+    iq_shm_unmap(q);
+    shm_unlink(q->name);
+    return -1;
+}
+
+// Producer: attach to a ring created by the consumer, waiting up to timeout_ms for it to appear.
+static inline int iq_shm_attach(iq_shm_t *q, const char *name, int timeout_ms) {
+    memset(q, 0, sizeof(*q));
+    q->fd = -1;
+    iq_shm_path(name, q->name, sizeof(q->name));
+    for (int waited = 0;; waited += 10) {
+        q->fd = shm_open(q->name, O_RDWR, 0);
+        struct stat sb;
+        if (q->fd >= 0 && !fstat(q->fd, &sb) && (uint64_t)sb.st_size > IQ_SHM_HDR_BYTES) {
+            q->map_len = (size_t)sb.st_size;
+            q->map = (uint8_t *)mmap(NULL, q->map_len, PROT_READ | PROT_WRITE, MAP_SHARED, q->fd, 0);
+            if (q->map == MAP_FAILED) {
+                fprintf(stderr, "mmap(%s): %s\n", q->name, strerror(errno));
+                iq_shm_unmap(q);
+                return -1;
+            }
+            q->h = (iq_shm_hdr_t *)q->map;
+            if (q->h->magic == IQ_SHM_MAGIC && q->h->capacity + IQ_SHM_HDR_BYTES == q->map_len)
+                break;
+            iq_shm_unmap(q);
+        } else if (q->fd >= 0) {
+            iq_shm_unmap(q);
+        }
+        if (waited >= timeout_ms) {
+            fprintf(stderr, "shm %s: no consumer ring after %d ms\n", q->name, timeout_ms);
+            return -1;
+        }
+        struct timespec ts = {0, 10 * 1000000L};
+        nanosleep(&ts, NULL);
+    }
+    atomic_thread_fence(memory_order_acquire);
+    if (q->h->version != IQ_SHM_VERSION) {
+        fprintf(stderr, "shm %s: version %u, expected %u\n", q->name, q->h->version, IQ_SHM_VERSION);
+        iq_shm_unmap(q);
+        return -1;
+    }
+    q->data = q->map + IQ_SHM_HDR_BYTES;
+    q->cap = q->h->capacity;
+    q->mask = q->cap - 1;
+    q->frame_bytes = q->h->frame_bytes;
+    atomic_store(&q->h->producer_closed, 0);
+    atomic_store(&q->h->producer_pid, (unsigned)getpid());
+    return 0;
+}
+
+// Producer: ring closes as EOF. Consumer: wakes a blocked producer and removes the object.
+static inline void iq_shm_close(iq_shm_t *q) {
+    if (!q->map)
+        return;
+    if (q->consumer) {
+        atomic_store(&q->h->consumer_closed, 1);
+        iq_shm_wake(&q->h->tail_seq, &q->h->producer_waiting, &q->h->consumer_wakes);
+        shm_unlink(q->name);
+    } else {
+        atomic_store(&q->h->producer_closed, 1);
+        iq_shm_wake(&q->h->head_seq, &q->h->consumer_waiting, &q->h->producer_wakes);
+    }
+    iq_shm_unmap(q);
+}
+
+// ---- consumer ----
+
+static inline size_t iq_shm_readable(const iq_shm_t *q) {
+    const uint64_t head = atomic_load_explicit(&q->h->head, memory_order_acquire);
+    const uint64_t tail = atomic_load_explicit(&q->h->tail, memory_order_relaxed);
+    return (size_t)((head - tail) / q->frame_bytes);
+}
+
+// Producer closed and everything it committed has been released.
+static inline bool iq_shm_eof(const iq_shm_t *q) {
+    return atomic_load_explicit(&q->h->producer_closed, memory_order_acquire) && iq_shm_readable(q) == 0;
+}
+
+// Block until at least min_frames are readable, the producer closes or timeout_ms passes.
+// Returns the readable frame count.
+static inline size_t iq_shm_wait_data(iq_shm_t *q, size_t min_frames, int timeout_ms) {
+    size_t n = iq_shm_readable(q);
+    while (n < min_frames && timeout_ms > 0 && !atomic_load(&q->h->producer_closed)) {
+        const unsigned seen = atomic_load_explicit(&q->h->head_seq, memory_order_acquire);
+        atomic_store(&q->h->consumer_waiting, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        n = iq_shm_readable(q);
+        if (n >= min_frames) {
+            atomic_store(&q->h->consumer_waiting, 0);
+            break;
+        }
+        const int slice = timeout_ms < IQ_SHM_WAIT_SLICE_MS ? timeout_ms : IQ_SHM_WAIT_SLICE_MS;
+        q->empty_waits++;
+        iq_shm_futex(&q->h->head_seq, FUTEX_WAIT, seen, slice);
+        atomic_store(&q->h->consumer_waiting, 0);
+        timeout_ms -= slice;
+        n = iq_shm_readable(q);
+    }
+    return n;
+}
+
+// Contiguous view of the readable frames (the data is mapped twice, so the wrap is invisible).
+static inline const int16_t *iq_shm_peek(const iq_shm_t *q) {
+    return (const int16_t *)(q->data + (atomic_load_explicit(&q->h->tail, memory_order_relaxed) & q->mask));
+}
+
+static inline void iq_shm_release(iq_shm_t *q, size_t frames) {
+    atomic_fetch_add_explicit(&q->h->tail, (uint64_t)frames * q->frame_bytes, memory_order_release);
+    iq_shm_wake(&q->h->tail_seq, &q->h->producer_waiting, &q->h->consumer_wakes);
+}
+
+// ---- producer ----
+
+// Reserve up to want frames at the head, waiting up to timeout_ms for space. Returns the write
+// pointer and sets *frames (stops at the wrap); NULL once the consumer has gone or on timeout.
+static inline int16_t *iq_shm_reserve(iq_shm_t *q, size_t want, size_t *frames, int timeout_ms) {
+    const uint64_t head = atomic_load_explicit(&q->h->head, memory_order_relaxed);
+    for (;;) {
+        if (atomic_load(&q->h->consumer_closed)) {
+            *frames = 0;
+            return NULL;
+        }
+        const uint64_t tail = atomic_load_explicit(&q->h->tail, memory_order_acquire);
+        uint64_t room = q->cap - (head - tail);
+        const uint64_t to_wrap = q->cap - (head & q->mask);
+        if (room > to_wrap)
+            room = to_wrap;
+        size_t n = (size_t)(room / q->frame_bytes);
+        if (n > want)
+            n = want;
+        if (n > 0) {
+            *frames = n;
+            return (int16_t *)(q->data + (head & q->mask));
+        }
+        if (timeout_ms <= 0) {
+            *frames = 0;
+            return NULL;
+        }
+        const unsigned seen = atomic_load_explicit(&q->h->tail_seq, memory_order_acquire);
+        atomic_store(&q->h->producer_waiting, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (atomic_load_explicit(&q->h->tail, memory_order_acquire) == tail) {
+            const int slice = timeout_ms < IQ_SHM_WAIT_SLICE_MS ? timeout_ms : IQ_SHM_WAIT_SLICE_MS;
+            atomic_fetch_add_explicit(&q->h->producer_full_waits, 1, memory_order_relaxed);
+            iq_shm_futex(&q->h->tail_seq, FUTEX_WAIT, seen, slice);
+            timeout_ms -= slice;
+        }
+        atomic_store(&q->h->producer_waiting, 0);
+    }
+}
+
+static inline void iq_shm_commit(iq_shm_t *q, size_t frames) {
+    atomic_fetch_add_explicit(&q->h->head, (uint64_t)frames * q->frame_bytes, memory_order_release);
+    iq_shm_wake(&q->h->head_seq, &q->h->consumer_waiting, &q->h->producer_wakes);
+}
+
+// Copy frames in, blocking while the ring is full. Returns frames written (short if the consumer
+// closed or nothing drained for timeout_ms).
+static inline size_t iq_shm_write(iq_shm_t *q, const int16_t *src, size_t frames, int timeout_ms) {
+    size_t done = 0;
+    while (done < frames) {
+        size_t n = 0;
+        int16_t *dst = iq_shm_reserve(q, frames - done, &n, timeout_ms);
+        if (!dst)
+            break;
+        memcpy(dst, (const uint8_t *)src + done * q->frame_bytes, n * q->frame_bytes);
+        iq_shm_commit(q, n);
+        done += n;
+    }
+    return done;
+}
+
+#endif
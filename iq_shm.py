@@ -0,0 +1,175 @@
+"""Producer side of the iq_shm.h shared-memory I/Q ring (tx_pipe_I16bit --shm <name>).
+
+    with IqShmProducer("txring") as ring:
+        view = ring.reserve(4096)      # int16 (n, 2 * channels) view into the ring, n <= 4096
+        view[:] = samples[: len(view)] # render / copy in place
+        ring.commit(len(view))
+
+Counters are 8-byte aligned loads/stores on the shared mapping, which are single accesses on
+x86-64 and arm64. Python cannot issue the fences the C side uses around the futex handshake, so a
+wakeup can occasionally be missed; both sides bound every sleep, which turns that into a short
+delay rather than a stall.
+"""
+import ctypes
+import mmap
+import os
+import platform
+import time
+
+import numpy as np
+
+MAGIC = 0x4D535149  # "IQSM"
+VERSION = 1
+HDR_BYTES = 4096
+WAIT_SLICE_S = 0.05
+
+# iq_shm_hdr_t field offsets
+OFF_MAGIC, OFF_VERSION, OFF_FRAME_BYTES, OFF_CHANNELS = 0, 4, 8, 12
+OFF_CAPACITY, OFF_SAMPLE_RATE = 16, 24
+OFF_CONSUMER_CLOSED, OFF_PRODUCER_CLOSED, OFF_PRODUCER_PID = 32, 36, 40
+OFF_HEAD, OFF_HEAD_SEQ, OFF_CONSUMER_WAITING, OFF_PRODUCER_WAKES = 64, 72, 76, 80
+OFF_TAIL, OFF_TAIL_SEQ, OFF_PRODUCER_WAITING = 128, 136, 140
+OFF_PRODUCER_FULL_WAITS = 152
+
+FUTEX_WAIT, FUTEX_WAKE = 0, 1
+_SYS_FUTEX = {"x86_64": 202, "aarch64": 98, "armv7l": 240, "i686": 240}.get(platform.machine())
+_libc = ctypes.CDLL(None, use_errno=True)
+
+
+class _Timespec(ctypes.Structure):
+    _fields_ = [("tv_sec", ctypes.c_long), ("tv_nsec", ctypes.c_long)]
+
+
+def _futex(addr: int, op: int, val: int, timeout_s: float = None) -> None:
+    if _SYS_FUTEX is None:  # unknown syscall number: poll instead of sleeping in the kernel
+        if op == FUTEX_WAIT:
+            time.sleep(min(timeout_s or WAIT_SLICE_S, 0.001))
+        return
+    ts = None
+    if timeout_s is not None:
+        ts = ctypes.byref(_Timespec(int(timeout_s), int((timeout_s % 1.0) * 1e9)))
+    _libc.syscall(ctypes.c_long(_SYS_FUTEX), ctypes.c_void_p(addr), ctypes.c_int(op), ctypes.c_uint(val), ts,
+                  None, ctypes.c_int(0))
+
+
+class IqShmProducer:
+    def __init__(self, name: str, timeout: float = 30.0):
+        path = "/dev/shm/" + name.lstrip("/")
+        deadline = time.monotonic() + timeout
+        while True:
+            try:
+                fd = os.open(path, os.O_RDWR)
+                try:
+                    size = os.fstat(fd).st_size
+                    if size > HDR_BYTES:
+                        mm = mmap.mmap(fd, size, mmap.MAP_SHARED, mmap.PROT_READ | mmap.PROT_WRITE)
+                        hdr = np.frombuffer(mm, dtype=np.uint32, count=4)
+                        cap = int(np.frombuffer(mm, dtype=np.uint64, count=1, offset=OFF_CAPACITY)[0])
+                        if hdr[0] == MAGIC and cap + HDR_BYTES == size:
+                            del hdr
+                            break
+                        del hdr
+                        mm.close()
+                finally:
+                    os.close(fd)
+            except FileNotFoundError:
+                pass
+            if time.monotonic() > deadline:
+                raise TimeoutError(f"shm {name}: no consumer ring after {timeout:.0f} s")
+            time.sleep(0.01)
+
+        self._mm = mm
+        u32 = lambda off: ctypes.c_uint32.from_buffer(mm, off)  # noqa: E731
+        u64 = lambda off: ctypes.c_uint64.from_buffer(mm, off)  # noqa: E731
+        if u32(OFF_VERSION).value != VERSION:
+            raise RuntimeError(f"shm {name}: version {u32(OFF_VERSION).value}, expected {VERSION}")
+        self.frame_bytes = u32(OFF_FRAME_BYTES).value
+        self.channels = u32(OFF_CHANNELS).value
+        self.capacity = cap
+        self.sample_rate = ctypes.c_double.from_buffer(mm, OFF_SAMPLE_RATE).value
+        self._consumer_closed = u32(OFF_CONSUMER_CLOSED)
+        self._producer_closed = u32(OFF_PRODUCER_CLOSED)
+        self._head = u64(OFF_HEAD)
+        self._head_seq = u32(OFF_HEAD_SEQ)
+        self._consumer_waiting = u32(OFF_CONSUMER_WAITING)
+        self._producer_wakes = u64(OFF_PRODUCER_WAKES)
+        self._tail = u64(OFF_TAIL)
+        self._tail_seq = u32(OFF_TAIL_SEQ)
+        self._producer_waiting = u32(OFF_PRODUCER_WAITING)
+        self._full_waits = u64(OFF_PRODUCER_FULL_WAITS)
+        self._lanes = self.frame_bytes // 2
+        self._data = np.frombuffer(mm, dtype=np.int16, count=cap // 2, offset=HDR_BYTES).reshape(-1, self._lanes)
+        self._frames = cap // self.frame_bytes
+        self._producer_closed.value = 0
+        u32(OFF_PRODUCER_PID).value = os.getpid()
+
+    @property
+    def consumer_closed(self) -> bool:
+        return self._consumer_closed.value != 0
+
+    def reserve(self, want: int, timeout: float = 1.0):
+        """Writable (n, 2 * channels) int16 view of up to `want` frames at the head (stops at the
+        wrap); None once the consumer has closed or nothing drained for `timeout` seconds."""
+        head = self._head.value
+        deadline = time.monotonic() + timeout
+        while True:
+            if self.consumer_closed:
+                return None
+            tail = self._tail.value
+            room = self.capacity - (head - tail)
+            start = (head % self.capacity) // self.frame_bytes
+            n = min(want, room // self.frame_bytes, self._frames - start)
+            if n > 0:
+                return self._data[start : start + n]
+            left = deadline - time.monotonic()
+            if left <= 0:
+                return None
+            seen = self._tail_seq.value
+            self._producer_waiting.value = 1
+            if self._tail.value == tail:
+                self._full_waits.value += 1
+                _futex(ctypes.addressof(self._tail_seq), FUTEX_WAIT, seen, min(left, WAIT_SLICE_S))
+            self._producer_waiting.value = 0
+
+    def commit(self, frames: int) -> None:
+        self._head.value += frames * self.frame_bytes
+        self._wake_consumer()
+
+    def write(self, frames: np.ndarray, timeout: float = 1.0) -> int:
+        """Copy int16 frames (flat interleaved or (n, 2 * channels)) in; returns frames written."""
+        frames = np.asarray(frames, dtype=np.int16).reshape(-1, self._lanes)
+        done = 0
+        while done < len(frames):
+            view = self.reserve(len(frames) - done, timeout)
+            if view is None:
+                break
+            view[:] = frames[done : done + len(view)]
+            self.commit(len(view))
+            done += len(view)
+        return done
+
+    def _wake_consumer(self) -> None:
+        self._head_seq.value = (self._head_seq.value + 1) & 0xFFFFFFFF
+        if self._consumer_waiting.value:
+            self._producer_wakes.value += 1
+            _futex(ctypes.addressof(self._head_seq), FUTEX_WAKE, 1)
+
+    def close(self) -> None:
+        """Signal EOF to the consumer and unmap."""
+        if self._mm is None:
+            return
+        self._producer_closed.value = 1
+        self._wake_consumer()
+        for k in [k for k, v in vars(self).items() if isinstance(v, (ctypes._SimpleCData, np.ndarray))]:
+            delattr(self, k)
+        try:
+            self._mm.close()
+        except BufferError:  # a caller still holds a reserve() view; the mapping goes with it
+            pass
+        self._mm = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
@@ -0,0 +1,927 @@
+#ifndef IQ_STATS_H
+#define IQ_STATS_H
+
+// Level and spectrum statistics for interleaved int16 I/Q (1 or 2 channels), the native
+// counterpart of wav_file_analyze.py that covers the whole stream instead of its first second.
+//
+// iq_stats_feed() takes any number of frames and keeps, per channel:
+//   - totals and per-block (block_frames) sums of I, Q, I^2, Q^2 and I*Q, min/max and clip counts
+//     (|v| >= 0.999 FS), from one pass of a SIMD reduction kernel (AVX2/SSE2/NEON, picked at
+//     runtime like iq_scale.h). Narrow lanes are widened every IQ_STATS_FLUSH vectors, so sums are
+//     exact for any length;
+//   - a Welch spectrum: Hann-windowed FFTs (iq_fft.h) of overlapping segments, |X|^2 summed per bin.
+//     Segments are read straight from the caller's buffer; only those that span two calls are
+//     assembled in a history buffer.
+//
+// Independent iq_stats_t over consecutive, block-aligned ranges merge exactly (blocks append, sums
+// and spectra add), which is how wav_analyze splits a file across threads; a Welch segment that
+// would straddle two ranges is skipped.
+//
+// iq_stats_tap_t runs the same analysis inline on a TX path: the stream thread copies each chunk it
+// sent into a small ring (dropping it when the ring is full, so the stream never waits) and a worker
+// thread feeds them to iq_stats. Each chunk carries its stream frame index, so a drop closes the
+// block in progress and restarts the Welch segment instead of splicing across the hole; blocks keep
+// their real start time and the holes are counted as gaps.
+
+#include "iq_fft.h"
+#include "iq_ring.h"
+#include <inttypes.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define IQ_STATS_X86 1
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define IQ_STATS_NEON 1
+#endif
+
+#define IQ_STATS_CH_MAX 2
+#define IQ_STATS_CLIP 32734  // 0.999 FS, the wav_file_analyze.py threshold
+#define IQ_STATS_FLUSH 16384 // vectors between widening the 16/32-bit accumulators
+#define IQ_STATS_DC_GUARD 2  // bins either side of DC left out of the pos/neg split and the peak search
+#define IQ_STATS_PEAK_BINS 3 // bins either side of a peak summed as its power (Hann main lobe + skirt)
+#define IQ_STATS_TAP_DEPTH 8
+
+typedef struct {
+    uint64_t frames;
+    int64_t sum[2]; // I, Q
+    uint64_t sq[2];
+    int64_t iq;
+    int32_t min[2], max[2];
+    uint64_t clips[2];
+} iq_stats_sums_t;
+
+// Adds frames of ch channels (2 * ch int16 per frame) into s[0 .. ch-1].
+typedef void (*iq_stats_fn)(const int16_t *x, size_t frames, unsigned ch, iq_stats_sums_t *s);
+
+typedef struct {
+    const char *name;
+    iq_stats_fn fn;
+    bool (*supported)(void);
+} iq_stats_kernel_t;
+
+static inline void iq_stats_sums_reset(iq_stats_sums_t *s) {
+    memset(s, 0, sizeof(*s));
+    s->min[0] = s->min[1] = INT16_MAX;
+    s->max[0] = s->max[1] = INT16_MIN;
+}
+
+static inline void iq_stats_sums_add(iq_stats_sums_t *d, const iq_stats_sums_t *s) {
+    d->frames += s->frames;
+    d->iq += s->iq;
+    for (int k = 0; k < 2; k++) {
+        d->sum[k] += s->sum[k];
+        d->sq[k] += s->sq[k];
+        d->clips[k] += s->clips[k];
+        if (s->min[k] < d->min[k])
+            d->min[k] = s->min[k];
+        if (s->max[k] > d->max[k])
+            d->max[k] = s->max[k];
+    }
+}
+
+static inline void iq_stats_scalar(const int16_t *x, size_t frames, unsigned ch, iq_stats_sums_t *s) {
+    for (unsigned c = 0; c < ch; c++) {
+        iq_stats_sums_t *o = &s[c];
+        const int16_t *p = x + 2 * c;
+        for (size_t f = 0; f < frames; f++, p += 2 * ch) {
+            const int32_t i = p[0], q = p[1];
+            o->sum[0] += i;
+            o->sum[1] += q;
+            o->sq[0] += (uint64_t)(i * i);
+            o->sq[1] += (uint64_t)(q * q);
+            o->iq += (int64_t)(i * q);
+            if (i < o->min[0])
+                o->min[0] = i;
+            if (i > o->max[0])
+                o->max[0] = i;
+            if (q < o->min[1])
+                o->min[1] = q;
+            if (q > o->max[1])
+                o->max[1] = q;
+            o->clips[0] += i >= IQ_STATS_CLIP || i <= -IQ_STATS_CLIP;
+            o->clips[1] += q >= IQ_STATS_CLIP || q <= -IQ_STATS_CLIP;
+        }
+        o->frames += frames;
+    }
+}
+
+static inline bool iq_stats_always(void) { return true; }
+
+// Per-lane partials of a vector kernel: 32-bit lane j holds one (I, Q) pair of channel j % ch,
+// int16 lane k is component k & 1 of channel (k / 2) % ch.
+typedef struct {
+    int64_t si[8], sq[8]; // sum I, sum Q per 32-bit lane
+    uint64_t p[8], pi[8]; // I^2 + Q^2, I^2
+    int64_t x[8];         // I * Q
+    int32_t mn[16], mx[16];
+    uint64_t cl[16];
+} iq_stats_lanes_t;
+
+static inline void iq_stats_lanes_reduce(const iq_stats_lanes_t *l, unsigned lanes32, unsigned ch, size_t frames,
+                                         iq_stats_sums_t *s) {
+    for (unsigned j = 0; j < lanes32; j++) {
+        iq_stats_sums_t *o = &s[j % ch];
+        o->sum[0] += l->si[j];
+        o->sum[1] += l->sq[j];
+        o->sq[0] += l->pi[j];
+        o->sq[1] += l->p[j] - l->pi[j];
+        o->iq += l->x[j];
+    }
+    for (unsigned k = 0; k < 2 * lanes32; k++) {
+        iq_stats_sums_t *o = &s[(k / 2) % ch];
+        const int c = (int)(k & 1);
+        if (l->mn[k] < o->min[c])
+            o->min[c] = l->mn[k];
+        if (l->mx[k] > o->max[c])
+            o->max[c] = l->mx[k];
+        o->clips[c] += l->cl[k];
+    }
+    for (unsigned c = 0; c < ch; c++)
+        s[c].frames += frames;
+}
+
+#ifdef IQ_STATS_X86
+__attribute__((target("sse2"))) static inline void iq_stats_sse2(const int16_t *x, size_t frames, unsigned ch,
+                                                                 iq_stats_sums_t *s) {
+    const size_t per = 4 / ch; // frames per vector
+    const size_t nv = frames / per;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i keep_i = _mm_set1_epi32(0xFFFF);
+    const __m128i one_i = _mm_set1_epi32(1), one_q = _mm_set1_epi32(1 << 16);
+    const __m128i hi = _mm_set1_epi16(IQ_STATS_CLIP - 1), lo = _mm_set1_epi16(-(IQ_STATS_CLIP - 1));
+    __m128i vmin = _mm_set1_epi16(INT16_MAX), vmax = _mm_set1_epi16(INT16_MIN);
+    __m128i p_lo = zero, p_hi = zero, pi_lo = zero, pi_hi = zero, x_lo = zero, x_hi = zero;
+    iq_stats_lanes_t l;
+    memset(&l, 0, sizeof(l));
+    for (size_t v0 = 0; v0 < nv; v0 += IQ_STATS_FLUSH) {
+        const size_t v1 = nv - v0 < IQ_STATS_FLUSH ? nv : v0 + IQ_STATS_FLUSH;
+        __m128i si = zero, sq = zero, cl = zero;
+        for (size_t v = v0; v < v1; v++) {
+            const __m128i a = _mm_loadu_si128((const __m128i *)(x + 8 * v));
+            const __m128i ai = _mm_and_si128(a, keep_i);
+            const __m128i sw = _mm_shufflehi_epi16(_mm_shufflelo_epi16(a, 0xB1), 0xB1);
+            si = _mm_add_epi32(si, _mm_madd_epi16(a, one_i));
+            sq = _mm_add_epi32(sq, _mm_madd_epi16(a, one_q));
+            const __m128i p = _mm_madd_epi16(a, a); // up to 2^31: read as unsigned
+            const __m128i pi = _mm_madd_epi16(ai, ai);
+            const __m128i iq = _mm_madd_epi16(ai, sw);
+            const __m128i iq_sign = _mm_cmpgt_epi32(zero, iq);
+            p_lo = _mm_add_epi64(p_lo, _mm_unpacklo_epi32(p, zero));
+            p_hi = _mm_add_epi64(p_hi, _mm_unpackhi_epi32(p, zero));
+            pi_lo = _mm_add_epi64(pi_lo, _mm_unpacklo_epi32(pi, zero));
+            pi_hi = _mm_add_epi64(pi_hi, _mm_unpackhi_epi32(pi, zero));
+            x_lo = _mm_add_epi64(x_lo, _mm_unpacklo_epi32(iq, iq_sign));
+            x_hi = _mm_add_epi64(x_hi, _mm_unpackhi_epi32(iq, iq_sign));
+            vmin = _mm_min_epi16(vmin, a);
+            vmax = _mm_max_epi16(vmax, a);
+            cl = _mm_sub_epi16(cl, _mm_or_si128(_mm_cmpgt_epi16(a, hi), _mm_cmpgt_epi16(lo, a)));
+        }
+        int32_t t32[4];
+        uint16_t t16[8];
+        _mm_storeu_si128((__m128i *)t32, si);
+        for (int j = 0; j < 4; j++)
+            l.si[j] += t32[j];
+        _mm_storeu_si128((__m128i *)t32, sq);
+        for (int j = 0; j < 4; j++)
+            l.sq[j] += t32[j];
+        _mm_storeu_si128((__m128i *)t16, cl);
+        for (int k = 0; k < 8; k++)
+            l.cl[k] += t16[k];
+    }
+    int16_t t16[8];
+    _mm_storeu_si128((__m128i *)t16, vmin);
+    for (int k = 0; k < 8; k++)
+        l.mn[k] = t16[k];
+    _mm_storeu_si128((__m128i *)t16, vmax);
+    for (int k = 0; k < 8; k++)
+        l.mx[k] = t16[k];
+    _mm_storeu_si128((__m128i *)&l.p[0], p_lo);
+    _mm_storeu_si128((__m128i *)&l.p[2], p_hi);
+    _mm_storeu_si128((__m128i *)&l.pi[0], pi_lo);
+    _mm_storeu_si128((__m128i *)&l.pi[2], pi_hi);
+    _mm_storeu_si128((__m128i *)&l.x[0], x_lo);
+    _mm_storeu_si128((__m128i *)&l.x[2], x_hi);
+    iq_stats_lanes_reduce(&l, 4, ch, nv * per, s);
+    iq_stats_scalar(x + 8 * nv, frames - nv * per, ch, s);
+}
+
+__attribute__((target("avx2"))) static inline void iq_stats_avx2(const int16_t *x, size_t frames, unsigned ch,
+                                                                 iq_stats_sums_t *s) {
+    const size_t per = 8 / ch;
+    const size_t nv = frames / per;
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i keep_i = _mm256_set1_epi32(0xFFFF);
+    const __m256i one_i = _mm256_set1_epi32(1), one_q = _mm256_set1_epi32(1 << 16);
+    const __m256i hi = _mm256_set1_epi16(IQ_STATS_CLIP - 1), lo = _mm256_set1_epi16(-(IQ_STATS_CLIP - 1));
+    __m256i vmin = _mm256_set1_epi16(INT16_MAX), vmax = _mm256_set1_epi16(INT16_MIN);
+    __m256i p_lo = zero, p_hi = zero, pi_lo = zero, pi_hi = zero, x_lo = zero, x_hi = zero;
+    iq_stats_lanes_t l;
+    memset(&l, 0, sizeof(l));
+    for (size_t v0 = 0; v0 < nv; v0 += IQ_STATS_FLUSH) {
+        const size_t v1 = nv - v0 < IQ_STATS_FLUSH ? nv : v0 + IQ_STATS_FLUSH;
+        __m256i si = zero, sq = zero, cl = zero;
+        for (size_t v = v0; v < v1; v++) {
+            const __m256i a = _mm256_loadu_si256((const __m256i *)(x + 16 * v));
+            const __m256i ai = _mm256_and_si256(a, keep_i);
+            const __m256i sw = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(a, 0xB1), 0xB1);
+            si = _mm256_add_epi32(si, _mm256_madd_epi16(a, one_i));
+            sq = _mm256_add_epi32(sq, _mm256_madd_epi16(a, one_q));
+            const __m256i p = _mm256_madd_epi16(a, a);
+            const __m256i pi = _mm256_madd_epi16(ai, ai);
+            const __m256i iq = _mm256_madd_epi16(ai, sw);
+            // 32-bit lanes 0-3 widen into *_lo, 4-7 into *_hi
+            p_lo = _mm256_add_epi64(p_lo, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(p)));
+            p_hi = _mm256_add_epi64(p_hi, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(p, 1)));
+            pi_lo = _mm256_add_epi64(pi_lo, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(pi)));
+            pi_hi = _mm256_add_epi64(pi_hi, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(pi, 1)));
+            x_lo = _mm256_add_epi64(x_lo, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(iq)));
+            x_hi = _mm256_add_epi64(x_hi, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(iq, 1)));
+            vmin = _mm256_min_epi16(vmin, a);
+            vmax = _mm256_max_epi16(vmax, a);
+            cl = _mm256_sub_epi16(cl, _mm256_or_si256(_mm256_cmpgt_epi16(a, hi), _mm256_cmpgt_epi16(lo, a)));
+        }
+        int32_t t32[8];
+        uint16_t t16[16];
+        _mm256_storeu_si256((__m256i *)t32, si);
+        for (int j = 0; j < 8; j++)
+            l.si[j] += t32[j];
+        _mm256_storeu_si256((__m256i *)t32, sq);
+        for (int j = 0; j < 8; j++)
+            l.sq[j] += t32[j];
+        _mm256_storeu_si256((__m256i *)t16, cl);
+        for (int k = 0; k < 16; k++)
+            l.cl[k] += t16[k];
+    }
+    int16_t t16[16];
+    _mm256_storeu_si256((__m256i *)t16, vmin);
+    for (int k = 0; k < 16; k++)
+        l.mn[k] = t16[k];
+    _mm256_storeu_si256((__m256i *)t16, vmax);
+    for (int k = 0; k < 16; k++)
+        l.mx[k] = t16[k];
+    _mm256_storeu_si256((__m256i *)&l.p[0], p_lo);
+    _mm256_storeu_si256((__m256i *)&l.p[4], p_hi);
+    _mm256_storeu_si256((__m256i *)&l.pi[0], pi_lo);
+    _mm256_storeu_si256((__m256i *)&l.pi[4], pi_hi);
+    _mm256_storeu_si256((__m256i *)&l.x[0], x_lo);
+    _mm256_storeu_si256((__m256i *)&l.x[4], x_hi);
+    iq_stats_lanes_reduce(&l, 8, ch, nv * per, s);
+    iq_stats_sse2(x + 16 * nv, frames - nv * per, ch, s);
+}
+
+static inline bool iq_stats_has_sse2(void) { return __builtin_cpu_supports("sse2"); }
+static inline bool iq_stats_has_avx2(void) { return __builtin_cpu_supports("avx2"); }
+#endif
+
+#ifdef IQ_STATS_NEON
+typedef struct {
+    int32x4_t si, sq;
+    uint64x2_t pi, pq;
+    int64x2_t x;
+    int16x8_t mn_i, mx_i, mn_q, mx_q;
+    uint16x8_t cl_i, cl_q;
+} iq_stats_neon_acc_t;
+
+static inline void iq_stats_neon_step(iq_stats_neon_acc_t *a, int16x8_t i, int16x8_t q) {
+    const int16x8_t hi = vdupq_n_s16(IQ_STATS_CLIP - 1), lo = vdupq_n_s16(-(IQ_STATS_CLIP - 1));
+    a->si = vpadalq_s16(a->si, i);
+    a->sq = vpadalq_s16(a->sq, q);
+    a->pi = vpadalq_u32(a->pi, vreinterpretq_u32_s32(vmull_s16(vget_low_s16(i), vget_low_s16(i))));
+    a->pi = vpadalq_u32(a->pi, vreinterpretq_u32_s32(vmull_s16(vget_high_s16(i), vget_high_s16(i))));
+    a->pq = vpadalq_u32(a->pq, vreinterpretq_u32_s32(vmull_s16(vget_low_s16(q), vget_low_s16(q))));
+    a->pq = vpadalq_u32(a->pq, vreinterpretq_u32_s32(vmull_s16(vget_high_s16(q), vget_high_s16(q))));
+    a->x = vpadalq_s32(a->x, vmull_s16(vget_low_s16(i), vget_low_s16(q)));
+    a->x = vpadalq_s32(a->x, vmull_s16(vget_high_s16(i), vget_high_s16(q)));
+    a->mn_i = vminq_s16(a->mn_i, i);
+    a->mx_i = vmaxq_s16(a->mx_i, i);
+    a->mn_q = vminq_s16(a->mn_q, q);
+    a->mx_q = vmaxq_s16(a->mx_q, q);
+    a->cl_i = vsubq_u16(a->cl_i, vorrq_u16(vcgtq_s16(i, hi), vcgtq_s16(lo, i)));
+    a->cl_q = vsubq_u16(a->cl_q, vorrq_u16(vcgtq_s16(q, hi), vcgtq_s16(lo, q)));
+}
+
+// The narrow sums and clip counters of a; the 64-bit ones and min/max go out once at the end.
+static inline void iq_stats_neon_flush(iq_stats_neon_acc_t *a, iq_stats_sums_t *o) {
+    int32_t t32[4];
+    uint16_t t16[8];
+    vst1q_s32(t32, a->si);
+    o->sum[0] += (int64_t)t32[0] + t32[1] + t32[2] + t32[3];
+    vst1q_s32(t32, a->sq);
+    o->sum[1] += (int64_t)t32[0] + t32[1] + t32[2] + t32[3];
+    vst1q_u16(t16, a->cl_i);
+    for (int k = 0; k < 8; k++)
+        o->clips[0] += t16[k];
+    vst1q_u16(t16, a->cl_q);
+    for (int k = 0; k < 8; k++)
+        o->clips[1] += t16[k];
+    a->si = a->sq = vdupq_n_s32(0);
+    a->cl_i = a->cl_q = vdupq_n_u16(0);
+}
+
+static inline void iq_stats_neon_finish(const iq_stats_neon_acc_t *a, size_t frames, iq_stats_sums_t *o) {
+    uint64_t t[2];
+    int64_t sx[2];
+    int16_t t16[8];
+    vst1q_u64(t, a->pi);
+    o->sq[0] += t[0] + t[1];
+    vst1q_u64(t, a->pq);
+    o->sq[1] += t[0] + t[1];
+    vst1q_s64(sx, a->x);
+    o->iq += sx[0] + sx[1];
+    const int16x8_t *mm[4] = {&a->mn_i, &a->mn_q, &a->mx_i, &a->mx_q};
+    for (int m = 0; m < 4; m++) {
+        vst1q_s16(t16, *mm[m]);
+        for (int k = 0; k < 8; k++) {
+            if (m < 2 && t16[k] < o->min[m])
+                o->min[m] = t16[k];
+            if (m >= 2 && t16[k] > o->max[m - 2])
+                o->max[m - 2] = t16[k];
+        }
+    }
+    o->frames += frames;
+}
+
+static inline void iq_stats_neon(const int16_t *x, size_t frames, unsigned ch, iq_stats_sums_t *s) {
+    const size_t nv = frames / 8; // vld2q / vld4q deinterleave 8 frames
+    iq_stats_neon_acc_t acc[IQ_STATS_CH_MAX];
+    for (unsigned c = 0; c < ch; c++) {
+        memset(&acc[c], 0, sizeof(acc[c]));
+        acc[c].mn_i = acc[c].mn_q = vdupq_n_s16(INT16_MAX);
+        acc[c].mx_i = acc[c].mx_q = vdupq_n_s16(INT16_MIN);
+    }
+    for (size_t v0 = 0; v0 < nv; v0 += IQ_STATS_FLUSH) {
+        const size_t v1 = nv - v0 < IQ_STATS_FLUSH ? nv : v0 + IQ_STATS_FLUSH;
+        for (size_t v = v0; v < v1; v++) {
+            if (ch == 1) {
+                const int16x8x2_t a = vld2q_s16(x + 16 * v);
+                iq_stats_neon_step(&acc[0], a.val[0], a.val[1]);
+            } else {
+                const int16x8x4_t a = vld4q_s16(x + 32 * v);
+                iq_stats_neon_step(&acc[0], a.val[0], a.val[1]);
+                iq_stats_neon_step(&acc[1], a.val[2], a.val[3]);
+            }
+        }
+        for (unsigned c = 0; c < ch; c++)
+            iq_stats_neon_flush(&acc[c], &s[c]);
+    }
+    for (unsigned c = 0; c < ch; c++)
+        iq_stats_neon_finish(&acc[c], nv * 8, &s[c]);
+    iq_stats_scalar(x + 16 * ch * nv, frames - nv * 8, ch, s);
+}
+#endif
+
+// Kernels from widest to narrowest; the list ends with the scalar fallback and a NULL entry.
+static inline const iq_stats_kernel_t *iq_stats_kernels(void) {
+    static const iq_stats_kernel_t k[] = {
+#ifdef IQ_STATS_X86
+        {"avx2", iq_stats_avx2, iq_stats_has_avx2},
+        {"sse2", iq_stats_sse2, iq_stats_has_sse2},
+#endif
+#ifdef IQ_STATS_NEON
+        {"neon", iq_stats_neon, iq_stats_always},
+#endif
+        {"scalar", iq_stats_scalar, iq_stats_always},
+        {NULL, NULL, NULL},
+    };
+    return k;
+}
+
+static inline iq_stats_fn iq_stats_select(const char **name) {
+    const iq_stats_kernel_t *k = iq_stats_kernels();
+    while (k->fn != iq_stats_scalar && !k->supported())
+        k++;
+    if (name)
+        *name = k->name;
+    return k->fn;
+}
+
+// ---- Welch spectrum ----
+
+typedef struct {
+    iq_fft_t fft;
+    int n, hop;
+    unsigned ch;
+    float *win;
+    double win_pow; // sum of w^2
+    double *psd;    // ch * n bins, FFT order: sum of |X|^2 over segments
+    uint64_t segs;
+    int16_t *hist; // a segment that spans two feeds
+    int fill;      // frames in hist
+    float *x;      // n complex scratch
+} iq_stats_welch_t;
+
+static inline void iq_stats_welch_free(iq_stats_welch_t *w) {
+    iq_fft_free(&w->fft);
+    free(w->win);
+    free(w->psd);
+    free(w->hist);
+    free(w->x);
+    memset(w, 0, sizeof(*w));
+}
+
+static inline int iq_stats_welch_init(iq_stats_welch_t *w, int n, double overlap, unsigned ch) {
+    memset(w, 0, sizeof(*w));
+    if (iq_fft_init(&w->fft, n, false))
+        return -1;
+    w->n = n;
+    w->hop = (int)lround(n * (1.0 - overlap));
+    if (w->hop < 1)
+        w->hop = 1;
+    if (w->hop > n)
+        w->hop = n;
+    w->ch = ch;
+    w->win = (float *)malloc((size_t)n * sizeof(float));
+    w->psd = (double *)calloc((size_t)ch * n, sizeof(double));
+    w->hist = (int16_t *)malloc((size_t)n * 2 * ch * sizeof(int16_t));
+    w->x = (float *)malloc(2 * (size_t)n * sizeof(float));
+    if (!w->win || !w->psd || !w->hist || !w->x) {
+        iq_stats_welch_free(w);
+        return -1;
+    }
+    for (int j = 0; j < n; j++) {
+        const double v = 0.5 - 0.5 * cos(2.0 * M_PI * j / n);
+        w->win[j] = (float)v;
+        w->win_pow += v * v;
+    }
+    return 0;
+}
+
+// One segment of n frames starting at seg.
+static inline void iq_stats_welch_segment(iq_stats_welch_t *w, const int16_t *seg) {
+    const unsigned lanes = 2 * w->ch;
+    for (unsigned c = 0; c < w->ch; c++) {
+        const int16_t *p = seg + 2 * c;
+        for (int j = 0; j < w->n; j++, p += lanes) {
+            w->x[2 * j] = (float)p[0] * w->win[j];
+            w->x[2 * j + 1] = (float)p[1] * w->win[j];
+        }
+        iq_fft_run(&w->fft, w->x);
+        double *psd = w->psd + (size_t)c * w->n;
+        for (int k = 0; k < w->n; k++)
+            psd[k] += (double)w->x[2 * k] * w->x[2 * k] + (double)w->x[2 * k + 1] * w->x[2 * k + 1];
+    }
+    w->segs++;
+}
+
+static inline void iq_stats_welch_feed(iq_stats_welch_t *w, const int16_t *x, size_t frames) {
+    const size_t lanes = 2 * w->ch, n = (size_t)w->n, hop = (size_t)w->hop;
+    // hist holds the first `fill` frames of the next segment and x continues right after them
+    while (w->fill) {
+        const size_t have = (size_t)w->fill;
+        if (have + frames < n) {
+            memcpy(w->hist + have * lanes, x, frames * lanes * sizeof(int16_t));
+            w->fill += (int)frames;
+            return;
+        }
+        memcpy(w->hist + have * lanes, x, (n - have) * lanes * sizeof(int16_t));
+        iq_stats_welch_segment(w, w->hist);
+        if (hop < have) {
+            memmove(w->hist, w->hist + hop * lanes, (have - hop) * lanes * sizeof(int16_t));
+            w->fill = (int)(have - hop);
+        } else { // the next segment starts inside x
+            x += (hop - have) * lanes;
+            frames -= hop - have;
+            w->fill = 0;
+        }
+    }
+    size_t pos = 0;
+    for (; pos + n <= frames; pos += hop)
+        iq_stats_welch_segment(w, x + pos * lanes);
+    memcpy(w->hist, x + pos * lanes, (frames - pos) * lanes * sizeof(int16_t));
+    w->fill = (int)(frames - pos);
+}
+
+// Bin power as a fraction of a full-scale complex tone (sum over bins = mean |x|^2 / 32768^2).
+static inline double iq_stats_welch_bin(const iq_stats_welch_t *w, unsigned c, int k) {
+    const int n = w->n;
+    k = ((k % n) + n) % n;
+    if (!w->segs)
+        return 0.0;
+    return w->psd[(size_t)c * n + k] / ((double)w->segs * n * w->win_pow * 32768.0 * 32768.0);
+}
+
+// ---- block and total statistics ----
+
+typedef struct {
+    uint64_t start;                 // stream frame index of the first frame
+    float rms_db[IQ_STATS_CH_MAX];  // mean of the I and Q RMS, dBFS
+    float peak_db[IQ_STATS_CH_MAX]; // max |I|, |Q|, dBFS
+    uint32_t clips[IQ_STATS_CH_MAX];
+} iq_stats_block_t;
+
+typedef struct {
+    unsigned ch;
+    double fs;
+    size_t block_frames;
+    iq_stats_fn fn;
+    const char *kernel;
+    iq_stats_sums_t total[IQ_STATS_CH_MAX];
+    iq_stats_sums_t cur[IQ_STATS_CH_MAX]; // the block being filled
+    iq_stats_block_t *blocks;
+    size_t nblocks, cap;
+    uint64_t pos, cur_start;   // stream index of the next frame / of the block being filled
+    uint64_t gaps, gap_frames; // holes in the stream (iq_stats_feed_at), frames missing
+    iq_stats_welch_t welch; // n == 0: no spectrum
+} iq_stats_t;
+
+static inline void iq_stats_free(iq_stats_t *s) {
+    free(s->blocks);
+    iq_stats_welch_free(&s->welch);
+    memset(s, 0, sizeof(*s));
+}
+
+// nfft 0 turns the spectrum off; overlap is the Welch segment overlap (0 .. 0.9).
+static inline int iq_stats_init(iq_stats_t *s, unsigned ch, double fs, size_t block_frames, int nfft, double overlap) {
+    memset(s, 0, sizeof(*s));
+    if (ch < 1 || ch > IQ_STATS_CH_MAX || block_frames < 1)
+        return -1;
+    s->ch = ch;
+    s->fs = fs;
+    s->block_frames = block_frames;
+    s->fn = iq_stats_select(&s->kernel);
+    for (unsigned c = 0; c < ch; c++) {
+        iq_stats_sums_reset(&s->total[c]);
+        iq_stats_sums_reset(&s->cur[c]);
+    }
+    if (nfft && iq_stats_welch_init(&s->welch, nfft, overlap, ch)) {
+        fprintf(stderr, "stats: bad FFT size %d (power of two >= 4)\n", nfft);
+        iq_stats_free(s);
+        return -1;
+    }
+    return 0;
+}
+
+static inline double iq_stats_db(double lin_pow) { return lin_pow > 0.0 ? 10.0 * log10(lin_pow) : -999.0; }
+
+static inline void iq_stats_close_block(iq_stats_t *s) {
+    if (!s->cur[0].frames)
+        return;
+    if (s->nblocks == s->cap) {
+        const size_t cap = s->cap ? 2 * s->cap : 1024;
+        iq_stats_block_t *b = (iq_stats_block_t *)realloc(s->blocks, cap * sizeof(*b));
+        if (!b)
+            return; // totals still count it; only the block table loses an entry
+        s->blocks = b;
+        s->cap = cap;
+    }
+    iq_stats_block_t *b = &s->blocks[s->nblocks++];
+    memset(b, 0, sizeof(*b));
+    b->start = s->cur_start;
+    for (unsigned c = 0; c < s->ch; c++) {
+        iq_stats_sums_t *u = &s->cur[c];
+        const double fs2 = 32768.0 * 32768.0;
+        const double rms = 0.5 * (sqrt((double)u->sq[0] / u->frames) + sqrt((double)u->sq[1] / u->frames));
+        int32_t pk = u->max[0] > -u->min[0] ? u->max[0] : -u->min[0];
+        if (u->max[1] > pk)
+            pk = u->max[1];
+        if (-u->min[1] > pk)
+            pk = -u->min[1];
+        b->rms_db[c] = (float)iq_stats_db(rms * rms / fs2);
+        b->peak_db[c] = (float)iq_stats_db((double)pk * pk / fs2);
+        b->clips[c] = (uint32_t)(u->clips[0] + u->clips[1]);
+        iq_stats_sums_add(&s->total[c], u);
+        iq_stats_sums_reset(u);
+    }
+}
+
+static inline void iq_stats_feed(iq_stats_t *s, const int16_t *x, size_t frames) {
+    if (s->welch.n)
+        iq_stats_welch_feed(&s->welch, x, frames);
+    while (frames) {
+        if (!s->cur[0].frames)
+            s->cur_start = s->pos;
+        size_t n = s->block_frames - (size_t)s->cur[0].frames;
+        if (n > frames)
+            n = frames;
+        s->fn(x, n, s->ch, s->cur);
+        s->pos += n;
+        x += n * 2 * s->ch;
+        frames -= n;
+        if (s->cur[0].frames == s->block_frames)
+            iq_stats_close_block(s);
+    }
+}
+
+// Like iq_stats_feed() for x starting at stream frame pos. When frames were skipped since the last
+// call, the partial block is closed and the Welch segment restarted so neither spans the hole.
+static inline void iq_stats_feed_at(iq_stats_t *s, const int16_t *x, size_t frames, uint64_t pos) {
+    if (pos != s->pos) {
+        iq_stats_close_block(s);
+        s->welch.fill = 0;
+        s->gaps++;
+        s->gap_frames += pos > s->pos ? pos - s->pos : 0;
+        s->pos = pos;
+    }
+    iq_stats_feed(s, x, frames);
+}
+
+// Closes the last partial block; call before reading the totals or merging.
+static inline void iq_stats_finish(iq_stats_t *s) { iq_stats_close_block(s); }
+
+// Appends src (the range right after dst's) to dst.
+static inline int iq_stats_merge(iq_stats_t *dst, const iq_stats_t *src) {
+    for (unsigned c = 0; c < dst->ch; c++)
+        iq_stats_sums_add(&dst->total[c], &src->total[c]);
+    if (src->nblocks) {
+        if (dst->nblocks + src->nblocks > dst->cap) {
+            const size_t cap = dst->nblocks + src->nblocks;
+            iq_stats_block_t *b = (iq_stats_block_t *)realloc(dst->blocks, cap * sizeof(*b));
+            if (!b)
+                return -1;
+            dst->blocks = b;
+            dst->cap = cap;
+        }
+        memcpy(dst->blocks + dst->nblocks, src->blocks, src->nblocks * sizeof(*src->blocks));
+        for (size_t b = dst->nblocks; b < dst->nblocks + src->nblocks; b++)
+            dst->blocks[b].start += dst->pos;
+        dst->nblocks += src->nblocks;
+    }
+    dst->pos += src->pos;
+    dst->gaps += src->gaps;
+    dst->gap_frames += src->gap_frames;
+    if (dst->welch.n && src->welch.n == dst->welch.n) {
+        for (size_t k = 0; k < (size_t)dst->ch * dst->welch.n; k++)
+            dst->welch.psd[k] += src->welch.psd[k];
+        dst->welch.segs += src->welch.segs;
+    }
+    return 0;
+}
+
+// ---- derived figures ----
+
+typedef struct {
+    double mean[2];              // DC, fraction of FS
+    double rms_db[2], peak_db[2]; // dBFS per component, as wav_file_analyze.py
+    uint64_t clips[2];
+    double corr;         // I/Q correlation coefficient
+    double imbalance_db; // 20 log10(rms I / rms Q)
+    // spectrum (when Welch ran)
+    double pos_pow, neg_pow; // outside the DC guard, fraction of FS^2
+    double tone_hz, tone_db; // strongest non-DC component, dBFS (complex amplitude)
+    double image_dbc;        // its mirror at -tone_hz, relative to it
+    double obw_hz;           // 99 % power bandwidth
+    // blocks
+    double blk_rms_min, blk_rms_med, blk_rms_max;
+    size_t clipped_blocks, first_clip_block, loudest_block;
+} iq_stats_report_t;
+
+static inline int iq_stats_cmp_float(const void *a, const void *b) {
+    const float x = *(const float *)a, y = *(const float *)b;
+    return (x > y) - (x < y);
+}
+
+static inline void iq_stats_report(const iq_stats_t *s, unsigned c, iq_stats_report_t *r) {
+    memset(r, 0, sizeof(*r));
+    const iq_stats_sums_t *t = &s->total[c];
+    const double n = t->frames ? (double)t->frames : 1.0;
+    double var[2];
+    for (int k = 0; k < 2; k++) {
+        const double mean = (double)t->sum[k] / n;
+        r->mean[k] = mean / 32768.0;
+        r->rms_db[k] = iq_stats_db((double)t->sq[k] / n / (32768.0 * 32768.0));
+        const int32_t pk = t->max[k] > -t->min[k] ? t->max[k] : -t->min[k];
+        r->peak_db[k] = t->frames ? iq_stats_db((double)pk * pk / (32768.0 * 32768.0)) : -999.0;
+        r->clips[k] = t->clips[k];
+        var[k] = (double)t->sq[k] / n - mean * mean;
+    }
+    const double cov = (double)t->iq / n - ((double)t->sum[0] / n) * ((double)t->sum[1] / n);
+    r->corr = var[0] > 0.0 && var[1] > 0.0 ? cov / sqrt(var[0] * var[1]) : 0.0;
+    r->imbalance_db = t->sq[1] ? 10.0 * log10((double)t->sq[0] / (double)t->sq[1]) : 0.0;
+
+    const iq_stats_welch_t *w = &s->welch;
+    if (w->n && w->segs) {
+        const int N = w->n;
+        double best = -1.0, total = 0.0;
+        int kbest = 0;
+        for (int k = 1; k < N; k++) {
+            const double p = iq_stats_welch_bin(w, c, k);
+            const int f = k < N / 2 ? k : k - N; // signed bin
+            total += p;
+            if (f > IQ_STATS_DC_GUARD)
+                r->pos_pow += p;
+            else if (f < -IQ_STATS_DC_GUARD)
+                r->neg_pow += p;
+            if ((f > IQ_STATS_DC_GUARD || f < -IQ_STATS_DC_GUARD) && p > best) {
+                best = p;
+                kbest = f;
+            }
+        }
+        total += iq_stats_welch_bin(w, c, 0);
+        double tone = 0.0, image = 0.0;
+        for (int d = -IQ_STATS_PEAK_BINS; d <= IQ_STATS_PEAK_BINS; d++) {
+            tone += iq_stats_welch_bin(w, c, kbest + d);
+            image += iq_stats_welch_bin(w, c, -kbest + d);
+        }
+        r->tone_hz = kbest * s->fs / N;
+        r->tone_db = iq_stats_db(tone);
+        r->image_dbc = tone > 0.0 ? iq_stats_db(image / tone) : 0.0;
+        // 99 %: grow symmetrically-in-power from the band edges (0.5 % cut off each side)
+        double lo = 0.0, hi = 0.0;
+        int klo = -N / 2, khi = N / 2 - 1;
+        while (klo < khi && lo + iq_stats_welch_bin(w, c, klo) <= 0.005 * total)
+            lo += iq_stats_welch_bin(w, c, klo++);
+        while (khi > klo && hi + iq_stats_welch_bin(w, c, khi) <= 0.005 * total)
+            hi += iq_stats_welch_bin(w, c, khi--);
+        r->obw_hz = (khi - klo + 1) * s->fs / N;
+    }
+
+    if (s->nblocks) {
+        float *v = (float *)malloc(s->nblocks * sizeof(float));
+        r->first_clip_block = (size_t)-1;
+        for (size_t b = 0; b < s->nblocks; b++) {
+            if (v)
+                v[b] = s->blocks[b].rms_db[c];
+            if (s->blocks[b].clips[c]) {
+                if (!r->clipped_blocks)
+                    r->first_clip_block = b;
+                r->clipped_blocks++;
+            }
+            if (s->blocks[b].rms_db[c] > s->blocks[r->loudest_block].rms_db[c])
+                r->loudest_block = b;
+        }
+        if (v) {
+            qsort(v, s->nblocks, sizeof(float), iq_stats_cmp_float);
+            r->blk_rms_min = v[0];
+            r->blk_rms_med = v[s->nblocks / 2];
+            r->blk_rms_max = v[s->nblocks - 1];
+            free(v);
+        }
+    }
+}
+
+static inline double iq_stats_block_s(const iq_stats_t *s, size_t b) { return (double)s->blocks[b].start / s->fs; }
+
+// Compact human-readable summary, one paragraph per channel.
+static inline void iq_stats_print(const iq_stats_t *s, FILE *f) {
+    static const char *const names[IQ_STATS_CH_MAX] = {"A", "B"};
+    for (unsigned c = 0; c < s->ch; c++) {
+        iq_stats_report_t r;
+        iq_stats_report(s, c, &r);
+        const char *tag = s->ch > 1 ? names[c] : "";
+        for (int k = 0; k < 2; k++)
+            fprintf(f, "%s%s: mean=%+.5f, RMS=%6.2f dBFS, peak=%6.2f dBFS, clipped=%" PRIu64 "\n", k ? "Q" : "I", tag,
+                    r.mean[k], r.rms_db[k], r.peak_db[k], r.clips[k]);
+        fprintf(f, "I/Q%s: corr=%+.4f, gain imbalance %+.3f dB\n", tag, r.corr, r.imbalance_db);
+        if (s->nblocks) {
+            fprintf(f, "blocks%s: %zu x %.1f ms, RMS min/median/max %.2f/%.2f/%.2f dBFS, loudest at %.3f s, ", tag,
+                    s->nblocks, 1e3 * s->block_frames / s->fs, r.blk_rms_min, r.blk_rms_med, r.blk_rms_max,
+                    iq_stats_block_s(s, r.loudest_block));
+            if (r.clipped_blocks)
+                fprintf(f, "%zu clipped (first at %.3f s)\n", r.clipped_blocks,
+                        iq_stats_block_s(s, r.first_clip_block));
+            else
+                fprintf(f, "none clipped\n");
+        }
+        if (s->welch.segs) {
+            fprintf(f,
+                    "spectrum%s: Welch %d-pt Hann, %" PRIu64 " segments, pos/neg power %.3e / %.3e (%+.2f dB), "
+                    "99%% BW %.3f kHz\n",
+                    tag, s->welch.n, s->welch.segs, r.pos_pow, r.neg_pow,
+                    r.neg_pow > 0.0 ? 10.0 * log10(r.pos_pow / r.neg_pow) : 0.0, r.obw_hz / 1e3);
+            fprintf(f, "tone%s: %+.3f kHz at %.2f dBFS, image at %+.3f kHz %.2f dBc\n", tag, r.tone_hz / 1e3, r.tone_db,
+                    -r.tone_hz / 1e3, r.image_dbc);
+        }
+    }
+    if (s->gaps)
+        fprintf(f, "gaps: %" PRIu64 ", %.3f s not analyzed\n", s->gaps, s->gap_frames / s->fs);
+}
+
+// One JSON object (no newline) for scripts.
+static inline void iq_stats_json(const iq_stats_t *s, FILE *f) {
+    fprintf(f, "{\"sample_rate\":%.0f,\"channels\":%u,\"frames\":%" PRIu64 ",\"kernel\":\"%s\",\"block_frames\":%zu,"
+               "\"fft\":%d,\"segments\":%" PRIu64 ",\"gaps\":%" PRIu64 ",\"gap_frames\":%" PRIu64 ",\"ch\":[",
+            s->fs, s->ch, s->total[0].frames, s->kernel, s->block_frames, s->welch.n, s->welch.segs, s->gaps,
+            s->gap_frames);
+    for (unsigned c = 0; c < s->ch; c++) {
+        iq_stats_report_t r;
+        iq_stats_report(s, c, &r);
+        fprintf(f,
+                "%s{\"mean_i\":%.6f,\"mean_q\":%.6f,\"rms_i_dbfs\":%.3f,\"rms_q_dbfs\":%.3f,\"peak_i_dbfs\":%.3f,"
+                "\"peak_q_dbfs\":%.3f,\"clips_i\":%" PRIu64 ",\"clips_q\":%" PRIu64 ",\"corr\":%.5f,"
+                "\"imbalance_db\":%.4f,"
+                "\"block_rms_dbfs\":[%.3f,%.3f,%.3f],\"clipped_blocks\":%zu",
+                c ? "," : "", r.mean[0], r.mean[1], r.rms_db[0], r.rms_db[1], r.peak_db[0], r.peak_db[1], r.clips[0],
+                r.clips[1], r.corr, r.imbalance_db, r.blk_rms_min, r.blk_rms_med, r.blk_rms_max, r.clipped_blocks);
+        if (s->welch.segs)
+            fprintf(f, ",\"pos_pow\":%.6e,\"neg_pow\":%.6e,\"tone_hz\":%.1f,\"tone_dbfs\":%.3f,\"image_dbc\":%.3f,"
+                       "\"obw99_hz\":%.1f",
+                    r.pos_pow, r.neg_pow, r.tone_hz, r.tone_db, r.image_dbc, r.obw_hz);
+        fputc('}', f);
+    }
+    fputs("]}", f);
+}
+
+// Per-block table: time, then RMS dBFS, peak dBFS and clip count per channel.
+static inline void iq_stats_blocks_csv(const iq_stats_t *s, FILE *f) {
+    fputs("t_s", f);
+    for (unsigned c = 0; c < s->ch; c++)
+        fprintf(f, ",rms_dbfs_%u,peak_dbfs_%u,clips_%u", c, c, c);
+    fputc('\n', f);
+    for (size_t b = 0; b < s->nblocks; b++) {
+        fprintf(f, "%.6f", iq_stats_block_s(s, b));
+        for (unsigned c = 0; c < s->ch; c++)
+            fprintf(f, ",%.2f,%.2f,%u", s->blocks[b].rms_db[c], s->blocks[b].peak_db[c], s->blocks[b].clips[c]);
+        fputc('\n', f);
+    }
+}
+
+// ---- inline tap on a TX path ----
+
+typedef struct {
+    iq_stats_t st;
+    iq_ring_t ring;
+    size_t max_frames;
+    pthread_t th;
+    bool started;
+    atomic_bool stop;
+    atomic_uint_fast64_t dropped; // chunks the tap was too busy for
+    uint64_t pushed;              // stream frames offered, dropped ones included (stream thread only)
+} iq_stats_tap_t;
+
+static inline void *iq_stats_tap_worker(void *arg) {
+    iq_stats_tap_t *t = (iq_stats_tap_t *)arg;
+    for (;;) {
+        const iq_slot_t *slot = NULL;
+        const int16_t *src = iq_ring_peek(&t->ring, &slot);
+        if (!src) {
+            if (atomic_load_explicit(&t->stop, memory_order_acquire) && !iq_ring_fill(&t->ring))
+                break;
+            iq_ring_pause(200000);
+            continue;
+        }
+        iq_stats_feed_at(&t->st, src, slot->frames, slot->pos);
+        iq_ring_release(&t->ring);
+    }
+    return NULL;
+}
+
+// max_frames: the largest chunk iq_stats_tap_push() will see. Start it before tx_rt_enter().
+static inline int iq_stats_tap_start(iq_stats_tap_t *t, unsigned ch, double fs, size_t max_frames, size_t block_frames,
+                                     int nfft) {
+    memset(t, 0, sizeof(*t));
+    if (iq_stats_init(&t->st, ch, fs, block_frames, nfft, 0.5))
+        return -1;
+    if (iq_ring_init(&t->ring, IQ_STATS_TAP_DEPTH, max_frames * 2 * ch, NULL)) {
+        iq_stats_free(&t->st);
+        return -1;
+    }
+    t->max_frames = max_frames;
+    atomic_init(&t->stop, false);
+    atomic_init(&t->dropped, 0);
+    if (pthread_create(&t->th, NULL, iq_stats_tap_worker, t)) {
+        fprintf(stderr, "stats: failed to start the tap thread\n");
+        iq_ring_free(&t->ring);
+        iq_stats_free(&t->st);
+        return -1;
+    }
+    t->started = true;
+    return 0;
+}
+
+// Stream thread: copy a sent chunk in, or count it dropped. Never blocks.
+static inline void iq_stats_tap_push(iq_stats_tap_t *t, const int16_t *x, size_t frames) {
+    if (!t->started || !frames)
+        return;
+    const uint64_t pos = t->pushed;
+    t->pushed += frames;
+    iq_slot_t *slot = NULL;
+    int16_t *dst = iq_ring_acquire(&t->ring, &slot);
+    if (!dst || frames > t->max_frames) {
+        atomic_fetch_add_explicit(&t->dropped, 1, memory_order_relaxed);
+        return;
+    }
+    memcpy(dst, x, frames * 2 * t->st.ch * sizeof(int16_t));
+    slot->frames = frames;
+    slot->eof = false;
+    slot->pos = pos;
+    iq_ring_publish(&t->ring);
+}
+
+// Drains what is queued, joins the worker and closes the last block; st stays readable until free.
+static inline void iq_stats_tap_stop(iq_stats_tap_t *t) {
+    if (!t->started)
+        return;
+    atomic_store_explicit(&t->stop, true, memory_order_release);
+    pthread_join(t->th, NULL);
+    t->started = false;
+    iq_stats_finish(&t->st);
+}
+
+static inline void iq_stats_tap_free(iq_stats_tap_t *t) {
+    iq_stats_tap_stop(t);
+    iq_ring_free(&t->ring);
+    iq_stats_free(&t->st);
+}
+
+#endif
@@ -0,0 +1,526 @@
+#ifndef IQ_TONE_H
+#define IQ_TONE_H
+
+// Multi-tone complex baseband generator for interleaved int16 I/Q.
+// Every tone is a 32-bit phase accumulator; sin/cos come from a degree-9 odd polynomial on the
+// folded phase (|error| < 4e-6), evaluated 8 (AVX2+FMA) or 4 (SSE2/NEON) samples at a time into
+// float I/Q accumulators. Tones at whole-Hz frequencies are resynced from the sample counter
+// every IQ_TONE_RESYNC frames, so they never drift. Sweeps step their increment every
+// IQ_TONE_SWEEP_SEG frames along a linear f0 -> f1 ramp and wrap back to f0.
+//
+// The int16 gain is crest-factor aware: the peak of I and Q is measured on the actual tone set
+// (one period if it is periodic, a probe window otherwise) and mapped to the requested fraction
+// of full scale. A periodic tone set is rendered once into a period-aligned buffer, so the
+// steady state only hands out pointers into it. With a cache directory that buffer is also kept
+// on disk (iq_wfcache.h), keyed by every parameter it depends on, so a restart skips rendering
+// and measuring it.
+
+#include "iq_scale.h"
+#include "iq_wfcache.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define IQ_TONE_MAX 16
+#define IQ_TONE_MAX_PERIOD (1u << 22) // frames; longer periods are rendered live
+#define IQ_TONE_RESYNC 4096
+#define IQ_TONE_SWEEP_SEG 64
+#define IQ_TONE_PROBE_FRAMES (1u << 18)
+
+typedef struct {
+    double freq_hz;  // start frequency for a sweep; negative = below the carrier
+    double amp;      // linear, relative to the other tones
+    double phase_deg;
+    double sweep_to_hz; // sweep end frequency (used when sweep_s > 0)
+    double sweep_s;     // sweep duration, 0 = fixed tone
+} iq_tone_t;
+
+typedef struct {
+    iq_tone_t t;
+    float amp;
+    uint32_t ph, inc, ph0;
+    bool exact;     // whole-Hz fixed tone: phase recomputed from the sample counter
+    uint64_t f_mod; // freq mod fs, in [0, fs), when exact
+    uint64_t sweep_len, sweep_pos;
+} iq_tone_osc_t;
+
+typedef void (*iq_tone_fn)(float *acc_i, float *acc_q, size_t n, uint32_t ph, uint32_t inc, float amp);
+
+typedef struct {
+    iq_tone_osc_t osc[IQ_TONE_MAX];
+    int n;
+    double fs;
+    uint64_t fs_int; // fs in Hz when it is a whole number, else 0
+    uint64_t count;  // frames rendered since the last reset
+    float *acc_i, *acc_q;
+    size_t cap;
+    iq_tone_fn fn;
+    const char *kernel;
+    float gain; // float sum -> int16
+    double peak, env_peak, rms;
+} iq_tone_gen_t;
+
+// sin(2*pi*x), x in [-0.25, 0.25]
+#define IQ_TONE_C1 6.2831853071795865f
+#define IQ_TONE_C3 -41.341702240399760f
+#define IQ_TONE_C5 81.605249276075042f
+#define IQ_TONE_C7 -76.705859753061385f
+#define IQ_TONE_C9 42.058693944897655f
+
+static inline float iq_tone_sin_turn(uint32_t ph) {
+    float t = (float)(int32_t)ph * (1.0f / 4294967296.0f); // [-0.5, 0.5)
+    float x = fminf(t, 0.5f - t);
+    x = fmaxf(x, -0.5f - x);
+    const float x2 = x * x;
+    return x * (IQ_TONE_C1 + x2 * (IQ_TONE_C3 + x2 * (IQ_TONE_C5 + x2 * (IQ_TONE_C7 + x2 * IQ_TONE_C9))));
+}
+
+static inline void iq_tone_c(float *acc_i, float *acc_q, size_t n, uint32_t ph, uint32_t inc, float amp) {
+    for (size_t i = 0; i < n; i++) {
+        acc_i[i] += amp * iq_tone_sin_turn(ph + 0x40000000u);
+        acc_q[i] += amp * iq_tone_sin_turn(ph);
+        ph += inc;
+    }
+}
+
+#ifdef IQ_SCALE_X86
+__attribute__((target("sse2"))) static inline __m128 iq_tone_sin_sse2(__m128i ph) {
+    const __m128 t = _mm_mul_ps(_mm_cvtepi32_ps(ph), _mm_set1_ps(1.0f / 4294967296.0f));
+    __m128 x = _mm_min_ps(t, _mm_sub_ps(_mm_set1_ps(0.5f), t));
+    x = _mm_max_ps(x, _mm_sub_ps(_mm_set1_ps(-0.5f), x));
+    const __m128 x2 = _mm_mul_ps(x, x);
+    __m128 p = _mm_add_ps(_mm_set1_ps(IQ_TONE_C7), _mm_mul_ps(x2, _mm_set1_ps(IQ_TONE_C9)));
+    p = _mm_add_ps(_mm_set1_ps(IQ_TONE_C5), _mm_mul_ps(x2, p));
+    p = _mm_add_ps(_mm_set1_ps(IQ_TONE_C3), _mm_mul_ps(x2, p));
+    p = _mm_add_ps(_mm_set1_ps(IQ_TONE_C1), _mm_mul_ps(x2, p));
+    return _mm_mul_ps(x, p);
+}
+
+__attribute__((target("sse2"))) static inline void iq_tone_sse2(float *acc_i, float *acc_q, size_t n, uint32_t ph,
+                                                                uint32_t inc, float amp) {
+    const __m128 a = _mm_set1_ps(amp);
+    const __m128i quarter = _mm_set1_epi32(0x40000000);
+    const __m128i step = _mm_set1_epi32((int32_t)(4u * inc));
+    __m128i p = _mm_setr_epi32((int32_t)ph, (int32_t)(ph + inc), (int32_t)(ph + 2u * inc), (int32_t)(ph + 3u * inc));
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 c = iq_tone_sin_sse2(_mm_add_epi32(p, quarter));
+        __m128 s = iq_tone_sin_sse2(p);
+        _mm_storeu_ps(acc_i + i, _mm_add_ps(_mm_loadu_ps(acc_i + i), _mm_mul_ps(a, c)));
+        _mm_storeu_ps(acc_q + i, _mm_add_ps(_mm_loadu_ps(acc_q + i), _mm_mul_ps(a, s)));
+        p = _mm_add_epi32(p, step);
+    }
+    iq_tone_c(acc_i + i, acc_q + i, n - i, ph + (uint32_t)i * inc, inc, amp);
+}
+
+__attribute__((target("avx2,fma"))) static inline __m256 iq_tone_sin_avx2(__m256i ph) {
+    const __m256 t = _mm256_mul_ps(_mm256_cvtepi32_ps(ph), _mm256_set1_ps(1.0f / 4294967296.0f));
+    __m256 x = _mm256_min_ps(t, _mm256_sub_ps(_mm256_set1_ps(0.5f), t));
+    x = _mm256_max_ps(x, _mm256_sub_ps(_mm256_set1_ps(-0.5f), x));
+    const __m256 x2 = _mm256_mul_ps(x, x);
+    __m256 p = _mm256_fmadd_ps(x2, _mm256_set1_ps(IQ_TONE_C9), _mm256_set1_ps(IQ_TONE_C7));
+    p = _mm256_fmadd_ps(x2, p, _mm256_set1_ps(IQ_TONE_C5));
+    p = _mm256_fmadd_ps(x2, p, _mm256_set1_ps(IQ_TONE_C3));
+    p = _mm256_fmadd_ps(x2, p, _mm256_set1_ps(IQ_TONE_C1));
+    return _mm256_mul_ps(x, p);
+}
+
+__attribute__((target("avx2,fma"))) static inline void iq_tone_avx2(float *acc_i, float *acc_q, size_t n,
+                                                                    uint32_t ph, uint32_t inc, float amp) {
+    const __m256 a = _mm256_set1_ps(amp);
+    const __m256i quarter = _mm256_set1_epi32(0x40000000);
+    const __m256i step = _mm256_set1_epi32((int32_t)(8u * inc));
+    __m256i p = _mm256_add_epi32(_mm256_set1_epi32((int32_t)ph),
+                                 _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                                    _mm256_set1_epi32((int32_t)inc)));
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 c = iq_tone_sin_avx2(_mm256_add_epi32(p, quarter));
+        __m256 s = iq_tone_sin_avx2(p);
+        _mm256_storeu_ps(acc_i + i, _mm256_fmadd_ps(a, c, _mm256_loadu_ps(acc_i + i)));
+        _mm256_storeu_ps(acc_q + i, _mm256_fmadd_ps(a, s, _mm256_loadu_ps(acc_q + i)));
+        p = _mm256_add_epi32(p, step);
+    }
+    iq_tone_c(acc_i + i, acc_q + i, n - i, ph + (uint32_t)i * inc, inc, amp);
+}
+#endif
+
+#ifdef IQ_SCALE_NEON
+static inline float32x4_t iq_tone_sin_neon(uint32x4_t ph) {
+    const float32x4_t t = vmulq_n_f32(vcvtq_f32_s32(vreinterpretq_s32_u32(ph)), 1.0f / 4294967296.0f);
+    float32x4_t x = vminq_f32(t, vsubq_f32(vdupq_n_f32(0.5f), t));
+    x = vmaxq_f32(x, vsubq_f32(vdupq_n_f32(-0.5f), x));
+    const float32x4_t x2 = vmulq_f32(x, x);
+    float32x4_t p = vmlaq_n_f32(vdupq_n_f32(IQ_TONE_C7), x2, IQ_TONE_C9);
+    p = vmlaq_f32(vdupq_n_f32(IQ_TONE_C5), x2, p);
+    p = vmlaq_f32(vdupq_n_f32(IQ_TONE_C3), x2, p);
+    p = vmlaq_f32(vdupq_n_f32(IQ_TONE_C1), x2, p);
+    return vmulq_f32(x, p);
+}
+
+static inline void iq_tone_neon(float *acc_i, float *acc_q, size_t n, uint32_t ph, uint32_t inc, float amp) {
+    const uint32_t init[4] = {ph, ph + inc, ph + 2u * inc, ph + 3u * inc};
+    const uint32x4_t quarter = vdupq_n_u32(0x40000000u);
+    const uint32x4_t step = vdupq_n_u32(4u * inc);
+    uint32x4_t p = vld1q_u32(init);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        vst1q_f32(acc_i + i, vmlaq_n_f32(vld1q_f32(acc_i + i), iq_tone_sin_neon(vaddq_u32(p, quarter)), amp));
+        vst1q_f32(acc_q + i, vmlaq_n_f32(vld1q_f32(acc_q + i), iq_tone_sin_neon(p), amp));
+        p = vaddq_u32(p, step);
+    }
+    iq_tone_c(acc_i + i, acc_q + i, n - i, ph + (uint32_t)i * inc, inc, amp);
+}
+#endif
+
+static inline iq_tone_fn iq_tone_select(const char **name) {
+    const char *n = "c";
+    iq_tone_fn fn = iq_tone_c;
+#ifdef IQ_SCALE_X86
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        n = "avx2";
+        fn = iq_tone_avx2;
+    } else if (__builtin_cpu_supports("sse2")) {
+        n = "sse2";
+        fn = iq_tone_sse2;
+    }
+#elif defined(IQ_SCALE_NEON)
+    n = "neon";
+    fn = iq_tone_neon;
+#endif
+    if (name)
+        *name = n;
+    return fn;
+}
+
+// "freq[:amp_dB[:phase_deg]]" or, for a sweep, "f0~f1/seconds[:amp_dB[:phase_deg]]".
+// Frequencies take k/M suffixes (limetx_parse_hz) through the parse_hz callback.
+static inline bool iq_tone_parse(const char *s, bool (*parse_hz)(const char *, double *), iq_tone_t *out) {
+    char tmp[128];
+    snprintf(tmp, sizeof(tmp), "%s", s);
+    memset(out, 0, sizeof(*out));
+    out->amp = 1.0;
+
+    char *amp = strchr(tmp, ':');
+    if (amp) {
+        *amp++ = '\0';
+        char *ph = strchr(amp, ':');
+        if (ph) {
+            *ph++ = '\0';
+            out->phase_deg = strtod(ph, NULL);
+        }
+        if (*amp)
+            out->amp = pow(10.0, strtod(amp, NULL) / 20.0);
+    }
+    char *to = strchr(tmp, '~');
+    if (to) {
+        *to++ = '\0';
+        char *dur = strchr(to, '/');
+        if (!dur)
+            return false;
+        *dur++ = '\0';
+        out->sweep_s = strtod(dur, NULL);
+        if (out->sweep_s <= 0.0 || !parse_hz(to, &out->sweep_to_hz))
+            return false;
+    }
+    return parse_hz(tmp, &out->freq_hz);
+}
+
+static inline uint32_t iq_tone_inc(double f_hz, double fs) {
+    double r = f_hz / fs;
+    r -= floor(r);
+    return (uint32_t)(uint64_t)llround(r * 4294967296.0);
+}
+
+// Exact phase of a whole-Hz tone after `count` frames.
+static inline uint32_t iq_tone_exact_ph(const iq_tone_osc_t *o, uint64_t fs, uint64_t count) {
+    const unsigned __int128 turns = (unsigned __int128)o->f_mod * (count % fs) % fs;
+    return o->ph0 + (uint32_t)((turns << 32) / fs);
+}
+
+static inline void iq_tone_reset(iq_tone_gen_t *g) {
+    g->count = 0;
+    for (int k = 0; k < g->n; k++) {
+        iq_tone_osc_t *o = &g->osc[k];
+        o->ph = o->ph0;
+        o->sweep_pos = 0;
+        o->inc = iq_tone_inc(o->t.freq_hz, g->fs);
+    }
+}
+
+static inline void iq_tone_free(iq_tone_gen_t *g) {
+    free(g->acc_i);
+    free(g->acc_q);
+    memset(g, 0, sizeof(*g));
+}
+
+// cap = largest chunk rendered at once (frames)
+static inline int iq_tone_init(iq_tone_gen_t *g, const iq_tone_t *tones, int n, double fs, size_t cap) {
+    memset(g, 0, sizeof(*g));
+    if (n < 1 || n > IQ_TONE_MAX || fs <= 0.0)
+        return -1;
+    g->acc_i = (float *)aligned_alloc(64, ((cap * sizeof(float) + 63) / 64) * 64);
+    g->acc_q = (float *)aligned_alloc(64, ((cap * sizeof(float) + 63) / 64) * 64);
+    if (!g->acc_i || !g->acc_q) {
+        iq_tone_free(g);
+        return -1;
+    }
+    g->cap = cap;
+    g->n = n;
+    g->fs = fs;
+    g->fs_int = fabs(fs - llround(fs)) < 1e-6 ? (uint64_t)llround(fs) : 0;
+    g->fn = iq_tone_select(&g->kernel);
+    g->gain = 32767.0f;
+    for (int k = 0; k < n; k++) {
+        iq_tone_osc_t *o = &g->osc[k];
+        o->t = tones[k];
+        o->amp = (float)tones[k].amp;
+        o->ph0 = iq_tone_inc(tones[k].phase_deg / 360.0, 1.0);
+        if (tones[k].sweep_s > 0.0) {
+            o->sweep_len = (uint64_t)llround(tones[k].sweep_s * fs);
+            if (o->sweep_len < 1)
+                o->sweep_len = 1;
+        } else if (g->fs_int && fabs(tones[k].freq_hz - llround(tones[k].freq_hz)) < 1e-6) {
+            const int64_t f = (int64_t)llround(tones[k].freq_hz) % (int64_t)g->fs_int;
+            o->exact = true;
+            o->f_mod = (uint64_t)(f < 0 ? f + (int64_t)g->fs_int : f);
+        }
+    }
+    iq_tone_reset(g);
+    return 0;
+}
+
+// Frames after which the tone set repeats exactly, or 0 (sweeps, fractional Hz, too long).
+static inline uint64_t iq_tone_period(const iq_tone_gen_t *g) {
+    uint64_t p = 1;
+    for (int k = 0; k < g->n; k++) {
+        const iq_tone_osc_t *o = &g->osc[k];
+        if (!o->exact)
+            return 0;
+        uint64_t a = o->f_mod, b = g->fs_int, t;
+        while (b) {
+            t = a % b;
+            a = b;
+            b = t;
+        }
+        const uint64_t pk = g->fs_int / a; // a = gcd(f_mod, fs), and gcd(0, fs) = fs
+        uint64_t x = p, y = pk;
+        while (y) {
+            t = x % y;
+            x = y;
+            y = t;
+        }
+        p = p / x * pk;
+        if (p > IQ_TONE_MAX_PERIOD)
+            return 0;
+    }
+    return p;
+}
+
+// Render n <= cap frames into acc_i/acc_q.
+static inline void iq_tone_render_f(iq_tone_gen_t *g, size_t n) {
+    memset(g->acc_i, 0, n * sizeof(float));
+    memset(g->acc_q, 0, n * sizeof(float));
+    for (int k = 0; k < g->n; k++) {
+        iq_tone_osc_t *o = &g->osc[k];
+        size_t done = 0;
+        while (done < n) {
+            size_t seg = n - done;
+            if (o->exact) {
+                const uint64_t c = g->count + done;
+                const size_t to_sync = IQ_TONE_RESYNC - (size_t)(c % IQ_TONE_RESYNC);
+                if (to_sync == IQ_TONE_RESYNC)
+                    o->ph = iq_tone_exact_ph(o, g->fs_int, c);
+                if (seg > to_sync)
+                    seg = to_sync;
+            } else if (o->sweep_len) {
+                const uint64_t in_seg = o->sweep_pos % IQ_TONE_SWEEP_SEG;
+                if (in_seg == 0) {
+                    const double f = o->t.freq_hz + (o->t.sweep_to_hz - o->t.freq_hz) *
+                                                        ((double)o->sweep_pos + IQ_TONE_SWEEP_SEG / 2.0) /
+                                                        (double)o->sweep_len;
+                    o->inc = iq_tone_inc(f, g->fs);
+                }
+                uint64_t lim = IQ_TONE_SWEEP_SEG - in_seg;
+                if (lim > o->sweep_len - o->sweep_pos)
+                    lim = o->sweep_len - o->sweep_pos;
+                if (seg > lim)
+                    seg = (size_t)lim;
+            }
+            g->fn(g->acc_i + done, g->acc_q + done, seg, o->ph, o->inc, o->amp);
+            o->ph += (uint32_t)seg * o->inc;
+            if (o->sweep_len) {
+                o->sweep_pos += seg;
+                if (o->sweep_pos >= o->sweep_len)
+                    o->sweep_pos = 0;
+            }
+            done += seg;
+        }
+    }
+    g->count += n;
+}
+
+static inline void iq_tone_pack(const iq_tone_gen_t *g, int16_t *out, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        out[2 * i] = iq_sat16((int32_t)lrintf(g->acc_i[i] * g->gain));
+        out[2 * i + 1] = iq_sat16((int32_t)lrintf(g->acc_q[i] * g->gain));
+    }
+}
+
+// Render n frames of int16 I/Q (any n).
+static inline void iq_tone_render(iq_tone_gen_t *g, int16_t *out, size_t n) {
+    while (n > 0) {
+        size_t k = n < g->cap ? n : g->cap;
+        iq_tone_render_f(g, k);
+        iq_tone_pack(g, out, k);
+        out += 2 * k;
+        n -= k;
+    }
+}
+
+// Measure peak(|I|,|Q|), envelope peak and RMS over the first `frames` frames, then rewind.
+static inline void iq_tone_measure(iq_tone_gen_t *g, uint64_t frames) {
+    double peak = 0.0, env = 0.0, pow_sum = 0.0;
+    iq_tone_reset(g);
+    for (uint64_t left = frames; left > 0;) {
+        size_t k = left < g->cap ? (size_t)left : g->cap;
+        iq_tone_render_f(g, k);
+        for (size_t i = 0; i < k; i++) {
+            const double a = g->acc_i[i], b = g->acc_q[i];
+            const double e = a * a + b * b;
+            peak = fmax(peak, fmax(fabs(a), fabs(b)));
+            env = fmax(env, e);
+            pow_sum += e;
+        }
+        left -= k;
+    }
+    g->peak = peak;
+    g->env_peak = sqrt(env);
+    g->rms = frames ? sqrt(pow_sum / (double)frames) : 0.0;
+    iq_tone_reset(g);
+}
+
+// Map the measured peak to `scale` of int16 full scale. margin > 1 leaves headroom for
+// peaks a probe window may have missed.
+static inline void iq_tone_set_scale(iq_tone_gen_t *g, double scale, double margin) {
+    double sum = 0.0;
+    for (int k = 0; k < g->n; k++)
+        sum += g->osc[k].t.amp;
+    double peak = fmin(g->peak * margin, sum); // sum of amplitudes bounds any peak
+    g->gain = peak > 0.0 ? (float)(scale * 32767.0 / peak) : 0.0f;
+}
+
+// Chunk source: window into a period buffer, or live rendering.
+typedef struct {
+    iq_tone_gen_t gen;
+    int16_t *period; // period_frames + chunk frames; the tail repeats the head
+    size_t period_frames;
+    size_t pos;
+    size_t chunk;
+    int16_t *scratch; // live rendering
+    int cached;       // IQ_TONE_CACHE_*: where the period buffer came from
+} iq_tone_src_t;
+
+#define IQ_TONE_CACHE_NONE 0   // rendered, not cached (live, no cache dir, or the store failed)
+#define IQ_TONE_CACHE_LOADED 1 // read back from the cache
+#define IQ_TONE_CACHE_STORED 2 // rendered and written to the cache
+
+static inline void iq_tone_src_free(iq_tone_src_t *s) {
+    iq_tone_free(&s->gen);
+    free(s->period);
+    free(s->scratch);
+    memset(s, 0, sizeof(*s));
+}
+
+// Cache key of a periodic tone set: everything the rendered int16 samples depend on. Bump the
+// version when the renderer or the scaling changes.
+static inline void iq_tone_cache_key(const iq_tone_gen_t *g, double scale, char *out, size_t n) {
+    int len = snprintf(out, n, "iq_tone v1 %s fs=%.17g scale=%.17g n=%d", g->kernel, g->fs, scale, g->n);
+    for (int k = 0; k < g->n && len > 0 && (size_t)len < n; k++) {
+        const iq_tone_t *t = &g->osc[k].t;
+        len += snprintf(out + len, n - (size_t)len, " %.17g/%.17g/%.17g", t->freq_hz, t->amp, t->phase_deg);
+    }
+}
+
+// cache_dir: waveform cache directory for periodic tone sets, or NULL to always render.
+static inline int iq_tone_src_init_cached(iq_tone_src_t *s, const iq_tone_t *tones, int n, double fs, double scale,
+                                          size_t chunk, const char *cache_dir) {
+    memset(s, 0, sizeof(*s));
+    s->chunk = chunk;
+    if (iq_tone_init(&s->gen, tones, n, fs, chunk))
+        return -1;
+    const uint64_t period = iq_tone_period(&s->gen);
+    if (period) {
+        char key[IQ_WFC_KEY_MAX];
+        double meta[IQ_WFC_META];
+        s->period_frames = (size_t)period;
+        if (cache_dir) {
+            iq_tone_cache_key(&s->gen, scale, key, sizeof(key));
+            s->period = iq_wfc_load(cache_dir, key, s->period_frames, chunk, meta);
+        }
+        if (s->period) {
+            s->gen.peak = meta[0];
+            s->gen.env_peak = meta[1];
+            s->gen.rms = meta[2];
+            s->gen.gain = (float)meta[3];
+            s->cached = IQ_TONE_CACHE_LOADED;
+            return 0;
+        }
+        iq_tone_measure(&s->gen, period);
+        iq_tone_set_scale(&s->gen, scale, 1.0);
+        s->period = iq_wfc_alloc(s->period_frames, chunk);
+        if (!s->period) {
+            iq_tone_src_free(s);
+            return -1;
+        }
+        iq_tone_render(&s->gen, s->period, period);
+        iq_wfc_wrap(s->period, s->period_frames, chunk);
+        if (cache_dir) {
+            meta[0] = s->gen.peak;
+            meta[1] = s->gen.env_peak;
+            meta[2] = s->gen.rms;
+            meta[3] = s->gen.gain;
+            if (!iq_wfc_store(cache_dir, key, s->period, s->period_frames, meta))
+                s->cached = IQ_TONE_CACHE_STORED;
+        }
+    } else {
+        iq_tone_measure(&s->gen, IQ_TONE_PROBE_FRAMES);
+        iq_tone_set_scale(&s->gen, scale, 1.12); // +1 dB
+        s->scratch = (int16_t *)aligned_alloc(64, ((2 * chunk * sizeof(int16_t) + 63) / 64) * 64);
+        if (!s->scratch) {
+            iq_tone_src_free(s);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static inline int iq_tone_src_init(iq_tone_src_t *s, const iq_tone_t *tones, int n, double fs, double scale,
+                                   size_t chunk) {
+    return iq_tone_src_init_cached(s, tones, n, fs, scale, chunk, NULL);
+}
+
+// Next `chunk` frames.
+static inline const int16_t *iq_tone_src_next(iq_tone_src_t *s) {
+    if (s->period) {
+        const int16_t *p = s->period + 2 * s->pos;
+        s->pos = (s->pos + s->chunk) % s->period_frames;
+        return p;
+    }
+    iq_tone_render(&s->gen, s->scratch, s->chunk);
+    return s->scratch;
+}
+
+// Crest factor (peak envelope over RMS) in dB.
+static inline double iq_tone_crest_db(const iq_tone_gen_t *g) {
+    return g->rms > 0.0 ? 20.0 * log10(g->env_peak / g->rms) : 0.0;
+}
+
+#endif
@@ -0,0 +1,148 @@
+#ifndef IQ_WFCACHE_H
+#define IQ_WFCACHE_H
+
+// Persistent cache of rendered baseband waveforms (interleaved int16 I/Q).
+// A generator whose output repeats renders one whole period once, then stores it here under a
+// key string that spells out every parameter the samples depend on (generator, renderer
+// version, sample rate, scale, the tones...). A later start with the same key reads the period
+// back instead of rendering and measuring it again. Files are <dir>/<fnv1a64(key)>.iqw: an
+// iq_wfc_hdr_t, the key itself (checked on load, so a hash collision is only a miss), IQ_WFC_META
+// doubles the generator keeps alongside (its measured peak and gain, say), then the frames.
+// Writes go to a temp file and are renamed into place, so a crash never leaves half a waveform.
+//
+// Buffers come from iq_wfc_alloc(): 64-byte aligned, the period followed by `tail` frames that
+// repeat its head, so a chunk starting anywhere in the period is contiguous and the send loop
+// only walks a pointer.
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define IQ_WFC_MAGIC 0x31435749u // "IWC1", little-endian
+#define IQ_WFC_KEY_MAX 2048
+#define IQ_WFC_PATH_MAX 512
+#define IQ_WFC_META 4
+
+typedef struct {
+    uint32_t magic;
+    uint32_t key_len;
+    uint64_t frames;
+    double meta[IQ_WFC_META];
+} iq_wfc_hdr_t;
+
+// $XDG_CACHE_HOME/limesdr_tests/wfm, else ~/.cache/limesdr_tests/wfm, else ./wfm
+static inline void iq_wfc_default_dir(char *out, size_t n) {
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    if (xdg && *xdg)
+        snprintf(out, n, "%s/limesdr_tests/wfm", xdg);
+    else if (home && *home)
+        snprintf(out, n, "%s/.cache/limesdr_tests/wfm", home);
+    else
+        snprintf(out, n, "wfm");
+}
+
+static inline uint64_t iq_wfc_hash(const char *s) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (; *s; s++)
+        h = (h ^ (uint8_t)*s) * 0x100000001b3ull;
+    return h;
+}
+
+static inline void iq_wfc_path(char *out, size_t n, const char *dir, const char *key) {
+    snprintf(out, n, "%s/%016llx.iqw", dir, (unsigned long long)iq_wfc_hash(key));
+}
+
+static inline int16_t *iq_wfc_alloc(size_t frames, size_t tail) {
+    return (int16_t *)aligned_alloc(64, ((2 * (frames + tail) * sizeof(int16_t) + 63) / 64) * 64);
+}
+
+// Fill the tail with the head of the period (which may be shorter than the tail).
+static inline void iq_wfc_wrap(int16_t *buf, size_t frames, size_t tail) {
+    for (size_t i = 0; i < tail; i++) {
+        buf[2 * (frames + i)] = buf[2 * (i % frames)];
+        buf[2 * (frames + i) + 1] = buf[2 * (i % frames) + 1];
+    }
+}
+
+// The cached period for `key` into a new iq_wfc_alloc(frames, tail) buffer, or NULL on a miss
+// (no file, another key, another length). meta may be NULL.
+static inline int16_t *iq_wfc_load(const char *dir, const char *key, size_t frames, size_t tail,
+                                   double meta[IQ_WFC_META]) {
+    char path[IQ_WFC_PATH_MAX];
+    iq_wfc_path(path, sizeof(path), dir, key);
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return NULL;
+    const size_t key_len = strlen(key);
+    iq_wfc_hdr_t h;
+    char stored[IQ_WFC_KEY_MAX];
+    int16_t *buf = NULL;
+    if (fread(&h, sizeof(h), 1, f) != 1 || h.magic != IQ_WFC_MAGIC || h.key_len != key_len ||
+        key_len >= IQ_WFC_KEY_MAX || h.frames != frames || fread(stored, 1, key_len, f) != key_len ||
+        memcmp(stored, key, key_len))
+        goto miss;
+    buf = iq_wfc_alloc(frames, tail);
+    if (!buf || fread(buf, 2 * sizeof(int16_t), frames, f) != frames || fgetc(f) != EOF)
+        goto miss;
+    fclose(f);
+    iq_wfc_wrap(buf, frames, tail);
+    if (meta)
+        memcpy(meta, h.meta, sizeof(h.meta));
+    return buf;
+miss:
+    fclose(f);
+    free(buf);
+    return NULL;
+}
+
+// mkdir -p
+static inline void iq_wfc_mkdirs(const char *dir) {
+    char tmp[IQ_WFC_PATH_MAX];
+    snprintf(tmp, sizeof(tmp), "%s/", dir);
+    for (char *p = tmp + 1; *p; p++) {
+        if (*p != '/')
+            continue;
+        *p = '\0';
+        (void)mkdir(tmp, 0755);
+        *p = '/';
+    }
+}
+
+// Store `frames` frames of buf under key. 0, or -1 after a message (the caller carries on).
+static inline int iq_wfc_store(const char *dir, const char *key, const int16_t *buf, size_t frames,
+                               const double meta[IQ_WFC_META]) {
+    char path[IQ_WFC_PATH_MAX], tmp[IQ_WFC_PATH_MAX + 8];
+    const size_t key_len = strlen(key);
+    if (key_len >= IQ_WFC_KEY_MAX)
+        return -1;
+    iq_wfc_path(path, sizeof(path), dir, key);
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    iq_wfc_mkdirs(dir);
+    FILE *f = fopen(tmp, "wb");
+    if (!f) {
+        fprintf(stderr, "WARN: waveform cache %s: %s\n", tmp, strerror(errno));
+        return -1;
+    }
+    iq_wfc_hdr_t h;
+    memset(&h, 0, sizeof(h));
+    h.magic = IQ_WFC_MAGIC;
+    h.key_len = (uint32_t)key_len;
+    h.frames = frames;
+    if (meta)
+        memcpy(h.meta, meta, sizeof(h.meta));
+    const bool ok = fwrite(&h, sizeof(h), 1, f) == 1 && fwrite(key, 1, key_len, f) == key_len &&
+                    fwrite(buf, 2 * sizeof(int16_t), frames, f) == frames;
+    if (fclose(f) || !ok || rename(tmp, path)) {
+        fprintf(stderr, "WARN: waveform cache %s: %s\n", path, strerror(errno));
+        remove(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+#endif
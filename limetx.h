@@ -0,0 +1,354 @@
+#ifndef LIMETX_H
+#define LIMETX_H
+
+// Helpers shared by the TX tools: option parsing and TXTSP corrector access.
+//
+// Corrector registers go through a small transaction layer. The corrector registers
+// (0x0201..0x0204) of both channels have a shadow copy: a register is fetched from the chip at
+// most once, writes are staged and flushed per channel behind a single MAC (0x0020) select, and
+// writes that would not change the chip value are dropped. The LimeSuite C API has no
+// multi-register transfer, so the saving comes from not issuing USB control transfers at all.
+// 0x0020 (TXEN/RXEN live next to MAC) and 0x0208 (CMIX bits next to the bypass flags) are
+// changed by LimeSuite itself, so they are re-read at the start of every transaction and only
+// cached within it.
+//
+// The shadow is only as good as the assumption that nobody else touched TXTSP: call
+// limetx_regs_invalidate() after LMS_Reset/LMS_Init/LMS_Calibrate/LMS_SetSampleRate, and after
+// LMS_EnableChannel, LMS_SetNCOFrequency/LMS_SetNCOIndex and LMS_SetLOFrequency.
+
+#include "lime/LimeSuite.h"
+#include <ctype.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define LIMETX_REG_MAC 0x0020    // MAC[1:0]: 01=A, 10=B
+#define LIMETX_REG_GCORRQ 0x0201 // GCORRQ[10:0]
+#define LIMETX_REG_GCORRI 0x0202 // GCORRI[10:0]
+#define LIMETX_REG_IQCORR 0x0203 // HBI_OVR[14:12], IQCORR[11:0] (tan(alpha/2), signed)
+#define LIMETX_REG_DCCORR 0x0204 // DCCORRI[15:8], DCCORRQ[7:0]
+#define LIMETX_REG_BYP 0x0208    // bypass flags
+#define LIMETX_BYP_PH (1u << 0)
+#define LIMETX_BYP_GC (1u << 1)
+#define LIMETX_BYP_DC (1u << 3)
+
+#define LIMETX_NCH 2
+#define LIMETX_NREGS 5
+
+typedef struct {
+    lms_device_t *dev;
+    uint16_t val[LIMETX_NCH][LIMETX_NREGS];  // value known to be on the chip
+    uint16_t pend[LIMETX_NCH][LIMETX_NREGS]; // staged by limetx_reg_write()
+    uint8_t valid[LIMETX_NCH];               // bit per register: val is current
+    uint8_t dirty[LIMETX_NCH];               // bit per register: pend waits for commit
+    uint16_t mac_reg;                        // 0x0020 as read in this transaction
+    bool mac_valid;
+    int mac_sel; // channel selected during the current transaction, -1 = unknown
+    unsigned reads, writes;
+} limetx_regs_t;
+
+typedef struct {
+    int gi, gq; // 0..2047, 2048 = unity
+    int iq;     // -2048..2047
+    int dci, dcq;
+    bool ph_byp, gc_byp, dc_byp;
+} limetx_txtsp_t;
+
+static inline int limetx_clampi(int v, int lo, int hi) { return v < lo ? lo : (v > hi ? hi : v); }
+
+// clang-format off
+static inline bool limetx_parse_bool(const char* s, bool* out){
+    if (!s || !out) return false;
+    if (!strcasecmp(s,"1") || !strcasecmp(s,"true") || !strcasecmp(s,"yes") || !strcasecmp(s,"on")) { *out=true;  return true; }
+    if (!strcasecmp(s,"0") || !strcasecmp(s,"false")|| !strcasecmp(s,"no")  || !strcasecmp(s,"off")){ *out=false; return true; }
+    return false;
+}
+
+// Parse Hz with optional k/M/G suffix (case-insensitive). Returns true on success.
+static inline bool limetx_parse_hz(const char* s, double* out){
+    if (!s || !out) return false;
+    char* end = NULL;
+    double v = strtod(s, &end);
+    if (end && *end != '\0'){
+        while (*end && isspace((unsigned char)*end)) end++;
+        if (*end){
+            double mul = 1.0;
+            char c = (char)tolower((unsigned char)*end);
+            if (c=='k') mul = 1e3;
+            else if (c=='m') mul = 1e6;
+            else if (c=='g') mul = 1e9;
+            else return false;
+            end++;
+            while (*end && isspace((unsigned char)*end)) end++;
+            if (*end!='\0') return false;
+            v *= mul;
+        }
+    }
+    *out = v;
+    return true;
+}
+
+// "i12" | "i16" -> LMS_LINK_FMT_I12 | LMS_LINK_FMT_I16
+static inline bool limetx_parse_link_fmt(const char* s, int* out){
+    if (!s || !out) return false;
+    if (!strcasecmp(s,"i12") || !strcmp(s,"12")) { *out = LMS_LINK_FMT_I12; return true; }
+    if (!strcasecmp(s,"i16") || !strcmp(s,"16")) { *out = LMS_LINK_FMT_I16; return true; }
+    return false;
+}
+// clang-format on
+
+// USB link format of a stream (lms_stream_t.linkFmt), independent of the host buffer format.
+// The host side stays LMS_FMT_I16; with LMS_LINK_FMT_I12 LimeSuite packs each I/Q frame into
+// 3 bytes instead of 4 by dropping the 4 LSBs, which the 12-bit DAC never sees anyway.
+//
+// Maximum sustainable host sample rate, one TX channel (bytes/frame vs. usable bulk payload):
+//   link   bytes/frame   USB 2.0 (~35 MB/s)   USB 3.0 (~300 MB/s)
+//   I16    4             ~8.5 Msps            61.44 Msps (chip limit)
+//   I12    3             ~11.5 Msps           61.44 Msps (chip limit)
+// Behind a shared or busy USB 2.0 hub the budget is lower; I12 buys the same 25% headroom.
+#define LIMETX_USB2_PAYLOAD_BPS 35e6
+
+static inline int limetx_link_bytes_per_frame(int link_fmt) { return link_fmt == LMS_LINK_FMT_I12 ? 3 : 4; }
+
+static inline const char *limetx_link_fmt_name(int link_fmt) { return link_fmt == LMS_LINK_FMT_I12 ? "I12" : "I16"; }
+
+static inline double limetx_link_max_sr_usb2(int link_fmt) {
+    return LIMETX_USB2_PAYLOAD_BPS / limetx_link_bytes_per_frame(link_fmt);
+}
+
+// One line with the USB load at host_sr_hz, plus a note when it exceeds a USB 2.0 link.
+static inline void limetx_print_link(int link_fmt, double host_sr_hz) {
+    const double mbs = host_sr_hz * limetx_link_bytes_per_frame(link_fmt) / 1e6;
+    printf("link: %s, %d bytes/frame, %.1f MB/s at %.3f Msps\n", limetx_link_fmt_name(link_fmt),
+           limetx_link_bytes_per_frame(link_fmt), mbs, host_sr_hz / 1e6);
+    if (host_sr_hz > limetx_link_max_sr_usb2(link_fmt))
+        printf("NOTE: above the ~%.1f Msps a USB 2.0 link sustains with %s%s\n",
+               limetx_link_max_sr_usb2(link_fmt) / 1e6, limetx_link_fmt_name(link_fmt),
+               link_fmt == LMS_LINK_FMT_I12 ? "" : " (try --link-fmt i12)");
+}
+
+static inline int limetx_reg_index(uint16_t addr) {
+    switch (addr) {
+    case LIMETX_REG_GCORRQ:
+        return 0;
+    case LIMETX_REG_GCORRI:
+        return 1;
+    case LIMETX_REG_IQCORR:
+        return 2;
+    case LIMETX_REG_DCCORR:
+        return 3;
+    case LIMETX_REG_BYP:
+        return 4;
+    default:
+        return -1;
+    }
+}
+
+static inline uint16_t limetx_reg_addr(int idx) {
+    static const uint16_t addr[LIMETX_NREGS] = {LIMETX_REG_GCORRQ, LIMETX_REG_GCORRI, LIMETX_REG_IQCORR,
+                                                LIMETX_REG_DCCORR, LIMETX_REG_BYP};
+    return addr[idx];
+}
+
+static inline void limetx_regs_init(limetx_regs_t *r, lms_device_t *dev) {
+    memset(r, 0, sizeof(*r));
+    r->dev = dev;
+    r->mac_sel = -1;
+}
+
+// Forget every shadow value (LimeSuite reprogrammed the TSP behind our back).
+static inline void limetx_regs_invalidate(limetx_regs_t *r) {
+    memset(r->valid, 0, sizeof(r->valid));
+    memset(r->dirty, 0, sizeof(r->dirty));
+    r->mac_valid = false;
+    r->mac_sel = -1;
+}
+
+// Any LimeSuite call may move MAC or rewrite 0x0020/0x0208, so those are only trusted inside one
+// transaction: the first select read-modify-writes 0x0020 and 0x0208 is fetched again.
+static inline void limetx_txn_begin(limetx_regs_t *r) {
+    const uint8_t byp = (uint8_t)(1u << limetx_reg_index(LIMETX_REG_BYP));
+    r->mac_sel = -1;
+    r->mac_valid = false;
+    for (int ch = 0; ch < LIMETX_NCH; ch++)
+        r->valid[ch] &= (uint8_t)~byp;
+}
+
+static inline int limetx_select(limetx_regs_t *r, int ch) {
+    if (r->mac_sel == ch)
+        return 0;
+    const uint16_t want_bits = (uint16_t)(ch == 0 ? 0x1 : 0x2);
+    if (!r->mac_valid) {
+        r->reads++;
+        if (LMS_ReadLMSReg(r->dev, LIMETX_REG_MAC, &r->mac_reg))
+            return -1;
+        r->mac_valid = true;
+        if ((r->mac_reg & 0x3) == want_bits) {
+            r->mac_sel = ch;
+            return 0;
+        }
+    }
+    const uint16_t v = (uint16_t)((r->mac_reg & ~0x3) | want_bits);
+    r->writes++;
+    if (LMS_WriteLMSReg(r->dev, LIMETX_REG_MAC, v)) {
+        r->mac_valid = false;
+        return -1;
+    }
+    r->mac_reg = v;
+    r->mac_sel = ch;
+    return 0;
+}
+
+static inline int limetx_reg_read(limetx_regs_t *r, int ch, uint16_t addr, uint16_t *out) {
+    const int i = limetx_reg_index(addr);
+    if (i < 0 || ch < 0 || ch >= LIMETX_NCH)
+        return -1;
+    if (r->dirty[ch] & (1u << i)) {
+        *out = r->pend[ch][i];
+        return 0;
+    }
+    if (!(r->valid[ch] & (1u << i))) {
+        if (limetx_select(r, ch))
+            return -1;
+        r->reads++;
+        if (LMS_ReadLMSReg(r->dev, addr, &r->val[ch][i]))
+            return -1;
+        r->valid[ch] |= (uint8_t)(1u << i);
+    }
+    *out = r->val[ch][i];
+    return 0;
+}
+
+// Stage a write; nothing reaches the chip before limetx_txn_commit().
+static inline int limetx_reg_write(limetx_regs_t *r, int ch, uint16_t addr, uint16_t v) {
+    const int i = limetx_reg_index(addr);
+    if (i < 0 || ch < 0 || ch >= LIMETX_NCH)
+        return -1;
+    r->pend[ch][i] = v;
+    r->dirty[ch] |= (uint8_t)(1u << i);
+    return 0;
+}
+
+static inline int limetx_reg_modify(limetx_regs_t *r, int ch, uint16_t addr, uint16_t mask, uint16_t bits) {
+    uint16_t v = 0;
+    if (limetx_reg_read(r, ch, addr, &v))
+        return -1;
+    return limetx_reg_write(r, ch, addr, (uint16_t)((v & ~mask) | (bits & mask)));
+}
+
+static inline int limetx_txn_commit(limetx_regs_t *r) {
+    int rc = 0;
+    for (int ch = 0; ch < LIMETX_NCH; ch++) {
+        for (int i = 0; i < LIMETX_NREGS && r->dirty[ch]; i++) {
+            const uint8_t bit = (uint8_t)(1u << i);
+            if (!(r->dirty[ch] & bit))
+                continue;
+            r->dirty[ch] &= (uint8_t)~bit;
+            if ((r->valid[ch] & bit) && r->val[ch][i] == r->pend[ch][i])
+                continue;
+            if (limetx_select(r, ch)) {
+                rc = -1;
+                continue;
+            }
+            r->writes++;
+            if (LMS_WriteLMSReg(r->dev, limetx_reg_addr(i), r->pend[ch][i])) {
+                r->valid[ch] &= (uint8_t)~bit;
+                rc = -1;
+                continue;
+            }
+            r->val[ch][i] = r->pend[ch][i];
+            r->valid[ch] |= bit;
+        }
+    }
+    return rc;
+}
+
+static inline int limetx_read_txtsp(limetx_regs_t *r, int ch, limetx_txtsp_t *c) {
+    uint16_t reg_gq = 0, reg_gi = 0, reg_iq = 0, reg_dc = 0, reg_byp = 0;
+    limetx_txn_begin(r);
+    if (limetx_reg_read(r, ch, LIMETX_REG_GCORRQ, &reg_gq) || limetx_reg_read(r, ch, LIMETX_REG_GCORRI, &reg_gi) ||
+        limetx_reg_read(r, ch, LIMETX_REG_IQCORR, &reg_iq) || limetx_reg_read(r, ch, LIMETX_REG_DCCORR, &reg_dc) ||
+        limetx_reg_read(r, ch, LIMETX_REG_BYP, &reg_byp))
+        return -1;
+
+    c->gq = (int)(reg_gq & 0x07FF);
+    c->gi = (int)(reg_gi & 0x07FF);
+    c->iq = (int)(reg_iq & 0x0FFF);
+    if (c->iq & 0x0800)
+        c->iq |= ~0x0FFF;
+    c->dci = (int8_t)((reg_dc >> 8) & 0xFF);
+    c->dcq = (int8_t)(reg_dc & 0xFF);
+    c->ph_byp = (reg_byp & LIMETX_BYP_PH) != 0;
+    c->gc_byp = (reg_byp & LIMETX_BYP_GC) != 0;
+    c->dc_byp = (reg_byp & LIMETX_BYP_DC) != 0;
+    return 0;
+}
+
+// Detailed corrector printout used by the tx_ssb tools.
+static inline void limetx_print_correctors(limetx_regs_t *r, int ch) {
+    limetx_txtsp_t c;
+    if (limetx_read_txtsp(r, ch, &c)) {
+        fprintf(stderr, "WARN: can't set MAC for channel %c\n", ch ? 'B' : 'A');
+        return;
+    }
+
+    const double gq = c.gq / 2048.0;
+    const double gi = c.gi / 2048.0;
+    const double gq_db = 20.0 * log10(gq > 0 ? gq : 1e-9);
+    const double gi_db = 20.0 * log10(gi > 0 ? gi : 1e-9);
+    const double alpha_deg = 2.0 * atan(c.iq / 2048.0) * 180.0 / M_PI;
+
+    printf("TXTSP correctors (CH %c):\n", ch ? 'B' : 'A');
+    printf("  Gain:   GCORRI=%4d  (%.6f, %+6.2f dB)%s,  GCORRQ=%4d  (%.6f, %+6.2f dB)%s\n", c.gi, gi, gi_db,
+           c.gc_byp ? " [BYPASSED]" : "", c.gq, gq, gq_db, c.gc_byp ? " [BYPASSED]" : "");
+    printf("  Phase:  IQCORR=%5d  -> phase ≈ %+8.4f deg%s\n", c.iq, alpha_deg, c.ph_byp ? " [BYPASSED]" : "");
+    printf("  DC:     DCCORRI=%4d (%.5f FS)%s,  DCCORRQ=%4d (%.5f FS)%s\n", c.dci, c.dci / 128.0,
+           c.dc_byp ? " [BYPASSED]" : "", c.dcq, c.dcq / 128.0, c.dc_byp ? " [BYPASSED]" : "");
+}
+
+// Three-line printout used by the streaming tools (tx_pipe, tx_wav).
+static inline void limetx_print_correctors_short(limetx_regs_t *r, int ch) {
+    limetx_txtsp_t c;
+    if (limetx_read_txtsp(r, ch, &c)) {
+        fprintf(stderr, "WARN: can't set MAC for channel %c\n", ch ? 'B' : 'A');
+        return;
+    }
+    printf("gain: GCORRI=%d, GCORRQ=%d\n", c.gi, c.gq);
+    printf("phase: IQCORR=%d\n", c.iq);
+    printf("dc: DCCORRI=%d, DCCORRQ=%d\n", c.dci, c.dcq);
+}
+
+// Write manual TXTSP correctors and un-bypass PH/GC/DC so they take effect. Everything goes
+// out in one transaction: one MAC select, one fetch per read-modify-write register at most.
+static inline int limetx_apply_manual(limetx_regs_t *r, int ch, bool have_gi, int gi, bool have_gq, int gq,
+                                      bool have_phase, int phase, bool have_dci, int dci, bool have_dcq, int dcq) {
+    int rc = 0;
+    limetx_txn_begin(r);
+
+    if (have_gi)
+        rc |= limetx_reg_write(r, ch, LIMETX_REG_GCORRI, (uint16_t)(limetx_clampi(gi, 0, 2047) & 0x07FF));
+    if (have_gq)
+        rc |= limetx_reg_write(r, ch, LIMETX_REG_GCORRQ, (uint16_t)(limetx_clampi(gq, 0, 2047) & 0x07FF));
+    if (have_phase)
+        rc |= limetx_reg_modify(r, ch, LIMETX_REG_IQCORR, 0x0FFF, (uint16_t)limetx_clampi(phase, -2047, 2047));
+    if (have_dci)
+        rc |= limetx_reg_modify(r, ch, LIMETX_REG_DCCORR, 0xFF00,
+                                (uint16_t)((uint16_t)(uint8_t)(int8_t)limetx_clampi(dci, -128, 127) << 8));
+    if (have_dcq)
+        rc |= limetx_reg_modify(r, ch, LIMETX_REG_DCCORR, 0x00FF,
+                                (uint16_t)(uint8_t)(int8_t)limetx_clampi(dcq, -128, 127));
+    rc |= limetx_reg_modify(r, ch, LIMETX_REG_BYP, LIMETX_BYP_PH | LIMETX_BYP_GC | LIMETX_BYP_DC, 0);
+
+    rc |= limetx_txn_commit(r);
+    return rc;
+}
+
+#endif
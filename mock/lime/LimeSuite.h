@@ -0,0 +1,123 @@
+#ifndef LIMESUITE_MOCK_H
+#define LIMESUITE_MOCK_H
+
+// Mock of the LimeSuite C API subset used by the tools here (see lms_mock.c).
+// Types and signatures follow LimeSuite 23.11 lime/LimeSuite.h, so a tool built with -Imock
+// compiles unchanged against the real library.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef double float_type;
+typedef char lms_info_str_t[256];
+typedef char lms_name_t[16];
+typedef void lms_device_t;
+
+#define LMS_SUCCESS 0
+#define LMS_CH_TX true
+#define LMS_CH_RX false
+
+#define LMS_PATH_NONE 0
+#define LMS_PATH_LNAH 1
+#define LMS_PATH_LNAL 2
+#define LMS_PATH_LNAW 3
+#define LMS_PATH_TX1 1
+#define LMS_PATH_TX2 2
+#define LMS_PATH_AUTO 255
+
+#define LMS_ALIGN_CH_PHASE (1 << 16)
+
+typedef struct {
+    uint64_t timestamp;
+    bool waitForTimestamp;
+    bool flushPartialPacket;
+} lms_stream_meta_t;
+
+typedef struct {
+    size_t handle;
+    bool isTx;
+    uint32_t channel;
+    uint32_t fifoSize;
+    float throughputVsLatency;
+    enum { LMS_FMT_F32 = 0, LMS_FMT_I16, LMS_FMT_I12 } dataFmt;
+    enum { LMS_LINK_FMT_DEFAULT = 0, LMS_LINK_FMT_I16, LMS_LINK_FMT_I12 } linkFmt;
+} lms_stream_t;
+
+typedef struct {
+    bool active;
+    uint32_t fifoFilledCount;
+    uint32_t fifoSize;
+    uint32_t underrun;
+    uint32_t overrun;
+    uint32_t droppedPackets;
+    float_type sampleRate;
+    float_type linkRate;
+    uint64_t timestamp;
+} lms_stream_status_t;
+
+typedef struct {
+    char deviceName[32];
+    char expansionName[32];
+    char firmwareVersion[16];
+    char hardwareVersion[16];
+    char protocolVersion[16];
+    uint64_t boardSerialNumber;
+    char gatewareVersion[16];
+    char gatewareTargetBoard[32];
+} lms_dev_info_t;
+
+int LMS_GetDeviceList(lms_info_str_t *dev_list);
+int LMS_Open(lms_device_t **device, const lms_info_str_t info, void *args);
+int LMS_Close(lms_device_t *device);
+int LMS_Init(lms_device_t *device);
+int LMS_Reset(lms_device_t *device);
+const lms_dev_info_t *LMS_GetDeviceInfo(lms_device_t *device);
+
+int LMS_EnableChannel(lms_device_t *device, bool dir_tx, size_t chan, bool enabled);
+int LMS_SetSampleRate(lms_device_t *device, float_type rate, size_t oversample);
+int LMS_GetSampleRate(lms_device_t *device, bool dir_tx, size_t chan, float_type *host_Hz, float_type *rf_Hz);
+int LMS_SetLOFrequency(lms_device_t *device, bool dir_tx, size_t chan, float_type frequency);
+int LMS_GetLOFrequency(lms_device_t *device, bool dir_tx, size_t chan, float_type *frequency);
+int LMS_GetAntennaList(lms_device_t *device, bool dir_tx, size_t chan, lms_name_t *list);
+int LMS_SetAntenna(lms_device_t *device, bool dir_tx, size_t chan, size_t index);
+int LMS_GetAntenna(lms_device_t *device, bool dir_tx, size_t chan);
+int LMS_SetGaindB(lms_device_t *device, bool dir_tx, size_t chan, unsigned gain);
+int LMS_GetGaindB(lms_device_t *device, bool dir_tx, size_t chan, unsigned *gain);
+int LMS_SetLPFBW(lms_device_t *device, bool dir_tx, size_t chan, float_type bandwidth);
+int LMS_GetLPFBW(lms_device_t *device, bool dir_tx, size_t chan, float_type *bandwidth);
+int LMS_Calibrate(lms_device_t *device, bool dir_tx, size_t chan, double bw, unsigned flags);
+int LMS_LoadConfig(lms_device_t *device, const char *filename);
+int LMS_SaveConfig(lms_device_t *device, const char *filename);
+int LMS_SetNCOFrequency(lms_device_t *device, bool dir_tx, size_t chan, const float_type *freq, float_type pho);
+int LMS_GetNCOFrequency(lms_device_t *device, bool dir_tx, size_t chan, float_type *freq, float_type *pho);
+int LMS_SetNCOIndex(lms_device_t *device, bool dir_tx, size_t chan, int index, bool downconv);
+int LMS_GetNCOIndex(lms_device_t *device, bool dir_tx, size_t chan);
+int LMS_ReadLMSReg(lms_device_t *device, uint32_t address, uint16_t *val);
+int LMS_WriteLMSReg(lms_device_t *device, uint32_t address, uint16_t val);
+int LMS_VCTCXOWrite(lms_device_t *device, uint16_t val);
+int LMS_VCTCXORead(lms_device_t *device, uint16_t *val);
+
+int LMS_SetupStream(lms_device_t *device, lms_stream_t *stream);
+int LMS_DestroyStream(lms_device_t *device, lms_stream_t *stream);
+int LMS_StartStream(lms_stream_t *stream);
+int LMS_StopStream(lms_stream_t *stream);
+int LMS_RecvStream(lms_stream_t *stream, void *samples, size_t sample_count, lms_stream_meta_t *meta,
+                   unsigned timeout_ms);
+int LMS_SendStream(lms_stream_t *stream, const void *samples, size_t sample_count, const lms_stream_meta_t *meta,
+                   unsigned timeout_ms);
+int LMS_GetStreamStatus(lms_stream_t *stream, lms_stream_status_t *status);
+int LMS_UploadWFM(lms_device_t *device, const void **samples, uint8_t chCount, size_t sample_count, int format);
+int LMS_EnableTxWFM(lms_device_t *device, unsigned chan, bool active);
+
+const char *LMS_GetLastErrorMessage(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,914 @@
+// Hardware-free LimeSuite backend for benchmarking the streaming tools (see bench_tools.sh).
+// gcc -O2 -Imock -o tx_pipe_I16bit_mock tx_pipe_I16bit.c mock/lms_mock.c -lpthread -lm
+//
+// TX streams drain into a simulated device FIFO at LMS_MOCK_RATE samples/s per channel, so
+// LMS_SendStream blocks like the real one once the FIFO is full and underruns are counted when
+// the host falls behind. Control calls can be given USB-like latency. Environment:
+//   LMS_MOCK_RATE     "host" (the rate set with LMS_SetSampleRate, default), "max" (no pacing,
+//                     measures the host's ceiling) or a rate in Hz
+//   LMS_MOCK_REG_US   latency of each LMS_ReadLMSReg/LMS_WriteLMSReg call and of each register an
+//                     NCO setter writes (1 for LMS_SetNCOIndex, 32 for LMS_SetNCOFrequency) (default 0)
+//   LMS_MOCK_GAIN_US  latency of each LMS_SetGaindB call (default 0)
+//   LMS_MOCK_REPORT   append one JSON line of results here at LMS_Close
+//   LMS_MOCK_LABEL    "case" field of that line
+//   LMS_MOCK_TX_IQ    "gain_dB:phase_deg:dc_i:dc_q" TX imbalance and LO leak (FS) seen by RX on the
+//                     LB1/LB2 loopback while the FPGA waveform plays (default 0.4:1.5:0.011:-0.007)
+//   LMS_MOCK_DEVICES  boards LMS_GetDeviceList reports, serials 0x10c0ffee upwards (default 1)
+//   LMS_MOCK_INIT_US  latency of LMS_Init, which takes about a second on a real board (default 0)
+// Control calls on one board share its mutex, like the single USB control endpoint. Boards have
+// their own info, control mutex, sample rate and stream pacing; the rest of the chip state (LO,
+// gain, NCO, registers) is shared, so the RX loopback only makes sense with one board at a time.
+// The report is written when the last board closes, for the first TX stream and the totals. A TX
+// send with meta->waitForTimestamp set after a gap queues that many samples of silence first, so
+// LMS_GetStreamStatus timestamps line up with the frames the host timestamped. A send with
+// flushPartialPacket ends a burst: once it has played the stream is idle rather than underrun, the
+// sample counter keeps running, and a timestamped send that is already late when it reaches an
+// idle stream is dropped (droppedPackets), as the FPGA drops late packets. RX on LB1/LB2 with the
+// FPGA waveform off hears the board's own TX stream instead: the int16 samples the DAC played,
+// in order (RX gain applied, plus noise), with silence where TX was not playing yet or ran dry,
+// so a pulse comes back at the RX timestamp of the moment it was played. LMS_EnableChannel sets
+// TXEN/RXEN in 0x0020 and an RX stream whose RXEN is off delivers zeros.
+
+#define _GNU_SOURCE
+#include "lime/LimeSuite.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#define MOCK_MAX_STREAMS 8
+#define MOCK_MAX_DEVICES 8
+#define MOCK_GAP_SAMPLES (1u << 20) // chunk intervals kept for percentiles (ring, newest win)
+#define MOCK_TS_GAPS 64             // timestamp gaps queued behind samples still in the FIFO
+#define MOCK_LB_HISTORY (1u << 16)  // TX samples kept after they played, for an RX loopback to read
+
+typedef struct {
+    bool used, started, tx;
+    int dev; // D index
+    uint32_t channel;
+    uint32_t fifo_size;
+    double fill;         // samples queued in the simulated FIFO
+    uint64_t t_drain_ns; // fill is valid at this time
+    uint64_t pushed;     // samples accepted (TX) or delivered (RX)
+    uint64_t consumed;   // TX: samples the "DAC" has played; timestamp source
+    double consumed_acc; // consumed with the fraction drains leave over
+    double silence;      // TX: timestamp gap played before the queued samples (not FIFO space)
+    uint64_t gap_at[MOCK_TS_GAPS]; // TX: further gaps, each before sample gap_at (pushed count)
+    double gap_len[MOCK_TS_GAPS];
+    unsigned gap_rd, gap_wr;
+    uint32_t underrun, overrun, dropped; // since the last LMS_GetStreamStatus
+    uint64_t underrun_total;
+    uint8_t *mem; // FIFO storage: samples are copied in like the real library does
+    size_t mem_bytes, mem_pos, frame_bytes;
+    bool primed; // TX: samples are due, an empty FIFO is now an underrun
+    bool idle;   // TX: the last send flushed a burst
+    pthread_mutex_t mu; // FIFO state, which an RX loopback reads from another thread
+    uint64_t lb_played;  // RX: TX samples already looped back
+} mock_stream_t;
+
+typedef struct {
+    lms_dev_info_t info;
+    pthread_mutex_t ctl;
+    double host_sr;
+} mock_dev_t;
+
+static mock_dev_t D[MOCK_MAX_DEVICES];
+
+static struct {
+    uint16_t regs[0x10000];
+    double lo[2], lpf_bw[2]; // [dir_tx]
+    unsigned gain[2];
+    int nco_idx[2];
+    bool nco_down[2];
+    double nco[2][16];
+    size_t path[2]; // antenna index, mock_ant order
+
+    // RX loopback model (see mock_loopback)
+    bool wfm_on;
+    double wfm_i, wfm_q, wfm_cyc; // first WFM sample (FS) and its rotation per sample (cycles)
+    double iq_gain_db, iq_phase_deg, iq_dc_i, iq_dc_q;
+    uint64_t noise;
+
+    double rate_cfg; // <0 host rate, 0 unlimited, >0 Hz
+    unsigned reg_us, gain_us, init_us, n_dev;
+    pthread_once_t env_once;
+    pthread_mutex_t setup; // stream slots and the open count, which boards take in parallel
+    int n_open;
+    char err[128];
+
+    mock_stream_t s[MOCK_MAX_STREAMS];
+    int first_tx; // stream whose chunk intervals are recorded
+
+    uint64_t t_first_ns, t_last_ns, t_prev_send_ns;
+    struct rusage ru_first;
+    _Atomic uint64_t frames_all; // every channel
+    uint64_t frames_first;       // first TX stream only
+    _Atomic uint64_t send_calls, reg_ops, gain_calls;
+    uint32_t *gaps_ns;
+    uint64_t n_gaps;
+} M = {.lpf_bw = {20e6, 20e6},
+       .path = {LMS_PATH_LNAH, LMS_PATH_TX1},
+       .iq_gain_db = 0.4,
+       .iq_phase_deg = 1.5,
+       .iq_dc_i = 0.011,
+       .iq_dc_q = -0.007,
+       .noise = 0x9e3779b97f4a7c15ull,
+       .rate_cfg = -1,
+       .n_dev = 1,
+       .env_once = PTHREAD_ONCE_INIT,
+       .setup = PTHREAD_MUTEX_INITIALIZER,
+       .first_tx = -1};
+
+static uint64_t mock_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void mock_sleep_ns(uint64_t ns) {
+    struct timespec ts = {(time_t)(ns / 1000000000ull), (long)(ns % 1000000000ull)};
+    nanosleep(&ts, NULL);
+}
+
+static void mock_usleep_ctl(unsigned us) {
+    if (us)
+        mock_sleep_ns((uint64_t)us * 1000ull);
+}
+
+static double mock_rate(const mock_stream_t *s) { return M.rate_cfg < 0 ? D[s->dev].host_sr : M.rate_cfg; }
+
+static void mock_env_once(void) {
+    const char *r = getenv("LMS_MOCK_RATE");
+    if (r && !strcmp(r, "max"))
+        M.rate_cfg = 0;
+    else if (r && strcmp(r, "host"))
+        M.rate_cfg = strtod(r, NULL);
+    const char *v = getenv("LMS_MOCK_REG_US");
+    M.reg_us = v ? (unsigned)strtoul(v, NULL, 0) : 0;
+    v = getenv("LMS_MOCK_GAIN_US");
+    M.gain_us = v ? (unsigned)strtoul(v, NULL, 0) : 0;
+    v = getenv("LMS_MOCK_TX_IQ");
+    if (v)
+        sscanf(v, "%lf:%lf:%lf:%lf", &M.iq_gain_db, &M.iq_phase_deg, &M.iq_dc_i, &M.iq_dc_q);
+    v = getenv("LMS_MOCK_INIT_US");
+    M.init_us = v ? (unsigned)strtoul(v, NULL, 0) : 0;
+    v = getenv("LMS_MOCK_DEVICES");
+    if (v) {
+        const unsigned long n = strtoul(v, NULL, 0);
+        M.n_dev = n < 1 ? 1 : n > MOCK_MAX_DEVICES ? MOCK_MAX_DEVICES : (unsigned)n;
+    }
+    for (unsigned d = 0; d < MOCK_MAX_DEVICES; d++) {
+        snprintf(D[d].info.deviceName, sizeof(D[d].info.deviceName), "LimeSDR-mock");
+        snprintf(D[d].info.firmwareVersion, sizeof(D[d].info.firmwareVersion), "mock");
+        D[d].info.boardSerialNumber = 0x10c0ffeeull + d;
+        pthread_mutex_init(&D[d].ctl, NULL);
+        D[d].host_sr = 1e6;
+    }
+}
+
+static void mock_env(void) { pthread_once(&M.env_once, mock_env_once); }
+
+// Handles are D entries; NULL (and anything foreign) falls back to the first board.
+static mock_dev_t *mock_dev(lms_device_t *device) {
+    mock_dev_t *d = (mock_dev_t *)device;
+    return d >= D && d < D + MOCK_MAX_DEVICES ? d : &D[0];
+}
+
+static mock_stream_t *mock_stream(const lms_stream_t *st) {
+    if (!st || st->handle < 1 || st->handle > MOCK_MAX_STREAMS || !M.s[st->handle - 1].used) {
+        snprintf(M.err, sizeof(M.err), "invalid stream handle");
+        return NULL;
+    }
+    return &M.s[st->handle - 1];
+}
+
+// Play out what the DAC consumed since the last call.
+static double mock_gaps_pending(const mock_stream_t *s) {
+    double sum = 0;
+    for (unsigned k = s->gap_rd; k != s->gap_wr; k++)
+        sum += s->gap_len[k % MOCK_TS_GAPS];
+    return sum;
+}
+
+static void mock_drain(mock_stream_t *s, uint64_t now) {
+    const double rate = mock_rate(s);
+    double played =
+        rate > 0 ? (double)(now - s->t_drain_ns) * 1e-9 * rate : s->silence + s->fill + mock_gaps_pending(s);
+    s->t_drain_ns = now;
+    for (;;) {
+        const double gap = played < s->silence ? played : s->silence;
+        s->silence -= gap;
+        s->consumed_acc += gap;
+        played -= gap;
+        // samples up to the next queued gap, then that gap
+        double avail = s->fill;
+        const bool more = s->gap_rd != s->gap_wr;
+        if (more) {
+            const double to_gap = (double)s->gap_at[s->gap_rd % MOCK_TS_GAPS] - ((double)s->pushed - s->fill);
+            avail = to_gap < avail ? to_gap : avail;
+        }
+        const double take = played < avail ? played : avail;
+        s->fill -= take;
+        s->consumed_acc += take;
+        played -= take;
+        if (!more || take < avail)
+            break;
+        s->silence += s->gap_len[s->gap_rd % MOCK_TS_GAPS];
+        s->gap_rd++;
+    }
+    if (played > 0) {
+        if (s->primed) {
+            s->underrun++;
+            s->underrun_total++;
+        } else if (s->idle) {
+            s->consumed_acc += played; // between bursts the counter runs on
+        }
+    }
+    s->consumed = (uint64_t)s->consumed_acc;
+}
+
+static int mock_cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void mock_report(void) {
+    if (!M.send_calls)
+        return;
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    const double cpu_s = (double)(ru.ru_utime.tv_sec - M.ru_first.ru_utime.tv_sec) +
+                         (double)(ru.ru_stime.tv_sec - M.ru_first.ru_stime.tv_sec) +
+                         (double)(ru.ru_utime.tv_usec - M.ru_first.ru_utime.tv_usec) / 1e6 +
+                         (double)(ru.ru_stime.tv_usec - M.ru_first.ru_stime.tv_usec) / 1e6;
+    const double wall_s = (double)(M.t_last_ns - M.t_first_ns) / 1e9;
+    const double msps = wall_s > 0 ? (double)M.frames_first / wall_s / 1e6 : 0.0;
+
+    const uint64_t ng = M.n_gaps < MOCK_GAP_SAMPLES ? M.n_gaps : MOCK_GAP_SAMPLES;
+    double p50 = 0, p99 = 0, p999 = 0, pmax = 0;
+    if (ng) {
+        qsort(M.gaps_ns, ng, sizeof(uint32_t), mock_cmp_u32);
+        p50 = M.gaps_ns[ng / 2] / 1e3;
+        p99 = M.gaps_ns[(uint64_t)((double)(ng - 1) * 0.99)] / 1e3;
+        p999 = M.gaps_ns[(uint64_t)((double)(ng - 1) * 0.999)] / 1e3;
+        pmax = M.gaps_ns[ng - 1] / 1e3;
+    }
+    uint64_t underruns = 0;
+    for (int i = 0; i < MOCK_MAX_STREAMS; i++)
+        underruns += M.s[i].underrun_total;
+
+    const char *label = getenv("LMS_MOCK_LABEL");
+    const double rate = M.first_tx >= 0 ? mock_rate(&M.s[M.first_tx]) : 0.0;
+    char line[768];
+    snprintf(line, sizeof(line),
+             "{\"case\":\"%s\",\"rate_hz\":%.0f,\"wall_s\":%.3f,\"frames\":%llu,\"msps\":%.3f,\"cpu_s\":%.3f,"
+             "\"cpu_ns_per_sample\":%.3f,\"chunk_us_p50\":%.1f,\"chunk_us_p99\":%.1f,\"chunk_us_p999\":%.1f,"
+             "\"chunk_us_max\":%.1f,\"send_calls\":%llu,\"underruns\":%llu,\"reg_ops\":%llu,\"gain_calls\":%llu}",
+             label ? label : "", rate, wall_s, (unsigned long long)M.frames_first, msps, cpu_s,
+             M.frames_all ? cpu_s * 1e9 / (double)M.frames_all : 0.0, p50, p99, p999, pmax,
+             (unsigned long long)M.send_calls, (unsigned long long)underruns, (unsigned long long)M.reg_ops,
+             (unsigned long long)M.gain_calls);
+    fprintf(stderr, "[lms_mock] %s\n", line);
+    const char *path = getenv("LMS_MOCK_REPORT");
+    if (path && *path) {
+        FILE *f = fopen(path, "a");
+        if (f) {
+            fprintf(f, "%s\n", line);
+            fclose(f);
+        }
+    }
+}
+
+// ---- device ----
+
+int LMS_GetDeviceList(lms_info_str_t *dev_list) {
+    mock_env();
+    for (unsigned d = 0; dev_list && d < M.n_dev; d++)
+        snprintf(dev_list[d], sizeof(lms_info_str_t), "LimeSDR-mock, media=mock, serial=%llx",
+                 (unsigned long long)D[d].info.boardSerialNumber);
+    return (int)M.n_dev;
+}
+
+int LMS_Open(lms_device_t **device, const lms_info_str_t info, void *args) {
+    (void)args;
+    mock_env();
+    unsigned d = 0;
+    const char *sn = info ? strstr(info, "serial=") : NULL;
+    if (sn) {
+        const unsigned long long want = strtoull(sn + 7, NULL, 16);
+        while (d < M.n_dev && D[d].info.boardSerialNumber != want)
+            d++;
+        if (d == M.n_dev) {
+            snprintf(M.err, sizeof(M.err), "no board with serial %llx", want);
+            return -1;
+        }
+    }
+    pthread_mutex_lock(&M.setup);
+    if (!M.n_open && !(M.gaps_ns = (uint32_t *)calloc(MOCK_GAP_SAMPLES, sizeof(uint32_t)))) {
+        pthread_mutex_unlock(&M.setup);
+        snprintf(M.err, sizeof(M.err), "out of memory");
+        return -1;
+    }
+    M.n_open++;
+    pthread_mutex_unlock(&M.setup);
+    *device = (lms_device_t *)&D[d];
+    return 0;
+}
+
+int LMS_Close(lms_device_t *device) {
+    (void)device;
+    pthread_mutex_lock(&M.setup);
+    if (M.n_open > 0 && !--M.n_open) {
+        mock_report();
+        free(M.gaps_ns);
+        M.gaps_ns = NULL;
+    }
+    pthread_mutex_unlock(&M.setup);
+    return 0;
+}
+
+int LMS_Init(lms_device_t *device) {
+    (void)device;
+    mock_usleep_ctl(M.init_us);
+    return 0;
+}
+
+int LMS_Reset(lms_device_t *device) {
+    (void)device;
+    memset(M.regs, 0, sizeof(M.regs));
+    return 0;
+}
+
+const lms_dev_info_t *LMS_GetDeviceInfo(lms_device_t *device) { return &mock_dev(device)->info;
+}
+
+// ---- control ----
+
+// TXEN_A/B and RXEN_A/B live in 0x0020[5:2] next to MAC, as on the chip, so a stale
+// read-modify-write of 0x0020 switches a channel off here too.
+static uint16_t mock_en_bit(bool dir_tx, size_t chan) { return (uint16_t)(1u << ((dir_tx ? 4 : 2) + (chan & 1))); }
+
+int LMS_EnableChannel(lms_device_t *device, bool dir_tx, size_t chan, bool enabled) {
+    pthread_mutex_t *ctl = &mock_dev(device)->ctl;
+    pthread_mutex_lock(ctl);
+    if (enabled)
+        M.regs[0x0020] |= mock_en_bit(dir_tx, chan);
+    else
+        M.regs[0x0020] &= (uint16_t)~mock_en_bit(dir_tx, chan);
+    pthread_mutex_unlock(ctl);
+    return 0;
+}
+
+int LMS_SetSampleRate(lms_device_t *device, float_type rate, size_t oversample) {
+    (void)oversample;
+    mock_dev(device)->host_sr = rate;
+    return 0;
+}
+
+int LMS_GetSampleRate(lms_device_t *device, bool dir_tx, size_t chan, float_type *host_Hz, float_type *rf_Hz) {
+    (void)dir_tx;
+    (void)chan;
+    if (host_Hz)
+        *host_Hz = mock_dev(device)->host_sr;
+    if (rf_Hz)
+        *rf_Hz = mock_dev(device)->host_sr * 32;
+    return 0;
+}
+
+int LMS_SetLOFrequency(lms_device_t *device, bool dir_tx, size_t chan, float_type frequency) {
+    (void)device;
+    (void)chan;
+    M.lo[dir_tx] = frequency;
+    return 0;
+}
+
+int LMS_GetLOFrequency(lms_device_t *device, bool dir_tx, size_t chan, float_type *frequency) {
+    (void)device;
+    (void)chan;
+    *frequency = M.lo[dir_tx];
+    return 0;
+}
+
+int LMS_SetAntenna(lms_device_t *device, bool dir_tx, size_t chan, size_t index) {
+    (void)device;
+    (void)chan;
+    M.path[dir_tx] = index;
+    return 0;
+}
+
+// LimeSDR-USB names; LB1/LB2 route the TX1/TX2 PA output back into the RX mixer.
+static const char *const mock_ant[2][6] = {{"NONE", "LNAH", "LNAL", "LNAW", "LB1", "LB2"},
+                                           {"NONE", "BAND1", "BAND2"}};
+
+int LMS_GetAntennaList(lms_device_t *device, bool dir_tx, size_t chan, lms_name_t *list) {
+    (void)device;
+    (void)chan;
+    const int n = dir_tx ? 3 : 6;
+    for (int i = 0; list && i < n; i++)
+        snprintf(list[i], sizeof(lms_name_t), "%s", mock_ant[dir_tx][i]);
+    return n;
+}
+
+int LMS_GetAntenna(lms_device_t *device, bool dir_tx, size_t chan) {
+    (void)device;
+    (void)chan;
+    return (int)M.path[dir_tx];
+}
+
+int LMS_SetGaindB(lms_device_t *device, bool dir_tx, size_t chan, unsigned gain) {
+    (void)chan;
+    pthread_mutex_t *ctl = &mock_dev(device)->ctl;
+    pthread_mutex_lock(ctl);
+    mock_usleep_ctl(M.gain_us);
+    M.gain[dir_tx] = gain;
+    M.gain_calls++;
+    pthread_mutex_unlock(ctl);
+    return 0;
+}
+
+int LMS_GetGaindB(lms_device_t *device, bool dir_tx, size_t chan, unsigned *gain) {
+    (void)device;
+    (void)chan;
+    *gain = M.gain[dir_tx];
+    return 0;
+}
+
+int LMS_SetLPFBW(lms_device_t *device, bool dir_tx, size_t chan, float_type bandwidth) {
+    (void)device;
+    (void)chan;
+    M.lpf_bw[dir_tx] = bandwidth;
+    return 0;
+}
+
+int LMS_GetLPFBW(lms_device_t *device, bool dir_tx, size_t chan, float_type *bandwidth) {
+    (void)device;
+    (void)chan;
+    *bandwidth = M.lpf_bw[dir_tx];
+    return 0;
+}
+
+int LMS_Calibrate(lms_device_t *device, bool dir_tx, size_t chan, double bw, unsigned flags) {
+    (void)device;
+    (void)dir_tx;
+    (void)chan;
+    (void)bw;
+    (void)flags;
+    return 0;
+}
+
+int LMS_LoadConfig(lms_device_t *device, const char *filename) {
+    (void)device;
+    FILE *f = fopen(filename, "r");
+    if (!f) {
+        snprintf(M.err, sizeof(M.err), "cannot open %s", filename);
+        return -1;
+    }
+    fclose(f);
+    return 0;
+}
+
+int LMS_SaveConfig(lms_device_t *device, const char *filename) {
+    (void)device;
+    FILE *f = fopen(filename, "w");
+    if (!f) {
+        snprintf(M.err, sizeof(M.err), "cannot write %s", filename);
+        return -1;
+    }
+    fprintf(f, "[lms_mock]\n");
+    fclose(f);
+    return 0;
+}
+
+int LMS_SetNCOFrequency(lms_device_t *device, bool dir_tx, size_t chan, const float_type *freq, float_type pho) {
+    (void)chan;
+    (void)pho;
+    pthread_mutex_t *ctl = &mock_dev(device)->ctl;
+    pthread_mutex_lock(ctl);
+    mock_usleep_ctl(32 * M.reg_us);
+    memcpy(M.nco[dir_tx], freq, sizeof(M.nco[dir_tx]));
+    M.reg_ops += 32;
+    pthread_mutex_unlock(ctl);
+    return 0;
+}
+
+int LMS_GetNCOFrequency(lms_device_t *device, bool dir_tx, size_t chan, float_type *freq, float_type *pho) {
+    (void)device;
+    (void)chan;
+    if (freq)
+        memcpy(freq, M.nco[dir_tx], sizeof(M.nco[dir_tx]));
+    if (pho)
+        *pho = 0;
+    return 0;
+}
+
+int LMS_SetNCOIndex(lms_device_t *device, bool dir_tx, size_t chan, int index, bool downconv) {
+    (void)chan;
+    (void)downconv;
+    pthread_mutex_t *ctl = &mock_dev(device)->ctl;
+    pthread_mutex_lock(ctl);
+    mock_usleep_ctl(M.reg_us);
+    M.nco_idx[dir_tx] = index;
+    M.nco_down[dir_tx] = downconv;
+    M.reg_ops++;
+    pthread_mutex_unlock(ctl);
+    return 0;
+}
+
+int LMS_GetNCOIndex(lms_device_t *device, bool dir_tx, size_t chan) {
+    (void)device;
+    (void)chan;
+    return M.nco_idx[dir_tx];
+}
+
+int LMS_ReadLMSReg(lms_device_t *device, uint32_t address, uint16_t *val) {
+    pthread_mutex_t *ctl = &mock_dev(device)->ctl;
+    pthread_mutex_lock(ctl);
+    mock_usleep_ctl(M.reg_us);
+    *val = M.regs[address & 0xffff];
+    M.reg_ops++;
+    pthread_mutex_unlock(ctl);
+    return 0;
+}
+
+int LMS_WriteLMSReg(lms_device_t *device, uint32_t address, uint16_t val) {
+    pthread_mutex_t *ctl = &mock_dev(device)->ctl;
+    pthread_mutex_lock(ctl);
+    mock_usleep_ctl(M.reg_us);
+    M.regs[address & 0xffff] = val;
+    M.reg_ops++;
+    pthread_mutex_unlock(ctl);
+    return 0;
+}
+
+int LMS_VCTCXOWrite(lms_device_t *device, uint16_t val) {
+    (void)device;
+    (void)val;
+    return 0;
+}
+
+int LMS_VCTCXORead(lms_device_t *device, uint16_t *val) {
+    (void)device;
+    *val = 128;
+    return 0;
+}
+
+// ---- streaming ----
+
+static int mock_setup_stream(mock_dev_t *dev, lms_stream_t *stream) {
+    for (int i = 0; i < MOCK_MAX_STREAMS; i++) {
+        if (!M.s[i].used) {
+            memset(&M.s[i], 0, sizeof(M.s[i]));
+            pthread_mutex_init(&M.s[i].mu, NULL);
+            M.s[i].used = true;
+            M.s[i].tx = stream->isTx;
+            M.s[i].dev = (int)(dev - D);
+            M.s[i].channel = stream->channel;
+            M.s[i].fifo_size = stream->fifoSize ? stream->fifoSize : (1u << 17);
+            M.s[i].frame_bytes = stream->dataFmt == LMS_FMT_F32 ? 8 : 4;
+            M.s[i].mem_bytes = (size_t)(M.s[i].fifo_size + (stream->isTx ? MOCK_LB_HISTORY : 0)) * M.s[i].frame_bytes;
+            M.s[i].mem = (uint8_t *)malloc(M.s[i].mem_bytes);
+            if (!M.s[i].mem) {
+                M.s[i].used = false;
+                snprintf(M.err, sizeof(M.err), "out of memory");
+                return -1;
+            }
+            if (stream->isTx && M.first_tx < 0)
+                M.first_tx = i;
+            stream->handle = (size_t)i + 1;
+            return 0;
+        }
+    }
+    snprintf(M.err, sizeof(M.err), "too many streams");
+    return -1;
+}
+
+int LMS_SetupStream(lms_device_t *device, lms_stream_t *stream) {
+    pthread_mutex_lock(&M.setup);
+    const int ret = mock_setup_stream(mock_dev(device), stream);
+    pthread_mutex_unlock(&M.setup);
+    return ret;
+}
+
+int LMS_DestroyStream(lms_device_t *device, lms_stream_t *stream) {
+    (void)device;
+    mock_stream_t *s = mock_stream(stream);
+    if (!s)
+        return -1;
+    pthread_mutex_lock(&M.setup);
+    s->used = false;
+    pthread_mutex_destroy(&s->mu);
+    free(s->mem);
+    s->mem = NULL;
+    pthread_mutex_unlock(&M.setup);
+    stream->handle = 0;
+    return 0;
+}
+
+int LMS_StartStream(lms_stream_t *stream) {
+    mock_stream_t *s = mock_stream(stream);
+    if (!s)
+        return -1;
+    s->started = true;
+    s->t_drain_ns = mock_now_ns();
+    return 0;
+}
+
+int LMS_StopStream(lms_stream_t *stream) {
+    mock_stream_t *s = mock_stream(stream);
+    if (!s)
+        return -1;
+    s->started = false;
+    return 0;
+}
+
+int LMS_SendStream(lms_stream_t *stream, const void *samples, size_t sample_count, const lms_stream_meta_t *meta,
+                   unsigned timeout_ms) {
+    mock_stream_t *s = mock_stream(stream);
+    if (!s)
+        return -1;
+    if (!s->started || !s->tx) {
+        snprintf(M.err, sizeof(M.err), "stream not started");
+        return -1;
+    }
+    uint64_t now = mock_now_ns();
+    const int idx = (int)(s - M.s);
+    if (idx == M.first_tx) {
+        if (!M.t_first_ns) {
+            M.t_first_ns = now;
+            getrusage(RUSAGE_SELF, &M.ru_first);
+        } else if (M.gaps_ns) {
+            uint64_t gap = now - M.t_prev_send_ns;
+            M.gaps_ns[M.n_gaps % MOCK_GAP_SAMPLES] = gap > UINT32_MAX ? UINT32_MAX : (uint32_t)gap;
+            M.n_gaps++;
+        }
+        M.t_prev_send_ns = now;
+    }
+
+    const double rate = mock_rate(s);
+    pthread_mutex_lock(&s->mu);
+    mock_drain(s, now);
+    if (meta && meta->waitForTimestamp) {
+        const bool empty = s->fill == 0.0 && s->gap_rd == s->gap_wr;
+        const double queued_to = s->consumed_acc + s->silence + s->fill + mock_gaps_pending(s);
+        if (empty && s->idle && (double)meta->timestamp < queued_to) {
+            s->dropped++;
+            M.send_calls++;
+            pthread_mutex_unlock(&s->mu);
+            return (int)sample_count;
+        }
+        if ((double)meta->timestamp > queued_to) {
+            if (empty)
+                s->silence += (double)meta->timestamp - queued_to;
+            else if (s->gap_wr - s->gap_rd < MOCK_TS_GAPS) {
+                s->gap_at[s->gap_wr % MOCK_TS_GAPS] = s->pushed;
+                s->gap_len[s->gap_wr % MOCK_TS_GAPS] = (double)meta->timestamp - queued_to;
+                s->gap_wr++;
+            }
+        }
+    }
+    if (rate > 0) {
+        // block until the FIFO has room, as the real stream does
+        const uint64_t deadline = now + (uint64_t)timeout_ms * 1000000ull;
+        const double need = (double)sample_count > s->fifo_size ? s->fifo_size : (double)sample_count;
+        while (s->fill + need > (double)s->fifo_size) {
+            if (now >= deadline) {
+                pthread_mutex_unlock(&s->mu);
+                snprintf(M.err, sizeof(M.err), "send timeout");
+                return 0;
+            }
+            const uint64_t wait_ns = (uint64_t)((s->fill + need - (double)s->fifo_size) / rate * 1e9) + 1000;
+            pthread_mutex_unlock(&s->mu);
+            mock_sleep_ns(wait_ns);
+            pthread_mutex_lock(&s->mu);
+            now = mock_now_ns();
+            mock_drain(s, now);
+        }
+    }
+    const uint8_t *src = (const uint8_t *)samples;
+    for (size_t left = sample_count * s->frame_bytes; left > 0;) {
+        size_t n = s->mem_bytes - s->mem_pos;
+        if (n > left)
+            n = left;
+        memcpy(s->mem + s->mem_pos, src, n);
+        s->mem_pos = (s->mem_pos + n) % s->mem_bytes;
+        src += n;
+        left -= n;
+    }
+    s->fill += (double)sample_count;
+    s->pushed += sample_count;
+    s->idle = meta && meta->flushPartialPacket;
+    s->primed = !s->idle;
+    pthread_mutex_unlock(&s->mu);
+
+    M.frames_all += sample_count;
+    if (idx == M.first_tx) {
+        M.frames_first += sample_count;
+        M.t_last_ns = now;
+    }
+    M.send_calls++;
+    return (int)sample_count;
+}
+
+static double mock_gauss(void) {
+    double u[2];
+    for (int k = 0; k < 2; k++) {
+        M.noise = M.noise * 6364136223846793005ull + 1442695040888963407ull;
+        u[k] = ((double)(M.noise >> 11) + 0.5) / 9007199254740992.0;
+    }
+    return sqrt(-2.0 * log(u[0])) * cos(2.0 * M_PI * u[1]);
+}
+
+// TX analog path after the TXTSP correctors: gain/phase imbalance and LO leakage (LMS_MOCK_TX_IQ).
+static void mock_tx_analog(double i, double q, double *oi, double *oq) {
+    const uint16_t byp = M.regs[0x0208];
+    if (!(byp & 2)) {
+        i *= (M.regs[0x0202] & 0x7ff) / 2048.0;
+        q *= (M.regs[0x0201] & 0x7ff) / 2048.0;
+    }
+    if (!(byp & 1)) {
+        int v = M.regs[0x0203] & 0xfff;
+        const double t = (v & 0x800 ? v - 0x1000 : v) / 2048.0;
+        const double i1 = i + t * q;
+        q += t * i;
+        i = i1;
+    }
+    if (!(byp & 8)) {
+        i += (int8_t)(M.regs[0x0204] >> 8) / 128.0;
+        q += (int8_t)(M.regs[0x0204] & 0xff) / 128.0;
+    }
+    const double g = pow(10.0, M.iq_gain_db / 40.0), h = M.iq_phase_deg * M_PI / 360.0;
+    *oi = g * (i * cos(h) + q * sin(h)) + M.iq_dc_i;
+    *oq = (q * cos(h) + i * sin(h)) / g + M.iq_dc_q;
+}
+
+// RX on LB1/LB2 while the FPGA waveform plays: the TX tone, its image and the TX LO leak as
+// the RX chain sees them, plus RX DC and noise. The TX path is memoryless and linear in u and
+// conj(u), so y = a u + b conj(u) + c is solved from three probes. Components the RX NCO moves
+// outside +-0.45 fs are dropped, as the decimation filters would.
+static void mock_loopback(mock_stream_t *s, int16_t *dst, size_t count) {
+    const double fs = D[s->dev].host_sr;
+    double yi[3], yq[3];
+    mock_tx_analog(0, 0, &yi[0], &yq[0]);
+    mock_tx_analog(M.wfm_i, M.wfm_q, &yi[1], &yq[1]);
+    mock_tx_analog(-M.wfm_q, M.wfm_i, &yi[2], &yq[2]); // j u
+    const double ar = yi[1] - yi[0], ai = yq[1] - yq[0];
+    const double jr = yq[2] - yq[0], ji = -(yi[2] - yi[0]); // (y(ju) - c) / j
+    const double tx_nco = M.nco[1][M.nco_idx[1] & 15] * (M.nco_down[1] ? -1.0 : 1.0);
+    const double rx_nco = M.nco[0][M.nco_idx[0] & 15] * (M.nco_down[0] ? -1.0 : 1.0);
+    const double f_sig = M.wfm_cyc * fs + tx_nco, dlo = M.lo[1] - M.lo[0];
+    const double lvl = 0.1 * pow(10.0, ((double)M.gain[0] - 40.0) / 20.0) * 32767.0;
+    const struct {
+        double f, re, im;
+    } comp[4] = {{f_sig + dlo + rx_nco, (ar + jr) / 2 * lvl, (ai + ji) / 2 * lvl},
+                 {-f_sig + dlo + rx_nco, (ar - jr) / 2 * lvl, (ai - ji) / 2 * lvl},
+                 {dlo + rx_nco, yi[0] * lvl, yq[0] * lvl},
+                 {rx_nco, 0.003 * 32767.0, -0.002 * 32767.0}};
+    for (size_t n = 0; n < count; n++) {
+        const double t = (double)(s->pushed + n) / fs;
+        double re = 3.0 * mock_gauss(), im = 3.0 * mock_gauss();
+        for (int k = 0; k < 4; k++) {
+            if (fabs(comp[k].f) > 0.45 * fs)
+                continue;
+            const double c = cos(2.0 * M_PI * comp[k].f * t), sn = sin(2.0 * M_PI * comp[k].f * t);
+            re += comp[k].re * c - comp[k].im * sn;
+            im += comp[k].re * sn + comp[k].im * c;
+        }
+        dst[2 * n] = (int16_t)fmax(-32768.0, fmin(32767.0, lrint(re)));
+        dst[2 * n + 1] = (int16_t)fmax(-32768.0, fmin(32767.0, lrint(im)));
+    }
+}
+
+// TX stream this RX loops back from: a started int16 one on the same board, same channel first.
+static mock_stream_t *mock_loopback_src(const mock_stream_t *rx) {
+    mock_stream_t *any = NULL;
+    for (int i = 0; i < MOCK_MAX_STREAMS; i++) {
+        mock_stream_t *t = &M.s[i];
+        if (!t->used || !t->tx || !t->started || t->dev != rx->dev || t->frame_bytes != 4)
+            continue;
+        if (t->channel == rx->channel)
+            return t;
+        if (!any)
+            any = t;
+    }
+    return any;
+}
+
+static void mock_loopback_stream(mock_stream_t *rx, mock_stream_t *tx, int16_t *dst, size_t count) {
+    const double lvl = 0.1 * pow(10.0, ((double)M.gain[0] - 40.0) / 20.0);
+    pthread_mutex_lock(&tx->mu);
+    mock_drain(tx, mock_now_ns());
+    const uint64_t played = tx->pushed - (uint64_t)ceil(tx->fill);
+    const uint64_t mem_frames = tx->mem_bytes / 4;
+    // A reader that falls behind works through a backlog, as the RX FIFO holds it; beyond that
+    // depth (or what the TX ring still has) samples are lost, as in a real RX overrun.
+    uint64_t from = rx->lb_played > played ? played : rx->lb_played;
+    uint64_t keep = (uint64_t)rx->fifo_size + count;
+    if (keep > mem_frames - (tx->pushed - played))
+        keep = mem_frames - (tx->pushed - played);
+    if (played - from > keep) {
+        from = played - keep;
+        rx->overrun++;
+    }
+    const size_t take = played - from < count ? (size_t)(played - from) : count;
+    const size_t pad = count - take; // TX not playing yet, or ran dry
+    memset(dst, 0, pad * 4);
+    // ring offset of sample `from`, then copy out in at most two pieces
+    size_t off = (tx->mem_pos + tx->mem_bytes - (size_t)((tx->pushed - from) * 4) % tx->mem_bytes) % tx->mem_bytes;
+    for (size_t left = take * 4, at = pad * 4; left > 0;) {
+        size_t n = tx->mem_bytes - off;
+        if (n > left)
+            n = left;
+        memcpy((uint8_t *)dst + at, tx->mem + off, n);
+        off = (off + n) % tx->mem_bytes;
+        at += n;
+        left -= n;
+    }
+    rx->lb_played = from + take;
+    pthread_mutex_unlock(&tx->mu);
+    // A triangular +-4 LSB dither stands in for the Gaussian noise floor: this runs at the full RX rate
+    uint64_t x = M.noise;
+    for (size_t n = 0; n < 2 * count; n++) {
+        x = x * 6364136223846793005ull + 1442695040888963407ull;
+        const int d = (int)((x >> 61) & 7) - (int)((x >> 58) & 7);
+        dst[n] = (int16_t)fmax(-32768.0, fmin(32767.0, lrint(lvl * dst[n]) + d));
+    }
+    M.noise = x;
+}
+
+int LMS_RecvStream(lms_stream_t *stream, void *samples, size_t sample_count, lms_stream_meta_t *meta,
+                   unsigned timeout_ms) {
+    (void)timeout_ms;
+    mock_stream_t *s = mock_stream(stream);
+    if (!s)
+        return -1;
+    const double rate = mock_rate(s);
+    if (rate > 0) {
+        const uint64_t due = s->t_drain_ns + (uint64_t)((double)(s->pushed + sample_count) / rate * 1e9);
+        const uint64_t now = mock_now_ns();
+        if (due > now)
+            mock_sleep_ns(due - now);
+    }
+    mock_stream_t *tx = NULL;
+    if (!(M.regs[0x0020] & mock_en_bit(false, s->channel)))
+        memset(samples, 0, sample_count * (stream->dataFmt == LMS_FMT_F32 ? 8 : 4)); // RXEN off: nothing
+    else if (M.wfm_on && M.path[0] >= 4 && stream->dataFmt != LMS_FMT_F32)
+        mock_loopback(s, (int16_t *)samples, sample_count);
+    else if (M.path[0] >= 4 && stream->dataFmt != LMS_FMT_F32 && (tx = mock_loopback_src(s)))
+        mock_loopback_stream(s, tx, (int16_t *)samples, sample_count);
+    else
+        memset(samples, 0, sample_count * (stream->dataFmt == LMS_FMT_F32 ? 8 : 4));
+    if (meta)
+        meta->timestamp = s->pushed;
+    s->pushed += sample_count;
+    return (int)sample_count;
+}
+
+// Underrun/overrun count since the previous call, as the real library reports them.
+int LMS_GetStreamStatus(lms_stream_t *stream, lms_stream_status_t *status) {
+    mock_stream_t *s = mock_stream(stream);
+    if (!s)
+        return -1;
+    memset(status, 0, sizeof(*status));
+    pthread_mutex_lock(&s->mu);
+    if (s->tx && s->started)
+        mock_drain(s, mock_now_ns());
+    status->active = s->started;
+    status->fifoFilledCount = (uint32_t)s->fill;
+    status->fifoSize = s->fifo_size;
+    status->underrun = s->underrun;
+    status->overrun = s->overrun;
+    status->droppedPackets = s->dropped;
+    status->sampleRate = mock_rate(s);
+    status->linkRate = status->sampleRate * (stream->linkFmt == LMS_LINK_FMT_I12 ? 3 : 4);
+    status->timestamp = s->tx ? s->consumed : s->pushed;
+    s->underrun = 0;
+    s->overrun = 0;
+    s->dropped = 0;
+    pthread_mutex_unlock(&s->mu);
+    return 0;
+}
+
+// Only the last channel's int16 waveform is kept, as a phasor and its rotation for mock_loopback.
+int LMS_UploadWFM(lms_device_t *device, const void **samples, uint8_t chCount, size_t sample_count, int format) {
+    (void)device;
+    if (format == 1 && chCount && sample_count >= 2) {
+        const int16_t *x = (const int16_t *)samples[chCount - 1];
+        M.wfm_i = x[0] / 32767.0;
+        M.wfm_q = x[1] / 32767.0;
+        M.wfm_cyc = (atan2(x[3], x[2]) - atan2(x[1], x[0])) / (2.0 * M_PI);
+        M.wfm_cyc -= floor(M.wfm_cyc + 0.5);
+    }
+    return 0;
+}
+
+int LMS_EnableTxWFM(lms_device_t *device, unsigned chan, bool active) {
+    (void)device;
+    (void)chan;
+    M.wfm_on = active;
+    return 0;
+}
+
+const char *LMS_GetLastErrorMessage(void) { return M.err[0] ? M.err : "no error"; }
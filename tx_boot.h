@@ -0,0 +1,174 @@
+#ifndef TX_BOOT_H
+#define TX_BOOT_H
+
+// Device bring-up with warm start and a per-phase timing breakdown.
+// --state-save stores the configured chip with LMS_SaveConfig. --state-load restores it with
+// LMS_LoadConfig in place of LMS_Init, and every setter below then reads the value back first
+// and skips the (PLL/CGEN tuning) call when it already matches the request.
+
+#include "lime/LimeSuite.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define TX_BOOT_MAX_PHASES 16
+#define TX_BOOT_FREQ_TOL_HZ 1.0
+#define TX_BOOT_BW_TOL_HZ 1e3
+
+typedef struct {
+    lms_device_t *dev;
+    int ch;
+    bool loaded; // state came from --state-load: verify before setting
+    unsigned skipped;
+
+    struct timespec t0, t_last, t_phase;
+    int n;
+    const char *name[TX_BOOT_MAX_PHASES];
+    double ms[TX_BOOT_MAX_PHASES];
+    bool skip[TX_BOOT_MAX_PHASES];
+} tx_boot_t;
+
+static inline double tx_boot_ms(const struct timespec *a, const struct timespec *b) {
+    return (double)(b->tv_sec - a->tv_sec) * 1e3 + (double)(b->tv_nsec - a->tv_nsec) / 1e6;
+}
+
+static inline void tx_boot_record(tx_boot_t *b, const char *name, const struct timespec *from, bool skipped) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (b->n < TX_BOOT_MAX_PHASES) {
+        b->name[b->n] = name;
+        b->ms[b->n] = tx_boot_ms(from, &now);
+        b->skip[b->n] = skipped;
+        b->n++;
+    }
+    if (skipped)
+        b->skipped++;
+    b->t_last = now;
+}
+
+// Start the clock; call before LMS_GetDeviceList.
+static inline void tx_boot_begin(tx_boot_t *b, int ch) {
+    memset(b, 0, sizeof(*b));
+    b->ch = ch;
+    clock_gettime(CLOCK_MONOTONIC, &b->t0);
+    b->t_last = b->t0;
+}
+
+static inline void tx_boot_phase(tx_boot_t *b) { clock_gettime(CLOCK_MONOTONIC, &b->t_phase); }
+
+// Close a phase that started where the previous one ended.
+static inline void tx_boot_mark(tx_boot_t *b, const char *name) { tx_boot_record(b, name, &b->t_last, false); }
+
+static inline void tx_boot_attach(tx_boot_t *b, lms_device_t *dev) {
+    b->dev = dev;
+    tx_boot_mark(b, "open");
+}
+
+// LMS_LoadConfig(state) when a state file is given and loads, LMS_Init otherwise.
+static inline int tx_boot_init_device(tx_boot_t *b, const char *state) {
+    tx_boot_phase(b);
+    if (state) {
+        if (LMS_LoadConfig(b->dev, state) == 0) {
+            b->loaded = true;
+            tx_boot_record(b, "load state", &b->t_phase, false);
+            printf("device state loaded from %s\n", state);
+            return 0;
+        }
+        fprintf(stderr, "WARN: LMS_LoadConfig(%s) failed: %s, doing a full init\n", state, LMS_GetLastErrorMessage());
+    }
+    int rc = LMS_Init(b->dev);
+    tx_boot_record(b, "init", &b->t_phase, false);
+    return rc;
+}
+
+static inline int tx_boot_save(tx_boot_t *b, const char *state) {
+    tx_boot_phase(b);
+    int rc = LMS_SaveConfig(b->dev, state);
+    tx_boot_record(b, "save state", &b->t_phase, false);
+    if (rc)
+        fprintf(stderr, "WARN: LMS_SaveConfig(%s) failed: %s\n", state, LMS_GetLastErrorMessage());
+    else
+        printf("device state saved to %s\n", state);
+    return rc;
+}
+
+static inline int tx_boot_sample_rate(tx_boot_t *b, double host_hz, int oversample) {
+    tx_boot_phase(b);
+    double host = 0, rf = 0;
+    if (b->loaded && !LMS_GetSampleRate(b->dev, LMS_CH_TX, b->ch, &host, &rf) &&
+        fabs(host - host_hz) < TX_BOOT_FREQ_TOL_HZ && host > 0 && fabs(rf / host - oversample) < 0.01) {
+        tx_boot_record(b, "sample rate", &b->t_phase, true);
+        return 0;
+    }
+    int rc = LMS_SetSampleRate(b->dev, host_hz, (size_t)oversample);
+    tx_boot_record(b, "sample rate", &b->t_phase, false);
+    return rc;
+}
+
+static inline int tx_boot_lpf_bw(tx_boot_t *b, double bw_hz) {
+    tx_boot_phase(b);
+    double bw = 0;
+    if (b->loaded && !LMS_GetLPFBW(b->dev, LMS_CH_TX, b->ch, &bw) && fabs(bw - bw_hz) < TX_BOOT_BW_TOL_HZ) {
+        tx_boot_record(b, "lpf bw", &b->t_phase, true);
+        return 0;
+    }
+    int rc = LMS_SetLPFBW(b->dev, LMS_CH_TX, b->ch, bw_hz);
+    tx_boot_record(b, "lpf bw", &b->t_phase, false);
+    return rc;
+}
+
+static inline int tx_boot_gain(tx_boot_t *b, int gain_db) {
+    tx_boot_phase(b);
+    unsigned int g = 0;
+    if (b->loaded && !LMS_GetGaindB(b->dev, LMS_CH_TX, b->ch, &g) && (int)g == gain_db) {
+        tx_boot_record(b, "gain", &b->t_phase, true);
+        return 0;
+    }
+    int rc = LMS_SetGaindB(b->dev, LMS_CH_TX, b->ch, (unsigned)gain_db);
+    tx_boot_record(b, "gain", &b->t_phase, false);
+    return rc;
+}
+
+static inline int tx_boot_lo(tx_boot_t *b, double lo_hz) {
+    tx_boot_phase(b);
+    double lo = 0;
+    if (b->loaded && !LMS_GetLOFrequency(b->dev, LMS_CH_TX, b->ch, &lo) && fabs(lo - lo_hz) < TX_BOOT_FREQ_TOL_HZ) {
+        tx_boot_record(b, "lo", &b->t_phase, true);
+        return 0;
+    }
+    int rc = LMS_SetLOFrequency(b->dev, LMS_CH_TX, b->ch, lo_hz);
+    tx_boot_record(b, "lo", &b->t_phase, false);
+    return rc;
+}
+
+// The NCO direction has no readback, so LMS_SetNCOIndex (one SPI write) always runs.
+static inline int tx_boot_nco(tx_boot_t *b, const double freqs[16], int index, bool downconvert) {
+    tx_boot_phase(b);
+    double cur[16] = {0}, pho = 0;
+    bool same = b->loaded && !LMS_GetNCOFrequency(b->dev, true, b->ch, cur, &pho);
+    for (int i = 0; same && i < 16; i++) // every slot: --hop switches between them
+        same = fabs(cur[i] - freqs[i]) < TX_BOOT_FREQ_TOL_HZ;
+    int rc = same ? 0 : LMS_SetNCOFrequency(b->dev, true, b->ch, freqs, 0.0);
+    if (!rc)
+        rc = LMS_SetNCOIndex(b->dev, true, b->ch, index, downconvert);
+    tx_boot_record(b, "nco", &b->t_phase, same);
+    return rc;
+}
+
+static inline void tx_boot_print(const tx_boot_t *b) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    const double total = tx_boot_ms(&b->t0, &now);
+    double sum = 0;
+    printf("startup timing (%s):\n", b->loaded ? "warm, state loaded" : "cold");
+    for (int i = 0; i < b->n; i++) {
+        printf("  %-12s %9.1f ms%s\n", b->name[i], b->ms[i], b->skip[i] ? "  (readback matched, skipped)" : "");
+        sum += b->ms[i];
+    }
+    printf("  %-12s %9.1f ms\n", "other", total - sum);
+    printf("  %-12s %9.1f ms\n", "total", total);
+}
+
+#endif
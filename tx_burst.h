@@ -0,0 +1,267 @@
+#ifndef TX_BURST_H
+#define TX_BURST_H
+
+// Timestamped burst TX. Instead of streaming continuously, each burst is queued once with
+// meta.waitForTimestamp set, so the FPGA holds it until its first frame is due and plays it at
+// that exact sample. The last send of a burst sets flushPartialPacket, so the tail leaves the
+// host right away instead of waiting in a half-filled USB packet for samples that never come.
+// Between bursts the host sleeps and nothing crosses USB; the DAC idles at zero.
+//
+// Burst times are in samples from the burst origin ts0, which is the queue lead plus
+// TX_BURST_LEAD_MS ahead of the device counter when tx_burst_start() runs. The stream thread sleeps until a burst is
+// `lead` samples away on the device counter (extrapolated from LMS_GetStreamStatus, refreshed
+// before each burst), then hands it over. Lateness is how far the counter has already passed
+// the burst time when its first frame is queued: negative is margin, positive means the FPGA
+// throws packets away (they show up as droppedPackets). A burst that would start before the
+// previous one ends is pushed back to that end and counted as an overlap.
+//
+// Index files list one burst per line, "<at> <offset> <frames>" in samples (offset: first frame
+// in the source); '#' starts a comment. A byte stream (the pipe) carries each burst as a
+// tx_burst_hdr_t followed by its frames.
+
+#include "lime/LimeSuite.h"
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TX_BURST_LEAD_MS 20                // burst origin ahead of the device counter, past the queue lead
+#define TX_BURST_QUEUE_MS_DEF 10           // --burst-lead: hand a burst over this long before it is due
+#define TX_BURST_QUEUE_MS_MAX 1000
+#define TX_BURST_SLEEP_MAX_NS 100000000ull // re-check stop at least this often while idle
+#define TX_BURST_STATS_MAX (1u << 16)      // lateness samples kept for percentiles (ring, newest win)
+#define TX_BURST_INDEX_MAX (1u << 20)
+
+#define TX_BURST_MAGIC 0x31425149u // "IQB1", little-endian
+
+typedef struct {
+    uint32_t magic;
+    uint32_t frames;
+    uint64_t at; // samples from the burst origin
+} tx_burst_hdr_t;
+
+typedef struct {
+    uint64_t at;     // samples from the burst origin
+    uint64_t offset; // first source frame
+    uint64_t frames;
+} tx_burst_ent_t;
+
+typedef struct {
+    lms_stream_t *s;
+    double fs;
+    uint64_t ts0;  // device timestamp of burst time 0
+    uint64_t lead; // samples
+    uint64_t anchor_ts, anchor_ns;
+
+    uint64_t ts;   // device timestamp of the next frame of the current burst
+    uint64_t left; // frames of it still to send
+    uint64_t end;  // first timestamp after the last burst queued
+
+    uint64_t t_start_ns;
+    uint64_t bursts, frames, late, overlaps;
+    uint64_t dropped, underruns; // from the stream status
+    int64_t *late_ns;            // TX_BURST_STATS_MAX ring
+    uint64_t n_late;
+} tx_burst_t;
+
+static inline uint64_t tx_burst_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static inline void tx_burst_sleep_ns(uint64_t ns) {
+    struct timespec ts = {(time_t)(ns / 1000000000ull), (long)(ns % 1000000000ull)};
+    nanosleep(&ts, NULL);
+}
+
+// "<len_ms>:<period_ms>", for periodic generator bursts.
+static inline bool tx_burst_parse_period(const char *s, double *len_ms, double *period_ms) {
+    char *end = NULL;
+    *len_ms = strtod(s, &end);
+    if (end == s || *end != ':')
+        return false;
+    const char *p = end + 1;
+    *period_ms = strtod(p, &end);
+    return end != p && !*end && *len_ms > 0 && *period_ms >= *len_ms;
+}
+
+// Index file -> *ents (malloc'd, sorted as written). Returns the count, or -1 after a message.
+static inline long tx_burst_load_index(const char *path, tx_burst_ent_t **ents) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "burst index %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    size_t n = 0, cap = 0;
+    tx_burst_ent_t *v = NULL;
+    char line[256];
+    int lineno = 0;
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+        char *hash = strchr(line, '#');
+        if (hash)
+            *hash = '\0';
+        unsigned long long at, off, frames;
+        char extra;
+        const int got = sscanf(line, "%llu %llu %llu %c", &at, &off, &frames, &extra);
+        if (got <= 0)
+            continue; // blank or comment
+        if (got != 3 || frames == 0 || n == TX_BURST_INDEX_MAX) {
+            fprintf(stderr, "burst index %s:%d: want \"<at> <offset> <frames>\" in samples\n", path, lineno);
+            goto fail;
+        }
+        if (n == cap) {
+            cap = cap ? 2 * cap : 256;
+            tx_burst_ent_t *nv = (tx_burst_ent_t *)realloc(v, cap * sizeof(*v));
+            if (!nv)
+                goto fail;
+            v = nv;
+        }
+        v[n++] = (tx_burst_ent_t){.at = at, .offset = off, .frames = frames};
+    }
+    fclose(f);
+    if (!n) {
+        fprintf(stderr, "burst index %s: no bursts\n", path);
+        free(v);
+        return -1;
+    }
+    *ents = v;
+    return (long)n;
+fail:
+    fclose(f);
+    free(v);
+    return -1;
+}
+
+static inline void tx_burst_anchor(tx_burst_t *b) {
+    lms_stream_status_t st;
+    memset(&st, 0, sizeof(st));
+    if (LMS_GetStreamStatus(b->s, &st))
+        return;
+    b->anchor_ts = st.timestamp;
+    b->anchor_ns = tx_burst_now_ns();
+    b->dropped += st.droppedPackets;
+    b->underruns += st.underrun;
+}
+
+static inline double tx_burst_device_ts(const tx_burst_t *b) {
+    return (double)b->anchor_ts + (double)(tx_burst_now_ns() - b->anchor_ns) * 1e-9 * b->fs;
+}
+
+// After LMS_StartStream. queue_ms: how long before its time a burst is handed to the FPGA.
+static inline int tx_burst_start(tx_burst_t *b, lms_stream_t *s, double fs, double queue_ms) {
+    memset(b, 0, sizeof(*b));
+    b->s = s;
+    b->fs = fs;
+    b->lead = (uint64_t)(fs * queue_ms / 1000.0);
+    b->late_ns = (int64_t *)malloc(TX_BURST_STATS_MAX * sizeof(int64_t));
+    if (!b->late_ns) {
+        fprintf(stderr, "malloc failed\n");
+        return -1;
+    }
+    tx_burst_anchor(b);
+    if (!b->anchor_ns) {
+        fprintf(stderr, "burst: LMS_GetStreamStatus failed: %s\n", LMS_GetLastErrorMessage());
+        return -1;
+    }
+    b->ts0 = b->anchor_ts + b->lead + (uint64_t)(fs * TX_BURST_LEAD_MS / 1000.0);
+    b->end = b->ts0;
+    b->t_start_ns = b->anchor_ns;
+    return 0;
+}
+
+// Open burst `at` of `frames`: sleep until it is due for queueing. False when *run dropped first.
+static inline bool tx_burst_begin(tx_burst_t *b, uint64_t at, uint64_t frames, const volatile int *run) {
+    uint64_t ts = b->ts0 + at;
+    if (ts < b->end) {
+        ts = b->end;
+        b->overlaps++;
+    }
+    const double target = (double)ts - (double)b->lead;
+    tx_burst_anchor(b);
+    for (;;) {
+        if (!*run)
+            return false;
+        const double now = tx_burst_device_ts(b);
+        if (now >= target)
+            break;
+        uint64_t ns = (uint64_t)((target - now) / b->fs * 1e9) + 1;
+        tx_burst_sleep_ns(ns < TX_BURST_SLEEP_MAX_NS ? ns : TX_BURST_SLEEP_MAX_NS);
+    }
+    tx_burst_anchor(b); // measure against the counter, not the extrapolation
+    const int64_t late_ns = (int64_t)((tx_burst_device_ts(b) - (double)ts) / b->fs * 1e9);
+    b->late_ns[b->n_late++ % TX_BURST_STATS_MAX] = late_ns;
+    if (late_ns > 0)
+        b->late++;
+    b->ts = ts;
+    b->left = frames;
+    b->end = ts + frames;
+    b->bursts++;
+    return true;
+}
+
+// Queue the next n frames of the open burst (n <= what is left of it). 0, or -1 on a send error.
+static inline int tx_burst_send(tx_burst_t *b, const int16_t *src, size_t n, unsigned timeout_ms) {
+    if (n > b->left)
+        n = (size_t)b->left;
+    lms_stream_meta_t meta;
+    memset(&meta, 0, sizeof(meta));
+    meta.waitForTimestamp = true;
+    meta.timestamp = b->ts;
+    meta.flushPartialPacket = n == b->left;
+    const int done = LMS_SendStream(b->s, src, n, &meta, timeout_ms);
+    if (done < 0 || (size_t)done != n)
+        return -1;
+    b->ts += n;
+    b->left -= n;
+    b->frames += n;
+    return 0;
+}
+
+// Sleep until the last queued burst has played; stopping the stream earlier would discard it.
+static inline void tx_burst_drain(tx_burst_t *b, const volatile int *run) {
+    tx_burst_anchor(b);
+    for (;;) {
+        const double left = (double)b->end - tx_burst_device_ts(b);
+        if (!*run || left <= 0)
+            return;
+        const uint64_t ns = (uint64_t)(left / b->fs * 1e9) + 1;
+        tx_burst_sleep_ns(ns < TX_BURST_SLEEP_MAX_NS ? ns : TX_BURST_SLEEP_MAX_NS);
+    }
+}
+
+static inline int tx_burst_cmp_i64(const void *x, const void *y) {
+    const int64_t a = *(const int64_t *)x, c = *(const int64_t *)y;
+    return a < c ? -1 : a > c;
+}
+
+static inline void tx_burst_print(tx_burst_t *b) {
+    if (!b->late_ns)
+        return;
+    tx_burst_anchor(b);
+    const double wall_s = (double)(tx_burst_now_ns() - b->t_start_ns) * 1e-9;
+    printf("burst: %" PRIu64 " bursts, %" PRIu64 " frames queued (duty %.1f%%), %" PRIu64 " overlapped, %" PRIu64
+           " dropped packets, %" PRIu64 " underruns\n",
+           b->bursts, b->frames, wall_s > 0 ? 100.0 * (double)b->frames / (wall_s * b->fs) : 0.0, b->overlaps,
+           b->dropped, b->underruns);
+    const uint64_t n = b->n_late < TX_BURST_STATS_MAX ? b->n_late : TX_BURST_STATS_MAX;
+    if (!n)
+        return;
+    qsort(b->late_ns, n, sizeof(int64_t), tx_burst_cmp_i64);
+    printf("burst: lateness at queue time p50 %.1f us, p99 %.1f us, max %.1f us (lead %.1f ms); %" PRIu64
+           " late\n",
+           (double)b->late_ns[n / 2] / 1e3, (double)b->late_ns[(n * 99) / 100] / 1e3, (double)b->late_ns[n - 1] / 1e3,
+           (double)b->lead / b->fs * 1e3, b->late);
+}
+
+static inline void tx_burst_free(tx_burst_t *b) {
+    free(b->late_ns);
+    b->late_ns = NULL;
+}
+
+#endif
@@ -0,0 +1,241 @@
+#ifndef TX_CALCACHE_H
+#define TX_CALCACHE_H
+
+// Persistent TX calibration cache.
+// LMS_Calibrate takes seconds, but all it leaves behind are five TXTSP corrector values. Entries
+// are keyed by board serial, channel, LO, NCO, calibration bandwidth and a gain bucket and kept
+// one per line in a small text file. A fresh entry at the same LO is restored through
+// limetx_apply_manual(); failing that, two fresh entries bracketing the LO (same other keys, at
+// most TXCAL_INTERP_MAX_HZ apart) are interpolated linearly. Only then is LMS_Calibrate (or the
+// loopback trim in tx_trim.h) run and its result stored.
+
+#include "limetx.h"
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#define TXCAL_GAIN_BUCKET_DB 10
+#define TXCAL_MAX_AGE_DEF_S (7 * 24 * 3600)
+#define TXCAL_INTERP_MAX_HZ 20e6
+#define TXCAL_FREQ_TOL_HZ 1.0
+#define TXCAL_MAX_ENTRIES 1024
+#define TXCAL_PATH_MAX 512
+
+typedef struct {
+    uint64_t serial;
+    int ch;
+    double lo_hz, nco_hz, bw_hz;
+    int gain_bucket; // gain_dB / TXCAL_GAIN_BUCKET_DB
+} txcal_key_t;
+
+typedef struct {
+    txcal_key_t key;
+    int64_t t; // unix time the calibration ran
+    int gi, gq, iq, dci, dcq;
+} txcal_entry_t;
+
+// $XDG_CACHE_HOME/limesdr_tests/tx_cal.txt, else ~/.cache/..., else ./tx_cal.txt
+static inline void txcal_default_path(char *out, size_t n) {
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    if (xdg && *xdg)
+        snprintf(out, n, "%s/limesdr_tests/tx_cal.txt", xdg);
+    else if (home && *home)
+        snprintf(out, n, "%s/.cache/limesdr_tests/tx_cal.txt", home);
+    else
+        snprintf(out, n, "tx_cal.txt");
+}
+
+static inline int txcal_key_init(txcal_key_t *k, lms_device_t *dev, int ch, double lo_hz, double nco_hz,
+                                 double bw_hz) {
+    memset(k, 0, sizeof(*k));
+    const lms_dev_info_t *info = LMS_GetDeviceInfo(dev);
+    unsigned int g = 0;
+    if (!info || LMS_GetGaindB(dev, LMS_CH_TX, ch, &g))
+        return -1;
+    k->serial = info->boardSerialNumber;
+    k->ch = ch;
+    k->lo_hz = lo_hz;
+    k->nco_hz = nco_hz;
+    k->bw_hz = bw_hz;
+    k->gain_bucket = (int)g / TXCAL_GAIN_BUCKET_DB;
+    return 0;
+}
+
+// Same calibration point apart from the LO.
+static inline bool txcal_key_compatible(const txcal_key_t *a, const txcal_key_t *b) {
+    return a->serial == b->serial && a->ch == b->ch && a->gain_bucket == b->gain_bucket &&
+           fabs(a->nco_hz - b->nco_hz) < TXCAL_FREQ_TOL_HZ && fabs(a->bw_hz - b->bw_hz) < TXCAL_FREQ_TOL_HZ;
+}
+
+static inline int txcal_load(const char *path, txcal_entry_t *e, int max) {
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return 0;
+    int n = 0;
+    char line[256];
+    while (n < max && fgets(line, sizeof(line), f)) {
+        if (line[0] == '#')
+            continue;
+        txcal_entry_t x;
+        memset(&x, 0, sizeof(x));
+        if (sscanf(line, "%" SCNx64 " %d %lf %lf %lf %d %" SCNd64 " %d %d %d %d %d", &x.key.serial, &x.key.ch,
+                   &x.key.lo_hz, &x.key.nco_hz, &x.key.bw_hz, &x.key.gain_bucket, &x.t, &x.gi, &x.gq, &x.iq, &x.dci,
+                   &x.dcq) == 12)
+            e[n++] = x;
+    }
+    fclose(f);
+    return n;
+}
+
+// mkdir -p for the directory part of path
+static inline void txcal_mkdirs(const char *path) {
+    char tmp[TXCAL_PATH_MAX];
+    snprintf(tmp, sizeof(tmp), "%s", path);
+    for (char *p = tmp + 1; *p; p++) {
+        if (*p != '/')
+            continue;
+        *p = '\0';
+        (void)mkdir(tmp, 0755);
+        *p = '/';
+    }
+}
+
+// Write to a temp file and rename, so a crash never leaves a truncated cache.
+static inline int txcal_save(const char *path, const txcal_entry_t *e, int n) {
+    char tmp[TXCAL_PATH_MAX + 8];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    txcal_mkdirs(path);
+    FILE *f = fopen(tmp, "w");
+    if (!f)
+        return -1;
+    fprintf(f, "# serial ch lo_hz nco_hz bw_hz gain_bucket(%d dB) unix_time gcorri gcorrq iqcorr dccorri dccorrq\n",
+            TXCAL_GAIN_BUCKET_DB);
+    for (int i = 0; i < n; i++)
+        fprintf(f, "%" PRIx64 " %d %.0f %.0f %.0f %d %" PRId64 " %d %d %d %d %d\n", e[i].key.serial, e[i].key.ch,
+                e[i].key.lo_hz, e[i].key.nco_hz, e[i].key.bw_hz, e[i].key.gain_bucket, e[i].t, e[i].gi, e[i].gq,
+                e[i].iq, e[i].dci, e[i].dcq);
+    if (fclose(f) || rename(tmp, path)) {
+        remove(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+// Exact LO hit, else interpolation between the nearest fresh entries below and above the LO.
+static inline bool txcal_lookup(const txcal_entry_t *e, int n, const txcal_key_t *k, int64_t now, int max_age_s,
+                                limetx_txtsp_t *out, int *age_s, double *lo_a, double *lo_b) {
+    const txcal_entry_t *below = NULL, *above = NULL;
+    for (int i = 0; i < n; i++) {
+        const txcal_entry_t *x = &e[i];
+        if (!txcal_key_compatible(&x->key, k) || now - x->t > max_age_s)
+            continue;
+        if (x->key.lo_hz <= k->lo_hz + TXCAL_FREQ_TOL_HZ && (!below || x->key.lo_hz > below->key.lo_hz ||
+                                                             (x->key.lo_hz == below->key.lo_hz && x->t > below->t)))
+            below = x;
+        if (x->key.lo_hz >= k->lo_hz - TXCAL_FREQ_TOL_HZ && (!above || x->key.lo_hz < above->key.lo_hz ||
+                                                             (x->key.lo_hz == above->key.lo_hz && x->t > above->t)))
+            above = x;
+    }
+    if (below && fabs(below->key.lo_hz - k->lo_hz) < TXCAL_FREQ_TOL_HZ)
+        above = below;
+    else if (above && fabs(above->key.lo_hz - k->lo_hz) < TXCAL_FREQ_TOL_HZ)
+        below = above;
+    if (!below || !above || above->key.lo_hz - below->key.lo_hz > TXCAL_INTERP_MAX_HZ)
+        return false;
+
+    const double span = above->key.lo_hz - below->key.lo_hz;
+    const double w = span > 0.0 ? (k->lo_hz - below->key.lo_hz) / span : 0.0;
+#define TXCAL_LERP(f) ((int)lround(below->f + w * (above->f - below->f)))
+    memset(out, 0, sizeof(*out));
+    out->gi = TXCAL_LERP(gi);
+    out->gq = TXCAL_LERP(gq);
+    out->iq = TXCAL_LERP(iq);
+    out->dci = TXCAL_LERP(dci);
+    out->dcq = TXCAL_LERP(dcq);
+#undef TXCAL_LERP
+    *age_s = (int)(now - (below->t < above->t ? below->t : above->t));
+    *lo_a = below->key.lo_hz;
+    *lo_b = above->key.lo_hz;
+    return true;
+}
+
+// Restore a fresh cached (or interpolated) entry for k. Returns true when the correctors were applied.
+static inline bool txcal_restore(limetx_regs_t *r, const txcal_key_t *k, const char *path, int max_age_s) {
+    static txcal_entry_t e[TXCAL_MAX_ENTRIES];
+    const int n = path ? txcal_load(path, e, TXCAL_MAX_ENTRIES) : 0;
+    limetx_txtsp_t c;
+    int age_s = 0;
+    double lo_a = 0, lo_b = 0;
+    if (!txcal_lookup(e, n, k, (int64_t)time(NULL), max_age_s, &c, &age_s, &lo_a, &lo_b))
+        return false;
+    if (lo_a == lo_b)
+        printf("calibration cache: hit at LO %.6f MHz (age %d s)\n", lo_a / 1e6, age_s);
+    else
+        printf("calibration cache: interpolated between LO %.6f and %.6f MHz (age %d s)\n", lo_a / 1e6, lo_b / 1e6,
+               age_s);
+    if (limetx_apply_manual(r, k->ch, true, c.gi, true, c.gq, true, c.iq, true, c.dci, true, c.dcq) == 0)
+        return true;
+    fprintf(stderr, "WARN: restoring cached correctors failed\n");
+    return false;
+}
+
+// Read the correctors now on the chip and store them for k.
+static inline void txcal_store(limetx_regs_t *r, const txcal_key_t *k, const char *path) {
+    static txcal_entry_t e[TXCAL_MAX_ENTRIES];
+    limetx_txtsp_t c;
+    if (limetx_read_txtsp(r, k->ch, &c)) {
+        fprintf(stderr, "WARN: can't read correctors, calibration not cached\n");
+        return;
+    }
+    int n = txcal_load(path, e, TXCAL_MAX_ENTRIES);
+
+    // Replace an entry for the same point, else append (dropping the oldest when full)
+    int slot = -1;
+    for (int i = 0; i < n && slot < 0; i++)
+        if (txcal_key_compatible(&e[i].key, k) && fabs(e[i].key.lo_hz - k->lo_hz) < TXCAL_FREQ_TOL_HZ)
+            slot = i;
+    if (slot < 0 && n < TXCAL_MAX_ENTRIES)
+        slot = n++;
+    if (slot < 0) {
+        slot = 0;
+        for (int i = 1; i < n; i++)
+            if (e[i].t < e[slot].t)
+                slot = i;
+    }
+    e[slot].key = *k;
+    e[slot].t = (int64_t)time(NULL);
+    e[slot].gi = c.gi;
+    e[slot].gq = c.gq;
+    e[slot].iq = c.iq;
+    e[slot].dci = c.dci;
+    e[slot].dcq = c.dcq;
+    if (txcal_save(path, e, n))
+        fprintf(stderr, "WARN: can't write calibration cache %s: %s\n", path, strerror(errno));
+}
+
+// Drop-in for LMS_Calibrate(TX): restore from the cache at path when possible, otherwise
+// calibrate and store the result. path == NULL disables the cache. Returns LMS_Calibrate's rc
+// (0 on a cache hit).
+static inline int txcal_calibrate(limetx_regs_t *r, const txcal_key_t *k, const char *path, int max_age_s) {
+    if (path && txcal_restore(r, k, path, max_age_s))
+        return 0;
+    if (path)
+        printf("calibration cache: miss, running LMS_Calibrate\n");
+
+    int rc = LMS_Calibrate(r->dev, LMS_CH_TX, k->ch, k->bw_hz, 0);
+    limetx_regs_invalidate(r);
+    if (rc || !path)
+        return rc;
+    txcal_store(r, k, path);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,184 @@
+#ifndef TX_CHUNK_H
+#define TX_CHUNK_H
+
+// Runtime sizing of the per-send chunk. By default the tools send BUF_SAMPLES frames per
+// LMS_SendStream into a FIFO_SIZE_SAMPLES host FIFO; with a goal set, their once-a-second
+// LMS_GetStreamStatus poll is handed to tx_chunk_update(), which moves the chunk between min and max:
+//
+//   underrun  double the chunk on any underrun and keep that size as a floor; after
+//             TX_CHUNK_CALM_POLLS clean polls shrink it by a quarter, never below the floor. Settles
+//             on the smallest chunk that has not underrun. The floor is sticky, so an underrun caused
+//             by a stalled producer also raises it.
+//   latency   the budget covers what is queued ahead of a new sample: the FIFO fill plus one chunk.
+//             The FIFO cannot change once the stream runs, so tx_chunk_fifo_for_latency() sizes it
+//             from the budget at setup and the chunk is capped at a quarter of it. Shrink while the
+//             estimate is over budget, double on an underrun while twice the chunk still fits.
+//
+// Chunks move in TX_CHUNK_ALIGN frame steps and never exceed half the FIFO, so a blocking send
+// always finds room for it; a fixed --chunk over that is clamped too. Callers size their buffers
+// for c->max after tx_chunk_init() and read c->cur before each chunk.
+
+#include "lime/LimeSuite.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TX_CHUNK_ALIGN 64
+#define TX_CHUNK_MIN 256
+#define TX_CHUNK_MAX_DEF 65536
+#define TX_CHUNK_CALM_POLLS 30
+
+typedef enum { TX_CHUNK_FIXED = 0, TX_CHUNK_UNDERRUN, TX_CHUNK_LATENCY } tx_chunk_goal_t;
+
+typedef struct {
+    tx_chunk_goal_t goal;
+    size_t min, max, cur; // frames per send
+    size_t floor;         // underrun goal: no shrinking below this
+    uint32_t fifo_size;
+    double sr;
+    double latency_ms; // latency goal budget
+    double est_ms;     // (fifo fill + chunk) / sr at the last poll
+    unsigned calm;     // clean polls since the last change
+    uint64_t underruns;
+    uint64_t changes;
+} tx_chunk_t;
+
+// "underrun" or "latency:<ms>"; "off" keeps the fixed chunk.
+static inline bool tx_chunk_parse_goal(const char *s, tx_chunk_goal_t *goal, double *latency_ms) {
+    if (!strcmp(s, "off")) {
+        *goal = TX_CHUNK_FIXED;
+        return true;
+    }
+    if (!strcmp(s, "underrun")) {
+        *goal = TX_CHUNK_UNDERRUN;
+        return true;
+    }
+    if (!strncmp(s, "latency:", 8)) {
+        char *end = NULL;
+        double ms = strtod(s + 8, &end);
+        if (end == s + 8 || *end || ms <= 0.0)
+            return false;
+        *goal = TX_CHUNK_LATENCY;
+        *latency_ms = ms;
+        return true;
+    }
+    return false;
+}
+
+static inline const char *tx_chunk_goal_name(tx_chunk_goal_t goal) {
+    return goal == TX_CHUNK_UNDERRUN ? "underrun" : (goal == TX_CHUNK_LATENCY ? "latency" : "fixed");
+}
+
+static inline size_t tx_chunk_align(size_t n) {
+    n = n / TX_CHUNK_ALIGN * TX_CHUNK_ALIGN;
+    return n < TX_CHUNK_ALIGN ? TX_CHUNK_ALIGN : n;
+}
+
+// FIFO size for a latency budget: three quarters of it, the rest is for the chunk being queued.
+static inline uint32_t tx_chunk_fifo_for_latency(double latency_ms, double sr) {
+    double n = latency_ms * 1e-3 * sr * 0.75;
+    if (n < 4.0 * TX_CHUNK_MIN)
+        n = 4.0 * TX_CHUNK_MIN;
+    if (n > (double)(1u << 30))
+        n = (double)(1u << 30);
+    return (uint32_t)tx_chunk_align((size_t)n);
+}
+
+// start is the first chunk (the fixed one with TX_CHUNK_FIXED); max_def bounds an adaptive chunk.
+static inline void tx_chunk_init(tx_chunk_t *c, tx_chunk_goal_t goal, double sr, uint32_t fifo_size, size_t start,
+                                 size_t max_def, double latency_ms) {
+    memset(c, 0, sizeof(*c));
+    c->goal = goal;
+    c->sr = sr;
+    c->fifo_size = fifo_size;
+    c->latency_ms = latency_ms;
+    if (start < 1)
+        start = 1;
+    if (goal == TX_CHUNK_FIXED) {
+        if (start > fifo_size / 2) {
+            fprintf(stderr, "WARN: --chunk %zu is over half the %u sample fifo, using %u\n", start, fifo_size,
+                    fifo_size / 2);
+            start = fifo_size / 2;
+        }
+        c->min = c->max = c->cur = start;
+        return;
+    }
+
+    size_t max = max_def;
+    if (max > fifo_size / 2)
+        max = fifo_size / 2;
+    if (goal == TX_CHUNK_LATENCY) {
+        const size_t quarter = (size_t)(latency_ms * 1e-3 * sr / 4.0);
+        if (max > quarter)
+            max = quarter;
+    }
+    c->max = tx_chunk_align(max);
+    c->min = TX_CHUNK_MIN < c->max ? TX_CHUNK_MIN : c->max;
+    c->cur = tx_chunk_align(start);
+    if (c->cur < c->min)
+        c->cur = c->min;
+    if (c->cur > c->max)
+        c->cur = c->max;
+    c->floor = c->min;
+    if (goal == TX_CHUNK_LATENCY && (double)fifo_size * 1e3 / sr > latency_ms)
+        fprintf(stderr, "WARN: fifo of %u samples alone holds %.1f ms, over the %.1f ms latency budget\n", fifo_size,
+                (double)fifo_size * 1e3 / sr, latency_ms);
+}
+
+// Feed one status poll (b: the second stream in MIMO mode, else NULL). Returns true when cur changed.
+static inline bool tx_chunk_update(tx_chunk_t *c, const lms_stream_status_t *a, const lms_stream_status_t *b) {
+    const uint32_t underrun = a->underrun + (b ? b->underrun : 0);
+    uint32_t fill = a->fifoFilledCount;
+    if (b && b->fifoFilledCount > fill)
+        fill = b->fifoFilledCount;
+    c->underruns += underrun;
+    c->est_ms = ((double)fill + (double)c->cur) * 1e3 / c->sr;
+    if (c->goal == TX_CHUNK_FIXED)
+        return false;
+
+    size_t next = c->cur;
+    if (c->goal == TX_CHUNK_UNDERRUN) {
+        if (underrun) {
+            next = 2 * c->cur;
+            c->floor = next < c->max ? next : c->max;
+            c->calm = 0;
+        } else if (++c->calm >= TX_CHUNK_CALM_POLLS) {
+            next = c->cur - c->cur / 4;
+            if (next < c->floor)
+                next = c->floor;
+            c->calm = 0;
+        }
+    } else {
+        const double budget = c->latency_ms * 1e-3 * c->sr;
+        if ((double)fill + (double)c->cur > budget)
+            next = c->cur - c->cur / 4;
+        else if (underrun && (double)fill + 2.0 * (double)c->cur <= budget)
+            next = 2 * c->cur;
+    }
+
+    next = tx_chunk_align(next);
+    if (next < c->min)
+        next = c->min;
+    if (next > c->max)
+        next = c->max;
+    if (next == c->cur)
+        return false;
+    c->cur = next;
+    c->changes++;
+    return true;
+}
+
+static inline void tx_chunk_print(const tx_chunk_t *c) {
+    if (c->goal == TX_CHUNK_FIXED)
+        printf("chunk: %zu frames (fixed), fifo=%u samples\n", c->cur, c->fifo_size);
+    else if (c->goal == TX_CHUNK_LATENCY)
+        printf("chunk: %zu frames, adaptive %zu..%zu for a %.1f ms latency budget, fifo=%u samples\n", c->cur, c->min,
+               c->max, c->latency_ms, c->fifo_size);
+    else
+        printf("chunk: %zu frames, adaptive %zu..%zu for zero underruns, fifo=%u samples\n", c->cur, c->min, c->max,
+               c->fifo_size);
+}
+
+#endif
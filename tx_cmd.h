@@ -0,0 +1,462 @@
+#ifndef TX_CMD_H
+#define TX_CMD_H
+
+// Live reconfiguration over a datagram control socket (--control udp:[host:]port | unix:path).
+// A server thread takes one text command per datagram, runs it on the tx_ctrl worker (so it is
+// serialised with gain ramps and every other SPI access made while streaming), reads the result
+// back and answers the sender with one datagram. The stream is never stopped or re-initialised:
+// a gain or NCO change costs a few USB control transfers instead of a cold start.
+//
+//   ping                                      round trip only
+//   get                                       every value below, read back
+//   gain <dB>                                 LMS_SetGaindB (cancels a running ramp)
+//   lo <Hz>                                   LMS_SetLOFrequency (A and B share it)
+//   nco <Hz> [up|down]                        NCO table slot 0 + LMS_SetNCOIndex
+//   scale <x>                                 host I/Q scale, picked up with the next chunk
+//   corr [gi=N] [gq=N] [iq=N] [dci=N] [dcq=N] TXTSP correctors (limetx_apply_manual)
+//
+// Replies are "ok <key>=<value>... apply_us=<t> us=<t>" or "err <reason>". Values are read back
+// after the change, the correctors from the chip rather than the register shadow. apply_us is
+// the time the worker spent on the request, us the time from receipt to the reply. With two
+// channels gain, nco and corr go to both and the B readbacks get a _b suffix. A trailing
+// "id=<token>" is echoed, so UDP clients can match replies to requests. Frequencies take k/M/G.
+//
+// Unix socket clients must bind an address of their own to get replies
+// (socat - UNIX-SENDTO:/tmp/tx.sock,bind=/tmp/me.sock). UDP binds 127.0.0.1 unless a host is given.
+
+#include "iq_scale.h"
+#include "lime/LimeSuite.h"
+#include "limetx.h"
+#include "tx_ctrl.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TX_CMD_MSG_MAX 512
+#define TX_CMD_ARGS_MAX 8
+#define TX_CMD_POLL_MS 100 // re-check stop
+#define TX_CMD_SCALE_MAX 4.0
+#define TX_CMD_NCO_INDEX 0 // the tools stream from slot 0
+
+enum { TX_CMD_PING, TX_CMD_GET, TX_CMD_GAIN, TX_CMD_LO, TX_CMD_NCO, TX_CMD_SCALE, TX_CMD_CORR };
+
+// Host-side scale published to the thread that applies it (stream or reader thread).
+typedef struct {
+    _Atomic uint64_t bits; // double
+    atomic_uint gen;
+} tx_cmd_scale_t;
+
+typedef struct {
+    tx_ctrl_t *ctrl;
+    limetx_regs_t *regs;
+    int ch[LIMETX_NCH];
+    int nch;
+    tx_cmd_scale_t scale;
+    double nco_hz; // last requested, worker only
+    bool nco_down;
+
+    int fd;
+    char path[sizeof(((struct sockaddr_un *)0)->sun_path)]; // unlinked at stop
+    pthread_t th;
+    bool started;
+    atomic_int stop;
+    atomic_uint_fast64_t served, errors;
+} tx_cmd_t;
+
+typedef struct {
+    tx_cmd_t *c;
+    int op;
+    double v;
+    bool have[5]; // corr: gi gq iq dci dcq
+    int corr[5];
+    bool dir_set, down;
+    char *out; // reply under construction
+    size_t cap, len;
+    int rc;
+    uint64_t apply_ns;
+} tx_cmd_job_t;
+
+static inline uint64_t tx_cmd_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static inline void tx_cmd_scale_set(tx_cmd_scale_t *s, double scale) {
+    uint64_t b;
+    memcpy(&b, &scale, sizeof(b));
+    atomic_store_explicit(&s->bits, b, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s->gen, 1, memory_order_release);
+}
+
+static inline double tx_cmd_scale_get(tx_cmd_scale_t *s) {
+    const uint64_t b = atomic_load_explicit(&s->bits, memory_order_relaxed);
+    double v;
+    memcpy(&v, &b, sizeof(v));
+    return v;
+}
+
+// Call once per chunk from the thread that owns q: rebuilds it when a new scale was published.
+static inline bool tx_cmd_scale_poll(tx_cmd_scale_t *s, unsigned *seen, iq_scale_q_t *q) {
+    const unsigned g = atomic_load_explicit(&s->gen, memory_order_acquire);
+    if (g == *seen)
+        return false;
+    *seen = g;
+    iq_scale_q_init(q, tx_cmd_scale_get(s));
+    return true;
+}
+
+static inline void tx_cmd_printf(tx_cmd_job_t *j, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static inline void tx_cmd_printf(tx_cmd_job_t *j, const char *fmt, ...) {
+    if (j->len >= j->cap)
+        return;
+    va_list ap;
+    va_start(ap, fmt);
+    const int n = vsnprintf(j->out + j->len, j->cap - j->len, fmt, ap);
+    va_end(ap);
+    if (n > 0)
+        j->len = j->len + (size_t)n < j->cap ? j->len + (size_t)n : j->cap - 1;
+}
+
+static inline const char *tx_cmd_sfx(int k) { return k ? "_b" : ""; }
+
+static inline void tx_cmd_read_gain(tx_cmd_job_t *j, lms_device_t *dev) {
+    for (int k = 0; k < j->c->nch; k++) {
+        unsigned g = 0;
+        if (LMS_GetGaindB(dev, LMS_CH_TX, (size_t)j->c->ch[k], &g) == 0)
+            tx_cmd_printf(j, " gain%s=%u", tx_cmd_sfx(k), g);
+        else
+            j->rc = -1;
+        if (k == 0)
+            atomic_store(&j->c->ctrl->gain_db, (int)g);
+    }
+}
+
+static inline void tx_cmd_read_lo(tx_cmd_job_t *j, lms_device_t *dev) {
+    double lo = 0;
+    if (LMS_GetLOFrequency(dev, LMS_CH_TX, (size_t)j->c->ch[0], &lo) == 0)
+        tx_cmd_printf(j, " lo=%.1f", lo);
+    else
+        j->rc = -1;
+}
+
+static inline void tx_cmd_read_nco(tx_cmd_job_t *j, lms_device_t *dev) {
+    for (int k = 0; k < j->c->nch; k++) {
+        double f[16] = {0}, pho = 0;
+        if (LMS_GetNCOFrequency(dev, true, (size_t)j->c->ch[k], f, &pho) == 0)
+            tx_cmd_printf(j, " nco%s=%.1f", tx_cmd_sfx(k), f[TX_CMD_NCO_INDEX]);
+        else
+            j->rc = -1;
+    }
+    tx_cmd_printf(j, " dir=%s", j->c->nco_down ? "down" : "up");
+}
+
+static inline void tx_cmd_read_corr(tx_cmd_job_t *j) {
+    limetx_regs_invalidate(j->c->regs); // read the chip, not the shadow
+    for (int k = 0; k < j->c->nch; k++) {
+        limetx_txtsp_t t;
+        if (limetx_read_txtsp(j->c->regs, j->c->ch[k], &t)) {
+            j->rc = -1;
+            continue;
+        }
+        const char *s = tx_cmd_sfx(k);
+        tx_cmd_printf(j, " gi%s=%d gq%s=%d iq%s=%d dci%s=%d dcq%s=%d", s, t.gi, s, t.gq, s, t.iq, s, t.dci, s, t.dcq);
+    }
+}
+
+static inline void tx_cmd_read_scale(tx_cmd_job_t *j) {
+    iq_scale_q_t q;
+    iq_scale_q_init(&q, tx_cmd_scale_get(&j->c->scale));
+    tx_cmd_printf(j, " scale=%.6f", q.g ? (double)q.g / (double)(1 << q.shift) : 0.0); // what the kernels apply
+}
+
+// Runs on the tx_ctrl worker.
+static inline void tx_cmd_run(lms_device_t *dev, void *arg) {
+    tx_cmd_job_t *j = (tx_cmd_job_t *)arg;
+    tx_cmd_t *c = j->c;
+    const uint64_t t0 = tx_cmd_now_ns();
+    switch (j->op) {
+    case TX_CMD_PING:
+        break;
+    case TX_CMD_GET:
+        tx_cmd_read_gain(j, dev);
+        tx_cmd_read_lo(j, dev);
+        tx_cmd_read_nco(j, dev);
+        tx_cmd_read_scale(j);
+        tx_cmd_read_corr(j);
+        break;
+    case TX_CMD_GAIN:
+        c->ctrl->ramping = false; // worker state; the request wins over a ramp in progress
+        atomic_store(&c->ctrl->ramp_done, true);
+        for (int k = 0; k < c->nch && !j->rc; k++)
+            j->rc = LMS_SetGaindB(dev, LMS_CH_TX, (size_t)c->ch[k], (unsigned)j->v);
+        if (!j->rc) {
+            c->ctrl->g_last = (int)j->v; // a later ramp starts from here
+            tx_cmd_read_gain(j, dev);
+        }
+        break;
+    case TX_CMD_LO:
+        j->rc = LMS_SetLOFrequency(dev, LMS_CH_TX, (size_t)c->ch[0], j->v);
+        limetx_regs_invalidate(c->regs); // tuning rewrites chip registers, even when it fails
+        if (!j->rc)
+            tx_cmd_read_lo(j, dev);
+        break;
+    case TX_CMD_NCO: {
+        double f[16] = {0};
+        f[TX_CMD_NCO_INDEX] = j->v;
+        const bool down = j->dir_set ? j->down : c->nco_down;
+        for (int k = 0; k < c->nch && !j->rc; k++) {
+            j->rc = LMS_SetNCOFrequency(dev, true, (size_t)c->ch[k], f, 0.0);
+            if (!j->rc)
+                j->rc = LMS_SetNCOIndex(dev, true, (size_t)c->ch[k], TX_CMD_NCO_INDEX, down);
+        }
+        limetx_regs_invalidate(c->regs); // CMIX bits in 0x0208 and MAC moved under the shadow
+        if (!j->rc) {
+            c->nco_hz = j->v;
+            c->nco_down = down;
+            tx_cmd_read_nco(j, dev);
+        }
+        break;
+    }
+    case TX_CMD_SCALE:
+        tx_cmd_scale_set(&c->scale, j->v);
+        tx_cmd_read_scale(j);
+        break;
+    case TX_CMD_CORR:
+        for (int k = 0; k < c->nch && !j->rc; k++)
+            j->rc = limetx_apply_manual(c->regs, c->ch[k], j->have[0], j->corr[0], j->have[1], j->corr[1], j->have[2],
+                                        j->corr[2], j->have[3], j->corr[3], j->have[4], j->corr[4]);
+        if (!j->rc)
+            tx_cmd_read_corr(j);
+        break;
+    }
+    j->apply_ns = tx_cmd_now_ns() - t0;
+}
+
+// Fill j from the tokens of one request. Returns NULL or the reason it was rejected.
+static inline const char *tx_cmd_parse(tx_cmd_job_t *j, char **tok, int n) {
+    static const char *const corr_keys[5] = {"gi", "gq", "iq", "dci", "dcq"};
+    if (n == 0)
+        return "empty request";
+    const char *cmd = tok[0];
+    if (!strcmp(cmd, "ping") || !strcmp(cmd, "get")) {
+        j->op = cmd[0] == 'p' ? TX_CMD_PING : TX_CMD_GET;
+        return n == 1 ? NULL : "no arguments expected";
+    }
+    if (!strcmp(cmd, "gain")) {
+        j->op = TX_CMD_GAIN;
+        char *end = NULL;
+        j->v = n == 2 ? strtod(tok[1], &end) : -1;
+        return n == 2 && end != tok[1] && !*end && j->v >= TX_CTRL_GAIN_MIN_DB && j->v <= TX_CTRL_GAIN_MAX_DB &&
+                       j->v == (int)j->v
+                   ? NULL
+                   : "usage: gain <0..73 dB>";
+    }
+    if (!strcmp(cmd, "lo")) {
+        j->op = TX_CMD_LO;
+        return n == 2 && limetx_parse_hz(tok[1], &j->v) && j->v > 0 ? NULL : "usage: lo <Hz>";
+    }
+    if (!strcmp(cmd, "nco")) {
+        j->op = TX_CMD_NCO;
+        if (n == 3) {
+            j->dir_set = true;
+            j->down = !strcmp(tok[2], "down");
+            if (!j->down && strcmp(tok[2], "up"))
+                return "usage: nco <Hz> [up|down]";
+        }
+        return (n == 2 || n == 3) && limetx_parse_hz(tok[1], &j->v) && j->v >= 0 ? NULL : "usage: nco <Hz> [up|down]";
+    }
+    if (!strcmp(cmd, "scale")) {
+        j->op = TX_CMD_SCALE;
+        char *end = NULL;
+        j->v = n == 2 ? strtod(tok[1], &end) : -1;
+        return n == 2 && end != tok[1] && !*end && j->v >= 0 && j->v <= TX_CMD_SCALE_MAX ? NULL
+                                                                                         : "usage: scale <0..4>";
+    }
+    if (!strcmp(cmd, "corr")) {
+        j->op = TX_CMD_CORR;
+        for (int i = 1; i < n; i++) {
+            char *v = strchr(tok[i], '=');
+            int k = 0;
+            if (v)
+                *v++ = '\0';
+            while (k < 5 && (!v || strcmp(tok[i], corr_keys[k])))
+                k++;
+            char *end = NULL;
+            if (k == 5 || ((j->corr[k] = (int)strtol(v, &end, 0)), end == v || *end))
+                return "usage: corr [gi=N] [gq=N] [iq=N] [dci=N] [dcq=N]";
+            j->have[k] = true;
+        }
+        return n > 1 ? NULL : "usage: corr [gi=N] [gq=N] [iq=N] [dci=N] [dcq=N]";
+    }
+    return "unknown command (ping get gain lo nco scale corr)";
+}
+
+// One request in msg (modified), the reply in out.
+static inline void tx_cmd_handle(tx_cmd_t *c, char *msg, uint64_t t_rx, char *out, size_t cap) {
+    char *tok[TX_CMD_ARGS_MAX + 1], *save = NULL, *id = NULL;
+    int n = 0;
+    for (char *t = strtok_r(msg, " \t\r\n", &save); t; t = strtok_r(NULL, " \t\r\n", &save)) {
+        if (n == TX_CMD_ARGS_MAX + 1)
+            break;
+        tok[n++] = t;
+    }
+    if (n > 0 && !strncmp(tok[n - 1], "id=", 3))
+        id = tok[--n] + 3;
+
+    tx_cmd_job_t j;
+    memset(&j, 0, sizeof(j));
+    j.c = c;
+    j.out = out;
+    j.cap = cap;
+    const char *err = n > TX_CMD_ARGS_MAX ? "too many arguments" : tx_cmd_parse(&j, tok, n);
+    if (!err) {
+        tx_cmd_printf(&j, "ok");
+        if (tx_ctrl_call(c->ctrl, tx_cmd_run, &j, true))
+            err = "control worker busy or stopping";
+        else if (j.rc)
+            err = LMS_GetLastErrorMessage();
+    }
+    if (err) {
+        j.len = 0;
+        tx_cmd_printf(&j, "err %s", err && *err ? err : "device call failed");
+        atomic_fetch_add(&c->errors, 1);
+    } else {
+        tx_cmd_printf(&j, " apply_us=%.1f us=%.1f", (double)j.apply_ns / 1e3, (double)(tx_cmd_now_ns() - t_rx) / 1e3);
+    }
+    if (id)
+        tx_cmd_printf(&j, " id=%s", id);
+    atomic_fetch_add(&c->served, 1);
+}
+
+static inline void *tx_cmd_thread(void *arg) {
+    tx_cmd_t *c = (tx_cmd_t *)arg;
+    char msg[TX_CMD_MSG_MAX], reply[TX_CMD_MSG_MAX];
+    while (!atomic_load_explicit(&c->stop, memory_order_relaxed)) {
+        struct pollfd pfd = {.fd = c->fd, .events = POLLIN};
+        if (poll(&pfd, 1, TX_CMD_POLL_MS) <= 0)
+            continue;
+        struct sockaddr_storage from;
+        socklen_t from_len = sizeof(from);
+        ssize_t got = recvfrom(c->fd, msg, sizeof(msg) - 1, 0, (struct sockaddr *)&from, &from_len);
+        const uint64_t t_rx = tx_cmd_now_ns();
+        if (got < 0)
+            continue;
+        msg[got] = '\0';
+        tx_cmd_handle(c, msg, t_rx, reply, sizeof(reply));
+        if (from_len > sizeof(sa_family_t)) // an unbound Unix client can't be answered
+            (void)sendto(c->fd, reply, strlen(reply), MSG_NOSIGNAL, (struct sockaddr *)&from, from_len);
+    }
+    return NULL;
+}
+
+// "udp:[host:]port" or "unix:path".
+static inline bool tx_cmd_parse_target(const char *s) {
+    return s && ((!strncmp(s, "udp:", 4) && s[4]) || (!strncmp(s, "unix:", 5) && s[5]));
+}
+
+// Idle state, so tx_cmd_stop() is safe before (or without) a start.
+static inline void tx_cmd_init(tx_cmd_t *c) {
+    memset(c, 0, sizeof(*c));
+    c->fd = -1;
+}
+
+// Start serving target. ctrl must be running; regs is only touched from the worker. ch[0..nch)
+// get gain, nco and corr; the scale starts at scale, the NCO direction at nco_down.
+static inline int tx_cmd_start(tx_cmd_t *c, const char *target, tx_ctrl_t *ctrl, limetx_regs_t *regs, const int *ch,
+                               int nch, double scale, double nco_hz, bool nco_down) {
+    tx_cmd_init(c);
+    c->ctrl = ctrl;
+    c->regs = regs;
+    c->nch = nch < 1 ? 1 : (nch > LIMETX_NCH ? LIMETX_NCH : nch);
+    for (int k = 0; k < c->nch; k++)
+        c->ch[k] = ch[k];
+    c->nco_hz = nco_hz;
+    c->nco_down = nco_down;
+    tx_cmd_scale_set(&c->scale, scale);
+
+    if (!strncmp(target, "unix:", 5)) {
+        struct sockaddr_un sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sun_family = AF_UNIX;
+        if (strlen(target + 5) >= sizeof(sa.sun_path)) {
+            fprintf(stderr, "control: socket path too long: %s\n", target + 5);
+            return -1;
+        }
+        snprintf(sa.sun_path, sizeof(sa.sun_path), "%s", target + 5);
+        (void)unlink(sa.sun_path); // a socket left behind by an earlier run
+        c->fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+        if (c->fd < 0 || bind(c->fd, (struct sockaddr *)&sa, sizeof(sa))) {
+            fprintf(stderr, "control: cannot bind %s: %s\n", sa.sun_path, strerror(errno));
+            goto fail;
+        }
+        snprintf(c->path, sizeof(c->path), "%s", sa.sun_path);
+    } else {
+        char host[64] = "127.0.0.1";
+        const char *port = target + 4, *colon = strrchr(port, ':');
+        if (colon) {
+            snprintf(host, sizeof(host), "%.*s", (int)(colon - port), port);
+            port = colon + 1;
+        }
+        struct sockaddr_in sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sin_family = AF_INET;
+        sa.sin_port = htons((uint16_t)atoi(port));
+        if (inet_pton(AF_INET, host, &sa.sin_addr) != 1 || atoi(port) <= 0 || atoi(port) > 65535) {
+            fprintf(stderr, "control: bad address %s\n", target);
+            return -1;
+        }
+        c->fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (c->fd < 0 || bind(c->fd, (struct sockaddr *)&sa, sizeof(sa))) {
+            fprintf(stderr, "control: cannot bind %s: %s\n", target + 4, strerror(errno));
+            goto fail;
+        }
+    }
+    if (pthread_create(&c->th, NULL, tx_cmd_thread, c)) {
+        fprintf(stderr, "control: failed to start server thread\n");
+        goto fail;
+    }
+    c->started = true;
+    printf("control: listening on %s (ping get gain lo nco scale corr)\n", target);
+    return 0;
+fail:
+    if (c->fd >= 0)
+        close(c->fd);
+    c->fd = -1;
+    if (c->path[0])
+        (void)unlink(c->path);
+    return -1;
+}
+
+// Stop serving; call before tx_ctrl_stop().
+static inline void tx_cmd_stop(tx_cmd_t *c) {
+    if (c->started) {
+        atomic_store(&c->stop, 1);
+        pthread_join(c->th, NULL);
+        c->started = false;
+        printf("control: %" PRIu64 " requests, %" PRIu64 " rejected\n", (uint64_t)atomic_load(&c->served),
+               (uint64_t)atomic_load(&c->errors));
+    }
+    if (c->fd >= 0)
+        close(c->fd);
+    c->fd = -1;
+    if (c->path[0])
+        (void)unlink(c->path);
+    c->path[0] = '\0';
+}
+
+#endif
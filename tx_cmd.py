@@ -0,0 +1,103 @@
+"""Client for the tx_cmd.h control socket (tx_pipe_I16bit / tx_wav_I16bit --control ...).
+
+    python3 tx_cmd.py udp:7700 "gain 45" "nco 1.2M up" get
+    python3 tx_cmd.py unix:/tmp/tx.sock --sweep gain 20:60:2 --dwell-ms 100
+
+Each reply is printed as it arrives, with the client-side round trip appended. A sweep steps one
+command through start:stop:step (stop included), waits --dwell-ms after each ack and ends with a
+latency summary, so it can drive a measurement loop without restarting the stream.
+"""
+import argparse
+import os
+import socket
+import sys
+import tempfile
+import time
+
+
+class TxControl:
+    def __init__(self, target, timeout_s=2.0):
+        self._tmp = None
+        if target.startswith("unix:"):
+            self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_DGRAM)
+            # The server answers the sender's address, so a Unix client needs one of its own
+            self._tmp = os.path.join(tempfile.mkdtemp(prefix="tx_cmd."), "client.sock")
+            self.sock.bind(self._tmp)
+            self.addr = target[5:]
+        elif target.startswith("udp:"):
+            host, _, port = target[4:].rpartition(":")
+            self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+            self.addr = (host or "127.0.0.1", int(port))
+        else:
+            raise ValueError("target must be udp:[host:]port or unix:<path>")
+        self.sock.settimeout(timeout_s)
+        self._seq = 0
+
+    def send(self, command):
+        """Returns (reply, round trip in us); reply is None on timeout."""
+        self._seq += 1
+        tag = "id=%d" % self._seq
+        t0 = time.monotonic()
+        self.sock.sendto(("%s %s" % (command, tag)).encode(), self.addr)
+        while True:
+            try:
+                reply = self.sock.recv(1024).decode()
+            except socket.timeout:
+                return None, (time.monotonic() - t0) * 1e6
+            if reply.endswith(" " + tag):  # drop late replies to earlier requests
+                return reply[: -len(tag) - 1], (time.monotonic() - t0) * 1e6
+
+    def close(self):
+        self.sock.close()
+        if self._tmp:
+            os.unlink(self._tmp)
+            os.rmdir(os.path.dirname(self._tmp))
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+
+def frange(spec):
+    start, stop, step = (float(v) for v in spec.split(":"))
+    n = int(round((stop - start) / step)) if step else 0
+    return [start + i * step for i in range(n + 1)]
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Send commands to a running TX tool")
+    ap.add_argument("target", help="udp:[host:]port or unix:<path>")
+    ap.add_argument("commands", nargs="*", help='e.g. "gain 40" "nco 2M down" get')
+    ap.add_argument("--sweep", nargs=2, metavar=("CMD", "START:STOP:STEP"))
+    ap.add_argument("--dwell-ms", type=float, default=0.0)
+    ap.add_argument("--timeout-ms", type=float, default=2000.0)
+    args = ap.parse_intermixed_args()
+
+    commands = list(args.commands)
+    if args.sweep:
+        commands += ["%s %.10g" % (args.sweep[0], v) for v in frange(args.sweep[1])]
+    if not commands:
+        ap.error("nothing to send")
+
+    rtts, failed = [], 0
+    with TxControl(args.target, args.timeout_ms / 1e3) as ctl:
+        for cmd in commands:
+            reply, rtt = ctl.send(cmd)
+            print("%-24s %s rtt_us=%.0f" % (cmd, reply if reply else "timeout", rtt))
+            if not reply or not reply.startswith("ok"):
+                failed += 1
+            else:
+                rtts.append(rtt)
+            if args.dwell_ms > 0:
+                time.sleep(args.dwell_ms / 1e3)
+    if len(commands) > 1 and rtts:
+        rtts.sort()
+        print("%d acked, %d failed, rtt median %.0f us, max %.0f us"
+              % (len(rtts), failed, rtts[len(rtts) // 2], rtts[-1]))
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,287 @@
+#ifndef TX_CTRL_H
+#define TX_CTRL_H
+
+// Control worker: a thread with a small command queue that owns every SPI/gain operation
+// issued while the TX stream runs (gain ramps, gain readback, TXTSP corrector updates, LO/NCO
+// changes from tx_cmd and tx_hop).
+// The send loop only moves samples; ramp steps run on an absolute CLOCK_MONOTONIC schedule
+// instead of being tied to when LMS_SendStream returns.
+
+#include "lime/LimeSuite.h"
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define TX_CTRL_QUEUE_LEN 32
+#define TX_CTRL_GAIN_MIN_DB 0
+#define TX_CTRL_GAIN_MAX_DB 73
+
+typedef enum {
+    TX_CTRL_SET_GAIN,
+    TX_CTRL_RAMP,
+    TX_CTRL_CALL,
+} tx_ctrl_op_t;
+
+typedef void (*tx_ctrl_fn)(lms_device_t *dev, void *arg);
+
+typedef struct {
+    tx_ctrl_op_t op;
+    int gain_db;     // SET_GAIN value, RAMP target
+    int start_db;    // RAMP
+    int ramp_ms;     // RAMP
+    int interval_ms; // RAMP
+    tx_ctrl_fn fn;   // CALL
+    void *arg;       // CALL
+    bool *done;      // set under the mutex when the command finished (may be NULL)
+} tx_ctrl_cmd_t;
+
+typedef struct {
+    lms_device_t *dev;
+    int ch;
+    pthread_t th;
+    bool started;
+
+    pthread_mutex_t mu;
+    pthread_cond_t cv;      // queue not empty / stop
+    pthread_cond_t done_cv; // some command completed
+    tx_ctrl_cmd_t q[TX_CTRL_QUEUE_LEN];
+    size_t q_head, q_tail;
+    bool stop;
+    bool exited;  // worker is gone; commands still queued were rejected, not run
+    int waiters;  // submitters blocked on done_cv, which tx_ctrl_stop() lets return first
+
+    // ramp state, touched by the worker only
+    bool ramping;
+    double g_accum, step_db;
+    int g_target, g_last, interval_ms;
+    struct timespec t_next;
+
+    atomic_int gain_db;     // last gain read back from the device
+    atomic_bool ramp_done;  // no ramp pending
+    atomic_uint_fast64_t spi_ops;
+} tx_ctrl_t;
+
+static inline int tx_ctrl_clampi(int v, int lo, int hi) { return v < lo ? lo : (v > hi ? hi : v); }
+
+static inline void tx_ctrl_ts_add_ms(struct timespec *t, int ms) {
+    t->tv_sec += ms / 1000;
+    t->tv_nsec += (long)(ms % 1000) * 1000000L;
+    if (t->tv_nsec >= 1000000000L) {
+        t->tv_sec++;
+        t->tv_nsec -= 1000000000L;
+    }
+}
+
+static inline bool tx_ctrl_ts_due(const struct timespec *t) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec > t->tv_sec || (now.tv_sec == t->tv_sec && now.tv_nsec >= t->tv_nsec);
+}
+
+static inline void tx_ctrl_apply_gain(tx_ctrl_t *c, int g, bool verbose) {
+    if (verbose)
+        fprintf(stderr, "ramp: setting gain to %d dB\n", g);
+    atomic_fetch_add(&c->spi_ops, 2);
+    if (LMS_SetGaindB(c->dev, LMS_CH_TX, c->ch, (unsigned)g) != 0) {
+        fprintf(stderr, "Gain ramp set failed: %s\n", LMS_GetLastErrorMessage());
+        return;
+    }
+    unsigned int g_read = 0;
+    if (LMS_GetGaindB(c->dev, LMS_CH_TX, c->ch, &g_read) == 0) {
+        atomic_store(&c->gain_db, (int)g_read);
+        if (verbose)
+            fprintf(stderr, "ramp: set=%d dB, get=%u dB\n", g, g_read);
+    } else {
+        fprintf(stderr, "ramp: LMS_GetGaindB failed: %s\n", LMS_GetLastErrorMessage());
+    }
+    c->g_last = g;
+}
+
+static inline void tx_ctrl_ramp_step(tx_ctrl_t *c) {
+    c->g_accum += c->step_db;
+    int g = tx_ctrl_clampi((int)llround(c->g_accum), TX_CTRL_GAIN_MIN_DB, TX_CTRL_GAIN_MAX_DB);
+    if (g != c->g_last)
+        tx_ctrl_apply_gain(c, g, true);
+    tx_ctrl_ts_add_ms(&c->t_next, c->interval_ms);
+
+    if ((c->step_db >= 0.0 && c->g_last >= c->g_target) || (c->step_db < 0.0 && c->g_last <= c->g_target)) {
+        if (c->g_last != c->g_target)
+            tx_ctrl_apply_gain(c, c->g_target, true);
+        c->ramping = false;
+        atomic_store(&c->ramp_done, true);
+    }
+}
+
+static inline void tx_ctrl_exec(tx_ctrl_t *c, const tx_ctrl_cmd_t *cmd) {
+    switch (cmd->op) {
+    case TX_CTRL_SET_GAIN:
+        c->ramping = false;
+        tx_ctrl_apply_gain(c, tx_ctrl_clampi(cmd->gain_db, TX_CTRL_GAIN_MIN_DB, TX_CTRL_GAIN_MAX_DB), false);
+        atomic_store(&c->ramp_done, true);
+        break;
+    case TX_CTRL_RAMP: {
+        const int steps = (cmd->ramp_ms + cmd->interval_ms - 1) / cmd->interval_ms;
+        c->g_accum = (double)cmd->start_db;
+        c->g_last = cmd->start_db;
+        c->g_target = cmd->gain_db;
+        c->interval_ms = cmd->interval_ms;
+        c->step_db = (double)(cmd->gain_db - cmd->start_db) / (double)(steps > 0 ? steps : 1);
+        clock_gettime(CLOCK_MONOTONIC, &c->t_next);
+        tx_ctrl_ts_add_ms(&c->t_next, c->interval_ms);
+        c->ramping = cmd->ramp_ms > 0 && cmd->gain_db != cmd->start_db;
+        if (!c->ramping && c->g_last != c->g_target)
+            tx_ctrl_apply_gain(c, c->g_target, false);
+        atomic_store(&c->ramp_done, !c->ramping);
+        break;
+    }
+    case TX_CTRL_CALL:
+        atomic_fetch_add(&c->spi_ops, 1);
+        cmd->fn(c->dev, cmd->arg);
+        break;
+    }
+}
+
+static inline void *tx_ctrl_thread(void *arg) {
+    tx_ctrl_t *c = (tx_ctrl_t *)arg;
+    pthread_mutex_lock(&c->mu);
+    while (!c->stop) {
+        if (c->q_head != c->q_tail) {
+            tx_ctrl_cmd_t cmd = c->q[c->q_tail % TX_CTRL_QUEUE_LEN];
+            c->q_tail++;
+            pthread_mutex_unlock(&c->mu);
+            tx_ctrl_exec(c, &cmd);
+            pthread_mutex_lock(&c->mu);
+            if (cmd.done) {
+                *cmd.done = true;
+                pthread_cond_broadcast(&c->done_cv);
+            }
+            continue;
+        }
+        if (c->ramping) {
+            if (tx_ctrl_ts_due(&c->t_next)) {
+                pthread_mutex_unlock(&c->mu);
+                tx_ctrl_ramp_step(c);
+                pthread_mutex_lock(&c->mu);
+            } else {
+                pthread_cond_timedwait(&c->cv, &c->mu, &c->t_next);
+            }
+            continue;
+        }
+        pthread_cond_wait(&c->cv, &c->mu);
+    }
+    // Reject what is still queued; waiting submitters see exited without done and return -1
+    c->q_tail = c->q_head;
+    c->exited = true;
+    c->ramping = false;
+    atomic_store(&c->ramp_done, true); // a rejected or unfinished ramp will not run any more
+    pthread_cond_broadcast(&c->done_cv);
+    pthread_mutex_unlock(&c->mu);
+    return NULL;
+}
+
+static inline int tx_ctrl_start(tx_ctrl_t *c, lms_device_t *dev, int ch) {
+    memset(c, 0, sizeof(*c));
+    c->dev = dev;
+    c->ch = ch;
+    atomic_init(&c->gain_db, -1);
+    atomic_init(&c->ramp_done, true);
+    atomic_init(&c->spi_ops, 0);
+
+    pthread_condattr_t ca;
+    pthread_condattr_init(&ca);
+    pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);
+    pthread_mutex_init(&c->mu, NULL);
+    pthread_cond_init(&c->cv, &ca);
+    pthread_cond_init(&c->done_cv, NULL);
+    pthread_condattr_destroy(&ca);
+
+    if (pthread_create(&c->th, NULL, tx_ctrl_thread, c)) {
+        fprintf(stderr, "failed to start control thread\n");
+        return -1;
+    }
+    c->started = true;
+    return 0;
+}
+
+static inline void tx_ctrl_stop(tx_ctrl_t *c) {
+    if (!c->started)
+        return;
+    pthread_mutex_lock(&c->mu);
+    c->stop = true;
+    pthread_cond_broadcast(&c->cv);
+    pthread_cond_broadcast(&c->done_cv);
+    pthread_mutex_unlock(&c->mu);
+    pthread_join(c->th, NULL);
+    pthread_mutex_lock(&c->mu);
+    while (c->waiters > 0) // the worker's exit broadcast has woken them
+        pthread_cond_wait(&c->done_cv, &c->mu);
+    pthread_mutex_unlock(&c->mu);
+    pthread_cond_destroy(&c->cv);
+    pthread_cond_destroy(&c->done_cv);
+    pthread_mutex_destroy(&c->mu);
+    c->started = false;
+}
+
+// Queue a command; with wait=true block until the worker has executed it. Returns -1 when the
+// queue is full or the worker is stopping; a waited-for command that tx_ctrl_stop() rejected
+// before it ran also returns -1.
+static inline int tx_ctrl_submit(tx_ctrl_t *c, tx_ctrl_cmd_t cmd, bool wait) {
+    bool done = false;
+    cmd.done = wait ? &done : NULL;
+
+    pthread_mutex_lock(&c->mu);
+    if (!c->started || c->stop || c->q_head - c->q_tail >= TX_CTRL_QUEUE_LEN) {
+        pthread_mutex_unlock(&c->mu);
+        return -1;
+    }
+    c->q[c->q_head % TX_CTRL_QUEUE_LEN] = cmd;
+    c->q_head++;
+    pthread_cond_signal(&c->cv);
+    if (!wait) {
+        pthread_mutex_unlock(&c->mu);
+        return 0;
+    }
+    // Not just !stop: a command the worker is running still writes done when it finishes
+    c->waiters++;
+    while (!done && !c->exited)
+        pthread_cond_wait(&c->done_cv, &c->mu);
+    c->waiters--;
+    if (c->exited)
+        pthread_cond_broadcast(&c->done_cv); // tx_ctrl_stop() may be waiting for waiters == 0
+    pthread_mutex_unlock(&c->mu);
+    return done ? 0 : -1;
+}
+
+static inline int tx_ctrl_ramp(tx_ctrl_t *c, int start_db, int target_db, int ramp_ms, int interval_ms) {
+    tx_ctrl_cmd_t cmd = {.op = TX_CTRL_RAMP,
+                         .gain_db = target_db,
+                         .start_db = start_db,
+                         .ramp_ms = ramp_ms,
+                         .interval_ms = interval_ms < 1 ? 1 : interval_ms};
+    // cleared before the submit, so a ramp the worker finishes at once is not reported pending
+    const bool was_done = atomic_exchange(&c->ramp_done, false);
+    if (tx_ctrl_submit(c, cmd, false)) {
+        if (was_done) // rejected: nothing will run to set it again
+            atomic_store(&c->ramp_done, true);
+        return -1;
+    }
+    return 0;
+}
+
+static inline int tx_ctrl_set_gain(tx_ctrl_t *c, int gain_db, bool wait) {
+    tx_ctrl_cmd_t cmd = {.op = TX_CTRL_SET_GAIN, .gain_db = gain_db};
+    return tx_ctrl_submit(c, cmd, wait);
+}
+
+static inline int tx_ctrl_call(tx_ctrl_t *c, tx_ctrl_fn fn, void *arg, bool wait) {
+    tx_ctrl_cmd_t cmd = {.op = TX_CTRL_CALL, .fn = fn, .arg = arg};
+    return tx_ctrl_submit(c, cmd, wait);
+}
+
+#endif
@@ -0,0 +1,504 @@
+#ifndef TX_HOP_H
+#define TX_HOP_H
+
+// Frequency hopping on the TXTSP NCO table instead of LO retunes.
+// The LMS7002M TX NCO holds 16 frequencies; changing which one is live is a single
+// LMS_SetNCOIndex register write (well under a millisecond over USB), while moving the LO
+// means re-tuning SXT and waiting for the PLL to relock (tens of ms).
+//
+// The schedule is kept in sample time. The stream is sent with meta.timestamp (frame n plays
+// at device timestamp ts0 + n), and hop k starts at sample k * dwell. The stream thread
+// publishes (device timestamp, CLOCK_MONOTONIC) pairs after each send; a hop thread extrapolates
+// the device counter from them, sleeps until just before the boundary and issues the switch
+// half its typical latency early. The stream is muted for guard samples around each boundary
+// (with a raised-cosine fade on both sides), so the register write lands in silence even though
+// it cannot be sample-exact itself.
+//
+// Slots: the next 15 hops are kept loaded. After each switch the thread rewrites slots that are
+// neither live nor needed soon (LMS_SetNCOFrequency writes the whole table; the live slot gets
+// its own value back), so a hop set larger than 16 frequencies costs no extra switch latency.
+// Only a hop that is outside the NCO span around the current LO (LPF bandwidth, and a fraction of
+// the TSP rate) falls back to an LO retune; the hop list is split into as few LO bands as fit.
+//
+// Every device call goes through the tx_ctrl worker (tx_ctrl_call, waited for), so switches never
+// interleave with gain ramp steps on the MAC select; the handoff is part of the measured latency
+// that sets the lead. The shared limetx_regs_t shadow is invalidated after each of them.
+
+#include "limetx.h"
+#include "tx_ctrl.h"
+#include "lime/LimeSuite.h"
+#include <inttypes.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TX_HOP_MAX 256       // --hop entries
+#define TX_HOP_SLOTS 16      // NCO table size
+#define TX_HOP_NCO_FRAC 0.45 // usable NCO offset as a fraction of the TSP (rf) rate
+#define TX_HOP_LEAD_MS 20    // first stream timestamp: this far ahead of the device counter
+#define TX_HOP_SPIN_US 200   // sleep until this close to a switch, then poll the clock
+#define TX_HOP_DWELL_MIN_S 100e-6
+
+typedef struct {
+    double rf_hz[TX_HOP_MAX];
+    int n;
+    double dwell_s; // time on each frequency
+    double guard_s; // muted around each boundary; 0 = no muting
+    uint32_t seed;  // 0 = list order, else pseudo-random order (never the same entry twice in a row)
+} tx_hop_cfg_t;
+
+typedef struct {
+    tx_ctrl_t *ctrl;
+    limetx_regs_t *regs;
+    int ch;
+    bool downconvert;
+    double fs;
+    uint64_t dwell, guard; // samples
+    uint64_t ts0;          // device timestamp of stream frame 0 (= start of hop 0)
+
+    int n;
+    double nco[TX_HOP_MAX]; // per list entry
+    int band[TX_HOP_MAX];   // per list entry: index into lo[]
+    double lo[TX_HOP_MAX];
+    int nbands;
+    uint32_t rng;
+    int prev;
+
+    int seq[TX_HOP_SLOTS]; // list entries of hops k .. k+15, seq[j % 16] = hop j
+    double table[TX_HOP_SLOTS];
+    bool loaded[TX_HOP_SLOTS];
+    int live;     // slot on air
+    int cur_band; // band of the LO now tuned
+
+    int16_t *fade; // guard samples, Q15 rising half of a raised cosine
+
+    pthread_t th;
+    bool started;
+    atomic_bool stop;
+    atomic_uint_fast64_t anchor_seq, anchor_ts, anchor_ns;
+
+    // hop thread only; read after tx_hop_stop()
+    uint64_t hops, late, retunes, rewrites, errors;
+    double lat_recent_s[TX_HOP_SLOTS]; // last switch latencies; their median sets the lead
+    double lat_typ_s, lat_max_s, lat_sum_s, retune_max_s;
+    int64_t err_max; // worst |switch time - boundary|, samples
+} tx_hop_t;
+
+static inline void tx_hop_cfg_default(tx_hop_cfg_t *c) {
+    memset(c, 0, sizeof(*c));
+    c->dwell_s = 10e-3;
+    c->guard_s = 100e-6; // USB control transfers jitter by tens of us
+}
+
+// "f1,f2,..." in Hz, k/M/G suffixes as limetx_parse_hz; "f0:f1:step" expands to a range.
+static inline bool tx_hop_parse_list(const char *s, tx_hop_cfg_t *c) {
+    char tok[64];
+    c->n = 0;
+    while (*s) {
+        const char *e = strchr(s, ',');
+        const size_t len = e ? (size_t)(e - s) : strlen(s);
+        if (!len || len >= sizeof(tok))
+            return false;
+        memcpy(tok, s, len);
+        tok[len] = '\0';
+        char *c1 = strchr(tok, ':');
+        if (c1) {
+            char *c2 = strchr(c1 + 1, ':');
+            double f0 = 0, f1 = 0, step = 0;
+            if (!c2)
+                return false;
+            *c1 = *c2 = '\0';
+            if (!limetx_parse_hz(tok, &f0) || !limetx_parse_hz(c1 + 1, &f1) || !limetx_parse_hz(c2 + 1, &step) ||
+                step <= 0 || f1 < f0)
+                return false;
+            for (double f = f0; f <= f1 + step * 1e-9; f += step) {
+                if (c->n >= TX_HOP_MAX)
+                    return false;
+                c->rf_hz[c->n++] = f;
+            }
+        } else {
+            if (c->n >= TX_HOP_MAX || !limetx_parse_hz(tok, &c->rf_hz[c->n]))
+                return false;
+            c->n++;
+        }
+        s += len;
+        if (*s == ',')
+            s++;
+    }
+    return c->n > 0;
+}
+
+static inline int tx_hop_cmp_double(const void *a, const void *b) {
+    const double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static inline int tx_hop_next_entry(tx_hop_t *h) {
+    if (!h->rng) {
+        h->prev = (h->prev + 1) % h->n;
+        return h->prev;
+    }
+    int e;
+    do {
+        h->rng ^= h->rng << 13;
+        h->rng ^= h->rng >> 17;
+        h->rng ^= h->rng << 5;
+        e = (int)(h->rng % (uint32_t)h->n);
+    } while (h->n > 1 && e == h->prev);
+    h->prev = e;
+    return e;
+}
+
+static inline int tx_hop_find_slot(const tx_hop_t *h, double nco) {
+    for (int s = 0; s < TX_HOP_SLOTS; s++)
+        if (h->loaded[s] && h->table[s] == nco)
+            return s;
+    return -1;
+}
+
+// Load the upcoming hops (from hop `from`, same band as cur_band) into slots other than the live one.
+// Returns true when the table changed and has to be written.
+static inline bool tx_hop_fill_slots(tx_hop_t *h, uint64_t from, bool protect_live) {
+    bool needed[TX_HOP_SLOTS] = {false}, changed = false;
+    if (protect_live)
+        needed[h->live] = true;
+    for (uint64_t j = from; j < from + TX_HOP_SLOTS - 1; j++) {
+        const int e = h->seq[j % TX_HOP_SLOTS];
+        if (h->band[e] != h->cur_band)
+            continue;
+        const int s = tx_hop_find_slot(h, h->nco[e]);
+        if (s >= 0)
+            needed[s] = true;
+    }
+    for (uint64_t j = from; j < from + TX_HOP_SLOTS - 1; j++) {
+        const int e = h->seq[j % TX_HOP_SLOTS];
+        if (h->band[e] != h->cur_band || tx_hop_find_slot(h, h->nco[e]) >= 0)
+            continue;
+        for (int s = 0; s < TX_HOP_SLOTS; s++)
+            if (!needed[s]) {
+                h->table[s] = h->nco[e];
+                h->loaded[s] = needed[s] = changed = true;
+                break;
+            }
+    }
+    return changed;
+}
+
+// Split the hop set into LO bands and load the table for the first hops. nco_span_hz is the
+// largest usable NCO offset; lo_hz is kept when every hop fits around it. Afterwards h->lo[h->cur_band]
+// is the LO to tune and h->table / h->live the NCO table and index to program before streaming.
+static inline int tx_hop_make_fade(tx_hop_t *h) {
+    free(h->fade);
+    h->fade = NULL;
+    if (!h->guard)
+        return 0;
+    h->fade = (int16_t *)malloc((size_t)h->guard * sizeof(int16_t));
+    if (!h->fade)
+        return -1;
+    for (uint64_t i = 0; i < h->guard; i++)
+        h->fade[i] = (int16_t)lrint(32767.0 * (0.5 - 0.5 * cos(M_PI * ((double)i + 0.5) / (double)h->guard)));
+    return 0;
+}
+
+static inline int tx_hop_init(tx_hop_t *h, const tx_hop_cfg_t *c, double fs, double lo_hz, bool downconvert,
+                              double nco_span_hz) {
+    memset(h, 0, sizeof(*h));
+    const double sgn = downconvert ? -1.0 : 1.0; // RF = LO + sgn * NCO
+    h->n = c->n;
+    h->fs = fs;
+    h->downconvert = downconvert;
+    h->dwell = (uint64_t)llround(c->dwell_s * fs);
+    h->guard = (uint64_t)llround(c->guard_s * fs);
+    if (c->n < 1 || c->dwell_s < TX_HOP_DWELL_MIN_S || h->guard * 4 > h->dwell || nco_span_hz <= 0) {
+        fprintf(stderr, "hop: need dwell >= %.0f us and guard <= dwell / 4\n", TX_HOP_DWELL_MIN_S * 1e6);
+        return -1;
+    }
+
+    bool fits = true;
+    for (int e = 0; e < c->n; e++) {
+        const double off = sgn * (c->rf_hz[e] - lo_hz);
+        fits = fits && off >= 0.0 && off <= nco_span_hz;
+    }
+    if (fits) {
+        h->lo[0] = lo_hz;
+        h->nbands = 1;
+    } else {
+        // greedy over the sorted set: each band starts at the lowest RF not yet covered
+        double sorted[TX_HOP_MAX];
+        memcpy(sorted, c->rf_hz, (size_t)c->n * sizeof(double));
+        qsort(sorted, (size_t)c->n, sizeof(double), tx_hop_cmp_double);
+        for (int i = 0; i < c->n;) {
+            h->lo[h->nbands++] = downconvert ? sorted[i] + nco_span_hz : sorted[i];
+            const double top = sorted[i] + nco_span_hz;
+            while (i < c->n && sorted[i] <= top)
+                i++;
+        }
+    }
+    for (int e = 0; e < c->n; e++) {
+        for (int b = 0; b < h->nbands; b++) {
+            const double off = sgn * (c->rf_hz[e] - h->lo[b]);
+            if (off >= -1e-3 && off <= nco_span_hz + 1e-3) {
+                h->band[e] = b;
+                h->nco[e] = fabs(off);
+                break;
+            }
+        }
+    }
+
+    if (tx_hop_make_fade(h))
+        return -1;
+
+    h->rng = c->seed;
+    h->prev = h->rng ? -1 : c->n - 1;
+    for (int j = 0; j < TX_HOP_SLOTS; j++)
+        h->seq[j] = tx_hop_next_entry(h);
+    h->cur_band = h->band[h->seq[0]];
+    tx_hop_fill_slots(h, 0, false);
+    h->live = tx_hop_find_slot(h, h->nco[h->seq[0]]);
+    atomic_init(&h->stop, false);
+    atomic_init(&h->anchor_seq, 0);
+    atomic_init(&h->anchor_ts, 0);
+    atomic_init(&h->anchor_ns, 0);
+    return 0;
+}
+
+// Re-derive the sample counts for the rate the device actually runs at (LMS_GetSampleRate), which
+// the PLL may have rounded away from the one tx_hop_init() planned with. Before tx_hop_start().
+static inline int tx_hop_set_fs(tx_hop_t *h, const tx_hop_cfg_t *c, double fs) {
+    h->fs = fs;
+    h->dwell = (uint64_t)llround(c->dwell_s * fs);
+    h->guard = (uint64_t)llround(c->guard_s * fs);
+    return tx_hop_make_fade(h);
+}
+
+static inline uint64_t tx_hop_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Stream thread, after each send: the device timestamp from LMS_GetStreamStatus and when it was read.
+static inline void tx_hop_anchor(tx_hop_t *h, uint64_t device_ts, uint64_t now_ns) {
+    atomic_fetch_add_explicit(&h->anchor_seq, 1, memory_order_acq_rel);
+    atomic_store_explicit(&h->anchor_ts, device_ts, memory_order_relaxed);
+    atomic_store_explicit(&h->anchor_ns, now_ns, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->anchor_seq, 1, memory_order_release);
+}
+
+// Device timestamp extrapolated to now_ns; false until the stream has published an anchor.
+static inline bool tx_hop_device_ts(tx_hop_t *h, uint64_t now_ns, double *ts) {
+    uint64_t s0, d, t;
+    do {
+        s0 = atomic_load_explicit(&h->anchor_seq, memory_order_acquire);
+        d = atomic_load_explicit(&h->anchor_ts, memory_order_relaxed);
+        t = atomic_load_explicit(&h->anchor_ns, memory_order_relaxed);
+    } while ((s0 & 1) || atomic_load_explicit(&h->anchor_seq, memory_order_acquire) != s0);
+    if (!s0)
+        return false;
+    *ts = (double)d + ((double)now_ns - (double)t) * 1e-9 * h->fs;
+    return true;
+}
+
+static inline void tx_hop_sleep_ns(uint64_t ns) {
+    struct timespec ts = {(time_t)(ns / 1000000000ull), (long)(ns % 1000000000ull)};
+    nanosleep(&ts, NULL);
+}
+
+// Sleep until the device counter reaches `target`; false when stopped first.
+static inline bool tx_hop_wait(tx_hop_t *h, double target) {
+    while (!atomic_load_explicit(&h->stop, memory_order_relaxed)) {
+        double ts = 0;
+        if (!tx_hop_device_ts(h, tx_hop_now_ns(), &ts)) {
+            tx_hop_sleep_ns(1000000);
+            continue;
+        }
+        if (ts >= target)
+            return true;
+        const double left_ns = (target - ts) / h->fs * 1e9;
+        if (left_ns > TX_HOP_SPIN_US * 1e3)
+            tx_hop_sleep_ns((uint64_t)(left_ns - TX_HOP_SPIN_US * 1e3));
+    }
+    return false;
+}
+
+typedef enum {
+    TX_HOP_SWITCH, // LMS_SetNCOIndex(slot)
+    TX_HOP_TABLE,  // LMS_SetNCOFrequency(table)
+    TX_HOP_RETUNE, // LO of cur_band, then the table and slot
+} tx_hop_op_t;
+
+typedef struct {
+    tx_hop_t *h;
+    tx_hop_op_t op;
+    int slot;
+    int rc;
+} tx_hop_job_t;
+
+// Runs on the tx_ctrl worker.
+static inline void tx_hop_run(lms_device_t *dev, void *arg) {
+    tx_hop_job_t *j = (tx_hop_job_t *)arg;
+    tx_hop_t *h = j->h;
+    const size_t ch = (size_t)h->ch;
+    switch (j->op) {
+    case TX_HOP_SWITCH:
+        j->rc = LMS_SetNCOIndex(dev, true, ch, j->slot, h->downconvert);
+        break;
+    case TX_HOP_TABLE:
+        j->rc = LMS_SetNCOFrequency(dev, true, ch, h->table, 0.0);
+        break;
+    case TX_HOP_RETUNE:
+        j->rc = LMS_SetLOFrequency(dev, LMS_CH_TX, ch, h->lo[h->cur_band]) ||
+                LMS_SetNCOFrequency(dev, true, ch, h->table, 0.0) ||
+                LMS_SetNCOIndex(dev, true, ch, j->slot, h->downconvert);
+        break;
+    }
+    limetx_regs_invalidate(h->regs); // CMIX bits in 0x0208 and MAC moved under the shadow
+}
+
+// Hop thread: one device operation on the worker, waited for. -1 also when the worker is stopping.
+static inline int tx_hop_exec(tx_hop_t *h, tx_hop_op_t op, int slot) {
+    tx_hop_job_t j = {.h = h, .op = op, .slot = slot, .rc = 0};
+    if (tx_ctrl_call(h->ctrl, tx_hop_run, &j, true))
+        return -1;
+    return j.rc;
+}
+
+static inline void *tx_hop_thread(void *arg) {
+    tx_hop_t *h = (tx_hop_t *)arg;
+    for (uint64_t k = 1;; k++) {
+        const int e = h->seq[k % TX_HOP_SLOTS];
+        const double boundary = (double)(h->ts0 + k * h->dwell);
+        if (h->band[e] != h->cur_band) {
+            // LO retune: wait for the boundary itself, the relock dominates anyway
+            if (!tx_hop_wait(h, boundary))
+                break;
+            const uint64_t t0 = tx_hop_now_ns();
+            h->cur_band = h->band[e];
+            memset(h->loaded, 0, sizeof(h->loaded));
+            tx_hop_fill_slots(h, k, false);
+            h->live = tx_hop_find_slot(h, h->nco[e]);
+            if (tx_hop_exec(h, TX_HOP_RETUNE, h->live))
+                h->errors++;
+            const double dt = (double)(tx_hop_now_ns() - t0) * 1e-9;
+            if (dt > h->retune_max_s)
+                h->retune_max_s = dt;
+            h->retunes++;
+        } else {
+            if (!tx_hop_wait(h, boundary - 0.5 * h->lat_typ_s * h->fs))
+                break;
+            const int s = tx_hop_find_slot(h, h->nco[e]);
+            const uint64_t t0 = tx_hop_now_ns();
+            if (s < 0 || tx_hop_exec(h, TX_HOP_SWITCH, s))
+                h->errors++;
+            const uint64_t t1 = tx_hop_now_ns();
+            h->live = s < 0 ? h->live : s;
+
+            double at = boundary;
+            tx_hop_device_ts(h, t0 / 2 + t1 / 2, &at);
+            const int64_t err = (int64_t)llround(at - boundary);
+            if ((err < 0 ? -err : err) > h->err_max)
+                h->err_max = err < 0 ? -err : err;
+            if ((uint64_t)(err < 0 ? -err : err) * 2 > h->guard)
+                h->late++;
+            const double lat = (double)(t1 - t0) * 1e-9;
+            // median, not mean: a preempted call should not pull the next switches early
+            const uint64_t fast = h->hops - h->retunes;
+            h->lat_recent_s[fast % TX_HOP_SLOTS] = lat;
+            double m[TX_HOP_SLOTS];
+            const size_t nm = fast + 1 < TX_HOP_SLOTS ? (size_t)fast + 1 : TX_HOP_SLOTS;
+            memcpy(m, h->lat_recent_s, nm * sizeof(double));
+            qsort(m, nm, sizeof(double), tx_hop_cmp_double);
+            h->lat_typ_s = m[nm / 2];
+            h->lat_sum_s += lat;
+            if (lat > h->lat_max_s)
+                h->lat_max_s = lat;
+        }
+        h->hops++;
+
+        // background: hop k+16 enters the window, hops k+1 .. k+15 must be loaded before they are due
+        h->seq[k % TX_HOP_SLOTS] = tx_hop_next_entry(h);
+        if (tx_hop_fill_slots(h, k + 1, true)) {
+            if (tx_hop_exec(h, TX_HOP_TABLE, 0))
+                h->errors++;
+            h->rewrites++;
+        }
+    }
+    return NULL;
+}
+
+// After the stream and ctrl started; ts0 is the timestamp stream frame 0 was (or will be) sent with.
+// Stop it before tx_ctrl_stop(). Start it before tx_rt_enter() so it does not inherit the stream
+// thread's CPU and priority.
+static inline int tx_hop_start(tx_hop_t *h, tx_ctrl_t *ctrl, limetx_regs_t *regs, int ch, uint64_t ts0) {
+    h->ctrl = ctrl;
+    h->regs = regs;
+    h->ch = ch;
+    h->ts0 = ts0;
+    if (pthread_create(&h->th, NULL, tx_hop_thread, h)) {
+        fprintf(stderr, "hop: failed to start the hop thread\n");
+        return -1;
+    }
+    h->started = true;
+    return 0;
+}
+
+// Mute the guard around each boundary in frames [n0, n0 + frames) of the stream. Returns src when
+// the chunk is clear of every guard, else dst (src copied and faded; dst may equal src).
+static inline const int16_t *tx_hop_blank(const tx_hop_t *h, int16_t *dst, const int16_t *src, uint64_t n0,
+                                          size_t frames) {
+    if (!h->guard)
+        return src;
+    const uint64_t g = h->guard, n1 = n0 + frames;
+    // boundaries whose [b - g, b + g) window overlaps the chunk; hop 0 starts the stream unmuted
+    uint64_t k = n0 >= g ? (n0 - g) / h->dwell + 1 : 1;
+    if (k * h->dwell - g >= n1)
+        return src;
+    if (dst != src)
+        memcpy(dst, src, frames * 2 * sizeof(int16_t));
+    for (; k * h->dwell - g < n1; k++) {
+        const uint64_t b = k * h->dwell;
+        const uint64_t a = b - g > n0 ? b - g : n0, z = b + g < n1 ? b + g : n1;
+        for (uint64_t n = a; n < z; n++) {
+            const uint64_t d = n < b ? b - 1 - n : n - b; // 0 at the boundary
+            const int32_t w = d < g / 2 ? 0 : h->fade[(d - g / 2) * 2 < g ? (d - g / 2) * 2 : g - 1];
+            int16_t *p = dst + 2 * (n - n0);
+            p[0] = (int16_t)((p[0] * w) >> 15);
+            p[1] = (int16_t)((p[1] * w) >> 15);
+        }
+    }
+    return dst;
+}
+
+static inline void tx_hop_stop(tx_hop_t *h) {
+    if (!h->started)
+        return;
+    atomic_store(&h->stop, true);
+    pthread_join(h->th, NULL);
+    h->started = false;
+}
+
+static inline void tx_hop_print(const tx_hop_t *h) {
+    const uint64_t fast = h->hops - h->retunes;
+    printf("hop: %" PRIu64 " hops (%" PRIu64 " LO retunes, %" PRIu64 " NCO switches outside the guard, %" PRIu64
+           " slot rewrites, %" PRIu64 " errors)\n",
+           h->hops, h->retunes, h->late, h->rewrites, h->errors);
+    if (fast)
+        printf("hop: NCO switch latency avg %.1f us, max %.1f us; timing error max %" PRId64 " samples (%.1f us)\n",
+               1e6 * h->lat_sum_s / (double)fast, 1e6 * h->lat_max_s, h->err_max, 1e6 * (double)h->err_max / h->fs);
+    if (h->retunes)
+        printf("hop: LO retune max %.2f ms\n", 1e3 * h->retune_max_s);
+}
+
+static inline void tx_hop_free(tx_hop_t *h) {
+    tx_hop_stop(h);
+    free(h->fade);
+    h->fade = NULL;
+}
+
+#endif
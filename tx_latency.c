@@ -0,0 +1,721 @@
+#define _GNU_SOURCE
+#include "lime/LimeSuite.h"
+#include "limetx.h"
+#include "tx_boot.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// End-to-end latency of the tx_pipe_I16bit data path, from the producer's write() to the DAC.
+// One process plays both ends on one board: a producer thread writes I/Q into a named pipe
+// (silence with a short fs/8 tone burst every --marker-ms, each stamped with the CLOCK_MONOTONIC
+// time its write() returned), the main thread gathers it into chunks the way tx_pipe does (full
+// chunk, or --gather-ms after the first byte) and sends them, and an RX stream on the LB1/LB2
+// loopback finds the bursts again. RX timestamps count samples, so the host time of a detected
+// burst is its timestamp over the sample rate plus the host-to-device clock offset, which is the
+// smallest (return time - block end) seen over the run. That offset still carries the shortest
+// RX delivery delay, so latencies read high by about one RX block at most.
+//
+// Every combination of --chunk, --fifo-size and --pipe-size gets a fresh pipe and fresh streams
+// and one result line; --out appends them as JSON. By default the producer is paced at the
+// sample rate like wav_to_pipe_I16bit.py and writes each block as it falls due, which shows the
+// latency a real-time source sees. --lead-ms keeps that much queued ahead of real time; the
+// queue sits in front of the pipe, chunk and FIFO, so once it covers them every combination
+// reads about the lead, and the result line also gives the latency beyond it. --greedy writes as
+// fast as the pipe takes it, so every buffer fills up and the result is their sum, the worst
+// case. A paced producer never catches up after an underrun, so each one adds its length to the
+// latency of every later burst. With no lead, the stream underruns whenever a chunk waits to
+// fill, and the underrun count shows how often that happened. The lead to pick is the smallest
+// one that removes the underruns.
+//
+// gcc -O2 -Imock -o tx_latency_mock tx_latency.c mock/lms_mock.c -lpthread -lm runs it without a
+// board; the mock loops the TX stream back to RX itself.
+
+#define CH 0
+#define BUF_SAMPLES 8192            // --chunk default, as tx_pipe_I16bit
+#define FIFO_SIZE_SAMPLES (1 << 17) // --fifo-size default
+#define PIPE_SIZE_DEF (1 << 20)
+#define GATHER_MS_DEF 5
+#define WRITE_FRAMES_DEF 1024 // --write: frames per producer write()
+#define LEAD_MS_DEF 0.0 // paced producer: this far ahead of real time
+#define MARKER_MS_DEF 50.0
+#define MARKER_LEN 256 // burst length unit, samples: burst k is (1 + k % MARKER_CODES) units long
+#define MARKER_CODES 4
+#define MARKER_SCALE 0.70
+#define SETTLE_MS 300        // silence before the first burst; RX measures its idle level meanwhile
+#define THRESH_FACTOR 4.0    // auto threshold: this times the idle RX peak...
+#define THRESH_MIN_FS 0.005  // ...but at least this
+#define RX_BLOCK 1024
+#define RX_FIFO_SAMPLES (1 << 16)
+#define RX_GAIN_DEF 30
+#define SEND_TIMEOUT_MS 1000
+#define RECV_TIMEOUT_MS 1000
+#define DRAIN_TIMEOUT_MS 5000
+#define MAX_LIST 16
+#define MAX_MARKERS (1 << 16)
+
+// clang-format off
+#define CHECK(x) do { \
+  int __e = (x); \
+  if (__e) { fprintf(stderr,"ERROR: %s -> %s\n", #x, LMS_GetLastErrorMessage()); goto cleanup; } \
+} while(0)
+// clang-format on
+
+static volatile int keep_running = 1;
+static void on_sigint(int s) {
+    (void)s;
+    keep_running = 0;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void sleep_ns(uint64_t ns) {
+    struct timespec ts = {(time_t)(ns / 1000000000ull), (long)(ns % 1000000000ull)};
+    nanosleep(&ts, NULL);
+}
+
+typedef struct {
+    // configuration of this run
+    lms_device_t *dev;
+    double sr;
+    int chunk, fifo_size, pipe_size, gather_ms, write_frames;
+    uint64_t marker_every, total_frames; // frames
+    bool greedy;
+    double lead_ms;
+    double thr_fs; // 0 = from the idle RX level
+
+    int rfd, wfd;
+    lms_stream_t txs, rxs;
+
+    // producer
+    uint64_t *t_marker; // host ns when the write() carrying the burst's first frame returned
+    size_t n_marker;
+    int wr_err;
+
+    // RX
+    atomic_int rx_run;
+    int64_t off_ns; // host ns minus device time of the same sample, lower envelope
+    bool have_off;
+    uint64_t *ts_det; // RX timestamp of each burst's first sample over the threshold
+    uint8_t *code_det; // its length code
+    size_t n_det;
+    double idle_peak, det_peak, thr; // FS
+    int rx_err;
+
+    // stream
+    uint64_t sends, short_chunks;
+    unsigned underruns, overruns; // TX, RX
+} run_t;
+
+typedef struct {
+    int chunk, fifo_size, pipe_size;
+    size_t markers, matched;
+    double p50_ms, p99_ms, max_ms, min_ms, buffers_ms;
+    unsigned underruns, overruns;
+} result_t;
+
+static void *producer_thread(void *arg) {
+    run_t *r = (run_t *)arg;
+    const size_t W = (size_t)r->write_frames;
+    int16_t *blk = (int16_t *)malloc(2 * W * sizeof(int16_t));
+    if (!blk) {
+        r->wr_err = ENOMEM;
+        goto out;
+    }
+    const uint64_t first = (uint64_t)(r->sr * SETTLE_MS / 1000.0) / W * W;
+    uint64_t b_start = 0, b_len = 0; // latest burst, which may run on past its first block
+    const uint64_t t0 = now_ns() - (uint64_t)(r->lead_ms * 1e6);
+    for (uint64_t pos = 0; pos < r->total_frames && keep_running; pos += W) {
+        if (!r->greedy) {
+            const uint64_t due = t0 + (uint64_t)((double)pos / r->sr * 1e9), t = now_ns();
+            if (due > t)
+                sleep_ns(due - t);
+        }
+        const bool is_mark = pos >= first && (pos - first) % r->marker_every == 0 && r->n_marker < MAX_MARKERS;
+        if (is_mark) {
+            b_start = pos;
+            b_len = (uint64_t)MARKER_LEN * (1 + r->n_marker % MARKER_CODES);
+        }
+        memset(blk, 0, 2 * W * sizeof(int16_t));
+        for (uint64_t k = pos > b_start ? pos - b_start : 0; k < b_len && b_start + k < pos + W; k++) {
+            const double ph = 2.0 * M_PI * (double)k / 8.0;
+            blk[2 * (b_start + k - pos)] = (int16_t)lrint(MARKER_SCALE * 32767.0 * cos(ph));
+            blk[2 * (b_start + k - pos) + 1] = (int16_t)lrint(MARKER_SCALE * 32767.0 * sin(ph));
+        }
+        const uint8_t *p = (const uint8_t *)blk;
+        for (size_t left = 2 * W * sizeof(int16_t); left > 0;) {
+            const ssize_t got = write(r->wfd, p, left);
+            if (got < 0) {
+                if (errno == EINTR)
+                    continue;
+                r->wr_err = errno;
+                goto out;
+            }
+            p += got;
+            left -= (size_t)got;
+        }
+        if (is_mark)
+            r->t_marker[r->n_marker++] = now_ns();
+    }
+out:
+    close(r->wfd); // EOF ends the stream loop
+    r->wfd = -1;
+    free(blk);
+    return NULL;
+}
+
+// Burst length in MARKER_LEN units tells which of MARKER_CODES consecutive bursts this is.
+static void rx_burst_end(run_t *r, uint64_t first, uint64_t last) {
+    if (r->n_det == MAX_MARKERS)
+        return;
+    const long units = lrint((double)(last - first + 1) / MARKER_LEN);
+    r->ts_det[r->n_det] = first;
+    r->code_det[r->n_det++] = (uint8_t)(units < 1 ? 0 : units > MARKER_CODES ? MARKER_CODES - 1 : units - 1);
+}
+
+static void *rx_thread(void *arg) {
+    run_t *r = (run_t *)arg;
+    int16_t *buf = (int16_t *)malloc(RX_BLOCK * 2 * sizeof(int16_t));
+    if (!buf) {
+        r->rx_err = ENOMEM;
+        return NULL;
+    }
+    const uint64_t idle_frames = (uint64_t)(r->sr * SETTLE_MS / 2000.0);
+    uint64_t seen = 0, b_start = 0, b_last = 0;
+    double thr2 = r->thr_fs > 0 ? r->thr_fs * r->thr_fs : -1.0, idle2 = 0.0, det2 = 0.0;
+    bool in_burst = false;
+    while (atomic_load(&r->rx_run)) {
+        lms_stream_meta_t meta;
+        memset(&meta, 0, sizeof(meta));
+        const int got = LMS_RecvStream(&r->rxs, buf, RX_BLOCK, &meta, RECV_TIMEOUT_MS);
+        const uint64_t t = now_ns();
+        if (got < 0) {
+            r->rx_err = EIO;
+            break;
+        }
+        if (got == 0)
+            continue;
+        const int64_t off = (int64_t)t - (int64_t)((double)(meta.timestamp + (uint64_t)got) / r->sr * 1e9);
+        if (!r->have_off || off < r->off_ns) {
+            r->off_ns = off;
+            r->have_off = true;
+        }
+        for (int n = 0; n < got; n++) {
+            const double i = buf[2 * n] / 32767.0, q = buf[2 * n + 1] / 32767.0;
+            const double m2 = i * i + q * q;
+            if (thr2 < 0) {
+                idle2 = m2 > idle2 ? m2 : idle2;
+                continue;
+            }
+            const uint64_t ts = meta.timestamp + (uint64_t)n;
+            if (m2 >= thr2) {
+                det2 = m2 > det2 ? m2 : det2;
+                if (!in_burst)
+                    b_start = ts;
+                in_burst = true;
+                b_last = ts;
+            } else if (in_burst && ts - b_last >= MARKER_LEN) {
+                rx_burst_end(r, b_start, b_last);
+                in_burst = false;
+            }
+        }
+        seen += (uint64_t)got;
+        if (thr2 < 0 && seen >= idle_frames) {
+            const double thr = fmax(THRESH_FACTOR * sqrt(idle2), THRESH_MIN_FS);
+            thr2 = thr * thr;
+        }
+    }
+    if (in_burst)
+        rx_burst_end(r, b_start, b_last);
+    r->idle_peak = sqrt(idle2);
+    r->det_peak = sqrt(det2);
+    r->thr = thr2 > 0 ? sqrt(thr2) : 0.0;
+    free(buf);
+    return NULL;
+}
+
+// tx_pipe_I16bit's gather rule: return once `cap` bytes are buffered, or gather_ms after the
+// first byte of the chunk. Whole frames only; a partial one is carried over in *have.
+static ssize_t gather(run_t *r, uint8_t *buf, size_t cap, size_t *have, bool *eof) {
+    uint64_t t_first = *have ? now_ns() : 0;
+    while (*have < cap && !*eof && keep_running) {
+        int timeout = -1;
+        if (*have >= 4) {
+            const double left_ms = r->gather_ms - (double)(now_ns() - t_first) / 1e6;
+            if (left_ms <= 0.0)
+                break;
+            timeout = (int)ceil(left_ms);
+        }
+        struct pollfd pfd = {.fd = r->rfd, .events = POLLIN};
+        const int pr = poll(&pfd, 1, timeout);
+        if (pr < 0 && errno == EINTR)
+            continue;
+        if (pr < 0) {
+            perror("poll fifo");
+            return -1;
+        }
+        if (pr == 0)
+            break;
+        const ssize_t got = read(r->rfd, buf + *have, cap - *have);
+        if (got < 0 && (errno == EINTR || errno == EAGAIN))
+            continue;
+        if (got < 0) {
+            perror("read fifo");
+            return -1;
+        }
+        if (got == 0) {
+            *eof = true;
+            break;
+        }
+        if (*have == 0)
+            t_first = now_ns();
+        *have += (size_t)got;
+    }
+    const size_t frames = *have / 4;
+    if (frames && *have < cap)
+        r->short_chunks++;
+    return (ssize_t)frames;
+}
+
+static int cmp_i64(const void *a, const void *b) {
+    const int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Bursts and detections pair up in order. The length code says which burst of the next
+// MARKER_CODES a detection is, so a missed burst (an RX overrun) does not shift every later
+// pairing; a detection before its burst was even written is a false trigger and is skipped.
+static void correlate(const run_t *r, result_t *res) {
+    res->markers = r->n_marker;
+    res->matched = 0;
+    if (!r->have_off || !r->n_marker)
+        return;
+    int64_t *lat = (int64_t *)malloc(r->n_marker * sizeof(int64_t));
+    if (!lat)
+        return;
+    size_t j = 0;
+    for (size_t d = 0; d < r->n_det && j < r->n_marker; d++) {
+        const int64_t host = r->off_ns + (int64_t)((double)r->ts_det[d] / r->sr * 1e9);
+        size_t k = j;
+        while (k < r->n_marker && k % MARKER_CODES != r->code_det[d])
+            k++;
+        if (k == r->n_marker || host < (int64_t)r->t_marker[k])
+            continue;
+        lat[res->matched++] = host - (int64_t)r->t_marker[k];
+        j = k + 1;
+    }
+    const size_t n = res->matched;
+    if (n) {
+        qsort(lat, n, sizeof(int64_t), cmp_i64);
+        res->min_ms = (double)lat[0] / 1e6;
+        res->p50_ms = (double)lat[n / 2] / 1e6;
+        res->p99_ms = (double)lat[(n * 99) / 100 < n ? (n * 99) / 100 : n - 1] / 1e6;
+        res->max_ms = (double)lat[n - 1] / 1e6;
+    }
+    free(lat);
+}
+
+static void collect_status(run_t *r) {
+    lms_stream_status_t st;
+    memset(&st, 0, sizeof(st));
+    if (!LMS_GetStreamStatus(&r->txs, &st))
+        r->underruns += st.underrun;
+}
+
+// RX on LB1 or LB2, whichever taps the TX path in use, tuned to the TX LO (as tx_trim_setup).
+static int rx_loopback_setup(lms_device_t *dev, double lo_hz, double bw_hz, int gain_db) {
+    if (LMS_EnableChannel(dev, LMS_CH_RX, CH, true))
+        return -1;
+    lms_name_t names[16];
+    const int na = LMS_GetAntennaList(dev, LMS_CH_RX, CH, NULL);
+    if (na < 1 || na > 16 || LMS_GetAntennaList(dev, LMS_CH_RX, CH, names) < 0)
+        return -1;
+    const char *want = LMS_GetAntenna(dev, LMS_CH_TX, CH) == LMS_PATH_TX2 ? "LB2" : "LB1";
+    int ant = -1;
+    for (int i = 0; i < na; i++)
+        if (!strcmp(names[i], want))
+            ant = i;
+    if (ant < 0) {
+        fprintf(stderr, "RX has no %s loopback path\n", want);
+        return -1;
+    }
+    if (LMS_SetAntenna(dev, LMS_CH_RX, CH, (size_t)ant) || LMS_SetLOFrequency(dev, LMS_CH_RX, CH, lo_hz))
+        return -1;
+    (void)LMS_SetLPFBW(dev, LMS_CH_RX, CH, fmin(fmax(bw_hz, 1.5e6), 130e6));
+    if (LMS_SetGaindB(dev, LMS_CH_RX, CH, (unsigned)gain_db))
+        return -1;
+    printf("RX loopback on %s, gain %d dB\n", want, gain_db);
+    return 0;
+}
+
+// One chunk/FIFO/pipe combination: fresh pipe ends and streams, producer and RX threads, then
+// stream until the producer's EOF and wait for the FIFO to play out.
+static int run_one(run_t *r, const char *fifo_path, result_t *res) {
+    int rc = -1;
+    uint8_t *buf = NULL;
+    pthread_t prod, rx;
+    bool prod_started = false, rx_started = false;
+    r->rfd = r->wfd = -1;
+    memset(&r->txs, 0, sizeof(r->txs));
+    memset(&r->rxs, 0, sizeof(r->rxs));
+    r->n_marker = r->n_det = 0;
+    r->have_off = false;
+    r->sends = r->short_chunks = 0;
+    r->underruns = r->overruns = 0;
+    r->wr_err = r->rx_err = 0;
+
+    // The read end first, non-blocking, so the write end opens without a second process
+    r->rfd = open(fifo_path, O_RDONLY | O_NONBLOCK);
+    if (r->rfd < 0 || (r->wfd = open(fifo_path, O_WRONLY)) < 0) {
+        fprintf(stderr, "open %s: %s\n", fifo_path, strerror(errno));
+        goto cleanup;
+    }
+    if (fcntl(r->wfd, F_SETPIPE_SZ, r->pipe_size) < 0)
+        fprintf(stderr, "WARN: F_SETPIPE_SZ(%d) failed: %s (see /proc/sys/fs/pipe-max-size)\n", r->pipe_size,
+                strerror(errno));
+    r->pipe_size = fcntl(r->wfd, F_GETPIPE_SZ);
+
+    const size_t cap = (size_t)r->chunk * 4;
+    buf = (uint8_t *)malloc(cap);
+    if (!buf) {
+        fprintf(stderr, "malloc failed\n");
+        goto cleanup;
+    }
+
+    r->rxs.channel = CH;
+    r->rxs.isTx = false;
+    r->rxs.fifoSize = RX_FIFO_SAMPLES;
+    r->rxs.throughputVsLatency = 0.0f;
+    r->rxs.dataFmt = LMS_FMT_I16;
+    CHECK(LMS_SetupStream(r->dev, &r->rxs));
+    CHECK(LMS_StartStream(&r->rxs));
+    atomic_store(&r->rx_run, 1);
+    if (pthread_create(&rx, NULL, rx_thread, r)) {
+        fprintf(stderr, "failed to start the RX thread\n");
+        goto cleanup;
+    }
+    rx_started = true;
+
+    r->txs.channel = CH;
+    r->txs.isTx = true;
+    r->txs.fifoSize = (uint32_t)r->fifo_size;
+    r->txs.dataFmt = LMS_FMT_I16;
+    CHECK(LMS_SetupStream(r->dev, &r->txs));
+    CHECK(LMS_StartStream(&r->txs));
+
+    if (pthread_create(&prod, NULL, producer_thread, r)) {
+        fprintf(stderr, "failed to start the producer thread\n");
+        goto cleanup;
+    }
+    prod_started = true;
+
+    size_t have = 0;
+    bool eof = false;
+    time_t last = time(NULL);
+    while (keep_running) {
+        const ssize_t frames = gather(r, buf, cap, &have, &eof);
+        if (frames < 0)
+            goto cleanup;
+        if (frames == 0)
+            break;
+        const int sent = LMS_SendStream(&r->txs, buf, (size_t)frames, NULL, SEND_TIMEOUT_MS);
+        if (sent != (int)frames) {
+            fprintf(stderr, "LMS_SendStream error: %s\n", LMS_GetLastErrorMessage());
+            goto cleanup;
+        }
+        r->sends++;
+        const size_t rest = have - (size_t)frames * 4;
+        if (rest)
+            memmove(buf, buf + (size_t)frames * 4, rest);
+        have = rest;
+        const time_t now = time(NULL);
+        if (now != last) {
+            last = now;
+            collect_status(r);
+        }
+    }
+    collect_status(r); // the drain below underruns on purpose
+
+    // Let the FIFO play out and the RX pick up the last burst
+    for (const uint64_t t_end = now_ns() + DRAIN_TIMEOUT_MS * 1000000ull; keep_running && now_ns() < t_end;) {
+        lms_stream_status_t st;
+        memset(&st, 0, sizeof(st));
+        if (LMS_GetStreamStatus(&r->txs, &st) || st.fifoFilledCount == 0)
+            break;
+        sleep_ns(2000000);
+    }
+    sleep_ns((uint64_t)(4.0 * RX_BLOCK / r->sr * 1e9) + 20000000ull);
+    rc = 0;
+
+cleanup:
+    if (r->rfd >= 0) {
+        close(r->rfd); // a producer still blocked in write() gets EPIPE
+        r->rfd = -1;
+    }
+    if (prod_started)
+        pthread_join(prod, NULL);
+    if (rx_started) {
+        atomic_store(&r->rx_run, 0);
+        pthread_join(rx, NULL);
+        lms_stream_status_t st;
+        memset(&st, 0, sizeof(st));
+        if (!LMS_GetStreamStatus(&r->rxs, &st))
+            r->overruns += st.overrun;
+    }
+    if (r->txs.handle) {
+        LMS_StopStream(&r->txs);
+        LMS_DestroyStream(r->dev, &r->txs);
+    }
+    if (r->rxs.handle) {
+        LMS_StopStream(&r->rxs);
+        LMS_DestroyStream(r->dev, &r->rxs);
+    }
+    if (r->wfd >= 0)
+        close(r->wfd);
+    free(buf);
+    if (r->wr_err)
+        fprintf(stderr, "producer: write fifo: %s\n", strerror(r->wr_err));
+    if (r->rx_err)
+        fprintf(stderr, "LMS_RecvStream error: %s\n", LMS_GetLastErrorMessage());
+
+    memset(res, 0, sizeof(*res));
+    res->chunk = r->chunk;
+    res->fifo_size = r->fifo_size;
+    res->pipe_size = r->pipe_size;
+    res->underruns = r->underruns;
+    res->overruns = r->overruns;
+    res->buffers_ms = ((double)r->pipe_size / 4.0 + r->chunk + r->fifo_size) / r->sr * 1e3;
+    correlate(r, res);
+    return rc;
+}
+
+static void print_result(const run_t *r, const result_t *res) {
+    printf("chunk %7d fifo %7d pipe %8d: ", res->chunk, res->fifo_size, res->pipe_size);
+    if (!res->matched)
+        printf("no bursts detected (%zu sent)", res->markers);
+    else
+        printf("latency p50 %7.2f ms, p99 %7.2f ms, max %7.2f ms (min %.2f) over %zu/%zu bursts", res->p50_ms,
+               res->p99_ms, res->max_ms, res->min_ms, res->matched, res->markers);
+    if (res->matched && !r->greedy && r->lead_ms > 0.0)
+        printf(", p50 %.2f ms beyond the %.1f ms lead%s", res->p50_ms - r->lead_ms, r->lead_ms,
+               res->p50_ms < 2.0 * r->lead_ms ? " (the lead dominates)" : "");
+    printf(", buffers %.1f ms, underruns %u, RX overruns %u, short chunks %" PRIu64 "\n", res->buffers_ms,
+           res->underruns, res->overruns, r->short_chunks);
+    printf("    RX idle peak %.1f dBFS, bursts %.1f dBFS, threshold %.1f dBFS\n",
+           20.0 * log10(fmax(r->idle_peak, 1e-6)), 20.0 * log10(fmax(r->det_peak, 1e-6)),
+           20.0 * log10(fmax(r->thr, 1e-6)));
+}
+
+static void write_json(FILE *f, const run_t *r, const result_t *res) {
+    fprintf(f,
+            "{\"chunk\":%d,\"fifo_size\":%d,\"pipe_size\":%d,\"gather_ms\":%d,\"sample_rate\":%.0f,\"greedy\":%s,"
+            "\"lead_ms\":%.1f,\"bursts\":%zu,\"matched\":%zu,\"p50_ms\":%.3f,\"p99_ms\":%.3f,\"max_ms\":%.3f,"
+            "\"min_ms\":%.3f,\"p50_beyond_lead_ms\":%.3f,\"buffers_ms\":%.3f,\"underruns\":%u,\"rx_overruns\":%u,\"short_chunks\":%" PRIu64 "}\n",
+            res->chunk, res->fifo_size, res->pipe_size, r->gather_ms, r->sr, r->greedy ? "true" : "false", r->lead_ms,
+            res->markers, res->matched, res->p50_ms, res->p99_ms, res->max_ms, res->min_ms,
+            r->greedy ? res->p50_ms : res->p50_ms - r->lead_ms, res->buffers_ms,
+            res->underruns, res->overruns, r->short_chunks);
+    fflush(f);
+}
+
+// "a,b,c" -> v[]; returns the count, 0 when a value is out of [lo, hi] or there are too many.
+static int parse_list(const char *s, int *v, int lo, int hi) {
+    int n = 0;
+    for (const char *p = s;;) {
+        char *end = NULL;
+        const long x = strtol(p, &end, 0);
+        if (end == p || x < lo || x > hi || n == MAX_LIST)
+            return 0;
+        v[n++] = (int)x;
+        if (*end == '\0')
+            return n;
+        if (*end != ',')
+            return 0;
+        p = end + 1;
+    }
+}
+
+int main(int argc, char **argv) {
+    int OVERSAMPLE = 32;
+    double TX_LPF_BW_HZ = 30e6;
+    double LO_HZ = 30e6;
+    int TX_GAIN_DB = 40;
+    int RX_GAIN_DB = RX_GAIN_DEF;
+    double HOST_SR_HZ = 5e6;
+    int CHUNKS[MAX_LIST] = {BUF_SAMPLES}, N_CHUNKS = 1;
+    int FIFOS[MAX_LIST] = {FIFO_SIZE_SAMPLES}, N_FIFOS = 1;
+    int PIPES[MAX_LIST] = {PIPE_SIZE_DEF}, N_PIPES = 1;
+    int GATHER_MS = GATHER_MS_DEF;
+    int WRITE_FRAMES = WRITE_FRAMES_DEF;
+    double MARKER_MS = MARKER_MS_DEF;
+    double SECONDS = 3.0; // of bursts per combination
+    bool GREEDY = false;
+    double LEAD_MS = LEAD_MS_DEF;
+    double THRESHOLD = 0; // FS; 0 = auto
+    const char *FIFO_PATH = NULL;
+    const char *OUT = NULL;
+
+    // clang-format off
+    for (int i=1; i<argc; i++){
+        const char* a = argv[i];
+        #define NEEDVAL() do{ if (i+1>=argc){ fprintf(stderr,"missing value for %s\n", a); return 1; } }while(0)
+
+        if (!strcmp(a,"--sample-rate")){ NEEDVAL(); if(!limetx_parse_hz(argv[++i], &HOST_SR_HZ) || HOST_SR_HZ<=0) { fprintf(stderr,"bad --sample-rate\n"); return 1; } continue; }
+        if (!strcmp(a,"--oversample")){ NEEDVAL(); OVERSAMPLE = (int)strtol(argv[++i], NULL, 0); if (OVERSAMPLE<1){ fprintf(stderr,"bad --oversample\n"); return 1; } continue; }
+        if (!strcmp(a,"--lo")){ NEEDVAL(); if(!limetx_parse_hz(argv[++i], &LO_HZ)) { fprintf(stderr,"bad --lo\n"); return 1; } continue; }
+        if (!strcmp(a,"--tx-lpf-bw")){ NEEDVAL(); if(!limetx_parse_hz(argv[++i], &TX_LPF_BW_HZ)) { fprintf(stderr,"bad --tx-lpf-bw\n"); return 1; } continue; }
+        if (!strcmp(a,"--tx-gain")){ NEEDVAL(); TX_GAIN_DB = (int)strtol(argv[++i], NULL, 0); if (TX_GAIN_DB<0 || TX_GAIN_DB>73){ fprintf(stderr,"bad --tx-gain (0..73)\n"); return 1; } continue; }
+        if (!strcmp(a,"--rx-gain")){ NEEDVAL(); RX_GAIN_DB = (int)strtol(argv[++i], NULL, 0); if (RX_GAIN_DB<0 || RX_GAIN_DB>73){ fprintf(stderr,"bad --rx-gain (0..73)\n"); return 1; } continue; }
+        if (!strcmp(a,"--chunk")){ NEEDVAL(); if (!(N_CHUNKS = parse_list(argv[++i], CHUNKS, 64, 1<<20))){ fprintf(stderr,"bad --chunk (list of 64..%d)\n", 1<<20); return 1; } continue; }
+        if (!strcmp(a,"--fifo-size")){ NEEDVAL(); if (!(N_FIFOS = parse_list(argv[++i], FIFOS, 4096, 1<<24))){ fprintf(stderr,"bad --fifo-size (list of 4096..%d)\n", 1<<24); return 1; } continue; }
+        if (!strcmp(a,"--pipe-size")){ NEEDVAL(); if (!(N_PIPES = parse_list(argv[++i], PIPES, 4096, 1<<30))){ fprintf(stderr,"bad --pipe-size (list of bytes)\n"); return 1; } continue; }
+        if (!strcmp(a,"--gather-ms")){ NEEDVAL(); GATHER_MS = (int)strtol(argv[++i], NULL, 0); if (GATHER_MS<0){ fprintf(stderr,"bad --gather-ms\n"); return 1; } continue; }
+        if (!strcmp(a,"--write")){ NEEDVAL(); WRITE_FRAMES = (int)strtol(argv[++i], NULL, 0); if (WRITE_FRAMES<64 || WRITE_FRAMES>(1<<20)){ fprintf(stderr,"bad --write (64..%d frames)\n", 1<<20); return 1; } continue; }
+        if (!strcmp(a,"--marker-ms")){ NEEDVAL(); MARKER_MS = strtod(argv[++i], NULL); if (MARKER_MS<=0){ fprintf(stderr,"bad --marker-ms\n"); return 1; } continue; }
+        if (!strcmp(a,"--seconds")){ NEEDVAL(); SECONDS = strtod(argv[++i], NULL); if (SECONDS<=0){ fprintf(stderr,"bad --seconds\n"); return 1; } continue; }
+        if (!strcmp(a,"--greedy")){ GREEDY = true; if (i+1 < argc){ bool v=false; if (limetx_parse_bool(argv[i+1], &v)){ GREEDY = v; i++; } } continue; }
+        if (!strcmp(a,"--lead-ms")){ NEEDVAL(); LEAD_MS = strtod(argv[++i], NULL); if (LEAD_MS<0){ fprintf(stderr,"bad --lead-ms\n"); return 1; } continue; }
+        if (!strcmp(a,"--threshold")){ NEEDVAL(); THRESHOLD = strtod(argv[++i], NULL); if (THRESHOLD<=0 || THRESHOLD>=1){ fprintf(stderr,"bad --threshold (FS, 0..1)\n"); return 1; } continue; }
+        if (!strcmp(a,"--fifo")){ NEEDVAL(); FIFO_PATH = argv[++i]; continue; }
+        if (!strcmp(a,"--out")){ NEEDVAL(); OUT = argv[++i]; continue; }
+
+        fprintf(stderr,"unknown option: %s\n", a);
+        return 1;
+    }
+    // clang-format on
+
+    char fifo_buf[256];
+    if (!FIFO_PATH) {
+        snprintf(fifo_buf, sizeof(fifo_buf), "/tmp/tx_latency.%d.fifo", (int)getpid());
+        FIFO_PATH = fifo_buf;
+    }
+    bool made_fifo = false;
+    if (mkfifo(FIFO_PATH, 0600) == 0)
+        made_fifo = true;
+    else if (errno != EEXIST) {
+        fprintf(stderr, "mkfifo %s: %s\n", FIFO_PATH, strerror(errno));
+        return 1;
+    }
+    FILE *out = NULL;
+    if (OUT && !(out = fopen(OUT, "a"))) {
+        fprintf(stderr, "%s: %s\n", OUT, strerror(errno));
+        if (made_fifo)
+            unlink(FIFO_PATH);
+        return 1;
+    }
+
+    int rc = 1;
+    lms_device_t *dev = NULL;
+    run_t run;
+    memset(&run, 0, sizeof(run));
+    run.t_marker = (uint64_t *)malloc(MAX_MARKERS * sizeof(uint64_t));
+    run.ts_det = (uint64_t *)malloc(MAX_MARKERS * sizeof(uint64_t));
+    run.code_det = (uint8_t *)malloc(MAX_MARKERS);
+    const int n_runs = N_CHUNKS * N_FIFOS * N_PIPES;
+    result_t *res = (result_t *)calloc((size_t)n_runs, sizeof(result_t));
+    if (!run.t_marker || !run.ts_det || !run.code_det || !res) {
+        fprintf(stderr, "malloc failed\n");
+        goto cleanup;
+    }
+
+    tx_boot_t boot;
+    tx_boot_begin(&boot, CH);
+    lms_info_str_t list[8];
+    if (LMS_GetDeviceList(list) < 1) {
+        fprintf(stderr, "no LimeSDR found\n");
+        goto cleanup;
+    }
+    if (LMS_Open(&dev, list[0], NULL)) {
+        fprintf(stderr, "LMS_Open failed: %s\n", LMS_GetLastErrorMessage());
+        dev = NULL;
+        goto cleanup;
+    }
+    tx_boot_attach(&boot, dev);
+    CHECK(tx_boot_init_device(&boot, NULL));
+    CHECK(LMS_EnableChannel(dev, LMS_CH_TX, CH, true));
+    CHECK(tx_boot_sample_rate(&boot, HOST_SR_HZ, OVERSAMPLE));
+    CHECK(tx_boot_lpf_bw(&boot, TX_LPF_BW_HZ));
+    CHECK(tx_boot_gain(&boot, TX_GAIN_DB));
+    CHECK(tx_boot_lo(&boot, LO_HZ));
+    CHECK(rx_loopback_setup(dev, LO_HZ, HOST_SR_HZ, RX_GAIN_DB));
+
+    double host_sr = 0, rf_sr = 0;
+    CHECK(LMS_GetSampleRate(dev, LMS_CH_TX, CH, &host_sr, &rf_sr));
+    run.dev = dev;
+    run.sr = host_sr;
+    run.gather_ms = GATHER_MS;
+    run.write_frames = WRITE_FRAMES;
+    run.greedy = GREEDY;
+    run.lead_ms = LEAD_MS;
+    run.thr_fs = THRESHOLD;
+    run.marker_every = (uint64_t)ceil(host_sr * MARKER_MS / 1000.0 / WRITE_FRAMES) * (uint64_t)WRITE_FRAMES;
+    run.total_frames = (uint64_t)(host_sr * (SETTLE_MS / 1000.0 + SECONDS));
+    char pace[64];
+    snprintf(pace, sizeof(pace), GREEDY ? "greedy" : "paced (%.1f ms lead)", LEAD_MS);
+    printf("host %.2f Msps, bursts every %.1f ms, %s producer writing %d frames, gather %d ms, %d combination%s\n",
+           host_sr / 1e6, (double)run.marker_every / host_sr * 1e3, pace, WRITE_FRAMES, GATHER_MS, n_runs,
+           n_runs > 1 ? "s" : "");
+
+    signal(SIGINT, on_sigint);
+    signal(SIGPIPE, SIG_IGN);
+    int done = 0;
+    for (int c = 0; c < N_CHUNKS && keep_running; c++)
+        for (int f = 0; f < N_FIFOS && keep_running; f++)
+            for (int p = 0; p < N_PIPES && keep_running; p++) {
+                run.chunk = CHUNKS[c];
+                run.fifo_size = FIFOS[f];
+                run.pipe_size = PIPES[p];
+                if (run_one(&run, FIFO_PATH, &res[done]))
+                    goto cleanup;
+                print_result(&run, &res[done]);
+                if (out)
+                    write_json(out, &run, &res[done]);
+                done++;
+            }
+
+    // Lowest p99 that kept up
+    int best = -1;
+    for (int k = 0; k < done; k++)
+        if (res[k].matched && res[k].matched == res[k].markers && !res[k].underruns &&
+            (best < 0 || res[k].p99_ms < res[best].p99_ms))
+            best = k;
+    if (done > 1 && best >= 0)
+        printf("lowest p99 without underruns: --chunk %d --fifo-size %d --pipe-size %d (p99 %.2f ms)\n",
+               res[best].chunk, res[best].fifo_size, res[best].pipe_size, res[best].p99_ms);
+    else if (done > 1)
+        printf("every combination underran or lost bursts\n");
+    rc = 0;
+
+cleanup:
+    if (dev) {
+        LMS_EnableChannel(dev, LMS_CH_RX, CH, false);
+        LMS_EnableChannel(dev, LMS_CH_TX, CH, false);
+        LMS_Close(dev);
+    }
+    if (out)
+        fclose(out);
+    if (made_fifo)
+        unlink(FIFO_PATH);
+    free(run.t_marker);
+    free(run.ts_det);
+    free(run.code_det);
+    free(res);
+    return rc;
+}
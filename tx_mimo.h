@@ -0,0 +1,242 @@
+#ifndef TX_MIMO_H
+#define TX_MIMO_H
+
+// Two-channel TX (A + B) on one device.
+// Input frames are I_A Q_A I_B Q_B, i.e. one 32-bit I/Q pair per channel, so splitting them is a
+// 32-bit even/odd deinterleave; iq_deint_select() picks the widest kernel the CPU supports. Both
+// streams are sent in lockstep with the same meta.timestamp, so frame n of A and frame n of B
+// leave the DACs on the same sample clock edge. The LMS7002M has one TX LO (SXT) for both
+// channels; LPF, gain, NCO and the TXTSP correctors are per channel.
+// Every send checks the device sample counter first: after an input stall the next timestamp is
+// already in the past and the FPGA would drop every later packet, so the stream is re-anchored
+// TX_MIMO_LEAD_MS ahead of the counter and the stall counted as an underrun on both channels.
+
+#include "iq_scale.h"
+#include "lime/LimeSuite.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TX_MIMO_NCH 2
+#define TX_MIMO_LEAD_MS 20 // first timestamp: this far ahead of the FPGA sample counter
+
+typedef void (*iq_deint_fn)(int16_t *a, int16_t *b, const int16_t *src, size_t frames);
+
+typedef struct {
+    lms_device_t *dev;
+    lms_stream_t s[TX_MIMO_NCH];
+    int16_t *a, *b; // per-channel scratch, cap frames each
+    size_t cap;
+    iq_deint_fn deint;
+    const char *kernel;
+    uint64_t ts;   // timestamp of the next frame on both channels
+    uint64_t lead; // TX_MIMO_LEAD_MS in samples
+    uint64_t rearms; // times ts fell behind the device counter and was re-anchored
+    // Counts the per-send polls took from LMS_GetStreamStatus (which reports each event once),
+    // handed back by tx_mimo_status(). rearm_pending[c] is rearms not reported on channel c yet.
+    uint32_t underrun, overrun, dropped, rearm_pending[TX_MIMO_NCH];
+} tx_mimo_t;
+
+static inline void iq_deint_c(int16_t *a, int16_t *b, const int16_t *src, size_t frames) {
+    for (size_t i = 0; i < frames; i++) {
+        a[2 * i] = src[4 * i];
+        a[2 * i + 1] = src[4 * i + 1];
+        b[2 * i] = src[4 * i + 2];
+        b[2 * i + 1] = src[4 * i + 3];
+    }
+}
+
+#ifdef IQ_SCALE_X86
+__attribute__((target("sse2"))) static inline void iq_deint_sse2(int16_t *a, int16_t *b, const int16_t *src,
+                                                                 size_t frames) {
+    size_t i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        // [A0 B0 A1 B1] [A2 B2 A3 B3] -> [A0 A1 B0 B1] [A2 A3 B2 B3] -> [A0..A3] [B0..B3]
+        __m128i x0 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)(src + 4 * i)), _MM_SHUFFLE(3, 1, 2, 0));
+        __m128i x1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)(src + 4 * i + 8)), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm_storeu_si128((__m128i *)(a + 2 * i), _mm_unpacklo_epi64(x0, x1));
+        _mm_storeu_si128((__m128i *)(b + 2 * i), _mm_unpackhi_epi64(x0, x1));
+    }
+    iq_deint_c(a + 2 * i, b + 2 * i, src + 4 * i, frames - i);
+}
+
+__attribute__((target("avx2"))) static inline void iq_deint_avx2(int16_t *a, int16_t *b, const int16_t *src,
+                                                                 size_t frames) {
+    const __m256i idx = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    size_t i = 0;
+    for (; i + 8 <= frames; i += 8) {
+        // each register becomes [A A A A | B B B B]; the lane permutes then gather A and B
+        __m256i x0 = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i *)(src + 4 * i)), idx);
+        __m256i x1 = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i *)(src + 4 * i + 16)), idx);
+        _mm256_storeu_si256((__m256i *)(a + 2 * i), _mm256_permute2x128_si256(x0, x1, 0x20));
+        _mm256_storeu_si256((__m256i *)(b + 2 * i), _mm256_permute2x128_si256(x0, x1, 0x31));
+    }
+    iq_deint_sse2(a + 2 * i, b + 2 * i, src + 4 * i, frames - i);
+}
+#endif
+
+#ifdef IQ_SCALE_NEON
+static inline void iq_deint_neon(int16_t *a, int16_t *b, const int16_t *src, size_t frames) {
+    size_t i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        uint32x4x2_t v = vld2q_u32((const uint32_t *)(src + 4 * i));
+        vst1q_u32((uint32_t *)(a + 2 * i), v.val[0]);
+        vst1q_u32((uint32_t *)(b + 2 * i), v.val[1]);
+    }
+    iq_deint_c(a + 2 * i, b + 2 * i, src + 4 * i, frames - i);
+}
+#endif
+
+static inline iq_deint_fn iq_deint_select(const char **name) {
+    const char *n = "c";
+    iq_deint_fn fn = iq_deint_c;
+#ifdef IQ_SCALE_X86
+    if (__builtin_cpu_supports("avx2")) {
+        n = "avx2";
+        fn = iq_deint_avx2;
+    } else if (__builtin_cpu_supports("sse2")) {
+        n = "sse2";
+        fn = iq_deint_sse2;
+    }
+#elif defined(IQ_SCALE_NEON)
+    n = "neon";
+    fn = iq_deint_neon;
+#endif
+    if (name)
+        *name = n;
+    return fn;
+}
+
+// Per-channel setup for a channel other than the one configured through tx_boot (the LO is shared).
+static inline int tx_mimo_config_ch(lms_device_t *dev, int ch, double lpf_bw_hz, int gain_db, const double freqs[16],
+                                    int nco_index, bool downconvert) {
+    if (LMS_EnableChannel(dev, LMS_CH_TX, ch, true) || LMS_SetLPFBW(dev, LMS_CH_TX, ch, lpf_bw_hz) ||
+        LMS_SetGaindB(dev, LMS_CH_TX, ch, (unsigned)gain_db) || LMS_SetNCOFrequency(dev, true, ch, freqs, 0.0) ||
+        LMS_SetNCOIndex(dev, true, ch, nco_index, downconvert))
+        return -1;
+    return 0;
+}
+
+static inline void tx_mimo_stop(tx_mimo_t *m) {
+    for (int c = 0; c < TX_MIMO_NCH; c++) {
+        if (m->s[c].handle) {
+            LMS_StopStream(&m->s[c]);
+            LMS_DestroyStream(m->dev, &m->s[c]);
+        }
+    }
+    free(m->a);
+    free(m->b);
+    memset(m, 0, sizeof(*m));
+}
+
+// Set up and start one stream per channel; cap is the largest chunk tx_mimo_send_interleaved() splits.
+static inline int tx_mimo_start(tx_mimo_t *m, lms_device_t *dev, uint32_t fifo_size, int link_fmt, size_t cap,
+                                double host_sr_hz) {
+    memset(m, 0, sizeof(*m));
+    m->dev = dev;
+    m->cap = cap;
+    m->a = (int16_t *)aligned_alloc(64, ((2 * cap * sizeof(int16_t) + 63) / 64) * 64);
+    m->b = (int16_t *)aligned_alloc(64, ((2 * cap * sizeof(int16_t) + 63) / 64) * 64);
+    if (!m->a || !m->b) {
+        fprintf(stderr, "malloc failed\n");
+        tx_mimo_stop(m);
+        return -1;
+    }
+    m->deint = iq_deint_select(&m->kernel);
+
+    for (int c = 0; c < TX_MIMO_NCH; c++) {
+        m->s[c].channel = (uint32_t)c;
+        m->s[c].isTx = true;
+        m->s[c].fifoSize = fifo_size;
+        m->s[c].dataFmt = LMS_FMT_I16;
+        m->s[c].linkFmt = link_fmt;
+        if (LMS_SetupStream(dev, &m->s[c]))
+            return -1;
+    }
+    for (int c = 0; c < TX_MIMO_NCH; c++)
+        if (LMS_StartStream(&m->s[c]))
+            return -1;
+
+    lms_stream_status_t st;
+    memset(&st, 0, sizeof(st));
+    if (LMS_GetStreamStatus(&m->s[0], &st))
+        return -1;
+    m->lead = (uint64_t)(host_sr_hz * TX_MIMO_LEAD_MS / 1000.0);
+    m->ts = st.timestamp + m->lead;
+    return 0;
+}
+
+// Re-anchor ts when it is no longer ahead of the device counter or the FPGA dropped late packets.
+static inline int tx_mimo_check_late(tx_mimo_t *m) {
+    lms_stream_status_t st;
+    memset(&st, 0, sizeof(st));
+    if (LMS_GetStreamStatus(&m->s[0], &st))
+        return -1;
+    m->underrun += st.underrun;
+    m->overrun += st.overrun;
+    m->dropped += st.droppedPackets;
+    if (m->ts <= st.timestamp || st.droppedPackets) {
+        m->ts = st.timestamp + m->lead;
+        m->rearms++;
+        for (int c = 0; c < TX_MIMO_NCH; c++)
+            m->rearm_pending[c]++;
+    }
+    return 0;
+}
+
+// Status poll for channel c with what the per-send polls already took (channel A) and the
+// re-anchors folded in, so the tools' once-a-second counters stay complete.
+static inline int tx_mimo_status(tx_mimo_t *m, int c, lms_stream_status_t *st) {
+    if (LMS_GetStreamStatus(&m->s[c], st))
+        return -1;
+    if (c == 0) {
+        st->underrun += m->underrun;
+        st->overrun += m->overrun;
+        st->droppedPackets += m->dropped;
+        m->underrun = m->overrun = m->dropped = 0;
+    }
+    st->underrun += m->rearm_pending[c];
+    m->rearm_pending[c] = 0;
+    return 0;
+}
+
+// Queue frames on both channels at the same timestamp. Returns 0, or -1 on a send error.
+static inline int tx_mimo_send(tx_mimo_t *m, const int16_t *a, const int16_t *b, size_t frames, unsigned timeout_ms) {
+    const int16_t *src[TX_MIMO_NCH] = {a, b};
+    if (tx_mimo_check_late(m))
+        return -1;
+    for (int c = 0; c < TX_MIMO_NCH; c++) {
+        size_t done = 0;
+        while (done < frames) {
+            lms_stream_meta_t meta;
+            memset(&meta, 0, sizeof(meta));
+            meta.waitForTimestamp = true;
+            meta.timestamp = m->ts + done;
+            int n = LMS_SendStream(&m->s[c], src[c] + 2 * done, frames - done, &meta, timeout_ms);
+            if (n <= 0)
+                return -1;
+            done += (size_t)n;
+        }
+    }
+    m->ts += frames;
+    return 0;
+}
+
+// Split I_A Q_A I_B Q_B frames into the per-channel scratch and send them.
+static inline int tx_mimo_send_interleaved(tx_mimo_t *m, const int16_t *src, size_t frames, unsigned timeout_ms) {
+    while (frames > 0) {
+        size_t n = frames < m->cap ? frames : m->cap;
+        m->deint(m->a, m->b, src, n);
+        if (tx_mimo_send(m, m->a, m->b, n, timeout_ms))
+            return -1;
+        src += 4 * n;
+        frames -= n;
+    }
+    return 0;
+}
+
+static inline bool tx_mimo_active(const tx_mimo_t *m) { return m->s[0].handle != 0; }
+
+#endif
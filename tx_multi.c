@@ -0,0 +1,713 @@
+#define _GNU_SOURCE
+#include "iq_tone.h"
+#include "lime/LimeSuite.h"
+#include "limetx.h"
+#include "tx_boot.h"
+#include "tx_calcache.h"
+#include "tx_multi.h"
+#include "tx_rt.h"
+#include "tx_trim.h"
+#include "wav_mmap.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <math.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+// Several LimeSDRs from one process: every board listed in --config gets its own thread, which
+// opens, initialises and (optionally) calibrates it in parallel with the others, then waits
+// for the rest so all streams start together, and streams its input from a CPU near the board's
+// USB controller (tx_multi.h). The main thread prints per-board and aggregate throughput.
+
+#define BUF_SAMPLES 8192            // --chunk
+#define FIFO_SIZE_SAMPLES (1 << 17) // --fifo-size
+#define SEND_TIMEOUT_MS 1000
+#define STATS_MS_DEF 1000
+#define TONE_SCALE 0.70
+
+enum { INPUT_WAV, INPUT_FIFO, INPUT_TONE };
+
+// clang-format off
+#define CHECK(x) do { \
+  int __e = (x); \
+  if (__e) { fprintf(stderr,"ERROR: board %d: %s -> %s\n", b->idx, #x, LMS_GetLastErrorMessage()); goto cleanup; } \
+} while(0)
+// clang-format on
+
+static volatile int keep_running = 1;
+static void on_sigint(int s) {
+    (void)s;
+    keep_running = 0;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+#pragma pack(push, 1)
+typedef struct {
+    char id[4];
+    uint32_t size;
+} chunk_hdr_t;
+#pragma pack(pop)
+
+static bool read_exact(FILE *f, void *p, size_t n) { return fread(p, 1, n, f) == n; }
+static bool read_chunk_hdr(FILE *f, chunk_hdr_t *h) { return read_exact(f, h, sizeof(*h)); }
+static int str4eq(const char id[4], const char *s) {
+    return id[0] == s[0] && id[1] == s[1] && id[2] == s[2] && id[3] == s[3];
+}
+
+typedef struct {
+    uint32_t sample_rate;
+    uint16_t bits_per_sample;
+    uint16_t channels;
+    uint64_t data_offset;
+    uint64_t data_bytes;
+} wav_info_t;
+
+static bool parse_wav(const char *path, wav_info_t *wi, FILE **outf) {
+    memset(wi, 0, sizeof(*wi));
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "Failed to open WAV %s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    chunk_hdr_t h;
+    char wave[4] = {0};
+    if (!read_chunk_hdr(f, &h) || !str4eq(h.id, "RIFF") || !read_exact(f, wave, 4) || !str4eq(wave, "WAVE")) {
+        fprintf(stderr, "%s: not a RIFF/WAVE file\n", path);
+        fclose(f);
+        return false;
+    }
+
+    bool got_fmt = false, got_data = false;
+    uint16_t audio_format = 0;
+    while (read_chunk_hdr(f, &h)) {
+        if (str4eq(h.id, "fmt ")) {
+            uint8_t fmtbuf[64] = {0};
+            size_t toread = h.size < sizeof(fmtbuf) ? h.size : sizeof(fmtbuf);
+            if (!read_exact(f, fmtbuf, toread)) {
+                fprintf(stderr, "%s: short read in fmt\n", path);
+                fclose(f);
+                return false;
+            }
+            if (h.size > toread)
+                fseek(f, (long)(h.size - toread), SEEK_CUR);
+
+            audio_format = (uint16_t)(fmtbuf[0] | (fmtbuf[1] << 8));
+            wi->channels = (uint16_t)(fmtbuf[2] | (fmtbuf[3] << 8));
+            wi->sample_rate = (uint32_t)(fmtbuf[4] | (fmtbuf[5] << 8) | (fmtbuf[6] << 16) | (fmtbuf[7] << 24));
+            wi->bits_per_sample = (uint16_t)(fmtbuf[14] | (fmtbuf[15] << 8));
+            got_fmt = true;
+        } else if (str4eq(h.id, "data")) {
+            wi->data_offset = (uint64_t)ftell(f);
+            wi->data_bytes = h.size;
+            fseek(f, (long)h.size, SEEK_CUR);
+            got_data = true;
+        } else {
+            fseek(f, (long)h.size, SEEK_CUR);
+        }
+        if (got_fmt && got_data)
+            break;
+    }
+
+    if (!got_fmt || !got_data) {
+        fprintf(stderr, "%s: missing %s chunk\n", path, got_fmt ? "data" : "fmt ");
+        fclose(f);
+        return false;
+    }
+    if (!(audio_format == 1 || audio_format == 0xFFFE) || wi->channels != 2 || wi->bits_per_sample != 16) {
+        fprintf(stderr, "%s: need 16-bit stereo (I/Q) PCM; got format 0x%04x, %u ch, %u bits\n", path, audio_format,
+                wi->channels, wi->bits_per_sample);
+        fclose(f);
+        return false;
+    }
+    *outf = f;
+    return true;
+}
+
+typedef struct {
+    double host_sr_hz; // --sample-rate, 0 = per board
+    int oversample;
+    int chunk;
+    int fifo_size;
+    bool keep_going;
+    const char *cal_cache;
+    int cal_max_age_s;
+    const char *wave_cache; // tone: periods, NULL = render every start
+    tx_rt_t rt; // cpu unused: every board has its own
+    pthread_mutex_t cal_lock;
+    // Start gate: board threads check in after bring-up and wait for main to open it
+    pthread_mutex_t gate_lock;
+    pthread_cond_t gate_cv;
+    int arrived;
+    bool go;
+    atomic_int failed; // boards that didn't come up
+} multi_opts_t;
+
+static multi_opts_t G;
+
+typedef struct {
+    int idx;
+    tx_multi_cfg_t cfg;
+    tx_multi_loc_t loc;
+    int cpu;
+    lms_info_str_t info; // LMS_GetDeviceList entry
+    double sr_hz;
+
+    int kind;
+    FILE *wf;
+    wav_info_t wi;
+    wav_map_t wm;
+    int fd; // INPUT_FIFO
+    int16_t *buf;
+    iq_tone_src_t tone;
+
+    lms_device_t *dev;
+    lms_stream_t txs;
+    tx_boot_t boot;
+    double init_ms;
+
+    pthread_t th;
+    bool ok;              // came up and streamed; false once it failed
+    atomic_bool running;  // in the stream loop
+    atomic_bool finished; // the thread is done with the board
+
+    // Written by the board thread, read by the stats loop
+    _Atomic uint64_t frames, sends, send_max_ns;
+    atomic_uint underrun, fifo_fill; // underrun: running total (LMS_GetStreamStatus reports deltas)
+    uint64_t t_start_ns, t_end_ns;
+} board_t;
+
+// LMS_Calibrate or the loopback trim with the shared calibration cache. txcal_restore/store keep
+// their scratch in static storage and rewrite one file, so they run one board at a time; the
+// calibration itself doesn't.
+static int board_calibrate(board_t *b, limetx_regs_t *r) {
+    const tx_multi_cfg_t *c = &b->cfg;
+    txcal_key_t k;
+    if (txcal_key_init(&k, b->dev, c->ch, c->lo_hz, c->nco_hz, c->lpf_hz))
+        return -1;
+    pthread_mutex_lock(&G.cal_lock);
+    const bool hit = G.cal_cache && txcal_restore(r, &k, G.cal_cache, G.cal_max_age_s);
+    pthread_mutex_unlock(&G.cal_lock);
+    if (hit)
+        return 0;
+
+    int rc;
+    if (c->cal == TX_MULTI_CAL_TRIM) {
+        tx_trim_t t;
+        rc = tx_trim_run(&t, r, c->ch, c->nco_hz, c->down);
+        if (!rc)
+            tx_trim_print(&t);
+    } else {
+        rc = LMS_Calibrate(b->dev, LMS_CH_TX, c->ch, c->lpf_hz, 0);
+        limetx_regs_invalidate(r);
+    }
+    if (rc || !G.cal_cache)
+        return rc;
+    pthread_mutex_lock(&G.cal_lock);
+    txcal_store(r, &k, G.cal_cache);
+    pthread_mutex_unlock(&G.cal_lock);
+    return 0;
+}
+
+// Open, configure and set up the stream; the part every board does at the same time.
+static int board_init(board_t *b) {
+    const tx_multi_cfg_t *c = &b->cfg;
+    limetx_regs_t regs;
+    tx_boot_begin(&b->boot, c->ch);
+    if (LMS_Open(&b->dev, b->info, NULL)) {
+        fprintf(stderr, "ERROR: board %d: LMS_Open failed: %s\n", b->idx, LMS_GetLastErrorMessage());
+        b->dev = NULL;
+        return -1;
+    }
+    tx_boot_attach(&b->boot, b->dev);
+    limetx_regs_init(&regs, b->dev);
+
+    CHECK(tx_boot_init_device(&b->boot, NULL));
+    CHECK(LMS_EnableChannel(b->dev, LMS_CH_TX, c->ch, true));
+    CHECK(tx_boot_sample_rate(&b->boot, b->sr_hz, G.oversample));
+    CHECK(tx_boot_lpf_bw(&b->boot, c->lpf_hz));
+    CHECK(tx_boot_gain(&b->boot, c->gain_db));
+    CHECK(tx_boot_lo(&b->boot, c->lo_hz));
+    {
+        double freqs[16] = {0};
+        freqs[0] = c->nco_hz;
+        CHECK(tx_boot_nco(&b->boot, freqs, 0, c->down));
+    }
+    if (c->cal != TX_MULTI_CAL_OFF) {
+        CHECK(board_calibrate(b, &regs));
+        tx_boot_mark(&b->boot, "calibrate");
+    }
+
+    b->txs.channel = (uint32_t)c->ch;
+    b->txs.isTx = true;
+    b->txs.fifoSize = (uint32_t)G.fifo_size;
+    b->txs.dataFmt = LMS_FMT_I16;
+    b->txs.linkFmt = LMS_LINK_FMT_I16;
+    CHECK(LMS_SetupStream(b->dev, &b->txs));
+    tx_boot_mark(&b->boot, "stream");
+
+    if (b->kind == INPUT_FIFO) {
+        // Blocks until the writer connects; the streams start once every input is ready
+        printf("[%d] opening FIFO %s (blocking until writer connects)...\n", b->idx, c->input + 5);
+        b->fd = open(c->input + 5, O_RDONLY);
+        if (b->fd < 0) {
+            fprintf(stderr, "ERROR: board %d: open %s: %s\n", b->idx, c->input + 5, strerror(errno));
+            goto cleanup;
+        }
+    }
+    b->init_ms = tx_boot_ms(&b->boot.t0, &b->boot.t_last);
+    return 0;
+cleanup:
+    return -1;
+}
+
+// Up to G.chunk frames from a FIFO; fewer only at EOF. NULL when nothing was left.
+static const int16_t *fifo_next(board_t *b, size_t *frames, bool *eof) {
+    const size_t want = (size_t)G.chunk * 2 * sizeof(int16_t);
+    size_t have = 0;
+    while (have < want && keep_running) {
+        ssize_t got = read(b->fd, (uint8_t *)b->buf + have, want - have);
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got <= 0) {
+            if (got < 0)
+                fprintf(stderr, "[%d] FIFO read: %s\n", b->idx, strerror(errno));
+            *eof = true;
+            break;
+        }
+        have += (size_t)got;
+    }
+    *frames = have / (2 * sizeof(int16_t)); // a torn frame at EOF is dropped
+    return *frames ? b->buf : NULL;
+}
+
+static void board_stream(board_t *b, const tx_rt_t *rt_base) {
+    tx_rt_t rt = *rt_base;
+    const uint64_t status_ns = 250000000ull;
+    uint64_t last_status = 0;
+
+    if (LMS_StartStream(&b->txs)) {
+        fprintf(stderr, "ERROR: board %d: LMS_StartStream -> %s\n", b->idx, LMS_GetLastErrorMessage());
+        b->ok = false;
+        return;
+    }
+    // After StartStream, so LimeSuite's own stream threads keep the process mask (tx_rt.h)
+    if (rt.enabled) {
+        rt.cpu = b->cpu;
+        rt.pinned = b->cpu >= 0;
+        tx_rt_enter(&rt);
+    } else if (b->cpu >= 0) {
+        int e = tx_rt_pin(b->cpu);
+        if (e)
+            fprintf(stderr, "WARN: board %d: pinning stream thread to CPU %d: %s\n", b->idx, b->cpu, strerror(e));
+    }
+
+    b->t_start_ns = now_ns();
+    atomic_store(&b->running, true);
+    while (keep_running) {
+        const int16_t *src = NULL;
+        size_t frames = 0;
+        bool eof = false;
+        if (b->kind == INPUT_WAV) {
+            src = wav_map_next(&b->wm, &frames, &eof);
+        } else if (b->kind == INPUT_FIFO) {
+            src = fifo_next(b, &frames, &eof);
+        } else {
+            src = iq_tone_src_next(&b->tone);
+            frames = (size_t)G.chunk;
+        }
+
+        if (frames > 0) {
+            lms_stream_meta_t meta;
+            memset(&meta, 0, sizeof(meta));
+            const uint64_t t0 = now_ns();
+            if (LMS_SendStream(&b->txs, src, frames, &meta, SEND_TIMEOUT_MS) < 0) {
+                fprintf(stderr, "ERROR: board %d: LMS_SendStream: %s\n", b->idx, LMS_GetLastErrorMessage());
+                b->ok = false;
+                break;
+            }
+            const uint64_t t1 = now_ns();
+            atomic_fetch_add_explicit(&b->frames, frames, memory_order_relaxed);
+            atomic_fetch_add_explicit(&b->sends, 1, memory_order_relaxed);
+            if (t1 - t0 > atomic_load_explicit(&b->send_max_ns, memory_order_relaxed))
+                atomic_store_explicit(&b->send_max_ns, t1 - t0, memory_order_relaxed);
+            if (t1 - last_status >= status_ns) {
+                lms_stream_status_t st;
+                memset(&st, 0, sizeof(st));
+                if (!LMS_GetStreamStatus(&b->txs, &st)) {
+                    atomic_fetch_add_explicit(&b->underrun, st.underrun, memory_order_relaxed);
+                    atomic_store_explicit(&b->fifo_fill, st.fifoFilledCount, memory_order_relaxed);
+                }
+                last_status = t1;
+            }
+        }
+        if (eof)
+            break;
+    }
+    b->t_end_ns = now_ns();
+
+    lms_stream_status_t st;
+    memset(&st, 0, sizeof(st));
+    if (!LMS_GetStreamStatus(&b->txs, &st))
+        atomic_fetch_add(&b->underrun, st.underrun);
+    atomic_store(&b->running, false);
+}
+
+static void *board_thread(void *arg) {
+    board_t *b = (board_t *)arg;
+    b->ok = board_init(b) == 0;
+    if (!b->ok)
+        atomic_fetch_add(&G.failed, 1);
+
+    pthread_mutex_lock(&G.gate_lock);
+    G.arrived++;
+    pthread_cond_broadcast(&G.gate_cv);
+    while (!G.go)
+        pthread_cond_wait(&G.gate_cv, &G.gate_lock);
+    pthread_mutex_unlock(&G.gate_lock);
+    if (b->ok && (G.keep_going || atomic_load(&G.failed) == 0))
+        board_stream(b, &G.rt);
+    if (!b->ok && !G.keep_going)
+        keep_running = 0;
+
+    if (b->dev) {
+        if (b->txs.handle) {
+            LMS_StopStream(&b->txs);
+            LMS_DestroyStream(b->dev, &b->txs);
+        }
+        LMS_EnableChannel(b->dev, LMS_CH_TX, b->cfg.ch, false);
+        LMS_Close(b->dev);
+        b->dev = NULL;
+    }
+    atomic_store(&b->finished, true);
+    return NULL;
+}
+
+// Input that only needs the file system: done before any board thread starts, so a bad path
+// fails the run before the (slow) bring-up.
+static int board_prepare(board_t *b) {
+    const tx_multi_cfg_t *c = &b->cfg;
+    b->fd = -1;
+    b->sr_hz = c->sr_hz > 0 ? c->sr_hz : G.host_sr_hz;
+    if (!strncmp(c->input, "fifo:", 5)) {
+        b->kind = INPUT_FIFO;
+    } else if (!strncmp(c->input, "tone:", 5)) {
+        b->kind = INPUT_TONE;
+    } else {
+        b->kind = INPUT_WAV;
+        if (!parse_wav(c->input, &b->wi, &b->wf))
+            return -1;
+        if (b->sr_hz <= 0)
+            b->sr_hz = b->wi.sample_rate;
+        else if (fabs(b->sr_hz - b->wi.sample_rate) > 0.5)
+            fprintf(stderr, "WARN: board %d: %s is %u Hz, played at %.0f Hz\n", b->idx, c->input, b->wi.sample_rate,
+                    b->sr_hz);
+        if (wav_map_open(&b->wm, fileno(b->wf), b->wi.data_offset, b->wi.data_bytes, 2 * sizeof(int16_t),
+                         (size_t)G.chunk, c->loop))
+            return -1;
+    }
+    if (b->sr_hz <= 0) {
+        fprintf(stderr, "config:%d: %s needs sr= or --sample-rate\n", c->line, c->input);
+        return -1;
+    }
+    if (b->kind == INPUT_TONE) {
+        iq_tone_t t;
+        if (!iq_tone_parse(c->input + 5, limetx_parse_hz, &t) ||
+            iq_tone_src_init_cached(&b->tone, &t, 1, b->sr_hz, TONE_SCALE, (size_t)G.chunk, G.wave_cache)) {
+            fprintf(stderr, "config:%d: bad %s\n", c->line, c->input);
+            return -1;
+        }
+    } else if (b->kind == INPUT_FIFO) {
+        b->buf = (int16_t *)tx_rt_alloc(&G.rt, (size_t)G.chunk * 2 * sizeof(int16_t));
+        if (!b->buf) {
+            fprintf(stderr, "malloc failed\n");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void board_release(board_t *b) {
+    wav_map_close(&b->wm);
+    if (b->wf)
+        fclose(b->wf);
+    if (b->fd >= 0)
+        close(b->fd);
+    iq_tone_src_free(&b->tone);
+    free(b->buf);
+}
+
+// --rt: every other thread off the stream CPUs, memory locked (tx_rt_begin for several CPUs).
+// No MCL_FUTURE: the WAV mappings would be faulted in and pinned whole.
+static void rt_begin(tx_rt_t *rt, const board_t *bs, int n) {
+    cpu_set_t rest;
+    CPU_ZERO(&rest);
+    if (sched_getaffinity(0, sizeof(rest), &rest) == 0) {
+        for (int i = 0; i < n; i++)
+            if (bs[i].cpu >= 0)
+                CPU_CLR(bs[i].cpu, &rest);
+        if (CPU_COUNT(&rest) == 0)
+            fprintf(stderr, "WARN: rt: no CPU left without a stream, other threads share them\n");
+        else if (sched_setaffinity(0, sizeof(rest), &rest))
+            fprintf(stderr, "WARN: rt: moving other threads off the stream CPUs: %s\n", strerror(errno));
+        else
+            rt->isolated = true;
+    }
+    if (mlockall(MCL_CURRENT))
+        fprintf(stderr, "WARN: rt: mlockall: %s (needs CAP_IPC_LOCK or a larger `ulimit -l`), page faults possible\n",
+                strerror(errno));
+    else
+        rt->locked = true;
+}
+
+static void print_placement(const board_t *b) {
+    char local[128] = "";
+    const tx_multi_loc_t *l = &b->loc;
+    for (int c = 0, first = 1; c < CPU_SETSIZE; c++) {
+        if (!CPU_ISSET(c, &l->local) || (c > 0 && CPU_ISSET(c - 1, &l->local)))
+            continue;
+        int e = c;
+        while (e + 1 < CPU_SETSIZE && CPU_ISSET(e + 1, &l->local))
+            e++;
+        const size_t len = strlen(local);
+        snprintf(local + len, sizeof(local) - len, e > c ? "%s%d-%d" : "%s%d", first ? "" : ",", c, e);
+        first = 0;
+    }
+    printf("[%d] serial %" PRIx64 ": ", b->idx, b->cfg.serial);
+    if (!l->usb[0])
+        printf("not in sysfs");
+    else if (!l->pci[0])
+        printf("usb %s", l->usb);
+    else
+        printf("usb %s on %s (local CPUs %s, irq %d%s%d)", l->usb, l->pci, local[0] ? local : "?", l->irq,
+               l->irq_cpu >= 0 ? " on CPU " : "", l->irq_cpu);
+    if (b->cpu >= 0)
+        printf(" -> stream CPU %d%s\n", b->cpu, b->cfg.cpu >= 0 ? " (cpu=)" : "");
+    else
+        printf(" -> not pinned\n");
+}
+
+static void print_init(const board_t *b) {
+    printf("[%d] init %.1f ms:", b->idx, b->init_ms);
+    for (int i = 0; i < b->boot.n; i++)
+        printf(" %s %.1f%s", b->boot.name[i], b->boot.ms[i], i + 1 < b->boot.n ? "," : "");
+    printf("\n");
+}
+
+int main(int argc, char **argv) {
+    const char *CONFIG = NULL;
+    double SECONDS = 0; // 0 = until Ctrl+C or every input ends
+    int STATS_MS = STATS_MS_DEF;
+    memset(&G, 0, sizeof(G));
+    G.oversample = 32;
+    G.chunk = BUF_SAMPLES;
+    G.fifo_size = FIFO_SIZE_SAMPLES;
+    G.cal_max_age_s = TXCAL_MAX_AGE_DEF_S;
+    char CAL_CACHE_BUF[TXCAL_PATH_MAX];
+    txcal_default_path(CAL_CACHE_BUF, sizeof(CAL_CACHE_BUF));
+    G.cal_cache = CAL_CACHE_BUF;
+    char WAVE_CACHE_BUF[IQ_WFC_PATH_MAX];
+    iq_wfc_default_dir(WAVE_CACHE_BUF, sizeof(WAVE_CACHE_BUF));
+    G.wave_cache = WAVE_CACHE_BUF;
+    tx_rt_init(&G.rt);
+
+    // clang-format off
+    for (int i=1; i<argc; i++){
+        const char* a = argv[i];
+        #define NEEDVAL() do{ if (i+1>=argc){ fprintf(stderr,"missing value for %s\n", a); return 1; } }while(0)
+
+        if (!strcmp(a,"--config")){ NEEDVAL(); CONFIG = argv[++i]; continue; }
+        if (!strcmp(a,"--sample-rate")){ NEEDVAL(); if(!limetx_parse_hz(argv[++i], &G.host_sr_hz) || G.host_sr_hz<=0) { fprintf(stderr,"bad --sample-rate\n"); return 1; } continue; }
+        if (!strcmp(a,"--oversample")){ NEEDVAL(); G.oversample = (int)strtol(argv[++i], NULL, 0); if (G.oversample<1){ fprintf(stderr,"bad --oversample\n"); return 1; } continue; }
+        if (!strcmp(a,"--chunk")){ NEEDVAL(); G.chunk = (int)strtol(argv[++i], NULL, 0); if (G.chunk<64 || G.chunk>(1<<20)){ fprintf(stderr,"bad --chunk (64..%d)\n", 1<<20); return 1; } continue; }
+        if (!strcmp(a,"--fifo-size")){ NEEDVAL(); G.fifo_size = (int)strtol(argv[++i], NULL, 0); if (G.fifo_size<4096){ fprintf(stderr,"bad --fifo-size\n"); return 1; } continue; }
+        if (!strcmp(a,"--seconds")){ NEEDVAL(); SECONDS = strtod(argv[++i], NULL); if (SECONDS<0){ fprintf(stderr,"bad --seconds\n"); return 1; } continue; }
+        if (!strcmp(a,"--stats-ms")){ NEEDVAL(); STATS_MS = (int)strtol(argv[++i], NULL, 0); if (STATS_MS<0){ fprintf(stderr,"bad --stats-ms\n"); return 1; } continue; }
+        if (!strcmp(a,"--keep-going")){ G.keep_going = true; if (i+1 < argc){ bool v=false; if (limetx_parse_bool(argv[i+1], &v)){ G.keep_going = v; i++; } } continue; }
+        if (!strcmp(a,"--rt")){ G.rt.enabled = true; if (i+1 < argc){ bool v=false; if (limetx_parse_bool(argv[i+1], &v)){ G.rt.enabled = v; i++; } } continue; }
+        if (!strcmp(a,"--rt-prio")){ NEEDVAL(); G.rt.prio = (int)strtol(argv[++i], NULL, 0); if (G.rt.prio<1 || G.rt.prio>99){ fprintf(stderr,"bad --rt-prio (1..99)\n"); return 1; } continue; }
+        if (!strcmp(a,"--cal-cache")){ NEEDVAL(); G.cal_cache = argv[++i]; if (!strcmp(G.cal_cache,"off")) G.cal_cache = NULL; continue; }
+        if (!strcmp(a,"--cal-cache-max-age")){ NEEDVAL(); G.cal_max_age_s = (int)strtol(argv[++i], NULL, 0); if (G.cal_max_age_s<0){ fprintf(stderr,"bad --cal-cache-max-age\n"); return 1; } continue; }
+        if (!strcmp(a,"--wave-cache")){ NEEDVAL(); G.wave_cache = argv[++i]; if (!strcmp(G.wave_cache,"off")) G.wave_cache = NULL; continue; }
+
+        fprintf(stderr,"unknown option: %s\n", a);
+        return 1;
+    }
+    if (!CONFIG){ fprintf(stderr,"missing --config <boards.conf>\n"); return 1; }
+    // clang-format on
+
+    static tx_multi_cfg_t cfg[TX_MULTI_MAX];
+    static board_t bs[TX_MULTI_MAX];
+    const int n = tx_multi_load(CONFIG, cfg, TX_MULTI_MAX);
+    if (n < 0)
+        return 1;
+
+    int rc = 1, started = 0;
+    pthread_mutex_init(&G.cal_lock, NULL);
+    pthread_mutex_init(&G.gate_lock, NULL);
+    pthread_cond_init(&G.gate_cv, NULL);
+    for (int i = 0; i < n; i++) {
+        bs[i].idx = i;
+        bs[i].cfg = cfg[i];
+        bs[i].fd = -1;
+    }
+    for (int i = 0; i < n; i++)
+        if (board_prepare(&bs[i]))
+            goto done;
+
+    // Every board listed must be attached, before any of them is touched
+    lms_info_str_t list[TX_MULTI_MAX * 2];
+    const int found = LMS_GetDeviceList(list);
+    for (int i = 0; i < n; i++) {
+        int hit = -1;
+        for (int j = 0; j < found && j < TX_MULTI_MAX * 2 && hit < 0; j++) {
+            const char *s = strstr(list[j], "serial=");
+            if (s && strtoull(s + 7, NULL, 16) == bs[i].cfg.serial)
+                hit = j;
+        }
+        if (hit < 0) {
+            fprintf(stderr, "config:%d: no LimeSDR with serial %" PRIx64 " (%d attached)\n", bs[i].cfg.line,
+                    bs[i].cfg.serial, found < 0 ? 0 : found);
+            goto done;
+        }
+        memcpy(bs[i].info, list[hit], sizeof(lms_info_str_t));
+    }
+
+    {
+        tx_multi_loc_t loc[TX_MULTI_MAX];
+        int cpus[TX_MULTI_MAX];
+        for (int i = 0; i < n; i++) {
+            tx_multi_locate(bs[i].cfg.serial, &loc[i]);
+            bs[i].loc = loc[i];
+            cpus[i] = bs[i].cfg.cpu;
+        }
+        if (tx_multi_plan_cpus(loc, n, cpus))
+            goto done;
+        for (int i = 0; i < n; i++) {
+            bs[i].cpu = cpus[i];
+            print_placement(&bs[i]);
+        }
+    }
+    if (G.rt.enabled)
+        rt_begin(&G.rt, bs, n);
+
+    signal(SIGINT, on_sigint);
+    const uint64_t t_init = now_ns();
+    for (; started < n; started++) {
+        if (pthread_create(&bs[started].th, NULL, board_thread, &bs[started])) {
+            fprintf(stderr, "failed to start the thread for board %d\n", started);
+            atomic_fetch_add(&G.failed, n - started);
+            break;
+        }
+    }
+    // Every stream starts once the last board is up (or has failed)
+    pthread_mutex_lock(&G.gate_lock);
+    while (G.arrived < started)
+        pthread_cond_wait(&G.gate_cv, &G.gate_lock);
+    G.go = true;
+    pthread_cond_broadcast(&G.gate_cv);
+    pthread_mutex_unlock(&G.gate_lock);
+
+    const double init_wall_ms = (double)(now_ns() - t_init) / 1e6;
+    double init_sum_ms = 0;
+    for (int i = 0; i < started; i++) {
+        if (!bs[i].ok)
+            continue;
+        print_init(&bs[i]);
+        init_sum_ms += bs[i].init_ms;
+    }
+    const int failed = atomic_load(&G.failed);
+    printf("init: %d of %d boards in %.1f ms (%.1f ms one after another)\n", n - failed, n, init_wall_ms,
+           init_sum_ms);
+    if (failed && !G.keep_going) {
+        fprintf(stderr, "%d board(s) failed to come up, stopping (--keep-going streams the rest)\n", failed);
+        keep_running = 0;
+    } else {
+        printf("Streaming %d boards (Ctrl+C to stop)\n", n - failed);
+    }
+
+    uint64_t frames_prev[TX_MULTI_MAX] = {0}, t_prev = now_ns();
+    const uint64_t t_run = t_prev;
+    for (bool any = true; keep_running && any;) {
+        struct timespec ts = {0, 20000000}; // 20 ms: notice the end of the inputs quickly
+        nanosleep(&ts, NULL);
+        const uint64_t t = now_ns();
+        any = false;
+        for (int i = 0; i < started; i++)
+            any |= !atomic_load(&bs[i].finished);
+        if (SECONDS > 0 && (double)(t - t_run) / 1e9 >= SECONDS)
+            keep_running = 0;
+        if (!STATS_MS || t - t_prev < (uint64_t)STATS_MS * 1000000ull)
+            continue;
+
+        const double dt = (double)(t - t_prev) / 1e9;
+        double total = 0;
+        unsigned underruns = 0;
+        printf("stats %.1f s:\n", (double)(t - t_run) / 1e9);
+        for (int i = 0; i < started; i++) {
+            board_t *b = &bs[i];
+            if (!atomic_load(&b->running))
+                continue;
+            const uint64_t f = atomic_load_explicit(&b->frames, memory_order_relaxed);
+            const double msps = (double)(f - frames_prev[i]) / dt / 1e6;
+            const unsigned ur = atomic_load_explicit(&b->underrun, memory_order_relaxed);
+            frames_prev[i] = f;
+            total += msps;
+            underruns += ur;
+            printf("  [%d] %" PRIx64 ": %7.3f Msps, fifo %u/%d, underruns %u, max send %.2f ms\n", i, b->cfg.serial,
+                   msps, atomic_load_explicit(&b->fifo_fill, memory_order_relaxed), G.fifo_size, ur,
+                   (double)atomic_exchange_explicit(&b->send_max_ns, 0, memory_order_relaxed) / 1e6);
+        }
+        printf("  total: %7.3f Msps, underruns %u\n", total, underruns);
+        t_prev = t;
+    }
+    keep_running = 0;
+    rc = 0;
+
+done:
+    for (int i = 0; i < started; i++)
+        pthread_join(bs[i].th, NULL);
+    if (started) {
+        double total = 0;
+        uint64_t frames = 0, underruns = 0;
+        printf("summary:\n");
+        for (int i = 0; i < started; i++) {
+            const board_t *b = &bs[i];
+            if (!b->t_start_ns) {
+                printf("  [%d] %" PRIx64 ": %s\n", i, b->cfg.serial, b->ok ? "not started" : "failed");
+                rc = 1;
+                continue;
+            }
+            const double s = (double)(b->t_end_ns - b->t_start_ns) / 1e9;
+            const double msps = s > 0 ? (double)b->frames / s / 1e6 : 0.0;
+            printf("  [%d] %" PRIx64 ": %" PRIu64 " frames in %.2f s (%.3f Msps of %.3f), %" PRIu64
+                   " sends, underruns %u%s\n",
+                   i, b->cfg.serial, (uint64_t)b->frames, s, msps, b->sr_hz / 1e6, (uint64_t)b->sends,
+                   (unsigned)b->underrun, b->ok ? "" : ", failed");
+            total += msps;
+            frames += b->frames;
+            underruns += b->underrun;
+            if (!b->ok)
+                rc = 1;
+        }
+        printf("  total: %" PRIu64 " frames, %.3f Msps, underruns %" PRIu64 "\n", frames, total, underruns);
+    }
+    for (int i = 0; i < n; i++)
+        board_release(&bs[i]);
+    return rc;
+}
@@ -0,0 +1,347 @@
+#ifndef TX_MULTI_H
+#define TX_MULTI_H
+
+// Board list and USB locality for tx_multi (several LimeSDRs from one process).
+//
+// The config file has one board per line, whitespace-separated key=value pairs, '#' to the end of
+// the line is a comment:
+//   serial=1d588fd5fe8f32 lo=433.92M nco=1M gain=40 input=a.wav loop=1
+//   serial=0009060b00471b22 lo=868.3M nco=500k down=0 input=fifo:/tmp/b.iq cpu=5 cal=trim
+// serial (hex, as LMS_GetDeviceList prints it), lo and input are required. input is a 16-bit
+// stereo WAV, fifo:<path> (raw interleaved int16 I/Q, as tx_pipe reads it) or
+// tone:<freq>[:amp_dB] (iq_tone). Everything else defaults to the tx_wav values.
+//
+// Each stream thread is pinned to a CPU near the board's USB host controller: the board is
+// found under /sys/bus/usb/devices by its serial, the sysfs path is walked up to the PCI function
+// (local_cpulist is the controller's NUMA node) and the controller's interrupt is looked up in
+// /proc/irq. Boards get distinct node-local CPUs, avoiding the one taking the controller's
+// interrupt while there are others; when the node runs out they spill to the rest of the
+// process's CPUs and share only when every CPU already has a stream. cpu= overrides the choice.
+//
+// Needs _GNU_SOURCE before the first #include (CPU_SET, realpath).
+
+#include "limetx.h"
+#include <ctype.h>
+#include <dirent.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TX_MULTI_MAX 16 // boards
+#define TX_MULTI_INPUT_MAX 256
+#define TX_MULTI_SYSFS_USB "/sys/bus/usb/devices"
+
+enum { TX_MULTI_CAL_OFF, TX_MULTI_CAL_LMS, TX_MULTI_CAL_TRIM };
+
+typedef struct {
+    uint64_t serial;
+    int ch;
+    double sr_hz; // 0 = --sample-rate, else the WAV rate
+    double lo_hz, nco_hz, lpf_hz;
+    bool down; // NCO downconvert
+    int gain_db;
+    char input[TX_MULTI_INPUT_MAX];
+    bool loop;
+    int cpu; // stream CPU, -1 = from the USB locality
+    int cal;
+    int line;
+} tx_multi_cfg_t;
+
+typedef struct {
+    char usb[32];    // sysfs bus id ("2-1.3"), empty when the board wasn't found
+    char pci[32];    // host controller PCI function
+    cpu_set_t local; // the controller's NUMA-local CPUs, empty when unknown
+    int irq;         // controller interrupt, -1 when unknown
+    int irq_cpu;     // the one CPU it is delivered to, -1 when unknown or spread
+} tx_multi_loc_t;
+
+static inline const char *tx_multi_cal_name(int cal) {
+    return cal == TX_MULTI_CAL_TRIM ? "trim" : cal == TX_MULTI_CAL_LMS ? "lms" : "off";
+}
+
+// "0-3,8,10-11" -> set. Returns false on a malformed list.
+static inline bool tx_multi_parse_cpulist(const char *s, cpu_set_t *set) {
+    CPU_ZERO(set);
+    while (*s && !isspace((unsigned char)*s)) {
+        char *end = NULL;
+        long a = strtol(s, &end, 10), b = a;
+        if (end == s || a < 0)
+            return false;
+        if (*end == '-') {
+            s = end + 1;
+            b = strtol(s, &end, 10);
+            if (end == s || b < a)
+                return false;
+        }
+        for (long c = a; c <= b && c < CPU_SETSIZE; c++)
+            CPU_SET((int)c, set);
+        s = *end == ',' ? end + 1 : end;
+    }
+    return true;
+}
+
+static inline bool tx_multi_read_line(const char *path, char *out, size_t n) {
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return false;
+    const bool ok = fgets(out, (int)n, f) != NULL;
+    fclose(f);
+    if (ok)
+        out[strcspn(out, "\r\n")] = '\0';
+    return ok;
+}
+
+static inline int tx_multi_cpu_last(const cpu_set_t *set) {
+    for (int c = CPU_SETSIZE - 1; c >= 0; c--)
+        if (CPU_ISSET(c, set))
+            return c;
+    return -1;
+}
+
+// The controller interrupt: the first MSI vector when there are any, the legacy line otherwise.
+static inline int tx_multi_pci_irq(const char *pci_dir) {
+    char path[PATH_MAX + 32], line[32];
+    snprintf(path, sizeof(path), "%s/msi_irqs", pci_dir);
+    int irq = -1;
+    DIR *d = opendir(path);
+    if (d) {
+        for (struct dirent *e; (e = readdir(d));)
+            if (isdigit((unsigned char)e->d_name[0]) && (irq < 0 || atoi(e->d_name) < irq))
+                irq = atoi(e->d_name);
+        closedir(d);
+    }
+    snprintf(path, sizeof(path), "%s/irq", pci_dir);
+    if (irq < 0 && tx_multi_read_line(path, line, sizeof(line)) && atoi(line) > 0)
+        irq = atoi(line);
+    return irq;
+}
+
+// Find the board with this serial under sysfs. Returns false when it isn't there (a non-USB
+// board, no sysfs, or the mock); loc is then empty and the board is placed like any other.
+static inline bool tx_multi_locate(uint64_t serial, tx_multi_loc_t *loc) {
+    memset(loc, 0, sizeof(*loc));
+    CPU_ZERO(&loc->local);
+    loc->irq = loc->irq_cpu = -1;
+
+    DIR *d = opendir(TX_MULTI_SYSFS_USB);
+    if (!d)
+        return false;
+    char path[PATH_MAX + 32], line[128];
+    for (struct dirent *e; (e = readdir(d));) {
+        if (e->d_name[0] == '.' || strchr(e->d_name, ':')) // interfaces have no serial
+            continue;
+        snprintf(path, sizeof(path), TX_MULTI_SYSFS_USB "/%s/serial", e->d_name);
+        char *end = NULL;
+        if (!tx_multi_read_line(path, line, sizeof(line)) || strtoull(line, &end, 16) != serial || end == line ||
+            *end)
+            continue;
+        snprintf(loc->usb, sizeof(loc->usb), "%.31s", e->d_name);
+        break;
+    }
+    closedir(d);
+    if (!loc->usb[0])
+        return false;
+
+    char dev[PATH_MAX];
+    snprintf(path, sizeof(path), TX_MULTI_SYSFS_USB "/%s", loc->usb);
+    if (!realpath(path, dev))
+        return true;
+    // .../pci0000:00/0000:00:14.0/usb2/2-1: the first ancestor with local_cpulist is the controller
+    for (char *slash; (slash = strrchr(dev, '/')) && slash != dev; *slash = '\0') {
+        snprintf(path, sizeof(path), "%s/local_cpulist", dev);
+        if (!tx_multi_read_line(path, line, sizeof(line)))
+            continue;
+        snprintf(loc->pci, sizeof(loc->pci), "%s", strrchr(dev, '/') + 1);
+        if (!tx_multi_parse_cpulist(line, &loc->local))
+            CPU_ZERO(&loc->local);
+        loc->irq = tx_multi_pci_irq(dev);
+        break;
+    }
+    if (loc->irq > 0) {
+        cpu_set_t eff;
+        snprintf(path, sizeof(path), "/proc/irq/%d/effective_affinity_list", loc->irq);
+        if ((tx_multi_read_line(path, line, sizeof(line)) ||
+             (snprintf(path, sizeof(path), "/proc/irq/%d/smp_affinity_list", loc->irq),
+              tx_multi_read_line(path, line, sizeof(line)))) &&
+            tx_multi_parse_cpulist(line, &eff) && CPU_COUNT(&eff) == 1)
+            loc->irq_cpu = tx_multi_cpu_last(&eff);
+    }
+    return true;
+}
+
+// Stream CPU for every board without cpu=, in config order. cpus[] holds cfg cpu= on entry.
+// Tiers, best first: node-local and free of streams and controller interrupts, node-local and
+// free of streams, any allowed CPU free of both, any free of streams, then shared (warned).
+// Returns -1 when a cpu= is outside the process's affinity.
+static inline int tx_multi_plan_cpus(const tx_multi_loc_t *loc, int n, int *cpus) {
+    cpu_set_t allowed, used, irqs;
+    CPU_ZERO(&allowed);
+    CPU_ZERO(&used);
+    CPU_ZERO(&irqs);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed)) {
+        fprintf(stderr, "WARN: sched_getaffinity failed, stream threads not pinned\n");
+        for (int i = 0; i < n; i++)
+            cpus[i] = -1;
+        return 0;
+    }
+    for (int i = 0; i < n; i++) {
+        if (loc[i].irq_cpu >= 0)
+            CPU_SET(loc[i].irq_cpu, &irqs);
+        if (cpus[i] < 0)
+            continue;
+        if (cpus[i] >= CPU_SETSIZE || !CPU_ISSET(cpus[i], &allowed)) {
+            fprintf(stderr, "CPU %d is not available to this process\n", cpus[i]);
+            return -1;
+        }
+        CPU_SET(cpus[i], &used);
+    }
+    for (int i = 0; i < n; i++) {
+        if (cpus[i] >= 0)
+            continue;
+        // a minus b is (a ^ b) & a
+        cpu_set_t tier[5], local;
+        CPU_AND(&local, &loc[i].local, &allowed);
+        CPU_XOR(&tier[1], &local, &used);
+        CPU_AND(&tier[1], &tier[1], &local);
+        CPU_XOR(&tier[0], &tier[1], &irqs);
+        CPU_AND(&tier[0], &tier[0], &tier[1]);
+        CPU_XOR(&tier[3], &allowed, &used);
+        CPU_AND(&tier[3], &tier[3], &allowed);
+        CPU_XOR(&tier[2], &tier[3], &irqs);
+        CPU_AND(&tier[2], &tier[2], &tier[3]);
+        tier[4] = allowed;
+        int t = 0;
+        while (t < 4 && CPU_COUNT(&tier[t]) == 0)
+            t++;
+        cpus[i] = tx_multi_cpu_last(&tier[t]);
+        if (t == 4) {
+            // Every CPU already has a stream: share them round-robin
+            int k = i % CPU_COUNT(&allowed);
+            for (int c = 0; c < CPU_SETSIZE && k >= 0; c++)
+                if (CPU_ISSET(c, &allowed) && k-- == 0)
+                    cpus[i] = c;
+            fprintf(stderr, "WARN: more boards than CPUs, board %d shares CPU %d\n", i, cpus[i]);
+        } else if (t >= 2 && CPU_COUNT(&loc[i].local)) {
+            fprintf(stderr, "WARN: no free CPU local to board %d's USB controller, using CPU %d\n", i, cpus[i]);
+        }
+        CPU_SET(cpus[i], &used);
+    }
+    return 0;
+}
+
+// One config line. Returns 0, 1 for a blank/comment line, -1 on an error (printed).
+static inline int tx_multi_parse_line(char *s, int line, tx_multi_cfg_t *c) {
+    char *hash = strchr(s, '#');
+    if (hash)
+        *hash = '\0';
+    memset(c, 0, sizeof(*c));
+    c->lpf_hz = 20e6;
+    c->nco_hz = 15e6;
+    c->down = true;
+    c->gain_db = 40;
+    c->cpu = -1;
+    c->line = line;
+    bool have_serial = false, have_lo = false, any = false;
+    char *save = NULL;
+    for (char *tok = strtok_r(s, " \t\r\n", &save); tok; tok = strtok_r(NULL, " \t\r\n", &save)) {
+        any = true;
+        char *v = strchr(tok, '=');
+        if (!v) {
+            fprintf(stderr, "config:%d: expected key=value, got '%s'\n", line, tok);
+            return -1;
+        }
+        *v++ = '\0';
+        char *end = NULL;
+        bool ok = true;
+        if (!strcmp(tok, "serial")) {
+            c->serial = strtoull(v, &end, 16);
+            ok = have_serial = end != v && !*end;
+        } else if (!strcmp(tok, "lo")) {
+            ok = have_lo = limetx_parse_hz(v, &c->lo_hz) && c->lo_hz > 0;
+        } else if (!strcmp(tok, "nco")) {
+            ok = limetx_parse_hz(v, &c->nco_hz);
+        } else if (!strcmp(tok, "down")) {
+            ok = limetx_parse_bool(v, &c->down);
+        } else if (!strcmp(tok, "sr")) {
+            ok = limetx_parse_hz(v, &c->sr_hz) && c->sr_hz > 0;
+        } else if (!strcmp(tok, "lpf")) {
+            ok = limetx_parse_hz(v, &c->lpf_hz) && c->lpf_hz > 0;
+        } else if (!strcmp(tok, "gain")) {
+            c->gain_db = (int)strtol(v, &end, 0);
+            ok = end != v && !*end && c->gain_db >= 0 && c->gain_db <= 73;
+        } else if (!strcmp(tok, "ch")) {
+            c->ch = (int)strtol(v, &end, 0);
+            ok = end != v && !*end && (c->ch == 0 || c->ch == 1);
+        } else if (!strcmp(tok, "cpu")) {
+            c->cpu = (int)strtol(v, &end, 0);
+            ok = end != v && !*end && c->cpu >= 0;
+        } else if (!strcmp(tok, "loop")) {
+            ok = limetx_parse_bool(v, &c->loop);
+        } else if (!strcmp(tok, "input")) {
+            ok = *v && strlen(v) < sizeof(c->input);
+            if (ok)
+                snprintf(c->input, sizeof(c->input), "%s", v);
+        } else if (!strcmp(tok, "cal")) {
+            c->cal = !strcmp(v, "lms") ? TX_MULTI_CAL_LMS : !strcmp(v, "trim") ? TX_MULTI_CAL_TRIM : TX_MULTI_CAL_OFF;
+            ok = c->cal != TX_MULTI_CAL_OFF || !strcmp(v, "off");
+        } else {
+            fprintf(stderr, "config:%d: unknown key '%s'\n", line, tok);
+            return -1;
+        }
+        if (!ok) {
+            fprintf(stderr, "config:%d: bad %s=%s\n", line, tok, v);
+            return -1;
+        }
+    }
+    if (!any)
+        return 1;
+    if (!have_serial || !have_lo || !c->input[0]) {
+        fprintf(stderr, "config:%d: needs serial=, lo= and input=\n", line);
+        return -1;
+    }
+    return 0;
+}
+
+// Returns the number of boards, -1 on an error (printed).
+static inline int tx_multi_load(const char *path, tx_multi_cfg_t *cfg, int max) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "can't open config %s\n", path);
+        return -1;
+    }
+    char buf[1024];
+    int n = 0, line = 0, rc = 0;
+    while (rc >= 0 && fgets(buf, sizeof(buf), f)) {
+        line++;
+        if (n == max) {
+            fprintf(stderr, "config:%d: more than %d boards\n", line, max);
+            rc = -1;
+            break;
+        }
+        rc = tx_multi_parse_line(buf, line, &cfg[n]);
+        if (rc == 0) {
+            for (int i = 0; i < n && rc == 0; i++)
+                if (cfg[i].serial == cfg[n].serial) {
+                    fprintf(stderr, "config:%d: serial %" PRIx64 " already on line %d\n", line, cfg[n].serial,
+                            cfg[i].line);
+                    rc = -1;
+                }
+            if (rc == 0)
+                n++;
+        }
+    }
+    fclose(f);
+    if (rc >= 0 && n == 0) {
+        fprintf(stderr, "config %s lists no boards\n", path);
+        return -1;
+    }
+    return rc < 0 ? -1 : n;
+}
+
+#endif
@@ -1,9 +1,26 @@
+#define _GNU_SOURCE
+#include "iq_ramp.h"
+#include "iq_resamp.h"
+#include "iq_scale.h"
+#include "iq_shm.h"
 #include "lime/LimeSuite.h"
+#include "limetx.h"
+#include "tx_boot.h"
+#include "tx_burst.h"
+#include "tx_calcache.h"
+#include "tx_chunk.h"
+#include "tx_cmd.h"
+#include "tx_ctrl.h"
+#include "tx_mimo.h"
+#include "tx_rt.h"
+#include "tx_telem.h"
+#include "tx_trim.h"
 #include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <inttypes.h>
 #include <math.h>
+#include <poll.h>
 #include <signal.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -15,10 +32,15 @@
 #include <time.h>
 
 #define CH 0
+#define CH_B 1 // second channel with --channels 2 (I_A Q_A I_B Q_B input)
 #define NCO_INDEX 0
-#define FIFO_SIZE_SAMPLES (1 << 17)
-#define BUF_SAMPLES 8192
+#define FIFO_SIZE_SAMPLES (1 << 17) // --fifo-size
+#define BUF_SAMPLES 8192            // --chunk; --chunk-goal adapts it at run time
 #define SEND_TIMEOUT_MS 1000
+#define PIPE_SIZE_DEF (1 << 20)
+#define GATHER_MS_DEF 5
+#define RAMP_DOWN_MS_DEF 20
+#define WAIT_HIST_BUCKETS 12 // <1 ms, <2 ms, <4 ms, ... , >=1024 ms
 
 // clang-format off
 #define CHECK(x) do { \
@@ -53,38 +75,6 @@ static void print_nco(lms_device_t *dev) {
     printf("set/get: NCO idx=%d (no frequency readback in this LimeSuite)\n", idx);
 }
 
-// clang-format off
-static bool parse_bool(const char* s, bool* out){
-    if (!s || !out) return false;
-    if (!strcasecmp(s,"1") || !strcasecmp(s,"true") || !strcasecmp(s,"yes") || !strcasecmp(s,"on")) { *out=true;  return true; }
-    if (!strcasecmp(s,"0") || !strcasecmp(s,"false")|| !strcasecmp(s,"no")  || !strcasecmp(s,"off")){ *out=false; return true; }
-    return false;
-}
-
-static bool parse_hz(const char* s, double* out){
-    if (!s || !out) return false;
-    char* end = NULL;
-    double v = strtod(s, &end);
-    if (end && *end != '\0'){
-        while (*end && isspace((unsigned char)*end)) end++;
-        if (*end){
-            double mul = 1.0;
-            char c = (char)tolower((unsigned char)*end);
-            if (c=='k') mul = 1e3;
-            else if (c=='m') mul = 1e6;
-            else if (c=='g') mul = 1e9;
-            else return false;
-            end++;
-            while (*end && isspace((unsigned char)*end)) end++;
-            if (*end!='\0') return false;
-            v *= mul;
-        }
-    }
-    *out = v;
-    return true;
-}
-// clang-format on
-
 static int clampi(int v, int lo, int hi) {
     if (v < lo)
         return lo;
@@ -93,84 +83,295 @@ static int clampi(int v, int lo, int hi) {
     return v;
 }
 
-static int set_mac_channel(lms_device_t *dev, int ch) {
-    uint16_t v = 0;
-    if (LMS_ReadLMSReg(dev, 0x0020, &v))
-        return -1;
-    v = (uint16_t)((v & ~0x3) | (ch == 0 ? 0x1 : 0x2));
-    return LMS_WriteLMSReg(dev, 0x0020, v);
+typedef struct {
+    int fd;
+    uint8_t *buf;
+    size_t cap;  // bytes_per_chunk
+    size_t have; // bytes in buf, including a carried partial frame
+    size_t bytes_per_frame;
+    int gather_ms;
+    bool eof;
+    tx_telem_t *telem;
+    iq_shm_t *shm; // --shm: buf points into the ring rather than being filled by read()
+
+    uint64_t chunks;
+    uint64_t short_chunks; // flushed by the gather deadline before the chunk was full
+    uint64_t blocked;      // input waits > 10 ms (used to be a per-event warning)
+    uint64_t wait_hist[WAIT_HIST_BUCKETS];
+} fifo_in_t;
+
+static double mono_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
 }
 
-static void print_tx_correctors(lms_device_t *dev, int ch) {
-    if (set_mac_channel(dev, ch)) {
-        fprintf(stderr, "WARN: can't set MAC for channel %c\n", ch ? 'B' : 'A');
-        return;
+static void fifo_in_account_wait(fifo_in_t *in, double wait_s) {
+    int b = 0;
+    double lim = 1e-3;
+    while (b < WAIT_HIST_BUCKETS - 1 && wait_s >= lim) {
+        b++;
+        lim *= 2.0;
     }
+    in->wait_hist[b]++;
+    if (wait_s > 0.01)
+        in->blocked++;
+}
 
-    uint16_t reg_gq = 0, reg_gi = 0, reg_iq = 0, reg_dc = 0;
+// Shared-memory input: the same gather rule, with in->buf pointing at the readable frames in the
+// ring. The producer only commits whole frames, so there is never a partial one to carry.
+static ssize_t fifo_in_gather_shm(fifo_in_t *in) {
+    const size_t want = in->cap / in->bytes_per_frame;
+    double t_first = 0.0;
+    double waited = 0.0;
+    size_t avail = iq_shm_readable(in->shm);
+
+    while (avail < want && keep_running) {
+        int timeout = 100; // wake up now and then to see keep_running
+        if (avail) {
+            if (t_first == 0.0)
+                t_first = mono_s();
+            double left_ms = in->gather_ms - (mono_s() - t_first) * 1e3;
+            if (left_ms <= 0.0)
+                break;
+            timeout = (int)ceil(left_ms);
+        } else if (iq_shm_eof(in->shm)) {
+            in->eof = true;
+            break;
+        }
+        double t0 = mono_s();
+        avail = iq_shm_wait_data(in->shm, want, timeout);
+        waited += mono_s() - t0;
+    }
 
-    (void)LMS_ReadLMSReg(dev, 0x0201, &reg_gq); // GCORRQ[10:0]
-    (void)LMS_ReadLMSReg(dev, 0x0202, &reg_gi); // GCORRI[10:0]
-    (void)LMS_ReadLMSReg(dev, 0x0203, &reg_iq); // IQCORR[11:0] (signed)
-    (void)LMS_ReadLMSReg(dev, 0x0204, &reg_dc); // DCCORRI[15:8], DCCORRQ[7:0]
+    if (avail > want)
+        avail = want;
+    in->buf = (uint8_t *)iq_shm_peek(in->shm);
+    in->have = avail * in->bytes_per_frame;
+    if (avail) {
+        tx_telem_read(in->telem, tx_telem_now_ns(), in->have);
+        in->chunks++;
+        if (avail < want)
+            in->short_chunks++;
+        fifo_in_account_wait(in, waited);
+    }
+    return (ssize_t)avail;
+}
 
-    int gq = (int)(reg_gq & 0x07FF);
-    int gi = (int)(reg_gi & 0x07FF);
+// Gather whole frames into in->buf: returns once a full chunk is buffered, or gather_ms after
+// the first byte of the chunk arrived. Returns frames ready (0 on EOF/stop), -1 on error.
+static ssize_t fifo_in_gather(fifo_in_t *in) {
+    if (in->shm)
+        return fifo_in_gather_shm(in);
+    double t_first = in->have ? mono_s() : 0.0;
+    double waited = 0.0;
+
+    while (in->have < in->cap && !in->eof && keep_running) {
+        int timeout = -1;
+        if (in->have >= in->bytes_per_frame) {
+            double left_ms = in->gather_ms - (mono_s() - t_first) * 1e3;
+            if (left_ms <= 0.0)
+                break;
+            timeout = (int)ceil(left_ms);
+        }
 
-    int iq = (int)(reg_iq & 0x0FFF);
-    if (iq & 0x0800)
-        iq |= ~0x0FFF;
+        struct pollfd pfd = {.fd = in->fd, .events = POLLIN};
+        double t0 = mono_s();
+        int pr = poll(&pfd, 1, timeout);
+        waited += mono_s() - t0;
+        if (pr < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("poll fifo");
+            return -1;
+        }
+        if (pr == 0)
+            break; // gather deadline
 
-    int dci = (int8_t)((reg_dc >> 8) & 0xFF);
-    int dcq = (int8_t)(reg_dc & 0xFF);
+        uint64_t t_read = tx_telem_now_ns();
+        ssize_t got = read(in->fd, in->buf + in->have, in->cap - in->have);
+        if (got > 0)
+            tx_telem_read(in->telem, t_read, (size_t)got);
+        if (got < 0) {
+            if (errno == EINTR || errno == EAGAIN)
+                continue;
+            perror("read fifo");
+            return -1;
+        }
+        if (got == 0) {
+            in->eof = true;
+            break;
+        }
+        if (in->have == 0)
+            t_first = mono_s();
+        in->have += (size_t)got;
+    }
 
-    printf("gain: GCORRI=%d, GCORRQ=%d\n", gi, gq);
-    printf("phase: IQCORR=%d\n", iq);
-    printf("dc: DCCORRI=%d, DCCORRQ=%d\n", dci, dcq);
+    size_t frames = in->have / in->bytes_per_frame;
+    if (frames) {
+        in->chunks++;
+        if (in->have < in->cap)
+            in->short_chunks++;
+        fifo_in_account_wait(in, waited);
+    }
+    return (ssize_t)frames;
 }
 
-static int apply_manual_txtsp(lms_device_t *dev, int ch, bool have_gi, int gi, bool have_gq, int gq, bool have_phase,
-                              int phase, bool have_dci, int dci, bool have_dcq, int dcq) {
-    if (set_mac_channel(dev, ch))
-        return -1;
-
-    int rc = 0;
+// Non-blocking variant used while fading out: take whatever is already in the pipe.
+static ssize_t fifo_in_read_now(fifo_in_t *in) {
+    if (in->shm) {
+        size_t avail = iq_shm_readable(in->shm);
+        if (avail > in->cap / in->bytes_per_frame)
+            avail = in->cap / in->bytes_per_frame;
+        in->buf = (uint8_t *)iq_shm_peek(in->shm);
+        in->have = avail * in->bytes_per_frame;
+        return (ssize_t)avail;
+    }
+    if (in->have < in->cap && !in->eof) {
+        struct pollfd pfd = {.fd = in->fd, .events = POLLIN};
+        if (poll(&pfd, 1, 0) > 0) {
+            uint64_t t_read = tx_telem_now_ns();
+            ssize_t got = read(in->fd, in->buf + in->have, in->cap - in->have);
+            if (got > 0)
+                tx_telem_read(in->telem, t_read, (size_t)got);
+            if (got == 0)
+                in->eof = true;
+            else if (got > 0)
+                in->have += (size_t)got;
+        }
+    }
+    return (ssize_t)(in->have / in->bytes_per_frame);
+}
 
-    if (have_gi) {
-        gi = clampi(gi, 0, 2047);
-        rc |= LMS_WriteLMSReg(dev, 0x0202, (uint16_t)((uint16_t)gi & 0x07FF)); // GCORRI
+// Drop the frames just sent, carrying a trailing partial frame into the next gather.
+static void fifo_in_consume(fifo_in_t *in, size_t frames) {
+    if (in->shm) {
+        iq_shm_release(in->shm, frames);
+        in->have = 0; // the rest stays in the ring for the next gather
+        return;
     }
-    if (have_gq) {
-        gq = clampi(gq, 0, 2047);
-        rc |= LMS_WriteLMSReg(dev, 0x0201, (uint16_t)((uint16_t)gq & 0x07FF)); // GCORRQ
+    size_t used = frames * in->bytes_per_frame;
+    size_t rest = in->have - used;
+    if (rest)
+        memmove(in->buf, in->buf + used, rest);
+    in->have = rest;
+}
+
+static void fifo_in_print_hist(const fifo_in_t *in) {
+    printf("FIFO input: %" PRIu64 " chunks, %" PRIu64 " short (deadline), %" PRIu64 " waits >10 ms\n", in->chunks,
+           in->short_chunks, in->blocked);
+    double lo = 0.0, hi = 1.0;
+    for (int b = 0; b < WAIT_HIST_BUCKETS; b++) {
+        if (in->wait_hist[b]) {
+            if (b == WAIT_HIST_BUCKETS - 1)
+                printf("  wait >= %6.0f ms : %" PRIu64 "\n", lo, in->wait_hist[b]);
+            else
+                printf("  wait %4.0f..%4.0f ms : %" PRIu64 "\n", lo, hi, in->wait_hist[b]);
+        }
+        lo = hi;
+        hi *= 2.0;
     }
-    if (have_phase) {
-        phase = clampi(phase, -2047, 2047);
-        uint16_t iq12 = (uint16_t)((uint16_t)phase & 0x0FFF); // IQCORR (12 bit signed)
-        rc |= LMS_WriteLMSReg(dev, 0x0203, iq12);
+    if (in->shm)
+        printf("shm input: %" PRIu64 " empty-ring sleeps, producer: %" PRIu64 " full-ring sleeps, %" PRIu64
+               " wakeups sent\n",
+               in->shm->empty_waits, (uint64_t)atomic_load(&in->shm->h->producer_full_waits),
+               (uint64_t)atomic_load(&in->shm->h->producer_wakes));
+}
+
+// Send one chunk from buf: a plain send, or split across A/B in lockstep with --channels 2.
+static int send_frames(lms_stream_t *txs, tx_mimo_t *mimo, tx_telem_t *telem, const int16_t *buf, size_t frames) {
+    const uint64_t t0 = tx_telem_now_ns();
+    int rc;
+    if (tx_mimo_active(mimo)) {
+        rc = tx_mimo_send_interleaved(mimo, buf, frames, SEND_TIMEOUT_MS);
+    } else {
+        lms_stream_meta_t meta;
+        memset(&meta, 0, sizeof(meta));
+        rc = LMS_SendStream(txs, buf, frames, &meta, SEND_TIMEOUT_MS) < 0 ? -1 : 0;
     }
+    tx_telem_send(telem, t0, frames, rc == 0);
+    return rc;
+}
 
-    if (have_dci || have_dcq) {
-        uint16_t reg_dc = 0;
-        rc |= LMS_ReadLMSReg(dev, 0x0204, &reg_dc); // DCCORR
-        if (have_dci) {
-            int8_t dci_s = (int8_t)clampi(dci, -128, 127);
-            reg_dc = (uint16_t)((reg_dc & 0x00FFu) | ((uint16_t)(uint8_t)dci_s << 8)); // I in [15:8]
+// Blocking read of exactly len bytes, waking every 100 ms to see keep_running. Returns the bytes
+// read (short on EOF or stop), -1 on error.
+static ssize_t fifo_read_full(int fd, void *dst, size_t len, tx_telem_t *telem) {
+    size_t have = 0;
+    while (have < len && keep_running) {
+        struct pollfd pfd = {.fd = fd, .events = POLLIN};
+        int pr = poll(&pfd, 1, 100);
+        if (pr < 0 && errno != EINTR) {
+            perror("poll fifo");
+            return -1;
         }
-        if (have_dcq) {
-            int8_t dcq_s = (int8_t)clampi(dcq, -128, 127);
-            reg_dc = (uint16_t)((reg_dc & 0xFF00u) | (uint16_t)(uint8_t)dcq_s); // Q in [7:0]
+        if (pr <= 0)
+            continue;
+        uint64_t t_read = tx_telem_now_ns();
+        ssize_t got = read(fd, (uint8_t *)dst + have, len - have);
+        if (got < 0) {
+            if (errno == EINTR || errno == EAGAIN)
+                continue;
+            perror("read fifo");
+            return -1;
         }
-        rc |= LMS_WriteLMSReg(dev, 0x0204, reg_dc);
+        if (got == 0)
+            break;
+        tx_telem_read(telem, t_read, (size_t)got);
+        have += (size_t)got;
     }
+    return (ssize_t)have;
+}
 
-    // Clear PH, GC, DC bypass so manual values take effect
-    uint16_t byp = 0;
-    rc |= LMS_ReadLMSReg(dev, 0x0208, &byp);
-    byp &= (uint16_t)~((1u << 0) | (1u << 1) | (1u << 3)); // clear PH_BYP (bit0), GC_BYP (bit1), DC_BYP (bit3)
-    rc |= LMS_WriteLMSReg(dev, 0x0208, byp);
-
-    return rc;
+// --bursts: the FIFO carries tx_burst_hdr_t + frames records, each queued at its sample time. The
+// first chunk of a burst is read before waiting for it, so the wake-up goes straight to the send.
+// A burst cut short by EOF is padded with zeros, so it still ends with a flushed packet.
+static void stream_bursts(tx_burst_t *b, int fd, int16_t *buf, size_t chunk_max, tx_telem_t *telem,
+                          iq_scale_fn scale_fn, iq_scale_q_t *scale_q, tx_cmd_scale_t *live, unsigned *seen) {
+    while (keep_running) {
+        tx_burst_hdr_t h;
+        ssize_t got = fifo_read_full(fd, &h, sizeof(h), telem);
+        if (got != (ssize_t)sizeof(h)) {
+            if (got >= 0 && keep_running)
+                fprintf(stderr, "FIFO EOF (writer closed), stopping after the last burst\n");
+            tx_burst_drain(b, &keep_running);
+            return;
+        }
+        if (h.magic != TX_BURST_MAGIC || h.frames == 0) {
+            fprintf(stderr, "bad burst header (magic 0x%08x, %u frames), stopping\n", h.magic, h.frames);
+            return;
+        }
+        bool first = true, eof = false;
+        for (uint64_t left = h.frames; left > 0;) {
+            const size_t n = left < chunk_max ? (size_t)left : chunk_max;
+            got = eof ? 0 : fifo_read_full(fd, buf, n * 2 * sizeof(int16_t), telem);
+            if (got < 0)
+                return;
+            const size_t bytes = (size_t)got - (size_t)got % (2 * sizeof(int16_t));
+            if (bytes < n * 2 * sizeof(int16_t)) {
+                eof = true;
+                memset((uint8_t *)buf + bytes, 0, n * 2 * sizeof(int16_t) - bytes);
+            }
+            if (first && !tx_burst_begin(b, h.at, h.frames, &keep_running))
+                return;
+            first = false;
+            tx_cmd_scale_poll(live, seen, scale_q);
+            if (scale_q->scale != 1.0)
+                scale_fn(buf, buf, n * 2, scale_q);
+            const uint64_t t0 = tx_telem_now_ns();
+            const int rc = tx_burst_send(b, buf, n, SEND_TIMEOUT_MS);
+            tx_telem_send(telem, t0, n, rc == 0);
+            if (rc) {
+                fprintf(stderr, "LMS_SendStream error: %s\n", LMS_GetLastErrorMessage());
+                return;
+            }
+            left -= n;
+        }
+        if (eof) {
+            fprintf(stderr, "FIFO EOF inside a burst (zero-padded), stopping\n");
+            tx_burst_drain(b, &keep_running);
+            return;
+        }
+    }
 }
 
 int main(int argc, char **argv) {
@@ -180,14 +381,45 @@ int main(int argc, char **argv) {
     double NCO_FREQ_HZ = 15e6;
     bool NCO_DOWNCONVERT = true;
     int TX_GAIN_DB = 40;
+    int TX_GAIN_START = -1; // <0: no ramp-up
+    int RAMP_MS = 0;
+    iq_ramp_shape_t DIG_RAMP = IQ_RAMP_DB;
+    int RAMP_DOWN_MS = RAMP_DOWN_MS_DEF;
     double CAL_BW_HZ = -1;
 
     double HOST_SR_HZ = 5e6;       // MUST be set with --sample-rate
-    const char *FIFO_PATH = NULL;  // MUST be set with --fifo
+    const char *FIFO_PATH = NULL;  // MUST be set with --fifo (or --shm)
+    const char *SHM_NAME = NULL;   // shared-memory ring instead of the FIFO
+    int SHM_SIZE = IQ_SHM_SIZE_DEF;
     double SCALE = 1.0;
+    int LINK_FMT = LMS_LINK_FMT_I16;
+    int NCH = 1; // 2: FIFO carries I_A Q_A I_B Q_B frames for TX A and TX B
+    double INPUT_SR_HZ = 0; // FIFO sample rate; 0 = same as --sample-rate (no resampling)
+    int RESAMP_THREADS = 0; // 0 = one per CPU, used only when a chunk is expensive
+    int PIPE_SIZE = PIPE_SIZE_DEF;
+    int GATHER_MS = GATHER_MS_DEF;
+    int FIFO_SIZE = 0; // 0 = FIFO_SIZE_SAMPLES, or sized from the budget with --chunk-goal latency:<ms>
+    int CHUNK = BUF_SAMPLES;
+    tx_chunk_goal_t CHUNK_GOAL = TX_CHUNK_FIXED;
+    double LATENCY_MS = 0;
+    tx_rt_t rt;
+    tx_rt_init(&rt);
+    int TELEM_MODE = TX_TELEM_OFF;
+    char TELEM_TARGET[TX_TELEM_PATH_MAX] = "";
+    int TELEM_INTERVAL_MS = TX_TELEM_INTERVAL_MS_DEF;
+    const char *CONTROL = NULL; // --control udp:[host:]port | unix:path
+    bool BURSTS = false;        // FIFO carries tx_burst_hdr_t-framed bursts
+    double BURST_LEAD_MS = TX_BURST_QUEUE_MS_DEF;
 
     bool DO_RESET = false;
     bool DO_CALIBRATE = false;
+    bool AUTOTRIM = false; // loopback trim, after LMS_Calibrate with --calibrate
+    const char *STATE_SAVE = NULL;
+    const char *STATE_LOAD = NULL;
+    char CAL_CACHE_BUF[TXCAL_PATH_MAX];
+    const char *CAL_CACHE = CAL_CACHE_BUF;
+    int CAL_MAX_AGE_S = TXCAL_MAX_AGE_DEF_S;
+    txcal_default_path(CAL_CACHE_BUF, sizeof(CAL_CACHE_BUF));
 
     bool PRINT_CORRECTORS = false;
     bool SET_GI = false, SET_GQ = false, SET_PHASE = false, SET_DCI = false, SET_DCQ = false;
@@ -201,18 +433,46 @@ int main(int argc, char **argv) {
         #define NEEDVAL() do{ if (i+1>=argc){ fprintf(stderr,"missing value for %s\n", a); return 1; } }while(0)
 
         if (!strcmp(a,"--fifo")){ NEEDVAL(); FIFO_PATH = argv[++i]; continue; }
-        if (!strcmp(a,"--sample-rate")){ NEEDVAL(); if(!parse_hz(argv[++i], &HOST_SR_HZ)) { fprintf(stderr,"bad --sample-rate\n"); return 1; } continue; }
+        if (!strcmp(a,"--shm")){ NEEDVAL(); SHM_NAME = argv[++i]; continue; }
+        if (!strcmp(a,"--shm-size")){ NEEDVAL(); SHM_SIZE = (int)strtol(argv[++i], NULL, 0); if (SHM_SIZE<65536){ fprintf(stderr,"bad --shm-size (>= 65536 bytes)\n"); return 1; } continue; }
+        if (!strcmp(a,"--state-save")){ NEEDVAL(); STATE_SAVE = argv[++i]; continue; }
+        if (!strcmp(a,"--state-load")){ NEEDVAL(); STATE_LOAD = argv[++i]; continue; }
+        if (!strcmp(a,"--sample-rate")){ NEEDVAL(); if(!limetx_parse_hz(argv[++i], &HOST_SR_HZ)) { fprintf(stderr,"bad --sample-rate\n"); return 1; } continue; }
+        if (!strcmp(a,"--input-rate")){ NEEDVAL(); if(!limetx_parse_hz(argv[++i], &INPUT_SR_HZ)) { fprintf(stderr,"bad --input-rate\n"); return 1; } continue; }
+        if (!strcmp(a,"--resample-threads")){ NEEDVAL(); RESAMP_THREADS = (int)strtol(argv[++i], NULL, 0); continue; }
         if (!strcmp(a,"--oversample")){ NEEDVAL(); OVERSAMPLE = (int)strtol(argv[++i], NULL, 0); if (OVERSAMPLE<1){ fprintf(stderr,"bad --oversample\n"); return 1; } continue; }
-        if (!strcmp(a,"--tx-lpf-bw")){ NEEDVAL(); if(!parse_hz(argv[++i], &TX_LPF_BW_HZ)) { fprintf(stderr,"bad --tx-lpf-bw\n"); return 1; } continue; }
-        if (!strcmp(a,"--lo")){ NEEDVAL(); if(!parse_hz(argv[++i], &LO_HZ)) { fprintf(stderr,"bad --lo\n"); return 1; } continue; }
-        if (!strcmp(a,"--nco")){ NEEDVAL(); if(!parse_hz(argv[++i], &NCO_FREQ_HZ)) { fprintf(stderr,"bad --nco\n"); return 1; } continue; }
-        if (!strcmp(a,"--nco-downconvert")){ NEEDVAL(); if(!parse_bool(argv[++i], &NCO_DOWNCONVERT)) { fprintf(stderr,"bad --nco-downconvert\n"); return 1; } continue; }
+        if (!strcmp(a,"--tx-lpf-bw")){ NEEDVAL(); if(!limetx_parse_hz(argv[++i], &TX_LPF_BW_HZ)) { fprintf(stderr,"bad --tx-lpf-bw\n"); return 1; } continue; }
+        if (!strcmp(a,"--lo")){ NEEDVAL(); if(!limetx_parse_hz(argv[++i], &LO_HZ)) { fprintf(stderr,"bad --lo\n"); return 1; } continue; }
+        if (!strcmp(a,"--nco")){ NEEDVAL(); if(!limetx_parse_hz(argv[++i], &NCO_FREQ_HZ)) { fprintf(stderr,"bad --nco\n"); return 1; } continue; }
+        if (!strcmp(a,"--nco-downconvert")){ NEEDVAL(); if(!limetx_parse_bool(argv[++i], &NCO_DOWNCONVERT)) { fprintf(stderr,"bad --nco-downconvert\n"); return 1; } continue; }
         if (!strcmp(a,"--tx-gain")){ NEEDVAL(); TX_GAIN_DB = (int)strtol(argv[++i], NULL, 0); if (TX_GAIN_DB<0 || TX_GAIN_DB>73){ fprintf(stderr,"--tx-gain (must be 0..73 dB typical)\n"); } continue; }
-        if (!strcmp(a,"--cal-bw")){ NEEDVAL(); if(!parse_hz(argv[++i], &CAL_BW_HZ)) { fprintf(stderr,"bad --cal-bw\n"); return 1; } continue; }
+        if (!strcmp(a,"--tx-gain-start")){ NEEDVAL(); TX_GAIN_START = (int)strtol(argv[++i], NULL, 0); continue; }
+        if (!strcmp(a,"--gain-ramp-ms")){ NEEDVAL(); RAMP_MS = (int)strtol(argv[++i], NULL, 0); continue; }
+        if (!strcmp(a,"--digital-ramp")){ NEEDVAL(); if(!iq_ramp_parse_shape(argv[++i], &DIG_RAMP)) { fprintf(stderr,"bad --digital-ramp (off|db|cos)\n"); return 1; } continue; }
+        if (!strcmp(a,"--ramp-down-ms")){ NEEDVAL(); RAMP_DOWN_MS = (int)strtol(argv[++i], NULL, 0); continue; }
+        if (!strcmp(a,"--cal-bw")){ NEEDVAL(); if(!limetx_parse_hz(argv[++i], &CAL_BW_HZ)) { fprintf(stderr,"bad --cal-bw\n"); return 1; } continue; }
+        if (!strcmp(a,"--pipe-size")){ NEEDVAL(); PIPE_SIZE = (int)strtol(argv[++i], NULL, 0); if (PIPE_SIZE<0){ fprintf(stderr,"bad --pipe-size\n"); return 1; } continue; }
+        if (!strcmp(a,"--gather-ms")){ NEEDVAL(); GATHER_MS = (int)strtol(argv[++i], NULL, 0); if (GATHER_MS<0){ fprintf(stderr,"bad --gather-ms\n"); return 1; } continue; }
+        if (!strcmp(a,"--fifo-size")){ NEEDVAL(); FIFO_SIZE = (int)strtol(argv[++i], NULL, 0); if (FIFO_SIZE<4*TX_CHUNK_MIN){ fprintf(stderr,"bad --fifo-size (>= %d samples)\n", 4*TX_CHUNK_MIN); return 1; } continue; }
+        if (!strcmp(a,"--chunk")){ NEEDVAL(); CHUNK = (int)strtol(argv[++i], NULL, 0); if (CHUNK<1 || CHUNK>TX_CHUNK_MAX_DEF){ fprintf(stderr,"bad --chunk (1..%d frames)\n", TX_CHUNK_MAX_DEF); return 1; } continue; }
+        if (!strcmp(a,"--chunk-goal")){ NEEDVAL(); if(!tx_chunk_parse_goal(argv[++i], &CHUNK_GOAL, &LATENCY_MS)) { fprintf(stderr,"bad --chunk-goal (off|underrun|latency:<ms>)\n"); return 1; } continue; }
+        if (!strcmp(a,"--rt")){ rt.enabled = true; if (i+1 < argc){ bool v=false; if (limetx_parse_bool(argv[i+1], &v)){ rt.enabled = v; i++; } } continue; }
+        if (!strcmp(a,"--rt-cpu")){ NEEDVAL(); rt.cpu = (int)strtol(argv[++i], NULL, 0); if (rt.cpu<0){ fprintf(stderr,"bad --rt-cpu\n"); return 1; } continue; }
+        if (!strcmp(a,"--rt-prio")){ NEEDVAL(); rt.prio = (int)strtol(argv[++i], NULL, 0); if (rt.prio<1 || rt.prio>99){ fprintf(stderr,"bad --rt-prio (1..99)\n"); return 1; } continue; }
+        if (!strcmp(a,"--telemetry")){ NEEDVAL(); if(!tx_telem_parse(argv[++i], &TELEM_MODE, TELEM_TARGET, sizeof(TELEM_TARGET))) { fprintf(stderr,"bad --telemetry (jsonl:<path|->, prom-file:<path>, prom:[host:]<port>)\n"); return 1; } continue; }
+        if (!strcmp(a,"--telemetry-interval-ms")){ NEEDVAL(); TELEM_INTERVAL_MS = (int)strtol(argv[++i], NULL, 0); if (TELEM_INTERVAL_MS<10){ fprintf(stderr,"bad --telemetry-interval-ms (>= 10)\n"); return 1; } continue; }
+        if (!strcmp(a,"--bursts")){ BURSTS = true; if (i+1 < argc){ bool v=false; if (limetx_parse_bool(argv[i+1], &v)){ BURSTS = v; i++; } } continue; }
+        if (!strcmp(a,"--burst-lead")){ NEEDVAL(); BURST_LEAD_MS = strtod(argv[++i], NULL); if (BURST_LEAD_MS<0 || BURST_LEAD_MS>TX_BURST_QUEUE_MS_MAX){ fprintf(stderr,"bad --burst-lead\n"); return 1; } continue; }
+        if (!strcmp(a,"--control")){ NEEDVAL(); CONTROL = argv[++i]; if (!tx_cmd_parse_target(CONTROL)){ fprintf(stderr,"bad --control (udp:[host:]port, unix:<path>)\n"); return 1; } continue; }
         if (!strcmp(a,"--scale")){ NEEDVAL(); SCALE = strtod(argv[++i], NULL); if (SCALE<0.0 || SCALE>4.0){ fprintf(stderr,"--scale out of range\n"); return 1; } continue; }
-        if (!strcmp(a,"--reset")){ DO_RESET = true; if (i+1 < argc){ bool v=false; if (parse_bool(argv[i+1], &v)){ DO_RESET = v; i++; } } continue; }
-        if (!strcmp(a,"--calibrate")){ DO_CALIBRATE = true; if (i+1 < argc){ bool v=false; if (parse_bool(argv[i+1], &v)){ DO_CALIBRATE = v; i++; } } continue; }
-        if (!strcmp(a,"--print-correctors")){ PRINT_CORRECTORS = true; if (i+1 < argc){ bool v=false; if (parse_bool(argv[i+1], &v)){ PRINT_CORRECTORS = v; i++; } } continue; }
+        if (!strcmp(a,"--channels")){ NEEDVAL(); NCH = (int)strtol(argv[++i], NULL, 0); if (NCH<1 || NCH>TX_MIMO_NCH){ fprintf(stderr,"bad --channels (1|2)\n"); return 1; } continue; }
+        if (!strcmp(a,"--link-fmt")){ NEEDVAL(); if(!limetx_parse_link_fmt(argv[++i], &LINK_FMT)) { fprintf(stderr,"bad --link-fmt (i12|i16)\n"); return 1; } continue; }
+        if (!strcmp(a,"--reset")){ DO_RESET = true; if (i+1 < argc){ bool v=false; if (limetx_parse_bool(argv[i+1], &v)){ DO_RESET = v; i++; } } continue; }
+        if (!strcmp(a,"--calibrate")){ DO_CALIBRATE = true; if (i+1 < argc){ bool v=false; if (limetx_parse_bool(argv[i+1], &v)){ DO_CALIBRATE = v; i++; } } continue; }
+        if (!strcmp(a,"--autotrim")){ AUTOTRIM = true; if (i+1 < argc){ bool v=false; if (limetx_parse_bool(argv[i+1], &v)){ AUTOTRIM = v; i++; } } continue; }
+        if (!strcmp(a,"--cal-cache")){ NEEDVAL(); CAL_CACHE = argv[++i]; if (!strcmp(CAL_CACHE,"off")) CAL_CACHE = NULL; continue; }
+        if (!strcmp(a,"--cal-cache-max-age")){ NEEDVAL(); CAL_MAX_AGE_S = (int)strtol(argv[++i], NULL, 0); continue; }
+        if (!strcmp(a,"--print-correctors")){ PRINT_CORRECTORS = true; if (i+1 < argc){ bool v=false; if (limetx_parse_bool(argv[i+1], &v)){ PRINT_CORRECTORS = v; i++; } } continue; }
         if (!strcmp(a,"--set-gain-i")){ NEEDVAL(); SET_GI=true; MAN_GI=clampi((int)strtol(argv[++i], NULL, 0), 0, 2047); continue; }
         if (!strcmp(a,"--set-gain-q")){ NEEDVAL(); SET_GQ=true; MAN_GQ=clampi((int)strtol(argv[++i], NULL, 0), 0, 2047); continue; }
         if (!strcmp(a,"--set-phase")) { NEEDVAL(); SET_PHASE=true; MAN_PHASE=clampi((int)strtol(argv[++i], NULL, 0), -2047, 2047); continue; }
@@ -222,16 +482,61 @@ int main(int argc, char **argv) {
         fprintf(stderr,"unknown option: %s\n", a);
         return 1;
     }
-    if (!FIFO_PATH){ fprintf(stderr,"missing --fifo <path>\n"); return 1; }
+    if (!FIFO_PATH == !SHM_NAME){ fprintf(stderr,"need one of --fifo <path> or --shm <name>\n"); return 1; }
+    if (BURSTS && (!FIFO_PATH || NCH != 1 || INPUT_SR_HZ > 0)){ fprintf(stderr,"--bursts needs --fifo, one channel and no --input-rate\n"); return 1; }
     if (CAL_BW_HZ <= 0) CAL_BW_HZ = TX_LPF_BW_HZ;
     // clang-format on
 
+    const bool RESAMPLE = INPUT_SR_HZ > 0 && fabs(INPUT_SR_HZ - HOST_SR_HZ) >= 0.5;
+    if (FIFO_SIZE == 0)
+        FIFO_SIZE = CHUNK_GOAL == TX_CHUNK_LATENCY ? (int)tx_chunk_fifo_for_latency(LATENCY_MS, HOST_SR_HZ)
+                                                   : FIFO_SIZE_SAMPLES;
+    tx_chunk_t chunk;
+    tx_chunk_init(&chunk, CHUNK_GOAL, HOST_SR_HZ, (uint32_t)FIFO_SIZE, (size_t)CHUNK, TX_CHUNK_MAX_DEF, LATENCY_MS);
+    const size_t CHUNK_MAX = chunk.max; // every buffer below holds this many frames
+    if (RAMP_MS < 0)
+        RAMP_MS = 0;
+    if (RAMP_DOWN_MS < 0)
+        RAMP_DOWN_MS = 0;
+    if (TX_GAIN_START > TX_GAIN_DB) {
+        fprintf(stderr, "WARN: --tx-gain-start above --tx-gain, ramp-up disabled\n");
+        TX_GAIN_START = -1;
+    }
+
     signal(SIGINT, on_sigint);
 
     lms_device_t *dev = NULL;
+    limetx_regs_t regs;
     lms_stream_t txs;
+    tx_mimo_t mimo;
+    double host_sr = HOST_SR_HZ, rf_sr = 0; // what the device runs at, once the rate is set
     int16_t *buf = NULL;
+    int16_t *inbuf = NULL; // FIFO input when resampling, else the FIFO reads straight into buf
+    iq_resamp_t rs;
+    fifo_in_t fifo_in;
+    iq_shm_t shm;
+    iq_ramp_t ramp;
+    tx_telem_t telem;
+    tx_ctrl_t ctrl;
+    tx_cmd_t cmd;
+    tx_burst_t burst;
+    bool ramped_down = false;
     memset(&txs, 0, sizeof(txs));
+    memset(&mimo, 0, sizeof(mimo));
+    memset(&fifo_in, 0, sizeof(fifo_in));
+    memset(&shm, 0, sizeof(shm));
+    memset(&rs, 0, sizeof(rs));
+    memset(&ramp, 0, sizeof(ramp));
+    memset(&ctrl, 0, sizeof(ctrl));
+    memset(&burst, 0, sizeof(burst));
+    tx_cmd_init(&cmd);
+    if (tx_rt_begin(&rt, true))
+        return 1;
+    if (tx_telem_start(&telem, TELEM_MODE, TELEM_TARGET, "tx_pipe_I16bit", NCH, (unsigned)TELEM_INTERVAL_MS))
+        return 1;
+
+    tx_boot_t boot;
+    tx_boot_begin(&boot, CH);
 
     lms_info_str_t list[8];
     int n = LMS_GetDeviceList(list);
@@ -243,63 +548,95 @@ int main(int argc, char **argv) {
         fprintf(stderr, "LMS_Open failed: %s\n", LMS_GetLastErrorMessage());
         return 1;
     }
+    tx_boot_attach(&boot, dev);
+    limetx_regs_init(&regs, dev);
 
     if (DO_RESET) {
         CHECK(LMS_Reset(dev));
         printf("device reset to defaults\n");
     }
-    CHECK(LMS_Init(dev));
+    CHECK(tx_boot_init_device(&boot, STATE_LOAD));
 
     CHECK(LMS_EnableChannel(dev, LMS_CH_TX, CH, true));
     printf("TX channel enabled\n");
 
-    CHECK(LMS_SetSampleRate(dev, HOST_SR_HZ, OVERSAMPLE));
+    CHECK(tx_boot_sample_rate(&boot, HOST_SR_HZ, OVERSAMPLE));
     print_sr(dev);
+    // The CGEN PLL rounds the rate: device timestamps advance at the one actually set
+    CHECK(LMS_GetSampleRate(dev, LMS_CH_TX, CH, &host_sr, &rf_sr));
+    if (host_sr <= 0)
+        host_sr = HOST_SR_HZ;
 
-    CHECK(LMS_SetLPFBW(dev, LMS_CH_TX, CH, TX_LPF_BW_HZ));
+    CHECK(tx_boot_lpf_bw(&boot, TX_LPF_BW_HZ));
 
-    CHECK(LMS_SetGaindB(dev, LMS_CH_TX, CH, TX_GAIN_DB));
+    CHECK(tx_boot_gain(&boot, TX_GAIN_DB));
     print_gain(dev);
 
-    CHECK(LMS_SetLOFrequency(dev, LMS_CH_TX, CH, LO_HZ));
+    CHECK(tx_boot_lo(&boot, LO_HZ));
     print_lo(dev);
 
     {
         double freqs[16] = {0};
         freqs[NCO_INDEX] = NCO_FREQ_HZ;
-        CHECK(LMS_SetNCOFrequency(dev, true, CH, freqs, 0.0));
-        CHECK(LMS_SetNCOIndex(dev, true, CH, NCO_INDEX, NCO_DOWNCONVERT));
+        CHECK(tx_boot_nco(&boot, freqs, NCO_INDEX, NCO_DOWNCONVERT));
         print_nco(dev);
+        if (NCH == 2) {
+            CHECK(tx_mimo_config_ch(dev, CH_B, TX_LPF_BW_HZ, TX_GAIN_DB, freqs, NCO_INDEX, NCO_DOWNCONVERT));
+            printf("TX channel B enabled (LO shared with A)\n");
+        }
     }
 
-    if (DO_CALIBRATE) {
-        CHECK(LMS_Calibrate(dev, LMS_CH_TX, CH, CAL_BW_HZ, 0));
-        printf("TX calibrated (bw=%.2f MHz)\n", CAL_BW_HZ / 1e6);
+    if (DO_CALIBRATE || AUTOTRIM) {
+        txcal_key_t cal_key;
+        CHECK(txcal_key_init(&cal_key, dev, CH, LO_HZ, NCO_FREQ_HZ, CAL_BW_HZ));
+        CHECK(AUTOTRIM ? tx_trim_calibrate(&regs, &cal_key, CAL_CACHE, CAL_MAX_AGE_S, NCO_DOWNCONVERT, DO_CALIBRATE)
+                       : txcal_calibrate(&regs, &cal_key, CAL_CACHE, CAL_MAX_AGE_S));
+        if (NCH == 2) {
+            CHECK(txcal_key_init(&cal_key, dev, CH_B, LO_HZ, NCO_FREQ_HZ, CAL_BW_HZ));
+            CHECK(AUTOTRIM ? tx_trim_calibrate(&regs, &cal_key, CAL_CACHE, CAL_MAX_AGE_S, NCO_DOWNCONVERT, DO_CALIBRATE)
+                           : txcal_calibrate(&regs, &cal_key, CAL_CACHE, CAL_MAX_AGE_S));
+        }
+        printf("TX calibrated (%s, bw=%.2f MHz%s)\n", AUTOTRIM ? "autotrim" : "LMS_Calibrate", CAL_BW_HZ / 1e6,
+               NCH == 2 ? ", A and B" : "");
     }
 
     if (PRINT_CORRECTORS) {
-        print_tx_correctors(dev, CH);
+        limetx_print_correctors_short(&regs, CH);
     }
 
     if (SET_GI || SET_GQ || SET_PHASE || SET_DCI || SET_DCQ) {
-        CHECK(apply_manual_txtsp(dev, CH, SET_GI, MAN_GI, SET_GQ, MAN_GQ, SET_PHASE, MAN_PHASE, SET_DCI, MAN_DCI,
+        CHECK(limetx_apply_manual(&regs, CH, SET_GI, MAN_GI, SET_GQ, MAN_GQ, SET_PHASE, MAN_PHASE, SET_DCI, MAN_DCI,
                                  SET_DCQ, MAN_DCQ));
         printf("Manual TXTSP correctors applied.\n");
         if (PRINT_CORRECTORS) {
-            print_tx_correctors(dev, CH);
+            limetx_print_correctors_short(&regs, CH);
         }
     }
 
-    txs.channel = CH;
-    txs.isTx = true;
-    txs.fifoSize = FIFO_SIZE_SAMPLES;
-    txs.dataFmt = LMS_FMT_I16;
-    CHECK(LMS_SetupStream(dev, &txs));
-    CHECK(LMS_StartStream(&txs));
-    printf("TX stream started (fifo=%d samples, fmt=I16)\n", FIFO_SIZE_SAMPLES);
+    tx_boot_mark(&boot, "correctors");
+    if (STATE_SAVE)
+        tx_boot_save(&boot, STATE_SAVE);
+
+    if (NCH == 2) {
+        CHECK(tx_mimo_start(&mimo, dev, (uint32_t)FIFO_SIZE, LINK_FMT, CHUNK_MAX, host_sr));
+        printf("TX streams A+B started (fifo=%d samples, fmt=I16, link=%s, deinterleave=%s, t0=%" PRIu64 ")\n",
+               FIFO_SIZE, limetx_link_fmt_name(LINK_FMT), mimo.kernel, mimo.ts);
+    } else {
+        txs.channel = CH;
+        txs.isTx = true;
+        txs.fifoSize = (uint32_t)FIFO_SIZE;
+        txs.dataFmt = LMS_FMT_I16;
+        txs.linkFmt = LINK_FMT;
+        CHECK(LMS_SetupStream(dev, &txs));
+        CHECK(LMS_StartStream(&txs));
+        printf("TX stream started (fifo=%d samples, fmt=I16, link=%s)\n", FIFO_SIZE,
+               limetx_link_fmt_name(LINK_FMT));
+    }
+    limetx_print_link(LINK_FMT, NCH * host_sr);
+    tx_chunk_print(&chunk);
+    tx_boot_mark(&boot, "stream");
+    tx_boot_print(&boot);
 
-    double host_sr = 0, rf_sr = 0;
-    LMS_GetSampleRate(dev, LMS_CH_TX, CH, &host_sr, &rf_sr);
     unsigned int g_cur = 0;
     LMS_GetGaindB(dev, LMS_CH_TX, CH, &g_cur);
 
@@ -307,109 +644,245 @@ int main(int argc, char **argv) {
     printf("TX %.6f MHz (host=%.2f Msps, rf=%.2f Msps, gain=%u dB, %sconvert)\n",
            rf_hz / 1e6, host_sr / 1e6, rf_sr / 1e6, g_cur, NCO_DOWNCONVERT ? "down" : "up");
 
-    printf("Opening FIFO %s for reading (blocking until writer connects)...\n", FIFO_PATH);
-    fifo_fd = open(FIFO_PATH, O_RDONLY);
-    if (fifo_fd < 0) {
-        perror("open fifo");
-        goto cleanup;
+    if (SHM_NAME) {
+        // At least two of the largest chunks, so a full chunk can always be gathered.
+        size_t shm_bytes = (size_t)SHM_SIZE;
+        if (shm_bytes < 2 * CHUNK_MAX * 2 * NCH * sizeof(int16_t))
+            shm_bytes = 2 * CHUNK_MAX * 2 * NCH * sizeof(int16_t);
+        if (iq_shm_create(&shm, SHM_NAME, shm_bytes, (unsigned)NCH, RESAMPLE ? INPUT_SR_HZ : HOST_SR_HZ))
+            goto cleanup;
+        printf("shm ring %s created (%" PRIu64 " bytes, %d ch, gather %d ms), streaming IQ from it (Ctrl+C to stop)\n",
+               shm.name, shm.cap, NCH, GATHER_MS);
+    } else {
+        printf("Opening FIFO %s for reading (blocking until writer connects)...\n", FIFO_PATH);
+        fifo_fd = open(FIFO_PATH, O_RDONLY);
+        if (fifo_fd < 0) {
+            perror("open fifo");
+            goto cleanup;
+        }
+        if (PIPE_SIZE > 0) {
+            if (fcntl(fifo_fd, F_SETPIPE_SZ, PIPE_SIZE) < 0)
+                fprintf(stderr, "WARN: F_SETPIPE_SZ(%d) failed: %s (see /proc/sys/fs/pipe-max-size)\n", PIPE_SIZE,
+                        strerror(errno));
+        }
+        printf("FIFO opened (pipe buffer %d bytes, gather %d ms), streaming IQ from FIFO (Ctrl+C to stop)\n",
+               fcntl(fifo_fd, F_GETPIPE_SZ), GATHER_MS);
     }
-    printf("FIFO opened, streaming IQ from FIFO (Ctrl+C to stop)\n");
 
-    buf = (int16_t *)malloc(2 * BUF_SAMPLES * sizeof(int16_t));
-    if (!buf) {
+    buf = (int16_t *)tx_rt_alloc(&rt, 2 * NCH * CHUNK_MAX * sizeof(int16_t));
+    if (!buf || iq_ramp_init(&ramp, CHUNK_MAX)) {
         fprintf(stderr, "malloc failed\n");
         goto cleanup;
     }
 
-    const size_t bytes_per_frame = 2 * sizeof(int16_t); // I + Q, 16-bit each
-    const size_t bytes_per_chunk = BUF_SAMPLES * bytes_per_frame;
+    const char *scale_kernel = NULL;
+    const iq_scale_fn scale_fn = iq_scale_select(&scale_kernel);
+    iq_scale_q_t scale_q;
+    iq_scale_q_init(&scale_q, SCALE);
+    unsigned scale_seen = 0;
+    if (SCALE != 1.0 || CONTROL)
+        printf("scale: %.4f using %s kernel\n", SCALE, scale_kernel);
+
+    // Live changes go through the control worker, so they never run on this thread.
+    if (CONTROL) {
+        const int chs[LIMETX_NCH] = {CH, CH_B};
+        if (tx_ctrl_start(&ctrl, dev, CH) ||
+            tx_cmd_start(&cmd, CONTROL, &ctrl, &regs, chs, NCH, SCALE, NCO_FREQ_HZ, NCO_DOWNCONVERT))
+            goto cleanup;
+    }
+
+    // Analog gain stays at --tx-gain; the ramp-up runs on the samples. With two channels a ramp
+    // "frame" is one channel's I/Q pair, so the envelope runs over NCH times as many of them.
+    if (DIG_RAMP != IQ_RAMP_OFF && TX_GAIN_START >= 0 && RAMP_MS > 0) {
+        iq_ramp_begin(&ramp, DIG_RAMP, (double)(TX_GAIN_START - TX_GAIN_DB), 0.0,
+                      (uint64_t)((double)RAMP_MS * host_sr / 1000.0) * NCH);
+        printf("digital ramp: %s, %d -> %d dB over %d ms\n", iq_ramp_shape_name(DIG_RAMP), TX_GAIN_START, TX_GAIN_DB,
+               RAMP_MS);
+    }
+
+    const size_t bytes_per_frame = 2 * NCH * sizeof(int16_t); // I + Q per channel, 16-bit each
+    size_t bytes_per_chunk = chunk.cur * bytes_per_frame;
+
+    if (RESAMPLE) {
+        if (iq_resamp_init(&rs, INPUT_SR_HZ, HOST_SR_HZ, 2 * (size_t)NCH, IQ_RESAMP_TAPS_DEF, CHUNK_MAX,
+                           RESAMP_THREADS))
+            goto cleanup;
+        bytes_per_chunk = iq_resamp_max_in(&rs, chunk.cur) * bytes_per_frame;
+        inbuf = (int16_t *)tx_rt_alloc(&rt, 2 * NCH * CHUNK_MAX * sizeof(int16_t));
+        if (!inbuf) {
+            fprintf(stderr, "malloc failed\n");
+            goto cleanup;
+        }
+        printf("resample: %.0f -> %.0f Hz (L/M = %u/%u, %zu taps/phase, %s kernel, up to %d threads)\n", INPUT_SR_HZ,
+               HOST_SR_HZ, rs.L, rs.M, rs.taps, rs.kernel, rs.nthreads);
+    }
+
+    fifo_in.fd = fifo_fd;
+    fifo_in.buf = (uint8_t *)(RESAMPLE ? inbuf : buf);
+    fifo_in.cap = bytes_per_chunk;
+    fifo_in.bytes_per_frame = bytes_per_frame;
+    fifo_in.gather_ms = GATHER_MS;
+    fifo_in.telem = &telem;
+    fifo_in.shm = SHM_NAME ? &shm : NULL;
+
+    if (BURSTS) {
+        if (tx_burst_start(&burst, &txs, host_sr, BURST_LEAD_MS))
+            goto cleanup;
+        printf("bursts: framed FIFO input, each burst queued %.1f ms before its time\n", BURST_LEAD_MS);
+        tx_rt_enter(&rt);
+        stream_bursts(&burst, fifo_fd, buf, chunk.cur, &telem, scale_fn, &scale_q, &cmd.scale, &scale_seen);
+        ramped_down = true; // nothing to fade or flush: the stream idles after the last burst
+        goto cleanup;
+    }
 
     lms_stream_status_t st;
     memset(&st, 0, sizeof(st));
 
+    tx_rt_enter(&rt);
     time_t last = time(NULL);
 
     while (keep_running) {
-        struct timespec t1, t2;
-        clock_gettime(CLOCK_MONOTONIC, &t1);
-        ssize_t got = read(fifo_fd, buf, bytes_per_chunk);
-        clock_gettime(CLOCK_MONOTONIC, &t2);
-
-        if (got < 0) {
-            if (errno == EINTR)
-                continue;
-            perror("read fifo");
+        ssize_t frames = fifo_in_gather(&fifo_in);
+        if (frames < 0)
             break;
-        }
-        if (got == 0) {
-            fprintf(stderr, "FIFO EOF (writer closed), stopping\n");
+        if (frames == 0) {
+            if (fifo_in.eof)
+                fprintf(stderr, "%s, stopping\n", SHM_NAME ? "shm EOF (producer closed)" : "FIFO EOF (writer closed)");
             break;
         }
 
-        double dt = (t2.tv_sec - t1.tv_sec) +
-                    (t2.tv_nsec - t1.tv_nsec)/1e9;
-        if (dt > 0.01) {
-            fprintf(stderr, "read from fifo blocked %.3f s\n", dt);
+        // FIFO input lands in buf (or inbuf); shm input is sent straight from the ring when untouched.
+        const int16_t *src = (const int16_t *)fifo_in.buf;
+        size_t n_out = (size_t)frames;
+        if (RESAMPLE) {
+            n_out = iq_resamp_process(&rs, src, (size_t)frames, buf);
+            fifo_in_consume(&fifo_in, (size_t)frames);
+            src = buf;
         }
 
-        if (SCALE != 1.0) {
-            size_t samples16 = (size_t)got / 2;
-            for (size_t i = 0; i < samples16; i++) {
-                int32_t v = (int32_t)buf[i];
-                int32_t s = (int32_t)(v * SCALE);
-                if (s > 32767)
-                    s = 32767;
-                else if (s < -32768)
-                    s = -32768;
-                buf[i] = (int16_t)s;
-            }
+        tx_cmd_scale_poll(&cmd.scale, &scale_seen, &scale_q);
+        if (scale_q.scale != 1.0) {
+            scale_fn(buf, src, n_out * 2 * NCH, &scale_q);
+            src = buf;
+        }
+        if (iq_ramp_active(&ramp)) {
+            iq_ramp_apply(&ramp, buf, src, n_out * NCH);
+            src = buf;
         }
 
-        size_t frames = (size_t)got / bytes_per_frame;
-        if (frames > 0) {
-            lms_stream_meta_t meta;
-            memset(&meta, 0, sizeof(meta));
-            if (LMS_SendStream(&txs, buf, (int)frames, &meta, SEND_TIMEOUT_MS) < 0) {
-                fprintf(stderr, "LMS_SendStream error: %s\n", LMS_GetLastErrorMessage());
-                break;
-            }
+        if (n_out && send_frames(&txs, &mimo, &telem, src, n_out)) {
+            fprintf(stderr, "LMS_SendStream error: %s\n", LMS_GetLastErrorMessage());
+            break;
         }
+        if (!RESAMPLE)
+            fifo_in_consume(&fifo_in, (size_t)frames);
 
         time_t now = time(NULL);
         if (now != last) {
             last = now;
-            if (!LMS_GetStreamStatus(&txs, &st)) {
-                printf("TX status: fifo=%u, underrun=%u, overrun=%u\n",
-                       st.fifoFilledCount, st.underrun, st.overrun);
+            bool resized = false;
+            if (NCH == 2) {
+                lms_stream_status_t sb;
+                memset(&sb, 0, sizeof(sb));
+                if (!tx_mimo_status(&mimo, 0, &st) && !tx_mimo_status(&mimo, 1, &sb)) {
+                    tx_telem_status(&telem, 0, &st);
+                    tx_telem_status(&telem, 1, &sb);
+                    resized = tx_chunk_update(&chunk, &st, &sb);
+                    printf("TX status: A fifo=%u underrun=%u, B fifo=%u underrun=%u, ts=%" PRIu64 ", rearms=%" PRIu64
+                           ", in_short=%" PRIu64 ", in_blocked=%" PRIu64 "\n",
+                           st.fifoFilledCount, st.underrun, sb.fifoFilledCount, sb.underrun, mimo.ts, mimo.rearms,
+                           fifo_in.short_chunks, fifo_in.blocked);
+                }
+            } else if (!LMS_GetStreamStatus(&txs, &st)) {
+                tx_telem_status(&telem, 0, &st);
+                resized = tx_chunk_update(&chunk, &st, NULL);
+                printf("TX status: fifo=%u, underrun=%u, overrun=%u, in_short=%" PRIu64 ", in_blocked=%" PRIu64 "\n",
+                       st.fifoFilledCount, st.underrun, st.overrun, fifo_in.short_chunks, fifo_in.blocked);
+            }
+            if (resized) {
+                // A shrink can leave more than the new cap buffered; that chunk still fits CHUNK_MAX.
+                fifo_in.cap = (RESAMPLE ? iq_resamp_max_in(&rs, chunk.cur) : chunk.cur) * bytes_per_frame;
+                printf("chunk: %zu frames (%s goal, est. latency %.1f ms)\n", chunk.cur, tx_chunk_goal_name(chunk.goal),
+                       chunk.est_ms);
             }
         }
     }
 
+    fifo_in_print_hist(&fifo_in);
     printf("\nSIGINT or FIFO EOF, stopping\n");
 
+    if (!keep_running && RAMP_DOWN_MS > 0 && DIG_RAMP != IQ_RAMP_OFF) {
+        // Fade out over whatever the writer still has queued in the pipe (zeros once it runs dry)
+        iq_ramp_begin(&ramp, DIG_RAMP, iq_ramp_level_db(&ramp), IQ_RAMP_MUTE_DB,
+                      (uint64_t)((double)RAMP_DOWN_MS * host_sr / 1000.0) * NCH);
+        ramped_down = true;
+        while (iq_ramp_active(&ramp)) {
+            ssize_t got = fifo_in_read_now(&fifo_in);
+            ssize_t frames = got;
+            const int16_t *src = (const int16_t *)fifo_in.buf;
+            if (RESAMPLE && got > 0) {
+                frames = (ssize_t)iq_resamp_process(&rs, src, (size_t)got, buf);
+                fifo_in_consume(&fifo_in, (size_t)got);
+                got = 0;
+                src = buf;
+            }
+            if (frames <= 0) {
+                memset(buf, 0, 2 * NCH * chunk.cur * sizeof(int16_t));
+                frames = (ssize_t)chunk.cur;
+                src = buf;
+            } else if (scale_q.scale != 1.0) {
+                scale_fn(buf, src, (size_t)frames * 2 * NCH, &scale_q);
+                src = buf;
+            }
+            iq_ramp_apply(&ramp, buf, src, (size_t)frames * NCH);
+
+            if (send_frames(&txs, &mimo, &telem, buf, (size_t)frames)) {
+                ramped_down = false;
+                break;
+            }
+            if (got > 0)
+                fifo_in_consume(&fifo_in, (size_t)got);
+        }
+    }
+
 cleanup:
-    if (txs.handle) {
-        int16_t *z = (int16_t *)calloc(2 * BUF_SAMPLES, sizeof(int16_t));
+    tx_cmd_stop(&cmd);
+    tx_ctrl_stop(&ctrl);
+    if (burst.late_ns)
+        tx_burst_print(&burst);
+    if ((txs.handle || tx_mimo_active(&mimo)) && !ramped_down) {
+        int16_t *z = (int16_t *)calloc(2 * NCH * CHUNK_MAX, sizeof(int16_t));
         if (z) {
-            lms_stream_meta_t meta;
-            memset(&meta, 0, sizeof(meta));
-            (void)LMS_SendStream(&txs, z, BUF_SAMPLES, &meta, SEND_TIMEOUT_MS);
+            (void)send_frames(&txs, &mimo, &telem, z, CHUNK_MAX);
             free(z);
         }
+    }
+    if (txs.handle) {
         LMS_StopStream(&txs);
         LMS_DestroyStream(dev, &txs);
         printf("TX stream stopped\n");
     }
+    if (tx_mimo_active(&mimo))
+        printf("TX streams A+B stopped\n");
+    tx_mimo_stop(&mimo);
 
     if (fifo_fd >= 0)
         close(fifo_fd);
+    iq_shm_close(&shm);
 
     if (dev) {
         LMS_EnableChannel(dev, LMS_CH_TX, CH, false);
+        if (NCH == 2)
+            LMS_EnableChannel(dev, LMS_CH_TX, CH_B, false);
         printf("TX channel disabled\n");
         LMS_Close(dev);
     }
 
+    tx_telem_stop(&telem);
+    tx_burst_free(&burst);
+    iq_ramp_free(&ramp);
+    iq_resamp_free(&rs);
+    free(inbuf);
     if (buf)
         free(buf);
     return 0;
@@ -0,0 +1,152 @@
+#ifndef TX_RT_H
+#define TX_RT_H
+
+// Real-time profile for the streaming thread (--rt).
+//
+// tx_rt_begin() runs right after argument parsing, before any thread exists: it moves the process
+// onto every allowed CPU except the stream CPU, so the reader, resampler, control and telemetry
+// threads (and LimeSuite's own) inherit a mask that keeps them off it, and it mlockall()s.
+// tx_rt_enter() runs on the streaming thread once those threads are up: it pins the thread to the
+// stream CPU, switches it to SCHED_FIFO and prefaults its stack. Threads created after that would
+// inherit both, so it has to come last.
+//
+// Tools that mmap() a large file pass lock_future = false: MCL_FUTURE would fault in and pin the
+// whole mapping. Buffers from tx_rt_alloc() are then mlock()ed one by one instead.
+//
+// Nothing here is fatal. Without CAP_SYS_NICE / an rtprio limit, CAP_IPC_LOCK / memlock limit or
+// transparent hugepages each step prints a warning and the tool streams as it would without --rt.
+//
+// Needs _GNU_SOURCE before the first #include (CPU_SET, pthread_setaffinity_np).
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define TX_RT_PRIO_DEF 50
+#define TX_RT_HUGE_BYTES (2u << 20) // x86-64 / arm64 PMD hugepage
+#define TX_RT_STACK_PREFAULT (256u << 10)
+
+typedef struct {
+    bool enabled;
+    int cpu;  // stream CPU, -1 = the last allowed one
+    int prio; // SCHED_FIFO priority
+    bool locked;
+    bool pinned;
+    bool isolated; // the other threads are kept off cpu
+    bool fifo;
+} tx_rt_t;
+
+static inline void tx_rt_init(tx_rt_t *rt) {
+    memset(rt, 0, sizeof(*rt));
+    rt->cpu = -1;
+    rt->prio = TX_RT_PRIO_DEF;
+}
+
+static inline int tx_rt_begin(tx_rt_t *rt, bool lock_future) {
+    if (!rt->enabled)
+        return 0;
+
+    cpu_set_t all;
+    CPU_ZERO(&all);
+    if (sched_getaffinity(0, sizeof(all), &all)) {
+        fprintf(stderr, "WARN: rt: sched_getaffinity: %s, no CPU pinning\n", strerror(errno));
+    } else {
+        if (rt->cpu < 0)
+            for (int c = CPU_SETSIZE - 1; c >= 0 && rt->cpu < 0; c--)
+                if (CPU_ISSET(c, &all))
+                    rt->cpu = c;
+        if (rt->cpu >= CPU_SETSIZE || !CPU_ISSET(rt->cpu, &all)) {
+            fprintf(stderr, "rt: CPU %d is not available to this process\n", rt->cpu);
+            return -1;
+        }
+        cpu_set_t rest = all;
+        CPU_CLR(rt->cpu, &rest);
+        if (CPU_COUNT(&rest) == 0)
+            fprintf(stderr, "WARN: rt: only CPU %d available, other threads share it\n", rt->cpu);
+        else if (sched_setaffinity(0, sizeof(rest), &rest))
+            fprintf(stderr, "WARN: rt: moving other threads off CPU %d: %s\n", rt->cpu, strerror(errno));
+        else
+            rt->isolated = true;
+        rt->pinned = true;
+    }
+
+    if (mlockall(MCL_CURRENT | (lock_future ? MCL_FUTURE : 0)))
+        fprintf(stderr, "WARN: rt: mlockall: %s (needs CAP_IPC_LOCK or a larger `ulimit -l`), page faults possible\n",
+                strerror(errno));
+    else
+        rt->locked = true;
+    return 0;
+}
+
+// Stream buffer: 64-byte aligned, zeroed (so prefaulted) and, with --rt, backed by transparent
+// hugepages when it spans one and mlock()ed. Release with free().
+static inline void *tx_rt_alloc(const tx_rt_t *rt, size_t bytes) {
+    const bool huge = rt && rt->enabled && bytes >= TX_RT_HUGE_BYTES / 2;
+    const size_t align = huge ? TX_RT_HUGE_BYTES : 64;
+    bytes = (bytes + align - 1) / align * align;
+    void *p = aligned_alloc(align, bytes);
+    if (!p)
+        return NULL;
+#ifdef MADV_HUGEPAGE
+    if (huge)
+        (void)madvise(p, bytes, MADV_HUGEPAGE); // before the first touch, so faults come in 2 MiB
+#endif
+    memset(p, 0, bytes);
+    if (rt && rt->enabled)
+        (void)mlock(p, bytes);
+    return p;
+}
+
+static inline void tx_rt_prefault_stack(void) {
+    volatile uint8_t stack[TX_RT_STACK_PREFAULT];
+    for (size_t i = 0; i < sizeof(stack); i += 4096)
+        stack[i] = 0;
+}
+
+// Pin the calling thread to one CPU. Returns 0 or the pthread error.
+static inline int tx_rt_pin(int cpu) {
+    cpu_set_t one;
+    CPU_ZERO(&one);
+    CPU_SET(cpu, &one);
+    return pthread_setaffinity_np(pthread_self(), sizeof(one), &one);
+}
+
+// Call on the streaming thread after every helper thread has been created.
+static inline void tx_rt_enter(tx_rt_t *rt) {
+    if (!rt->enabled)
+        return;
+    if (rt->pinned) {
+        int e = tx_rt_pin(rt->cpu);
+        if (e) {
+            fprintf(stderr, "WARN: rt: pinning stream thread to CPU %d: %s\n", rt->cpu, strerror(e));
+            rt->pinned = false;
+        }
+    }
+    struct sched_param sp;
+    memset(&sp, 0, sizeof(sp));
+    sp.sched_priority = rt->prio;
+    int e = pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp);
+    if (e)
+        fprintf(stderr, "WARN: rt: SCHED_FIFO %d: %s (needs CAP_SYS_NICE or an rtprio limit), staying SCHED_OTHER\n",
+                rt->prio, strerror(e));
+    else
+        rt->fifo = true;
+    if (rt->locked)
+        tx_rt_prefault_stack();
+
+    printf("rt: stream thread %s", rt->fifo ? "SCHED_FIFO" : "SCHED_OTHER");
+    if (rt->fifo)
+        printf(" %d", rt->prio);
+    if (rt->pinned)
+        printf(" on CPU %d%s", rt->cpu, rt->isolated ? ", other threads off it" : "");
+    printf(", memory %slocked\n", rt->locked ? "" : "not ");
+}
+
+#endif
@@ -1,4 +1,7 @@
 #include "lime/LimeSuite.h"
+#include "limetx.h"
+#include "tx_boot.h"
+#include "tx_calcache.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -36,30 +39,6 @@ static uint64_t now_ms(void){
 }
 static int clampi(int v, int lo, int hi){ if (v<lo) return lo; if (v>hi) return hi; return v; }
 
-static bool parse_bool(const char* s, bool* out){
-    if (!s || !out) return false;
-    if (!strcasecmp(s,"1")||!strcasecmp(s,"true") ||!strcasecmp(s,"yes")||!strcasecmp(s,"on"))  { *out=true;  return true; }
-    if (!strcasecmp(s,"0")||!strcasecmp(s,"false")||!strcasecmp(s,"no") ||!strcasecmp(s,"off")) { *out=false; return true; }
-    return false;
-}
-// Parse Hz with optional k/M/G suffix (case-insensitive). Returns true on success.
-static bool parse_hz(const char* s, double* out){
-    if (!s || !out) return false;
-    char* end=NULL; double v=strtod(s,&end);
-    if (end && *end!='\0'){
-        while (*end && isspace((unsigned char)*end)) end++;
-        if (*end){
-            double mul=1.0; char c=(char)tolower((unsigned char)*end);
-            if (c=='k') mul=1e3; else if (c=='m') mul=1e6; else if (c=='g') mul=1e9; else return false;
-            end++;
-            while (*end && isspace((unsigned char)*end)) end++;
-            if (*end!='\0') return false;
-            v*=mul;
-        }
-    }
-    *out=v; return true;
-}
-
 static void print_sr(lms_device_t* dev){
     double host=0, rf=0;
     if (!LMS_GetSampleRate(dev, LMS_CH_TX, CH, &host, &rf))
@@ -102,6 +81,8 @@ static void usage(const char* prog){
         "\n"
         "Calibration:\n"
         "  --calibrate <0|1|true|false>  Run LMS_Calibrate(TX)      [default false]\n"
+        "  --cal-cache <path|off>        Reuse TX calibrations      [default ~/.cache/limesdr_tests/tx_cal.txt]\n"
+        "  --cal-cache-max-age <s>       Recalibrate older entries  [default 604800]\n"
         "  --set-gain-i <0..2047>        Manually set GCORRI (I gain)\n"
         "  --set-gain-q <0..2047>        Manually set GCORRQ (Q gain)\n"
         "  --set-phase  <-2047..2047>    Manually set IQCORR (phase)\n"
@@ -109,65 +90,16 @@ static void usage(const char* prog){
         "  --set-dc-q   <-128..127>      Manually set DCCORRQ (Q DC)\n"
         "\n"
         "Misc:\n"
+        "  --state-save <file>     Save the configured chip state (LMS_SaveConfig)\n"
+        "  --state-load <file>     Warm start: load state instead of LMS_Init and\n"
+        "                          skip setters whose readback already matches\n"
         "  -h, --help              Show this help\n\n", prog);
 }
 
-// ----------------- Helpers for register access / introspection -----------------
-static int set_mac_channel(lms_device_t* dev, int ch /*0=A,1=B*/){
-    uint16_t v = 0;
-    if (LMS_ReadLMSReg(dev, 0x0020, &v)) return -1;
-    // MAC[1:0]: 01=A, 10=B
-    v = (uint16_t)((v & ~0x3) | (ch==0 ? 0x1 : 0x2));
-    return LMS_WriteLMSReg(dev, 0x0020, v);
-}
-static void print_tx_correctors(lms_device_t* dev, int ch /*0=A,1=B*/){
-    if (set_mac_channel(dev, ch)) {
-        fprintf(stderr, "WARN: can't set MAC for channel %c\n", ch? 'B':'A');
-        return;
-    }
-    uint16_t reg_gq=0, reg_gi=0, reg_iq=0, reg_dc=0, reg_byp=0;
-    (void)LMS_ReadLMSReg(dev, 0x0201, &reg_gq); // GCORRQ[10:0]
-    (void)LMS_ReadLMSReg(dev, 0x0202, &reg_gi); // GCORRI[10:0]
-    (void)LMS_ReadLMSReg(dev, 0x0203, &reg_iq); // IQCORR[11:0] (tan(alpha/2))
-    (void)LMS_ReadLMSReg(dev, 0x0204, &reg_dc); // DCCORRI[15:8], DCCORRQ[7:0]
-    (void)LMS_ReadLMSReg(dev, 0x0208, &reg_byp); // bypass flags
-
-    int gq_u   = (int)(reg_gq & 0x07FF);
-    int gi_u   = (int)(reg_gi & 0x07FF);
-    int16_t iq_s = (int16_t)(reg_iq & 0x0FFF); if (iq_s & 0x0800) iq_s |= 0xF000;
-    int8_t dci_s = (int8_t)((reg_dc >> 8) & 0xFF);
-    int8_t dcq_s = (int8_t)(reg_dc & 0xFF);
-
-    const double gq = gq_u / 2048.0;
-    const double gi = gi_u / 2048.0;
-    const double gq_db = 20.0*log10(gq>0?gq:1e-9);
-    const double gi_db = 20.0*log10(gi>0?gi:1e-9);
-
-    const double tan_half = iq_s / 2048.0;
-    const double alpha_rad = 2.0 * atan(tan_half);
-    const double alpha_deg = alpha_rad * 180.0 / M_PI;
-
-    const double dci_norm = dci_s / 128.0;
-    const double dcq_norm = dcq_s / 128.0;
-
-    const bool ph_bypass = (reg_byp & (1u<<0)) != 0; // PH_BYP
-    const bool gc_bypass = (reg_byp & (1u<<1)) != 0; // GC_BYP
-    const bool dc_bypass = (reg_byp & (1u<<3)) != 0; // DC_BYP
-
-    printf("TXTSP correctors (CH %c):\n", ch? 'B':'A');
-    printf("  Gain:   GCORRI=%4d  (%.6f, %+6.2f dB)%s,  GCORRQ=%4d  (%.6f, %+6.2f dB)%s\n",
-           gi_u, gi, gi_db, gc_bypass?" [BYPASSED]":"",
-           gq_u, gq, gq_db, gc_bypass?" [BYPASSED]":"");
-    printf("  Phase:  IQCORR=%5d  -> phase ≈ %+8.4f deg%s\n",
-           (int)iq_s, alpha_deg, ph_bypass?" [BYPASSED]":"");
-    printf("  DC:     DCCORRI=%4d (%.5f FS)%s,  DCCORRQ=%4d (%.5f FS)%s\n",
-           (int)dci_s, dci_norm, dc_bypass?" [BYPASSED]":"",
-           (int)dcq_s, dcq_norm, dc_bypass?" [BYPASSED]":"");
-}
 // ---------------------------------------------------------------------
 
 // Snapshot printer (called before/after calibration as requested)
-static void print_snapshot(lms_device_t* dev,
+static void print_snapshot(lms_device_t* dev, limetx_regs_t* regs,
                            const char* title,
                            double requested_tx_lpf_bw_hz,
                            double requested_nco_hz,
@@ -192,59 +124,10 @@ static void print_snapshot(lms_device_t* dev,
     printf(" Target RF    : %.6f MHz (computed from LO±NCO)\n", rf_hz/1e6);
     printf(" TX Gain (dB) : %u (current)\n", gdb);
     printf(" Tone scale   : %.2f (fraction of full-scale)\n", tone_scale);
-    print_tx_correctors(dev, CH);
+    limetx_print_correctors(regs, CH);
     printf("=============================================================\n");
 }
 
-// Write manual TXTSP correctors and un-bypass GC/PH/DC
-static int apply_manual_txtsp(lms_device_t* dev, int ch,
-                              bool have_gi,    int gi,
-                              bool have_gq,    int gq,
-                              bool have_phase, int phase,
-                              bool have_dci,   int dci,
-                              bool have_dcq,   int dcq)
-{
-    if (set_mac_channel(dev, ch)) return -1;
-
-    int rc = 0;
-
-    if (have_gi) {
-        gi = clampi(gi, 0, 2047);
-        rc |= LMS_WriteLMSReg(dev, 0x0202, (uint16_t)((uint16_t)gi & 0x07FF)); // GCORRI
-    }
-    if (have_gq) {
-        gq = clampi(gq, 0, 2047);
-        rc |= LMS_WriteLMSReg(dev, 0x0201, (uint16_t)((uint16_t)gq & 0x07FF)); // GCORRQ
-    }
-    if (have_phase) {
-        phase = clampi(phase, -2047, 2047);
-        uint16_t iq12 = (uint16_t)((uint16_t)phase & 0x0FFF);                  // IQCORR (12-bit signed)
-        rc |= LMS_WriteLMSReg(dev, 0x0203, iq12);
-    }
-
-    if (have_dci || have_dcq) {
-        uint16_t reg_dc = 0;
-        rc |= LMS_ReadLMSReg(dev, 0x0204, &reg_dc);                            // DCCORR
-        if (have_dci) {
-            int8_t dci_s = (int8_t)clampi(dci, -128, 127);
-            reg_dc = (uint16_t)((reg_dc & 0x00FFu) | ((uint16_t)(uint8_t)dci_s << 8)); // I in [15:8]
-        }
-        if (have_dcq) {
-            int8_t dcq_s = (int8_t)clampi(dcq, -128, 127);
-            reg_dc = (uint16_t)((reg_dc & 0xFF00u) | (uint16_t)(uint8_t)dcq_s);        // Q in [7:0]
-        }
-        rc |= LMS_WriteLMSReg(dev, 0x0204, reg_dc);
-    }
-
-    // Clear PH/GC/DC bypass so manual values take effect
-    uint16_t byp = 0;
-    rc |= LMS_ReadLMSReg(dev, 0x0208, &byp);
-    byp &= (uint16_t)~((1u<<0) | (1u<<1) | (1u<<3)); // clear PH_BYP (bit0), GC_BYP (bit1), DC_BYP (bit3)
-    rc |= LMS_WriteLMSReg(dev, 0x0208, byp);
-
-    return rc;
-}
-
 int main(int argc, char** argv)
 {
     // Defaults
@@ -260,6 +143,12 @@ int main(int argc, char** argv)
     int    RAMP_INTERVAL_MS= 20;   // ramp step
     double TONE_SCALE      = TONE_SCALE_DEF;
     bool   DO_CAL          = false;
+    const char* STATE_SAVE = NULL;
+    const char* STATE_LOAD = NULL;
+    char   CAL_CACHE_BUF[TXCAL_PATH_MAX];
+    const char* CAL_CACHE  = CAL_CACHE_BUF;
+    int    CAL_MAX_AGE_S   = TXCAL_MAX_AGE_DEF_S;
+    txcal_default_path(CAL_CACHE_BUF, sizeof(CAL_CACHE_BUF));
 
     // Manual TXTSP correctors (off unless specified)
     bool SET_GI=false, SET_GQ=false, SET_PHASE=false, SET_DCI=false, SET_DCQ=false;
@@ -271,12 +160,12 @@ int main(int argc, char** argv)
         if (!strcmp(a,"-h") || !strcmp(a,"--help")) { usage(argv[0]); return 0; }
         #define NEEDVAL() do{ if (i+1>=argc){ fprintf(stderr,"Missing value for %s\n", a); usage(argv[0]); return 1; } }while(0)
 
-        if (!strcmp(a,"--host-sr")){ NEEDVAL(); if(!parse_hz(argv[++i], &HOST_SR_HZ)) { fprintf(stderr,"Bad --host-sr\n"); return 1; } continue; }
+        if (!strcmp(a,"--host-sr")){ NEEDVAL(); if(!limetx_parse_hz(argv[++i], &HOST_SR_HZ)) { fprintf(stderr,"Bad --host-sr\n"); return 1; } continue; }
         if (!strcmp(a,"--oversample")){ NEEDVAL(); OVERSAMPLE = (int)strtol(argv[++i], NULL, 0); if (OVERSAMPLE<1){ fprintf(stderr,"Bad --oversample\n"); return 1; } continue; }
-        if (!strcmp(a,"--tx-lpf-bw")){ NEEDVAL(); if(!parse_hz(argv[++i], &TX_LPF_BW_HZ)) { fprintf(stderr,"Bad --tx-lpf-bw\n"); return 1; } continue; }
-        if (!strcmp(a,"--lo")){ NEEDVAL(); if(!parse_hz(argv[++i], &LO_HZ)) { fprintf(stderr,"Bad --lo\n"); return 1; } continue; }
-        if (!strcmp(a,"--nco")){ NEEDVAL(); if(!parse_hz(argv[++i], &NCO_FREQ_HZ)) { fprintf(stderr,"Bad --nco\n"); return 1; } continue; }
-        if (!strcmp(a,"--nco-downconvert")){ NEEDVAL(); if(!parse_bool(argv[++i], &NCO_DOWNCONVERT)) { fprintf(stderr,"Bad --nco-downconvert\n"); return 1; } continue; }
+        if (!strcmp(a,"--tx-lpf-bw")){ NEEDVAL(); if(!limetx_parse_hz(argv[++i], &TX_LPF_BW_HZ)) { fprintf(stderr,"Bad --tx-lpf-bw\n"); return 1; } continue; }
+        if (!strcmp(a,"--lo")){ NEEDVAL(); if(!limetx_parse_hz(argv[++i], &LO_HZ)) { fprintf(stderr,"Bad --lo\n"); return 1; } continue; }
+        if (!strcmp(a,"--nco")){ NEEDVAL(); if(!limetx_parse_hz(argv[++i], &NCO_FREQ_HZ)) { fprintf(stderr,"Bad --nco\n"); return 1; } continue; }
+        if (!strcmp(a,"--nco-downconvert")){ NEEDVAL(); if(!limetx_parse_bool(argv[++i], &NCO_DOWNCONVERT)) { fprintf(stderr,"Bad --nco-downconvert\n"); return 1; } continue; }
 
         if (!strcmp(a,"--tx-gain")){ NEEDVAL(); TX_GAIN_DB = (int)strtol(argv[++i], NULL, 0); continue; }
         if (!strcmp(a,"--tx-gain-start")){ NEEDVAL(); TX_GAIN_START = (int)strtol(argv[++i], NULL, 0); continue; }
@@ -285,7 +174,11 @@ int main(int argc, char** argv)
 
         if (!strcmp(a,"--tone-scale")){ NEEDVAL(); TONE_SCALE = strtod(argv[++i], NULL); continue; }
 
-        if (!strcmp(a,"--calibrate")){ NEEDVAL(); if(!parse_bool(argv[++i], &DO_CAL)) { fprintf(stderr,"Bad --calibrate\n"); return 1; } continue; }
+        if (!strcmp(a,"--calibrate")){ NEEDVAL(); if(!limetx_parse_bool(argv[++i], &DO_CAL)) { fprintf(stderr,"Bad --calibrate\n"); return 1; } continue; }
+        if (!strcmp(a,"--state-save")){ NEEDVAL(); STATE_SAVE = argv[++i]; continue; }
+        if (!strcmp(a,"--state-load")){ NEEDVAL(); STATE_LOAD = argv[++i]; continue; }
+        if (!strcmp(a,"--cal-cache")){ NEEDVAL(); CAL_CACHE = argv[++i]; if (!strcmp(CAL_CACHE,"off")) CAL_CACHE = NULL; continue; }
+        if (!strcmp(a,"--cal-cache-max-age")){ NEEDVAL(); CAL_MAX_AGE_S = (int)strtol(argv[++i], NULL, 0); continue; }
 
         // Manual correctors
         if (!strcmp(a,"--set-gain-i")){ NEEDVAL(); SET_GI=true;    MAN_GI    = (int)strtol(argv[++i], NULL, 0); MAN_GI    = clampi(MAN_GI,    0, 2047); continue; }
@@ -308,19 +201,25 @@ int main(int argc, char** argv)
     if (TONE_SCALE > 1.0) TONE_SCALE = 1.0;
 
     lms_device_t* dev = NULL;
+    limetx_regs_t  regs;
     lms_stream_t  txs;
     int16_t*      buf = NULL;
 
     signal(SIGINT, on_sigint);
 
     // 1) Open device
+    tx_boot_t boot;
+    tx_boot_begin(&boot, CH);
+
     lms_info_str_t list[8];
     int n = LMS_GetDeviceList(list);
     if (n < 1) { fprintf(stderr,"No LimeSDR found\n"); return 1; }
     if (LMS_Open(&dev, list[0], NULL)) { fprintf(stderr,"LMS_Open failed: %s\n", LMS_GetLastErrorMessage()); return 1; }
+    tx_boot_attach(&boot, dev);
+    limetx_regs_init(&regs, dev);
 
     // 2) Basic setup
-    CHECK(LMS_Init(dev));
+    CHECK(tx_boot_init_device(&boot, STATE_LOAD));
 
     uint16_t dac;
     LMS_VCTCXORead(dev, &dac);
@@ -331,7 +230,7 @@ int main(int argc, char** argv)
     LMS_VCTCXORead(dev, &dac);
     printf("After set VCTCXO DAC: %u\n", dac);
 
-    if (DO_CAL) {
+    if (DO_CAL && !boot.loaded) {
         CHECK(LMS_Reset(dev));
         printf("device reset to defaults\n");
     }
@@ -340,18 +239,18 @@ int main(int argc, char** argv)
     printf("TX channel enabled.\n");
 
     // Sample rates
-    CHECK(LMS_SetSampleRate(dev, HOST_SR_HZ, OVERSAMPLE));
+    CHECK(tx_boot_sample_rate(&boot, HOST_SR_HZ, OVERSAMPLE));
     print_sr(dev);
 
     // // TX LPF/BW
     // CHECK(LMS_SetLPFBW(dev, LMS_CH_TX, CH, TX_LPF_BW_HZ));
 
     // Set initial gain (start of ramp)
-    CHECK(LMS_SetGaindB(dev, LMS_CH_TX, CH, TX_GAIN_START));
+    CHECK(tx_boot_gain(&boot, TX_GAIN_START));
     print_gain(dev);
 
     // LO
-    CHECK(LMS_SetLOFrequency(dev, LMS_CH_TX, CH, LO_HZ));
+    CHECK(tx_boot_lo(&boot, LO_HZ));
     print_lo(dev);
 
     // // 3) NCO -> RF sine at LO ± NCO
@@ -364,34 +263,39 @@ int main(int argc, char** argv)
     // }
 
     // ---- Parameter snapshot(s) before/after calibration as requested ----
-    print_snapshot(dev, DO_CAL ? "BEFORE calibration" : "Parameters (calibration OFF)",
+    print_snapshot(dev, &regs, DO_CAL ? "BEFORE calibration" : "Parameters (calibration OFF)",
                    TX_LPF_BW_HZ, NCO_FREQ_HZ, NCO_DOWNCONVERT, TONE_SCALE);
 
     int calib_rc = 0;
     if (DO_CAL) {
-        printf("Running LMS_Calibrate(TX ch=%d, bw=%.3f MHz)...\n", CH, TX_LPF_BW_HZ/1e6);
-        calib_rc = LMS_Calibrate(dev, LMS_CH_TX, CH, TX_LPF_BW_HZ, 0);
+        printf("Calibrating TX ch=%d, bw=%.3f MHz (cache: %s)...\n", CH, TX_LPF_BW_HZ/1e6, CAL_CACHE ? CAL_CACHE : "off");
+        txcal_key_t cal_key;
+        calib_rc = txcal_key_init(&cal_key, dev, CH, LO_HZ, NCO_FREQ_HZ, TX_LPF_BW_HZ);
+        if (!calib_rc) calib_rc = txcal_calibrate(&regs, &cal_key, CAL_CACHE, CAL_MAX_AGE_S);
         if (calib_rc) fprintf(stderr,"LMS_Calibrate returned %d: %s\n", calib_rc, LMS_GetLastErrorMessage());
         else          printf("Calibration OK.\n");
 
         // Print AFTER calibration snapshot
-        print_snapshot(dev, "AFTER calibration",
+        print_snapshot(dev, &regs, "AFTER calibration",
                        TX_LPF_BW_HZ, NCO_FREQ_HZ, NCO_DOWNCONVERT, TONE_SCALE);
     }
 
     // If manual correctors are requested, apply them now (after calibration so they override)
     if (SET_GI || SET_GQ || SET_PHASE || SET_DCI || SET_DCQ) {
-        CHECK(apply_manual_txtsp(dev, CH,
+        CHECK(limetx_apply_manual(&regs, CH,
                                  SET_GI, MAN_GI,
                                  SET_GQ, MAN_GQ,
                                  SET_PHASE, MAN_PHASE,
                                  SET_DCI, MAN_DCI,
                                  SET_DCQ, MAN_DCQ));
-        print_snapshot(dev, DO_CAL ? "AFTER manual correctors (override calibration)" : "AFTER manual correctors",
+        print_snapshot(dev, &regs, DO_CAL ? "AFTER manual correctors (override calibration)" : "AFTER manual correctors",
                        TX_LPF_BW_HZ, NCO_FREQ_HZ, NCO_DOWNCONVERT, TONE_SCALE);
     }
     // --------------------------------------------------------------------
 
+    tx_boot_mark(&boot, "correctors");
+    if (STATE_SAVE) tx_boot_save(&boot, STATE_SAVE);
+
     // 4) TX stream
     memset(&txs, 0, sizeof(txs));
     txs.channel  = CH;
@@ -401,6 +305,8 @@ int main(int argc, char** argv)
     CHECK(LMS_SetupStream(dev, &txs));
     CHECK(LMS_StartStream(&txs));
     printf("TX stream started (fifo=%d samples, fmt=I16).\n", FIFO_SIZE_SAMPLES);
+    tx_boot_mark(&boot, "stream");
+    tx_boot_print(&boot);
 
     // Baseband: constant DC IQ -> the NCO turns this into an RF sine at LO ± NCO.
     buf = (int16_t*)malloc(2*BUF_SAMPLES*sizeof(int16_t));
@@ -1,4 +1,7 @@
 #include "lime/LimeSuite.h"
+#include "limetx.h"
+#include "tx_boot.h"
+#include "tx_calcache.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -36,29 +39,6 @@ static uint64_t now_ms(void){
 }
 static int clampi(int v, int lo, int hi){ if (v<lo) return lo; if (v>hi) return hi; return v; }
 
-static bool parse_bool(const char* s, bool* out){
-    if (!s || !out) return false;
-    if (!strcasecmp(s,"1")||!strcasecmp(s,"true") ||!strcasecmp(s,"yes")||!strcasecmp(s,"on"))  { *out=true;  return true; }
-    if (!strcasecmp(s,"0")||!strcasecmp(s,"false")||!strcasecmp(s,"no") ||!strcasecmp(s,"off")) { *out=false; return true; }
-    return false;
-}
-static bool parse_hz(const char* s, double* out){
-    if (!s || !out) return false;
-    char* end=NULL; double v=strtod(s,&end);
-    if (end && *end!='\0'){
-        while (*end && isspace((unsigned char)*end)) end++;
-        if (*end){
-            double mul=1.0; char c=(char)tolower((unsigned char)*end);
-            if (c=='k') mul=1e3; else if (c=='m') mul=1e6; else if (c=='g') mul=1e9; else return false;
-            end++;
-            while (*end && isspace((unsigned char)*end)) end++;
-            if (*end!='\0') return false;
-            v*=mul;
-        }
-    }
-    *out=v; return true;
-}
-
 static void print_sr(lms_device_t* dev){
     double host=0, rf=0;
     if (!LMS_GetSampleRate(dev, LMS_CH_TX, CH, &host, &rf))
@@ -101,6 +81,8 @@ static void usage(const char* prog){
         "\n"
         "Calibration:\n"
         "  --calibrate <0|1|true|false>  Run LMS_Calibrate(TX)      [default false]\n"
+        "  --cal-cache <path|off>        Reuse TX calibrations      [default ~/.cache/limesdr_tests/tx_cal.txt]\n"
+        "  --cal-cache-max-age <s>       Recalibrate older entries  [default 604800]\n"
         "  --set-gain-i <0..2047>        Manually set GCORRI (I gain)\n"
         "  --set-gain-q <0..2047>        Manually set GCORRQ (Q gain)\n"
         "  --set-phase  <-2047..2047>    Manually set IQCORR (phase)\n"
@@ -108,61 +90,13 @@ static void usage(const char* prog){
         "  --set-dc-q   <-128..127>      Manually set DCCORRQ (Q DC)\n"
         "\n"
         "Misc:\n"
+        "  --state-save <file>     Save the configured chip state (LMS_SaveConfig)\n"
+        "  --state-load <file>     Warm start: load state instead of LMS_Init and\n"
+        "                          skip setters whose readback already matches\n"
         "  -h, --help              Show this help\n\n", prog);
 }
 
-static int set_mac_channel(lms_device_t* dev, int ch){
-    uint16_t v = 0;
-    if (LMS_ReadLMSReg(dev, 0x0020, &v)) return -1;
-    v = (uint16_t)((v & ~0x3) | (ch==0 ? 0x1 : 0x2));
-    return LMS_WriteLMSReg(dev, 0x0020, v);
-}
-static void print_tx_correctors(lms_device_t* dev, int ch){
-    if (set_mac_channel(dev, ch)) {
-        fprintf(stderr, "WARN: can't set MAC for channel %c\n", ch? 'B':'A');
-        return;
-    }
-    uint16_t reg_gq=0, reg_gi=0, reg_iq=0, reg_dc=0, reg_byp=0;
-    (void)LMS_ReadLMSReg(dev, 0x0201, &reg_gq);
-    (void)LMS_ReadLMSReg(dev, 0x0202, &reg_gi);
-    (void)LMS_ReadLMSReg(dev, 0x0203, &reg_iq);
-    (void)LMS_ReadLMSReg(dev, 0x0204, &reg_dc);
-    (void)LMS_ReadLMSReg(dev, 0x0208, &reg_byp);
-
-    int gq_u   = (int)(reg_gq & 0x07FF);
-    int gi_u   = (int)(reg_gi & 0x07FF);
-    int16_t iq_s = (int16_t)(reg_iq & 0x0FFF); if (iq_s & 0x0800) iq_s |= 0xF000;
-    int8_t dci_s = (int8_t)((reg_dc >> 8) & 0xFF);
-    int8_t dcq_s = (int8_t)(reg_dc & 0xFF);
-
-    const double gq = gq_u / 2048.0;
-    const double gi = gi_u / 2048.0;
-    const double gq_db = 20.0*log10(gq>0?gq:1e-9);
-    const double gi_db = 20.0*log10(gi>0?gi:1e-9);
-
-    const double tan_half = iq_s / 2048.0;
-    const double alpha_rad = 2.0 * atan(tan_half);
-    const double alpha_deg = alpha_rad * 180.0 / M_PI;
-
-    const double dci_norm = dci_s / 128.0;
-    const double dcq_norm = dcq_s / 128.0;
-
-    const bool ph_bypass = (reg_byp & (1u<<0)) != 0;
-    const bool gc_bypass = (reg_byp & (1u<<1)) != 0;
-    const bool dc_bypass = (reg_byp & (1u<<3)) != 0;
-
-    printf("TXTSP correctors (CH %c):\n", ch? 'B':'A');
-    printf("  Gain:   GCORRI=%4d  (%.6f, %+6.2f dB)%s,  GCORRQ=%4d  (%.6f, %+6.2f dB)%s\n",
-           gi_u, gi, gi_db, gc_bypass?" [BYPASSED]":"",
-           gq_u, gq, gq_db, gc_bypass?" [BYPASSED]":"");
-    printf("  Phase:  IQCORR=%5d  -> phase ≈ %+8.4f deg%s\n",
-           (int)iq_s, alpha_deg, ph_bypass?" [BYPASSED]":"");
-    printf("  DC:     DCCORRI=%4d (%.5f FS)%s,  DCCORRQ=%4d (%.5f FS)%s\n",
-           (int)dci_s, dci_norm, dc_bypass?" [BYPASSED]":"",
-           (int)dcq_s, dcq_norm, dc_bypass?" [BYPASSED]":"");
-}
-
-static void print_snapshot(lms_device_t* dev,
+static void print_snapshot(lms_device_t* dev, limetx_regs_t* regs,
                            const char* title,
                            double requested_tx_lpf_bw_hz,
                            double requested_nco_hz,
@@ -187,57 +121,10 @@ static void print_snapshot(lms_device_t* dev,
     printf(" Target RF    : %.6f MHz (computed from LO±NCO)\n", rf_hz/1e6);
     printf(" TX Gain (dB) : %u (current)\n", gdb);
     printf(" Tone scale   : %.2f (fraction of full-scale)\n", tone_scale);
-    print_tx_correctors(dev, CH);
+    limetx_print_correctors(regs, CH);
     printf("=============================================================\n");
 }
 
-static int apply_manual_txtsp(lms_device_t* dev, int ch,
-                              bool have_gi,    int gi,
-                              bool have_gq,    int gq,
-                              bool have_phase, int phase,
-                              bool have_dci,   int dci,
-                              bool have_dcq,   int dcq)
-{
-    if (set_mac_channel(dev, ch)) return -1;
-
-    int rc = 0;
-
-    if (have_gi) {
-        gi = clampi(gi, 0, 2047);
-        rc |= LMS_WriteLMSReg(dev, 0x0202, (uint16_t)((uint16_t)gi & 0x07FF));
-    }
-    if (have_gq) {
-        gq = clampi(gq, 0, 2047);
-        rc |= LMS_WriteLMSReg(dev, 0x0201, (uint16_t)((uint16_t)gq & 0x07FF));
-    }
-    if (have_phase) {
-        phase = clampi(phase, -2047, 2047);
-        uint16_t iq12 = (uint16_t)((uint16_t)phase & 0x0FFF);
-        rc |= LMS_WriteLMSReg(dev, 0x0203, iq12);
-    }
-
-    if (have_dci || have_dcq) {
-        uint16_t reg_dc = 0;
-        rc |= LMS_ReadLMSReg(dev, 0x0204, &reg_dc);
-        if (have_dci) {
-            int8_t dci_s = (int8_t)clampi(dci, -128, 127);
-            reg_dc = (uint16_t)((reg_dc & 0x00FFu) | ((uint16_t)(uint8_t)dci_s << 8));
-        }
-        if (have_dcq) {
-            int8_t dcq_s = (int8_t)clampi(dcq, -128, 127);
-            reg_dc = (uint16_t)((reg_dc & 0xFF00u) | (uint16_t)(uint8_t)dcq_s);
-        }
-        rc |= LMS_WriteLMSReg(dev, 0x0204, reg_dc);
-    }
-
-    uint16_t byp = 0;
-    rc |= LMS_ReadLMSReg(dev, 0x0208, &byp);
-    byp &= (uint16_t)~((1u<<0) | (1u<<1) | (1u<<3));
-    rc |= LMS_WriteLMSReg(dev, 0x0208, byp);
-
-    return rc;
-}
-
 int main(int argc, char** argv)
 {
     double HOST_SR_HZ      = 5e6;
@@ -252,6 +139,12 @@ int main(int argc, char** argv)
     int    RAMP_INTERVAL_MS= 20;
     double TONE_SCALE      = TONE_SCALE_DEF;
     bool   DO_CAL          = false;
+    const char* STATE_SAVE = NULL;
+    const char* STATE_LOAD = NULL;
+    char   CAL_CACHE_BUF[TXCAL_PATH_MAX];
+    const char* CAL_CACHE  = CAL_CACHE_BUF;
+    int    CAL_MAX_AGE_S   = TXCAL_MAX_AGE_DEF_S;
+    txcal_default_path(CAL_CACHE_BUF, sizeof(CAL_CACHE_BUF));
 
     bool SET_GI=false, SET_GQ=false, SET_PHASE=false, SET_DCI=false, SET_DCQ=false;
     int  MAN_GI=0,     MAN_GQ=0,     MAN_PHASE=0,     MAN_DCI=0,     MAN_DCQ=0;
@@ -261,12 +154,12 @@ int main(int argc, char** argv)
         if (!strcmp(a,"-h") || !strcmp(a,"--help")) { usage(argv[0]); return 0; }
         #define NEEDVAL() do{ if (i+1>=argc){ fprintf(stderr,"Missing value for %s\n", a); usage(argv[0]); return 1; } }while(0)
 
-        if (!strcmp(a,"--host-sr")){ NEEDVAL(); if(!parse_hz(argv[++i], &HOST_SR_HZ)) { fprintf(stderr,"Bad --host-sr\n"); return 1; } continue; }
+        if (!strcmp(a,"--host-sr")){ NEEDVAL(); if(!limetx_parse_hz(argv[++i], &HOST_SR_HZ)) { fprintf(stderr,"Bad --host-sr\n"); return 1; } continue; }
         if (!strcmp(a,"--oversample")){ NEEDVAL(); OVERSAMPLE = (int)strtol(argv[++i], NULL, 0); if (OVERSAMPLE<1){ fprintf(stderr,"Bad --oversample\n"); return 1; } continue; }
-        if (!strcmp(a,"--tx-lpf-bw")){ NEEDVAL(); if(!parse_hz(argv[++i], &TX_LPF_BW_HZ)) { fprintf(stderr,"Bad --tx-lpf-bw\n"); return 1; } continue; }
-        if (!strcmp(a,"--lo")){ NEEDVAL(); if(!parse_hz(argv[++i], &LO_HZ)) { fprintf(stderr,"Bad --lo\n"); return 1; } continue; }
-        if (!strcmp(a,"--nco")){ NEEDVAL(); if(!parse_hz(argv[++i], &NCO_FREQ_HZ)) { fprintf(stderr,"Bad --nco\n"); return 1; } continue; }
-        if (!strcmp(a,"--nco-downconvert")){ NEEDVAL(); if(!parse_bool(argv[++i], &NCO_DOWNCONVERT)) { fprintf(stderr,"Bad --nco-downconvert\n"); return 1; } continue; }
+        if (!strcmp(a,"--tx-lpf-bw")){ NEEDVAL(); if(!limetx_parse_hz(argv[++i], &TX_LPF_BW_HZ)) { fprintf(stderr,"Bad --tx-lpf-bw\n"); return 1; } continue; }
+        if (!strcmp(a,"--lo")){ NEEDVAL(); if(!limetx_parse_hz(argv[++i], &LO_HZ)) { fprintf(stderr,"Bad --lo\n"); return 1; } continue; }
+        if (!strcmp(a,"--nco")){ NEEDVAL(); if(!limetx_parse_hz(argv[++i], &NCO_FREQ_HZ)) { fprintf(stderr,"Bad --nco\n"); return 1; } continue; }
+        if (!strcmp(a,"--nco-downconvert")){ NEEDVAL(); if(!limetx_parse_bool(argv[++i], &NCO_DOWNCONVERT)) { fprintf(stderr,"Bad --nco-downconvert\n"); return 1; } continue; }
 
         if (!strcmp(a,"--tx-gain")){ NEEDVAL(); TX_GAIN_DB = (int)strtol(argv[++i], NULL, 0); continue; }
         if (!strcmp(a,"--tx-gain-start")){ NEEDVAL(); TX_GAIN_START = (int)strtol(argv[++i], NULL, 0); continue; }
@@ -275,7 +168,11 @@ int main(int argc, char** argv)
 
         if (!strcmp(a,"--tone-scale")){ NEEDVAL(); TONE_SCALE = strtod(argv[++i], NULL); continue; }
 
-        if (!strcmp(a,"--calibrate")){ NEEDVAL(); if(!parse_bool(argv[++i], &DO_CAL)) { fprintf(stderr,"Bad --calibrate\n"); return 1; } continue; }
+        if (!strcmp(a,"--calibrate")){ NEEDVAL(); if(!limetx_parse_bool(argv[++i], &DO_CAL)) { fprintf(stderr,"Bad --calibrate\n"); return 1; } continue; }
+        if (!strcmp(a,"--state-save")){ NEEDVAL(); STATE_SAVE = argv[++i]; continue; }
+        if (!strcmp(a,"--state-load")){ NEEDVAL(); STATE_LOAD = argv[++i]; continue; }
+        if (!strcmp(a,"--cal-cache")){ NEEDVAL(); CAL_CACHE = argv[++i]; if (!strcmp(CAL_CACHE,"off")) CAL_CACHE = NULL; continue; }
+        if (!strcmp(a,"--cal-cache-max-age")){ NEEDVAL(); CAL_MAX_AGE_S = (int)strtol(argv[++i], NULL, 0); continue; }
 
         if (!strcmp(a,"--set-gain-i")){ NEEDVAL(); SET_GI=true;    MAN_GI    = (int)strtol(argv[++i], NULL, 0); MAN_GI    = clampi(MAN_GI,    0, 2047); continue; }
         if (!strcmp(a,"--set-gain-q")){ NEEDVAL(); SET_GQ=true;    MAN_GQ    = (int)strtol(argv[++i], NULL, 0); MAN_GQ    = clampi(MAN_GQ,    0, 2047); continue; }
@@ -296,68 +193,82 @@ int main(int argc, char** argv)
     if (TONE_SCALE > 1.0) TONE_SCALE = 1.0;
 
     lms_device_t* dev = NULL;
+    limetx_regs_t  regs;
     lms_stream_t  txs;
     int16_t*      buf = NULL;
 
     signal(SIGINT, on_sigint);
 
+    tx_boot_t boot;
+    tx_boot_begin(&boot, CH);
+
     lms_info_str_t list[8];
     int n = LMS_GetDeviceList(list);
     if (n < 1) { fprintf(stderr,"No LimeSDR found\n"); return 1; }
     if (LMS_Open(&dev, list[0], NULL)) { fprintf(stderr,"LMS_Open failed: %s\n", LMS_GetLastErrorMessage()); return 1; }
+    tx_boot_attach(&boot, dev);
+    limetx_regs_init(&regs, dev);
 
-    CHECK(LMS_Init(dev));
+    CHECK(tx_boot_init_device(&boot, STATE_LOAD));
 
-    CHECK(LMS_Reset(dev));
-    printf("device reset to defaults\n");
+    if (!boot.loaded) {
+        CHECK(LMS_Reset(dev));
+        printf("device reset to defaults\n");
+    } else {
+        printf("device state restored, reset skipped\n");
+    }
 
     CHECK(LMS_EnableChannel(dev, LMS_CH_TX, CH, true));
     printf("TX channel enabled.\n");
 
-    CHECK(LMS_SetSampleRate(dev, HOST_SR_HZ, OVERSAMPLE));
+    CHECK(tx_boot_sample_rate(&boot, HOST_SR_HZ, OVERSAMPLE));
     print_sr(dev);
 
-    CHECK(LMS_SetLPFBW(dev, LMS_CH_TX, CH, TX_LPF_BW_HZ));
+    CHECK(tx_boot_lpf_bw(&boot, TX_LPF_BW_HZ));
 
-    CHECK(LMS_SetGaindB(dev, LMS_CH_TX, CH, TX_GAIN_START));
+    CHECK(tx_boot_gain(&boot, TX_GAIN_START));
     print_gain(dev);
 
-    CHECK(LMS_SetLOFrequency(dev, LMS_CH_TX, CH, LO_HZ));
+    CHECK(tx_boot_lo(&boot, LO_HZ));
     print_lo(dev);
 
     {
         double freqs[16]={0};
         freqs[NCO_INDEX] = NCO_FREQ_HZ;
-        CHECK(LMS_SetNCOFrequency(dev, true, CH, freqs, 0.0));
-        CHECK(LMS_SetNCOIndex    (dev, true, CH, NCO_INDEX, NCO_DOWNCONVERT));
+        CHECK(tx_boot_nco(&boot, freqs, NCO_INDEX, NCO_DOWNCONVERT));
         print_nco(dev);
     }
 
-    print_snapshot(dev, DO_CAL ? "BEFORE calibration" : "Parameters (calibration OFF)",
+    print_snapshot(dev, &regs, DO_CAL ? "BEFORE calibration" : "Parameters (calibration OFF)",
                    TX_LPF_BW_HZ, NCO_FREQ_HZ, NCO_DOWNCONVERT, TONE_SCALE);
 
     int calib_rc = 0;
     if (DO_CAL) {
-        printf("Running LMS_Calibrate(TX ch=%d, bw=%.3f MHz)...\n", CH, TX_LPF_BW_HZ/1e6);
-        calib_rc = LMS_Calibrate(dev, LMS_CH_TX, CH, TX_LPF_BW_HZ, 0);
+        printf("Calibrating TX ch=%d, bw=%.3f MHz (cache: %s)...\n", CH, TX_LPF_BW_HZ/1e6, CAL_CACHE ? CAL_CACHE : "off");
+        txcal_key_t cal_key;
+        calib_rc = txcal_key_init(&cal_key, dev, CH, LO_HZ, NCO_FREQ_HZ, TX_LPF_BW_HZ);
+        if (!calib_rc) calib_rc = txcal_calibrate(&regs, &cal_key, CAL_CACHE, CAL_MAX_AGE_S);
         if (calib_rc) fprintf(stderr,"LMS_Calibrate returned %d: %s\n", calib_rc, LMS_GetLastErrorMessage());
         else          printf("Calibration OK.\n");
 
-        print_snapshot(dev, "AFTER calibration",
+        print_snapshot(dev, &regs, "AFTER calibration",
                        TX_LPF_BW_HZ, NCO_FREQ_HZ, NCO_DOWNCONVERT, TONE_SCALE);
     }
 
     if (SET_GI || SET_GQ || SET_PHASE || SET_DCI || SET_DCQ) {
-        CHECK(apply_manual_txtsp(dev, CH,
+        CHECK(limetx_apply_manual(&regs, CH,
                                  SET_GI, MAN_GI,
                                  SET_GQ, MAN_GQ,
                                  SET_PHASE, MAN_PHASE,
                                  SET_DCI, MAN_DCI,
                                  SET_DCQ, MAN_DCQ));
-        print_snapshot(dev, DO_CAL ? "AFTER manual correctors (override calibration)" : "AFTER manual correctors",
+        print_snapshot(dev, &regs, DO_CAL ? "AFTER manual correctors (override calibration)" : "AFTER manual correctors",
                        TX_LPF_BW_HZ, NCO_FREQ_HZ, NCO_DOWNCONVERT, TONE_SCALE);
     }
 
+    tx_boot_mark(&boot, "correctors");
+    if (STATE_SAVE) tx_boot_save(&boot, STATE_SAVE);
+
     memset(&txs, 0, sizeof(txs));
     txs.channel  = CH;
     txs.isTx     = true;
@@ -366,6 +277,8 @@ int main(int argc, char** argv)
     CHECK(LMS_SetupStream(dev, &txs));
     CHECK(LMS_StartStream(&txs));
     printf("TX stream started (fifo=%d samples, fmt=I16).\n", FIFO_SIZE_SAMPLES);
+    tx_boot_mark(&boot, "stream");
+    tx_boot_print(&boot);
 
     buf = (int16_t*)malloc(2*BUF_SAMPLES*sizeof(int16_t));
     if (!buf) { fprintf(stderr,"malloc failed\n"); goto cleanup; }
@@ -1,4 +1,17 @@
+#define _GNU_SOURCE
+#include "iq_ofdm.h"
+#include "iq_ramp.h"
+#include "iq_tone.h"
 #include "lime/LimeSuite.h"
+#include "limetx.h"
+#include "tx_boot.h"
+#include "tx_burst.h"
+#include "tx_calcache.h"
+#include "tx_ctrl.h"
+#include "tx_hop.h"
+#include "tx_rt.h"
+#include "tx_telem.h"
+#include "tx_trim.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -21,6 +34,8 @@
 #define TONE_SCALE_DEF    0.70
 #define TX_GAIN_MIN_DB    0
 #define TX_GAIN_MAX_DB    73
+#define WFM_FMT_I16       1   // LMS_UploadWFM format: int16, full scale +-32767
+#define RAMP_DOWN_MS_DEF  20
 
 #define CHECK(x) do { \
   int __e = (x); \
@@ -30,35 +45,8 @@
 static volatile int keep_running = 1;
 static void on_sigint(int s){ (void)s; keep_running = 0; }
 
-static uint64_t now_ms(void){
-    struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
-    return (uint64_t)ts.tv_sec*1000ull + (uint64_t)(ts.tv_nsec/1000000ull);
-}
 static int clampi(int v, int lo, int hi){ if (v<lo) return lo; if (v>hi) return hi; return v; }
 
-static bool parse_bool(const char* s, bool* out){
-    if (!s || !out) return false;
-    if (!strcasecmp(s,"1")||!strcasecmp(s,"true") ||!strcasecmp(s,"yes")||!strcasecmp(s,"on"))  { *out=true;  return true; }
-    if (!strcasecmp(s,"0")||!strcasecmp(s,"false")||!strcasecmp(s,"no") ||!strcasecmp(s,"off")) { *out=false; return true; }
-    return false;
-}
-static bool parse_hz(const char* s, double* out){
-    if (!s || !out) return false;
-    char* end=NULL; double v=strtod(s,&end);
-    if (end && *end!='\0'){
-        while (*end && isspace((unsigned char)*end)) end++;
-        if (*end){
-            double mul=1.0; char c=(char)tolower((unsigned char)*end);
-            if (c=='k') mul=1e3; else if (c=='m') mul=1e6; else if (c=='g') mul=1e9; else return false;
-            end++;
-            while (*end && isspace((unsigned char)*end)) end++;
-            if (*end!='\0') return false;
-            v*=mul;
-        }
-    }
-    *out=v; return true;
-}
-
 static void print_sr(lms_device_t* dev){
     double host=0, rf=0;
     if (!LMS_GetSampleRate(dev, LMS_CH_TX, CH, &host, &rf))
@@ -89,18 +77,64 @@ static void usage(const char* prog){
         "  --lo <Hz>               LO frequency                     [default 30M]\n"
         "  --nco <Hz>              NCO frequency (magnitude)        [default 15M]\n"
         "  --nco-downconvert <0|1|true|false>  RF=LO-NCO if true    [default true]\n"
+        "  --link-fmt <i12|i16>    USB link format (I12 packs 3 B/frame) [default i16]\n"
         "\n"
         "Gain (smooth ramp):\n"
         "  --tx-gain-start <dB>    Starting TX gain                 [default 0]\n"
         "  --tx-gain <dB>          Target TX gain                   [default 40]\n"
         "  --gain-ramp-ms <ms>     Total ramp duration              [default 2000]\n"
         "  --gain-ramp-interval-ms <ms>  Step interval              [default 20]\n"
+        "  --digital-ramp <off|db|cos>   Ramp per sample in baseband instead of\n"
+        "                                1 dB analog steps (analog gain set once) [default off]\n"
+        "  --ramp-down-ms <ms>     Digital fade-out on Ctrl+C       [default 20]\n"
         "\n"
         "Tone:\n"
-        "  --tone-scale <0..1>     Baseband DC amplitude fraction   [default 0.70]\n"
+        "  --tone-scale <0..1>     Baseband DC amplitude fraction; with --tone,\n"
+        "                          peak of I/Q after crest-factor scaling; with\n"
+        "                          --ofdm, the clip level              [default 0.70]\n"
+        "  --tone <f[:dB[:deg]]>   Add a baseband tone at f Hz offset from the NCO\n"
+        "                          (negative = below), relative level and phase;\n"
+        "                          repeat for multi-tone / two-tone SSB (max 16)\n"
+        "  --sweep <f0~f1/s[:dB[:deg]]>  Add a tone swept linearly f0 -> f1 over s seconds\n"
+        "  --fpga-wfm <0|1|true|false>   Loop the tone in the FPGA waveform player\n"
+        "                                instead of streaming it over USB [default false]\n"
+        "                                (periodic --tone sets upload one full period)\n"
+        "\n"
+        "OFDM (instead of --tone; symbols rendered by a worker pool):\n"
+        "  --ofdm [true|false]     Transmit random-payload OFDM     [default false]\n"
+        "  --ofdm-fft <N>          IFFT size, power of 2, 16..8192  [default 64]\n"
+        "  --ofdm-cp <0..1>        Cyclic prefix, fraction of N     [default 0.25]\n"
+        "  --ofdm-pilots <n>       Pilot subcarriers (total)        [default 6]\n"
+        "  --ofdm-payload <n>      Data subcarriers (total); pilots + payload even [default 22]\n"
+        "  --ofdm-guard <bins>     Unused bins at each band edge    [default 0]\n"
+        "  --ofdm-mod <m>          bpsk|qpsk|8psk|16qam|32psk|64qam [default 16qam]\n"
+        "  --ofdm-papr <dB>        Clip level over RMS              [default 9]\n"
+        "  --ofdm-preamble <n>     Schmidl-Cox preamble symbols per frame (cached) [default 1]\n"
+        "  --ofdm-frame <n>        Data symbols per frame           [default 16]\n"
+        "  --ofdm-repeat <0|1|true|false>  Same payload every frame: one cached\n"
+        "                                frame, no workers, --fpga-wfm capable [default false]\n"
+        "  --ofdm-seed <n>         Payload PRNG seed                [default 12345]\n"
+        "  --ofdm-threads <n>      Symbol workers, 0 = CPUs - 1     [default 0]\n"
+        "\n"
+        "Frequency hopping (NCO table; LO retuned only when a hop leaves the NCO span):\n"
+        "  --hop <f1,f2,..|f0:f1:step>  RF hop frequencies, --lo kept if they all fit\n"
+        "  --hop-dwell-ms <ms>     Time on each frequency           [default 10]\n"
+        "  --hop-guard-us <us>     Mute around each hop, half that again as a fade-out/in\n"
+        "                          on either side                   [default 100]\n"
+        "  --hop-seed <n>          0 = list order, else pseudo-random order [default 0]\n"
+        "\n"
+        "Bursts (timestamped; host and USB idle in between):\n"
+        "  --burst <len_ms>:<period_ms>  Send len_ms of the signal every period_ms,\n"
+        "                          each burst queued to start at an exact sample time\n"
+        "  --burst-lead <ms>       Queue each burst this long before it is due [default 10]\n"
         "\n"
         "Calibration:\n"
         "  --calibrate <0|1|true|false>  Run LMS_Calibrate(TX)      [default false]\n"
+        "  --autotrim [true|false]       Trim image/LO leak over the RX loopback (after\n"
+        "                                LMS_Calibrate with --calibrate) [default false]\n"
+        "  --cal-cache <path|off>        Reuse TX calibrations      [default ~/.cache/limesdr_tests/tx_cal.txt]\n"
+        "  --cal-cache-max-age <s>       Recalibrate older entries  [default 604800]\n"
+        "  --wave-cache <dir|off>        Reuse tone periods         [default ~/.cache/limesdr_tests/wfm]\n"
         "  --set-gain-i <0..2047>        Manually set GCORRI (I gain)\n"
         "  --set-gain-q <0..2047>        Manually set GCORRQ (Q gain)\n"
         "  --set-phase  <-2047..2047>    Manually set IQCORR (phase)\n"
@@ -108,61 +142,21 @@ static void usage(const char* prog){
         "  --set-dc-q   <-128..127>      Manually set DCCORRQ (Q DC)\n"
         "\n"
         "Misc:\n"
+        "  --state-save <file>     Save the configured chip state (LMS_SaveConfig)\n"
+        "  --state-load <file>     Warm start: load state instead of LMS_Init and\n"
+        "                          skip setters whose readback already matches\n"
+        "  --telemetry <spec>      Export stream counters/histograms: jsonl:<path|->,\n"
+        "                          prom-file:<path> or prom:[host:]<port> (HTTP\n"
+        "                          /metrics, loopback unless host is given)\n"
+        "  --telemetry-interval-ms <ms>  Export period            [default 1000]\n"
+        "  --rt [true|false]       Real-time profile: SCHED_FIFO stream thread pinned to\n"
+        "                          its own CPU, mlockall, hugepage buffers\n"
+        "  --rt-cpu <n>            CPU for the stream thread       [default last allowed]\n"
+        "  --rt-prio <1..99>       SCHED_FIFO priority             [default 50]\n"
         "  -h, --help              Show this help\n\n", prog);
 }
 
-static int set_mac_channel(lms_device_t* dev, int ch){
-    uint16_t v = 0;
-    if (LMS_ReadLMSReg(dev, 0x0020, &v)) return -1;
-    v = (uint16_t)((v & ~0x3) | (ch==0 ? 0x1 : 0x2));
-    return LMS_WriteLMSReg(dev, 0x0020, v);
-}
-static void print_tx_correctors(lms_device_t* dev, int ch){
-    if (set_mac_channel(dev, ch)) {
-        fprintf(stderr, "WARN: can't set MAC for channel %c\n", ch? 'B':'A');
-        return;
-    }
-    uint16_t reg_gq=0, reg_gi=0, reg_iq=0, reg_dc=0, reg_byp=0;
-    (void)LMS_ReadLMSReg(dev, 0x0201, &reg_gq);
-    (void)LMS_ReadLMSReg(dev, 0x0202, &reg_gi);
-    (void)LMS_ReadLMSReg(dev, 0x0203, &reg_iq);
-    (void)LMS_ReadLMSReg(dev, 0x0204, &reg_dc);
-    (void)LMS_ReadLMSReg(dev, 0x0208, &reg_byp);
-
-    int gq_u   = (int)(reg_gq & 0x07FF);
-    int gi_u   = (int)(reg_gi & 0x07FF);
-    int16_t iq_s = (int16_t)(reg_iq & 0x0FFF); if (iq_s & 0x0800) iq_s |= 0xF000;
-    int8_t dci_s = (int8_t)((reg_dc >> 8) & 0xFF);
-    int8_t dcq_s = (int8_t)(reg_dc & 0xFF);
-
-    const double gq = gq_u / 2048.0;
-    const double gi = gi_u / 2048.0;
-    const double gq_db = 20.0*log10(gq>0?gq:1e-9);
-    const double gi_db = 20.0*log10(gi>0?gi:1e-9);
-
-    const double tan_half = iq_s / 2048.0;
-    const double alpha_rad = 2.0 * atan(tan_half);
-    const double alpha_deg = alpha_rad * 180.0 / M_PI;
-
-    const double dci_norm = dci_s / 128.0;
-    const double dcq_norm = dcq_s / 128.0;
-
-    const bool ph_bypass = (reg_byp & (1u<<0)) != 0;
-    const bool gc_bypass = (reg_byp & (1u<<1)) != 0;
-    const bool dc_bypass = (reg_byp & (1u<<3)) != 0;
-
-    printf("TXTSP correctors (CH %c):\n", ch? 'B':'A');
-    printf("  Gain:   GCORRI=%4d  (%.6f, %+6.2f dB)%s,  GCORRQ=%4d  (%.6f, %+6.2f dB)%s\n",
-           gi_u, gi, gi_db, gc_bypass?" [BYPASSED]":"",
-           gq_u, gq, gq_db, gc_bypass?" [BYPASSED]":"");
-    printf("  Phase:  IQCORR=%5d  -> phase ≈ %+8.4f deg%s\n",
-           (int)iq_s, alpha_deg, ph_bypass?" [BYPASSED]":"");
-    printf("  DC:     DCCORRI=%4d (%.5f FS)%s,  DCCORRQ=%4d (%.5f FS)%s\n",
-           (int)dci_s, dci_norm, dc_bypass?" [BYPASSED]":"",
-           (int)dcq_s, dcq_norm, dc_bypass?" [BYPASSED]":"");
-}
-
-static void print_snapshot(lms_device_t* dev,
+static void print_snapshot(lms_device_t* dev, limetx_regs_t* regs,
                            const char* title,
                            double requested_tx_lpf_bw_hz,
                            double requested_nco_hz,
@@ -187,55 +181,40 @@ static void print_snapshot(lms_device_t* dev,
     printf(" Target RF    : %.6f MHz (computed from LO±NCO)\n", rf_hz/1e6);
     printf(" TX Gain (dB) : %u (current)\n", gdb);
     printf(" Tone scale   : %.2f (fraction of full-scale)\n", tone_scale);
-    print_tx_correctors(dev, CH);
+    limetx_print_correctors(regs, CH);
     printf("=============================================================\n");
 }
 
-static int apply_manual_txtsp(lms_device_t* dev, int ch,
-                              bool have_gi,    int gi,
-                              bool have_gq,    int gq,
-                              bool have_phase, int phase,
-                              bool have_dci,   int dci,
-                              bool have_dcq,   int dcq)
-{
-    if (set_mac_channel(dev, ch)) return -1;
-
-    int rc = 0;
-
-    if (have_gi) {
-        gi = clampi(gi, 0, 2047);
-        rc |= LMS_WriteLMSReg(dev, 0x0202, (uint16_t)((uint16_t)gi & 0x07FF));
-    }
-    if (have_gq) {
-        gq = clampi(gq, 0, 2047);
-        rc |= LMS_WriteLMSReg(dev, 0x0201, (uint16_t)((uint16_t)gq & 0x07FF));
+// Upload the constant tone buffer to the FPGA waveform player and loop it there, so no samples
+// cross USB afterwards. Returns false when the gateware/API refuses (caller streams instead).
+static bool start_fpga_wfm(lms_device_t* dev, const int16_t* buf, size_t frames){
+    const void* src[1] = { buf };
+    if (LMS_UploadWFM(dev, src, 1, frames, WFM_FMT_I16)) {
+        fprintf(stderr,"WARN: LMS_UploadWFM failed (%s), falling back to host streaming\n", LMS_GetLastErrorMessage());
+        return false;
     }
-    if (have_phase) {
-        phase = clampi(phase, -2047, 2047);
-        uint16_t iq12 = (uint16_t)((uint16_t)phase & 0x0FFF);
-        rc |= LMS_WriteLMSReg(dev, 0x0203, iq12);
+    if (LMS_EnableTxWFM(dev, CH, true)) {
+        fprintf(stderr,"WARN: LMS_EnableTxWFM failed (%s), falling back to host streaming\n", LMS_GetLastErrorMessage());
+        return false;
     }
+    printf("FPGA waveform player: %zu samples uploaded and looping, host streaming off.\n", frames);
+    return true;
+}
 
-    if (have_dci || have_dcq) {
-        uint16_t reg_dc = 0;
-        rc |= LMS_ReadLMSReg(dev, 0x0204, &reg_dc);
-        if (have_dci) {
-            int8_t dci_s = (int8_t)clampi(dci, -128, 127);
-            reg_dc = (uint16_t)((reg_dc & 0x00FFu) | ((uint16_t)(uint8_t)dci_s << 8));
-        }
-        if (have_dcq) {
-            int8_t dcq_s = (int8_t)clampi(dcq, -128, 127);
-            reg_dc = (uint16_t)((reg_dc & 0xFF00u) | (uint16_t)(uint8_t)dcq_s);
-        }
-        rc |= LMS_WriteLMSReg(dev, 0x0204, reg_dc);
-    }
-
-    uint16_t byp = 0;
-    rc |= LMS_ReadLMSReg(dev, 0x0208, &byp);
-    byp &= (uint16_t)~((1u<<0) | (1u<<1) | (1u<<3));
-    rc |= LMS_WriteLMSReg(dev, 0x0208, byp);
-
-    return rc;
+// Fade the repeating src chunk (or the running tone / OFDM generator, when set) from the current digital
+// level to silence; the last sent chunk ends in zeros, so it replaces the zero buffer otherwise sent
+// at cleanup.
+static bool ramp_down(lms_stream_t* txs, iq_ramp_t* ramp, iq_ramp_shape_t shape,
+                      const int16_t* src, iq_tone_src_t* tones, iq_ofdm_src_t* ofdm,
+                      int16_t* out, size_t chunk, uint64_t frames)
+{
+    iq_ramp_begin(ramp, shape, iq_ramp_level_db(ramp), IQ_RAMP_MUTE_DB, frames);
+    do {
+        iq_ramp_apply(ramp, out, ofdm ? iq_ofdm_src_next(ofdm) : tones ? iq_tone_src_next(tones) : src, chunk);
+        lms_stream_meta_t meta; memset(&meta,0,sizeof(meta));
+        if (LMS_SendStream(txs, out, chunk, &meta, SEND_TIMEOUT_MS) < 0) return false;
+    } while (iq_ramp_active(ramp));
+    return true;
 }
 
 int main(int argc, char** argv)
@@ -250,8 +229,39 @@ int main(int argc, char** argv)
     int    TX_GAIN_START   = 0;
     int    RAMP_MS         = 2000;
     int    RAMP_INTERVAL_MS= 20;
+    iq_ramp_shape_t DIG_RAMP = IQ_RAMP_OFF;
+    int    RAMP_DOWN_MS    = RAMP_DOWN_MS_DEF;
     double TONE_SCALE      = TONE_SCALE_DEF;
     bool   DO_CAL          = false;
+    bool   AUTOTRIM        = false;
+    const char* STATE_SAVE = NULL;
+    const char* STATE_LOAD = NULL;
+    char   CAL_CACHE_BUF[TXCAL_PATH_MAX];
+    const char* CAL_CACHE  = CAL_CACHE_BUF;
+    int    CAL_MAX_AGE_S   = TXCAL_MAX_AGE_DEF_S;
+    txcal_default_path(CAL_CACHE_BUF, sizeof(CAL_CACHE_BUF));
+    char   WAVE_CACHE_BUF[IQ_WFC_PATH_MAX];
+    const char* WAVE_CACHE = WAVE_CACHE_BUF;
+    iq_wfc_default_dir(WAVE_CACHE_BUF, sizeof(WAVE_CACHE_BUF));
+    bool   FPGA_WFM        = false;
+    int    LINK_FMT        = LMS_LINK_FMT_I16;
+    iq_tone_t TONES[IQ_TONE_MAX];
+    int    N_TONES         = 0;
+    bool   OFDM            = false;
+    iq_ofdm_cfg_t OFDM_CFG;
+    iq_ofdm_cfg_default(&OFDM_CFG);
+    int    OFDM_THREADS    = 0;
+    bool   HOP             = false;
+    tx_hop_cfg_t HOP_CFG;
+    tx_hop_cfg_default(&HOP_CFG);
+    bool   BURST           = false;
+    double BURST_LEN_MS    = 0, BURST_PERIOD_MS = 0;
+    double BURST_LEAD_MS   = TX_BURST_QUEUE_MS_DEF;
+    int    TELEM_MODE      = TX_TELEM_OFF;
+    char   TELEM_TARGET[TX_TELEM_PATH_MAX] = "";
+    int    TELEM_INTERVAL_MS = TX_TELEM_INTERVAL_MS_DEF;
+    tx_rt_t rt;
+    tx_rt_init(&rt);
 
     bool SET_GI=false, SET_GQ=false, SET_PHASE=false, SET_DCI=false, SET_DCQ=false;
     int  MAN_GI=0,     MAN_GQ=0,     MAN_PHASE=0,     MAN_DCI=0,     MAN_DCQ=0;
@@ -261,21 +271,65 @@ int main(int argc, char** argv)
         if (!strcmp(a,"-h") || !strcmp(a,"--help")) { usage(argv[0]); return 0; }
         #define NEEDVAL() do{ if (i+1>=argc){ fprintf(stderr,"Missing value for %s\n", a); usage(argv[0]); return 1; } }while(0)
 
-        if (!strcmp(a,"--host-sr")){ NEEDVAL(); if(!parse_hz(argv[++i], &HOST_SR_HZ)) { fprintf(stderr,"Bad --host-sr\n"); return 1; } continue; }
+        if (!strcmp(a,"--host-sr")){ NEEDVAL(); if(!limetx_parse_hz(argv[++i], &HOST_SR_HZ)) { fprintf(stderr,"Bad --host-sr\n"); return 1; } continue; }
         if (!strcmp(a,"--oversample")){ NEEDVAL(); OVERSAMPLE = (int)strtol(argv[++i], NULL, 0); if (OVERSAMPLE<1){ fprintf(stderr,"Bad --oversample\n"); return 1; } continue; }
-        if (!strcmp(a,"--tx-lpf-bw")){ NEEDVAL(); if(!parse_hz(argv[++i], &TX_LPF_BW_HZ)) { fprintf(stderr,"Bad --tx-lpf-bw\n"); return 1; } continue; }
-        if (!strcmp(a,"--lo")){ NEEDVAL(); if(!parse_hz(argv[++i], &LO_HZ)) { fprintf(stderr,"Bad --lo\n"); return 1; } continue; }
-        if (!strcmp(a,"--nco")){ NEEDVAL(); if(!parse_hz(argv[++i], &NCO_FREQ_HZ)) { fprintf(stderr,"Bad --nco\n"); return 1; } continue; }
-        if (!strcmp(a,"--nco-downconvert")){ NEEDVAL(); if(!parse_bool(argv[++i], &NCO_DOWNCONVERT)) { fprintf(stderr,"Bad --nco-downconvert\n"); return 1; } continue; }
+        if (!strcmp(a,"--tx-lpf-bw")){ NEEDVAL(); if(!limetx_parse_hz(argv[++i], &TX_LPF_BW_HZ)) { fprintf(stderr,"Bad --tx-lpf-bw\n"); return 1; } continue; }
+        if (!strcmp(a,"--lo")){ NEEDVAL(); if(!limetx_parse_hz(argv[++i], &LO_HZ)) { fprintf(stderr,"Bad --lo\n"); return 1; } continue; }
+        if (!strcmp(a,"--nco")){ NEEDVAL(); if(!limetx_parse_hz(argv[++i], &NCO_FREQ_HZ)) { fprintf(stderr,"Bad --nco\n"); return 1; } continue; }
+        if (!strcmp(a,"--nco-downconvert")){ NEEDVAL(); if(!limetx_parse_bool(argv[++i], &NCO_DOWNCONVERT)) { fprintf(stderr,"Bad --nco-downconvert\n"); return 1; } continue; }
+        if (!strcmp(a,"--link-fmt")){ NEEDVAL(); if(!limetx_parse_link_fmt(argv[++i], &LINK_FMT)) { fprintf(stderr,"Bad --link-fmt (i12|i16)\n"); return 1; } continue; }
 
         if (!strcmp(a,"--tx-gain")){ NEEDVAL(); TX_GAIN_DB = (int)strtol(argv[++i], NULL, 0); continue; }
         if (!strcmp(a,"--tx-gain-start")){ NEEDVAL(); TX_GAIN_START = (int)strtol(argv[++i], NULL, 0); continue; }
         if (!strcmp(a,"--gain-ramp-ms")){ NEEDVAL(); RAMP_MS = (int)strtol(argv[++i], NULL, 0); continue; }
         if (!strcmp(a,"--gain-ramp-interval-ms")){ NEEDVAL(); RAMP_INTERVAL_MS = (int)strtol(argv[++i], NULL, 0); continue; }
+        if (!strcmp(a,"--digital-ramp")){ NEEDVAL(); if(!iq_ramp_parse_shape(argv[++i], &DIG_RAMP)) { fprintf(stderr,"Bad --digital-ramp\n"); return 1; } continue; }
+        if (!strcmp(a,"--ramp-down-ms")){ NEEDVAL(); RAMP_DOWN_MS = (int)strtol(argv[++i], NULL, 0); continue; }
 
         if (!strcmp(a,"--tone-scale")){ NEEDVAL(); TONE_SCALE = strtod(argv[++i], NULL); continue; }
-
-        if (!strcmp(a,"--calibrate")){ NEEDVAL(); if(!parse_bool(argv[++i], &DO_CAL)) { fprintf(stderr,"Bad --calibrate\n"); return 1; } continue; }
+        if (!strcmp(a,"--tone") || !strcmp(a,"--sweep")){
+            NEEDVAL();
+            if (N_TONES >= IQ_TONE_MAX) { fprintf(stderr,"Too many tones (max %d)\n", IQ_TONE_MAX); return 1; }
+            const bool sweep = !strcmp(a,"--sweep");
+            if (!iq_tone_parse(argv[++i], limetx_parse_hz, &TONES[N_TONES]) || sweep != (TONES[N_TONES].sweep_s > 0.0)) {
+                fprintf(stderr,"Bad %s\n", a); return 1;
+            }
+            N_TONES++;
+            continue;
+        }
+        if (!strcmp(a,"--ofdm")){ OFDM = true; if (i+1 < argc){ bool v=false; if (limetx_parse_bool(argv[i+1], &v)){ OFDM = v; i++; } } continue; }
+        if (!strcmp(a,"--ofdm-fft")){ NEEDVAL(); OFDM_CFG.fft_n = (int)strtol(argv[++i], NULL, 0); continue; }
+        if (!strcmp(a,"--ofdm-cp")){ NEEDVAL(); OFDM_CFG.cp_frac = strtod(argv[++i], NULL); continue; }
+        if (!strcmp(a,"--ofdm-pilots")){ NEEDVAL(); OFDM_CFG.pilots = (int)strtol(argv[++i], NULL, 0); continue; }
+        if (!strcmp(a,"--ofdm-payload")){ NEEDVAL(); OFDM_CFG.payload = (int)strtol(argv[++i], NULL, 0); continue; }
+        if (!strcmp(a,"--ofdm-guard")){ NEEDVAL(); OFDM_CFG.guard = (int)strtol(argv[++i], NULL, 0); continue; }
+        if (!strcmp(a,"--ofdm-mod")){ NEEDVAL(); if(!iq_ofdm_parse_mod(argv[++i], &OFDM_CFG.mod)) { fprintf(stderr,"Bad --ofdm-mod (bpsk|qpsk|8psk|16qam|32psk|64qam)\n"); return 1; } continue; }
+        if (!strcmp(a,"--ofdm-papr")){ NEEDVAL(); OFDM_CFG.papr_db = strtod(argv[++i], NULL); continue; }
+        if (!strcmp(a,"--ofdm-preamble")){ NEEDVAL(); OFDM_CFG.preamble = (int)strtol(argv[++i], NULL, 0); continue; }
+        if (!strcmp(a,"--ofdm-frame")){ NEEDVAL(); OFDM_CFG.frame = (int)strtol(argv[++i], NULL, 0); continue; }
+        if (!strcmp(a,"--ofdm-repeat")){ NEEDVAL(); if(!limetx_parse_bool(argv[++i], &OFDM_CFG.repeat)) { fprintf(stderr,"Bad --ofdm-repeat\n"); return 1; } continue; }
+        if (!strcmp(a,"--ofdm-seed")){ NEEDVAL(); OFDM_CFG.seed = strtoull(argv[++i], NULL, 0); continue; }
+        if (!strcmp(a,"--ofdm-threads")){ NEEDVAL(); OFDM_THREADS = (int)strtol(argv[++i], NULL, 0); if (OFDM_THREADS<0 || OFDM_THREADS>IQ_OFDM_THREADS_MAX){ fprintf(stderr,"Bad --ofdm-threads (0..%d)\n", IQ_OFDM_THREADS_MAX); return 1; } continue; }
+        if (!strcmp(a,"--hop")){ NEEDVAL(); if(!tx_hop_parse_list(argv[++i], &HOP_CFG)) { fprintf(stderr,"Bad --hop (f1,f2,... or f0:f1:step, max %d)\n", TX_HOP_MAX); return 1; } HOP = true; continue; }
+        if (!strcmp(a,"--hop-dwell-ms")){ NEEDVAL(); HOP_CFG.dwell_s = strtod(argv[++i], NULL) / 1e3; continue; }
+        if (!strcmp(a,"--hop-guard-us")){ NEEDVAL(); HOP_CFG.guard_s = strtod(argv[++i], NULL) / 1e6; if (HOP_CFG.guard_s<0){ fprintf(stderr,"Bad --hop-guard-us\n"); return 1; } continue; }
+        if (!strcmp(a,"--hop-seed")){ NEEDVAL(); HOP_CFG.seed = (uint32_t)strtoul(argv[++i], NULL, 0); continue; }
+        if (!strcmp(a,"--burst")){ NEEDVAL(); if(!tx_burst_parse_period(argv[++i], &BURST_LEN_MS, &BURST_PERIOD_MS)) { fprintf(stderr,"Bad --burst (<len_ms>:<period_ms>, len <= period)\n"); return 1; } BURST = true; continue; }
+        if (!strcmp(a,"--burst-lead")){ NEEDVAL(); BURST_LEAD_MS = strtod(argv[++i], NULL); if (BURST_LEAD_MS<0 || BURST_LEAD_MS>TX_BURST_QUEUE_MS_MAX){ fprintf(stderr,"Bad --burst-lead\n"); return 1; } continue; }
+        if (!strcmp(a,"--fpga-wfm")){ NEEDVAL(); if(!limetx_parse_bool(argv[++i], &FPGA_WFM)) { fprintf(stderr,"Bad --fpga-wfm\n"); return 1; } continue; }
+
+        if (!strcmp(a,"--calibrate")){ NEEDVAL(); if(!limetx_parse_bool(argv[++i], &DO_CAL)) { fprintf(stderr,"Bad --calibrate\n"); return 1; } continue; }
+        if (!strcmp(a,"--autotrim")){ AUTOTRIM = true; if (i+1 < argc){ bool v=false; if (limetx_parse_bool(argv[i+1], &v)){ AUTOTRIM = v; i++; } } continue; }
+        if (!strcmp(a,"--state-save")){ NEEDVAL(); STATE_SAVE = argv[++i]; continue; }
+        if (!strcmp(a,"--state-load")){ NEEDVAL(); STATE_LOAD = argv[++i]; continue; }
+        if (!strcmp(a,"--rt")){ rt.enabled = true; if (i+1 < argc){ bool v=false; if (limetx_parse_bool(argv[i+1], &v)){ rt.enabled = v; i++; } } continue; }
+        if (!strcmp(a,"--rt-cpu")){ NEEDVAL(); rt.cpu = (int)strtol(argv[++i], NULL, 0); if (rt.cpu<0){ fprintf(stderr,"Bad --rt-cpu\n"); return 1; } continue; }
+        if (!strcmp(a,"--rt-prio")){ NEEDVAL(); rt.prio = (int)strtol(argv[++i], NULL, 0); if (rt.prio<1 || rt.prio>99){ fprintf(stderr,"Bad --rt-prio (1..99)\n"); return 1; } continue; }
+        if (!strcmp(a,"--telemetry")){ NEEDVAL(); if(!tx_telem_parse(argv[++i], &TELEM_MODE, TELEM_TARGET, sizeof(TELEM_TARGET))) { fprintf(stderr,"Bad --telemetry (jsonl:<path|->, prom-file:<path>, prom:[host:]<port>)\n"); return 1; } continue; }
+        if (!strcmp(a,"--telemetry-interval-ms")){ NEEDVAL(); TELEM_INTERVAL_MS = (int)strtol(argv[++i], NULL, 0); if (TELEM_INTERVAL_MS<10){ fprintf(stderr,"Bad --telemetry-interval-ms (>= 10)\n"); return 1; } continue; }
+        if (!strcmp(a,"--cal-cache")){ NEEDVAL(); CAL_CACHE = argv[++i]; if (!strcmp(CAL_CACHE,"off")) CAL_CACHE = NULL; continue; }
+        if (!strcmp(a,"--cal-cache-max-age")){ NEEDVAL(); CAL_MAX_AGE_S = (int)strtol(argv[++i], NULL, 0); continue; }
+        if (!strcmp(a,"--wave-cache")){ NEEDVAL(); WAVE_CACHE = argv[++i]; if (!strcmp(WAVE_CACHE,"off")) WAVE_CACHE = NULL; continue; }
 
         if (!strcmp(a,"--set-gain-i")){ NEEDVAL(); SET_GI=true;    MAN_GI    = (int)strtol(argv[++i], NULL, 0); MAN_GI    = clampi(MAN_GI,    0, 2047); continue; }
         if (!strcmp(a,"--set-gain-q")){ NEEDVAL(); SET_GQ=true;    MAN_GQ    = (int)strtol(argv[++i], NULL, 0); MAN_GQ    = clampi(MAN_GQ,    0, 2047); continue; }
@@ -292,23 +346,81 @@ int main(int argc, char** argv)
     TX_GAIN_START = clampi(TX_GAIN_START, TX_GAIN_MIN_DB, TX_GAIN_MAX_DB);
     if (RAMP_INTERVAL_MS < 1) RAMP_INTERVAL_MS = 1;
     if (RAMP_MS < 0) RAMP_MS = 0;
+    if (RAMP_DOWN_MS < 0) RAMP_DOWN_MS = 0;
+    if (DIG_RAMP != IQ_RAMP_OFF && FPGA_WFM) {
+        fprintf(stderr,"WARN: --digital-ramp needs host streaming, using analog ramp with --fpga-wfm\n");
+        DIG_RAMP = IQ_RAMP_OFF;
+    }
+    if (DIG_RAMP != IQ_RAMP_OFF && TX_GAIN_START > TX_GAIN_DB) {
+        fprintf(stderr,"WARN: digital ramp can only ramp up (start > target), using analog ramp\n");
+        DIG_RAMP = IQ_RAMP_OFF;
+    }
+    const int TX_GAIN_INIT = DIG_RAMP != IQ_RAMP_OFF ? TX_GAIN_DB : TX_GAIN_START;
     if (TONE_SCALE < 0.0) TONE_SCALE = 0.0;
     if (TONE_SCALE > 1.0) TONE_SCALE = 1.0;
+    if (OFDM && N_TONES > 0) { fprintf(stderr,"Use either --tone/--sweep or --ofdm\n"); return 1; }
+    if (HOP && BURST) { fprintf(stderr,"Use either --hop or --burst\n"); return 1; }
+    if (BURST && FPGA_WFM) {
+        fprintf(stderr,"WARN: --burst schedules on stream timestamps, streaming instead of --fpga-wfm\n");
+        FPGA_WFM = false;
+    }
+    if (HOP && FPGA_WFM) {
+        fprintf(stderr,"WARN: --hop schedules on stream timestamps, streaming instead of --fpga-wfm\n");
+        FPGA_WFM = false;
+    }
+    tx_hop_t hop;
+    memset(&hop, 0, sizeof(hop));
+    if (HOP) {
+        // the NCO runs at the TSP rate; past the LPF bandwidth the signal is filtered away
+        const double span = fmin(TX_HOP_NCO_FRAC * HOST_SR_HZ * OVERSAMPLE, TX_LPF_BW_HZ);
+        if (tx_hop_init(&hop, &HOP_CFG, HOST_SR_HZ, LO_HZ, NCO_DOWNCONVERT, span)) return 1;
+        LO_HZ       = hop.lo[hop.cur_band];
+        NCO_FREQ_HZ = hop.table[hop.live];
+        printf("Hop: %d frequencies, dwell %.3f ms (%" PRIu64 " samples), guard %.1f us, %s order, NCO span %.3f MHz, %d LO band(s).\n",
+               hop.n, 1e3 * (double)hop.dwell / HOST_SR_HZ, hop.dwell, 1e6 * (double)hop.guard / HOST_SR_HZ,
+               HOP_CFG.seed ? "random" : "list", span / 1e6, hop.nbands);
+        if (hop.nbands > 1)
+            printf("WARN: hop set is wider than the NCO span, hops between LO bands retune the LO (slow).\n");
+    }
 
     lms_device_t* dev = NULL;
+    limetx_regs_t  regs;
     lms_stream_t  txs;
     int16_t*      buf = NULL;
+    int16_t*      out = NULL;
+    iq_tone_src_t tones;
+    iq_ofdm_src_t ofdm;
+    tx_telem_t    telem;
+    tx_ctrl_t     ctrl;
+    iq_ramp_t     ramp;
+    tx_burst_t    burst;
+    bool          ramped_down = false;
+    bool          wfm_active = false;
+    double        host_sr = HOST_SR_HZ, rf_sr = 0; // what the device runs at, once the rate is set
+    memset(&burst, 0, sizeof(burst));
+    memset(&txs, 0, sizeof(txs));
+    memset(&ctrl, 0, sizeof(ctrl));
+    memset(&ramp, 0, sizeof(ramp));
+    memset(&tones, 0, sizeof(tones));
+    memset(&ofdm, 0, sizeof(ofdm));
+    if (tx_rt_begin(&rt, true)) return 1;
+    if (tx_telem_start(&telem, TELEM_MODE, TELEM_TARGET, "tx_ssb11", 1, (unsigned)TELEM_INTERVAL_MS)) return 1;
 
     signal(SIGINT, on_sigint);
 
+    tx_boot_t boot;
+    tx_boot_begin(&boot, CH);
+
     lms_info_str_t list[8];
     int n = LMS_GetDeviceList(list);
     if (n < 1) { fprintf(stderr,"No LimeSDR found\n"); return 1; }
     if (LMS_Open(&dev, list[0], NULL)) { fprintf(stderr,"LMS_Open failed: %s\n", LMS_GetLastErrorMessage()); return 1; }
+    tx_boot_attach(&boot, dev);
+    limetx_regs_init(&regs, dev);
 
-    CHECK(LMS_Init(dev));
+    CHECK(tx_boot_init_device(&boot, STATE_LOAD));
 
-    if (DO_CAL) {
+    if (DO_CAL && !boot.loaded) {
         CHECK(LMS_Reset(dev));
         printf("device reset to defaults\n");
     }
@@ -316,146 +428,268 @@ int main(int argc, char** argv)
     CHECK(LMS_EnableChannel(dev, LMS_CH_TX, CH, true));
     printf("TX channel enabled.\n");
 
-    CHECK(LMS_SetSampleRate(dev, HOST_SR_HZ, OVERSAMPLE));
+    CHECK(tx_boot_sample_rate(&boot, HOST_SR_HZ, OVERSAMPLE));
     print_sr(dev);
+    // The CGEN PLL rounds the rate: tones, symbols and schedules use the one actually set
+    CHECK(LMS_GetSampleRate(dev, LMS_CH_TX, CH, &host_sr, &rf_sr));
+    if (host_sr <= 0) host_sr = HOST_SR_HZ;
+    if (HOP && tx_hop_set_fs(&hop, &HOP_CFG, host_sr)) { fprintf(stderr,"malloc failed\n"); goto cleanup; }
 
-    CHECK(LMS_SetLPFBW(dev, LMS_CH_TX, CH, TX_LPF_BW_HZ));
+    CHECK(tx_boot_lpf_bw(&boot, TX_LPF_BW_HZ));
 
-    CHECK(LMS_SetGaindB(dev, LMS_CH_TX, CH, TX_GAIN_START));
+    CHECK(tx_boot_gain(&boot, TX_GAIN_INIT));
     print_gain(dev);
 
-    CHECK(LMS_SetLOFrequency(dev, LMS_CH_TX, CH, LO_HZ));
+    CHECK(tx_boot_lo(&boot, LO_HZ));
     print_lo(dev);
 
-    {
+    if (HOP) {
+        CHECK(tx_boot_nco(&boot, hop.table, hop.live, NCO_DOWNCONVERT));
+        print_nco(dev);
+    } else {
         double freqs[16]={0};
         freqs[NCO_INDEX] = NCO_FREQ_HZ;
-        CHECK(LMS_SetNCOFrequency(dev, true, CH, freqs, 0.0));
-        CHECK(LMS_SetNCOIndex    (dev, true, CH, NCO_INDEX, NCO_DOWNCONVERT));
+        CHECK(tx_boot_nco(&boot, freqs, NCO_INDEX, NCO_DOWNCONVERT));
         print_nco(dev);
     }
 
-    print_snapshot(dev, DO_CAL ? "BEFORE calibration" : "Parameters (calibration OFF)",
+    print_snapshot(dev, &regs, DO_CAL || AUTOTRIM ? "BEFORE calibration" : "Parameters (calibration OFF)",
                    TX_LPF_BW_HZ, NCO_FREQ_HZ, NCO_DOWNCONVERT, TONE_SCALE);
 
     int calib_rc = 0;
-    if (DO_CAL) {
-        printf("Running LMS_Calibrate(TX ch=%d, bw=%.3f MHz)...\n", CH, TX_LPF_BW_HZ/1e6);
-        calib_rc = LMS_Calibrate(dev, LMS_CH_TX, CH, TX_LPF_BW_HZ, 0);
-        if (calib_rc) fprintf(stderr,"LMS_Calibrate returned %d: %s\n", calib_rc, LMS_GetLastErrorMessage());
+    if (DO_CAL || AUTOTRIM) {
+        printf("Calibrating TX ch=%d, bw=%.3f MHz (%s, cache: %s)...\n", CH, TX_LPF_BW_HZ/1e6,
+               AUTOTRIM ? (DO_CAL ? "LMS_Calibrate + autotrim" : "autotrim") : "LMS_Calibrate", CAL_CACHE ? CAL_CACHE : "off");
+        txcal_key_t cal_key;
+        calib_rc = txcal_key_init(&cal_key, dev, CH, LO_HZ, NCO_FREQ_HZ, TX_LPF_BW_HZ);
+        if (!calib_rc) calib_rc = AUTOTRIM ? tx_trim_calibrate(&regs, &cal_key, CAL_CACHE, CAL_MAX_AGE_S, NCO_DOWNCONVERT, DO_CAL)
+                                           : txcal_calibrate(&regs, &cal_key, CAL_CACHE, CAL_MAX_AGE_S);
+        if (calib_rc) fprintf(stderr,"%s returned %d: %s\n", AUTOTRIM ? "autotrim" : "LMS_Calibrate", calib_rc, LMS_GetLastErrorMessage());
         else          printf("Calibration OK.\n");
 
-        print_snapshot(dev, "AFTER calibration",
+        print_snapshot(dev, &regs, "AFTER calibration",
                        TX_LPF_BW_HZ, NCO_FREQ_HZ, NCO_DOWNCONVERT, TONE_SCALE);
     }
 
     if (SET_GI || SET_GQ || SET_PHASE || SET_DCI || SET_DCQ) {
-        CHECK(apply_manual_txtsp(dev, CH,
+        CHECK(limetx_apply_manual(&regs, CH,
                                  SET_GI, MAN_GI,
                                  SET_GQ, MAN_GQ,
                                  SET_PHASE, MAN_PHASE,
                                  SET_DCI, MAN_DCI,
                                  SET_DCQ, MAN_DCQ));
-        print_snapshot(dev, DO_CAL ? "AFTER manual correctors (override calibration)" : "AFTER manual correctors",
+        print_snapshot(dev, &regs, DO_CAL || AUTOTRIM ? "AFTER manual correctors (override calibration)" : "AFTER manual correctors",
                        TX_LPF_BW_HZ, NCO_FREQ_HZ, NCO_DOWNCONVERT, TONE_SCALE);
     }
 
-    memset(&txs, 0, sizeof(txs));
-    txs.channel  = CH;
-    txs.isTx     = true;
-    txs.fifoSize = FIFO_SIZE_SAMPLES;
-    txs.dataFmt  = LMS_FMT_I16;
-    CHECK(LMS_SetupStream(dev, &txs));
-    CHECK(LMS_StartStream(&txs));
-    printf("TX stream started (fifo=%d samples, fmt=I16).\n", FIFO_SIZE_SAMPLES);
-
-    buf = (int16_t*)malloc(2*BUF_SAMPLES*sizeof(int16_t));
-    if (!buf) { fprintf(stderr,"malloc failed\n"); goto cleanup; }
+    tx_boot_mark(&boot, "correctors");
+    if (STATE_SAVE) tx_boot_save(&boot, STATE_SAVE);
+
+    buf = (int16_t*)tx_rt_alloc(&rt, 2*BUF_SAMPLES*sizeof(int16_t));
+    out = (int16_t*)tx_rt_alloc(&rt, 2*BUF_SAMPLES*sizeof(int16_t));
+    if (!buf || !out || iq_ramp_init(&ramp, BUF_SAMPLES)) { fprintf(stderr,"malloc failed\n"); goto cleanup; }
     const int16_t I = (int16_t)(TONE_SCALE * 32767.0);
     const int16_t Q = 0;
     for (size_t i=0;i<BUF_SAMPLES;i++){ buf[2*i+0]=I; buf[2*i+1]=Q; }
 
-    double host_sr=0, rf_sr=0; LMS_GetSampleRate(dev, LMS_CH_TX, CH, &host_sr, &rf_sr);
+    if (N_TONES > 0) {
+        if (iq_tone_src_init_cached(&tones, TONES, N_TONES, host_sr, TONE_SCALE, BUF_SAMPLES, WAVE_CACHE)) { fprintf(stderr,"tone generator init failed\n"); goto cleanup; }
+        printf("Tone generator: %d tone(s), kernel=%s, crest factor %.2f dB, peak %.3f -> %.2f FS, %s.\n",
+               N_TONES, tones.gen.kernel, iq_tone_crest_db(&tones.gen), tones.gen.peak, TONE_SCALE,
+               tones.period ? "periodic" : "rendered live");
+        if (tones.period)
+            printf("Tone generator: period %zu samples (%.3f ms) %s.\n",
+                   tones.period_frames, 1e3 * (double)tones.period_frames / host_sr,
+                   tones.cached == IQ_TONE_CACHE_LOADED ? "loaded from the waveform cache"
+                   : tones.cached == IQ_TONE_CACHE_STORED ? "precomputed, stored in the waveform cache" : "precomputed");
+        for (int k=0; k<N_TONES; k++) {
+            const iq_tone_t* t = &TONES[k];
+            if (t->sweep_s > 0.0)
+                printf("  tone %d: sweep %+.3f -> %+.3f kHz over %.3f s, %.1f dB, %.1f deg\n",
+                       k, t->freq_hz/1e3, t->sweep_to_hz/1e3, t->sweep_s, 20.0*log10(t->amp), t->phase_deg);
+            else
+                printf("  tone %d: %+.3f kHz, %.1f dB, %.1f deg\n", k, t->freq_hz/1e3, 20.0*log10(t->amp), t->phase_deg);
+        }
+    }
+
+    if (OFDM) {
+        // before tx_rt_enter: the workers must not inherit the stream thread's CPU and priority
+        if (iq_ofdm_src_init(&ofdm, &OFDM_CFG, TONE_SCALE, BUF_SAMPLES, OFDM_THREADS)) { fprintf(stderr,"OFDM generator init failed\n"); goto cleanup; }
+        const iq_ofdm_t* o = &ofdm.o;
+        printf("OFDM: N=%d, CP=%d, %d data + %d pilot bins (%s), spacing %.3f kHz, occupied %.3f MHz, symbol %.3f us.\n",
+               o->n, o->cp, o->n_data, o->n_pilot, iq_ofdm_mod_name(OFDM_CFG.mod), host_sr/o->n/1e3,
+               (o->n_data + o->n_pilot) * host_sr/o->n/1e6, 1e6 * o->sym_len / host_sr);
+        printf("OFDM: frame %d preamble + %d data symbols, %.3f Mbit/s payload, clip %.2f FS at %.1f dB PAPR, %s.\n",
+               OFDM_CFG.preamble, OFDM_CFG.frame, iq_ofdm_bitrate(o, host_sr)/1e6, TONE_SCALE, OFDM_CFG.papr_db,
+               ofdm.period ? "frame repeats (one cached period)" : "rendered live");
+        if (ofdm.period)
+            printf("OFDM: period %zu samples (%.3f ms) precomputed.\n", ofdm.period_frames, 1e3 * (double)ofdm.period_frames / host_sr);
+        else
+            printf("OFDM: %d symbol worker(s), %u chunks in flight, %d preamble symbol(s) cached.\n", ofdm.nthreads, ofdm.window, o->cached);
+    }
+
+    if (FPGA_WFM) {
+        if (OFDM) {
+            if (ofdm.period) wfm_active = start_fpga_wfm(dev, ofdm.period, ofdm.period_frames);
+            else fprintf(stderr,"WARN: OFDM payload does not repeat (see --ofdm-repeat), cannot loop it in the FPGA; streaming\n");
+        }
+        else if (N_TONES == 0) wfm_active = start_fpga_wfm(dev, buf, BUF_SAMPLES);
+        else if (tones.period) wfm_active = start_fpga_wfm(dev, tones.period, tones.period_frames);
+        else fprintf(stderr,"WARN: tone set is not periodic (sweep or fractional Hz), cannot loop it in the FPGA; streaming\n");
+    }
+
+    if (!wfm_active) {
+        memset(&txs, 0, sizeof(txs));
+        txs.channel  = CH;
+        txs.isTx     = true;
+        txs.fifoSize = FIFO_SIZE_SAMPLES;
+        txs.dataFmt  = LMS_FMT_I16;
+        txs.linkFmt  = LINK_FMT;
+        CHECK(LMS_SetupStream(dev, &txs));
+        CHECK(LMS_StartStream(&txs));
+        printf("TX stream started (fifo=%d samples, fmt=I16, link=%s).\n", FIFO_SIZE_SAMPLES, limetx_link_fmt_name(LINK_FMT));
+        limetx_print_link(LINK_FMT, host_sr);
+    }
+    tx_boot_mark(&boot, wfm_active ? "fpga wfm" : "stream");
+    tx_boot_print(&boot);
+
     double lo_now=0; LMS_GetLOFrequency(dev, LMS_CH_TX, CH, &lo_now);
     const double rf_hz = NCO_DOWNCONVERT ? (lo_now - NCO_FREQ_HZ) : (lo_now + NCO_FREQ_HZ);
-    printf("TX RF sine @ %.6f MHz  (host=%.2f Msps, rf=%.2f Msps, start_gain=%d dB -> target=%d dB, ramp=%d ms, step=%d ms, %sconvert).\n",
-           rf_hz/1e6, host_sr/1e6, rf_sr/1e6, TX_GAIN_START, TX_GAIN_DB, RAMP_MS, RAMP_INTERVAL_MS,
-           NCO_DOWNCONVERT?"down":"up");
+    printf("TX RF sine @ %.6f MHz  (host=%.2f Msps, rf=%.2f Msps, start_gain=%d dB -> target=%d dB, ramp=%d ms, %s, %sconvert, %s).\n",
+           rf_hz/1e6, host_sr/1e6, rf_sr/1e6, TX_GAIN_START, TX_GAIN_DB, RAMP_MS,
+           DIG_RAMP != IQ_RAMP_OFF ? (DIG_RAMP == IQ_RAMP_DB ? "digital dB ramp" : "digital cos ramp") : "analog 1 dB steps",
+           NCO_DOWNCONVERT?"down":"up", wfm_active?"FPGA WFM":"host stream");
     printf("Ctrl+C to stop.\n");
 
-    const bool use_ramp = (RAMP_MS > 0) && (TX_GAIN_DB != TX_GAIN_START);
-    const int  total_delta = TX_GAIN_DB - TX_GAIN_START;
-    const int  steps = use_ramp ? (RAMP_MS + RAMP_INTERVAL_MS - 1) / RAMP_INTERVAL_MS : 1;
-    const double step_db_f = use_ramp ? ((double)total_delta / (double)steps) : 0.0;
+    if (tx_ctrl_start(&ctrl, dev, CH)) goto cleanup;
+    if (DIG_RAMP != IQ_RAMP_OFF) {
+        if (RAMP_MS > 0)
+            iq_ramp_begin(&ramp, DIG_RAMP, (double)(TX_GAIN_START - TX_GAIN_DB), 0.0,
+                          (uint64_t)((double)RAMP_MS * host_sr / 1000.0));
+    } else {
+        tx_ctrl_ramp(&ctrl, TX_GAIN_START, TX_GAIN_DB, RAMP_MS, RAMP_INTERVAL_MS);
+    }
+
+    while (keep_running && wfm_active) {
+        // FPGA loops the tone by itself; the control worker runs the ramp
+        struct timespec ts = { 0, 100*1000000L };
+        nanosleep(&ts, NULL);
+    }
+
+    uint64_t sent = 0; // frames streamed; with --hop, frame n goes out at timestamp hop.ts0 + n
+    if (HOP) {
+        lms_stream_status_t st;
+        memset(&st, 0, sizeof(st));
+        CHECK(LMS_GetStreamStatus(&txs, &st));
+        if (tx_hop_start(&hop, &ctrl, &regs, CH, st.timestamp + (uint64_t)(host_sr * TX_HOP_LEAD_MS / 1000.0))) goto cleanup;
+    }
 
-    uint64_t t0 = now_ms();
-    uint64_t t_next = t0 + (use_ramp ? (uint64_t)RAMP_INTERVAL_MS : UINT64_MAX);
-    double   g_accum = (double)TX_GAIN_START;
-    int      g_last_applied = TX_GAIN_START;
+    // --burst: burst k covers [k * period, k * period + len) from the burst origin
+    const uint64_t burst_len = (uint64_t)llround(BURST_LEN_MS * host_sr / 1000.0);
+    const uint64_t burst_period = (uint64_t)llround(BURST_PERIOD_MS * host_sr / 1000.0);
+    uint64_t burst_k = 0, burst_left = 0;
+    if (BURST) {
+        if (tx_burst_start(&burst, &txs, host_sr, BURST_LEAD_MS)) goto cleanup;
+        printf("Burst: %" PRIu64 " samples every %" PRIu64 " (%.3f / %.3f ms), queued %.1f ms ahead.\n",
+               burst_len, burst_period, BURST_LEN_MS, BURST_PERIOD_MS, BURST_LEAD_MS);
+    }
 
+    if (!wfm_active) tx_rt_enter(&rt);
+    time_t last_status = time(NULL);
     while (keep_running) {
+        if (BURST && !burst_left) {
+            if (!tx_burst_begin(&burst, burst_k * burst_period, burst_len, &keep_running)) break;
+            burst_k++;
+            burst_left = burst_len;
+        }
+        const size_t n = BURST && burst_left < BUF_SAMPLES ? (size_t)burst_left : BUF_SAMPLES;
+        const int16_t* src = OFDM ? iq_ofdm_src_next(&ofdm) : N_TONES > 0 ? iq_tone_src_next(&tones) : buf;
+        if (iq_ramp_active(&ramp)) { iq_ramp_apply(&ramp, out, src, n); src = out; }
+
         lms_stream_meta_t meta; memset(&meta,0,sizeof(meta));
-        if (LMS_SendStream(&txs, buf, BUF_SAMPLES, &meta, SEND_TIMEOUT_MS) < 0) {
+        if (HOP) {
+            src = tx_hop_blank(&hop, out, src, sent, BUF_SAMPLES);
+            meta.waitForTimestamp = true;
+            meta.timestamp = hop.ts0 + sent;
+        }
+        const uint64_t t_send = tx_telem_now_ns();
+        const bool ok = BURST ? !tx_burst_send(&burst, src, n, SEND_TIMEOUT_MS)
+                              : LMS_SendStream(&txs, src, BUF_SAMPLES, &meta, SEND_TIMEOUT_MS) >= 0;
+        tx_telem_send(&telem, t_send, n, ok);
+        if (!ok) {
             fprintf(stderr,"LMS_SendStream error: %s\n", LMS_GetLastErrorMessage());
             break;
         }
-
-        if (use_ramp) {
-            uint64_t now = now_ms();
-            while (now >= t_next && keep_running) {
-                g_accum += step_db_f;
-                int g_int = clampi((int)llround(g_accum), TX_GAIN_MIN_DB, TX_GAIN_MAX_DB);
-
-                if (g_int != g_last_applied) {
-                    fprintf(stderr, "ramp: setting gain to %d dB\n", g_int);
-                    if (LMS_SetGaindB(dev, LMS_CH_TX, CH, g_int) == 0) {
-                        unsigned int g_read = 0;
-                        if (LMS_GetGaindB(dev, LMS_CH_TX, CH, &g_read) == 0) {
-                            fprintf(stderr, "ramp: set=%d dB, get=%u dB\n", g_int, g_read);
-                        } else {
-                            fprintf(stderr, "ramp: LMS_GetGaindB failed: %s\n",
-                                    LMS_GetLastErrorMessage());
-                        }
-                        g_last_applied = g_int;
-                    } else {
-                        fprintf(stderr, "Gain ramp set failed: %s\n", LMS_GetLastErrorMessage());
-                    }
-                }
-                t_next += (uint64_t)RAMP_INTERVAL_MS;
-
-                if ((step_db_f >= 0 && g_last_applied >= TX_GAIN_DB) ||
-                    (step_db_f <  0 && g_last_applied <= TX_GAIN_DB)) {
-                    if (g_last_applied != TX_GAIN_DB) {
-                        (void)LMS_SetGaindB(dev, LMS_CH_TX, CH, TX_GAIN_DB);
-                        g_last_applied = TX_GAIN_DB;
-                    }
-                    t_next = UINT64_MAX;
-                    break;
-                }
-                now = now_ms();
+        sent += n;
+        if (BURST)
+            burst_left -= n;
+        if (HOP) {
+            // fresh device timestamp for the hop thread every chunk; the deltas feed telemetry as usual
+            lms_stream_status_t st;
+            memset(&st, 0, sizeof(st));
+            if (!LMS_GetStreamStatus(&txs, &st)) {
+                tx_hop_anchor(&hop, st.timestamp, tx_hop_now_ns());
+                tx_telem_status(&telem, 0, &st);
             }
+            continue;
+        }
+
+        // underrun/overrun feed for the exporter only; this tool prints no per-second status
+        time_t now = time(NULL);
+        if (tx_telem_enabled(&telem) && now != last_status) {
+            last_status = now;
+            lms_stream_status_t st;
+            memset(&st, 0, sizeof(st));
+            if (!LMS_GetStreamStatus(&txs, &st)) tx_telem_status(&telem, 0, &st);
         }
     }
 
     printf("\nSIGINT detected: muting TX and shutting down safely...\n");
+    if (wfm_active)
+        tx_ctrl_set_gain(&ctrl, TX_GAIN_MIN_DB, true);
+    else if (!keep_running && RAMP_DOWN_MS > 0 && !BURST) // a burst just ends; the stream is idle after it
+        ramped_down = ramp_down(&txs, &ramp, DIG_RAMP, buf, N_TONES > 0 ? &tones : NULL, OFDM ? &ofdm : NULL,
+                                out, BUF_SAMPLES, (uint64_t)((double)RAMP_DOWN_MS * host_sr / 1000.0));
 
 cleanup:
-    if (txs.handle) {
+    if (hop.started) {
+        tx_hop_stop(&hop);
+        tx_hop_print(&hop);
+    }
+    tx_ctrl_stop(&ctrl);
+    if (burst.late_ns)
+        tx_burst_print(&burst);
+    if (txs.handle && !ramped_down && !BURST) {
         int16_t* z = (int16_t*)calloc(2*BUF_SAMPLES, sizeof(int16_t));
         if (z){
             lms_stream_meta_t meta; memset(&meta,0,sizeof(meta));
             (void)LMS_SendStream(&txs, z, BUF_SAMPLES, &meta, SEND_TIMEOUT_MS);
             free(z);
         }
+    }
+    if (txs.handle) {
         LMS_StopStream(&txs);
         LMS_DestroyStream(dev, &txs);
         printf("TX stream stopped.\n");
     }
+    if (wfm_active) {
+        (void)LMS_EnableTxWFM(dev, CH, false);
+        printf("FPGA waveform player stopped.\n");
+    }
     if (dev) {
         LMS_EnableChannel(dev, LMS_CH_TX, CH, false);
         printf("TX channel disabled.\n");
         LMS_Close(dev);
     }
     if (buf) free(buf);
+    free(out);
+    iq_tone_src_free(&tones);
+    if (ofdm.nthreads)
+        printf("OFDM: %" PRIu64 " chunks sent, %" PRIu64 " waited on the symbol workers.\n", ofdm.chunks, ofdm.waits);
+    iq_ofdm_src_free(&ofdm);
+    tx_hop_free(&hop);
+    tx_burst_free(&burst);
+    tx_telem_stop(&telem);
+    iq_ramp_free(&ramp);
     return 0;
 }
@@ -0,0 +1,438 @@
+#ifndef TX_TELEM_H
+#define TX_TELEM_H
+
+// Streaming telemetry: lock-free counters and log2 histograms updated from the hot loops, exported
+// by a side thread as JSON lines, a Prometheus textfile (node_exporter textfile collector) or a
+// Prometheus HTTP /metrics endpoint.
+//
+// Every field is a relaxed atomic with a single writer (the reader thread for input, the stream
+// thread for send/status), so recording is a handful of uncontended adds and never blocks the
+// stream. The exporter only loads them; a line can mix values from neighbouring chunks, which is
+// fine for rates and histograms.
+//
+// Histogram bucket b counts values v with 2^(b-1) <= v < 2^b (bucket 0: v == 0), so latency buckets
+// in microseconds run 1 us, 2 us, 4 us, ... and the last one is open. JSON lines carry per-bucket
+// counts, Prometheus gets the cumulative le= form.
+//
+// Underrun/overrun/dropped are what LMS_GetStreamStatus reports for the time since its last call;
+// the tools keep their once-a-second status poll and hand the result to tx_telem_status(), which
+// accumulates it into totals.
+
+#include "lime/LimeSuite.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TX_TELEM_BUCKETS 24
+#define TX_TELEM_MAX_CH 2
+#define TX_TELEM_INTERVAL_MS_DEF 1000
+#define TX_TELEM_PATH_MAX 512
+#define TX_TELEM_SEND_TIMEOUT_MS 200 // per /metrics response; a client that stops reading is cut off
+
+enum { TX_TELEM_OFF = 0, TX_TELEM_JSONL, TX_TELEM_PROM_FILE, TX_TELEM_PROM_HTTP };
+
+typedef struct {
+    atomic_uint_fast64_t b[TX_TELEM_BUCKETS];
+    atomic_uint_fast64_t sum;
+    atomic_uint_fast64_t count;
+} tx_telem_hist_t;
+
+typedef struct {
+    // hot path
+    _Alignas(64) tx_telem_hist_t read_us; // read()/fread() of one input chunk
+    atomic_uint_fast64_t input_bytes;
+    tx_telem_hist_t disk_us; // one async block read (wav_aio.h), submit to completion
+    atomic_uint_fast64_t disk_bytes;
+    _Alignas(64) tx_telem_hist_t send_us; // LMS_SendStream of one chunk (both channels with MIMO)
+    tx_telem_hist_t chunk_frames;
+    atomic_uint_fast64_t frames_sent;
+    atomic_uint_fast64_t send_errors;
+    atomic_uint_fast64_t underruns[TX_TELEM_MAX_CH];
+    atomic_uint_fast64_t overruns[TX_TELEM_MAX_CH];
+    atomic_uint_fast64_t dropped[TX_TELEM_MAX_CH];
+    atomic_uint_fast32_t fifo_fill[TX_TELEM_MAX_CH];
+    atomic_uint_fast32_t fifo_size[TX_TELEM_MAX_CH];
+
+    // exporter
+    int mode;
+    char target[TX_TELEM_PATH_MAX]; // path, or the port for HTTP
+    const char *tool;
+    int nch;
+    unsigned interval_ms;
+    FILE *out; // JSON lines
+    int listen_fd;
+    struct timespec t0;
+    uint64_t json_disk_bytes, json_ns; // at the previous JSON line, for disk_mb_s
+    pthread_t th;
+    bool started;
+    atomic_int stop;
+} tx_telem_t;
+
+static inline uint64_t tx_telem_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static inline void tx_telem_hist_add(tx_telem_hist_t *h, uint64_t v) {
+    int b = v ? 64 - __builtin_clzll(v) : 0;
+    if (b >= TX_TELEM_BUCKETS)
+        b = TX_TELEM_BUCKETS - 1;
+    atomic_fetch_add_explicit(&h->b[b], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->sum, v, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->count, 1, memory_order_relaxed);
+}
+
+static inline bool tx_telem_enabled(const tx_telem_t *t) { return t && t->mode != TX_TELEM_OFF; }
+
+// One input read that started at t0_ns (tx_telem_now_ns) and returned `bytes`.
+static inline void tx_telem_read(tx_telem_t *t, uint64_t t0_ns, size_t bytes) {
+    if (!tx_telem_enabled(t))
+        return;
+    tx_telem_hist_add(&t->read_us, (tx_telem_now_ns() - t0_ns) / 1000);
+    atomic_fetch_add_explicit(&t->input_bytes, bytes, memory_order_relaxed);
+}
+
+// One async disk read submitted at t0_ns that delivered `bytes` (alignment padding included).
+static inline void tx_telem_disk(tx_telem_t *t, uint64_t t0_ns, size_t bytes) {
+    if (!tx_telem_enabled(t))
+        return;
+    tx_telem_hist_add(&t->disk_us, (tx_telem_now_ns() - t0_ns) / 1000);
+    atomic_fetch_add_explicit(&t->disk_bytes, bytes, memory_order_relaxed);
+}
+
+// One chunk handed to LMS_SendStream at t0_ns; ok = false counts a send error.
+static inline void tx_telem_send(tx_telem_t *t, uint64_t t0_ns, size_t frames, bool ok) {
+    if (!tx_telem_enabled(t))
+        return;
+    tx_telem_hist_add(&t->send_us, (tx_telem_now_ns() - t0_ns) / 1000);
+    if (!ok) {
+        atomic_fetch_add_explicit(&t->send_errors, 1, memory_order_relaxed);
+        return;
+    }
+    tx_telem_hist_add(&t->chunk_frames, frames);
+    atomic_fetch_add_explicit(&t->frames_sent, frames, memory_order_relaxed);
+}
+
+static inline void tx_telem_status(tx_telem_t *t, int ch, const lms_stream_status_t *st) {
+    if (!tx_telem_enabled(t) || ch < 0 || ch >= TX_TELEM_MAX_CH)
+        return;
+    atomic_fetch_add_explicit(&t->underruns[ch], st->underrun, memory_order_relaxed);
+    atomic_fetch_add_explicit(&t->overruns[ch], st->overrun, memory_order_relaxed);
+    atomic_fetch_add_explicit(&t->dropped[ch], st->droppedPackets, memory_order_relaxed);
+    atomic_store_explicit(&t->fifo_fill[ch], st->fifoFilledCount, memory_order_relaxed);
+    atomic_store_explicit(&t->fifo_size[ch], st->fifoSize, memory_order_relaxed);
+}
+
+// "[host:]port" of the /metrics listener; the host defaults to loopback.
+static inline bool tx_telem_prom_addr(const char *target, struct sockaddr_in *sa) {
+    char host[64] = "127.0.0.1";
+    const char *port = target, *colon = strrchr(target, ':');
+    if (colon) {
+        snprintf(host, sizeof(host), "%.*s", (int)(colon - target), target);
+        port = colon + 1;
+    }
+    char *end = NULL;
+    long p = strtol(port, &end, 10);
+    memset(sa, 0, sizeof(*sa));
+    sa->sin_family = AF_INET;
+    sa->sin_port = htons((uint16_t)p);
+    return *port && !*end && p >= 1 && p <= 65535 && inet_pton(AF_INET, host, &sa->sin_addr) == 1;
+}
+
+// "jsonl:<path|->", "prom-file:<path>" or "prom:[host:]<port>".
+static inline bool tx_telem_parse(const char *s, int *mode, char *target, size_t target_len) {
+    const char *v = NULL;
+    if (!strncmp(s, "jsonl:", 6)) {
+        *mode = TX_TELEM_JSONL;
+        v = s + 6;
+    } else if (!strncmp(s, "prom-file:", 10)) {
+        *mode = TX_TELEM_PROM_FILE;
+        v = s + 10;
+    } else if (!strncmp(s, "prom:", 5)) {
+        *mode = TX_TELEM_PROM_HTTP;
+        v = s + 5;
+        struct sockaddr_in sa;
+        if (!tx_telem_prom_addr(v, &sa))
+            return false;
+    } else {
+        return false;
+    }
+    if (!*v || strlen(v) >= target_len)
+        return false;
+    snprintf(target, target_len, "%s", v);
+    return true;
+}
+
+static inline double tx_telem_uptime_s(const tx_telem_t *t) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - t->t0.tv_sec) + (double)(now.tv_nsec - t->t0.tv_nsec) / 1e9;
+}
+
+#define TX_TELEM_LD(x) ((unsigned long long)atomic_load_explicit(&(x), memory_order_relaxed))
+
+static inline void tx_telem_json_hist(FILE *f, const char *name, const tx_telem_hist_t *h) {
+    int last = TX_TELEM_BUCKETS - 1;
+    while (last > 0 && !TX_TELEM_LD(h->b[last]))
+        last--;
+    fprintf(f, ",\"%s\":{\"count\":%llu,\"sum\":%llu,\"log2_buckets\":[", name, TX_TELEM_LD(h->count),
+            TX_TELEM_LD(h->sum));
+    for (int b = 0; b <= last; b++)
+        fprintf(f, "%s%llu", b ? "," : "", TX_TELEM_LD(h->b[b]));
+    fprintf(f, "]}");
+}
+
+static inline void tx_telem_write_json(tx_telem_t *t, FILE *f) {
+    struct timespec wall;
+    clock_gettime(CLOCK_REALTIME, &wall);
+    fprintf(f, "{\"ts\":%lld.%03ld,\"tool\":\"%s\",\"uptime_s\":%.3f", (long long)wall.tv_sec,
+            wall.tv_nsec / 1000000, t->tool, tx_telem_uptime_s(t));
+    fprintf(f, ",\"frames_sent\":%llu,\"send_errors\":%llu,\"input_bytes\":%llu", TX_TELEM_LD(t->frames_sent),
+            TX_TELEM_LD(t->send_errors), TX_TELEM_LD(t->input_bytes));
+    if (TX_TELEM_LD(t->disk_us.count)) {
+        const uint64_t disk = TX_TELEM_LD(t->disk_bytes), now = tx_telem_now_ns();
+        const double dt = t->json_ns ? (double)(now - t->json_ns) / 1e9 : tx_telem_uptime_s(t);
+        fprintf(f, ",\"disk_bytes\":%llu,\"disk_mb_s\":%.1f", (unsigned long long)disk,
+                dt > 0 ? (double)(disk - t->json_disk_bytes) / dt / 1e6 : 0.0);
+        t->json_disk_bytes = disk;
+        t->json_ns = now;
+    }
+    const char *fields[] = {"underruns", "overruns", "dropped", "fifo_fill", "fifo_size"};
+    for (int k = 0; k < 5; k++) {
+        fprintf(f, ",\"%s\":[", fields[k]);
+        for (int c = 0; c < t->nch; c++) {
+            unsigned long long v = k == 0   ? TX_TELEM_LD(t->underruns[c])
+                                   : k == 1 ? TX_TELEM_LD(t->overruns[c])
+                                   : k == 2 ? TX_TELEM_LD(t->dropped[c])
+                                   : k == 3 ? TX_TELEM_LD(t->fifo_fill[c])
+                                            : TX_TELEM_LD(t->fifo_size[c]);
+            fprintf(f, "%s%llu", c ? "," : "", v);
+        }
+        fprintf(f, "]");
+    }
+    tx_telem_json_hist(f, "read_us", &t->read_us);
+    if (TX_TELEM_LD(t->disk_us.count))
+        tx_telem_json_hist(f, "disk_read_us", &t->disk_us);
+    tx_telem_json_hist(f, "send_us", &t->send_us);
+    tx_telem_json_hist(f, "chunk_frames", &t->chunk_frames);
+    fprintf(f, "}\n");
+}
+
+// unit_div: bucket bound 2^b in recorded units -> exported units (1e6 for us -> seconds)
+static inline void tx_telem_prom_hist(FILE *f, const tx_telem_t *t, const char *name, const char *help,
+                                      const tx_telem_hist_t *h, double unit_div) {
+    fprintf(f, "# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+    unsigned long long cum = 0;
+    for (int b = 0; b < TX_TELEM_BUCKETS - 1; b++) {
+        cum += TX_TELEM_LD(h->b[b]);
+        fprintf(f, "%s_bucket{tool=\"%s\",le=\"%g\"} %llu\n", name, t->tool, (double)(1ull << b) / unit_div, cum);
+    }
+    fprintf(f, "%s_bucket{tool=\"%s\",le=\"+Inf\"} %llu\n", name, t->tool, TX_TELEM_LD(h->count));
+    fprintf(f, "%s_sum{tool=\"%s\"} %g\n", name, t->tool, (double)TX_TELEM_LD(h->sum) / unit_div);
+    fprintf(f, "%s_count{tool=\"%s\"} %llu\n", name, t->tool, TX_TELEM_LD(h->count));
+}
+
+static inline void tx_telem_write_prom(tx_telem_t *t, FILE *f) {
+    fprintf(f, "# TYPE limetx_uptime_seconds gauge\nlimetx_uptime_seconds{tool=\"%s\"} %.3f\n", t->tool,
+            tx_telem_uptime_s(t));
+    fprintf(f, "# TYPE limetx_frames_sent_total counter\nlimetx_frames_sent_total{tool=\"%s\"} %llu\n", t->tool,
+            TX_TELEM_LD(t->frames_sent));
+    fprintf(f, "# TYPE limetx_send_errors_total counter\nlimetx_send_errors_total{tool=\"%s\"} %llu\n", t->tool,
+            TX_TELEM_LD(t->send_errors));
+    fprintf(f, "# TYPE limetx_input_bytes_total counter\nlimetx_input_bytes_total{tool=\"%s\"} %llu\n", t->tool,
+            TX_TELEM_LD(t->input_bytes));
+    fprintf(f, "# TYPE limetx_disk_read_bytes_total counter\nlimetx_disk_read_bytes_total{tool=\"%s\"} %llu\n",
+            t->tool, TX_TELEM_LD(t->disk_bytes));
+    const struct {
+        const char *name, *type;
+        const void *v;
+        bool u32;
+    } per_ch[] = {
+        {"limetx_underruns_total", "counter", t->underruns, false},
+        {"limetx_overruns_total", "counter", t->overruns, false},
+        {"limetx_dropped_packets_total", "counter", t->dropped, false},
+        {"limetx_fifo_fill_samples", "gauge", t->fifo_fill, true},
+        {"limetx_fifo_size_samples", "gauge", t->fifo_size, true},
+    };
+    for (size_t k = 0; k < sizeof(per_ch) / sizeof(per_ch[0]); k++) {
+        fprintf(f, "# TYPE %s %s\n", per_ch[k].name, per_ch[k].type);
+        for (int c = 0; c < t->nch; c++) {
+            unsigned long long v = per_ch[k].u32 ? TX_TELEM_LD(((atomic_uint_fast32_t *)per_ch[k].v)[c])
+                                                 : TX_TELEM_LD(((atomic_uint_fast64_t *)per_ch[k].v)[c]);
+            fprintf(f, "%s{tool=\"%s\",ch=\"%d\"} %llu\n", per_ch[k].name, t->tool, c, v);
+        }
+    }
+    tx_telem_prom_hist(f, t, "limetx_read_latency_seconds", "Input read()/fread() latency per chunk", &t->read_us,
+                       1e6);
+    tx_telem_prom_hist(f, t, "limetx_disk_read_latency_seconds", "Async disk block read latency", &t->disk_us, 1e6);
+    tx_telem_prom_hist(f, t, "limetx_send_latency_seconds", "LMS_SendStream latency per chunk", &t->send_us, 1e6);
+    tx_telem_prom_hist(f, t, "limetx_chunk_frames", "Frames per LMS_SendStream chunk", &t->chunk_frames, 1.0);
+}
+
+// Textfile collector: write <path>.tmp and rename it over <path> so readers never see half a file.
+static inline void tx_telem_write_prom_file(tx_telem_t *t) {
+    char tmp[TX_TELEM_PATH_MAX + 8];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", t->target);
+    FILE *f = fopen(tmp, "w");
+    if (!f)
+        return;
+    tx_telem_write_prom(t, f);
+    if (fclose(f) == 0)
+        rename(tmp, t->target);
+}
+
+static inline void tx_telem_serve(tx_telem_t *t) {
+    int c = accept(t->listen_fd, NULL, NULL);
+    if (c < 0)
+        return;
+    // Bounded writes: a client that stops reading must not hold up the exporter or tx_telem_stop()
+    const struct timeval tv = {0, TX_TELEM_SEND_TIMEOUT_MS * 1000};
+    (void)setsockopt(c, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    const uint64_t deadline = tx_telem_now_ns() + TX_TELEM_SEND_TIMEOUT_MS * 1000000ull;
+    char req[1024];
+    struct pollfd pfd = {.fd = c, .events = POLLIN};
+    if (poll(&pfd, 1, 200) > 0)
+        (void)recv(c, req, sizeof(req), 0); // any request path gets the metrics
+
+    char *body = NULL;
+    size_t len = 0;
+    FILE *m = open_memstream(&body, &len);
+    if (m) {
+        tx_telem_write_prom(t, m);
+        fclose(m);
+        char hdr[160];
+        int hl = snprintf(hdr, sizeof(hdr),
+                          "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %zu\r\n"
+                          "Connection: close\r\n\r\n",
+                          len);
+        if (send(c, hdr, (size_t)hl, MSG_NOSIGNAL) != hl)
+            len = 0;
+        for (size_t off = 0; off < len && tx_telem_now_ns() < deadline;) {
+            ssize_t n = send(c, body + off, len - off, MSG_NOSIGNAL);
+            if (n <= 0)
+                break;
+            off += (size_t)n;
+        }
+        free(body);
+    }
+    close(c);
+}
+
+static inline void tx_telem_export(tx_telem_t *t) {
+    if (t->mode == TX_TELEM_JSONL) {
+        tx_telem_write_json(t, t->out);
+        fflush(t->out);
+    } else if (t->mode == TX_TELEM_PROM_FILE) {
+        tx_telem_write_prom_file(t);
+    }
+}
+
+static inline void *tx_telem_thread(void *arg) {
+    tx_telem_t *t = (tx_telem_t *)arg;
+    uint64_t next = tx_telem_now_ns() + (uint64_t)t->interval_ms * 1000000ull;
+    while (!atomic_load_explicit(&t->stop, memory_order_relaxed)) {
+        uint64_t now = tx_telem_now_ns();
+        if (now >= next) {
+            tx_telem_export(t);
+            next += (uint64_t)t->interval_ms * 1000000ull;
+            if (next <= now)
+                next = now + (uint64_t)t->interval_ms * 1000000ull;
+            continue;
+        }
+        int wait_ms = (int)((next - now) / 1000000ull) + 1;
+        if (wait_ms > 100)
+            wait_ms = 100; // re-check stop
+        if (t->mode == TX_TELEM_PROM_HTTP) {
+            struct pollfd pfd = {.fd = t->listen_fd, .events = POLLIN};
+            if (poll(&pfd, 1, wait_ms) > 0)
+                tx_telem_serve(t);
+        } else {
+            struct timespec ts = {0, (long)wait_ms * 1000000L};
+            nanosleep(&ts, NULL);
+        }
+    }
+    return NULL;
+}
+
+// Start the exporter; mode TX_TELEM_OFF only zeroes the counters. nch = streams reported.
+static inline int tx_telem_start(tx_telem_t *t, int mode, const char *target, const char *tool, int nch,
+                                 unsigned interval_ms) {
+    memset(t, 0, sizeof(*t));
+    t->listen_fd = -1;
+    t->tool = tool;
+    t->nch = nch < 1 ? 1 : (nch > TX_TELEM_MAX_CH ? TX_TELEM_MAX_CH : nch);
+    t->interval_ms = interval_ms ? interval_ms : TX_TELEM_INTERVAL_MS_DEF;
+    clock_gettime(CLOCK_MONOTONIC, &t->t0);
+    if (mode == TX_TELEM_OFF)
+        return 0;
+    snprintf(t->target, sizeof(t->target), "%s", target);
+
+    if (mode == TX_TELEM_JSONL) {
+        t->out = strcmp(target, "-") ? fopen(target, "a") : stdout;
+        if (!t->out) {
+            fprintf(stderr, "telemetry: cannot open %s: %s\n", target, strerror(errno));
+            return -1;
+        }
+    } else if (mode == TX_TELEM_PROM_HTTP) {
+        struct sockaddr_in sa;
+        int one = 1;
+        if (!tx_telem_prom_addr(target, &sa)) {
+            fprintf(stderr, "telemetry: bad address %s\n", target);
+            return -1;
+        }
+        t->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (t->listen_fd < 0 || setsockopt(t->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) ||
+            bind(t->listen_fd, (struct sockaddr *)&sa, sizeof(sa)) || listen(t->listen_fd, 8)) {
+            fprintf(stderr, "telemetry: cannot listen on %s: %s\n", target, strerror(errno));
+            if (t->listen_fd >= 0)
+                close(t->listen_fd);
+            t->listen_fd = -1;
+            return -1;
+        }
+    }
+    t->mode = mode;
+    if (pthread_create(&t->th, NULL, tx_telem_thread, t)) {
+        fprintf(stderr, "telemetry: failed to start exporter thread\n");
+        t->mode = TX_TELEM_OFF;
+        return -1;
+    }
+    t->started = true;
+    if (mode == TX_TELEM_PROM_HTTP)
+        printf("telemetry: Prometheus metrics on http://%s%s/metrics\n", strchr(target, ':') ? "" : "127.0.0.1:", target);
+    else
+        printf("telemetry: %s every %u ms to %s\n", mode == TX_TELEM_JSONL ? "JSON lines" : "Prometheus textfile",
+               t->interval_ms, target);
+    return 0;
+}
+
+// Stop the exporter after one final export.
+static inline void tx_telem_stop(tx_telem_t *t) {
+    if (t->started) {
+        atomic_store(&t->stop, 1);
+        pthread_join(t->th, NULL);
+        t->started = false;
+        tx_telem_export(t);
+    }
+    if (t->out && t->out != stdout)
+        fclose(t->out);
+    t->out = NULL;
+    if (t->listen_fd >= 0)
+        close(t->listen_fd);
+    t->listen_fd = -1;
+    t->mode = TX_TELEM_OFF;
+}
+
+#endif
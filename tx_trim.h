@@ -0,0 +1,509 @@
+#ifndef TX_TRIM_H
+#define TX_TRIM_H
+
+// Closed-loop TX image and LO-leak trim over the internal RX loopback (--autotrim).
+// The FPGA waveform player plays a single tone (DC, or a baseband tone when the NCO offset is too
+// small to tell it from the LO), the TX NCO moves it to f_sig and the RX input is switched to LB1
+// or LB2 (whichever taps the active TX band). The RX LO sits f_sh below the TX LO, so the TX
+// tone, its image at -f_sig, the TX LO leak and the RX chip's own DC land at four distinct
+// frequencies. Three RX NCO slots move the tone, the image or the leak onto fs/8; a window is a
+// single LMS_SetNCOIndex write, and each measurement is the Hann-windowed power around that one
+// FFT bin of a TX_TRIM_N capture taken after the register writes have settled (by RX timestamp).
+//
+// Image power is a quadratic in (GCORRI - GCORRQ, IQCORR) and leak power a quadratic in
+// (DCCORRI, DCCORRQ), and the two do not interact, so both run in lockstep: every iteration
+// writes all five correctors in one limetx_apply_manual() transaction and reads both windows.
+// Each pass probes one coordinate of each pair at +-delta and jumps to the vertex of the
+// parabola through the three points; deltas shrink over TX_TRIM_PASSES passes. A few dozen
+// captures at the host rate, so the trim is over in tens of milliseconds.
+//
+// The probe goes out of the antenna port at the current TX gain, like LMS_Calibrate's tones.
+
+#include "iq_fft.h"
+#include "limetx.h"
+#include "lime/LimeSuite.h"
+#include "tx_calcache.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TX_TRIM_N 1024          // capture and FFT length; the measured bin is N/8 (fs/8)
+#define TX_TRIM_LOBE 2          // bins either side of it summed (Hann main lobe)
+#define TX_TRIM_SETTLE 256      // samples after a write that still carry the old setting
+#define TX_TRIM_GUARD_BINS 16   // minimum spacing of any two components at the measured bin
+#define TX_TRIM_AMPL 0.5        // probe amplitude, FS
+#define TX_TRIM_WFM_FMT 1       // LMS_UploadWFM int16
+#define TX_TRIM_RX_GAIN_DEF 30  // dB, then levelled to a TX_TRIM_RX_PEAK peak
+#define TX_TRIM_RX_GAIN_MAX 70
+#define TX_TRIM_RX_PEAK 0.3
+#define TX_TRIM_MIN_SNR_DB 30.0 // tone over the noise in the same bins
+#define TX_TRIM_GOAL_DBC -70.0  // both below: stop early
+#define TX_TRIM_PASSES 3
+#define TX_TRIM_REACH 8  // vertex jump limit, in probe steps
+#define TX_TRIM_REPEAT 4 // steps per coordinate and pass while the minimum is not bracketed
+#define TX_TRIM_RECV_TIMEOUT_MS 100
+#define TX_TRIM_MAX_RECV 256 // reads spent waiting for settled samples
+
+enum { TX_TRIM_SIG, TX_TRIM_IMG, TX_TRIM_LO, TX_TRIM_NWIN };
+
+// gd = GCORRI - GCORRQ; the larger of the two stays at 2047
+typedef struct {
+    int gd, iq, dci, dcq;
+} tx_trim_pt_t;
+
+typedef struct {
+    lms_device_t *dev;
+    int ch;
+    double fs, rf;            // host and RX TSP rate
+    double f_bb, f_sig, f_sh; // probe in the waveform, probe offset from the TX LO, RX LO below TX LO
+    double tx_lo, rx_lo;
+    double shift[TX_TRIM_NWIN]; // signed RX NCO shift per window
+    bool flip;                  // this RX NCO shifts the other way for a given downconv flag
+    int win;                    // live RX NCO slot, -1 unknown
+    int rx_gain;
+    char ant[16];
+    lms_stream_t rxs;
+    iq_fft_t fft;
+    float *w, *x;
+    int16_t *raw, *wfm;
+    double wnorm;
+    bool wfm_on, rx_on;
+    double sig;               // tone power at the RX, FS^2
+    double img0, lo0, img, lo; // dBc before and after
+    tx_trim_pt_t start, best;
+    unsigned iters, captures;
+    double ms;
+} tx_trim_t;
+
+static inline void tx_trim_gains(const tx_trim_pt_t *p, int *gi, int *gq) {
+    *gi = 2047 + (p->gd < 0 ? p->gd : 0);
+    *gq = 2047 - (p->gd > 0 ? p->gd : 0);
+}
+
+static inline void tx_trim_clamp(tx_trim_pt_t *p) {
+    p->gd = limetx_clampi(p->gd, -2047, 2047);
+    p->iq = limetx_clampi(p->iq, -2047, 2047);
+    p->dci = limetx_clampi(p->dci, -128, 127);
+    p->dcq = limetx_clampi(p->dcq, -128, 127);
+}
+
+static inline int tx_trim_apply(limetx_regs_t *r, int ch, const tx_trim_pt_t *p) {
+    int gi, gq;
+    tx_trim_gains(p, &gi, &gq);
+    return limetx_apply_manual(r, ch, true, gi, true, gq, true, p->iq, true, p->dci, true, p->dcq);
+}
+
+static inline double tx_trim_db(double ratio) { return 10.0 * log10(ratio > 1e-30 ? ratio : 1e-30); }
+
+// Frequencies before the RX NCO of the tone, image, TX LO leak and RX DC, for a given f_sh.
+// Every window must keep the other three (and their RX IQ mirrors) off the measured bin; a
+// component moved out of the RX band is removed by the decimation filters.
+static inline bool tx_trim_plan_ok(tx_trim_t *t, double f_sig, double f_sh) {
+    const double pos[4] = {f_sig + f_sh, -f_sig + f_sh, f_sh, 0.0};
+    const double fm = t->fs / 8, guard = TX_TRIM_GUARD_BINS * t->fs / TX_TRIM_N;
+    for (int x = 0; x < TX_TRIM_NWIN; x++) {
+        if (fabs(fm - pos[x]) > 0.45 * t->rf)
+            return false;
+        for (int y = 0; y < 4; y++) {
+            const double d = pos[y] - pos[x];
+            if (y != x && (fabs(d) < guard || fabs(d + 2 * fm) < guard))
+                return false;
+        }
+    }
+    for (int x = 0; x < TX_TRIM_NWIN; x++)
+        t->shift[x] = fm - pos[x];
+    t->f_sig = f_sig;
+    t->f_sh = f_sh;
+    return true;
+}
+
+static inline bool tx_trim_plan(tx_trim_t *t, double nco_off) {
+    static const double bb[] = {0.0, 0.25, -0.25, 0.1875};
+    static const double sh[] = {0.25, -0.25, 0.375, -0.375, 0.125, -0.125, 0.3125, -0.3125};
+    for (size_t i = 0; i < sizeof(bb) / sizeof(bb[0]); i++)
+        for (size_t j = 0; j < sizeof(sh) / sizeof(sh[0]); j++)
+            if (tx_trim_plan_ok(t, nco_off + bb[i] * t->fs, sh[j] * t->fs)) {
+                t->f_bb = bb[i] * t->fs;
+                return true;
+            }
+    return false;
+}
+
+// Power (FS^2) around fs/8 with window win selected, and the capture's peak sample (FS).
+static inline int tx_trim_capture(tx_trim_t *t, int win, double *p, double *peak) {
+    if (win != t->win) {
+        if (LMS_SetNCOIndex(t->dev, LMS_CH_RX, t->ch, win, (t->shift[win] < 0) != t->flip))
+            return -1;
+        t->win = win;
+    }
+    lms_stream_status_t st;
+    if (LMS_GetStreamStatus(&t->rxs, &st))
+        return -1;
+    lms_stream_meta_t meta;
+    for (int k = 0;; k++) {
+        memset(&meta, 0, sizeof(meta));
+        if (k == TX_TRIM_MAX_RECV ||
+            LMS_RecvStream(&t->rxs, t->raw, TX_TRIM_SETTLE, &meta, TX_TRIM_RECV_TIMEOUT_MS) != TX_TRIM_SETTLE)
+            return -1;
+        if (meta.timestamp >= st.timestamp)
+            break;
+    }
+    memset(&meta, 0, sizeof(meta));
+    if (LMS_RecvStream(&t->rxs, t->raw, TX_TRIM_N, &meta, TX_TRIM_RECV_TIMEOUT_MS) != TX_TRIM_N)
+        return -1;
+    t->captures++;
+
+    float pk = 0.0f;
+    for (int i = 0; i < 2 * TX_TRIM_N; i++) {
+        const float v = t->raw[i] * (1.0f / 32767.0f);
+        pk = fabsf(v) > pk ? fabsf(v) : pk;
+        t->x[i] = v * t->w[i >> 1];
+    }
+    iq_fft_run(&t->fft, t->x);
+    double acc = 0.0;
+    for (int k = TX_TRIM_N / 8 - TX_TRIM_LOBE; k <= TX_TRIM_N / 8 + TX_TRIM_LOBE; k++)
+        acc += (double)t->x[2 * k] * t->x[2 * k] + (double)t->x[2 * k + 1] * t->x[2 * k + 1];
+    *p = acc / t->wnorm;
+    if (peak)
+        *peak = pk;
+    return 0;
+}
+
+static inline int tx_trim_cmpf(const void *a, const void *b) {
+    const float x = *(const float *)a, y = *(const float *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Noise in the measured bins, estimated from the median bin of the last capture.
+static inline double tx_trim_floor(const tx_trim_t *t) {
+    float *m = (float *)malloc(TX_TRIM_N * sizeof(float));
+    if (!m)
+        return 0.0;
+    for (int k = 0; k < TX_TRIM_N; k++)
+        m[k] = t->x[2 * k] * t->x[2 * k] + t->x[2 * k + 1] * t->x[2 * k + 1];
+    qsort(m, TX_TRIM_N, sizeof(float), tx_trim_cmpf);
+    const double med = m[TX_TRIM_N / 2];
+    free(m);
+    return med * (2 * TX_TRIM_LOBE + 1) / t->wnorm;
+}
+
+// One iteration: all correctors in one transaction, then the image and leak windows (starting
+// with whichever is live, so consecutive iterations share an NCO switch).
+static inline int tx_trim_measure(tx_trim_t *t, limetx_regs_t *r, const tx_trim_pt_t *p, double *img, double *lo) {
+    if (tx_trim_apply(r, t->ch, p))
+        return -1;
+    t->iters++;
+    double pi = 0, pl = 0;
+    const bool lo_first = t->win == TX_TRIM_LO;
+    if (tx_trim_capture(t, lo_first ? TX_TRIM_LO : TX_TRIM_IMG, lo_first ? &pl : &pi, NULL) ||
+        tx_trim_capture(t, lo_first ? TX_TRIM_IMG : TX_TRIM_LO, lo_first ? &pi : &pl, NULL))
+        return -1;
+    *img = pi / t->sig;
+    *lo = pl / t->sig;
+    return 0;
+}
+
+// Offset to the vertex of the parabola through (-d, a), (0, b), (d, c), at most TX_TRIM_REACH d.
+// *far is set when the probes do not bracket the minimum: the fit is then only a direction (the
+// GCORR kink at gd = 0 bends it), and the step is repeated from where it lands.
+static inline int tx_trim_vertex(double a, double b, double c, int d, bool *far) {
+    const double den = a - 2 * b + c;
+    *far = den <= 0 || fabs(a - c) > 2 * den;
+    if (den <= 0)
+        return a < c ? -d : d;
+    const int lim = TX_TRIM_REACH * d;
+    const double v = d * (a - c) / (2 * den);
+    return (int)lround(v < -lim ? -lim : (v > lim ? lim : v));
+}
+
+static inline int *tx_trim_img_coord(tx_trim_pt_t *p, int k) { return k ? &p->iq : &p->gd; }
+static inline int *tx_trim_dc_coord(tx_trim_pt_t *p, int k) { return k ? &p->dcq : &p->dci; }
+
+static inline void tx_trim_teardown(tx_trim_t *t) {
+    if (t->rxs.handle) {
+        LMS_StopStream(&t->rxs);
+        LMS_DestroyStream(t->dev, &t->rxs);
+    }
+    if (t->rx_on)
+        (void)LMS_EnableChannel(t->dev, LMS_CH_RX, t->ch, false);
+    if (t->wfm_on)
+        (void)LMS_EnableTxWFM(t->dev, t->ch, false);
+    t->rx_on = t->wfm_on = false;
+    iq_fft_free(&t->fft);
+    free(t->w);
+    free(t->x);
+    free(t->raw);
+    free(t->wfm);
+    t->w = t->x = NULL;
+    t->raw = t->wfm = NULL;
+}
+
+static inline int tx_trim_fail(tx_trim_t *t, limetx_regs_t *r, const char *what) {
+    fprintf(stderr, "autotrim: %s (%s)\n", what, LMS_GetLastErrorMessage());
+    tx_trim_teardown(t);
+    limetx_regs_invalidate(r); // RX channel off again
+    (void)tx_trim_apply(r, t->ch, &t->start);
+    return -1;
+}
+
+// Probe, RX loopback path and stream.
+static inline int tx_trim_setup(tx_trim_t *t, double nco_off) {
+    lms_device_t *dev = t->dev;
+    if (LMS_GetSampleRate(dev, LMS_CH_RX, t->ch, &t->fs, &t->rf) || t->fs <= 0 ||
+        LMS_GetLOFrequency(dev, LMS_CH_TX, t->ch, &t->tx_lo))
+        return -1;
+    if (!tx_trim_plan(t, nco_off)) {
+        fprintf(stderr, "autotrim: no probe layout keeps the tone, image and leak apart at %.3f Msps\n", t->fs / 1e6);
+        return -1;
+    }
+
+    if (iq_fft_init(&t->fft, TX_TRIM_N, false))
+        return -1;
+    t->w = (float *)malloc(TX_TRIM_N * sizeof(float));
+    t->x = (float *)malloc(2 * TX_TRIM_N * sizeof(float));
+    t->raw = (int16_t *)malloc(2 * TX_TRIM_N * sizeof(int16_t));
+    t->wfm = (int16_t *)calloc(4 * TX_TRIM_N, sizeof(int16_t)); // probe, then silence for the other channel
+    if (!t->w || !t->x || !t->raw || !t->wfm)
+        return -1;
+    double ws = 0.0;
+    for (int i = 0; i < TX_TRIM_N; i++) {
+        t->w[i] = (float)(0.5 - 0.5 * cos(2.0 * M_PI * i / TX_TRIM_N));
+        ws += t->w[i];
+    }
+    t->wnorm = ws * ws * 1.5; // a unit tone's Hann main lobe: 1 + 2 * 0.25
+
+    // The waveform holds a whole number of probe periods (f_bb is a multiple of fs/16)
+    for (int n = 0; n < TX_TRIM_N; n++) {
+        const double ph = 2.0 * M_PI * t->f_bb / t->fs * n;
+        t->wfm[2 * n] = (int16_t)lrint(TX_TRIM_AMPL * 32767.0 * cos(ph));
+        t->wfm[2 * n + 1] = (int16_t)lrint(TX_TRIM_AMPL * 32767.0 * sin(ph));
+    }
+    const void *src[LIMETX_NCH] = {t->wfm, t->wfm};
+    src[t->ch ? 0 : 1] = t->wfm + 2 * TX_TRIM_N;
+    if (LMS_UploadWFM(dev, src, (uint8_t)(t->ch + 1), TX_TRIM_N, TX_TRIM_WFM_FMT) ||
+        LMS_EnableTxWFM(dev, t->ch, true))
+        return -1;
+    t->wfm_on = true;
+
+    if (LMS_EnableChannel(dev, LMS_CH_RX, t->ch, true))
+        return -1;
+    t->rx_on = true;
+    lms_name_t names[16];
+    const int na = LMS_GetAntennaList(dev, LMS_CH_RX, t->ch, NULL);
+    if (na < 1 || na > 16 || LMS_GetAntennaList(dev, LMS_CH_RX, t->ch, names) < 0)
+        return -1;
+    snprintf(t->ant, sizeof(t->ant), "%s", LMS_GetAntenna(dev, LMS_CH_TX, t->ch) == LMS_PATH_TX2 ? "LB2" : "LB1");
+    int ant = -1;
+    for (int i = 0; i < na; i++)
+        if (!strcmp(names[i], t->ant))
+            ant = i;
+    if (ant < 0) {
+        fprintf(stderr, "autotrim: RX has no %s loopback path\n", t->ant);
+        return -1;
+    }
+    if (LMS_SetAntenna(dev, LMS_CH_RX, t->ch, (size_t)ant))
+        return -1;
+
+    // Boards with one shared synthesizer keep RX on the TX LO; re-plan around what was set
+    if (LMS_SetLOFrequency(dev, LMS_CH_RX, t->ch, t->tx_lo - t->f_sh) ||
+        LMS_GetLOFrequency(dev, LMS_CH_RX, t->ch, &t->rx_lo))
+        return -1;
+    if (fabs(t->tx_lo - t->rx_lo - t->f_sh) > 1.0 && !tx_trim_plan_ok(t, t->f_sig, t->tx_lo - t->rx_lo)) {
+        fprintf(stderr, "autotrim: RX LO stays at %.6f MHz, the leak can't be told from RX DC\n", t->rx_lo / 1e6);
+        return -1;
+    }
+    const double span = fabs(t->f_sig) + fabs(t->f_sh);
+    (void)LMS_SetLPFBW(dev, LMS_CH_RX, t->ch, fmin(fmax(2.4 * span, 1.5e6), 130e6));
+    t->rx_gain = TX_TRIM_RX_GAIN_DEF;
+    if (LMS_SetGaindB(dev, LMS_CH_RX, t->ch, (unsigned)t->rx_gain))
+        return -1;
+    float_type freqs[16] = {0};
+    for (int k = 0; k < TX_TRIM_NWIN; k++)
+        freqs[k] = fabs(t->shift[k]);
+    if (LMS_SetNCOFrequency(dev, LMS_CH_RX, t->ch, freqs, 0))
+        return -1;
+    t->win = -1;
+
+    memset(&t->rxs, 0, sizeof(t->rxs));
+    t->rxs.channel = (uint32_t)t->ch;
+    t->rxs.fifoSize = 16 * TX_TRIM_N;
+    t->rxs.throughputVsLatency = 0.0f;
+    t->rxs.isTx = false;
+    t->rxs.dataFmt = LMS_FMT_I16;
+    if (LMS_SetupStream(dev, &t->rxs)) {
+        t->rxs.handle = 0;
+        return -1;
+    }
+    return LMS_StartStream(&t->rxs);
+}
+
+// Level the RX, find which way its NCO turns and check the tone stands out.
+static inline int tx_trim_acquire(tx_trim_t *t) {
+    double ps = 0, pi = 0, pk = 0;
+    for (int k = 0; k < 4; k++) {
+        if (tx_trim_capture(t, TX_TRIM_SIG, &ps, &pk))
+            return -1;
+        const int g = limetx_clampi(t->rx_gain + (int)lround(20.0 * log10(TX_TRIM_RX_PEAK / fmax(pk, 1e-4))), 0,
+                                    TX_TRIM_RX_GAIN_MAX);
+        if ((pk > TX_TRIM_RX_PEAK / 3 && pk < TX_TRIM_RX_PEAK * 2) || abs(g - t->rx_gain) < 2)
+            break;
+        t->rx_gain = g;
+        if (LMS_SetGaindB(t->dev, LMS_CH_RX, t->ch, (unsigned)g))
+            return -1;
+    }
+    for (int k = 0; k < 2; k++) {
+        if (tx_trim_capture(t, TX_TRIM_SIG, &ps, NULL) || tx_trim_capture(t, TX_TRIM_IMG, &pi, NULL))
+            return -1;
+        if (ps > pi)
+            break;
+        t->flip = !t->flip;
+        t->win = -1;
+    }
+    if (tx_trim_capture(t, TX_TRIM_SIG, &ps, NULL))
+        return -1;
+    const double snr = tx_trim_db(ps / fmax(tx_trim_floor(t), 1e-30));
+    if (ps <= pi || snr < TX_TRIM_MIN_SNR_DB) {
+        fprintf(stderr, "autotrim: loopback tone %.1f dB over the noise on %s at RX gain %d dB, need %.0f\n", snr,
+                t->ant, t->rx_gain, TX_TRIM_MIN_SNR_DB);
+        return -1;
+    }
+    t->sig = ps;
+    return 0;
+}
+
+// Trim the correctors of ch at the current LO/NCO (nco_hz, downconvert as set with
+// LMS_SetNCOIndex). Starts from whatever is on the chip, e.g. LMS_Calibrate's result, and leaves
+// the best point found there. Returns 0 on success; on failure the starting values are restored.
+static inline int tx_trim_run(tx_trim_t *t, limetx_regs_t *r, int ch, double nco_hz, bool downconvert) {
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    memset(t, 0, sizeof(*t));
+    t->dev = r->dev;
+    t->ch = ch;
+
+    limetx_txtsp_t c;
+    if (limetx_read_txtsp(r, ch, &c)) {
+        fprintf(stderr, "autotrim: can't read the correctors (%s)\n", LMS_GetLastErrorMessage());
+        return -1;
+    }
+    t->start.gd = c.gc_byp ? 0 : c.gi - c.gq;
+    t->start.iq = c.ph_byp ? 0 : c.iq;
+    t->start.dci = c.dc_byp ? 0 : c.dci;
+    t->start.dcq = c.dc_byp ? 0 : c.dcq;
+    tx_trim_clamp(&t->start);
+
+    const int setup = tx_trim_setup(t, downconvert ? -nco_hz : nco_hz);
+    limetx_regs_invalidate(r); // setup enabled RX and moved the RX LO and NCO
+    if (setup)
+        return tx_trim_fail(t, r, "loopback setup failed");
+    if (tx_trim_apply(r, ch, &t->start) || tx_trim_acquire(t))
+        return tx_trim_fail(t, r, "no usable loopback signal");
+
+    static const int d_img[TX_TRIM_PASSES] = {48, 12, 3}, d_dc[TX_TRIM_PASSES] = {8, 3, 1};
+    const double goal = pow(10.0, TX_TRIM_GOAL_DBC / 10.0);
+    tx_trim_pt_t cur = t->start;
+    double ci, cl;
+    if (tx_trim_measure(t, r, &cur, &ci, &cl))
+        return tx_trim_fail(t, r, "capture failed");
+    t->img0 = tx_trim_db(ci);
+    t->lo0 = tx_trim_db(cl);
+    t->best = cur;
+    for (int pass = 0; pass < TX_TRIM_PASSES && (ci > goal || cl > goal); pass++) {
+        for (int k = 0; k < 2; k++) {
+            bool far_i = true, far_l = true;
+            for (int n = 0; n < TX_TRIM_REPEAT && (far_i || far_l) && (ci > goal || cl > goal); n++) {
+                tx_trim_pt_t pt[2] = {cur, cur};
+                double pi[2], pl[2];
+                for (int s = 0; s < 2; s++) {
+                    *tx_trim_img_coord(&pt[s], k) += s ? d_img[pass] : -d_img[pass];
+                    *tx_trim_dc_coord(&pt[s], k) += s ? d_dc[pass] : -d_dc[pass];
+                    tx_trim_clamp(&pt[s]);
+                    if (tx_trim_measure(t, r, &pt[s], &pi[s], &pl[s]))
+                        return tx_trim_fail(t, r, "capture failed");
+                }
+                tx_trim_pt_t v = cur;
+                *tx_trim_img_coord(&v, k) += tx_trim_vertex(pi[0], ci, pi[1], d_img[pass], &far_i);
+                *tx_trim_dc_coord(&v, k) += tx_trim_vertex(pl[0], cl, pl[1], d_dc[pass], &far_l);
+                tx_trim_clamp(&v);
+                double vi, vl;
+                if (tx_trim_measure(t, r, &v, &vi, &vl))
+                    return tx_trim_fail(t, r, "capture failed");
+                far_i = far_i && vi < ci;
+                far_l = far_l && vl < cl;
+
+                // Keep the best image pair and the best DC pair seen; they are independent
+                const tx_trim_pt_t *cand[3] = {&pt[0], &pt[1], &v};
+                const double cand_i[3] = {pi[0], pi[1], vi}, cand_l[3] = {pl[0], pl[1], vl};
+                for (int j = 0; j < 3; j++) {
+                    if (cand_i[j] < ci) {
+                        ci = cand_i[j];
+                        cur.gd = cand[j]->gd;
+                        cur.iq = cand[j]->iq;
+                    }
+                    if (cand_l[j] < cl) {
+                        cl = cand_l[j];
+                        cur.dci = cand[j]->dci;
+                        cur.dcq = cand[j]->dcq;
+                    }
+                }
+            }
+        }
+    }
+
+    // Final point, measured against a fresh tone reading
+    t->best = cur;
+    double ps = 0;
+    if (tx_trim_apply(r, ch, &cur) || tx_trim_capture(t, TX_TRIM_SIG, &ps, NULL))
+        return tx_trim_fail(t, r, "capture failed");
+    t->sig = ps;
+    if (tx_trim_measure(t, r, &cur, &ci, &cl))
+        return tx_trim_fail(t, r, "capture failed");
+    t->img = tx_trim_db(ci);
+    t->lo = tx_trim_db(cl);
+    tx_trim_teardown(t);
+    limetx_regs_invalidate(r);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    t->ms = (double)(t1.tv_sec - t0.tv_sec) * 1e3 + (double)(t1.tv_nsec - t0.tv_nsec) / 1e6;
+    return 0;
+}
+
+static inline void tx_trim_print(const tx_trim_t *t) {
+    int gi, gq;
+    tx_trim_gains(&t->best, &gi, &gq);
+    printf("autotrim: %s loopback, probe %+.3f MHz, RX LO %+.3f MHz from TX, RX gain %d dB\n", t->ant,
+           t->f_sig / 1e6, -t->f_sh / 1e6, t->rx_gain);
+    printf("autotrim: image %.1f -> %.1f dBc, LO leak %.1f -> %.1f dBc (%u iterations, %u captures, %.1f ms)\n",
+           t->img0, t->img, t->lo0, t->lo, t->iters, t->captures, t->ms);
+    printf("autotrim: GCORRI=%d GCORRQ=%d IQCORR=%d DCCORRI=%d DCCORRQ=%d\n", gi, gq, t->best.iq, t->best.dci,
+           t->best.dcq);
+}
+
+// txcal_calibrate() with the loopback trim: restore from the cache at path when possible,
+// otherwise trim (after LMS_Calibrate when lms_seed) and store the result.
+static inline int tx_trim_calibrate(limetx_regs_t *r, const txcal_key_t *k, const char *path, int max_age_s,
+                                    bool downconvert, bool lms_seed) {
+    if (path && txcal_restore(r, k, path, max_age_s))
+        return 0;
+    if (path)
+        printf("calibration cache: miss, running %s\n",
+               lms_seed ? "LMS_Calibrate and the loopback trim" : "the loopback trim");
+    if (lms_seed) {
+        const int rc = LMS_Calibrate(r->dev, LMS_CH_TX, k->ch, k->bw_hz, 0);
+        limetx_regs_invalidate(r);
+        if (rc)
+            return rc;
+    }
+    tx_trim_t t;
+    if (tx_trim_run(&t, r, k->ch, k->nco_hz, downconvert))
+        return -1;
+    tx_trim_print(&t);
+    if (path)
+        txcal_store(r, k, path);
+    return 0;
+}
+
+#endif
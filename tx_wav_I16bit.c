@@ -1,8 +1,28 @@
+#define _GNU_SOURCE
+#include "iq_pack.h"
+#include "iq_resamp.h"
+#include "iq_ring.h"
+#include "iq_scale.h"
+#include "iq_stats.h"
 #include "lime/LimeSuite.h"
+#include "limetx.h"
+#include "tx_boot.h"
+#include "tx_burst.h"
+#include "tx_calcache.h"
+#include "tx_chunk.h"
+#include "tx_cmd.h"
+#include "tx_ctrl.h"
+#include "tx_mimo.h"
+#include "tx_rt.h"
+#include "tx_telem.h"
+#include "tx_trim.h"
+#include "wav_aio.h"
+#include "wav_mmap.h"
 #include <ctype.h>
 #include <errno.h>
 #include <inttypes.h>
 #include <math.h>
+#include <pthread.h>
 #include <signal.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -10,12 +30,16 @@
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <time.h>
 
 #define CH 0
+#define CH_B 1 // second channel of a 4-channel (I_A Q_A I_B Q_B) WAV
 #define NCO_INDEX 0
-#define FIFO_SIZE_SAMPLES (1 << 17)
-#define BUF_SAMPLES 8192
+#define FIFO_SIZE_SAMPLES (1 << 17) // --fifo-size
+#define BUF_SAMPLES 8192            // --chunk; --chunk-goal adapts it at run time
 #define SEND_TIMEOUT_MS 1000
+#define RING_DEPTH_DEF 8
+#define ANALYZE_BLOCK_MS 100 // --analyze per-block RMS/peak/clip granularity
 
 // clang-format off
 #define CHECK(x) do { \
@@ -50,38 +74,6 @@ static void print_nco(lms_device_t *dev) {
     printf("set/get: NCO idx=%d (no frequency readback in this LimeSuite)\n", idx);
 }
 
-// clang-format off
-static bool parse_bool(const char* s, bool* out){
-    if (!s || !out) return false;
-    if (!strcasecmp(s,"1") || !strcasecmp(s,"true") || !strcasecmp(s,"yes") || !strcasecmp(s,"on")) { *out=true;  return true; }
-    if (!strcasecmp(s,"0") || !strcasecmp(s,"false")|| !strcasecmp(s,"no")  || !strcasecmp(s,"off")){ *out=false; return true; }
-    return false;
-}
-
-static bool parse_hz(const char* s, double* out){
-    if (!s || !out) return false;
-    char* end = NULL;
-    double v = strtod(s, &end);
-    if (end && *end != '\0'){
-        while (*end && isspace((unsigned char)*end)) end++;
-        if (*end){
-            double mul = 1.0;
-            char c = (char)tolower((unsigned char)*end);
-            if (c=='k') mul = 1e3;
-            else if (c=='m') mul = 1e6;
-            else if (c=='g') mul = 1e9;
-            else return false;
-            end++;
-            while (*end && isspace((unsigned char)*end)) end++;
-            if (*end!='\0') return false;
-            v *= mul;
-        }
-    }
-    *out = v;
-    return true;
-}
-// clang-format on
-
 static int clampi(int v, int lo, int hi) {
     if (v < lo)
         return lo;
@@ -177,8 +169,9 @@ static bool parse_wav(const char *path, wav_info_t *wi, FILE **outf) {
         fclose(f);
         return false;
     }
-    if (wi->channels != 2 || wi->bits_per_sample != 16) {
-        fprintf(stderr, "WAV: need stereo(2ch) 16-bit; got %u ch, %u bits\n", wi->channels, wi->bits_per_sample);
+    if ((wi->channels != 2 && wi->channels != 4) || wi->bits_per_sample != 16) {
+        fprintf(stderr, "WAV: need 16-bit stereo (I/Q) or 4ch (I_A/Q_A/I_B/Q_B); got %u ch, %u bits\n", wi->channels,
+                wi->bits_per_sample);
         fclose(f);
         return false;
     }
@@ -190,84 +183,120 @@ static bool parse_wav(const char *path, wav_info_t *wi, FILE **outf) {
     return true;
 }
 
-static int set_mac_channel(lms_device_t *dev, int ch) {
-    uint16_t v = 0;
-    if (LMS_ReadLMSReg(dev, 0x0020, &v))
-        return -1;
-    v = (uint16_t)((v & ~0x3) | (ch == 0 ? 0x1 : 0x2));
-    return LMS_WriteLMSReg(dev, 0x0020, v);
-}
-
-static void print_tx_correctors(lms_device_t *dev, int ch) {
-    if (set_mac_channel(dev, ch)) {
-        fprintf(stderr, "WARN: can't set MAC for channel %c\n", ch ? 'B' : 'A');
-        return;
-    }
-
-    uint16_t reg_gq = 0, reg_gi = 0, reg_iq = 0, reg_dc = 0;
-
-    (void)LMS_ReadLMSReg(dev, 0x0201, &reg_gq); // GCORRQ[10:0]
-    (void)LMS_ReadLMSReg(dev, 0x0202, &reg_gi); // GCORRI[10:0]
-    (void)LMS_ReadLMSReg(dev, 0x0203, &reg_iq); // IQCORR[11:0] (signed)
-    (void)LMS_ReadLMSReg(dev, 0x0204, &reg_dc); // DCCORRI[15:8], DCCORRQ[7:0]
-
-    int gq = (int)(reg_gq & 0x07FF);
-    int gi = (int)(reg_gi & 0x07FF);
-
-    int iq = (int)(reg_iq & 0x0FFF);
-    if (iq & 0x0800)
-        iq |= ~0x0FFF;
-
-    int dci = (int8_t)((reg_dc >> 8) & 0xFF);
-    int dcq = (int8_t)(reg_dc & 0xFF);
-
-    printf("gain: GCORRI=%d, GCORRQ=%d\n", gi, gq);
-    printf("phase: IQCORR=%d\n", iq);
-    printf("dc: DCCORRI=%d, DCCORRQ=%d\n", dci, dcq);
-}
+typedef struct {
+    FILE *wf;
+    uint64_t data_offset;
+    uint64_t data_bytes;
+    size_t bytes_per_frame;
+    bool loop;
+    iq_scale_fn scale_fn;
+    iq_scale_q_t scale_q;
+    tx_cmd_scale_t *live_scale; // --control scale, picked up per chunk
+    unsigned scale_seen;
+    iq_resamp_t *rs; // NULL when the WAV rate is the host rate
+    int16_t *rs_in;  // one input chunk for the resampler
+    wav_aio_t *aio;        // --io direct, else fread() on wf
+    iq_pack_reader_t *pack; // .iqz input, decoded ahead by its own threads
+    iq_ring_t *ring;
+    tx_telem_t *telem;
+    atomic_size_t chunk; // output frames per slot; the stream thread resizes it, slots hold the maximum
+} reader_ctx_t;
+
+// Producer: file -> ring. Owns every fread()/fseek() (or wav_aio_read()) so page-cache misses and
+// disk latency never stall LMS_SendStream.
+static void *reader_thread(void *arg) {
+    reader_ctx_t *rc = (reader_ctx_t *)arg;
+    iq_ring_t *ring = rc->ring;
+    const size_t lanes = rc->bytes_per_frame / sizeof(int16_t);
+    uint64_t bytes_left = rc->data_bytes;
 
-static int apply_manual_txtsp(lms_device_t *dev, int ch, bool have_gi, int gi, bool have_gq, int gq, bool have_phase,
-                              int phase, bool have_dci, int dci, bool have_dcq, int dcq) {
-    if (set_mac_channel(dev, ch))
-        return -1;
+    while (keep_running) {
+        iq_slot_t *slot = NULL;
+        int16_t *dst = iq_ring_acquire(ring, &slot);
+        if (!dst) {
+            atomic_fetch_add_explicit(&ring->full_waits, 1, memory_order_relaxed);
+            iq_ring_pause(500000);
+            continue;
+        }
 
-    int rc = 0;
+        const size_t chunk = atomic_load_explicit(&rc->chunk, memory_order_relaxed);
+        const size_t bytes_per_chunk = (rc->rs ? iq_resamp_max_in(rc->rs, chunk) : chunk) * rc->bytes_per_frame;
+        size_t want = bytes_per_chunk;
+        if (!rc->loop && bytes_left < want)
+            want = (size_t)bytes_left;
+
+        const uint64_t t_read = tx_telem_now_ns();
+        void *into = rc->rs ? (void *)rc->rs_in : (void *)dst;
+        size_t got = 0;
+        if (want)
+            got = rc->pack  ? iq_pack_read(rc->pack, into, want)
+                  : rc->aio ? wav_aio_read(rc->aio, into, want)
+                            : fread(into, 1, want, rc->wf);
+        tx_telem_read(rc->telem, t_read, got);
+        size_t frames = got / rc->bytes_per_frame;
+        if (rc->rs)
+            frames = iq_resamp_process(rc->rs, rc->rs_in, frames, dst);
+
+        tx_cmd_scale_poll(rc->live_scale, &rc->scale_seen, &rc->scale_q);
+        if (frames > 0 && rc->scale_q.scale != 1.0)
+            rc->scale_fn(dst, dst, frames * lanes, &rc->scale_q);
+
+        slot->frames = frames;
+        slot->eof = (rc->aio && wav_aio_failed(rc->aio)) || (rc->pack && iq_pack_failed(rc->pack));
+
+        if (!rc->loop) {
+            bytes_left -= got;
+            if (got < bytes_per_chunk || bytes_left == 0)
+                slot->eof = true;
+        } else if (got < want && !rc->aio && !rc->pack) { // wav_aio_read() and iq_pack_read() wrap by themselves
+            fseek(rc->wf, (long)rc->data_offset, SEEK_SET);
+        }
 
-    if (have_gi) {
-        gi = clampi(gi, 0, 2047);
-        rc |= LMS_WriteLMSReg(dev, 0x0202, (uint16_t)((uint16_t)gi & 0x07FF)); // GCORRI
-    }
-    if (have_gq) {
-        gq = clampi(gq, 0, 2047);
-        rc |= LMS_WriteLMSReg(dev, 0x0201, (uint16_t)((uint16_t)gq & 0x07FF)); // GCORRQ
-    }
-    if (have_phase) {
-        phase = clampi(phase, -2047, 2047);
-        uint16_t iq12 = (uint16_t)((uint16_t)phase & 0x0FFF); // IQCORR (12 bit signed)
-        rc |= LMS_WriteLMSReg(dev, 0x0203, iq12);
+        iq_ring_publish(ring);
+        if (slot->eof)
+            break;
     }
+    return NULL;
+}
 
-    if (have_dci || have_dcq) {
-        uint16_t reg_dc = 0;
-        rc |= LMS_ReadLMSReg(dev, 0x0204, &reg_dc); // DCCORR
-        if (have_dci) {
-            int8_t dci_s = (int8_t)clampi(dci, -128, 127);
-            reg_dc = (uint16_t)((reg_dc & 0x00FFu) | ((uint16_t)(uint8_t)dci_s << 8)); // I in [15:8]
-        }
-        if (have_dcq) {
-            int8_t dcq_s = (int8_t)clampi(dcq, -128, 127);
-            reg_dc = (uint16_t)((reg_dc & 0xFF00u) | (uint16_t)(uint8_t)dcq_s); // Q in [7:0]
+// --bursts: queue every index entry at its sample time as a pointer walk over the mapping (scaled
+// into buf when a scale is set). Each burst's pages are advised in before waiting for it. With
+// --loop the schedule repeats, one cycle being the end of its latest burst.
+static void stream_bursts(tx_burst_t *b, wav_map_t *wm, const tx_burst_ent_t *ents, long n, bool loop, size_t chunk,
+                          int16_t *buf, reader_ctx_t *rc, tx_telem_t *telem) {
+    uint64_t cycle = 0;
+    for (long k = 0; k < n; k++)
+        if (ents[k].at + ents[k].frames > cycle)
+            cycle = ents[k].at + ents[k].frames;
+    for (uint64_t base = 0; keep_running; base += cycle) {
+        for (long k = 0; k < n; k++) {
+            const tx_burst_ent_t *e = &ents[k];
+            wav_map_advise(wm, e->offset * wm->bytes_per_frame);
+            if (!tx_burst_begin(b, base + e->at, e->frames, &keep_running))
+                return;
+            const int16_t *p = (const int16_t *)(wm->data + e->offset * wm->bytes_per_frame);
+            for (uint64_t done = 0; done < e->frames;) {
+                const size_t m = e->frames - done < chunk ? (size_t)(e->frames - done) : chunk;
+                const int16_t *src = p + 2 * done;
+                tx_cmd_scale_poll(rc->live_scale, &rc->scale_seen, &rc->scale_q);
+                if (rc->scale_q.scale != 1.0) {
+                    rc->scale_fn(buf, src, 2 * m, &rc->scale_q);
+                    src = buf;
+                }
+                const uint64_t t0 = tx_telem_now_ns();
+                const int err = tx_burst_send(b, src, m, SEND_TIMEOUT_MS);
+                tx_telem_send(telem, t0, m, !err);
+                if (err) {
+                    fprintf(stderr, "LMS_SendStream error: %s\n", LMS_GetLastErrorMessage());
+                    return;
+                }
+                done += m;
+            }
         }
-        rc |= LMS_WriteLMSReg(dev, 0x0204, reg_dc);
+        if (!loop)
+            break;
     }
-
-    // Clear PH, GC, DC bypass so manual values take effect
-    uint16_t byp = 0;
-    rc |= LMS_ReadLMSReg(dev, 0x0208, &byp);
-    byp &= (uint16_t)~((1u << 0) | (1u << 1) | (1u << 3)); // clear PH_BYP (bit0), GC_BYP (bit1), DC_BYP (bit3)
-    rc |= LMS_WriteLMSReg(dev, 0x0208, byp);
-
-    return rc;
+    tx_burst_drain(b, &keep_running);
 }
 
 int main(int argc, char **argv) {
@@ -281,10 +310,42 @@ int main(int argc, char **argv) {
 
     const char *WAV_PATH = NULL;
     bool LOOP = false;
+    bool USE_MMAP = false;
+    bool USE_AIO = false;
+    wav_aio_backend_t AIO_BACKEND = WAV_AIO_AUTO;
+    int AIO_DEPTH = WAV_AIO_DEPTH_DEF;
+    unsigned long long AIO_BLOCK = WAV_AIO_BLOCK_DEF;
+    int DECODE_THREADS = 0; // .iqz decoders, 0 = one per CPU but one
     double SCALE = 1.0;
+    int LINK_FMT = LMS_LINK_FMT_I16;
+    int RING_DEPTH = RING_DEPTH_DEF;
+    double SR_OPT = 0;      // host rate; 0 = the WAV rate (no resampling)
+    int RESAMP_THREADS = 0; // 0 = one per CPU, used only when a chunk is expensive
+    int TELEM_MODE = TX_TELEM_OFF;
+    char TELEM_TARGET[TX_TELEM_PATH_MAX] = "";
+    int TELEM_INTERVAL_MS = TX_TELEM_INTERVAL_MS_DEF;
+    const char *CONTROL = NULL; // --control udp:[host:]port | unix:path
+    const char *BURST_INDEX = NULL; // --bursts <index>: timestamped bursts instead of a stream
+    double BURST_LEAD_MS = TX_BURST_QUEUE_MS_DEF;
+    bool ANALYZE = false;   // level/spectrum stats of what was actually sent, off the stream thread
+    int ANALYZE_FFT = 4096; // 0 = levels only
+    const char *ANALYZE_JSON = NULL;
+    tx_rt_t rt;
+    tx_rt_init(&rt);
+    int FIFO_SIZE = 0; // 0 = FIFO_SIZE_SAMPLES, or sized from the budget with --chunk-goal latency:<ms>
+    int CHUNK = BUF_SAMPLES;
+    tx_chunk_goal_t CHUNK_GOAL = TX_CHUNK_FIXED;
+    double LATENCY_MS = 0;
 
     bool DO_RESET = false;
     bool DO_CALIBRATE = false;
+    bool AUTOTRIM = false; // loopback trim, after LMS_Calibrate with --calibrate
+    const char *STATE_SAVE = NULL;
+    const char *STATE_LOAD = NULL;
+    char CAL_CACHE_BUF[TXCAL_PATH_MAX];
+    const char *CAL_CACHE = CAL_CACHE_BUF;
+    int CAL_MAX_AGE_S = TXCAL_MAX_AGE_DEF_S;
+    txcal_default_path(CAL_CACHE_BUF, sizeof(CAL_CACHE_BUF));
 
     bool PRINT_CORRECTORS = false;
     bool SET_GI = false, SET_GQ = false, SET_PHASE = false, SET_DCI = false, SET_DCQ = false;
@@ -296,18 +357,47 @@ int main(int argc, char **argv) {
         #define NEEDVAL() do{ if (i+1>=argc){ fprintf(stderr,"missing value for %s\n", a); return 1; } }while(0)
 
         if (!strcmp(a,"--file")){ NEEDVAL(); WAV_PATH = argv[++i]; continue; }
+        if (!strcmp(a,"--state-save")){ NEEDVAL(); STATE_SAVE = argv[++i]; continue; }
+        if (!strcmp(a,"--state-load")){ NEEDVAL(); STATE_LOAD = argv[++i]; continue; }
         if (!strcmp(a,"--oversample")){ NEEDVAL(); OVERSAMPLE = (int)strtol(argv[++i], NULL, 0); if (OVERSAMPLE<1){ fprintf(stderr,"bad --oversample\n"); return 1; } continue; }
-        if (!strcmp(a,"--tx-lpf-bw")){ NEEDVAL(); if(!parse_hz(argv[++i], &TX_LPF_BW_HZ)) { fprintf(stderr,"bad --tx-lpf-bw\n"); return 1; } continue; }
-        if (!strcmp(a,"--lo")){ NEEDVAL(); if(!parse_hz(argv[++i], &LO_HZ)) { fprintf(stderr,"bad --lo\n"); return 1; } continue; }
-        if (!strcmp(a,"--nco")){ NEEDVAL(); if(!parse_hz(argv[++i], &NCO_FREQ_HZ)) { fprintf(stderr,"bad --nco\n"); return 1; } continue; }
-        if (!strcmp(a,"--nco-downconvert")){ NEEDVAL(); if(!parse_bool(argv[++i], &NCO_DOWNCONVERT)) { fprintf(stderr,"bad --nco-downconvert\n"); return 1; } continue; }
+        if (!strcmp(a,"--tx-lpf-bw")){ NEEDVAL(); if(!limetx_parse_hz(argv[++i], &TX_LPF_BW_HZ)) { fprintf(stderr,"bad --tx-lpf-bw\n"); return 1; } continue; }
+        if (!strcmp(a,"--lo")){ NEEDVAL(); if(!limetx_parse_hz(argv[++i], &LO_HZ)) { fprintf(stderr,"bad --lo\n"); return 1; } continue; }
+        if (!strcmp(a,"--nco")){ NEEDVAL(); if(!limetx_parse_hz(argv[++i], &NCO_FREQ_HZ)) { fprintf(stderr,"bad --nco\n"); return 1; } continue; }
+        if (!strcmp(a,"--nco-downconvert")){ NEEDVAL(); if(!limetx_parse_bool(argv[++i], &NCO_DOWNCONVERT)) { fprintf(stderr,"bad --nco-downconvert\n"); return 1; } continue; }
         if (!strcmp(a,"--tx-gain")){ NEEDVAL(); TX_GAIN_DB = (int)strtol(argv[++i], NULL, 0); if (TX_GAIN_DB<0 || TX_GAIN_DB>73){ fprintf(stderr,"--tx-gain (must be 0..73 dB typical)\n"); } continue; }
-        if (!strcmp(a,"--cal-bw")){ NEEDVAL(); if(!parse_hz(argv[++i], &CAL_BW_HZ)) { fprintf(stderr,"bad --cal-bw\n"); return 1; } continue; }
+        if (!strcmp(a,"--cal-bw")){ NEEDVAL(); if(!limetx_parse_hz(argv[++i], &CAL_BW_HZ)) { fprintf(stderr,"bad --cal-bw\n"); return 1; } continue; }
         if (!strcmp(a,"--loop")){ LOOP = true; continue; }
+        if (!strcmp(a,"--sample-rate")){ NEEDVAL(); if(!limetx_parse_hz(argv[++i], &SR_OPT)) { fprintf(stderr,"bad --sample-rate\n"); return 1; } continue; }
+        if (!strcmp(a,"--resample-threads")){ NEEDVAL(); RESAMP_THREADS = (int)strtol(argv[++i], NULL, 0); continue; }
+        if (!strcmp(a,"--mmap")){ USE_MMAP = true; continue; }
+        if (!strcmp(a,"--io")){ NEEDVAL(); a = argv[++i]; if (!strcmp(a,"fread")) USE_AIO = false; else if (!strcmp(a,"direct")) USE_AIO = true; else { fprintf(stderr,"bad --io (fread|direct)\n"); return 1; } continue; }
+        if (!strcmp(a,"--decode-threads")){ NEEDVAL(); DECODE_THREADS = (int)strtol(argv[++i], NULL, 0); if (DECODE_THREADS<0 || DECODE_THREADS>IQ_PACK_THREADS_MAX){ fprintf(stderr,"bad --decode-threads (0..%d)\n", IQ_PACK_THREADS_MAX); return 1; } continue; }
+        if (!strcmp(a,"--io-backend")){ NEEDVAL(); if(!wav_aio_parse_backend(argv[++i], &AIO_BACKEND)) { fprintf(stderr,"bad --io-backend (auto|uring|threads)\n"); return 1; } continue; }
+        if (!strcmp(a,"--io-depth")){ NEEDVAL(); AIO_DEPTH = (int)strtol(argv[++i], NULL, 0); if (AIO_DEPTH<2 || AIO_DEPTH>WAV_AIO_DEPTH_MAX){ fprintf(stderr,"bad --io-depth (2..%d)\n", WAV_AIO_DEPTH_MAX); return 1; } continue; }
+        if (!strcmp(a,"--io-block")){ NEEDVAL(); AIO_BLOCK = strtoull(argv[++i], NULL, 0); if (AIO_BLOCK<WAV_AIO_ALIGN || AIO_BLOCK>(64u<<20)){ fprintf(stderr,"bad --io-block (%u..%u bytes)\n", WAV_AIO_ALIGN, 64u<<20); return 1; } continue; }
+        if (!strcmp(a,"--ring-depth")){ NEEDVAL(); RING_DEPTH = (int)strtol(argv[++i], NULL, 0); if (RING_DEPTH<2 || RING_DEPTH>1024){ fprintf(stderr,"bad --ring-depth (2..1024)\n"); return 1; } continue; }
+        if (!strcmp(a,"--fifo-size")){ NEEDVAL(); FIFO_SIZE = (int)strtol(argv[++i], NULL, 0); if (FIFO_SIZE<4*TX_CHUNK_MIN){ fprintf(stderr,"bad --fifo-size (>= %d samples)\n", 4*TX_CHUNK_MIN); return 1; } continue; }
+        if (!strcmp(a,"--chunk")){ NEEDVAL(); CHUNK = (int)strtol(argv[++i], NULL, 0); if (CHUNK<1 || CHUNK>TX_CHUNK_MAX_DEF){ fprintf(stderr,"bad --chunk (1..%d frames)\n", TX_CHUNK_MAX_DEF); return 1; } continue; }
+        if (!strcmp(a,"--chunk-goal")){ NEEDVAL(); if(!tx_chunk_parse_goal(argv[++i], &CHUNK_GOAL, &LATENCY_MS)) { fprintf(stderr,"bad --chunk-goal (off|underrun|latency:<ms>)\n"); return 1; } continue; }
+        if (!strcmp(a,"--rt")){ rt.enabled = true; if (i+1 < argc){ bool v=false; if (limetx_parse_bool(argv[i+1], &v)){ rt.enabled = v; i++; } } continue; }
+        if (!strcmp(a,"--rt-cpu")){ NEEDVAL(); rt.cpu = (int)strtol(argv[++i], NULL, 0); if (rt.cpu<0){ fprintf(stderr,"bad --rt-cpu\n"); return 1; } continue; }
+        if (!strcmp(a,"--rt-prio")){ NEEDVAL(); rt.prio = (int)strtol(argv[++i], NULL, 0); if (rt.prio<1 || rt.prio>99){ fprintf(stderr,"bad --rt-prio (1..99)\n"); return 1; } continue; }
+        if (!strcmp(a,"--telemetry")){ NEEDVAL(); if(!tx_telem_parse(argv[++i], &TELEM_MODE, TELEM_TARGET, sizeof(TELEM_TARGET))) { fprintf(stderr,"bad --telemetry (jsonl:<path|->, prom-file:<path>, prom:[host:]<port>)\n"); return 1; } continue; }
+        if (!strcmp(a,"--telemetry-interval-ms")){ NEEDVAL(); TELEM_INTERVAL_MS = (int)strtol(argv[++i], NULL, 0); if (TELEM_INTERVAL_MS<10){ fprintf(stderr,"bad --telemetry-interval-ms (>= 10)\n"); return 1; } continue; }
+        if (!strcmp(a,"--bursts")){ NEEDVAL(); BURST_INDEX = argv[++i]; continue; }
+        if (!strcmp(a,"--burst-lead")){ NEEDVAL(); BURST_LEAD_MS = strtod(argv[++i], NULL); if (BURST_LEAD_MS<0 || BURST_LEAD_MS>TX_BURST_QUEUE_MS_MAX){ fprintf(stderr,"bad --burst-lead\n"); return 1; } continue; }
+        if (!strcmp(a,"--control")){ NEEDVAL(); CONTROL = argv[++i]; if (!tx_cmd_parse_target(CONTROL)){ fprintf(stderr,"bad --control (udp:[host:]port, unix:<path>)\n"); return 1; } continue; }
         if (!strcmp(a,"--scale")){ NEEDVAL(); SCALE = strtod(argv[++i], NULL); if (SCALE<0.0 || SCALE>4.0){ fprintf(stderr,"--scale out of range\n"); return 1; } continue; }
-        if (!strcmp(a,"--reset")){ DO_RESET = true; if (i+1 < argc){ bool v=false; if (parse_bool(argv[i+1], &v)){ DO_RESET = v; i++; } } continue; }
-        if (!strcmp(a,"--calibrate")){ DO_CALIBRATE = true; if (i+1 < argc){ bool v=false; if (parse_bool(argv[i+1], &v)){ DO_CALIBRATE = v; i++; } } continue; }
-        if (!strcmp(a,"--print-correctors")){ PRINT_CORRECTORS = true; if (i+1 < argc){ bool v=false; if (parse_bool(argv[i+1], &v)){ PRINT_CORRECTORS = v; i++; } } continue; }
+        if (!strcmp(a,"--analyze")){ ANALYZE = true; if (i+1 < argc){ bool v=false; if (limetx_parse_bool(argv[i+1], &v)){ ANALYZE = v; i++; } } continue; }
+        if (!strcmp(a,"--analyze-fft")){ NEEDVAL(); ANALYZE_FFT = (int)strtol(argv[++i], NULL, 0); if (ANALYZE_FFT && (ANALYZE_FFT<16 || ANALYZE_FFT>(1<<20) || (ANALYZE_FFT & (ANALYZE_FFT-1)))){ fprintf(stderr,"bad --analyze-fft (0 or a power of two, 16..1048576)\n"); return 1; } continue; }
+        if (!strcmp(a,"--analyze-json")){ NEEDVAL(); ANALYZE_JSON = argv[++i]; ANALYZE = true; continue; }
+        if (!strcmp(a,"--link-fmt")){ NEEDVAL(); if(!limetx_parse_link_fmt(argv[++i], &LINK_FMT)) { fprintf(stderr,"bad --link-fmt (i12|i16)\n"); return 1; } continue; }
+        if (!strcmp(a,"--reset")){ DO_RESET = true; if (i+1 < argc){ bool v=false; if (limetx_parse_bool(argv[i+1], &v)){ DO_RESET = v; i++; } } continue; }
+        if (!strcmp(a,"--calibrate")){ DO_CALIBRATE = true; if (i+1 < argc){ bool v=false; if (limetx_parse_bool(argv[i+1], &v)){ DO_CALIBRATE = v; i++; } } continue; }
+        if (!strcmp(a,"--autotrim")){ AUTOTRIM = true; if (i+1 < argc){ bool v=false; if (limetx_parse_bool(argv[i+1], &v)){ AUTOTRIM = v; i++; } } continue; }
+        if (!strcmp(a,"--cal-cache")){ NEEDVAL(); CAL_CACHE = argv[++i]; if (!strcmp(CAL_CACHE,"off")) CAL_CACHE = NULL; continue; }
+        if (!strcmp(a,"--cal-cache-max-age")){ NEEDVAL(); CAL_MAX_AGE_S = (int)strtol(argv[++i], NULL, 0); continue; }
+        if (!strcmp(a,"--print-correctors")){ PRINT_CORRECTORS = true; if (i+1 < argc){ bool v=false; if (limetx_parse_bool(argv[i+1], &v)){ PRINT_CORRECTORS = v; i++; } } continue; }
         if (!strcmp(a,"--set-gain-i")){ NEEDVAL(); SET_GI=true; MAN_GI=clampi((int)strtol(argv[++i], NULL, 0), 0, 2047); continue; }
         if (!strcmp(a,"--set-gain-q")){ NEEDVAL(); SET_GQ=true; MAN_GQ=clampi((int)strtol(argv[++i], NULL, 0), 0, 2047); continue; }
         if (!strcmp(a,"--set-phase")) { NEEDVAL(); SET_PHASE=true; MAN_PHASE=clampi((int)strtol(argv[++i], NULL, 0), -2047, 2047); continue; }
@@ -325,17 +415,113 @@ int main(int argc, char **argv) {
 
     wav_info_t wi;
     FILE *wf = NULL;
-    if (!parse_wav(WAV_PATH, &wi, &wf))
+    iq_pack_file_hdr_t iqz;
+    const bool IQZ = iq_pack_probe(WAV_PATH, &iqz) == 1;
+    if (IQZ) {
+        // Decoded by iq_pack_reader_t below; wf stays open only so the error paths can fclose() it.
+        memset(&wi, 0, sizeof(wi));
+        wi.sample_rate = iqz.sample_rate;
+        wi.bits_per_sample = 16;
+        wi.channels = (uint16_t)iqz.lanes;
+        wi.data_bytes = iqz.frames * iqz.lanes * sizeof(int16_t);
+        if ((wi.channels != 2 && wi.channels != 4) || !(wf = fopen(WAV_PATH, "rb"))) {
+            fprintf(stderr, "iqz: need 2 or 4 channels; got %u\n", wi.channels);
+            return 1;
+        }
+        if (USE_MMAP || USE_AIO) {
+            fprintf(stderr, "WARN: %s is compressed, --mmap / --io direct ignored\n", WAV_PATH);
+            USE_MMAP = USE_AIO = false;
+        }
+    } else if (!parse_wav(WAV_PATH, &wi, &wf)) {
         return 1;
-    const double HOST_SR_HZ = (double)wi.sample_rate;
-
-    printf("WAV: %u Hz, %u-bit, %u ch, data=%" PRIu64 " bytes @ 0x%08" PRIx64 "\n", wi.sample_rate, wi.bits_per_sample,
-           wi.channels, wi.data_bytes, wi.data_offset);
+    }
+    const double HOST_SR_HZ = SR_OPT > 0 ? SR_OPT : (double)wi.sample_rate;
+    const bool RESAMPLE = fabs(HOST_SR_HZ - (double)wi.sample_rate) >= 0.5;
+    if (RESAMPLE && USE_MMAP) {
+        fprintf(stderr, "WARN: --mmap hands file data straight to the stream, ignored while resampling\n");
+        USE_MMAP = false;
+    }
+    if (USE_MMAP && USE_AIO) {
+        fprintf(stderr, "WARN: --mmap reads through the page cache, --io direct ignored\n");
+        USE_AIO = false;
+    }
+    const bool DUAL = wi.channels == 4;
+    tx_burst_ent_t *bursts = NULL;
+    long n_bursts = 0;
+    bool bad_bursts = false; // checked against the mapping, which knows how much data the file has
+    if (BURST_INDEX) {
+        if (IQZ || RESAMPLE || DUAL) {
+            fprintf(stderr, "--bursts needs an uncompressed 2-channel WAV at the host rate\n");
+            fclose(wf);
+            return 1;
+        }
+        if ((n_bursts = tx_burst_load_index(BURST_INDEX, &bursts)) < 0) {
+            fclose(wf);
+            return 1;
+        }
+        USE_MMAP = true; // bursts are sent straight from the mapping
+        USE_AIO = false;
+        if (ANALYZE) {
+            fprintf(stderr, "WARN: --analyze taps the continuous stream, ignored with --bursts\n");
+            ANALYZE = false;
+        }
+    }
+    if (FIFO_SIZE == 0)
+        FIFO_SIZE = CHUNK_GOAL == TX_CHUNK_LATENCY ? (int)tx_chunk_fifo_for_latency(LATENCY_MS, HOST_SR_HZ)
+                                                   : FIFO_SIZE_SAMPLES;
+    tx_chunk_t chunk;
+    tx_chunk_init(&chunk, CHUNK_GOAL, HOST_SR_HZ, (uint32_t)FIFO_SIZE, (size_t)CHUNK, TX_CHUNK_MAX_DEF, LATENCY_MS);
+    const size_t CHUNK_MAX = chunk.max; // ring slots, the mmap seam and every buffer below hold this many frames
+
+    if (IQZ)
+        printf("IQZ: %u Hz, %u ch, %" PRIu64 " frames in %u blocks of %u\n", wi.sample_rate, wi.channels, iqz.frames,
+               iqz.nblocks, iqz.block_frames);
+    else
+        printf("WAV: %u Hz, %u-bit, %u ch, data=%" PRIu64 " bytes @ 0x%08" PRIx64 "\n", wi.sample_rate,
+               wi.bits_per_sample, wi.channels, wi.data_bytes, wi.data_offset);
 
     lms_device_t *dev = NULL;
+    limetx_regs_t regs;
     lms_stream_t txs;
+    tx_mimo_t mimo;
+    double host_sr = HOST_SR_HZ, rf_sr = 0; // what the device runs at, once the rate is set
+    iq_ring_t ring;
+    wav_map_t wm;
+    wav_aio_t aio;
+    iq_pack_reader_t pack;
+    iq_resamp_t rs;
+    tx_telem_t telem;
+    iq_stats_tap_t tap;
+    tx_ctrl_t ctrl;
+    tx_cmd_t cmd;
+    tx_burst_t burst;
     int16_t *buf = NULL;
+    pthread_t reader;
+    bool reader_started = false;
     memset(&txs, 0, sizeof(txs));
+    memset(&mimo, 0, sizeof(mimo));
+    memset(&ring, 0, sizeof(ring));
+    memset(&wm, 0, sizeof(wm));
+    memset(&aio, 0, sizeof(aio));
+    aio.fd = aio.ring_fd = -1;
+    memset(&pack, 0, sizeof(pack));
+    pack.fd = -1;
+    memset(&rs, 0, sizeof(rs));
+    memset(&tap, 0, sizeof(tap));
+    memset(&ctrl, 0, sizeof(ctrl));
+    memset(&burst, 0, sizeof(burst));
+    tx_cmd_init(&cmd);
+    if (tx_rt_begin(&rt, !USE_MMAP)) { // MCL_FUTURE would pin the whole --mmap mapping
+        fclose(wf);
+        return 1;
+    }
+    if (tx_telem_start(&telem, TELEM_MODE, TELEM_TARGET, "tx_wav_I16bit", DUAL ? 2 : 1, (unsigned)TELEM_INTERVAL_MS)) {
+        fclose(wf);
+        return 1;
+    }
+
+    tx_boot_t boot;
+    tx_boot_begin(&boot, CH);
 
     lms_info_str_t list[8];
     int n = LMS_GetDeviceList(list);
@@ -349,63 +535,96 @@ int main(int argc, char **argv) {
         fclose(wf);
         return 1;
     }
+    tx_boot_attach(&boot, dev);
+    limetx_regs_init(&regs, dev);
 
     if (DO_RESET) {
         CHECK(LMS_Reset(dev));
         printf("device reset to defaults\n");
     }
-    CHECK(LMS_Init(dev));
+    CHECK(tx_boot_init_device(&boot, STATE_LOAD));
 
     CHECK(LMS_EnableChannel(dev, LMS_CH_TX, CH, true));
     printf("TX channel enabled\n");
 
-    CHECK(LMS_SetSampleRate(dev, HOST_SR_HZ, OVERSAMPLE));
+    CHECK(tx_boot_sample_rate(&boot, HOST_SR_HZ, OVERSAMPLE));
     print_sr(dev);
+    // The CGEN PLL rounds the rate: device timestamps advance at the one actually set
+    CHECK(LMS_GetSampleRate(dev, LMS_CH_TX, CH, &host_sr, &rf_sr));
+    if (host_sr <= 0)
+        host_sr = HOST_SR_HZ;
 
-    CHECK(LMS_SetLPFBW(dev, LMS_CH_TX, CH, TX_LPF_BW_HZ));
+    CHECK(tx_boot_lpf_bw(&boot, TX_LPF_BW_HZ));
 
-    CHECK(LMS_SetGaindB(dev, LMS_CH_TX, CH, TX_GAIN_DB));
+    CHECK(tx_boot_gain(&boot, TX_GAIN_DB));
     print_gain(dev);
 
-    CHECK(LMS_SetLOFrequency(dev, LMS_CH_TX, CH, LO_HZ));
+    CHECK(tx_boot_lo(&boot, LO_HZ));
     print_lo(dev);
 
     {
         double freqs[16] = {0};
         freqs[NCO_INDEX] = NCO_FREQ_HZ;
-        CHECK(LMS_SetNCOFrequency(dev, true, CH, freqs, 0.0));
-        CHECK(LMS_SetNCOIndex(dev, true, CH, NCO_INDEX, NCO_DOWNCONVERT));
+        CHECK(tx_boot_nco(&boot, freqs, NCO_INDEX, NCO_DOWNCONVERT));
         print_nco(dev);
+        if (DUAL) {
+            CHECK(tx_mimo_config_ch(dev, CH_B, TX_LPF_BW_HZ, TX_GAIN_DB, freqs, NCO_INDEX, NCO_DOWNCONVERT));
+            printf("TX channel B enabled (LO shared with A)\n");
+        }
     }
 
-    if (DO_CALIBRATE) {
-        CHECK(LMS_Calibrate(dev, LMS_CH_TX, CH, CAL_BW_HZ, 0));
-        printf("TX calibrated (bw=%.2f MHz)\n", CAL_BW_HZ / 1e6);
+    if (DO_CALIBRATE || AUTOTRIM) {
+        txcal_key_t cal_key;
+        CHECK(txcal_key_init(&cal_key, dev, CH, LO_HZ, NCO_FREQ_HZ, CAL_BW_HZ));
+        CHECK(AUTOTRIM ? tx_trim_calibrate(&regs, &cal_key, CAL_CACHE, CAL_MAX_AGE_S, NCO_DOWNCONVERT, DO_CALIBRATE)
+                       : txcal_calibrate(&regs, &cal_key, CAL_CACHE, CAL_MAX_AGE_S));
+        if (DUAL) {
+            CHECK(txcal_key_init(&cal_key, dev, CH_B, LO_HZ, NCO_FREQ_HZ, CAL_BW_HZ));
+            CHECK(AUTOTRIM ? tx_trim_calibrate(&regs, &cal_key, CAL_CACHE, CAL_MAX_AGE_S, NCO_DOWNCONVERT, DO_CALIBRATE)
+                           : txcal_calibrate(&regs, &cal_key, CAL_CACHE, CAL_MAX_AGE_S));
+        }
+        printf("TX calibrated (%s, bw=%.2f MHz%s)\n", AUTOTRIM ? "autotrim" : "LMS_Calibrate", CAL_BW_HZ / 1e6,
+               DUAL ? ", A and B" : "");
     }
 
     if (PRINT_CORRECTORS) {
-        print_tx_correctors(dev, CH);
+        limetx_print_correctors_short(&regs, CH);
     }
 
     if (SET_GI || SET_GQ || SET_PHASE || SET_DCI || SET_DCQ) {
-        CHECK(apply_manual_txtsp(dev, CH, SET_GI, MAN_GI, SET_GQ, MAN_GQ, SET_PHASE, MAN_PHASE, SET_DCI, MAN_DCI,
+        CHECK(limetx_apply_manual(&regs, CH, SET_GI, MAN_GI, SET_GQ, MAN_GQ, SET_PHASE, MAN_PHASE, SET_DCI, MAN_DCI,
                                  SET_DCQ, MAN_DCQ));
         printf("Manual TXTSP correctors applied.\n");
         if (PRINT_CORRECTORS) {
-            print_tx_correctors(dev, CH);
+            limetx_print_correctors_short(&regs, CH);
         }
     }
 
-    txs.channel = CH;
-    txs.isTx = true;
-    txs.fifoSize = FIFO_SIZE_SAMPLES;
-    txs.dataFmt = LMS_FMT_I16;
-    CHECK(LMS_SetupStream(dev, &txs));
-    CHECK(LMS_StartStream(&txs));
-    printf("TX stream started (fifo=%d samples, fmt=I16)\n", FIFO_SIZE_SAMPLES);
+    tx_boot_mark(&boot, "correctors");
+    if (STATE_SAVE)
+        tx_boot_save(&boot, STATE_SAVE);
+
+    if (DUAL) {
+        CHECK(tx_mimo_start(&mimo, dev, (uint32_t)FIFO_SIZE, LINK_FMT, CHUNK_MAX, host_sr));
+        printf("TX streams A+B started (fifo=%d samples, fmt=I16, link=%s, deinterleave=%s, t0=%" PRIu64 ")\n",
+               FIFO_SIZE, limetx_link_fmt_name(LINK_FMT), mimo.kernel, mimo.ts);
+        limetx_print_link(LINK_FMT, TX_MIMO_NCH * host_sr);
+    } else {
+        txs.channel = CH;
+        txs.isTx = true;
+        txs.fifoSize = (uint32_t)FIFO_SIZE;
+        txs.dataFmt = LMS_FMT_I16;
+        txs.linkFmt = LINK_FMT;
+        CHECK(LMS_SetupStream(dev, &txs));
+        CHECK(LMS_StartStream(&txs));
+        printf("TX stream started (fifo=%d samples, fmt=I16, link=%s)\n", FIFO_SIZE,
+               limetx_link_fmt_name(LINK_FMT));
+        limetx_print_link(LINK_FMT, host_sr);
+    }
+    tx_chunk_print(&chunk);
+    tx_boot_mark(&boot, "stream");
+    tx_boot_print(&boot);
 
-    double host_sr = 0, rf_sr = 0;
-    LMS_GetSampleRate(dev, LMS_CH_TX, CH, &host_sr, &rf_sr);
     unsigned int g_cur = 0;
     LMS_GetGaindB(dev, LMS_CH_TX, CH, &g_cur);
 
@@ -414,64 +633,199 @@ int main(int argc, char **argv) {
            rf_sr / 1e6, g_cur, NCO_DOWNCONVERT ? "down" : "up");
     printf("Streaming: %s  (Ctrl+C to stop)\n", WAV_PATH);
 
-    buf = (int16_t *)malloc(2 * BUF_SAMPLES * sizeof(int16_t));
-    if (!buf) {
-        fprintf(stderr, "malloc failed\n");
-        goto cleanup;
+    // Live changes go through the control worker; up before the reader, which polls the scale.
+    if (CONTROL) {
+        const int chs[LIMETX_NCH] = {CH, CH_B};
+        if (tx_ctrl_start(&ctrl, dev, CH) ||
+            tx_cmd_start(&cmd, CONTROL, &ctrl, &regs, chs, DUAL ? 2 : 1, SCALE, NCO_FREQ_HZ, NCO_DOWNCONVERT))
+            goto cleanup;
+    }
+
+    reader_ctx_t rctx = {
+        .wf = wf,
+        .data_offset = wi.data_offset,
+        .data_bytes = wi.data_bytes,
+        .bytes_per_frame = (size_t)wi.channels * (wi.bits_per_sample / 8),
+        .loop = LOOP,
+        .live_scale = &cmd.scale,
+        .ring = &ring,
+        .telem = &telem,
+        .chunk = chunk.cur,
+    };
+    if (RESAMPLE) {
+        if (iq_resamp_init(&rs, (double)wi.sample_rate, HOST_SR_HZ, rctx.bytes_per_frame / sizeof(int16_t),
+                           IQ_RESAMP_TAPS_DEF, CHUNK_MAX, RESAMP_THREADS))
+            goto cleanup;
+        buf = (int16_t *)tx_rt_alloc(&rt, wi.channels * CHUNK_MAX * sizeof(int16_t));
+        if (!buf) {
+            fprintf(stderr, "malloc failed\n");
+            goto cleanup;
+        }
+        rctx.rs = &rs;
+        rctx.rs_in = buf;
+        printf("resample: %u -> %.0f Hz (L/M = %u/%u, %zu taps/phase, %s kernel, up to %d threads)\n", wi.sample_rate,
+               HOST_SR_HZ, rs.L, rs.M, rs.taps, rs.kernel, rs.nthreads);
+    }
+    const char *scale_kernel = NULL;
+    rctx.scale_fn = iq_scale_select(&scale_kernel);
+    iq_scale_q_init(&rctx.scale_q, SCALE);
+    if (SCALE != 1.0 || CONTROL)
+        printf("scale: %.4f using %s kernel\n", SCALE, scale_kernel);
+
+    if (USE_MMAP) {
+        if (wav_map_open(&wm, fileno(wf), wi.data_offset, wi.data_bytes, rctx.bytes_per_frame, CHUNK_MAX, LOOP))
+            goto cleanup;
+        wm.chunk_frames = chunk.cur;
+        for (long k = 0; k < n_bursts; k++) {
+            if (bursts[k].offset + bursts[k].frames > wm.frames) {
+                fprintf(stderr, "burst %ld (offset %" PRIu64 ", %" PRIu64 " frames) runs past the %" PRIu64
+                                " frames in %s\n",
+                        k, bursts[k].offset, bursts[k].frames, wm.frames, WAV_PATH);
+                bad_bursts = true;
+                goto cleanup;
+            }
+        }
+        if (SCALE != 1.0 || CONTROL) { // a live "scale" needs the copy buffer too
+            buf = (int16_t *)tx_rt_alloc(&rt, wi.channels * CHUNK_MAX * sizeof(int16_t));
+            if (!buf) {
+                fprintf(stderr, "malloc failed\n");
+                goto cleanup;
+            }
+        }
+        printf("mmap: %zu bytes mapped, %s\n", wm.map_len,
+               SCALE != 1.0 ? "scaled copy" : (DUAL ? "no copy before deinterleave" : "zero-copy"));
+    } else {
+        if (USE_AIO) {
+            if (wav_aio_open(&aio, WAV_PATH, wi.data_offset, wi.data_bytes, rctx.bytes_per_frame, (size_t)AIO_BLOCK,
+                             (unsigned)AIO_DEPTH, LOOP, AIO_BACKEND, &telem))
+                goto cleanup;
+            rctx.aio = &aio;
+            wav_aio_print(&aio);
+        }
+        if (IQZ) {
+            if (iq_pack_open(&pack, WAV_PATH, LOOP, DECODE_THREADS))
+                goto cleanup;
+            rctx.pack = &pack;
+            printf("iqz: %d decoder threads, %u blocks decoded ahead\n", pack.nthreads, pack.window);
+        }
+        if (iq_ring_init(&ring, (size_t)RING_DEPTH, (size_t)wi.channels * CHUNK_MAX, &rt)) {
+            fprintf(stderr, "ring alloc failed\n");
+            goto cleanup;
+        }
+        if (pthread_create(&reader, NULL, reader_thread, &rctx)) {
+            fprintf(stderr, "failed to start reader thread\n");
+            goto cleanup;
+        }
+        reader_started = true;
     }
 
-    const size_t bytes_per_frame = 2 * (wi.bits_per_sample / 8);
-    const size_t bytes_per_chunk = BUF_SAMPLES * bytes_per_frame;
+    if (ANALYZE) {
+        // Fed after each successful send, so it sees the scaled/resampled host-rate stream
+        if (iq_stats_tap_start(&tap, wi.channels / 2, host_sr, CHUNK_MAX,
+                               (size_t)(host_sr * ANALYZE_BLOCK_MS / 1000.0), ANALYZE_FFT))
+            goto cleanup;
+        printf("analyze: tap on, %s kernel, %d-pt spectrum, %d ms blocks\n", tap.st.kernel, ANALYZE_FFT,
+               ANALYZE_BLOCK_MS);
+    }
 
-    uint64_t bytes_left = wi.data_bytes;
-    while (keep_running) {
-        size_t want = bytes_per_chunk;
+    if (BURST_INDEX) {
+        if (tx_burst_start(&burst, &txs, host_sr, BURST_LEAD_MS))
+            goto cleanup;
+        printf("bursts: %ld from %s%s, each queued %.1f ms before its time\n", n_bursts, BURST_INDEX,
+               LOOP ? " (looped)" : "", BURST_LEAD_MS);
+        tx_rt_enter(&rt);
+        stream_bursts(&burst, &wm, bursts, n_bursts, LOOP, chunk.cur, buf, &rctx, &telem);
+        goto cleanup;
+    }
 
-        if (!LOOP) {
-            if (bytes_left == 0)
-                break;
-            if (bytes_left < want)
-                want = (size_t)bytes_left;
-        }
+    lms_stream_status_t st;
+    memset(&st, 0, sizeof(st));
+
+    tx_rt_enter(&rt);
+    time_t last = time(NULL);
 
-        size_t got = fread(buf, 1, want, wf);
-
-        if (got > 0 && SCALE != 1.0) {
-            size_t samples16 = got / 2;
-            for (size_t i = 0; i < samples16; i++) {
-                int32_t v = (int32_t)buf[i];
-                int32_t s = (int32_t)(v * SCALE);
-                if (s > 32767)
-                    s = 32767;
-                else if (s < -32768)
-                    s = -32768;
-                buf[i] = (int16_t)s;
+    while (keep_running) {
+        const int16_t *src = NULL;
+        size_t frames = 0;
+        bool eof = false;
+
+        if (USE_MMAP) {
+            src = wav_map_next(&wm, &frames, &eof);
+            tx_cmd_scale_poll(&cmd.scale, &rctx.scale_seen, &rctx.scale_q);
+            if (rctx.scale_q.scale != 1.0) {
+                rctx.scale_fn(buf, src, frames * wi.channels, &rctx.scale_q);
+                src = buf;
+            }
+        } else {
+            const iq_slot_t *slot = NULL;
+            src = iq_ring_peek(&ring, &slot);
+            if (!src) {
+                atomic_fetch_add_explicit(&ring.empty_waits, 1, memory_order_relaxed);
+                iq_ring_pause(100000);
+                continue;
             }
+            frames = slot->frames;
+            eof = slot->eof;
         }
 
-        size_t frames = got / bytes_per_frame;
         if (frames > 0) {
-            lms_stream_meta_t meta;
-            memset(&meta, 0, sizeof(meta));
-            if (LMS_SendStream(&txs, buf, frames, &meta, SEND_TIMEOUT_MS) < 0) {
+            const uint64_t t_send = tx_telem_now_ns();
+            bool ok;
+            if (DUAL) {
+                ok = tx_mimo_send_interleaved(&mimo, src, frames, SEND_TIMEOUT_MS) == 0;
+            } else {
+                lms_stream_meta_t meta;
+                memset(&meta, 0, sizeof(meta));
+                ok = LMS_SendStream(&txs, src, frames, &meta, SEND_TIMEOUT_MS) >= 0;
+            }
+            tx_telem_send(&telem, t_send, frames, ok);
+            if (!ok) {
                 fprintf(stderr, "LMS_SendStream error: %s\n", LMS_GetLastErrorMessage());
                 break;
             }
+            iq_stats_tap_push(&tap, src, frames);
         }
 
-        if (!LOOP) {
-            if (got < want) {
-                memset(buf, 0, 2 * BUF_SAMPLES * sizeof(int16_t));
-                lms_stream_meta_t meta;
-                memset(&meta, 0, sizeof(meta));
-                (void)LMS_SendStream(&txs, buf, BUF_SAMPLES, &meta, SEND_TIMEOUT_MS);
-                break;
+        if (!USE_MMAP)
+            iq_ring_release(&ring);
+        if (eof)
+            break;
+
+        time_t now = time(NULL);
+        if (now != last) {
+            last = now;
+            bool resized = false;
+            if (DUAL) {
+                lms_stream_status_t sb;
+                memset(&sb, 0, sizeof(sb));
+                if (!tx_mimo_status(&mimo, 0, &st) && !tx_mimo_status(&mimo, 1, &sb)) {
+                    tx_telem_status(&telem, 0, &st);
+                    tx_telem_status(&telem, 1, &sb);
+                    resized = tx_chunk_update(&chunk, &st, &sb);
+                    printf("TX status: A fifo=%u underrun=%u, B fifo=%u underrun=%u, ts=%" PRIu64 ", rearms=%" PRIu64 ", ring=%zu/%zu\n",
+                           st.fifoFilledCount, st.underrun, sb.fifoFilledCount, sb.underrun, mimo.ts, mimo.rearms,
+                           USE_MMAP ? (size_t)0 : iq_ring_fill(&ring), ring.depth);
+                }
+            } else if (!LMS_GetStreamStatus(&txs, &st)) {
+                tx_telem_status(&telem, 0, &st);
+                resized = tx_chunk_update(&chunk, &st, NULL);
+                if (USE_MMAP)
+                    printf("TX status: fifo=%u, underrun=%u, overrun=%u, mmap_pos=%" PRIu64 "/%" PRIu64
+                           ", wraps=%" PRIu64 "\n",
+                           st.fifoFilledCount, st.underrun, st.overrun, wm.pos, wm.frames, wm.wraps);
+                else
+                    printf("TX status: fifo=%u, underrun=%u, overrun=%u, ring=%zu/%zu, ring_empty=%" PRIu64 "\n",
+                           st.fifoFilledCount, st.underrun, st.overrun, iq_ring_fill(&ring), ring.depth,
+                           (uint64_t)atomic_load(&ring.empty_waits));
             }
-            bytes_left -= got;
-        } else {
-            if (got < want) {
-                fseek(wf, (long)wi.data_offset, SEEK_SET);
-                bytes_left = wi.data_bytes;
+            if (resized) {
+                // Slots already in the ring keep their size; the reader picks the new one up next.
+                if (USE_MMAP)
+                    wm.chunk_frames = chunk.cur;
+                else
+                    atomic_store_explicit(&rctx.chunk, chunk.cur, memory_order_relaxed);
+                printf("chunk: %zu frames (%s goal, est. latency %.1f ms)\n", chunk.cur, tx_chunk_goal_name(chunk.goal),
+                       chunk.est_ms);
             }
         }
     }
@@ -479,28 +833,78 @@ int main(int argc, char **argv) {
     printf("\nSIGINT or EOF, stopping\n");
 
 cleanup:
+    keep_running = 0;
+    if (reader_started)
+        pthread_join(reader, NULL);
+    tx_cmd_stop(&cmd);
+    tx_ctrl_stop(&ctrl);
+    if (burst.late_ns)
+        tx_burst_print(&burst);
+
     if (txs.handle) {
-        int16_t *z = (int16_t *)calloc(2 * BUF_SAMPLES, sizeof(int16_t));
+        int16_t *z = BURST_INDEX ? NULL : (int16_t *)calloc(2 * CHUNK_MAX, sizeof(int16_t)); // bursts end idle
         if (z) {
             lms_stream_meta_t meta;
             memset(&meta, 0, sizeof(meta));
-            (void)LMS_SendStream(&txs, z, BUF_SAMPLES, &meta, SEND_TIMEOUT_MS);
+            (void)LMS_SendStream(&txs, z, CHUNK_MAX, &meta, SEND_TIMEOUT_MS);
             free(z);
         }
         LMS_StopStream(&txs);
         LMS_DestroyStream(dev, &txs);
         printf("TX stream stopped\n");
     }
+    if (tx_mimo_active(&mimo)) {
+        int16_t *z = (int16_t *)calloc(2 * CHUNK_MAX, sizeof(int16_t));
+        if (z) {
+            (void)tx_mimo_send(&mimo, z, z, CHUNK_MAX, SEND_TIMEOUT_MS);
+            free(z);
+        }
+        printf("TX streams A+B stopped\n");
+    }
+    tx_mimo_stop(&mimo);
 
     if (dev) {
         LMS_EnableChannel(dev, LMS_CH_TX, CH, false);
+        if (DUAL)
+            LMS_EnableChannel(dev, LMS_CH_TX, CH_B, false);
         printf("TX channel disabled\n");
         LMS_Close(dev);
     }
 
+    wav_map_close(&wm);
+    const bool read_failed = aio.mem && wav_aio_failed(&aio);
+    if (aio.mem) {
+        printf("aio: %.1f MB read from disk in %" PRIu64 " blocks (%.1f MB/s), %" PRIu64 " reads waited on a block\n",
+               (double)aio.disk_bytes / 1e6, aio.blocks, wav_aio_mb_s(&aio), aio.waits);
+        wav_aio_close(&aio);
+    }
+    if (pack.pcm_mem) {
+        printf("iqz: %.1f MB read for %" PRIu64 " blocks, %" PRIu64 " reads waited on a decoder\n",
+               (double)pack.packed_bytes / 1e6, pack.blocks, pack.waits);
+        iq_pack_close(&pack);
+    }
+    if (tap.started) {
+        iq_stats_tap_stop(&tap);
+        printf("analyze: %" PRIu64 " chunks skipped (tap busy)\n", (uint64_t)atomic_load(&tap.dropped));
+        iq_stats_print(&tap.st, stdout);
+        FILE *jf = ANALYZE_JSON ? (strcmp(ANALYZE_JSON, "-") ? fopen(ANALYZE_JSON, "w") : stdout) : NULL;
+        if (jf) {
+            iq_stats_json(&tap.st, jf);
+            fputc('\n', jf);
+            if (jf != stdout)
+                fclose(jf);
+        } else if (ANALYZE_JSON) {
+            fprintf(stderr, "create %s: %s\n", ANALYZE_JSON, strerror(errno));
+        }
+    }
+    iq_stats_tap_free(&tap);
     if (wf)
         fclose(wf);
-    if (buf)
-        free(buf);
-    return 0;
+    tx_telem_stop(&telem);
+    tx_burst_free(&burst);
+    free(bursts);
+    iq_ring_free(&ring);
+    iq_resamp_free(&rs);
+    free(buf);
+    return read_failed || bad_bursts ? 1 : 0;
 }
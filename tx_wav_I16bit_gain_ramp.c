@@ -1,8 +1,20 @@
+#define _GNU_SOURCE
+#include "iq_ramp.h"
+#include "iq_ring.h"
+#include "iq_scale.h"
 #include "lime/LimeSuite.h"
+#include "limetx.h"
+#include "tx_boot.h"
+#include "tx_calcache.h"
+#include "tx_ctrl.h"
+#include "tx_rt.h"
+#include "tx_telem.h"
+#include "wav_mmap.h"
 #include <ctype.h>
 #include <errno.h>
 #include <inttypes.h>
 #include <math.h>
+#include <pthread.h>
 #include <signal.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -17,6 +29,8 @@
 #define FIFO_SIZE_SAMPLES (1 << 17)
 #define BUF_SAMPLES 8192
 #define SEND_TIMEOUT_MS 1000
+#define RING_DEPTH_DEF 8
+#define RAMP_DOWN_MS_DEF 20
 
 #define TX_GAIN_MIN_DB 0
 #define TX_GAIN_MAX_DB 73
@@ -54,38 +68,6 @@ static void print_nco(lms_device_t *dev) {
     printf("set/get: NCO idx=%d (no frequency readback in this LimeSuite)\n", idx);
 }
 
-// clang-format off
-static bool parse_bool(const char* s, bool* out){
-    if (!s || !out) return false;
-    if (!strcasecmp(s,"1") || !strcasecmp(s,"true") || !strcasecmp(s,"yes") || !strcasecmp(s,"on")) { *out=true;  return true; }
-    if (!strcasecmp(s,"0") || !strcasecmp(s,"false")|| !strcasecmp(s,"no")  || !strcasecmp(s,"off")){ *out=false; return true; }
-    return false;
-}
-
-static bool parse_hz(const char* s, double* out){
-    if (!s || !out) return false;
-    char* end = NULL;
-    double v = strtod(s, &end);
-    if (end && *end != '\0'){
-        while (*end && isspace((unsigned char)*end)) end++;
-        if (*end){
-            double mul = 1.0;
-            char c = (char)tolower((unsigned char)*end);
-            if (c=='k') mul = 1e3;
-            else if (c=='m') mul = 1e6;
-            else if (c=='g') mul = 1e9;
-            else return false;
-            end++;
-            while (*end && isspace((unsigned char)*end)) end++;
-            if (*end!='\0') return false;
-            v *= mul;
-        }
-    }
-    *out = v;
-    return true;
-}
-// clang-format on
-
 static int clampi(int v, int lo, int hi) {
     if (v < lo)
         return lo;
@@ -94,12 +76,6 @@ static int clampi(int v, int lo, int hi) {
     return v;
 }
 
-static uint64_t now_ms(void) {
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC, &ts);
-    return (uint64_t)ts.tv_sec * 1000ull + (uint64_t)(ts.tv_nsec / 1000000ull);
-}
-
 #pragma pack(push, 1)
 typedef struct {
     char id[4];
@@ -200,84 +176,62 @@ static bool parse_wav(const char *path, wav_info_t *wi, FILE **outf) {
     return true;
 }
 
-static int set_mac_channel(lms_device_t *dev, int ch) {
-    uint16_t v = 0;
-    if (LMS_ReadLMSReg(dev, 0x0020, &v))
-        return -1;
-    v = (uint16_t)((v & ~0x3) | (ch == 0 ? 0x1 : 0x2));
-    return LMS_WriteLMSReg(dev, 0x0020, v);
-}
-
-static void print_tx_correctors(lms_device_t *dev, int ch) {
-    if (set_mac_channel(dev, ch)) {
-        fprintf(stderr, "WARN: can't set MAC for channel %c\n", ch ? 'B' : 'A');
-        return;
-    }
-
-    uint16_t reg_gq = 0, reg_gi = 0, reg_iq = 0, reg_dc = 0;
-
-    (void)LMS_ReadLMSReg(dev, 0x0201, &reg_gq); // GCORRQ[10:0]
-    (void)LMS_ReadLMSReg(dev, 0x0202, &reg_gi); // GCORRI[10:0]
-    (void)LMS_ReadLMSReg(dev, 0x0203, &reg_iq); // IQCORR[11:0] (signed)
-    (void)LMS_ReadLMSReg(dev, 0x0204, &reg_dc); // DCCORRI[15:8], DCCORRQ[7:0]
-
-    int gq = (int)(reg_gq & 0x07FF);
-    int gi = (int)(reg_gi & 0x07FF);
-
-    int iq = (int)(reg_iq & 0x0FFF);
-    if (iq & 0x0800)
-        iq |= ~0x0FFF;
+typedef struct {
+    FILE *wf;
+    uint64_t data_offset;
+    uint64_t data_bytes;
+    size_t bytes_per_frame;
+    bool loop;
+    double scale;
+    iq_scale_fn scale_fn;
+    iq_scale_q_t scale_q;
+    iq_ring_t *ring;
+    tx_telem_t *telem;
+} reader_ctx_t;
+
+// Producer: file -> ring. Owns every fread()/fseek() so page-cache misses never stall LMS_SendStream.
+static void *reader_thread(void *arg) {
+    reader_ctx_t *rc = (reader_ctx_t *)arg;
+    iq_ring_t *ring = rc->ring;
+    const size_t bytes_per_chunk = BUF_SAMPLES * rc->bytes_per_frame;
+    uint64_t bytes_left = rc->data_bytes;
 
-    int dci = (int8_t)((reg_dc >> 8) & 0xFF);
-    int dcq = (int8_t)(reg_dc & 0xFF);
+    while (keep_running) {
+        iq_slot_t *slot = NULL;
+        int16_t *dst = iq_ring_acquire(ring, &slot);
+        if (!dst) {
+            atomic_fetch_add_explicit(&ring->full_waits, 1, memory_order_relaxed);
+            iq_ring_pause(500000);
+            continue;
+        }
 
-    printf("gain: GCORRI=%d, GCORRQ=%d\n", gi, gq);
-    printf("phase: IQCORR=%d\n", iq);
-    printf("dc: DCCORRI=%d, DCCORRQ=%d\n", dci, dcq);
-}
+        size_t want = bytes_per_chunk;
+        if (!rc->loop && bytes_left < want)
+            want = (size_t)bytes_left;
 
-static int apply_manual_txtsp(lms_device_t *dev, int ch, bool have_gi, int gi, bool have_gq, int gq, bool have_phase,
-                              int phase, bool have_dci, int dci, bool have_dcq, int dcq) {
-    if (set_mac_channel(dev, ch))
-        return -1;
+        const uint64_t t_read = tx_telem_now_ns();
+        size_t got = want ? fread(dst, 1, want, rc->wf) : 0;
+        tx_telem_read(rc->telem, t_read, got);
 
-    int rc = 0;
+        if (got > 0 && rc->scale != 1.0)
+            rc->scale_fn(dst, dst, got / 2, &rc->scale_q);
 
-    if (have_gi) {
-        gi = clampi(gi, 0, 2047);
-        rc |= LMS_WriteLMSReg(dev, 0x0202, (uint16_t)((uint16_t)gi & 0x07FF)); // GCORRI
-    }
-    if (have_gq) {
-        gq = clampi(gq, 0, 2047);
-        rc |= LMS_WriteLMSReg(dev, 0x0201, (uint16_t)((uint16_t)gq & 0x07FF)); // GCORRQ
-    }
-    if (have_phase) {
-        phase = clampi(phase, -2047, 2047);
-        uint16_t iq12 = (uint16_t)((uint16_t)phase & 0x0FFF); // IQCORR (12 bit signed)
-        rc |= LMS_WriteLMSReg(dev, 0x0203, iq12);
-    }
+        slot->frames = got / rc->bytes_per_frame;
+        slot->eof = false;
 
-    if (have_dci || have_dcq) {
-        uint16_t reg_dc = 0;
-        rc |= LMS_ReadLMSReg(dev, 0x0204, &reg_dc); // DCCORR
-        if (have_dci) {
-            int8_t dci_s = (int8_t)clampi(dci, -128, 127);
-            reg_dc = (uint16_t)((reg_dc & 0x00FFu) | ((uint16_t)(uint8_t)dci_s << 8)); // I in [15:8]
-        }
-        if (have_dcq) {
-            int8_t dcq_s = (int8_t)clampi(dcq, -128, 127);
-            reg_dc = (uint16_t)((reg_dc & 0xFF00u) | (uint16_t)(uint8_t)dcq_s); // Q in [7:0]
+        if (!rc->loop) {
+            bytes_left -= got;
+            if (got < bytes_per_chunk || bytes_left == 0)
+                slot->eof = true;
+        } else if (got < want) {
+            fseek(rc->wf, (long)rc->data_offset, SEEK_SET);
         }
-        rc |= LMS_WriteLMSReg(dev, 0x0204, reg_dc);
-    }
 
-    // Clear PH, GC, DC bypass so manual values take effect
-    uint16_t byp = 0;
-    rc |= LMS_ReadLMSReg(dev, 0x0208, &byp);
-    byp &= (uint16_t)~((1u << 0) | (1u << 1) | (1u << 3)); // clear PH_BYP (bit0), GC_BYP (bit1), DC_BYP (bit3)
-    rc |= LMS_WriteLMSReg(dev, 0x0208, byp);
-
-    return rc;
+        iq_ring_publish(ring);
+        if (slot->eof)
+            break;
+    }
+    return NULL;
 }
 
 int main(int argc, char **argv) {
@@ -292,13 +246,29 @@ int main(int argc, char **argv) {
     int TX_GAIN_START = 40;
     int RAMP_MS = 0;              // 0 = ramp disabled (old behavior)
     int RAMP_INTERVAL_MS = 20;    // step interval when ramp enabled
+    iq_ramp_shape_t DIG_RAMP = IQ_RAMP_OFF; // per-sample baseband ramp instead of analog steps
+    int RAMP_DOWN_MS = RAMP_DOWN_MS_DEF;
 
     const char *WAV_PATH = NULL;
     bool LOOP = false;
+    bool USE_MMAP = false;
     double SCALE = 1.0;
+    int LINK_FMT = LMS_LINK_FMT_I16;
+    int RING_DEPTH = RING_DEPTH_DEF;
+    int TELEM_MODE = TX_TELEM_OFF;
+    char TELEM_TARGET[TX_TELEM_PATH_MAX] = "";
+    int TELEM_INTERVAL_MS = TX_TELEM_INTERVAL_MS_DEF;
+    tx_rt_t rt;
+    tx_rt_init(&rt);
 
     bool DO_RESET = false;
     bool DO_CALIBRATE = false;
+    const char *STATE_SAVE = NULL;
+    const char *STATE_LOAD = NULL;
+    char CAL_CACHE_BUF[TXCAL_PATH_MAX];
+    const char *CAL_CACHE = CAL_CACHE_BUF;
+    int CAL_MAX_AGE_S = TXCAL_MAX_AGE_DEF_S;
+    txcal_default_path(CAL_CACHE_BUF, sizeof(CAL_CACHE_BUF));
 
     bool PRINT_CORRECTORS = false;
     bool SET_GI = false, SET_GQ = false, SET_PHASE = false, SET_DCI = false, SET_DCQ = false;
@@ -311,21 +281,35 @@ int main(int argc, char **argv) {
         #define NEEDVAL() do{ if (i+1>=argc){ fprintf(stderr,"missing value for %s\n", a); return 1; } }while(0)
 
         if (!strcmp(a,"--file")){ NEEDVAL(); WAV_PATH = argv[++i]; continue; }
+        if (!strcmp(a,"--state-save")){ NEEDVAL(); STATE_SAVE = argv[++i]; continue; }
+        if (!strcmp(a,"--state-load")){ NEEDVAL(); STATE_LOAD = argv[++i]; continue; }
         if (!strcmp(a,"--oversample")){ NEEDVAL(); OVERSAMPLE = (int)strtol(argv[++i], NULL, 0); if (OVERSAMPLE<1){ fprintf(stderr,"bad --oversample\n"); return 1; } continue; }
-        if (!strcmp(a,"--tx-lpf-bw")){ NEEDVAL(); if(!parse_hz(argv[++i], &TX_LPF_BW_HZ)) { fprintf(stderr,"bad --tx-lpf-bw\n"); return 1; } continue; }
-        if (!strcmp(a,"--lo")){ NEEDVAL(); if(!parse_hz(argv[++i], &LO_HZ)) { fprintf(stderr,"bad --lo\n"); return 1; } continue; }
-        if (!strcmp(a,"--nco")){ NEEDVAL(); if(!parse_hz(argv[++i], &NCO_FREQ_HZ)) { fprintf(stderr,"bad --nco\n"); return 1; } continue; }
-        if (!strcmp(a,"--nco-downconvert")){ NEEDVAL(); if(!parse_bool(argv[++i], &NCO_DOWNCONVERT)) { fprintf(stderr,"bad --nco-downconvert\n"); return 1; } continue; }
+        if (!strcmp(a,"--tx-lpf-bw")){ NEEDVAL(); if(!limetx_parse_hz(argv[++i], &TX_LPF_BW_HZ)) { fprintf(stderr,"bad --tx-lpf-bw\n"); return 1; } continue; }
+        if (!strcmp(a,"--lo")){ NEEDVAL(); if(!limetx_parse_hz(argv[++i], &LO_HZ)) { fprintf(stderr,"bad --lo\n"); return 1; } continue; }
+        if (!strcmp(a,"--nco")){ NEEDVAL(); if(!limetx_parse_hz(argv[++i], &NCO_FREQ_HZ)) { fprintf(stderr,"bad --nco\n"); return 1; } continue; }
+        if (!strcmp(a,"--nco-downconvert")){ NEEDVAL(); if(!limetx_parse_bool(argv[++i], &NCO_DOWNCONVERT)) { fprintf(stderr,"bad --nco-downconvert\n"); return 1; } continue; }
         if (!strcmp(a,"--tx-gain")){ NEEDVAL(); TX_GAIN_DB = (int)strtol(argv[++i], NULL, 0); continue; }
         if (!strcmp(a,"--tx-gain-start")){ NEEDVAL(); TX_GAIN_START = (int)strtol(argv[++i], NULL, 0); HAVE_TX_GAIN_START = true; continue; }
         if (!strcmp(a,"--gain-ramp-ms")){ NEEDVAL(); RAMP_MS = (int)strtol(argv[++i], NULL, 0); continue; }
         if (!strcmp(a,"--gain-ramp-interval-ms")){ NEEDVAL(); RAMP_INTERVAL_MS = (int)strtol(argv[++i], NULL, 0); continue; }
-        if (!strcmp(a,"--cal-bw")){ NEEDVAL(); if(!parse_hz(argv[++i], &CAL_BW_HZ)) { fprintf(stderr,"bad --cal-bw\n"); return 1; } continue; }
+        if (!strcmp(a,"--digital-ramp")){ NEEDVAL(); if(!iq_ramp_parse_shape(argv[++i], &DIG_RAMP)) { fprintf(stderr,"bad --digital-ramp (off|db|cos)\n"); return 1; } continue; }
+        if (!strcmp(a,"--ramp-down-ms")){ NEEDVAL(); RAMP_DOWN_MS = (int)strtol(argv[++i], NULL, 0); continue; }
+        if (!strcmp(a,"--cal-bw")){ NEEDVAL(); if(!limetx_parse_hz(argv[++i], &CAL_BW_HZ)) { fprintf(stderr,"bad --cal-bw\n"); return 1; } continue; }
         if (!strcmp(a,"--loop")){ LOOP = true; continue; }
+        if (!strcmp(a,"--mmap")){ USE_MMAP = true; continue; }
+        if (!strcmp(a,"--ring-depth")){ NEEDVAL(); RING_DEPTH = (int)strtol(argv[++i], NULL, 0); if (RING_DEPTH<2 || RING_DEPTH>1024){ fprintf(stderr,"bad --ring-depth (2..1024)\n"); return 1; } continue; }
+        if (!strcmp(a,"--rt")){ rt.enabled = true; if (i+1 < argc){ bool v=false; if (limetx_parse_bool(argv[i+1], &v)){ rt.enabled = v; i++; } } continue; }
+        if (!strcmp(a,"--rt-cpu")){ NEEDVAL(); rt.cpu = (int)strtol(argv[++i], NULL, 0); if (rt.cpu<0){ fprintf(stderr,"bad --rt-cpu\n"); return 1; } continue; }
+        if (!strcmp(a,"--rt-prio")){ NEEDVAL(); rt.prio = (int)strtol(argv[++i], NULL, 0); if (rt.prio<1 || rt.prio>99){ fprintf(stderr,"bad --rt-prio (1..99)\n"); return 1; } continue; }
+        if (!strcmp(a,"--telemetry")){ NEEDVAL(); if(!tx_telem_parse(argv[++i], &TELEM_MODE, TELEM_TARGET, sizeof(TELEM_TARGET))) { fprintf(stderr,"bad --telemetry (jsonl:<path|->, prom-file:<path>, prom:[host:]<port>)\n"); return 1; } continue; }
+        if (!strcmp(a,"--telemetry-interval-ms")){ NEEDVAL(); TELEM_INTERVAL_MS = (int)strtol(argv[++i], NULL, 0); if (TELEM_INTERVAL_MS<10){ fprintf(stderr,"bad --telemetry-interval-ms (>= 10)\n"); return 1; } continue; }
         if (!strcmp(a,"--scale")){ NEEDVAL(); SCALE = strtod(argv[++i], NULL); if (SCALE<0.0 || SCALE>4.0){ fprintf(stderr,"--scale out of range\n"); return 1; } continue; }
-        if (!strcmp(a,"--reset")){ DO_RESET = true; if (i+1 < argc){ bool v=false; if (parse_bool(argv[i+1], &v)){ DO_RESET = v; i++; } } continue; }
-        if (!strcmp(a,"--calibrate")){ DO_CALIBRATE = true; if (i+1 < argc){ bool v=false; if (parse_bool(argv[i+1], &v)){ DO_CALIBRATE = v; i++; } } continue; }
-        if (!strcmp(a,"--print-correctors")){ PRINT_CORRECTORS = true; if (i+1 < argc){ bool v=false; if (parse_bool(argv[i+1], &v)){ PRINT_CORRECTORS = v; i++; } } continue; }
+        if (!strcmp(a,"--link-fmt")){ NEEDVAL(); if(!limetx_parse_link_fmt(argv[++i], &LINK_FMT)) { fprintf(stderr,"bad --link-fmt (i12|i16)\n"); return 1; } continue; }
+        if (!strcmp(a,"--reset")){ DO_RESET = true; if (i+1 < argc){ bool v=false; if (limetx_parse_bool(argv[i+1], &v)){ DO_RESET = v; i++; } } continue; }
+        if (!strcmp(a,"--calibrate")){ DO_CALIBRATE = true; if (i+1 < argc){ bool v=false; if (limetx_parse_bool(argv[i+1], &v)){ DO_CALIBRATE = v; i++; } } continue; }
+        if (!strcmp(a,"--cal-cache")){ NEEDVAL(); CAL_CACHE = argv[++i]; if (!strcmp(CAL_CACHE,"off")) CAL_CACHE = NULL; continue; }
+        if (!strcmp(a,"--cal-cache-max-age")){ NEEDVAL(); CAL_MAX_AGE_S = (int)strtol(argv[++i], NULL, 0); continue; }
+        if (!strcmp(a,"--print-correctors")){ PRINT_CORRECTORS = true; if (i+1 < argc){ bool v=false; if (limetx_parse_bool(argv[i+1], &v)){ PRINT_CORRECTORS = v; i++; } } continue; }
         if (!strcmp(a,"--set-gain-i")){ NEEDVAL(); SET_GI=true; MAN_GI=clampi((int)strtol(argv[++i], NULL, 0), 0, 2047); continue; }
         if (!strcmp(a,"--set-gain-q")){ NEEDVAL(); SET_GQ=true; MAN_GQ=clampi((int)strtol(argv[++i], NULL, 0), 0, 2047); continue; }
         if (!strcmp(a,"--set-phase")) { NEEDVAL(); SET_PHASE=true; MAN_PHASE=clampi((int)strtol(argv[++i], NULL, 0), -2047, 2047); continue; }
@@ -344,6 +328,12 @@ int main(int argc, char **argv) {
     TX_GAIN_START = clampi(TX_GAIN_START, TX_GAIN_MIN_DB, TX_GAIN_MAX_DB);
     if (RAMP_INTERVAL_MS < 1) RAMP_INTERVAL_MS = 1;
     if (RAMP_MS < 0) RAMP_MS = 0;
+    if (RAMP_DOWN_MS < 0) RAMP_DOWN_MS = 0;
+    if (DIG_RAMP != IQ_RAMP_OFF && TX_GAIN_START > TX_GAIN_DB) {
+        fprintf(stderr, "WARN: digital ramp can only ramp up (start > target), using analog ramp\n");
+        DIG_RAMP = IQ_RAMP_OFF;
+    }
+    const int TX_GAIN_INIT = DIG_RAMP != IQ_RAMP_OFF ? TX_GAIN_DB : TX_GAIN_START;
     // clang-format on
 
     signal(SIGINT, on_sigint);
@@ -358,9 +348,34 @@ int main(int argc, char **argv) {
            wi.channels, wi.data_bytes, wi.data_offset);
 
     lms_device_t *dev = NULL;
+    limetx_regs_t regs;
     lms_stream_t txs;
+    iq_ring_t ring;
+    wav_map_t wm;
     int16_t *buf = NULL;
+    pthread_t reader;
+    bool reader_started = false;
     memset(&txs, 0, sizeof(txs));
+    memset(&ring, 0, sizeof(ring));
+    memset(&wm, 0, sizeof(wm));
+    tx_ctrl_t ctrl;
+    iq_ramp_t ramp;
+    int16_t *out = NULL;
+    tx_telem_t telem;
+    bool ramped_down = false;
+    memset(&ctrl, 0, sizeof(ctrl));
+    memset(&ramp, 0, sizeof(ramp));
+    if (tx_rt_begin(&rt, !USE_MMAP)) { // MCL_FUTURE would pin the whole --mmap mapping
+        fclose(wf);
+        return 1;
+    }
+    if (tx_telem_start(&telem, TELEM_MODE, TELEM_TARGET, "tx_wav_I16bit_gain_ramp", 1, (unsigned)TELEM_INTERVAL_MS)) {
+        fclose(wf);
+        return 1;
+    }
+
+    tx_boot_t boot;
+    tx_boot_begin(&boot, CH);
 
     lms_info_str_t list[8];
     int n = LMS_GetDeviceList(list);
@@ -374,60 +389,72 @@ int main(int argc, char **argv) {
         fclose(wf);
         return 1;
     }
+    tx_boot_attach(&boot, dev);
+    limetx_regs_init(&regs, dev);
 
     if (DO_RESET) {
         CHECK(LMS_Reset(dev));
         printf("device reset to defaults\n");
     }
-    CHECK(LMS_Init(dev));
+    CHECK(tx_boot_init_device(&boot, STATE_LOAD));
 
     CHECK(LMS_EnableChannel(dev, LMS_CH_TX, CH, true));
     printf("TX channel enabled\n");
 
-    CHECK(LMS_SetSampleRate(dev, HOST_SR_HZ, OVERSAMPLE));
+    CHECK(tx_boot_sample_rate(&boot, HOST_SR_HZ, OVERSAMPLE));
     print_sr(dev);
 
-    CHECK(LMS_SetLPFBW(dev, LMS_CH_TX, CH, TX_LPF_BW_HZ));
+    CHECK(tx_boot_lpf_bw(&boot, TX_LPF_BW_HZ));
 
-    CHECK(LMS_SetGaindB(dev, LMS_CH_TX, CH, TX_GAIN_START));
+    CHECK(tx_boot_gain(&boot, TX_GAIN_INIT));
     print_gain(dev);
 
-    CHECK(LMS_SetLOFrequency(dev, LMS_CH_TX, CH, LO_HZ));
+    CHECK(tx_boot_lo(&boot, LO_HZ));
     print_lo(dev);
 
     {
         double freqs[16] = {0};
         freqs[NCO_INDEX] = NCO_FREQ_HZ;
-        CHECK(LMS_SetNCOFrequency(dev, true, CH, freqs, 0.0));
-        CHECK(LMS_SetNCOIndex(dev, true, CH, NCO_INDEX, NCO_DOWNCONVERT));
+        CHECK(tx_boot_nco(&boot, freqs, NCO_INDEX, NCO_DOWNCONVERT));
         print_nco(dev);
     }
 
     if (DO_CALIBRATE) {
-        CHECK(LMS_Calibrate(dev, LMS_CH_TX, CH, CAL_BW_HZ, 0));
+        txcal_key_t cal_key;
+        CHECK(txcal_key_init(&cal_key, dev, CH, LO_HZ, NCO_FREQ_HZ, CAL_BW_HZ));
+        CHECK(txcal_calibrate(&regs, &cal_key, CAL_CACHE, CAL_MAX_AGE_S));
         printf("TX calibrated (bw=%.2f MHz)\n", CAL_BW_HZ / 1e6);
     }
 
     if (PRINT_CORRECTORS) {
-        print_tx_correctors(dev, CH);
+        limetx_print_correctors_short(&regs, CH);
     }
 
     if (SET_GI || SET_GQ || SET_PHASE || SET_DCI || SET_DCQ) {
-        CHECK(apply_manual_txtsp(dev, CH, SET_GI, MAN_GI, SET_GQ, MAN_GQ, SET_PHASE, MAN_PHASE, SET_DCI, MAN_DCI,
+        CHECK(limetx_apply_manual(&regs, CH, SET_GI, MAN_GI, SET_GQ, MAN_GQ, SET_PHASE, MAN_PHASE, SET_DCI, MAN_DCI,
                                  SET_DCQ, MAN_DCQ));
         printf("Manual TXTSP correctors applied.\n");
         if (PRINT_CORRECTORS) {
-            print_tx_correctors(dev, CH);
+            limetx_print_correctors_short(&regs, CH);
         }
     }
 
+    tx_boot_mark(&boot, "correctors");
+    if (STATE_SAVE)
+        tx_boot_save(&boot, STATE_SAVE);
+
     txs.channel = CH;
     txs.isTx = true;
     txs.fifoSize = FIFO_SIZE_SAMPLES;
     txs.dataFmt = LMS_FMT_I16;
+    txs.linkFmt = LINK_FMT;
     CHECK(LMS_SetupStream(dev, &txs));
     CHECK(LMS_StartStream(&txs));
-    printf("TX stream started (fifo=%d samples, fmt=I16)\n", FIFO_SIZE_SAMPLES);
+    printf("TX stream started (fifo=%d samples, fmt=I16, link=%s)\n", FIFO_SIZE_SAMPLES,
+           limetx_link_fmt_name(LINK_FMT));
+    limetx_print_link(LINK_FMT, HOST_SR_HZ);
+    tx_boot_mark(&boot, "stream");
+    tx_boot_print(&boot);
 
     double host_sr = 0, rf_sr = 0;
     LMS_GetSampleRate(dev, LMS_CH_TX, CH, &host_sr, &rf_sr);
@@ -435,125 +462,181 @@ int main(int argc, char **argv) {
     LMS_GetGaindB(dev, LMS_CH_TX, CH, &g_cur);
 
     const double rf_hz = NCO_DOWNCONVERT ? (LO_HZ - NCO_FREQ_HZ) : (LO_HZ + NCO_FREQ_HZ);
-    printf("TX %.6f MHz (host=%.2f Msps, rf=%.2f Msps, start_gain=%d dB (read=%u dB), target_gain=%d dB, ramp=%d ms, step=%d ms, %sconvert)\n",
+    printf("TX %.6f MHz (host=%.2f Msps, rf=%.2f Msps, start_gain=%d dB (read=%u dB), target_gain=%d dB, ramp=%d ms, step=%d ms, digital=%s, %sconvert)\n",
            rf_hz / 1e6, host_sr / 1e6, rf_sr / 1e6, TX_GAIN_START, g_cur, TX_GAIN_DB, RAMP_MS, RAMP_INTERVAL_MS,
-           NCO_DOWNCONVERT ? "down" : "up");
+           iq_ramp_shape_name(DIG_RAMP), NCO_DOWNCONVERT ? "down" : "up");
     printf("Streaming: %s  (Ctrl+C to stop)\n", WAV_PATH);
 
-    buf = (int16_t *)malloc(2 * BUF_SAMPLES * sizeof(int16_t));
-    if (!buf) {
+    reader_ctx_t rctx = {
+        .wf = wf,
+        .data_offset = wi.data_offset,
+        .data_bytes = wi.data_bytes,
+        .bytes_per_frame = 2 * (wi.bits_per_sample / 8),
+        .loop = LOOP,
+        .scale = SCALE,
+        .ring = &ring,
+        .telem = &telem,
+    };
+    const char *scale_kernel = NULL;
+    rctx.scale_fn = iq_scale_select(&scale_kernel);
+    iq_scale_q_init(&rctx.scale_q, SCALE);
+    if (SCALE != 1.0)
+        printf("scale: %.4f using %s kernel\n", SCALE, scale_kernel);
+
+    if (USE_MMAP) {
+        if (wav_map_open(&wm, fileno(wf), wi.data_offset, wi.data_bytes, rctx.bytes_per_frame, BUF_SAMPLES, LOOP))
+            goto cleanup;
+        if (SCALE != 1.0) {
+            buf = (int16_t *)tx_rt_alloc(&rt, 2 * BUF_SAMPLES * sizeof(int16_t));
+            if (!buf) {
+                fprintf(stderr, "malloc failed\n");
+                goto cleanup;
+            }
+        }
+        printf("mmap: %zu bytes mapped, %s\n", wm.map_len, SCALE != 1.0 ? "scaled copy" : "zero-copy");
+    } else {
+        if (iq_ring_init(&ring, (size_t)RING_DEPTH, 2 * BUF_SAMPLES, &rt)) {
+            fprintf(stderr, "ring alloc failed\n");
+            goto cleanup;
+        }
+        if (pthread_create(&reader, NULL, reader_thread, &rctx)) {
+            fprintf(stderr, "failed to start reader thread\n");
+            goto cleanup;
+        }
+        reader_started = true;
+    }
+
+    out = (int16_t *)tx_rt_alloc(&rt, 2 * BUF_SAMPLES * sizeof(int16_t));
+    if (!out || iq_ramp_init(&ramp, BUF_SAMPLES)) {
         fprintf(stderr, "malloc failed\n");
         goto cleanup;
     }
 
-    const size_t bytes_per_frame = 2 * (wi.bits_per_sample / 8);
-    const size_t bytes_per_chunk = BUF_SAMPLES * bytes_per_frame;
-
-    uint64_t bytes_left = wi.data_bytes;
+    if (tx_ctrl_start(&ctrl, dev, CH))
+        goto cleanup;
+    if (DIG_RAMP != IQ_RAMP_OFF) {
+        if (RAMP_MS > 0)
+            iq_ramp_begin(&ramp, DIG_RAMP, (double)(TX_GAIN_START - TX_GAIN_DB), 0.0,
+                          (uint64_t)((double)RAMP_MS * host_sr / 1000.0));
+    } else {
+        tx_ctrl_ramp(&ctrl, TX_GAIN_START, TX_GAIN_DB, RAMP_MS, RAMP_INTERVAL_MS);
+    }
 
-    const bool use_ramp = (RAMP_MS > 0) && (TX_GAIN_DB != TX_GAIN_START);
-    const int total_delta = TX_GAIN_DB - TX_GAIN_START;
-    const int steps = use_ramp ? (RAMP_MS + RAMP_INTERVAL_MS - 1) / RAMP_INTERVAL_MS : 1;
-    const double step_db_f = use_ramp ? ((double)total_delta / (double)steps) : 0.0;
+    lms_stream_status_t st;
+    memset(&st, 0, sizeof(st));
 
-    uint64_t t0 = now_ms();
-    uint64_t t_next = t0 + (use_ramp ? (uint64_t)RAMP_INTERVAL_MS : UINT64_MAX);
-    double g_accum = (double)TX_GAIN_START;
-    int g_last_applied = TX_GAIN_START;
+    tx_rt_enter(&rt);
+    time_t last = time(NULL);
 
     while (keep_running) {
-        size_t want = bytes_per_chunk;
-
-        if (!LOOP) {
-            if (bytes_left == 0)
-                break;
-            if (bytes_left < want)
-                want = (size_t)bytes_left;
+        const int16_t *src = NULL;
+        size_t frames = 0;
+        bool eof = false;
+
+        if (USE_MMAP) {
+            src = wav_map_next(&wm, &frames, &eof);
+            if (SCALE != 1.0) {
+                rctx.scale_fn(buf, src, frames * 2, &rctx.scale_q);
+                src = buf;
+            }
+        } else {
+            const iq_slot_t *slot = NULL;
+            src = iq_ring_peek(&ring, &slot);
+            if (!src) {
+                atomic_fetch_add_explicit(&ring.empty_waits, 1, memory_order_relaxed);
+                iq_ring_pause(100000);
+                continue;
+            }
+            frames = slot->frames;
+            eof = slot->eof;
         }
 
-        size_t got = fread(buf, 1, want, wf);
-
-        if (got > 0 && SCALE != 1.0) {
-            size_t samples16 = got / 2;
-            for (size_t i = 0; i < samples16; i++) {
-                int32_t v = (int32_t)buf[i];
-                int32_t s = (int32_t)(v * SCALE);
-                if (s > 32767)
-                    s = 32767;
-                else if (s < -32768)
-                    s = -32768;
-                buf[i] = (int16_t)s;
-            }
+        if (frames > 0 && iq_ramp_active(&ramp)) {
+            iq_ramp_apply(&ramp, out, src, frames);
+            src = out;
         }
 
-        size_t frames = got / bytes_per_frame;
         if (frames > 0) {
             lms_stream_meta_t meta;
             memset(&meta, 0, sizeof(meta));
-            if (LMS_SendStream(&txs, buf, frames, &meta, SEND_TIMEOUT_MS) < 0) {
+            const uint64_t t_send = tx_telem_now_ns();
+            const bool ok = LMS_SendStream(&txs, src, frames, &meta, SEND_TIMEOUT_MS) >= 0;
+            tx_telem_send(&telem, t_send, frames, ok);
+            if (!ok) {
                 fprintf(stderr, "LMS_SendStream error: %s\n", LMS_GetLastErrorMessage());
                 break;
             }
+        }
 
-            if (use_ramp) {
-                uint64_t now = now_ms();
-                while (now >= t_next && keep_running) {
-                    g_accum += step_db_f;
-                    int g_int = clampi((int)llround(g_accum), TX_GAIN_MIN_DB, TX_GAIN_MAX_DB);
-
-                    if (g_int != g_last_applied) {
-                        fprintf(stderr, "ramp: setting gain to %d dB\n", g_int);
-                        if (LMS_SetGaindB(dev, LMS_CH_TX, CH, g_int) == 0) {
-                            unsigned int g_read = 0;
-                            if (LMS_GetGaindB(dev, LMS_CH_TX, CH, &g_read) == 0) {
-                                fprintf(stderr, "ramp: set=%d dB, get=%u dB\n", g_int, g_read);
-                            } else {
-                                fprintf(stderr, "ramp: LMS_GetGaindB failed: %s\n",
-                                        LMS_GetLastErrorMessage());
-                            }
-                            g_last_applied = g_int;
-                        } else {
-                            fprintf(stderr, "Gain ramp set failed: %s\n", LMS_GetLastErrorMessage());
-                        }
-                    }
-
-                    t_next += (uint64_t)RAMP_INTERVAL_MS;
-
-                    if ((step_db_f >= 0.0 && g_last_applied >= TX_GAIN_DB) ||
-                        (step_db_f <  0.0 && g_last_applied <= TX_GAIN_DB)) {
-                        if (g_last_applied != TX_GAIN_DB) {
-                            (void)LMS_SetGaindB(dev, LMS_CH_TX, CH, TX_GAIN_DB);
-                            g_last_applied = TX_GAIN_DB;
-                        }
-                        t_next = UINT64_MAX;
-                        break;
-                    }
-                    now = now_ms();
-                }
+        if (!USE_MMAP)
+            iq_ring_release(&ring);
+        if (eof)
+            break;
+
+        time_t now = time(NULL);
+        if (now != last) {
+            last = now;
+            if (!LMS_GetStreamStatus(&txs, &st)) {
+                tx_telem_status(&telem, 0, &st);
+                if (USE_MMAP)
+                    printf("TX status: fifo=%u, underrun=%u, overrun=%u, mmap_pos=%" PRIu64 "/%" PRIu64
+                           ", wraps=%" PRIu64 "\n",
+                           st.fifoFilledCount, st.underrun, st.overrun, wm.pos, wm.frames, wm.wraps);
+                else
+                    printf("TX status: fifo=%u, underrun=%u, overrun=%u, ring=%zu/%zu, ring_empty=%" PRIu64 "\n",
+                           st.fifoFilledCount, st.underrun, st.overrun, iq_ring_fill(&ring), ring.depth,
+                           (uint64_t)atomic_load(&ring.empty_waits));
             }
         }
+    }
 
-        if (!LOOP) {
-            if (got < want) {
-                memset(buf, 0, 2 * BUF_SAMPLES * sizeof(int16_t));
-                lms_stream_meta_t meta;
-                memset(&meta, 0, sizeof(meta));
-                (void)LMS_SendStream(&txs, buf, BUF_SAMPLES, &meta, SEND_TIMEOUT_MS);
-                break;
+    printf("\nSIGINT or EOF, stopping\n");
+
+    if (!keep_running && RAMP_DOWN_MS > 0) {
+        // Fade out over whatever input is still buffered (zeros once it runs dry)
+        iq_ramp_begin(&ramp, DIG_RAMP, iq_ramp_level_db(&ramp), IQ_RAMP_MUTE_DB,
+                      (uint64_t)((double)RAMP_DOWN_MS * host_sr / 1000.0));
+        ramped_down = true;
+        while (iq_ramp_active(&ramp)) {
+            const int16_t *src = NULL;
+            const iq_slot_t *slot = NULL;
+            size_t frames = 0;
+            bool eof = false;
+            if (USE_MMAP) {
+                src = wav_map_next(&wm, &frames, &eof);
+                if (SCALE != 1.0) {
+                    rctx.scale_fn(buf, src, frames * 2, &rctx.scale_q);
+                    src = buf;
+                }
+            } else if ((src = iq_ring_peek(&ring, &slot)) != NULL) {
+                frames = slot->frames;
             }
-            bytes_left -= got;
-        } else {
-            if (got < want) {
-                fseek(wf, (long)wi.data_offset, SEEK_SET);
-                bytes_left = wi.data_bytes;
+            if (!src || frames == 0) {
+                memset(out, 0, 2 * BUF_SAMPLES * sizeof(int16_t));
+                src = out;
+                frames = BUF_SAMPLES;
+            }
+
+            iq_ramp_apply(&ramp, out, src, frames);
+            lms_stream_meta_t meta;
+            memset(&meta, 0, sizeof(meta));
+            int rc = LMS_SendStream(&txs, out, frames, &meta, SEND_TIMEOUT_MS);
+            if (slot)
+                iq_ring_release(&ring);
+            if (rc < 0) {
+                ramped_down = false;
+                break;
             }
         }
     }
 
-    printf("\nSIGINT or EOF, stopping\n");
-
 cleanup:
-    if (txs.handle) {
+    keep_running = 0;
+    if (reader_started)
+        pthread_join(reader, NULL);
+    tx_ctrl_stop(&ctrl);
+
+    if (txs.handle && !ramped_down) {
         int16_t *z = (int16_t *)calloc(2 * BUF_SAMPLES, sizeof(int16_t));
         if (z) {
             lms_stream_meta_t meta;
@@ -561,6 +644,8 @@ cleanup:
             (void)LMS_SendStream(&txs, z, BUF_SAMPLES, &meta, SEND_TIMEOUT_MS);
             free(z);
         }
+    }
+    if (txs.handle) {
         LMS_StopStream(&txs);
         LMS_DestroyStream(dev, &txs);
         printf("TX stream stopped\n");
@@ -572,9 +657,13 @@ cleanup:
         LMS_Close(dev);
     }
 
+    wav_map_close(&wm);
     if (wf)
         fclose(wf);
-    if (buf)
-        free(buf);
+    tx_telem_stop(&telem);
+    iq_ring_free(&ring);
+    iq_ramp_free(&ramp);
+    free(buf);
+    free(out);
     return 0;
 }
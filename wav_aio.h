@@ -0,0 +1,509 @@
+#ifndef WAV_AIO_H
+#define WAV_AIO_H
+
+// Asynchronous O_DIRECT reader for the WAV data chunk (--io direct).
+//
+// The data chunk is read in fixed `block` byte requests on WAV_AIO_ALIGN boundaries. The first
+// block starts at data_offset rounded down, and wav_aio_read() skips the header bytes in front of
+// the data. `depth` blocks are kept in flight ahead of the consumer. Each block the consumer
+// finishes is resubmitted right away for the block `depth` further on. With loop that position
+// wraps to the first block, so the loop point is prefetched like any other block. The block
+// numbers keep counting, so a file shorter than depth blocks just has copies of the same blocks
+// in flight.
+//
+// Backends:
+//   uring    io_uring through raw syscalls (IORING_OP_READV), one submit per block, completions
+//            reaped by the consumer
+//   threads  a small pool of preadv() workers fed from a queue, for kernels without io_uring or
+//            where it is disabled (kernel.io_uring_disabled, seccomp)
+//
+// O_DIRECT keeps a multi-GB replay from pushing everything else out of the page cache. Where the
+// filesystem refuses it (tmpfs, some FUSE and network mounts) the file is read buffered and each
+// finished block is dropped with POSIX_FADV_DONTNEED, which has much the same effect.
+//
+// wav_aio_read() behaves like fread() on the data chunk. A read stops short at the data end, and
+// with loop the next call continues from the start, so the caller's EOF and wrap handling stays the
+// same. Only the consumer thread may call it; it copies out of the block buffers into the
+// caller's ring slot.
+
+#include "tx_telem.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <linux/io_uring.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define WAV_AIO_ALIGN 4096u // logical block size of every common device is a divisor
+#define WAV_AIO_BLOCK_DEF (1u << 20)
+#define WAV_AIO_DEPTH_DEF 8
+#define WAV_AIO_DEPTH_MAX 64
+#define WAV_AIO_THREADS_MAX 4
+
+#ifndef __NR_io_uring_setup
+#define __NR_io_uring_setup 425
+#endif
+#ifndef __NR_io_uring_enter
+#define __NR_io_uring_enter 426
+#endif
+
+typedef enum { WAV_AIO_AUTO = 0, WAV_AIO_URING, WAV_AIO_THREADS } wav_aio_backend_t;
+
+enum { WAV_AIO_IDLE = 0, WAV_AIO_QUEUED, WAV_AIO_INFLIGHT, WAV_AIO_DONE, WAV_AIO_READY };
+
+typedef struct {
+    uint8_t *buf;
+    uint64_t seq; // block number in the stream; the file block is seq % nblocks with loop
+    int state;
+    ssize_t res;
+    uint64_t t_submit; // tx_telem_now_ns()
+    struct iovec iov;
+} wav_aio_slot_t;
+
+typedef struct {
+    int fd;
+    bool direct;
+    wav_aio_backend_t backend;
+    bool loop;
+    uint64_t data_offset, data_end; // file offsets of the whole frames in the data chunk
+    uint64_t base;                  // data_offset rounded down to WAV_AIO_ALIGN
+    uint64_t nblocks;
+    size_t block;
+    unsigned depth;
+    uint8_t *mem;
+    wav_aio_slot_t slots[WAV_AIO_DEPTH_MAX];
+    uint64_t next_seq; // next block to submit
+    unsigned cur;      // slot the consumer reads
+    size_t cur_off;    // consumer position inside slots[cur], from the block start
+    bool eof, failed;
+    unsigned inflight; // uring only: submitted, not yet reaped
+    tx_telem_t *telem;
+
+    // uring
+    int ring_fd;
+    void *sq_map, *cq_map;
+    size_t sq_map_len, cq_map_len;
+    struct io_uring_sqe *sqes;
+    size_t sqes_len;
+    _Atomic unsigned *sq_head, *sq_tail, *cq_head, *cq_tail;
+    unsigned *sq_mask, *sq_array, *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    // threads
+    pthread_t th[WAV_AIO_THREADS_MAX];
+    int nthreads;
+    pthread_mutex_t mu;
+    pthread_cond_t work, done;
+    unsigned queue[WAV_AIO_DEPTH_MAX], q_head, q_len;
+    bool stop;
+
+    // stats
+    uint64_t disk_bytes;
+    uint64_t blocks;
+    uint64_t waits; // wav_aio_read() found its block still in flight
+    uint64_t t_open;
+} wav_aio_t;
+
+static inline bool wav_aio_parse_backend(const char *s, wav_aio_backend_t *b) {
+    if (!strcmp(s, "auto"))
+        *b = WAV_AIO_AUTO;
+    else if (!strcmp(s, "uring"))
+        *b = WAV_AIO_URING;
+    else if (!strcmp(s, "threads"))
+        *b = WAV_AIO_THREADS;
+    else
+        return false;
+    return true;
+}
+
+static inline const char *wav_aio_backend_name(wav_aio_backend_t b) {
+    return b == WAV_AIO_URING ? "io_uring" : (b == WAV_AIO_THREADS ? "preadv threads" : "auto");
+}
+
+static inline uint64_t wav_aio_file_off(const wav_aio_t *a, uint64_t seq) {
+    return a->base + (a->loop ? seq % a->nblocks : seq) * a->block;
+}
+
+// ---- io_uring ----
+
+static inline int wav_aio_uring_setup(wav_aio_t *a) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    a->ring_fd = (int)syscall(__NR_io_uring_setup, a->depth, &p);
+    if (a->ring_fd < 0)
+        return -1;
+    a->sq_map_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    a->cq_map_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    a->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    a->sq_map = mmap(NULL, a->sq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, a->ring_fd,
+                     IORING_OFF_SQ_RING);
+    a->cq_map = mmap(NULL, a->cq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, a->ring_fd,
+                     IORING_OFF_CQ_RING);
+    a->sqes = (struct io_uring_sqe *)mmap(NULL, a->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                          a->ring_fd, IORING_OFF_SQES);
+    if (a->sq_map == MAP_FAILED || a->cq_map == MAP_FAILED || a->sqes == MAP_FAILED) {
+        int e = errno;
+        if (a->sq_map != MAP_FAILED)
+            munmap(a->sq_map, a->sq_map_len);
+        if (a->cq_map != MAP_FAILED)
+            munmap(a->cq_map, a->cq_map_len);
+        if (a->sqes != MAP_FAILED)
+            munmap(a->sqes, a->sqes_len);
+        a->sq_map = a->cq_map = NULL;
+        a->sqes = NULL;
+        close(a->ring_fd);
+        a->ring_fd = -1;
+        errno = e;
+        return -1;
+    }
+    uint8_t *sq = (uint8_t *)a->sq_map, *cq = (uint8_t *)a->cq_map;
+    a->sq_head = (_Atomic unsigned *)(sq + p.sq_off.head);
+    a->sq_tail = (_Atomic unsigned *)(sq + p.sq_off.tail);
+    a->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    a->sq_array = (unsigned *)(sq + p.sq_off.array);
+    a->cq_head = (_Atomic unsigned *)(cq + p.cq_off.head);
+    a->cq_tail = (_Atomic unsigned *)(cq + p.cq_off.tail);
+    a->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    a->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    return 0;
+}
+
+static inline int wav_aio_uring_submit(wav_aio_t *a, unsigned idx) {
+    wav_aio_slot_t *s = &a->slots[idx];
+    const unsigned tail = atomic_load_explicit(a->sq_tail, memory_order_relaxed);
+    const unsigned i = tail & *a->sq_mask;
+    struct io_uring_sqe *sqe = &a->sqes[i];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = a->fd;
+    sqe->off = wav_aio_file_off(a, s->seq);
+    sqe->addr = (uint64_t)(uintptr_t)&s->iov;
+    sqe->len = 1;
+    sqe->user_data = idx;
+    a->sq_array[i] = i;
+    atomic_store_explicit(a->sq_tail, tail + 1, memory_order_release);
+    for (;;) {
+        int r = (int)syscall(__NR_io_uring_enter, a->ring_fd, 1, 0, 0, NULL, 0);
+        if (r >= 0)
+            return 0;
+        if (errno != EINTR && errno != EAGAIN)
+            return -1;
+    }
+}
+
+// Reap every posted completion; with wait, block until at least one arrives.
+static inline int wav_aio_uring_reap(wav_aio_t *a, bool wait) {
+    unsigned head = atomic_load_explicit(a->cq_head, memory_order_relaxed);
+    if (wait && head == atomic_load_explicit(a->cq_tail, memory_order_acquire)) {
+        int r = (int)syscall(__NR_io_uring_enter, a->ring_fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (r < 0 && errno != EINTR)
+            return -1;
+    }
+    while (head != atomic_load_explicit(a->cq_tail, memory_order_acquire)) {
+        const struct io_uring_cqe *cqe = &a->cqes[head & *a->cq_mask];
+        wav_aio_slot_t *s = &a->slots[cqe->user_data];
+        s->res = cqe->res;
+        s->state = WAV_AIO_DONE;
+        a->inflight--;
+        head++;
+    }
+    atomic_store_explicit(a->cq_head, head, memory_order_release);
+    return 0;
+}
+
+// ---- preadv thread pool ----
+
+static inline void *wav_aio_worker(void *arg) {
+    wav_aio_t *a = (wav_aio_t *)arg;
+    pthread_mutex_lock(&a->mu);
+    for (;;) {
+        while (!a->stop && a->q_len == 0)
+            pthread_cond_wait(&a->work, &a->mu);
+        if (a->stop)
+            break;
+        const unsigned idx = a->queue[a->q_head];
+        a->q_head = (a->q_head + 1) % WAV_AIO_DEPTH_MAX;
+        a->q_len--;
+        wav_aio_slot_t *s = &a->slots[idx];
+        s->state = WAV_AIO_INFLIGHT;
+        const off_t off = (off_t)wav_aio_file_off(a, s->seq);
+        pthread_mutex_unlock(&a->mu);
+
+        ssize_t r;
+        do
+            r = preadv(a->fd, &s->iov, 1, off);
+        while (r < 0 && errno == EINTR);
+
+        pthread_mutex_lock(&a->mu);
+        s->res = r < 0 ? -errno : r;
+        s->state = WAV_AIO_DONE;
+        pthread_cond_broadcast(&a->done);
+    }
+    pthread_mutex_unlock(&a->mu);
+    return NULL;
+}
+
+static inline void wav_aio_threads_submit(wav_aio_t *a, unsigned idx) {
+    pthread_mutex_lock(&a->mu);
+    a->queue[(a->q_head + a->q_len) % WAV_AIO_DEPTH_MAX] = idx;
+    a->q_len++;
+    pthread_cond_signal(&a->work);
+    pthread_mutex_unlock(&a->mu);
+}
+
+// ---- common ----
+
+// Queue slot idx for block seq; past the end without loop the slot stays idle.
+static inline int wav_aio_submit(wav_aio_t *a, unsigned idx, uint64_t seq) {
+    wav_aio_slot_t *s = &a->slots[idx];
+    s->seq = seq;
+    if (!a->loop && seq >= a->nblocks) {
+        s->state = WAV_AIO_IDLE;
+        return 0;
+    }
+    s->res = 0;
+    s->t_submit = tx_telem_now_ns();
+    if (a->backend == WAV_AIO_URING) {
+        s->state = WAV_AIO_INFLIGHT;
+        a->inflight++;
+        if (wav_aio_uring_submit(a, idx)) {
+            s->state = WAV_AIO_IDLE;
+            a->inflight--;
+            fprintf(stderr, "aio: io_uring submit: %s\n", strerror(errno));
+            return -1;
+        }
+    } else {
+        s->state = WAV_AIO_QUEUED;
+        wav_aio_threads_submit(a, idx);
+    }
+    return 0;
+}
+
+// Wait for the consumer's slot; false on a read error or an idle slot (past the end).
+static inline bool wav_aio_collect(wav_aio_t *a) {
+    wav_aio_slot_t *s = &a->slots[a->cur];
+    if (s->state == WAV_AIO_READY)
+        return true;
+    if (s->state == WAV_AIO_IDLE)
+        return false;
+    if (a->backend == WAV_AIO_URING) {
+        if (wav_aio_uring_reap(a, false))
+            return false;
+        if (s->state != WAV_AIO_DONE)
+            a->waits++;
+        while (s->state != WAV_AIO_DONE)
+            if (wav_aio_uring_reap(a, true)) {
+                fprintf(stderr, "aio: io_uring wait: %s\n", strerror(errno));
+                return false;
+            }
+    } else {
+        pthread_mutex_lock(&a->mu);
+        if (s->state != WAV_AIO_DONE)
+            a->waits++;
+        while (s->state != WAV_AIO_DONE)
+            pthread_cond_wait(&a->done, &a->mu);
+        pthread_mutex_unlock(&a->mu);
+    }
+
+    const uint64_t off = wav_aio_file_off(a, s->seq);
+    const uint64_t need = (a->data_end < off + a->block ? a->data_end : off + a->block) - off;
+    if (s->res < 0 || (uint64_t)s->res < need) {
+        fprintf(stderr, "aio: read of %zu bytes at %" PRIu64 ": %s\n", a->block, off,
+                s->res < 0 ? strerror((int)-s->res) : "short read (file truncated?)");
+        return false;
+    }
+    s->state = WAV_AIO_READY;
+    a->disk_bytes += (uint64_t)s->res;
+    a->blocks++;
+    tx_telem_disk(a->telem, s->t_submit, (size_t)s->res);
+    return true;
+}
+
+static inline void wav_aio_close(wav_aio_t *a) {
+    if (a->backend == WAV_AIO_URING && a->ring_fd >= 0) {
+        while (a->inflight && !wav_aio_uring_reap(a, true)) // the kernel may still DMA into mem
+            ;
+        munmap(a->sqes, a->sqes_len);
+        munmap(a->sq_map, a->sq_map_len);
+        munmap(a->cq_map, a->cq_map_len);
+        close(a->ring_fd);
+    } else if (a->backend == WAV_AIO_THREADS && a->nthreads) {
+        pthread_mutex_lock(&a->mu);
+        a->stop = true;
+        pthread_cond_broadcast(&a->work);
+        pthread_mutex_unlock(&a->mu);
+        for (int i = 0; i < a->nthreads; i++)
+            pthread_join(a->th[i], NULL);
+        pthread_mutex_destroy(&a->mu);
+        pthread_cond_destroy(&a->work);
+        pthread_cond_destroy(&a->done);
+    }
+    if (a->fd >= 0)
+        close(a->fd);
+    free(a->mem);
+    memset(a, 0, sizeof(*a));
+    a->fd = a->ring_fd = -1;
+}
+
+// block is rounded up to WAV_AIO_ALIGN; telem may be NULL.
+static inline int wav_aio_open(wav_aio_t *a, const char *path, uint64_t data_offset, uint64_t data_bytes,
+                               size_t bytes_per_frame, size_t block, unsigned depth, bool loop,
+                               wav_aio_backend_t backend, tx_telem_t *telem) {
+    memset(a, 0, sizeof(*a));
+    a->fd = a->ring_fd = -1;
+    a->loop = loop;
+    a->telem = telem;
+    a->t_open = tx_telem_now_ns();
+    a->depth = depth < 2 ? 2 : (depth > WAV_AIO_DEPTH_MAX ? WAV_AIO_DEPTH_MAX : depth);
+    a->block = (block + WAV_AIO_ALIGN - 1) / WAV_AIO_ALIGN * WAV_AIO_ALIGN;
+    a->data_offset = data_offset;
+    // A truncated file declares more data than it has: stream every whole frame that is there
+    struct stat sb;
+    if (stat(path, &sb)) {
+        fprintf(stderr, "aio: stat %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    if ((uint64_t)sb.st_size < data_offset + data_bytes) {
+        const uint64_t have = (uint64_t)sb.st_size > data_offset ? (uint64_t)sb.st_size - data_offset : 0;
+        fprintf(stderr, "aio: WARN: data chunk declares %" PRIu64 " bytes, file has %" PRIu64 " (truncated?)\n",
+                data_bytes, have);
+        data_bytes = have;
+    }
+    a->data_end = data_offset + data_bytes / bytes_per_frame * bytes_per_frame;
+    a->base = data_offset / WAV_AIO_ALIGN * WAV_AIO_ALIGN;
+    if (a->data_end == data_offset) {
+        fprintf(stderr, "aio: empty data chunk\n");
+        return -1;
+    }
+    a->nblocks = (a->data_end - a->base + a->block - 1) / a->block;
+
+    a->mem = (uint8_t *)aligned_alloc(WAV_AIO_ALIGN, (size_t)a->depth * a->block);
+    if (!a->mem) {
+        fprintf(stderr, "aio: cannot allocate %u x %zu bytes\n", a->depth, a->block);
+        return -1;
+    }
+    for (unsigned i = 0; i < a->depth; i++) {
+        a->slots[i].buf = a->mem + (size_t)i * a->block;
+        a->slots[i].iov.iov_base = a->slots[i].buf;
+        a->slots[i].iov.iov_len = a->block;
+    }
+
+    // Probe with one synchronous read: some filesystems accept O_DIRECT in open() and only fail
+    // the first read.
+    a->fd = open(path, O_RDONLY | O_DIRECT);
+    a->direct = a->fd >= 0 && pread(a->fd, a->mem, a->block, (off_t)a->base) >= 0;
+    if (!a->direct) {
+        if (a->fd >= 0)
+            close(a->fd);
+        a->fd = open(path, O_RDONLY);
+        if (a->fd < 0) {
+            fprintf(stderr, "aio: open %s: %s\n", path, strerror(errno));
+            wav_aio_close(a);
+            return -1;
+        }
+        fprintf(stderr, "WARN: aio: O_DIRECT not supported for %s, reading buffered and dropping pages behind\n",
+                path);
+        (void)posix_fadvise(a->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+
+    a->backend = backend;
+    if (backend != WAV_AIO_THREADS) {
+        a->backend = WAV_AIO_URING;
+        if (wav_aio_uring_setup(a)) {
+            if (backend == WAV_AIO_URING) {
+                fprintf(stderr, "aio: io_uring_setup: %s\n", strerror(errno));
+                wav_aio_close(a);
+                return -1;
+            }
+            a->backend = WAV_AIO_THREADS;
+        }
+    }
+    if (a->backend == WAV_AIO_THREADS) {
+        pthread_mutex_init(&a->mu, NULL);
+        pthread_cond_init(&a->work, NULL);
+        pthread_cond_init(&a->done, NULL);
+        const int want = a->depth < WAV_AIO_THREADS_MAX ? (int)a->depth : WAV_AIO_THREADS_MAX;
+        for (; a->nthreads < want; a->nthreads++)
+            if (pthread_create(&a->th[a->nthreads], NULL, wav_aio_worker, a))
+                break;
+        if (!a->nthreads) {
+            fprintf(stderr, "aio: failed to start reader threads\n");
+            wav_aio_close(a);
+            return -1;
+        }
+    }
+
+    for (unsigned i = 0; i < a->depth; i++)
+        if (wav_aio_submit(a, i, a->next_seq++)) {
+            wav_aio_close(a);
+            return -1;
+        }
+    a->cur_off = (size_t)(a->data_offset - a->base);
+    return 0;
+}
+
+static inline bool wav_aio_failed(const wav_aio_t *a) { return a->failed; }
+
+// Copy up to want bytes of the data chunk into dst, fread() style: stops short at the data end
+// (the next call starts over from the beginning with loop) and on a read error (wav_aio_failed()).
+static inline size_t wav_aio_read(wav_aio_t *a, void *dst, size_t want) {
+    uint8_t *out = (uint8_t *)dst;
+    size_t got = 0;
+    while (got < want && !a->eof && !a->failed) {
+        if (!wav_aio_collect(a)) {
+            a->failed = a->slots[a->cur].state != WAV_AIO_IDLE;
+            a->eof = !a->failed;
+            break;
+        }
+        wav_aio_slot_t *s = &a->slots[a->cur];
+        const uint64_t off = wav_aio_file_off(a, s->seq);
+        const uint64_t end = a->data_end < off + a->block ? a->data_end - off : a->block;
+        if (a->cur_off < end) {
+            size_t n = (size_t)(end - a->cur_off);
+            if (n > want - got)
+                n = want - got;
+            memcpy(out + got, s->buf + a->cur_off, n);
+            a->cur_off += n;
+            got += n;
+            continue;
+        }
+
+        // Block used up: drop it from the page cache if buffered, refill the slot, move on.
+        const bool last = off + a->block >= a->data_end;
+        if (!a->direct)
+            (void)posix_fadvise(a->fd, (off_t)off, (off_t)a->block, POSIX_FADV_DONTNEED);
+        if (wav_aio_submit(a, a->cur, a->next_seq++)) {
+            a->failed = true;
+            break;
+        }
+        a->cur = (a->cur + 1) % a->depth;
+        a->cur_off = last ? (size_t)(a->data_offset - a->base) : 0;
+        if (last && (got || !a->loop)) {
+            a->eof = !a->loop;
+            break;
+        }
+    }
+    return got;
+}
+
+static inline double wav_aio_mb_s(const wav_aio_t *a) {
+    const double s = (double)(tx_telem_now_ns() - a->t_open) / 1e9;
+    return s > 0 ? (double)a->disk_bytes / s / 1e6 : 0.0;
+}
+
+static inline void wav_aio_print(const wav_aio_t *a) {
+    printf("aio: %s, %s, %u x %zu KiB in flight, %" PRIu64 " blocks of data\n", wav_aio_backend_name(a->backend),
+           a->direct ? "O_DIRECT" : "buffered", a->depth, a->block >> 10, a->nblocks);
+}
+
+#endif
@@ -0,0 +1,263 @@
+// Whole-file level and spectrum analysis of 16-bit I/Q WAVs, the native replacement for
+// wav_file_analyze.py on large captures. The data chunk is mmap()ed and split into block-aligned
+// ranges, one per thread; each runs iq_stats.h (SIMD level sums, per-block RMS/peak/clips, Welch
+// spectrum) and the ranges are merged in order.
+//
+// ./wav_analyze <file.wav> [--seconds 0] [--fft 4096] [--overlap 0.5] [--block-ms 100] [--threads 0]
+//               [--json <path|->] [--blocks-csv <path>] [--assume-mono-iq]
+#define _GNU_SOURCE
+#include "iq_stats.h"
+#include "wav_mmap.h"
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define THREADS_MAX 64
+
+typedef struct {
+    uint32_t sample_rate;
+    uint16_t channels;
+    uint64_t data_offset;
+    uint64_t data_bytes;
+} wav_in_t;
+
+static uint32_t le32(const uint8_t *p) { return (uint32_t)p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24; }
+static uint16_t le16(const uint8_t *p) { return (uint16_t)(p[0] | p[1] << 8); }
+
+static bool parse_wav(FILE *f, wav_in_t *wi, bool mono_ok) {
+    memset(wi, 0, sizeof(*wi));
+    uint8_t h[12];
+    if (fread(h, 1, 12, f) != 12 || memcmp(h, "RIFF", 4) || memcmp(h + 8, "WAVE", 4)) {
+        fprintf(stderr, "not a RIFF/WAVE file\n");
+        return false;
+    }
+    bool got_fmt = false;
+    uint16_t format = 0, bits = 0;
+    for (;;) {
+        if (fread(h, 1, 8, f) != 8) {
+            fprintf(stderr, "WAV: missing %s chunk\n", got_fmt ? "data" : "fmt ");
+            return false;
+        }
+        const uint32_t size = le32(h + 4);
+        if (!memcmp(h, "fmt ", 4)) {
+            uint8_t fmt[16];
+            if (size < 16 || fread(fmt, 1, 16, f) != 16) {
+                fprintf(stderr, "WAV: short fmt chunk\n");
+                return false;
+            }
+            format = le16(fmt);
+            wi->channels = le16(fmt + 2);
+            wi->sample_rate = le32(fmt + 4);
+            bits = le16(fmt + 14);
+            fseeko(f, (off_t)(size - 16 + (size & 1)), SEEK_CUR);
+            got_fmt = true;
+        } else if (!memcmp(h, "data", 4) && got_fmt) {
+            wi->data_offset = (uint64_t)ftello(f);
+            wi->data_bytes = size;
+            break;
+        } else {
+            fseeko(f, (off_t)(size + (size & 1)), SEEK_CUR);
+        }
+    }
+    const bool ch_ok = wi->channels == 2 || wi->channels == 4 || (mono_ok && wi->channels == 1);
+    if (!(format == 1 || format == 0xFFFE) || bits != 16 || !ch_ok) {
+        fprintf(stderr, "WAV: need 16-bit PCM with 2 or 4 channels%s; got format 0x%04x, %u ch, %u bits\n",
+                mono_ok ? " (or mono)" : "", format, wi->channels, bits);
+        if (wi->channels == 1 && !mono_ok)
+            fprintf(stderr, "mono: if it holds I0,Q0,I1,Q1,... re-run with --assume-mono-iq\n");
+        return false;
+    }
+    return true;
+}
+
+typedef struct {
+    const int16_t *data;
+    uint64_t first, frames; // range in frames
+    iq_stats_t st;
+    int rc;
+} range_t;
+
+static void *analyze_range(void *arg) {
+    range_t *r = (range_t *)arg;
+    const unsigned lanes = 2 * r->st.ch;
+    for (uint64_t done = 0; done < r->frames;) {
+        uint64_t n = r->frames - done;
+        if (n > r->st.block_frames)
+            n = r->st.block_frames;
+        iq_stats_feed(&r->st, r->data + (r->first + done) * lanes, (size_t)n);
+        done += n;
+    }
+    iq_stats_finish(&r->st);
+    return NULL;
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+    const char *PATH = NULL;
+    double SECONDS = 0.0; // 0 = whole file
+    int FFT = 4096;       // 0 = no spectrum
+    double OVERLAP = 0.5;
+    double BLOCK_MS = 100.0;
+    int THREADS = 0; // 0 = one per CPU
+    const char *JSON = NULL;
+    const char *BLOCKS_CSV = NULL;
+    bool MONO_IQ = false;
+
+    // clang-format off
+    for (int i=1; i<argc; i++){
+        const char* a = argv[i];
+        #define NEEDVAL() do{ if (i+1>=argc){ fprintf(stderr,"missing value for %s\n", a); return 1; } }while(0)
+
+        if (!strcmp(a,"--seconds")){ NEEDVAL(); SECONDS = strtod(argv[++i], NULL); if (SECONDS<0){ fprintf(stderr,"bad --seconds\n"); return 1; } continue; }
+        if (!strcmp(a,"--fft")){ NEEDVAL(); FFT = (int)strtol(argv[++i], NULL, 0); if (FFT && (FFT<16 || FFT>(1<<20) || (FFT & (FFT-1)))){ fprintf(stderr,"bad --fft (0 or a power of two, 16..1048576)\n"); return 1; } continue; }
+        if (!strcmp(a,"--overlap")){ NEEDVAL(); OVERLAP = strtod(argv[++i], NULL); if (OVERLAP<0 || OVERLAP>0.9){ fprintf(stderr,"bad --overlap (0..0.9)\n"); return 1; } continue; }
+        if (!strcmp(a,"--block-ms")){ NEEDVAL(); BLOCK_MS = strtod(argv[++i], NULL); if (BLOCK_MS<=0){ fprintf(stderr,"bad --block-ms\n"); return 1; } continue; }
+        if (!strcmp(a,"--threads")){ NEEDVAL(); THREADS = (int)strtol(argv[++i], NULL, 0); if (THREADS<0 || THREADS>THREADS_MAX){ fprintf(stderr,"bad --threads (0..%d)\n", THREADS_MAX); return 1; } continue; }
+        if (!strcmp(a,"--json")){ NEEDVAL(); JSON = argv[++i]; continue; }
+        if (!strcmp(a,"--blocks-csv")){ NEEDVAL(); BLOCKS_CSV = argv[++i]; continue; }
+        if (!strcmp(a,"--assume-mono-iq")){ MONO_IQ = true; continue; }
+        if (a[0] != '-' && !PATH){ PATH = a; continue; }
+
+        fprintf(stderr,"unknown option: %s\n", a);
+        return 1;
+    }
+    if (!PATH){ fprintf(stderr,"usage: %s <file.wav> [--seconds s] [--fft n] [--overlap f] [--block-ms ms] [--threads n] [--json path|-] [--blocks-csv path] [--assume-mono-iq]\n", argv[0]); return 1; }
+    // clang-format on
+
+    FILE *f = fopen(PATH, "rb");
+    if (!f) {
+        fprintf(stderr, "open %s: %s\n", PATH, strerror(errno));
+        return 1;
+    }
+    wav_in_t wi;
+    if (!parse_wav(f, &wi, MONO_IQ)) {
+        fclose(f);
+        return 1;
+    }
+    // mono I/Q: every frame is two WAV samples, so the complex rate is half the WAV rate
+    const unsigned ch = wi.channels == 1 ? 1 : wi.channels / 2;
+    const double fs = wi.channels == 1 ? wi.sample_rate / 2.0 : (double)wi.sample_rate;
+    const size_t bpf = 2 * ch * sizeof(int16_t);
+
+    // a capture cut short (or still being written) declares more data than the file holds
+    struct stat sb;
+    if (!fstat(fileno(f), &sb) && (uint64_t)sb.st_size < wi.data_offset + wi.data_bytes)
+        wi.data_bytes = (uint64_t)sb.st_size > wi.data_offset ? (uint64_t)sb.st_size - wi.data_offset : 0;
+
+    wav_map_t wm;
+    if (wav_map_open(&wm, fileno(f), wi.data_offset, wi.data_bytes, bpf, 1, false)) {
+        fclose(f);
+        return 1;
+    }
+    uint64_t frames = wm.frames;
+    if (SECONDS > 0.0 && (uint64_t)(SECONDS * fs) < frames)
+        frames = (uint64_t)(SECONDS * fs);
+    size_t block = (size_t)llround(BLOCK_MS * fs / 1000.0);
+    if (block < 1)
+        block = 1;
+
+    if (THREADS == 0) {
+        const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        THREADS = cpus < 1 ? 1 : (cpus > THREADS_MAX ? THREADS_MAX : (int)cpus);
+    }
+    const uint64_t nblocks = (frames + block - 1) / block;
+    if ((uint64_t)THREADS > nblocks)
+        THREADS = nblocks ? (int)nblocks : 1;
+
+    range_t *rs = (range_t *)calloc((size_t)THREADS, sizeof(range_t));
+    pthread_t *th = (pthread_t *)calloc((size_t)THREADS, sizeof(pthread_t));
+    int rc = 1, started = 0;
+    if (!rs || !th) {
+        fprintf(stderr, "malloc failed\n");
+        goto done;
+    }
+    for (int t = 0; t < THREADS; t++) {
+        const uint64_t b0 = nblocks * (uint64_t)t / (uint64_t)THREADS;
+        const uint64_t b1 = nblocks * (uint64_t)(t + 1) / (uint64_t)THREADS;
+        rs[t].data = (const int16_t *)wm.data;
+        rs[t].first = b0 * block;
+        rs[t].frames = (b1 * block < frames ? b1 * block : frames) - rs[t].first;
+        if (iq_stats_init(&rs[t].st, ch, fs, block, FFT, OVERLAP)) {
+            fprintf(stderr, "stats init failed\n");
+            goto done;
+        }
+    }
+
+    const double t0 = now_s();
+    for (; started < THREADS; started++)
+        if (pthread_create(&th[started], NULL, analyze_range, &rs[started]))
+            break;
+    for (int t = started; t < THREADS; t++) // threads that did not start: run their range here
+        analyze_range(&rs[t]);
+    for (int t = 0; t < started; t++)
+        pthread_join(th[t], NULL);
+    for (int t = 1; t < THREADS; t++)
+        if (iq_stats_merge(&rs[0].st, &rs[t].st)) {
+            fprintf(stderr, "malloc failed\n");
+            goto done;
+        }
+    const double dt = now_s() - t0;
+    const iq_stats_t *st = &rs[0].st;
+
+    printf("File      : %s\n", PATH);
+    printf("SampleRate: %u Hz%s\n", wi.sample_rate, wi.channels == 1 ? " (mono I/Q: complex rate is half)" : "");
+    printf("Channels  : %u (%u I/Q pair%s)\n", wi.channels, ch, ch > 1 ? "s" : "");
+    printf("Frames    : %" PRIu64 " of %" PRIu64 " (analyzed %.3f s)\n", frames, wm.frames, (double)frames / fs);
+    printf("Analysis  : %d thread%s, %s kernel, %.2f s (%.0f MB/s)\n\n", THREADS, THREADS > 1 ? "s" : "", st->kernel,
+           dt, dt > 0 ? (double)frames * bpf / dt / 1e6 : 0.0);
+    iq_stats_print(st, stdout);
+    if (ch == 1)
+        printf("Hint: if the spectrum looks mirrored (tone below LO instead of above), swap I/Q or flip Q.\n");
+
+    rc = 0;
+    if (JSON) {
+        FILE *jf = strcmp(JSON, "-") ? fopen(JSON, "w") : stdout;
+        if (!jf) {
+            fprintf(stderr, "create %s: %s\n", JSON, strerror(errno));
+            rc = 1;
+        } else {
+            iq_stats_json(st, jf);
+            fputc('\n', jf);
+            if (jf != stdout && fclose(jf)) {
+                fprintf(stderr, "write %s: %s\n", JSON, strerror(errno));
+                rc = 1;
+            }
+        }
+    }
+    if (BLOCKS_CSV) {
+        FILE *cf = fopen(BLOCKS_CSV, "w");
+        if (!cf) {
+            fprintf(stderr, "create %s: %s\n", BLOCKS_CSV, strerror(errno));
+            rc = 1;
+        } else {
+            iq_stats_blocks_csv(st, cf);
+            if (fclose(cf)) {
+                fprintf(stderr, "write %s: %s\n", BLOCKS_CSV, strerror(errno));
+                rc = 1;
+            }
+        }
+    }
+
+done:
+    if (rs)
+        for (int t = 0; t < THREADS; t++)
+            iq_stats_free(&rs[t].st);
+    free(rs);
+    free(th);
+    wav_map_close(&wm);
+    fclose(f);
+    return rc;
+}
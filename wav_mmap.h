@@ -0,0 +1,151 @@
+#ifndef WAV_MMAP_H
+#define WAV_MMAP_H
+
+// Zero-copy access to a WAV data chunk through mmap().
+// wav_map_next() hands out BUF-sized pointers straight into the mapping; on a loop wrap the
+// tail and the head of the data chunk are spliced into one seam buffer, so every chunk sent
+// is full-size and no seek ever happens.
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define WAV_MAP_READAHEAD_BYTES (16u << 20)
+
+typedef struct {
+    uint8_t *map; // page-aligned mapping base
+    size_t map_len;
+    const uint8_t *data; // first byte of the data chunk inside the mapping
+    uint64_t frames;     // whole frames in the data chunk
+    size_t bytes_per_frame;
+    size_t chunk_frames; // can change between calls, up to the size passed to wav_map_open()
+    bool loop;
+
+    uint64_t pos;        // next frame to hand out
+    uint64_t advised_to; // byte offset (from data) up to which WILLNEED was issued
+    uint8_t *seam;       // chunk_frames frames, used only at a loop wrap
+    uint64_t wraps;
+} wav_map_t;
+
+static inline void wav_map_advise(wav_map_t *m, uint64_t from) {
+    const uint64_t data_len = m->frames * m->bytes_per_frame;
+    if (from >= data_len)
+        return;
+    uint64_t len = WAV_MAP_READAHEAD_BYTES;
+    if (from + len > data_len)
+        len = data_len - from;
+
+    const uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t a = (uintptr_t)(m->data + from) & ~(page - 1);
+    uintptr_t b = (uintptr_t)(m->data + from + len);
+    (void)madvise((void *)a, (size_t)(b - a), MADV_WILLNEED);
+    m->advised_to = from + len;
+}
+
+static inline int wav_map_open(wav_map_t *m, int fd, uint64_t data_offset, uint64_t data_bytes,
+                               size_t bytes_per_frame, size_t chunk_frames, bool loop) {
+    memset(m, 0, sizeof(*m));
+    m->bytes_per_frame = bytes_per_frame;
+    m->chunk_frames = chunk_frames;
+    m->loop = loop;
+    // A truncated file declares more data than it has; touching a page past EOF raises SIGBUS
+    struct stat sb;
+    if (fstat(fd, &sb)) {
+        perror("fstat");
+        return -1;
+    }
+    if ((uint64_t)sb.st_size < data_offset + data_bytes) {
+        const uint64_t have = (uint64_t)sb.st_size > data_offset ? (uint64_t)sb.st_size - data_offset : 0;
+        fprintf(stderr, "mmap: WARN: data chunk declares %" PRIu64 " bytes, file has %" PRIu64 " (truncated?)\n",
+                data_bytes, have);
+        data_bytes = have;
+    }
+    m->frames = data_bytes / bytes_per_frame;
+    if (m->frames == 0) {
+        fprintf(stderr, "mmap: empty data chunk\n");
+        return -1;
+    }
+
+    const uint64_t page = (uint64_t)sysconf(_SC_PAGESIZE);
+    const uint64_t map_off = data_offset & ~(page - 1);
+    m->map_len = (size_t)(data_offset - map_off + m->frames * bytes_per_frame);
+
+    void *p = mmap(NULL, m->map_len, PROT_READ, MAP_SHARED, fd, (off_t)map_off);
+    if (p == MAP_FAILED) {
+        perror("mmap");
+        memset(m, 0, sizeof(*m));
+        return -1;
+    }
+    m->map = (uint8_t *)p;
+    m->data = m->map + (data_offset - map_off);
+    (void)madvise(m->map, m->map_len, MADV_SEQUENTIAL);
+    wav_map_advise(m, 0);
+
+    if (loop) {
+        m->seam = (uint8_t *)aligned_alloc(64, chunk_frames * bytes_per_frame);
+        if (!m->seam) {
+            munmap(m->map, m->map_len);
+            memset(m, 0, sizeof(*m));
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static inline void wav_map_close(wav_map_t *m) {
+    if (m->map)
+        munmap(m->map, m->map_len);
+    free(m->seam);
+    memset(m, 0, sizeof(*m));
+}
+
+// Returns a pointer to the next chunk and its frame count. Without loop the last chunk may be
+// short and sets *eof; with loop every chunk is exactly chunk_frames long.
+static inline const int16_t *wav_map_next(wav_map_t *m, size_t *frames, bool *eof) {
+    *eof = false;
+    if (m->loop && m->pos == m->frames) {
+        m->pos = 0;
+        m->wraps++;
+        wav_map_advise(m, 0);
+    }
+    const uint64_t left = m->frames - m->pos;
+
+    if (left >= m->chunk_frames || !m->loop) {
+        size_t n = left < m->chunk_frames ? (size_t)left : m->chunk_frames;
+        const uint8_t *p = m->data + m->pos * m->bytes_per_frame;
+        m->pos += n;
+        if (!m->loop && m->pos >= m->frames)
+            *eof = true;
+        if (m->pos * m->bytes_per_frame + WAV_MAP_READAHEAD_BYTES / 2 > m->advised_to)
+            wav_map_advise(m, m->advised_to);
+        *frames = n;
+        return (const int16_t *)p;
+    }
+
+    // Loop wrap: splice tail + head into the seam buffer (may wrap more than once for short files)
+    size_t filled = 0;
+    while (filled < m->chunk_frames) {
+        if (m->pos == m->frames) {
+            m->pos = 0;
+            m->wraps++;
+            wav_map_advise(m, 0);
+        }
+        uint64_t avail = m->frames - m->pos;
+        size_t n = m->chunk_frames - filled;
+        if (avail < n)
+            n = (size_t)avail;
+        memcpy(m->seam + filled * m->bytes_per_frame, m->data + m->pos * m->bytes_per_frame, n * m->bytes_per_frame);
+        filled += n;
+        m->pos += n;
+    }
+    *frames = m->chunk_frames;
+    return (const int16_t *)m->seam;
+}
+
+#endif
@@ -6,6 +6,8 @@ import wave
 
 import numpy as np
 
+from iq_shm import IqShmProducer
+
 
 def send_iq_to_fifo(fifo_path: str, i: np.ndarray, q: np.ndarray) -> None:
     if i.dtype != np.int16 or q.dtype != np.int16:
@@ -25,7 +27,8 @@ def send_iq_to_fifo(fifo_path: str, i: np.ndarray, q: np.ndarray) -> None:
             print("WARNING: fifo write blocked", t2 - t1)
 
 
-def stream_wav_to_fifo(wav_path: str, fifo_path: str, chunk_samples: int = 4096, loop: bool = False):
+def stream_wav_to_fifo(wav_path: str, fifo_path: str, chunk_samples: int = 4096, loop: bool = False,
+                       shm_name: str = None):
     # Open WAV
     wf = wave.open(wav_path, "rb")
     if wf.getnchannels() != 2:
@@ -36,16 +39,28 @@ def stream_wav_to_fifo(wav_path: str, fifo_path: str, chunk_samples: int = 4096,
     sr = wf.getframerate()
     print(f"WAV: {sr} Hz, {wf.getnchannels()} ch, 16-bit")
 
-    # C side must be configured with --sample-rate equal to sr
-    print(f"Make sure lime_tx_fifo is using --sample-rate {sr}")
-
-    # Open FIFO once and keep it open
-    if not os.path.exists(fifo_path):
-        raise FileNotFoundError(f"FIFO {fifo_path} does not exist")
-
-    print(f"Opening FIFO {fifo_path} for writing (blocking until C side opens it)...")
-    f = open(fifo_path, "wb", buffering=0)
-    print("FIFO opened, streaming... (Ctrl+C to stop)")
+    # C side must run at sr, or resample from it with --input-rate
+    print(f"Make sure lime_tx_fifo is using --sample-rate {sr} (or --input-rate {sr} to resample)")
+
+    if shm_name:
+        # tx_pipe_I16bit --shm creates the ring; wait for it
+        print(f"Attaching to shared-memory ring {shm_name} (waiting for the C side to create it)...")
+        ring = IqShmProducer(shm_name)
+        if ring.channels != 1:
+            ring.close()
+            wf.close()
+            raise RuntimeError(f"ring {shm_name} carries {ring.channels} channels, the WAV has 1 I/Q pair")
+        write = ring.write
+        print(f"Ring attached ({ring.capacity} bytes), streaming... (Ctrl+C to stop)")
+    else:
+        # Open FIFO once and keep it open
+        if not os.path.exists(fifo_path):
+            raise FileNotFoundError(f"FIFO {fifo_path} does not exist")
+
+        print(f"Opening FIFO {fifo_path} for writing (blocking until C side opens it)...")
+        ring = open(fifo_path, "wb", buffering=0)
+        write = ring.write
+        print("FIFO opened, streaming... (Ctrl+C to stop)")
 
     total_samples_sent = 0
     t0 = time.perf_counter()
@@ -60,21 +75,15 @@ def stream_wav_to_fifo(wav_path: str, fifo_path: str, chunk_samples: int = 4096,
                 else:
                     break
 
-            # Convert bytes → int16
+            # Stereo interleaved L0, R0, L1, R1, ... is already the I0, Q0, I1, Q1, ... the C side takes
             data = np.frombuffer(raw, dtype=np.int16)
-
-            # Stereo interleaved: L0, R0, L1, R1, ...
-            i = data[0::2]
-            q = data[1::2]
-
-            # Interleave explicitly (not strictly needed, but matches the helper)
-            interleaved = np.empty(i.size * 2, dtype=np.int16)
-            interleaved[0::2] = i
-            interleaved[1::2] = q
-
-            # Write to FIFO
-            f.write(interleaved.tobytes())
-            total_samples_sent += i.size
+            if shm_name:
+                if write(data) * 2 < data.size:
+                    print("C side closed the ring")
+                    break
+            else:
+                write(raw)
+            total_samples_sent += data.size // 2
 
             # Real-time pacing: target time based on sample count
             target_time = total_samples_sent / sr
@@ -83,7 +92,7 @@ def stream_wav_to_fifo(wav_path: str, fifo_path: str, chunk_samples: int = 4096,
             if sleep_time > 0:
                 time.sleep(sleep_time)
     finally:
-        f.close()
+        ring.close()
         wf.close()
         print("Streaming finished.")
 
@@ -91,12 +100,14 @@ def stream_wav_to_fifo(wav_path: str, fifo_path: str, chunk_samples: int = 4096,
 def main():
     ap = argparse.ArgumentParser(description="Stream IQ from WAV to FIFO")
     ap.add_argument("--wav", required=True, help="Input stereo 16-bit WAV (I=left, Q=right)")
-    ap.add_argument("--fifo", required=True, help="FIFO path (same as --fifo in lime_tx_fifo)")
+    dst = ap.add_mutually_exclusive_group(required=True)
+    dst.add_argument("--fifo", help="FIFO path (same as --fifo in lime_tx_fifo)")
+    dst.add_argument("--shm", help="Shared-memory ring name (same as --shm in tx_pipe_I16bit)")
     ap.add_argument("--chunk", type=int, default=4096, help="Chunk size in samples per channel")
     ap.add_argument("--loop", action="store_true", help="Loop WAV endlessly")
     args = ap.parse_args()
 
-    stream_wav_to_fifo(args.wav, args.fifo, chunk_samples=args.chunk, loop=args.loop)
+    stream_wav_to_fifo(args.wav, args.fifo, chunk_samples=args.chunk, loop=args.loop, shm_name=args.shm)
 
 
 if __name__ == "__main__":
@@ -1,4 +1,6 @@
 #include "lime/LimeSuite.h"
+#include "limetx.h"
+#include "tx_boot.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -40,40 +42,11 @@ static void usage(const char* prog){
         "  --tx-gain <dB>          TX gain (0..73 typical)       [40]\n"
         "  --loop                  Loop WAV when EOF             [off]\n"
         "  --scale <0..1>          Optional amplitude scale      [1.0]\n"
+        "  --state-save <file>     Save chip state after setup   [off]\n"
+        "  --state-load <file>     Warm start from a saved state [off]\n"
         "  -h, --help              Show this help\n\n", prog);
 }
 
-static bool parse_bool(const char* s, bool* out){
-    if (!s || !out) return false;
-    if (!strcasecmp(s,"1") || !strcasecmp(s,"true") || !strcasecmp(s,"yes") || !strcasecmp(s,"on")) { *out=true;  return true; }
-    if (!strcasecmp(s,"0") || !strcasecmp(s,"false")|| !strcasecmp(s,"no")  || !strcasecmp(s,"off")){ *out=false; return true; }
-    return false;
-}
-
-// Parse Hz with optional k/M/G suffix (case-insensitive). Returns true on success.
-static bool parse_hz(const char* s, double* out){
-    if (!s || !out) return false;
-    char* end = NULL;
-    double v = strtod(s, &end);
-    if (end && *end != '\0'){
-        while (*end && isspace((unsigned char)*end)) end++;
-        if (*end){
-            double mul = 1.0;
-            char c = (char)tolower((unsigned char)*end);
-            if (c=='k') mul = 1e3;
-            else if (c=='m') mul = 1e6;
-            else if (c=='g') mul = 1e9;
-            else return false;
-            end++;
-            while (*end && isspace((unsigned char)*end)) end++;
-            if (*end!='\0') return false;
-            v *= mul;
-        }
-    }
-    *out = v;
-    return true;
-}
-
 /* ---------- Minimal WAV parser (PCM16, stereo) ---------- */
 
 #pragma pack(push,1)
@@ -185,6 +158,8 @@ int main(int argc, char** argv)
     bool   NCO_DOWNCONVERT   = true;
     int    TX_GAIN_DB        = DEFAULT_TX_GAIN;
     bool   LOOP              = false;
+    const char* STATE_SAVE = NULL;
+    const char* STATE_LOAD = NULL;
     double SCALE             = 1.0; // optional amplitude scale
 
     for (int i=1; i<argc; i++){
@@ -193,12 +168,14 @@ int main(int argc, char** argv)
         #define NEEDVAL() do{ if (i+1>=argc){ fprintf(stderr,"Missing value for %s\n", a); usage(argv[0]); return 1; } }while(0)
         if (!strcmp(a,"--file")){ NEEDVAL(); WAV_PATH = argv[++i]; continue; }
         if (!strcmp(a,"--oversample")){ NEEDVAL(); OVERSAMPLE = (int)strtol(argv[++i], NULL, 0); continue; }
-        if (!strcmp(a,"--tx-lpf-bw")){ NEEDVAL(); if(!parse_hz(argv[++i], &TX_LPF_BW_HZ)) { fprintf(stderr,"Bad --tx-lpf-bw\n"); return 1; } continue; }
-        if (!strcmp(a,"--lo")){ NEEDVAL(); if(!parse_hz(argv[++i], &LO_HZ)) { fprintf(stderr,"Bad --lo\n"); return 1; } continue; }
-        if (!strcmp(a,"--nco")){ NEEDVAL(); if(!parse_hz(argv[++i], &NCO_FREQ_HZ)) { fprintf(stderr,"Bad --nco\n"); return 1; } continue; }
-        if (!strcmp(a,"--nco-downconvert")){ NEEDVAL(); if(!parse_bool(argv[++i], &NCO_DOWNCONVERT)) { fprintf(stderr,"Bad --nco-downconvert\n"); return 1; } continue; }
+        if (!strcmp(a,"--tx-lpf-bw")){ NEEDVAL(); if(!limetx_parse_hz(argv[++i], &TX_LPF_BW_HZ)) { fprintf(stderr,"Bad --tx-lpf-bw\n"); return 1; } continue; }
+        if (!strcmp(a,"--lo")){ NEEDVAL(); if(!limetx_parse_hz(argv[++i], &LO_HZ)) { fprintf(stderr,"Bad --lo\n"); return 1; } continue; }
+        if (!strcmp(a,"--nco")){ NEEDVAL(); if(!limetx_parse_hz(argv[++i], &NCO_FREQ_HZ)) { fprintf(stderr,"Bad --nco\n"); return 1; } continue; }
+        if (!strcmp(a,"--nco-downconvert")){ NEEDVAL(); if(!limetx_parse_bool(argv[++i], &NCO_DOWNCONVERT)) { fprintf(stderr,"Bad --nco-downconvert\n"); return 1; } continue; }
         if (!strcmp(a,"--tx-gain")){ NEEDVAL(); TX_GAIN_DB = (int)strtol(argv[++i], NULL, 0); continue; }
         if (!strcmp(a,"--loop")){ LOOP = true; continue; }
+        if (!strcmp(a,"--state-save")){ NEEDVAL(); STATE_SAVE = argv[++i]; continue; }
+        if (!strcmp(a,"--state-load")){ NEEDVAL(); STATE_LOAD = argv[++i]; continue; }
         if (!strcmp(a,"--scale")){ NEEDVAL(); SCALE = strtod(argv[++i], NULL); if (SCALE<0.0 || SCALE>4.0){ fprintf(stderr,"--scale out of range\n"); return 1; } continue; }
         fprintf(stderr,"Unknown option: %s\n", a); usage(argv[0]); return 1;
     }
@@ -221,27 +198,33 @@ int main(int argc, char** argv)
     memset(&txs, 0, sizeof(txs));
     int16_t* buf = NULL;
 
+    tx_boot_t boot;
+    tx_boot_begin(&boot, CH);
+
     lms_info_str_t list[8];
     int n = LMS_GetDeviceList(list);
     if (n < 1) { fprintf(stderr,"No LimeSDR found\n"); fclose(wf); return 1; }
     if (LMS_Open(&dev, list[0], NULL)) { fprintf(stderr,"LMS_Open failed: %s\n", LMS_GetLastErrorMessage()); fclose(wf); return 1; }
+    tx_boot_attach(&boot, dev);
 
     // Setup
-    CHECK(LMS_Init(dev));
+    CHECK(tx_boot_init_device(&boot, STATE_LOAD));
     CHECK(LMS_EnableChannel(dev, LMS_CH_TX, CH, true));
-    CHECK(LMS_SetSampleRate(dev, HOST_SR_HZ, OVERSAMPLE));  // complex samples (I+Q)
-    CHECK(LMS_SetLPFBW(dev, LMS_CH_TX, CH, TX_LPF_BW_HZ));
-    CHECK(LMS_SetGaindB(dev, LMS_CH_TX, CH, TX_GAIN_DB));
-    CHECK(LMS_SetLOFrequency(dev, LMS_CH_TX, CH, LO_HZ));
+    CHECK(tx_boot_sample_rate(&boot, HOST_SR_HZ, OVERSAMPLE));  // complex samples (I+Q)
+    CHECK(tx_boot_lpf_bw(&boot, TX_LPF_BW_HZ));
+    CHECK(tx_boot_gain(&boot, TX_GAIN_DB));
+    CHECK(tx_boot_lo(&boot, LO_HZ));
 
     // NCO
     {
         double freqs[16]={0};
         freqs[NCO_INDEX] = NCO_FREQ_HZ;
-        CHECK(LMS_SetNCOFrequency(dev, true, CH, freqs, 0.0));
-        CHECK(LMS_SetNCOIndex    (dev, true, CH, NCO_INDEX, NCO_DOWNCONVERT));
+        CHECK(tx_boot_nco(&boot, freqs, NCO_INDEX, NCO_DOWNCONVERT));
     }
 
+    tx_boot_mark(&boot, "setup");
+    if (STATE_SAVE) tx_boot_save(&boot, STATE_SAVE);
+
     // Stream
     txs.channel  = CH;
     txs.isTx     = true;
@@ -250,6 +233,8 @@ int main(int argc, char** argv)
     CHECK(LMS_SetupStream(dev, &txs));
     CHECK(LMS_StartStream(&txs));
     printf("TX stream started (fmt=I16, fifo=%d).\n", FIFO_SIZE_SAMPLES);
+    tx_boot_mark(&boot, "stream");
+    tx_boot_print(&boot);
 
     double host=0, rf=0; LMS_GetSampleRate(dev, LMS_CH_TX, CH, &host, &rf);
     unsigned g=0; LMS_GetGaindB(dev, LMS_CH_TX, CH, &g);